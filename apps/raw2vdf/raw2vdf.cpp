@@ -36,6 +36,12 @@
 #include <vapor/CFuncs.h>
 #ifdef WIN32
 #include "windows.h"
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 using namespace VetsUtil;
@@ -56,6 +62,7 @@ struct opt_t {
 	OptionParser::Boolean_T	quiet;
 	OptionParser::Boolean_T	swapbytes;
 	OptionParser::Boolean_T	dbl;
+	OptionParser::Boolean_T	mmap;
 	OptionParser::IntRange_T xregion;
 	OptionParser::IntRange_T yregion;
 	OptionParser::IntRange_T zregion;
@@ -75,6 +82,8 @@ OptionParser::OptDescRec_T	set_opts[] = {
 	{"quiet",	0,	"",	"Operate quietly"},
 	{"swapbytes",	0,	"",	"Swap bytes in raw data as they are read from disk"},
 	{"dbl",	0,	"",	"Input data are 64-bit floats"},
+	{"mmap",	0,	"",	"Map the raw data file into memory instead of "
+		"reading it (ignored on Windows)"},
 	{"xregion", 1, "-1:-1", "X dimension subregion bounds (min:max)"},
 	{"yregion", 1, "-1:-1", "Y dimension subregion bounds (min:max)"},
 	{"zregion", 1, "-1:-1", "Z dimension subregion bounds (min:max)"},
@@ -94,6 +103,7 @@ OptionParser::Option_T	get_options[] = {
 	{"quiet", VetsUtil::CvtToBoolean, &opt.quiet, sizeof(opt.quiet)},
 	{"swapbytes", VetsUtil::CvtToBoolean, &opt.swapbytes, sizeof(opt.swapbytes)},
 	{"dbl", VetsUtil::CvtToBoolean, &opt.dbl, sizeof(opt.dbl)},
+	{"mmap", VetsUtil::CvtToBoolean, &opt.mmap, sizeof(opt.mmap)},
 	{"xregion", VetsUtil::CvtToIntRange, &opt.xregion, sizeof(opt.xregion)},
 	{"yregion", VetsUtil::CvtToIntRange, &opt.yregion, sizeof(opt.yregion)},
 	{"zregion", VetsUtil::CvtToIntRange, &opt.zregion, sizeof(opt.zregion)},
@@ -253,6 +263,257 @@ int read_next_slice(
 
 }
 
+#ifndef WIN32
+
+//
+// Read only view of the raw data file. The file is mapped through a
+// window that slides forward as slices are consumed, so only
+// MapWindowSize bytes of it (or one slice, if larger) are mapped, and
+// resident, at any time regardless of the size of the file.
+//
+const size_t MapWindowSize = 64*1024*1024;
+
+class MappedFile {
+public:
+	MappedFile() {
+		_fd = -1; _base = NULL; _woffset = 0; _wlen = 0; _size = 0;
+		_offset = 0;
+	}
+	~MappedFile() { Close(); }
+
+	int Open(const char *path);
+	void Close();
+
+	//
+	// Return a pointer to bytes [offset, offset+len) of the file. The
+	// pointer is valid until the next call.
+	//
+	const unsigned char *Map(size_t offset, size_t len);
+
+	//
+	// Mapped counterpart of read_next_slice(): return the next slice of
+	// the file. Raw rows are converted and unstaggered in a single pass
+	// from the mapped pages into slice. If no conversion is needed the
+	// mapped slice itself is returned, valid until the next call, and
+	// slice is untouched.
+	//
+	const float *NextSlice(
+		const size_t dim[2], float *slice, float *read_timer
+	);
+
+private:
+	int _fd;
+	unsigned char *_base;	// start of the window
+	size_t _woffset;	// file offset of the window
+	size_t _wlen;	// length of the window
+	size_t _size;	// file size
+	size_t _offset;	// file offset of the next slice
+	vector <float> _prev;	// previous native slice if z staggered
+	vector <float> _row0;
+	vector <float> _row1;
+};
+
+int MappedFile::Open(const char *path) {
+	Close();
+
+	struct STAT64_T statbuf;
+	if (STAT64(path, &statbuf) < 0) {
+		MyBase::SetErrMsg("Could not stat file \"%s\" : %M", path);
+		return(-1);
+	}
+	_size = statbuf.st_size;
+
+	_fd = open(path, O_RDONLY);
+	if (_fd < 0) {
+		MyBase::SetErrMsg("Could not open file \"%s\" : %M", path);
+		return(-1);
+	}
+	return(0);
+}
+
+void MappedFile::Close() {
+	if (_base) munmap(_base, _wlen);
+	if (_fd >= 0) close(_fd);
+	_fd = -1;
+	_base = NULL;
+	_woffset = _wlen = 0;
+	_offset = 0;
+	_prev.clear();
+}
+
+const unsigned char *MappedFile::Map(size_t offset, size_t len) {
+	if (offset + len > _size) {
+		MyBase::SetErrMsg("Short read on input file");
+		return(NULL);
+	}
+
+	if (_base && offset >= _woffset && offset + len <= _woffset + _wlen) {
+		return(_base + (offset - _woffset));
+	}
+
+	//
+	// Unmap the pages already consumed and map the next window, starting
+	// at the page holding offset
+	//
+	if (_base) munmap(_base, _wlen);
+	_base = NULL;
+
+	size_t pagesize = sysconf(_SC_PAGESIZE);
+	_woffset = offset - (offset % pagesize);
+	_wlen = (offset - _woffset) + len;
+	if (_wlen < MapWindowSize) _wlen = MapWindowSize;
+	if (_woffset + _wlen > _size) _wlen = _size - _woffset;
+
+	void *addr = mmap(NULL, _wlen, PROT_READ, MAP_SHARED, _fd, _woffset);
+	if (addr == MAP_FAILED) {
+		MyBase::SetErrMsg("Could not map input file : %M");
+		_wlen = 0;
+		return(NULL);
+	}
+	_base = (unsigned char *) addr;
+
+	// The window is read once, front to back
+	//
+	(void) madvise(_base, _wlen, MADV_SEQUENTIAL);
+
+	return(_base + (offset - _woffset));
+}
+
+//
+// Convert n raw elements to floats, swapping bytes and narrowing doubles
+// in the same pass
+//
+void convert_row(const unsigned char *src, size_t n, float *dst) {
+	if (! opt.dbl && ! opt.swapbytes) {
+		memcpy(dst, src, n*sizeof(*dst));
+	}
+	else if (! opt.dbl) {
+		for (size_t i=0; i<n; i++, src += sizeof(float)) {
+			unsigned char *d = (unsigned char *) &dst[i];
+			d[0] = src[3]; d[1] = src[2]; d[2] = src[1]; d[3] = src[0];
+		}
+	}
+	else if (! opt.swapbytes) {
+		for (size_t i=0; i<n; i++, src += sizeof(double)) {
+			double v;
+			memcpy(&v, src, sizeof(v));
+			dst[i] = (float) v;
+		}
+	}
+	else {
+		for (size_t i=0; i<n; i++, src += sizeof(double)) {
+			double v;
+			unsigned char *d = (unsigned char *) &v;
+			d[0] = src[7]; d[1] = src[6]; d[2] = src[5]; d[3] = src[4];
+			d[4] = src[3]; d[5] = src[2]; d[6] = src[1]; d[7] = src[0];
+			dst[i] = (float) v;
+		}
+	}
+}
+
+const float *MappedFile::NextSlice(
+	const size_t dim[2],
+	float *slice,
+	float *read_timer
+) {
+	double t0 = GetTime();
+
+	size_t element_sz = opt.dbl ? sizeof(double) : sizeof(float);
+
+	size_t dimx,dimy;
+	dimx = (opt.staggeredDim == 1) ? dim[0]+1 : dim[0];
+	dimy = (opt.staggeredDim == 2) ? dim[1]+1 : dim[1];
+	size_t slice_sz = dimx*dimy*element_sz;
+
+	//
+	// First slice of z staggered data only primes _prev
+	//
+	if (opt.staggeredDim == 3 && _prev.empty()) {
+		const unsigned char *src = Map(_offset, slice_sz);
+		if (! src) return(NULL);
+		_offset += slice_sz;
+
+		_prev.resize(dimx*dimy);
+		convert_row(src, dimx*dimy, &_prev[0]);
+	}
+
+	const unsigned char *src = Map(_offset, slice_sz);
+	if (! src) return(NULL);
+	_offset += slice_sz;
+
+	if (opt.staggeredDim == 0 && ! opt.dbl && ! opt.swapbytes) {
+		*read_timer += GetTime() - t0;
+		return((const float *) src);
+	}
+
+	size_t rowsz = dimx*element_sz;
+	if (opt.staggeredDim == 1) {
+		_row0.resize(dimx);
+		for (size_t j=0; j<dim[1]; j++) {
+			convert_row(src + j*rowsz, dimx, &_row0[0]);
+			float *dst = slice + j*dim[0];
+			for (size_t i=0; i<dim[0]; i++) {
+				dst[i] = 0.5*(_row0[i]+_row0[i+1]);
+			}
+		}
+	}
+	else if (opt.staggeredDim == 2) {
+		_row0.resize(dimx);
+		_row1.resize(dimx);
+		convert_row(src, dimx, &_row0[0]);
+		for (size_t j=0; j<dim[1]; j++) {
+			convert_row(src + (j+1)*rowsz, dimx, &_row1[0]);
+			float *dst = slice + j*dim[0];
+			for (size_t i=0; i<dim[0]; i++) {
+				dst[i] = (_row0[i]+_row1[i])*0.5;
+			}
+			_row0.swap(_row1);
+		}
+	}
+	else if (opt.staggeredDim == 3) {
+		_row0.resize(dimx);
+		for (size_t j=0; j<dim[1]; j++) {
+			convert_row(src + j*rowsz, dimx, &_row0[0]);
+			float *old_row = &_prev[j*dimx];
+			float *dst = slice + j*dim[0];
+			for (size_t i=0; i<dim[0]; i++) {
+				float v = _row0[i];
+				dst[i] = 0.5*(v + old_row[i]);
+				old_row[i] = v;
+			}
+		}
+	}
+	else {
+		convert_row(src, dimx*dimy, slice);
+	}
+
+	*read_timer += GetTime() - t0;
+	return(slice);
+}
+
+MappedFile *MFile = NULL;	// non-NULL if the data file is mapped
+#endif
+
+//
+// Return the next slice of the data file, read from fp or mapped. The
+// slice is either slice, or points into the mapped file.
+//
+const float *next_slice(
+	const VDFIOBase *vdfio,
+	const size_t dim[2],
+	FILE	*fp, 
+	float *slice,
+	float *read_timer
+) {
+#ifndef WIN32
+	if (MFile) return(MFile->NextSlice(dim, slice, read_timer));
+#endif
+
+	int rc = read_next_slice(vdfio, dim, fp, slice, read_timer);
+	if (rc<0) return(NULL);
+	return(slice);
+}
+
 void	process_volume(
 	VDFIOBase *vdfio,
 	FILE *fp,
@@ -308,10 +569,10 @@ void	process_volume(
 			cout << "Reading slice # " << z << endl;
 		}
 
-		rc = read_next_slice(vdfio, dim3d, fp, slice, read_timer);
-		if (rc<0) exit(1);
+		const float *sptr = next_slice(vdfio, dim3d, fp, slice, read_timer);
+		if (! sptr) exit(1);
 
-		rc = vdfio->WriteSlice(slice);
+		rc = vdfio->WriteSlice(sptr);
 		if (rc<0) {
 			MyBase::SetErrMsg(
 				"Failed to write slice # %d of variable \"%s\"", z, opt.varname
@@ -333,7 +594,7 @@ void	process_volume(
 }
 
 
-float *read_region(
+const float *read_region(
 	VDFIOBase *vdfio,
 	FILE	*fp, 
 	Metadata::VarType_T vtype,
@@ -389,14 +650,16 @@ float *read_region(
 	}
 	if (vtype != Metadata::VAR3D) dim3d[2] = 1;
 
-	// Allocate a buffer large enough to hold entire subregion
-	//
 	size_t size = dim3d[0]*dim3d[1]*dim3d[2];
 
+	// Allocate a buffer large enough to hold entire subregion
+	//
 	float *region = new float[size];
 
 	//
-	// Translate the volume one slice at a time
+	// Translate the volume one slice at a time. A mapped file is only
+	// mapped through its window, a slice at a time, and slices that need
+	// no conversion are copied out of it.
 	//
 	float *slice = region;
 	int rc;
@@ -406,8 +669,11 @@ float *read_region(
 			cout << "Reading slice # " << z << endl;
 		}
 
-		rc = read_next_slice(vdfio, dim3d, fp, slice, read_timer);
-		if (rc<0) exit(1);
+		const float *sptr = next_slice(vdfio, dim3d, fp, slice, read_timer);
+		if (! sptr) exit(1);
+		if (sptr != slice) {
+			memcpy(slice, sptr, dim3d[0]*dim3d[1]*sizeof(*slice));
+		}
 
 		slice += dim3d[0]*dim3d[1];
 	}
@@ -435,12 +701,12 @@ void	process_region(
 	}
 
 
-	float *buf = NULL;
+	const float *buf = NULL;
 	size_t min[3], max[3];
 
 	buf = read_region(vdfio, fp, vtype, min, max, read_timer);
 
-	vdfio->WriteRegion((float *) buf, min, max);
+	vdfio->WriteRegion(buf, min, max);
 	if (vdfio->GetErrCode() != 0) {
 		MyBase::SetErrMsg(
 			"Failed to write region of variable \"%s\"", opt.varname
@@ -556,10 +822,21 @@ int	main(int argc, char **argv) {
 		exit(1);
 	}
 
-	fp = FOPEN64(datafile, "rb");
-	if (! fp) {
-		MyBase::SetErrMsg("Could not open file \"%s\" : %M", datafile);
-		exit(1);
+	fp = NULL;
+#ifdef WIN32
+	opt.mmap = false;
+#else
+	if (opt.mmap) {
+		MFile = new MappedFile();
+		if (MFile->Open(datafile) < 0) exit(1);
+	}
+#endif
+	if (! opt.mmap) {
+		fp = FOPEN64(datafile, "rb");
+		if (! fp) {
+			MyBase::SetErrMsg("Could not open file \"%s\" : %M", datafile);
+			exit(1);
+		}
 	}
 
 
@@ -589,6 +866,12 @@ int	main(int argc, char **argv) {
 
 		fprintf(stdout, "read time : %f\n", read_timer);
 		fprintf(stdout, "write time : %f\n", write_timer);
+		if (wcwriter) {
+			fprintf(
+				stdout, "background write time : %f\n",
+				wcwriter->GetFlushTimer()
+			);
+		}
 		fprintf(stdout, "transform time : %f\n", xform_timer);
 		fprintf(stdout, "total transform time : %f\n", timer);
 		fprintf(stdout, "min and max values of data output: %g, %g\n",range[0], range[1]);
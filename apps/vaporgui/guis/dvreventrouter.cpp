@@ -793,6 +793,14 @@ void DvrEventRouter::initTypes()
     index++;
   }
 
+  if (VolumeRenderer::supported(DvrParams::DVR_CPU_RAY_CASTER))
+  {
+    typeCombo->insertItem(index,"CPU Ray Caster");
+    typemap[index] = DvrParams::DVR_CPU_RAY_CASTER;
+    typemapi[DvrParams::DVR_CPU_RAY_CASTER] = index;
+    index++;
+  }
+
   if (VolumeRenderer::supported(DvrParams::DVR_DEBUG))
   {
     typeCombo->insertItem(index,"Debug" );
@@ -39,6 +39,7 @@
 #include "session.h"
 #include "messagereporter.h"
 #include "transferfunction.h"
+#include "HistoBuilder.h"
 #include "loadtfdialog.h"
 #include "savetfdialog.h"
 #include <vector>
@@ -217,6 +218,21 @@ void EventRouter::refreshHistogram(RenderParams* renParams, int varNum, const fl
 	//Check if the region/resolution is too big:
 	  double exts[6];
 	  rParams->GetBox()->GetLocalExtents(exts, timeStep);
+	//Convert local extents to user extents
+	size_t ts = (size_t)timeStep;
+	const vector<double>& userExts = dataMgr->GetExtents(ts);
+	double userBox[6];
+	for (int i = 0; i<3; i++) {
+		userBox[i] = exts[i] + userExts[i];
+		userBox[i+3] = exts[i+3] + userExts[i];
+	}
+	//Reuse the histogram if it was already computed for this region and range:
+	HistoBuilder* histoBuilder = ds->getHistoBuilder();
+	vector<int> bins;
+	if (histoBuilder->Find(ts, varname, availRefLevel, lod, min_dim, max_dim, userBox, dRange, 256, bins)){
+		histogramList[varNum] = new Histo(bins, dRange[0], dRange[1]);
+		return;
+	}
 	  int numMBs = RegionParams::getMBStorageNeeded(exts, availRefLevel);
 	  int cacheSize = DataStatus::getInstance()->getCacheMB();
 	  if (numMBs > (int)(0.75*cacheSize)){
@@ -234,7 +250,6 @@ void EventRouter::refreshHistogram(RenderParams* renParams, int varNum, const fl
 	//Now get the data:
 	
 	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-	size_t ts = (size_t)timeStep;
 	RegularGrid* rg = dataMgr->GetGrid(
 		ts, varname, availRefLevel, lod, min_dim, max_dim, 1
 	);
@@ -250,14 +265,13 @@ void EventRouter::refreshHistogram(RenderParams* renParams, int varNum, const fl
 		ds->setDataMissing3D(timeStep, availRefLevel, lod, varNum);
 		return;
 	}
-	//Convert local extents to user extents
-	const vector<double>& userExts = dataMgr->GetExtents(ts);
-	for (int i = 0; i<3; i++) {
-		exts[i] += userExts[i];
-		exts[i+3] += userExts[i];
-	}
-	histogramList[varNum] = new Histo(rg, exts, dRange);
+	histogramList[varNum] = new Histo(rg, userBox, dRange, histoBuilder);
 	dataMgr->UnlockGrid(rg);
+	delete rg;
+	if (dRange[0] < dRange[1]) {
+		for (int i = 0; i<256; i++) bins.push_back(histogramList[varNum]->getBinSize(i));
+		histoBuilder->Insert(ts, varname, availRefLevel, lod, min_dim, max_dim, userBox, dRange, bins);
+	}
 	
 }
 //Obtain a 2D histogram for the current selected variables.
@@ -39,6 +39,7 @@
 #include <qspinbox.h>
 #include <qslider.h>
 #include <qlabel.h>
+#include <QFileDialog>
 
 #include "instancetable.h"
 #include "mappingframe.h"
@@ -165,6 +166,7 @@ IsoEventRouter::hookUpTab()
 	connect (loadButton, SIGNAL(clicked()), this, SLOT(isoLoadTF()));
 	connect (loadInstalledButton, SIGNAL(clicked()), this, SLOT(isoLoadInstalledTF()));
 	connect (saveButton, SIGNAL(clicked()), this, SLOT(isoSaveTF()));
+	connect (exportButton, SIGNAL(clicked()), this, SLOT(isoExportSurface()));
 	
 	connect (opacityScaleSlider, SIGNAL(valueChanged(int)), this, SLOT (guiSetOpacityScale(int)));
 	connect (ColorBindButton, SIGNAL(pressed()), this, SLOT(guiBindColorToOpac()));
@@ -446,6 +448,34 @@ void IsoEventRouter::isoSaveTF(){
 	if (iParams->GetMapVariableNum() < 0) return;
 	saveTF(iParams);
 }
+//Respond to user request to export the isosurface of the
+//current time step to a PLY or OBJ file
+//
+void IsoEventRouter::isoExportSurface(){
+	confirmText(false);
+	ParamsIso* iParams = (ParamsIso*)VizWinMgr::getInstance()->getApplicableParams(Params::_isoParamsTag);
+	RegionParams* rParams = (RegionParams*)VizWinMgr::getInstance()->getApplicableParams(Params::_regionParamsTag);
+	int timestep = VizWinMgr::getActiveAnimationParams()->getCurrentTimestep();
+	if (iParams->doBypass(timestep)){
+		MyBase::SetErrMsg(VAPOR_ERROR_DATA_UNAVAILABLE,"Unable to export isosurface");
+		return;
+	}
+	//Launch a file-save dialog
+	QString filename = QFileDialog::getSaveFileName(this,
+		"Specify file name for exporting the isosurface",
+		Session::getInstance()->getFlowDirectory().c_str(),
+		"PLY files (*.ply);;Wavefront OBJ files (*.obj)");
+	//Check that user did specify a file:
+	if (filename.isNull()) return;
+
+	//Errors are reported by the renderer
+	//
+	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+	IsoRenderer::ExportIsosurface(
+		iParams, rParams, (size_t) timestep, (const char*)filename.toAscii()
+	);
+	QApplication::restoreOverrideCursor();
+}
 //Respond to user request to load/save TF
 //Assumes name is valid
 //
@@ -103,6 +103,7 @@ protected slots:
 	void isoLoadTF();
 	void isoLoadInstalledTF();
 	void isoSaveTF();
+	void isoExportSurface();
 
 	void guiSetComboVarNum(int val);
 	void guiSetMapComboVarNum(int val);
@@ -888,6 +888,20 @@ resetMetadata(vector<string>& files, bool restoredSession,const string& importTy
 					dataMgr = 0;
 					return false;
 				}
+
+				//
+				// Model output has a single refinement level. Give it
+				// coarser levels, down to about 64 voxels along the
+				// longest axis, for interactive rendering.
+				//
+				if (dataMgr->GetNumTransforms() == 0) {
+					size_t dim[3];
+					dataMgr->GetDim(dim, -1);
+					size_t maxdim = MAX(dim[0], MAX(dim[1], dim[2]));
+					int ntransforms = 0;
+					while ((maxdim >> ntransforms) > 64) ntransforms++;
+					dataMgr->SetPyramid(ntransforms);
+				}
 			} else {
 				vector <string> metafiles;
 				metafiles.push_back(currentMetadataFile);
@@ -0,0 +1,187 @@
+//
+//      $Id$
+//
+
+#ifndef	_BlockSummary_h_
+#define	_BlockSummary_h_
+
+#include <vector>
+#include <string>
+#include <vapor/MyBase.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class BlockSummary
+//! \brief Per-block minimum, maximum and mean of a variable
+//!
+//! A BlockSummary partitions a volume, at one refinement level, into
+//! blocks and records the minimum, maximum, and mean of the
+//! valid (non-missing) values in each block, together with the number of
+//! valid values. Summaries are small (a few values per block) and may be
+//! used to answer data range queries, for the whole volume or any
+//! subregion, without reading any data. Ranges returned for a subregion
+//! are conservative: they are the union of the ranges of every block
+//! intersecting the region.
+//!
+//! Blocks are aligned with voxel coordinate zero of the refinement level.
+//! Only the blocks from GetBlockMin() through
+//! GetBlockMin() + GetBlockDims() - 1 are described; other blocks are
+//! taken to be empty. Two dimensional variables are summarized with a
+//! block size of one along their third dimension.
+//!
+//! A summary may be stored in, and restored from, a small binary file.
+//! The file records the dimensions of the volume summarized and a
+//! fingerprint of the data it was computed from (see SetSource()), so
+//! that readers can reject summaries of data that has since changed.
+//!
+//! \sa DataMgr::GetBlockSummary(), WaveCodecIO
+//
+class VDF_API BlockSummary : public VetsUtil::MyBase {
+
+public:
+
+ BlockSummary();
+ virtual ~BlockSummary() {}
+
+ //! Initialize an empty summary
+ //!
+ //! The source of the summary (see SetSource()) is not changed.
+ //!
+ //! \param[in] bs Block size, in voxels
+ //! \param[in] bmin Coordinates, in blocks, of the first block described
+ //! \param[in] bdim Number of blocks described along each axis
+ //
+ void Init(const size_t bs[3], const size_t bmin[3], const size_t bdim[3]);
+
+ //! Compute a summary from a grid
+ //!
+ //! The summary describes the blocks intersecting the grid. Voxels
+ //! equal to the grid's missing value (if the grid has missing data), and
+ //! NaNs, are ignored.
+ //!
+ //! \param[in] rg Grid to summarize. Voxel coordinates are
+ //! those returned by RegularGrid::GetIJKOrigin()
+ //! \param[in] bs Block size of the summary, in voxels. It need not be the
+ //! block size of the grid
+ //
+ void Compute(const RegularGrid *rg, const size_t bs[3]);
+
+ //! Set the statistics of one block
+ //!
+ //! Different blocks may be set concurrently from different threads.
+ //!
+ //! \param[in] bcoord Block coordinates. Blocks outside of the summary
+ //! are ignored.
+ //! \param[in] min,max,mean Statistics of the valid values in the block
+ //! \param[in] count Number of valid values in the block. If zero the
+ //! block is marked empty.
+ //
+ void SetBlock(
+	const size_t bcoord[3], float min, float max, float mean, size_t count
+ );
+
+ //! Return the statistics of one block
+ //!
+ //! \retval status Returns false if the block is empty or outside of
+ //! the summary, in which case the outputs are not modified.
+ //
+ bool GetBlock(
+	const size_t bcoord[3], float range[2], float *mean, size_t *count
+ ) const;
+
+ //! Return the range of all valid values
+ //!
+ //! \retval status Returns false, and sets \p range to (0,0), if the
+ //! summary contains no valid values.
+ //
+ bool GetRange(float range[2]) const;
+
+ //! Return a range bounding the valid values in a region
+ //!
+ //! \param[in] min,max Region bounds, in voxels
+ //! \param[out] range Union of the ranges of all non-empty blocks
+ //! intersecting the region
+ //!
+ //! \retval status Returns false, and sets \p range to (0,0), if the
+ //! region contains no valid values.
+ //
+ bool GetRange(
+	const size_t min[3], const size_t max[3], float range[2]
+ ) const;
+
+ //! Return the mean of all valid values
+ //
+ double GetMean() const;
+
+ //! Return the number of valid values
+ //
+ size_t GetCount() const;
+
+ void GetBlockSize(size_t bs[3]) const {
+	for (int i=0; i<3; i++) bs[i] = _bs[i];
+ }
+ void GetBlockMin(size_t bmin[3]) const {
+	for (int i=0; i<3; i++) bmin[i] = _bmin[i];
+ }
+ void GetBlockDims(size_t bdim[3]) const {
+	for (int i=0; i<3; i++) bdim[i] = _bdim[i];
+ }
+ size_t GetNumBlocks() const { return(_count.size()); }
+
+ //! Record the data a summary describes
+ //!
+ //! \param[in] dims Dimensions, in voxels, of the volume summarized, or
+ //! zeros if unknown
+ //! \param[in] fingerprint Fingerprint of the data the summary was
+ //! computed from (e.g. see VetsUtil::FileFingerprint()), or zero if
+ //! unknown
+ //
+ void SetSource(const size_t dims[3], unsigned long long fingerprint);
+
+ void GetDims(size_t dims[3]) const {
+	for (int i=0; i<3; i++) dims[i] = _dims[i];
+ }
+ unsigned long long GetFingerprint() const { return(_fingerprint); }
+
+ //! Write the summary to a file
+ //!
+ //! The file is written under a temporary name and renamed, so readers
+ //! never see a partially written summary.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Write(const std::string &path) const;
+
+ //! Read a summary written with Write()
+ //!
+ //! The file's size must match the number of blocks in its header, and
+ //! the blocks must lie within the recorded volume dimensions, if
+ //! any. It is up
+ //! to the caller to check that the dimensions and fingerprint (see
+ //! GetDims() and GetFingerprint()) are those of the data in hand.
+ //!
+ //! \retval status A negative int is returned if the file can not
+ //! be opened or is not a valid summary
+ //
+ int Read(const std::string &path);
+
+private:
+ size_t _bs[3];
+ size_t _bmin[3];
+ size_t _bdim[3];
+ size_t _dims[3];	// dimensions of the volume summarized
+ unsigned long long _fingerprint;	// fingerprint of the source data
+ std::vector <float> _min;
+ std::vector <float> _max;
+ std::vector <float> _mean;
+ std::vector <unsigned int> _count;
+
+ bool _index(const size_t bcoord[3], size_t *idx) const;
+};
+
+};
+
+#endif	//	_BlockSummary_h_
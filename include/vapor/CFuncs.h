@@ -26,6 +26,7 @@
 
 #include <cmath>
 #include <string>
+#include <vector>
 #include <vapor/common.h>
 
 
@@ -55,6 +56,50 @@ COMMON_API double GetTime();
 COMMON_API int    MkDirHier(const string &dir);
 COMMON_API void   DirName(const string &path, string &dir);
 
+//! Initial value of a hash computed with HashBytes() and HashString()
+//!
+const unsigned long long HashInit = 14695981039346656037ULL;
+
+//! Update a 64 bit FNV-1a hash with a block of bytes
+//!
+//! \param[in] data Bytes to hash
+//! \param[in] n Number of bytes
+//! \param[in] hash Hash of the data preceding \p data
+//! \retval hash The updated hash
+//!
+COMMON_API unsigned long long HashBytes(
+	const void *data, size_t n, unsigned long long hash = HashInit
+);
+
+//! Update a 64 bit FNV-1a hash with a string and its terminating null,
+//! so that {"ab", "c"} and {"a", "bc"} hash differently
+//!
+//! \sa HashBytes()
+//!
+COMMON_API unsigned long long HashString(
+	const string &s, unsigned long long hash = HashInit
+);
+
+//! Identify the version of a file by its modification time and size
+//!
+//! \param[in] path File path name
+//! \param[out] stamp A line of text that changes whenever the file is
+//! rewritten
+//! \retval status A negative int if the file can't be stat'ed
+//!
+COMMON_API int FileStamp(const string &path, string &stamp);
+
+//! Return a fingerprint of a set of files
+//!
+//! The fingerprint is a hash of the name and FileStamp() of each file,
+//! and changes whenever any of the files is rewritten. A file that
+//! doesn't exist contributes only its name.
+//!
+//! \param[in] paths File path names
+//! \retval fingerprint A 64 bit hash, never zero
+//!
+COMMON_API unsigned long long FileFingerprint(const vector <string> &paths);
+
 };
 
 #endif	// _CFuncs_h_
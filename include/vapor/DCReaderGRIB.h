@@ -22,6 +22,7 @@
 #define DCREADERGRIB_H
 #include "grib_api.h"
 #include <vapor/DCReader.h>
+#include <vapor/EasyThreads.h>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -58,9 +59,30 @@ class VDF_API DCReaderGRIB : public DCReader {
     	virtual int OpenVariableRead(size_t timestep, string varname, 
         	                          int reflevel=0, int lod=0);
 	 	virtual int CloseVariable() {//grib_handle_delete(h);
-								  fclose(_inFile); return 0;}
+								  if (_inFile) fclose(_inFile);
+								  _inFile = NULL; _inFileName.clear();
+								  return 0;}
+
+		//! Read the remaining levels of the currently opened variable.
+		//! The GRIB messages of a 3D variable's levels are read, and
+		//! reordered, concurrently, and decoded one at a time.
+		//
 	 	virtual int Read(float *values);
 	 	virtual int ReadSlice(float *slice);
+
+		//! Read a subregion of the currently opened variable. Only the
+		//! GRIB messages of the region's levels are decoded, as by Read().
+		//!
+		//! \param[in] min Minimum voxel coordinates of the region, X
+		//! fastest. \p min[2] is ignored for 2D variables.
+		//! \param[in] max Maximum voxel coordinates of the region
+		//! \param[out] region The region, X varying fastest
+		//!
+		//! \retval status A negative int is returned on failure
+		//
+		virtual int ReadRegion(
+			const size_t min[3], const size_t max[3], float *region
+		);
 	 	virtual bool VariableExists(size_t ts, string varname,
                                  int reflevel=0, int lod=0) const;     // not pure
 	 	virtual void GetLatLonExtents(size_t ts, double lon_exts[2],
@@ -94,6 +116,88 @@ class VDF_API DCReaderGRIB : public DCReader {
 
 		vector <double> GetZCoordsInMeters() const {return _vertCoordinates;}
 		void _LinearInterpolation(float* values);
+
+		//! Copy a decoded GRIB field into a slice
+		//!
+		//! \param[in] src The \p ni x \p nj values of the field, in the
+		//! order they are scanned
+		//! \param[in] iScanNeg True if points are scanned east to west
+		//! \param[in] jScanPos True if rows are scanned south to north
+		//! \param[in] divisor Values are divided by \p divisor
+		//! \param[out] dst The slice, X varying fastest and the first row
+		//! southernmost
+		//
+		static void ReorderField(
+			const double *src, int ni, int nj, bool iScanNeg, bool jScanPos,
+			double divisor, float *dst
+		);
+
+		//! Read the index of a GRIB file
+		//!
+		//! The keys of a file's records are kept in an index file, 
+		//! \p file + ".gidx", and reused while the file's modification 
+		//! time and size don't change. The "file" key of every record is
+		//! set to \p file, so that the index follows a file that is moved.
+		//!
+		//! \param[in] file Path to the GRIB file
+		//! \param[out] records The keys of the file's records
+		//!
+		//! \retval status A negative int is returned if there is no
+		//! index, or it is stale or malformed, leaving \p records empty. No
+		//! error message is set.
+		//
+		static int ReadIndex(
+			const string &file,
+			std::vector<std::map<std::string, std::string> > &records
+		);
+
+		//! Write the index of a GRIB file read by ReadIndex()
+		//!
+		//! Failing to write an index only costs the next run a scan of 
+		//! the file, so errors are ignored.
+		//!
+		//! \param[in] file Path to the GRIB file
+		//! \param[in] records The keys of the file's records. The "file"
+		//! key is not written.
+		//
+		static void WriteIndex(
+			const string &file,
+			const std::vector<std::map<std::string, std::string> > &records
+		);
+
+		// Decodes a share of the levels of a region
+		//
+		class ThreadObj {
+			public:
+				ThreadObj(
+					DCReaderGRIB *reader, int id,
+					const size_t min[3], const size_t max[3], float *region
+				);
+				~ThreadObj() {if (_fp) fclose(_fp);}
+				void RunThread();
+				int GetStatus() const {return _rc;}
+
+				// Error message of a failed thread, reported by
+				// _ReadLevels() on the calling thread
+				//
+				const string &GetErrMsg() const {return _errMsg;}
+
+			private:
+				DCReaderGRIB *_reader;
+				int _id;	// thread id
+				size_t _min[3];
+				size_t _max[3];
+				float *_region;
+				FILE *_fp;
+				string _fileName;
+				std::vector<double> _dvalues;
+				std::vector<unsigned char> _message;
+				std::vector<float> _slice;
+				int _rc;
+				string _errMsg;
+
+				int _Run();
+		};
 	
     private:
 		/////
@@ -108,6 +212,18 @@ class VDF_API DCReaderGRIB : public DCReader {
 		void Print1dVars();
 		double BarometricFormula(const double pressure) const;
 		int _InitCartographicExtents(string mapProj);
+
+		// Decode the message of level sliceNum of the opened variable
+		// into slice. fp and fileName cache the open GRIB file, message
+		// the message read and dvalues the decoded message, so each 
+		// thread passes its own.
+		//
+		int _ReadLevel(
+			int sliceNum, FILE *&fp, string &fileName,
+			std::vector<unsigned char> &message,
+			std::vector<double> &dvalues, float *slice
+		);
+		int _ReadLevels(const size_t min[3], const size_t max[3], float *region);
 		/////
 
 		struct MessageLocation {
@@ -184,6 +300,11 @@ class VDF_API DCReaderGRIB : public DCReader {
 
 		static int _openTS;   
 		FILE* _inFile;    
+		string _inFileName;
+		std::vector<unsigned char> _message;	// message, reused by ReadSlice()
+		std::vector<double> _dvalues;	// decoded message, reused by ReadSlice()
+		VetsUtil::EasyThreads _et;
+		int _nthreads;
 		grib_handle* h;
 		std::vector<double> _pressureLevels;
 		std::vector<double> _vertCoordinates;
@@ -209,6 +330,12 @@ class VDF_API DCReaderGRIB : public DCReader {
 				int _LoadRecord(string file, size_t offset);
 				int _LoadRecordKeys(const string file);	// loads only the keys that we need for vdc creation
 				int _VerifyKeys();					// verifies that key/values conform to our reqs
+
+				// Add the records of a file's index, or write the index of
+				// the records from first on (see DCReaderGRIB::ReadIndex())
+				//
+				int _ReadIndex(const string &file);
+				void _WriteIndex(const string &file, size_t first) const;
 				std::vector<std::map<std::string, std::string> > GetRecords() const {return _recordKeys;}
 				 int doWeIgnoreForecastTimes() {return _ignoreForecastTimes;}
 
@@ -129,6 +129,23 @@ public:
 
  virtual int Read(float *data);
 
+ //! Read a subregion of the currently opened variable
+ //!
+ //! Only the levels of the region, and the rows and columns of the
+ //! native grid needed to resample the region onto the lat-lon grid, are
+ //! read from the netCDF files.
+ //!
+ //! \param[in] min Minimum voxel coordinates of the region, X fastest.
+ //! \p min[2] is ignored for 2D variables.
+ //! \param[in] max Maximum voxel coordinates of the region
+ //! \param[out] region The region, X varying fastest
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ virtual int ReadRegion(
+	const size_t min[3], const size_t max[3], float *region
+ );
+
  virtual bool VariableExists(size_t ts, string varname, int i0=0, int i1=0) const {
 	if (IsVariableDerived(varname)) return (true);
     return(_ncdfc->VariableExists(ts, varname));
@@ -32,7 +32,14 @@ class VDF_API DCReaderWRF : public DCReader {
 
 public:
 
- DCReaderWRF(const std::vector <string> &files);
+ //! Read a collection of WRF output files
+ //!
+ //! \param[in] files The WRF output files
+ //! \param[in] lazyInit If true, the files are initialized with
+ //! NetCDFCollection::SetLazyInitialize(), which saves reading the
+ //! full header of every file of a large run
+ //
+ DCReaderWRF(const std::vector <string> &files, bool lazyInit = false);
 
  virtual ~DCReaderWRF();
 
@@ -133,6 +140,23 @@ public:
 
  virtual int Read(float *data);
 
+ //! Read a subregion of the currently opened variable
+ //!
+ //! Only the rows, columns and levels of the region are read from the
+ //! netCDF files. Staggered variables and the derived ELEVATION variable
+ //! are interpolated and computed on the region alone.
+ //!
+ //! \param[in] min Minimum voxel coordinates of the region, X fastest.
+ //! \p min[2] is ignored for 2D variables.
+ //! \param[in] max Maximum voxel coordinates of the region
+ //! \param[out] region The region, X varying fastest
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ virtual int ReadRegion(
+	const size_t min[3], const size_t max[3], float *region
+ );
+
  virtual bool VariableExists(size_t ts, string varname, int i0=0, int i1=0) const {
 	ts = _timeLookup[ts];
     return(_ncdfc->VariableExists(ts, varname));
@@ -166,6 +190,9 @@ private:
   virtual int Open(size_t ts);
   virtual int ReadSlice(float *slice, int );
   virtual int Read(float *buf, int );
+  virtual int ReadRegion(
+	size_t start[], size_t count[], float *region, int 
+  );
   virtual int SeekSlice(int offset, int whence, int );
   virtual int Close(int fd);
   virtual bool TimeVarying() const {return(true); };
@@ -181,8 +208,13 @@ private:
   float _grav;
   string _PHvar;
   string _PHBvar;
-  float *_PH;
+  bool _stag[3];	// PH and PHB staggered dimensions, slowest first
+  float *_PH;		// native slices
   float *_PHB;
+  std::vector <float> _PHregion;	// native hyperslabs
+  std::vector <float> _PHBregion;
+  SliceKernel _kernel;
+  SliceKernel _regionKernel;
   int _PHfd;
   int _PHBfd;
   size_t _num_ts;
@@ -202,6 +234,7 @@ private:
  NetCDFCollection *_ncdfc;
  float *_sliceBuffer;	// buffer for reading data
  int _ovr_fd;
+ string _ovr_varname;
  string _projString;
  Proj4API _proj4API;
  int _mapProj;
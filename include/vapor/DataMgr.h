@@ -17,6 +17,8 @@
 #include <vapor/LayeredGrid.h>
 #include <vapor/SphericalGrid.h>
 #include <vapor/StretchedGrid.h>
+#include <vapor/BlockSummary.h>
+#include <vapor/MultiResPyramid.h>
 
 namespace VAPoR {
 class PipeLine;
@@ -78,6 +80,11 @@ public:
  //
  int GetNumTransforms() const { return(_GetNumTransforms()); };
 
+ //! Return the size of the memory cache, in megabytes, as passed to
+ //! the constructor
+ //
+ size_t GetMemSize() const { return(_mem_size); };
+
  //! \copydoc GetCRatios()
  //
  virtual vector <size_t> GetCRatios() const { return( _GetCRatios()); }
@@ -247,6 +254,21 @@ public:
  //
  void	Clear();
 
+ //! Lock or unlock the DataMgr
+ //!
+ //! The methods that read data, or query or change the cache, hold a
+ //! recursive lock owned by the DataMgr while they run, so a DataMgr may
+ //! be used by several threads. Lock() and Unlock() make a sequence of
+ //! calls atomic. Each call to Lock() must be matched by a call to
+ //! Unlock() from the same thread.
+ //!
+ //! \note The data of a grid returned by GetGrid() remain valid only
+ //! while the grid is locked into the cache, if other threads may read
+ //! data.
+ //
+ void Lock() const;
+ void Unlock() const;
+
  //! Return the current data range as a two-element array
  //!
  //! This method returns the minimum and maximum data values
@@ -267,6 +289,76 @@ public:
 	int reflevel = 0, int lod = 0
  );
 
+ //! Return the block summary of a variable
+ //!
+ //! This method returns the per-block minimum, maximum, and mean of the
+ //! indicated time step and variable, which may be used to bound the
+ //! values of any subregion without reading data. The summary is taken
+ //! from memory or from a summary file (see _GetSummaryPath()) if
+ //! possible, and otherwise computed by reading the variable's valid
+ //! region. Newly computed summaries of native variables are saved
+ //! to a summary file, if one is defined. Summary files record the 
+ //! dimensions of the volume and a fingerprint of the data (see 
+ //! _GetSourceFingerprint()), and are ignored if either no longer match.
+ //!
+ //! GetDataRange() uses a summary already in memory in preference to
+ //! opening the variable, and reads or computes one only if the
+ //! derived class doesn't know the variable's range.
+ //!
+ //! \param[in] ts A valid time step between 0 and GetNumTimesteps()-1
+ //! \param[in] varname Name of variable 
+ //! \param[in] reflevel Refinement level requested
+ //! \param[in] lod Level of detail requested
+ //! \param[in] compute If false, only a summary in memory or in a summary
+ //! file is returned, and the variable is never read
+ //!
+ //! \retval summary A pointer to the summary, owned by this class and
+ //! valid until Clear() or PurgeVariable() are called, or NULL on failure
+ //!
+ //! \sa BlockSummary
+ //
+ const BlockSummary *GetBlockSummary(
+	size_t ts, const char *varname, int reflevel = 0, int lod = 0,
+	bool compute = true
+ );
+
+ //! Set the directory for block summary files
+ //!
+ //! Summaries computed by GetBlockSummary() are written to, and read
+ //! from, files in \p dir. If \p dir is empty (the default) summaries are
+ //! only kept in memory, unless the derived class provides its own
+ //! summary files (as VDC2 collections do). DataMgrFactory sets a
+ //! directory for the model output readers. Failure to read or write
+ //! summary files is not an error.
+ //!
+ //! \sa _GetSummaryPath()
+ //
+ void SetSummaryDir(const string &dir) { _summaryDir = dir; }
+ string GetSummaryDir() const { return(_summaryDir); }
+
+ //! Compute coarser refinement levels for data collections that have none
+ //!
+ //! Data collections read from model output (WRF, ROMS, MOM, GRIB files)
+ //! have a single refinement level. If \p ntransforms is positive they 
+ //! report \p ntransforms coarser levels, each halving the dimensions of 
+ //! the next finer one. The coarser levels of a variable are computed 
+ //! with a box filter the first time any of them is read, in one pass 
+ //! over the native data (see MultiResPyramid), and are then kept in 
+ //! the cache, whose memory they share with cached regions. If \p dir 
+ //! isn't empty they are also written to, and read from, files in 
+ //! \p dir, which record the fingerprint of the data (see 
+ //! _GetSourceFingerprint()) and are ignored once it no longer matches.
+ //! Failure to read or write these files is not an error.
+ //!
+ //! The cache is cleared. Data collections with refinement levels of 
+ //! their own ignore the pyramid.
+ //!
+ //! \param[in] ntransforms Number of coarser levels. Zero disables the
+ //! pyramid.
+ //! \param[in] dir Directory of pyramid files, or the empty string
+ //
+ void SetPyramid(int ntransforms, const string &dir = "");
+
  //! Return the valid region bounds for the specified region
  //!
  //! This method returns the minimum and maximum valid coordinate
@@ -834,6 +926,50 @@ protected:
  //!
  virtual const float *_GetDataRange() const { return(NULL);};
 
+ //! Return the path of the block summary file for a variable
+ //!
+ //! The default implementation returns a path in the directory set with
+ //! SetSummaryDir(), or the empty string (no summary file) if none
+ //! was set. Derived classes whose writers produce summaries (see
+ //! WaveCodecIO) may return the path of those instead.
+ //!
+ //! \param[in] ts A valid time step
+ //! \param[in] varname Name of a native variable
+ //! \param[in] reflevel Refinement level, not -1
+ //! \param[in] lod Level of detail, not -1
+ //!
+ //! \sa GetBlockSummary()
+ //
+ virtual string _GetSummaryPath(
+	size_t ts, const string &varname, int reflevel, int lod
+ ) const;
+
+ //! Return a fingerprint of the data of a variable
+ //!
+ //! The fingerprint is recorded in summary files, which are discarded
+ //! when it no longer matches. The default implementation returns
+ //! the fingerprint set with _SetSourceFingerprint(), or zero.
+ //!
+ //! \param[in] ts A valid time step
+ //! \param[in] varname Name of a native variable
+ //!
+ //! \sa VetsUtil::FileFingerprint(), BlockSummary::SetSource()
+ //
+ virtual unsigned long long _GetSourceFingerprint(
+	size_t ts, const string &varname
+ ) const {
+	return(_sourceFingerprint);
+ }
+
+ //! Set the fingerprint returned by _GetSourceFingerprint()
+ //!
+ //! Derived classes that read a fixed set of files may fingerprint them
+ //! all when constructed.
+ //
+ void _SetSourceFingerprint(unsigned long long fingerprint) {
+	_sourceFingerprint = fingerprint;
+ }
+
  //! Return the value of the missing data value
  //!
  //! This method returns the value of the missing data value for 
@@ -853,8 +989,10 @@ protected:
  //! Read in and return a subregion from the currently opened multiresolution
  //! data volume.
  //!
- //! The dimensions of the region are provided in block coordinates. However,
- //! the returned region is not blocked. 
+ //! The dimensions of the region are provided in block coordinates, and
+ //! the returned region is blocked: blocks are stored one after the other,
+ //! X varying fastest, and the voxels of each block likewise. For 2D 
+ //! variables the blocks have a single layer. 
  //! 
  //!
  //! \param[in] bmin Minimum region extents in block coordinates
@@ -875,6 +1013,94 @@ protected:
  //
  virtual int	_CloseVariable() = 0;
 
+ //! Largest block dimension of data collections whose files aren't 
+ //! blocked
+ //!
+ //! Such collections are read in regions made of blocks no larger than
+ //! this along each axis, so that only the parts of the files covered by 
+ //! a region are read.
+ //!
+ //! \sa _GetNativeBlockSize()
+ //
+ static const size_t NATIVE_BLOCK_SIZE = 64;
+
+ //! Return the block dimensions of a grid whose files aren't blocked
+ //!
+ //! \param[in] dim Grid dimensions
+ //! \param[out] bs \p dim clamped to NATIVE_BLOCK_SIZE
+ //
+ static void _GetNativeBlockSize(const size_t dim[3], size_t bs[3]);
+
+ //! Copy an unblocked region into the blocked layout returned by 
+ //! _BlockReadRegion()
+ //!
+ //! The region starts at a block corner. Voxels of partial blocks lying
+ //! past the region are given the value of the nearest region voxel.
+ //!
+ //! \param[in] region Region, X varying fastest
+ //! \param[in] dim Dimensions of \p region
+ //! \param[in] bs Block dimensions, with \p bs[2] one for 2D variables
+ //! \param[out] blks Blocks covering \p region
+ //
+ static void _CopyToBlocks(
+	const float *region, const size_t dim[3], const size_t bs[3], 
+	float *blks
+ );
+
+ //! Read an unblocked region of the currently opened variable at its
+ //! native refinement level
+ //!
+ //! Only data collections whose files aren't blocked implement this
+ //! method. They may then implement _BlockReadRegion() with
+ //! _BlockReadNativeRegion(), and get coarser refinement levels from 
+ //! SetPyramid().
+ //!
+ //! \param[in] min Minimum voxel coordinates of the region
+ //! \param[in] max Maximum voxel coordinates of the region
+ //! \param[out] region The region, X varying fastest
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ virtual int _ReadNativeRegion(
+	const size_t min[3], const size_t max[3], float *region
+ ) {
+	SetErrMsg("Not implemented");
+	return(-1);
+ }
+
+ //! Record the variable opened by _OpenVariableRead(), for 
+ //! _BlockReadNativeRegion()
+ //
+ void _SetNativeVariable(size_t ts, const string &varname, int reflevel);
+
+ //! Implement _BlockReadRegion() with _ReadNativeRegion()
+ //!
+ //! Regions of the native refinement level are read with 
+ //! _ReadNativeRegion(). Regions of coarser levels are copied from the
+ //! pyramid of the variable, which is built, or read from its file, on 
+ //! first access. Either way they are returned blocked.
+ //!
+ //! \sa SetPyramid(), _SetNativeVariable()
+ //
+ int _BlockReadNativeRegion(
+	const size_t bmin[3], const size_t bmax[3], float *blks
+ );
+
+ //! Return the number of coarser refinement levels set with SetPyramid()
+ //
+ int _GetPyramidTransforms() const { return(_pyramidTransforms); }
+
+ //! Return the dimensions of a refinement level of a data collection 
+ //! whose native grid has dimensions \p dim
+ //!
+ //! \sa SetPyramid(), MultiResPyramid::GetDim()
+ //
+ void _GetPyramidDim(
+	const size_t dim[3], int reflevel, size_t ldim[3]
+ ) const {
+	MultiResPyramid::GetDim(dim, _pyramidTransforms, reflevel, ldim);
+ }
+
 private:
 
  size_t _mem_size;
@@ -895,6 +1121,8 @@ private:
 
  BlkMemMgr	*_blk_mem_mgr;
 
+ void *_mutex;		// recursive mutex serializing access, see Lock()
+
  vector <PipeLine *> _PipeLines;
 
 
@@ -961,6 +1189,45 @@ private:
  VarInfoCache _VarInfoCache;
  std::map <size_t, vector <double> > _extentsCache;
 
+ //
+ // Block summaries, keyed by time step, variable, refinement level
+ // and lod
+ //
+ std::map <string, BlockSummary *> _summaryCache;
+ string _summaryDir;
+ unsigned long long _sourceFingerprint;
+
+ //
+ // Pyramids of coarser refinement levels, keyed by time step and 
+ // variable, most recently used last. Their levels are kept in blocks
+ // of the cache, so they compete with cached regions for its memory.
+ //
+ typedef struct {
+	string key;
+	MultiResPyramid *pyramid;
+	float *blks;
+ } pyramid_t;
+
+ int _pyramidTransforms;
+ string _pyramidDir;
+ std::list <pyramid_t> _pyramidList;
+
+ //
+ // Variable opened by _OpenVariableRead(), for _BlockReadNativeRegion()
+ //
+ size_t _nativeTS;
+ string _nativeVarname;
+ int _nativeReflevel;
+
+ MultiResPyramid *get_pyramid(size_t ts, const string &varname);
+ void free_pyramid(pyramid_t &pyramid);
+ void purge_pyramids(const string &varname);
+
+ BlockSummary *get_summary(
+	size_t ts, string varname, int reflevel, int lod, bool read, bool compute
+ );
+ void purge_summaries(const string &varname);
+
  float	*get_region_from_cache(
 	size_t ts,
 	string varname,
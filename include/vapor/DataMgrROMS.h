@@ -36,16 +36,20 @@ protected:
  //	Metadata methods
  //
 
- virtual void   _GetDim(size_t dim[3], int ) const {
-	return(DCReaderROMS::GetGridDim(dim));
+ virtual void   _GetDim(size_t dim[3], int reflevel) const {
+	size_t native[3];
+	DCReaderROMS::GetGridDim(native);
+	DataMgr::_GetPyramidDim(native, reflevel, dim);
  };
 
  virtual void _GetBlockSize(size_t bs[3], int reflevel) const {
-	return(DCReaderROMS::GetGridDim(bs));
+	size_t dim[3];
+	DCReaderROMS::GetGridDim(dim);
+	DataMgr::_GetNativeBlockSize(dim, bs);
  }
 
  virtual int _GetNumTransforms() const {
-	return(0);
+	return(DataMgr::_GetPyramidTransforms());
  };
 
  virtual string _GetGridType() const { 
@@ -109,9 +113,10 @@ protected:
  virtual int    _OpenVariableRead(
     size_t timestep,
     const char *varname,
-    int,
+    int reflevel,
     int
  ) {
+	DataMgr::_SetNativeVariable(timestep, varname, reflevel);
 	return(DCReaderROMS::OpenVariableRead(timestep, varname));
  };
 
@@ -120,9 +125,9 @@ protected:
  }
 
  virtual void _GetValidRegion(
-    size_t min[3], size_t max[3], int 
+    size_t min[3], size_t max[3], int reflevel
  ) const {
-	size_t dim[3]; DCReaderROMS::GetGridDim(dim);
+	size_t dim[3]; _GetDim(dim, reflevel);
 	min[0] = min[1] = min[2] = 0;
 	max[0] = dim[0]-1; max[1] = dim[1]-1; max[2] = dim[2]-1;
  };
@@ -133,9 +138,15 @@ protected:
 
 
  virtual int    _BlockReadRegion(
-    const size_t *, const size_t *, float *region
+    const size_t bmin[3], const size_t bmax[3], float *blks
  ) {
-	return(DCReaderROMS::Read(region));
+	return(DataMgr::_BlockReadNativeRegion(bmin, bmax, blks));
+ };
+
+ virtual int _ReadNativeRegion(
+	const size_t min[3], const size_t max[3], float *region
+ ) {
+	return(DCReaderROMS::ReadRegion(min, max, region));
  };
 
  virtual int    _CloseVariable() {
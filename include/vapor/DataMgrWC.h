@@ -166,6 +166,25 @@ protected:
 	return(WaveCodecIO::GetDataRange());
  }
 
+ //
+ // Summaries written by WaveCodecIO describe the native data. Use
+ // them at any lod, as with _GetDataRange().
+ //
+ virtual string _GetSummaryPath(
+	size_t ts, const string &varname, int reflevel, int lod
+ ) const {
+	if (reflevel == WaveCodecIO::GetNumTransforms()) {
+		return(WaveCodecIO::GetBlockSummaryPath(ts, varname));
+	}
+	return(DataMgr::_GetSummaryPath(ts, varname, reflevel, lod));
+ }
+
+ virtual unsigned long long _GetSourceFingerprint(
+	size_t ts, const string &varname
+ ) const {
+	return(WaveCodecIO::GetDataFingerprint(ts, varname));
+ }
+
  virtual bool _GetMissingValue(string varname, float &value) const;
 
 
@@ -0,0 +1,189 @@
+//	File:		FlowMap.h
+//
+//	Description:	Dense flow map and finite-time Lyapunov exponent
+//					(FTLE) computation. Unlike the rake based tracers
+//					in VaporFlow only the end position of each seed
+//					is retained, so that a seed may be placed at every
+//					point of a 3D lattice.
+//
+
+#ifndef	_FlowMap_h_
+#define	_FlowMap_h_
+
+#include <string>
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/DataMgr.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class FlowMap
+//! \brief Dense-seeding flow map and FTLE engine
+//!
+//! This class advects one seed per grid point of a lattice through a
+//! steady vector field for a fixed integration time using a fourth
+//! order Runge-Kutta scheme with a fixed number of steps. Only the final
+//! position of each seed is stored (three floats per seed), from which
+//! the finite-time Lyapunov exponent field may be computed.
+//!
+//! Seeds are processed in tiles matching the block decomposition of
+//! the lattice so that neighboring trajectories, which sample the same
+//! region of the vector field, are advected together. Tiles are
+//! distributed across threads.
+//!
+//! Seeds that leave the domain, or enter a region of missing data,
+//! are frozen at their last valid position.
+//
+class FLOW_API FlowMap : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ FlowMap(int nthreads = 0);
+ virtual ~FlowMap();
+
+ //! Set the integration time, in user time units. A negative
+ //! value integrates backward in time.
+ //
+ void SetIntegrationTime(double t) { _integrationTime = t; }
+ double GetIntegrationTime() const { return(_integrationTime); }
+
+ //! Set the number of fixed size Runge-Kutta steps taken by each seed
+ //
+ void SetNumSteps(int n) { _numSteps = n < 1 ? 1 : n; }
+ int GetNumSteps() const { return(_numSteps); }
+
+ //! Compute the flow map
+ //!
+ //! Advects a seed located at each grid point of \p lattice through
+ //! the field (\p u, \p v, \p w). Any of the field components may be
+ //! NULL, in which case the component is taken to be zero. The
+ //! lattice may be dataless: only its coordinates are used.
+ //!
+ //! \param[out] endpos Array of 3*nx*ny*nz floats, where nx, ny, nz
+ //! are the dimensions of \p lattice, receiving the final position
+ //! of each seed with the \a I axis varying fastest. A seed that does
+ //! not start in a valid region of the field is assigned
+ //! END_FLOW_FLAG.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Advect(
+	const RegularGrid *u, const RegularGrid *v, const RegularGrid *w,
+	const RegularGrid *lattice, float *endpos
+ );
+
+ //! Compute the finite-time Lyapunov exponent field
+ //!
+ //! Computes the flow map with seeds at every grid point of \p ftle
+ //! and stores in \p ftle the largest FTLE,
+ //! ln(sqrt(lambda_max(C)))/|T|, where C is the Cauchy-Green
+ //! deformation tensor of the flow map and T is the integration time.
+ //! Grid points whose flow map gradient can not be evaluated are
+ //! assigned the missing value of \p ftle if it has one, zero
+ //! otherwise.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int ComputeFTLE(
+	const RegularGrid *u, const RegularGrid *v, const RegularGrid *w,
+	RegularGrid *ftle
+ );
+
+ class ThreadObj {
+ public:
+	ThreadObj(FlowMap *fm, int id) { _fm = fm; _id = id; }
+	void AdvectThread();
+	void FTLEThread();
+ private:
+	FlowMap *_fm;
+	int _id;	// thread id
+	void _velocity(const double p[3], double vel[3], bool *valid) const;
+ };
+
+private:
+ double _integrationTime;
+ int _numSteps;
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+
+ //
+ // State shared by the thread objects for the current operation
+ //
+ const RegularGrid *_ugrid, *_vgrid, *_wgrid;
+ const RegularGrid *_lattice;
+ RegularGrid *_ftleGrid;
+ float *_endpos;
+ size_t _dims[3];	// lattice dimensions
+ size_t _tileDims[3];	// tile dimensions (lattice block size)
+ size_t _ntiles[3];	// number of tiles along each axis
+
+ void _setLattice(const RegularGrid *lattice);
+ int _run(void *(*start)(void *));
+};
+
+//
+//! \class FTLEPipeLine
+//! \brief A DataMgr pipeline stage deriving an FTLE variable
+//!
+//! Once registered with DataMgr::NewPipeline() the output variable
+//! may be requested with DataMgr::GetGrid() like any other variable.
+//! The flow map is computed on the requested region, refinement level
+//! and lod using the region's steady vector field. DataMgr reads the
+//! field at the requested time step and lod. The grid spacing doubles
+//! with each coarser refinement level, and so does the Runge-Kutta step
+//! size, so that the number of steps taken by a seed per grid cell is
+//! the same at every level.
+//
+class FLOW_API FTLEPipeLine : public PipeLine {
+public:
+
+ //! \param[in] name Name of the pipeline stage
+ //! \param[in] xvar Name of x component of the field, or "0"
+ //! \param[in] yvar Name of y component of the field, or "0"
+ //! \param[in] zvar Name of z component of the field, or "0"
+ //! \param[in] outvar Name of the derived 3D FTLE variable
+ //! \param[in] integrationTime Signed integration time in user time units
+ //! \param[in] numSteps Number of Runge-Kutta steps per seed at the
+ //! finest refinement level
+ //! \param[in] numTransforms The finest refinement level, as returned by
+ //! DataMgr::GetNumTransforms(). If negative \p numSteps are taken at
+ //! every level.
+ //
+ FTLEPipeLine(
+	string name, string xvar, string yvar, string zvar, string outvar,
+	double integrationTime, int numSteps, int numTransforms = -1
+ );
+ virtual ~FTLEPipeLine() {}
+
+ virtual int Calculate (
+	vector <const RegularGrid *> input_grids,
+	vector <RegularGrid *> output_grids,
+	size_t ts,
+	int reflevel,
+	int lod
+ );
+
+ //! Return the number of Runge-Kutta steps taken at refinement level
+ //! \p reflevel
+ //
+ int GetNumSteps(int reflevel) const;
+
+private:
+ vector <bool> _zeroComponent;	// true if component i is "0"
+ double _integrationTime;
+ int _numSteps;
+ int _numTransforms;
+
+ static vector <string> _inputs(string xvar, string yvar, string zvar);
+ static vector <pair <string, DataMgr::VarType_T> > _outputs(string outvar);
+};
+
+};
+
+#endif	// _FlowMap_h_
@@ -19,6 +19,16 @@
 //! The remaining x and y coordinates are givey by (i*dx, j*dy)
 //! for some real dx and dy .
 //!
+//! To speed up point location the varying dimension coordinates are
+//! copied into one contiguous array per column of grid points (a column
+//! being the grid points sharing the same non-varying indecies), along
+//! with the minimum and maximum coordinate of each column. The tables
+//! are built on the first point location query, not by the constructor,
+//! and missing coordinates are replaced in them as by GetUserCoordinates().
+//! Each thread's searches along the varying dimension first try the cell
+//! found by that thread's previous search.
+//! The additional storage is reported by GetLocatorMemSize().
+//!
 //
 
 namespace VAPoR {
@@ -179,12 +189,33 @@ public:
  //!
  float **GetCoordBlks() const { return(_coords); };
 
+ //! Return the size in bytes of the point location tables (per-column
+ //! coordinates and bounds) maintained in addition to the coordinate
+ //! blocks. Zero until the tables are built by the first point location
+ //! query.
+ //!
+ size_t GetLocatorMemSize() const;
+
 
 private:
  float **_coords;
  int _varying_dim;
  double _extents[6];
 
+ //
+ // Point location tables. Column (a,b), where a and b are the indecies
+ // of the first and second non-varying dimension, starts at
+ // coords + (b*_colDims[0] + a) * _colDims[2]
+ //
+ struct ColumnTable {
+	float *coords;	// varying coordinate of each grid point, by column
+	float *cmin;	// minimum coordinate of each column
+	float *cmax;	// maximum coordinate of each column
+ };
+ mutable ColumnTable *volatile _colTable;	// NULL until first needed
+ size_t _colDims[3];	// # of columns along a and b, # of points per column
+ int _colAxes[2];	// non-varying dimensions a and b
+
  void _GetUserExtents(double extents[6]) const;
  void _GetBoundingBox(
     const size_t min[3],
@@ -198,6 +229,29 @@ private:
 	double x, double y, double z 
  ) const;
 
+ void _SetColumnDims();
+ const ColumnTable *_GetColumns() const;
+ ColumnTable *_BuildColumns() const;
+ void _FreeColumns();
+ void _GetColumnStencil(
+	size_t i0, size_t j0, size_t k0,
+	double x, double y, double z,
+	const float *cols[4], double *iwgt, double *jwgt
+ ) const;
+ size_t _FindLevel(
+	const float *const cols[4], double iwgt, double jwgt, double vc
+ ) const;
+
+ static double _columnCoord(
+	const float *const cols[4], double iwgt, double jwgt, size_t l
+ ) {
+	double c00 = cols[0][l];
+	double c01 = cols[1][l];
+	double c10 = cols[2][l];
+	double c11 = cols[3][l];
+	return(c00+iwgt*(c01-c00) + jwgt*((c10+iwgt*(c11-c10))-(c00+iwgt*(c01-c00))));
+ }
+
 };
 };
 #endif
@@ -0,0 +1,174 @@
+//
+//      $Id$
+//
+
+#ifndef	_MultiResPyramid_h_
+#define	_MultiResPyramid_h_
+
+#include <vector>
+#include <string>
+#include <vapor/MyBase.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class MultiResPyramid
+//! \brief Coarser refinement levels of a volume computed with a box filter
+//!
+//! A MultiResPyramid holds the refinement levels 0 through
+//! \p ntransforms - 1 of a volume whose native resolution is refinement
+//! level \p ntransforms. Each level halves the dimensions of the next
+//! finer one, rounding up: a voxel is the mean of the (up to) 2x2x2
+//! voxels of the finer level it covers. Missing values are left out of
+//! the mean, and a voxel covering only missing values is missing. Two
+//! dimensional variables are handled as volumes one voxel deep.
+//!
+//! The pyramid is built in a single streaming pass over the native
+//! volume: slabs of GetSlabDepth() XY planes are handed to AddSlab(),
+//! bottom to top, and are not kept.
+//!
+//! A pyramid may be stored in, and restored from, a binary file, which
+//! records the fingerprint of the data it was built from (see
+//! SetFingerprint()).
+//!
+//! \sa DataMgr::SetPyramid()
+//
+class VDF_API MultiResPyramid : public VetsUtil::MyBase {
+
+public:
+
+ MultiResPyramid();
+ virtual ~MultiResPyramid();
+
+ //! Return the dimensions of a refinement level
+ //!
+ //! \param[in] dim Dimensions of the native volume
+ //! \param[in] ntransforms Refinement level of the native volume
+ //! \param[in] reflevel Refinement level. A value outside of
+ //! 0..\p ntransforms selects the native level.
+ //! \param[out] ldim Dimensions of level \p reflevel
+ //
+ static void GetDim(
+	const size_t dim[3], int ntransforms, int reflevel, size_t ldim[3]
+ );
+
+ //! Return the memory needed by the coarse levels of a volume, in bytes
+ //!
+ //! \param[in] dim Dimensions of the native volume
+ //! \param[in] ntransforms Number of coarser levels
+ //
+ static size_t GetNumBytes(const size_t dim[3], int ntransforms);
+
+ //! Prepare an empty pyramid
+ //!
+ //! \param[in] dim Dimensions of the native volume
+ //! \param[in] ntransforms Number of coarser levels
+ //! \param[in] has_missing True if the volume has missing values
+ //! \param[in] mv The missing value
+ //! \param[in] storage If not NULL, GetNumBytes(\p dim, \p ntransforms)
+ //! bytes of memory, owned by the caller, in which the levels are kept.
+ //! Otherwise the pyramid allocates its own.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Init(
+	const size_t dim[3], int ntransforms, bool has_missing = false,
+	float mv = 0.0, float *storage = NULL
+ );
+
+ //! Record the fingerprint of the data the pyramid is built from
+ //!
+ //! The fingerprint is written by Write(), and Read() rejects files 
+ //! whose fingerprint differs.
+ //!
+ //! \param[in] fingerprint Fingerprint of the native volume (e.g. see 
+ //! VetsUtil::FileFingerprint()), or zero if unknown
+ //
+ void SetFingerprint(unsigned long long fingerprint) {
+	_fingerprint = fingerprint;
+ }
+ unsigned long long GetFingerprint() const { return(_fingerprint); }
+
+ //! Return the number of XY planes of the slabs expected by AddSlab(),
+ //! 2 raised to the power \p ntransforms
+ //
+ size_t GetSlabDepth() const { return((size_t) 1 << _ntransforms); }
+
+ //! Filter the next slab of the native volume into the pyramid
+ //!
+ //! \param[in] slab GetSlabDepth() XY planes of the native volume,
+ //! X varying fastest, or fewer for the last slab
+ //! \param[in] nz Number of planes in \p slab
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int AddSlab(const float *slab, size_t nz);
+
+ //! Return true once every plane of the native volume has been added
+ //
+ bool IsComplete() const {
+	return(_ntransforms > 0 && _nextz == _dim[2]);
+ }
+
+ //! Copy a region of a coarse level
+ //!
+ //! \param[in] reflevel Refinement level, 0..\p ntransforms - 1
+ //! \param[in] min Minimum voxel coordinates of the region
+ //! \param[in] max Maximum voxel coordinates of the region
+ //! \param[out] region The region, X varying fastest
+ //!
+ //! \retval status A negative int is returned if the pyramid isn't
+ //! complete or the region is invalid
+ //
+ int GetRegion(
+	int reflevel, const size_t min[3], const size_t max[3], float *region
+ ) const;
+
+ int GetNumTransforms() const { return(_ntransforms); }
+
+ //! Return the memory used by the coarse levels, in bytes
+ //
+ size_t GetNumBytes() const {
+	return(_ntransforms ? GetNumBytes(_dim, _ntransforms) : 0);
+ }
+
+ //! Write a complete pyramid to a file
+ //!
+ //! The file is written under a temporary name and renamed, so readers
+ //! never see a partially written pyramid.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Write(const std::string &path) const;
+
+ //! Read a pyramid written with Write()
+ //!
+ //! \retval status A negative int is returned if the file can not
+ //! be opened or is not a valid pyramid for the volume given to Init()
+ //! and the fingerprint given to SetFingerprint()
+ //
+ int Read(const std::string &path);
+
+private:
+ size_t _dim[3];
+ int _ntransforms;
+ bool _has_missing;
+ float _mv;
+ unsigned long long _fingerprint;
+ size_t _nextz;		// next native plane expected by AddSlab()
+ std::vector <float *> _levels;	// coarsest first, within _storage
+ float *_storage;
+ bool _ownStorage;
+
+ MultiResPyramid(const MultiResPyramid &);
+ MultiResPyramid &operator=(const MultiResPyramid &);
+
+ void _reduce(
+	const float *src, const size_t sdim[3], float *dst, const size_t ddim[2]
+ ) const;
+};
+
+};
+
+#endif	//	_MultiResPyramid_h_
@@ -243,6 +243,28 @@ public:
 	bool prev = Enabled; Enabled = enable; return (prev);
  };
 
+ //! Divert the error messages of the calling thread
+ //!
+ //! The error message, code and callbacks are shared by all threads.
+ //! While diverted, SetErrMsg() called by the calling thread only
+ //! records the message for that thread, to be retrieved with
+ //! GetThreadErrMsg(), and SetDiagMsg() does nothing. Worker threads
+ //! use this to leave error reporting to the thread that started them.
+ //!
+ //! \param[in] divert Boolean flag to divert or restore error messages
+ //! \retval previous The previous setting
+ //!
+ //! \sa GetThreadErrMsg()
+ //
+ static bool DivertThreadErrMsg(bool divert);
+
+ //! Return the last error message recorded by the calling thread while
+ //! its messages were diverted, or an empty string
+ //!
+ //! \sa DivertThreadErrMsg()
+ //
+ static const char *GetThreadErrMsg();
+
  // N.B. the error codes/messages are stored in static class members!!!
  static char 	*ErrMsg;
  static int	ErrCode;
@@ -263,6 +285,7 @@ protected:
 
 private:
 	static void	_SetErrMsg(char **msg,int *sz,const char *format, va_list args);
+	static bool	_ThreadErrMsg(const char *format, va_list args);
 	string _className;	// name of class
 
 };
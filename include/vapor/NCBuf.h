@@ -1,14 +1,26 @@
-
-
 #ifndef	_NCBuf_h_
 #define	_NCBuf_h_
 
 #include <vector>
 #include <sstream>
+#if !defined(WIN32) && !defined(PNETCDF)
+#define	NCBUF_ASYNC
+#include <pthread.h>
+#endif
 #include <vapor/MyBase.h>
 
 namespace VAPoR {
 
+//
+// Buffers the writes of a netCDF variable. Writes of contiguous regions
+// that follow each other on disk are combined, and so are runs of them
+// that are rows of a hyperslab (e.g. the blocks of a sub-region).
+//
+// A full buffer is written by a background thread while the caller fills
+// a second one. An error from a background write is returned by the next
+// call. The netCDF library isn't thread safe: NCBuf serializes its own
+// writes, but other netCDF calls must wait for Wait() to return.
+//
 class VDF_API NCBuf : public VetsUtil::MyBase {
 public:
 
@@ -19,38 +31,87 @@ public:
  ~NCBuf();
 
  int PutVara(
-	const size_t start[], const size_t count[], 
+	const size_t start[], const size_t count[],
 	const void *data
  );
 
+ // Write the buffered data, and wait for the writes to complete
+ //
  int Flush();
 
+ // Wait for background writes to complete. The buffered data isn't
+ // written.
+ //
+ int Wait();
+
+ // Accumulated time, in seconds, spent in netCDF writes, in the
+ // background or not
+ //
+ double GetFlushTimer() const;
+
 private:
+
+ //
+ // A region of _flushbuf to write
+ //
+ class region {
+ public:
+  std::vector <size_t> start;
+  std::vector <size_t> count;
+  size_t offset;	// byte offset of the region's data
+ };
+
  int _ncid;
  int _varid;
- unsigned char *_buf;
+ unsigned char *_buf;	// buffer being filled
+ unsigned char *_flushbuf;	// buffer being written in the background
  size_t _bufsize;	// size of _buf in bytes
  size_t _bufcount; // num bytes in _buf
- size_t *_start;
- size_t *_count;
+ size_t *_start;	// coordinates of the first element in _buf
+ int _rowdim;	// dimension rows are stacked along, or -1 for one run
+ size_t _rowlen;	// elements per row
  std::vector <size_t> _dims;
  int _xtype;
  size_t _elem_size;
  bool _collective;
  int _rank;
+ std::vector <region> _regions;	// regions of _flushbuf
+ int _status;	// first error of a background write
+ double _flushTimer;
+ bool _pending;	// _regions are being written
+ bool _shutdown;
+ bool _threaded;
+
+#ifdef	NCBUF_ASYNC
+ pthread_t _worker;
+ pthread_mutex_t _lock;	// protects _pending, _status and _shutdown
+ pthread_cond_t _changed;
+public:
+ void _RunWorker();
+private:
+#endif
 
  bool contiguous(const size_t count[]);
  void linearize(
 	const size_t start[], const size_t count[], size_t *lstart, size_t *lcount
- ); 
- void inc_count(size_t lcount);
-
- void delinearize(size_t lcount, size_t count[]);
-
+ ) const;
+ size_t stride(int dim) const;
+ size_t box(const size_t start[], size_t n, size_t count[]) const;
  size_t max_reg( const size_t start[]);
 
- 
+ bool _Append(const size_t start[], size_t lstart, size_t lcount);
+ void _AddRun(
+	const size_t start[], size_t n, size_t offset,
+	std::vector <region> &regions
+ ) const;
+ int _Submit();
+ int _WriteRegions(const unsigned char *buf);
+ int _Put(
+	const size_t start[], const size_t count[], const void *data,
+	bool buffered
+ );
 };
 
 };
 #endif
+
@@ -409,6 +409,8 @@ private:
   string _depth_cvar;
   bool _is_open;
   bool _ok;
+
+  void _Slice(size_t z, float *slice) const;
  };
 
  class DerivedVar_ocean_s_coordinate_g2 : public NetCDFCollection::DerivedVar {
@@ -448,6 +450,8 @@ private:
   string _depth_cvar;
   bool _is_open;
   bool _ok;
+
+  void _Slice(size_t z, float *slice) const;
  };
 
 
@@ -482,7 +486,7 @@ public:
                    const float   P0,           float** HYBA,         float** HYBB,
                    const int     KLEV,   const int     MLON,   const int     MLON2,
                          float** HYPDLN,       float** HYALPH, float** PTERM,
-                   float** ZSLICE);
+                   float** ZSLICE,       float** PMLN);
   std::vector <size_t> _dims;
   std::vector <string> _dimnames;
   size_t _slice_num;
@@ -8,10 +8,12 @@
 
 #include <vector>
 #include <map>
+#include <list>
 
 #include <sstream>
 #include <vapor/MyBase.h>
 #include <vapor/NetCDFSimple.h>
+#include <vapor/SliceKernel.h>
 
 namespace VAPoR {
 
@@ -705,6 +707,82 @@ public:
 	_missingValAttName = attname;
  }
 
+ //! Bound the number of netCDF files kept open
+ //!
+ //! A netCDF file is opened when a variable in it is first read, and 
+ //! is kept open, and shared by all variables, so that later reads 
+ //! don't reopen it. Once more than \p n files are open the least 
+ //! recently used files with no open variables are closed. The default
+ //! is 32.
+ //!
+ //! \param n Maximum number of open files, at least one
+ //
+ virtual void SetMaxOpenFiles(size_t n);
+
+ //! Return the number of netCDF files currently open
+ //!
+ //! \sa SetMaxOpenFiles()
+ //
+ size_t GetNumOpenFiles() const;
+
+ //! Set the size of the slice read-ahead buffer
+ //!
+ //! When consecutive slices of a 3D variable are read with ReadSlice()
+ //! or ReadSliceNative() the following slices are read along with the 
+ //! current one, in a single request of at most \p nbytes bytes, and 
+ //! are returned by the next calls. The default is 16 MB. Zero disables
+ //! read-ahead.
+ //!
+ //! \param nbytes Size of the read-ahead buffer of each open variable
+ //
+ virtual void SetReadAhead(size_t nbytes) { _readAheadSize = nbytes; }
+
+ //! Set the size of the buffer used to unstagger hyperslabs
+ //!
+ //! Read(start, count) reads the native hyperslab of a staggered
+ //! variable a chunk of Z slices at a time, into a buffer of at most
+ //! \p nbytes bytes, unless a single slice (or pair of slices, for
+ //! variables staggered along Z) is larger. The default is 8 MB.
+ //!
+ //! \param nbytes Size of the hyperslab buffer of each open variable
+ //
+ virtual void SetRegionBuffer(size_t nbytes) { _regionBufSize = nbytes; }
+
+ //! Initialize the collection from a single representative file
+ //!
+ //! If \p enable is true, Initialize() reads the full header of the 
+ //! first file only. The other files are checked to define the same
+ //! dimensions, variables and attributes, and share its header, and
+ //! only their dimension lengths and time coordinate variables are 
+ //! kept. A file that fails the check is read in full, so the
+ //! collection is the same as without lazy initialization. The default
+ //! is false.
+ //!
+ //! Must be called before Initialize()
+ //!
+ //! \param enable Enable lazy initialization
+ //!
+ //! \sa SetManifestDir()
+ //
+ virtual void SetLazyInitialize(bool enable) { _lazyInit = enable; }
+
+ //! Set the directory of collection manifests
+ //!
+ //! With lazy initialization enabled, the dimension lengths and time
+ //! coordinates read from each file of a collection are saved to a
+ //! manifest file in \p dir, and Initialize() reads them back instead 
+ //! of opening the files that haven't changed since. An empty string 
+ //! disables manifests. The default is the value of the 
+ //! VAPOR_NC_MANIFEST_DIR environment variable, if set.
+ //!
+ //! Must be called before Initialize()
+ //!
+ //! \param dir Directory to store manifests in, created if necessary
+ //!
+ //! \sa SetLazyInitialize()
+ //
+ virtual void SetManifestDir(const string &dir) { _manifestDir = dir; }
+
  //! Return a list of variables that are not available for access
  //!
  //! This method returns a list of variables that were detected in the
@@ -779,6 +857,15 @@ public:
   virtual int Open(size_t ts) = 0;
   virtual int ReadSlice(float *slice, int fd) = 0;
   virtual int Read(float *buf, int fd) = 0;
+
+  //! Read the hyperslab defined by \p start and \p count, given in
+  //! unstaggered coordinates for the spatial dimensions only. The
+  //! default implementation reads the slices spanned by the hyperslab
+  //! and crops them.
+  //
+  virtual int ReadRegion(
+	size_t start[], size_t count[], float *region, int fd
+  );
   virtual int SeekSlice(int offset, int whence, int fd) = 0;
   virtual int Close(int fd) { return(0); };
   virtual bool TimeVarying() const = 0;
@@ -822,6 +909,18 @@ private:
  std::vector <string> _failedVars;	// Varibles that could not be added
  std::map <string, DerivedVar *> _derivedVarsMap;
  DerivedVar * _derivedVar; // if current opened variable is derived this is it
+ std::list <NetCDFSimple *> _openFiles;	// least recently used first
+ size_t _maxOpenFiles;
+ size_t _readAheadSize;
+ size_t _regionBufSize;
+ bool _lazyInit;
+ string _manifestDir;
+
+ //
+ // Time coordinate values read while initializing the files, for
+ // each file and time coordinate variable
+ //
+ std::map <string, std::map <string, std::vector <double> > > _tcvValues;
 
  // 
  // file handle for an open variable
@@ -839,15 +938,48 @@ private:
   size_t _slicebufsz;
   unsigned char *_linebuf;
    size_t _linebufsz;
+  SliceKernel _kernel;	// unstaggers the slices read by ReadSlice()
+  SliceKernel _regionKernel;	// unstaggers the hyperslabs read by Read()
   TimeVaryingVar _tvvars;
   bool _has_missing;
   double _missing_value;
+  float *_rabuf;		// slices read ahead
+  size_t _rabufsz;
+  int _ra_first;		// first slice in _rabuf
+  int _ra_count;		// number of slices in _rabuf
+  int _last_slice;		// last slice read by ReadSliceNative()
  };
  //
  // Open file data
  //
  std::map<int, NetCDFCollection::fileHandle> _ovr_table;
 
+ int _InitializeFiles(
+	const std::vector <string> &files,
+	const std::vector <string> &time_dimnames,
+	const std::vector <string> &time_coordvars
+ );
+
+ void _ReadTimeCoords(
+	const string &file, const std::vector <string> &time_coordvars
+ );
+
+ string _ManifestPath(
+	const std::vector <string> &files,
+	const std::vector <string> &time_dimnames,
+	const std::vector <string> &time_coordvars
+ ) const;
+
+ int _ReadManifest(
+	const string &path, const std::vector <string> &files,
+	std::vector <int> &status, std::vector <std::vector <size_t> > &dims
+ );
+
+ void _WriteManifest(
+	const string &path, const std::vector <string> &files,
+	const std::vector <int> &status
+ ) const;
+
  int _InitializeTimesMap(
     const std::vector <string> &files, 
 	const std::vector <string> &time_dimnames,
@@ -880,11 +1012,6 @@ private:
     bool has_missing, float mv, float *dst
  ) const;
 
- void _InterpolateSlice(
-    size_t nx, size_t ny, bool xstag, bool ystag, 
-	bool has_missing, float mv, float *slice
- ) const;
-
 int _GetTimesMap(
 	NetCDFSimple *netcdf,
 	const std::vector <string> &time_coordvars,
@@ -901,6 +1028,9 @@ int _GetTimesMap(
     const vector <NetCDFSimple::Variable> variables, string varname
  ) const;
 
+ void _UseFile(NetCDFSimple *netcdf);
+ void _TrimOpenFiles(const NetCDFSimple *keep = NULL);
+
 
 };
 };
@@ -159,6 +159,40 @@ public:
  //!
  int Initialize(string path);
 
+ //! Initialize the class instance for a netCDF file like another one
+ //!
+ //! The file named by \p path is checked to define the same 
+ //! dimensions, attributes and variables as the file of \p like, 
+ //! except for the dimension lengths, with the variables in the same
+ //! order. Only its dimension lengths are kept: the rest of its 
+ //! header is shared with \p like.
+ //!
+ //! \param[in] path Path to the netCDF file
+ //! \param[in] like An initialized instance
+ //!
+ //! \retval status A negative int is returned on failure, or if the
+ //! file doesn't match \p like
+ //!
+ int Initialize(string path, const NetCDFSimple &like);
+
+ //! Initialize the class instance for a netCDF file like another one,
+ //! without reading it
+ //!
+ //! The file must be known to match \p like, as checked by
+ //! Initialize(path, like).
+ //!
+ //! \param[in] path Path to the netCDF file
+ //! \param[in] like An initialized instance
+ //! \param[in] dims The dimension lengths of the file, in the order
+ //! returned by \p like.GetDimensions()
+ //!
+ //! \retval status A negative int is returned if \p dims doesn't
+ //! have an element for each dimension of \p like
+ //!
+ int Initialize(
+	string path, const NetCDFSimple &like, const std::vector <size_t> &dims
+ );
+
  //! Open the named variable for reading
  //!
  //! This method prepares a netCDF variable
@@ -212,6 +246,29 @@ public:
  //
  int Close(int fd = 0);
 
+ //! Close the netCDF file
+ //!
+ //! The netCDF file is opened by OpenRead(), and stays open after
+ //! the variable is closed so that other variables may be read without
+ //! reopening it. This method closes it. It is reopened by the next 
+ //! call to OpenRead().
+ //!
+ //! \retval status A negative int is returned on failure, or if any
+ //! variable is still open
+ //!
+ //! \sa IsFileOpen(), GetNumOpenVariables()
+ //
+ int CloseFile();
+
+ //! Return true if the netCDF file is open
+ //
+ bool IsFileOpen() const { return(_ncid != -1); }
+
+ //! Return the number of variables opened with OpenRead() and not
+ //! yet closed
+ //
+ int GetNumOpenVariables() const { return(_ovr_table.size()); }
+
  //! Return a vector of the Variables contained in the file
  //!
  //! This method returns a vector of Variable objects containing
@@ -368,6 +425,8 @@ private:
  std::vector <std::pair <string, string> > _str_atts;
  std::vector <NetCDFSimple::Variable> _variables;
 
+ int _GetVarAtts(int ncid, Variable &var);
+
  int _GetAtts(
 	int ncid, int varid,
 	std::vector <std::pair <string, std::vector <double> > > &flt_atts,
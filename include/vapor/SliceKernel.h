@@ -0,0 +1,124 @@
+//
+//      $Id$
+//
+
+#ifndef	_SliceKernel_h_
+#define	_SliceKernel_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class SliceKernel
+//! \brief Fused unstaggering, combination and scaling of variable slices
+//!
+//! A SliceKernel computes the XY slices of
+//!
+//! (U(v_0) + U(v_1) + ... + U(v_n-1)) / divisor
+//!
+//! where the v_i are variables sharing the same, possibly staggered,
+//! grid, and U() interpolates a variable on an Arakawa C-grid onto the
+//! unstaggered grid by averaging neighboring samples along each
+//! staggered dimension. A sample is missing if any sample it is computed
+//! from is missing.
+//!
+//! Slices of the native (staggered) variables are handed to Apply(),
+//! bottom to top, and each output slice is computed in a single pass over
+//! them. If the variables are staggered along Z the kernel keeps the
+//! previous slice of each variable, interpolated horizontally, in a
+//! scratch buffer that is reused by every call. The results are identical
+//! to interpolating along X, then Y, then Z, then combining.
+//!
+//! \sa NetCDFCollection::ReadSlice()
+//
+class VDF_API SliceKernel : public VetsUtil::MyBase {
+
+public:
+
+ SliceKernel();
+ virtual ~SliceKernel() {}
+
+ //! Prepare the kernel
+ //!
+ //! \param[in] nx Native (staggered) X dimension of the slices
+ //! \param[in] ny Native (staggered) Y dimension of the slices
+ //! \param[in] xstag True if the variables are staggered along X
+ //! \param[in] ystag True if the variables are staggered along Y
+ //! \param[in] zstag True if the variables are staggered along Z
+ //! \param[in] nterms Number of variables summed
+ //! \param[in] divisor The sum is divided by \p divisor
+ //! \param[in] has_missing True if the variables have missing values
+ //! \param[in] mv The missing value
+ //!
+ //! \retval status A negative int is returned if a staggered dimension
+ //! has fewer than two samples
+ //
+ int Init(
+	size_t nx, size_t ny, bool xstag, bool ystag, bool zstag,
+	int nterms = 1, float divisor = 1.0, bool has_missing = false,
+	float mv = 0.0
+ );
+
+ //! Return the dimensions of the output slices
+ //
+ void GetDim(size_t &nx, size_t &ny) const {
+	nx = _nxus; ny = _nyus;
+ }
+
+ //! Forget the previous slices. The next call to Apply() starts a new
+ //! column of slices, e.g. after a seek.
+ //
+ void Reset() { _primed = false; }
+
+ //! Compute the next output slice
+ //!
+ //! \param[in] slices The next native slice of each of the \p nterms
+ //! variables
+ //! \param[out] dst The output slice, GetDim() samples, X varying fastest
+ //!
+ //! \retval n 1 if \p dst was written. 0 if the slices were only
+ //! retained: the variables are staggered along Z and this was the
+ //! first slice since Init() or Reset(), so Apply() must be called
+ //! again with the next slices.
+ //
+ int Apply(const float *const slices[], float *dst);
+
+ //! Compute the output slices of whole native volumes
+ //!
+ //! Resets the kernel and applies it to each of the \p nz native slices
+ //! of \p volumes.
+ //!
+ //! \param[in] volumes The native volume of each of the \p nterms
+ //! variables, X varying fastest
+ //! \param[in] nz Native Z dimension of the volumes
+ //! \param[out] dst The output volume
+ //!
+ //! \retval n The number of output slices written
+ //
+ size_t ApplyVolume(const float *const volumes[], size_t nz, float *dst);
+
+private:
+ size_t _nx;
+ size_t _ny;
+ size_t _nxus;
+ size_t _nyus;
+ bool _xstag;
+ bool _ystag;
+ bool _zstag;
+ int _nterms;
+ float _divisor;
+ bool _has_missing;
+ float _mv;
+ bool _primed;	// previous slices are valid
+ std::vector <float> _prev;	// horizontally interpolated previous slices
+ std::vector <float> _row;	// one horizontally interpolated row
+
+ void _interpolateRow(const float *src, size_t y, float *row) const;
+};
+
+};
+
+#endif	//	_SliceKernel_h_
@@ -190,6 +190,9 @@ private:
 
  float _GetValueNearestNeighbor(double x, double y, double z) const;
  float _GetValueLinear(double x, double y, double z) const;
+ size_t _FindIndex(
+	const std::vector <double> &coords, double c, size_t *hint
+ ) const;
 
 
 
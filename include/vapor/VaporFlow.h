@@ -73,6 +73,14 @@ namespace VAPoR
 		//Version that actually does the work
 		bool GenStreamLinesNoRake(FlowLineData* container, float* seeds);
 		
+		//Dense seeding version:  advect one seed at each point of a lattice of
+		//latticeDims[0]xlatticeDims[1]xlatticeDims[2] points spanning the rake, through
+		//the steady field for the specified integration time (in user time units).
+		//Only the end positions are kept, 3 floats per seed, placed in endPositions.
+		//Seeds that start outside the field are set to END_FLOW_FLAG.
+		bool GenFlowMap(int timestep, const size_t latticeDims[3], double integrationTime,
+			int numSteps, float* endPositions);
+		
 		//Incrementally do path lines:
 		bool ExtendPathLines(PathLineData* container, int startTimeStep, int endTimeStep,
 			bool doingFLA);
@@ -80,6 +88,12 @@ namespace VAPoR
 		//Like the above, but put results into fieldLineData array.  
 		bool AdvectFieldLines(FlowLineData** containerArray, int startTimeStep, int endTimeStep, int maxNumSamples);
 
+		//Limit on the memory (in MB) used to read unsteady field data ahead of
+		//the integration in ExtendPathLines and AdvectFieldLines.  0 disables
+		//background reading.  Read-ahead is further limited to half of the
+		//DataMgr cache left by the two timesteps being integrated.
+		void SetPrefetchMemoryBudget(size_t megabytes) {prefetchMemBudgetMB = megabytes;}
+
 		void SetPeriodicDimensions(bool xPeriodic, bool yPeriodic, bool zPeriodic);
 		
 		bool regionPeriodicDim(int i) {return (periodicDim[i] && fullInDim[i]);}
@@ -104,13 +118,18 @@ namespace VAPoR
 			bool useRakeBounds, int numRefinements, int timestep);
 
 		DataMgr* getDataMgr(){return dataMgr;}
-	 
-	private:
-		
+
+		//Read (and lock) the three components of a field in a region, at the
+		//refinement and compression levels set with SetLocalRegion().  Components
+		//named "0" are set to NULL.  If any component can't be read the others
+		//are unlocked, and false is returned.
 		bool Get3GridData(
 			size_t ts, std::string xVarName, std::string yVarName, 
 			std::string zVarName, size_t minreg[3], size_t maxreg[3],
 			RegularGrid** xGrid, RegularGrid** yGrid, RegularGrid** zGrid);
+	 
+	private:
+		
 		double getMaxStepSize(double mingrid[3]);
 		double getInitStepSize(double mingrid[3]);
 
@@ -160,6 +179,7 @@ namespace VAPoR
 		float* flowLineAdvectionSeeds;
 		float minPriorityVal, maxPriorityVal;
 		float seedDistBias;
+		size_t prefetchMemBudgetMB;					// memory bound for unsteady read-ahead
 		
 	};
 };
@@ -9,6 +9,7 @@
 #include <vapor/Compressor.h>
 #include <vapor/EasyThreads.h>
 #include <vapor/NCBuf.h>
+#include <vapor/BlockSummary.h>
 
 #ifdef PARALLEL
 #include <mpi.h>
@@ -331,6 +332,54 @@ public:
  //
  const float *GetDataRange() const {return (_dataRange);}
 
+ //! Return the block summary of the variable opened for writing
+ //!
+ //! While a variable is written the minimum, maximum, and mean of
+ //! each native block are recorded. The summary is saved, when the
+ //! variable is closed, in the file returned by GetBlockSummaryPath().
+ //! Block coordinates are packed for 2D variables, as with 
+ //! BlockWriteRegion(). Missing values replaced by the block mean
+ //! are counted as valid.
+ //!
+ //! \sa BlockSummary
+ //
+ const BlockSummary &GetBlockSummary() const {return (_summary);}
+
+ //! Return the path of the block summary file of a variable
+ //!
+ //! \param[in] ts A valid time step
+ //! \param[in] varname A valid variable name
+ //!
+ //! \retval path The path, or the empty string on failure
+ //
+ string GetBlockSummaryPath(size_t ts, const string &varname) const;
+
+ //! Return a fingerprint of the data of a variable
+ //!
+ //! The fingerprint changes whenever the variable is rewritten. It is
+ //! recorded in the variable's block summary file.
+ //!
+ //! \param[in] ts A valid time step
+ //! \param[in] varname A valid variable name
+ //!
+ //! \retval fingerprint The fingerprint, or zero on failure
+ //!
+ //! \sa VetsUtil::FileFingerprint(), BlockSummary::SetSource()
+ //
+ unsigned long long GetDataFingerprint(
+	size_t ts, const string &varname
+ ) const;
+
+ //! Return the background write timer
+ //!
+ //! Coefficients are buffered, and full buffers are written to the
+ //! files in the background while the following blocks are compressed.
+ //! This method returns the accumulated clock time, in seconds, spent
+ //! in those writes, for the variables closed so far. The time the
+ //! writer waits for them is included in GetWriteTimer().
+ //!
+ double GetFlushTimer() const { return(_flushTimer); };
+
  //! Return the valid region bounds for the currently opened
  //! variable
  //!
@@ -416,6 +465,7 @@ private:
  double _methodTimer;
  double _methodThreadTimer;
  double _ioMPI;
+ double _flushTimer;	// time spent in NCBuf writes
  //
  // Threaded read object for parallel inverse transforms 
  // (data reconstruction)
@@ -504,6 +554,7 @@ private:
  vector <float *> _blockThread;
  float *_blockReg;	// more storage
  float _dataRange[2];
+ BlockSummary _summary;	// per-block statistics of variable being written
  vector <size_t> _ncoeffs; // num wave coeff. at each compression level
  vector <size_t> _cratios3D;	// 3D compression ratios
  vector <size_t> _cratios2D;	// 2D compression ratios
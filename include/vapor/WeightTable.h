@@ -1,5 +1,6 @@
 #ifndef weightTable_h
 #define weightTable_h
+#include <string>
 namespace VAPoR {
 // The WeightTable class calculates the weight tables that are used to lookup the interpolation weight that determines the corner x,y indices in user space and
 // alpha and beta coefficients that are used to interpolate the function value associated with a latitude and longitude grid coordinate.
@@ -16,11 +17,14 @@ namespace VAPoR {
 //	[0,360] and [-90,90] intervals
 // No special provision is made for points near the north pole.  In that case, the latitude is always less than 90, so a valid rectangle will contain the point in 
 //	user ulon/ulat coordinates.
+// The weights are computed on a pool of threads.  If a cache directory is set with SetCacheDir(), or with the VAPOR_WEIGHT_CACHE
+// environment variable, the table is written to a file in it named for a hash of geo_lat and geo_lon, and later tables for the same
+// grid are read from the file instead of being recomputed.
 // 
 class VDFIOBase;
 class VDF_API WeightTable {
 public:
-	//Construct a weight table (initially empty) for a given geo_lat and geo_lon variable.
+	//Construct the weight table for a given geo_lat and geo_lon variable, reading it from the cache directory if it's there.
  WeightTable(
     const float *geo_lat, const float *geo_lon,
     int ny, int nx,
@@ -32,10 +36,38 @@ public:
 	// Sourcedata is where the variable data has already been loaded.
 	// Values in the data that are equal to missingValue are mapped to missMap
 	void interp2D(const float* sourceData, float* resultData, float srcMV, float dstMV, const size_t* dims);
+
+	// Interpolate the region [min,max] of the lon/lat grid.  sourceData holds only the region [smin,smax] of the
+	// user grid, as returned by sourceRegion(), and resultData receives the (max[0]-min[0]+1)*(max[1]-min[1]+1) values.
+	void interp2D(
+		const float* sourceData, const size_t smin[2], const size_t smax[2], 
+		float* resultData, const size_t min[2], const size_t max[2],
+		float srcMV, float dstMV
+	);
+
+	// Return the region [smin,smax] of the user grid whose vertices are needed to interpolate the region [min,max]
+	// of the lon/lat grid.
+	void sourceRegion(const size_t min[2], const size_t max[2], size_t smin[2], size_t smax[2]) const;
 	
 	//Calculate the weights 
 	int calcWeights();
 
+	//Set the directory of weight table files.  An empty string disables the cache.  Failure to read or write the
+	//files is not an error.
+	static void SetCacheDir(const std::string &dir);
+	static std::string GetCacheDir();
+
+	//Computes the weights of the lon/lat grid rows assigned to one thread
+	class ThreadObj {
+	public:
+		ThreadObj(WeightTable *wt, int id, int nthreads) : _wt(wt), _id(id), _nthreads(nthreads) {}
+		void RunThread() { _wt->_calcWeights(_id, _nthreads); }
+	private:
+		WeightTable *_wt;
+		int _id;	// thread id
+		int _nthreads;
+	};
+
 	//Calculate angle that grid makes with latitude line at a particular vertex.
 	float getAngle(int ilon, int ilat) const;
 
@@ -47,6 +79,21 @@ private:
 	float bestLatLon(int ulon, int ulat);
 	
 	bool MOMBased;
+
+	//Look up the user grid vertices of the four corners used to interpolate lon/lat vertex (i,j)
+	void _corners(int i, int j, int lons[4], int lats[4]) const;
+
+	//Calculate the weights of the lon/lat grid rows id, id+nthreads, ...  Each vertex is written by one thread only, in the
+	//order of the serial calculation, so the table doesn't depend on the number of threads.
+	void _calcWeights(int id, int nthreads);
+
+	//Fill in the gather arrays used by interp2D from the weights
+	void _makeGather();
+
+	//Cache file of the table, or the empty string if there's no cache directory
+	std::string _cachePath();
+	int _readCache(const std::string &path);
+	void _writeCache(const std::string &path) const;
 	
 	//Calculate the weights alpha, beta associated with a point P=(plon,plat), based on rectangle cornered at 
 	//user grid vertex nlon, nlat
@@ -117,6 +164,11 @@ private:
 	// the lon/lat point indexed by "j".
 	int* _cornerLons;
 	int* _cornerLats;
+	//The user grid vertices interpolated for each lon/lat vertex, as from _corners(): 4 longitude indices, and 2 latitude
+	//indices (of corners 0 and 1, and of corners 2 and 3), and the 4 interpolation coefficients.
+	int* _gatherLons;
+	int* _gatherLats;
+	float* _gatherCoefs;
 	//As the table is constructed, keep track of how good is the test.  Points near boundary get replaced if a better fit is found.
 	float* _testValues;
 	//Arrays that hold the geo_lat and geo_lon values in the user topo data.  To determine the longitude and latitude of
@@ -128,6 +180,10 @@ private:
 	float _epsilon, _epsRect;
 	float _deltaLat, _deltaLon;
 	bool _wrapLon, _wrapLat;
+	unsigned long long _hash;	//hash of the grid the table is computed for
+
+	static std::string _cacheDir;
+	static bool _cacheDirSet;
 		
 }; //End WeightTable class
 	
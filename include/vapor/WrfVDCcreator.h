@@ -52,6 +52,7 @@ private:
  int _level;
  int _lod;
  int _nthreads;
+ VetsUtil::OptionParser::Boolean_T _lazy;
  VetsUtil::OptionParser::Boolean_T _help;
  VetsUtil::OptionParser::Boolean_T _quiet;
  VetsUtil::OptionParser::Boolean_T _debug;
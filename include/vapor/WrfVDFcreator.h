@@ -27,6 +27,7 @@ private:
  vector <string> _dervars;
  VetsUtil::OptionParser::Boolean_T _vdc2;
  VetsUtil::OptionParser::Boolean_T _append;
+ VetsUtil::OptionParser::Boolean_T _lazy;
  VetsUtil::OptionParser::Boolean_T _help;
  VetsUtil::OptionParser::Boolean_T _quiet;
  VetsUtil::OptionParser::Boolean_T _debug;
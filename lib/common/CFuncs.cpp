@@ -5,6 +5,7 @@
 #include <cassert>
 #include <cerrno>
 #include <stack>
+#include <sstream>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <vapor/MyBase.h>
@@ -189,3 +190,42 @@ void    VetsUtil::DirName(const string &path, string &dir) {
 		dir = path.substr(0, idx+1);
 	}
 }
+
+unsigned long long VetsUtil::HashBytes(
+	const void *data, size_t n, unsigned long long hash
+) {
+	const unsigned char *ptr = (const unsigned char *) data;
+	for (size_t i=0; i<n; i++) {
+		hash ^= ptr[i];
+		hash *= 1099511628211ULL;
+	}
+	return(hash);
+}
+
+unsigned long long VetsUtil::HashString(
+	const string &s, unsigned long long hash
+) {
+	return(HashBytes(s.c_str(), s.size()+1, hash));
+}
+
+int VetsUtil::FileStamp(const string &path, string &stamp) {
+	struct STAT64_T statbuf;
+	if (STAT64(path.c_str(), &statbuf) < 0) return(-1);
+
+	ostringstream oss;
+	oss << statbuf.st_mtime << " " << statbuf.st_size;
+	stamp = oss.str();
+	return(0);
+}
+
+unsigned long long VetsUtil::FileFingerprint(const vector <string> &paths) {
+
+	unsigned long long hash = HashInit;
+	for (size_t i=0; i<paths.size(); i++) {
+		hash = HashString(paths[i], hash);
+
+		string stamp;
+		if (FileStamp(paths[i], stamp) == 0) hash = HashString(stamp, hash);
+	}
+	return(hash ? hash : 1);
+}
@@ -14,6 +14,8 @@
 #ifdef WIN32
 #pragma warning( disable : 4996 )
 #include "windows.h"
+#else
+#include <pthread.h>
 #endif
 
 #include <iostream>
@@ -63,6 +65,58 @@ void (*MyBase::DiagMsgCB) (const char *msg) = NULL;
 
 bool MyBase::Enabled = true;
 
+namespace {
+
+	//
+	// Error message state of a thread whose messages are diverted
+	//
+	struct ThreadErr {
+		bool diverted;
+		char *msg;
+		int msgsz;
+	};
+
+#ifdef WIN32
+	__declspec(thread) ThreadErr *ThreadErrPtr = NULL;
+
+	ThreadErr *getThreadErr(bool create) {
+		if (! ThreadErrPtr && create) {
+			ThreadErrPtr = new ThreadErr;
+			ThreadErrPtr->diverted = false;
+			ThreadErrPtr->msg = NULL;
+			ThreadErrPtr->msgsz = 0;
+		}
+		return(ThreadErrPtr);
+	}
+#else
+	pthread_key_t ThreadErrKey;
+	pthread_once_t ThreadErrOnce = PTHREAD_ONCE_INIT;
+
+	void freeThreadErr(void *p) {
+		ThreadErr *te = (ThreadErr *) p;
+		if (te->msg) delete [] te->msg;
+		delete te;
+	}
+
+	void makeThreadErrKey() {
+		(void) pthread_key_create(&ThreadErrKey, freeThreadErr);
+	}
+
+	ThreadErr *getThreadErr(bool create) {
+		(void) pthread_once(&ThreadErrOnce, makeThreadErrKey);
+		ThreadErr *te = (ThreadErr *) pthread_getspecific(ThreadErrKey);
+		if (! te && create) {
+			te = new ThreadErr;
+			te->diverted = false;
+			te->msg = NULL;
+			te->msgsz = 0;
+			(void) pthread_setspecific(ThreadErrKey, te);
+		}
+		return(te);
+	}
+#endif
+};
+
 MyBase::MyBase() {
 	SetClassName("MyBase");
 }
@@ -124,6 +178,34 @@ void	MyBase::_SetErrMsg(
 
 }
 
+bool	MyBase::DivertThreadErrMsg(bool divert) {
+	ThreadErr *te = getThreadErr(divert);
+	if (! te) return(false);
+
+	bool prev = te->diverted;
+	te->diverted = divert;
+	if (divert && te->msg) te->msg[0] = '\0';
+	return(prev);
+}
+
+const char	*MyBase::GetThreadErrMsg() {
+	ThreadErr *te = getThreadErr(false);
+	if (! te || ! te->msg) return("");
+	return(te->msg);
+}
+
+//
+// Record the message for the calling thread if its messages are
+// diverted. Returns false if they're not.
+//
+bool	MyBase::_ThreadErrMsg(const char *format, va_list args) {
+	ThreadErr *te = getThreadErr(false);
+	if (! te || ! te->diverted) return(false);
+
+	if (format) _SetErrMsg(&te->msg, &te->msgsz, format, args);
+	return(true);
+}
+
 void	MyBase::SetErrMsg(
 	const char *format, 
 	...
@@ -132,6 +214,12 @@ void	MyBase::SetErrMsg(
 
 
 	if (! Enabled) return;
+
+	va_start(args, format);
+	bool diverted = _ThreadErrMsg(format, args);
+	va_end(args);
+	if (diverted) return;
+
 	ErrCode = 1;
 
 	va_start(args, format);
@@ -155,6 +243,12 @@ void	MyBase::SetErrMsg(
 
 
 	if (! Enabled) return;
+
+	va_start(args, format);
+	bool diverted = _ThreadErrMsg(format, args);
+	va_end(args);
+	if (diverted) return;
+
 	ErrCode = errcode;
 
 	va_start(args, format);
@@ -175,6 +269,9 @@ void	MyBase::SetDiagMsg(
 ) {
 	va_list args;
 
+	ThreadErr *te = getThreadErr(false);
+	if (te && te->diverted) return;
+
 	va_start(args, format);
 	_SetErrMsg(&DiagMsg, &DiagMsgSize, format, args);
 	va_end(args);
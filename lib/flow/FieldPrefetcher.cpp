@@ -0,0 +1,288 @@
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cassert>
+#ifndef WIN32
+#include <sys/time.h>
+#endif
+#include "FieldPrefetcher.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+#ifndef WIN32
+namespace {
+	void* runPrefetchWorker(void* object){
+		((FieldPrefetcher*) object)->runWorker();
+		return 0;
+	}
+	double wallTime(){
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+		return (double)tv.tv_sec + 1.e-6*(double)tv.tv_usec;
+	}
+};
+#endif
+
+FieldPrefetcher::FieldPrefetcher(DataMgr* dm, const std::string names[3],
+	int nXForms, int lodLevel, const size_t minRegion[3], const size_t maxRegion[3],
+	size_t memBudgetMB)
+{
+	dataMgr = dm;
+	numXForms = nXForms;
+	lod = lodLevel;
+	size_t nComponents = 0;
+	size_t nVoxels = 1;
+	for (int i = 0; i<3; i++){
+		varNames[i] = names[i];
+		if (varNames[i].compare("0") != 0) nComponents++;
+		minReg[i] = minRegion[i];
+		maxReg[i] = maxRegion[i];
+		nVoxels *= (maxReg[i]-minReg[i]+1);
+	}
+	bytesPerStep = nComponents*nVoxels*sizeof(float);
+
+	//Leave the two timesteps being integrated, and half of the rest of
+	//the cache for other users, out of the read-ahead budget
+	size_t cacheBytes = dataMgr->GetMemSize()*1024*1024;
+	size_t cacheBudget = 0;
+	if (cacheBytes > 2*bytesPerStep) cacheBudget = (cacheBytes - 2*bytesPerStep)/2;
+	memBudget = memBudgetMB*1024*1024;
+	if (memBudget > cacheBudget) memBudget = cacheBudget;
+	depth = bytesPerStep > 0 ? (int)(memBudget/bytesPerStep) : 0;
+	waitTime = 0.0;
+	busy = false;
+	busyTimestep = 0;
+	shutdown = false;
+	threaded = false;
+
+#ifndef WIN32
+	if (memBudget >= bytesPerStep && bytesPerStep > 0){
+		pthread_mutex_init(&stateLock, 0);
+		pthread_mutex_init(&dataMgrLock, 0);
+		pthread_cond_init(&stateChanged, 0);
+		threaded = (pthread_create(&worker, 0, runPrefetchWorker, this) == 0);
+		if (!threaded){
+			pthread_cond_destroy(&stateChanged);
+			pthread_mutex_destroy(&dataMgrLock);
+			pthread_mutex_destroy(&stateLock);
+		}
+	}
+#endif
+}
+
+FieldPrefetcher::~FieldPrefetcher()
+{
+#ifndef WIN32
+	if (threaded){
+		pthread_mutex_lock(&stateLock);
+		shutdown = true;
+		queue.clear();
+		pthread_cond_broadcast(&stateChanged);
+		pthread_mutex_unlock(&stateLock);
+		pthread_join(worker, 0);
+	}
+#endif
+	//Unlock anything that was read ahead but never used:
+	std::map<size_t, Entry>::iterator itr;
+	for (itr = ready.begin(); itr != ready.end(); itr++){
+		if (itr->second.ok) releaseEntry(&itr->second);
+	}
+	ready.clear();
+#ifndef WIN32
+	if (threaded){
+		pthread_cond_destroy(&stateChanged);
+		pthread_mutex_destroy(&dataMgrLock);
+		pthread_mutex_destroy(&stateLock);
+	}
+#endif
+}
+
+//Number of timesteps that are, or soon will be, held by the prefetcher
+size_t FieldPrefetcher::numResident() const
+{
+	return ready.size() + queue.size() + (busy ? 1 : 0);
+}
+
+void FieldPrefetcher::Request(size_t ts)
+{
+	if (!threaded) return;
+#ifndef WIN32
+	pthread_mutex_lock(&stateLock);
+	bool known = (ready.find(ts) != ready.end()) || (busy && busyTimestep == ts);
+	for (size_t i = 0; !known && i<queue.size(); i++){
+		if (queue[i] == ts) known = true;
+	}
+	if (!known && (numResident()+1)*bytesPerStep <= memBudget){
+		queue.push_back(ts);
+		pthread_cond_broadcast(&stateChanged);
+	}
+	pthread_mutex_unlock(&stateLock);
+#endif
+}
+
+bool FieldPrefetcher::Get(size_t ts, RegularGrid** xGrid, RegularGrid** yGrid, RegularGrid** zGrid)
+{
+	Entry entry;
+	*xGrid = *yGrid = *zGrid = 0;
+#ifndef WIN32
+	if (threaded){
+		double t0 = wallTime();
+		pthread_mutex_lock(&stateLock);
+		for (;;){
+			std::map<size_t, Entry>::iterator itr = ready.find(ts);
+			if (itr != ready.end()){
+				entry = itr->second;
+				ready.erase(itr);
+				break;
+			}
+			bool pending = (busy && busyTimestep == ts);
+			for (std::deque<size_t>::iterator q = queue.begin(); !pending && q != queue.end(); q++){
+				if (*q == ts){
+					//Not started yet; read it right away instead
+					queue.erase(q);
+					break;
+				}
+			}
+			if (!pending){
+				pthread_mutex_unlock(&stateLock);
+				readGrids(ts, &entry);
+				pthread_mutex_lock(&stateLock);
+				break;
+			}
+			pthread_cond_wait(&stateChanged, &stateLock);
+		}
+		pthread_mutex_unlock(&stateLock);
+		waitTime += wallTime()-t0;
+	} else
+#endif
+	{
+		readGrids(ts, &entry);
+	}
+	if (!entry.ok && threaded){
+		//The background read may have failed for lack of cache space held
+		//by read-ahead.  Drop the read-ahead and read again here, so that
+		//any error is reported on this thread.
+		dropReadAhead();
+		readGrids(ts, &entry);
+	}
+	if (!entry.ok) return false;
+	*xGrid = entry.grids[0];
+	*yGrid = entry.grids[1];
+	*zGrid = entry.grids[2];
+	return true;
+}
+
+void FieldPrefetcher::Release(RegularGrid* xGrid, RegularGrid* yGrid, RegularGrid* zGrid)
+{
+	Entry entry;
+	entry.grids[0] = xGrid;
+	entry.grids[1] = yGrid;
+	entry.grids[2] = zGrid;
+	entry.ok = true;
+	releaseEntry(&entry);
+}
+
+void FieldPrefetcher::LockDataMgr()
+{
+#ifndef WIN32
+	if (threaded) pthread_mutex_lock(&dataMgrLock);
+#endif
+}
+
+void FieldPrefetcher::UnlockDataMgr()
+{
+#ifndef WIN32
+	if (threaded) pthread_mutex_unlock(&dataMgrLock);
+#endif
+}
+
+//Forget the queued timesteps and unlock those read ahead, including the
+//one the worker may be reading now
+void FieldPrefetcher::dropReadAhead()
+{
+#ifndef WIN32
+	pthread_mutex_lock(&stateLock);
+	queue.clear();
+	while (busy) pthread_cond_wait(&stateChanged, &stateLock);
+	std::map<size_t, Entry> dropped;
+	dropped.swap(ready);
+	pthread_mutex_unlock(&stateLock);
+
+	std::map<size_t, Entry>::iterator itr;
+	for (itr = dropped.begin(); itr != dropped.end(); itr++){
+		if (itr->second.ok) releaseEntry(&itr->second);
+	}
+#endif
+}
+
+//Read (and lock) the grids for one timestep.  Same policy as
+//VaporFlow::Get3GridData:  if one component fails, the others are unlocked.
+bool FieldPrefetcher::readGrids(size_t ts, Entry* entry)
+{
+#ifndef WIN32
+	if (threaded) pthread_mutex_lock(&dataMgrLock);
+#endif
+	bool ok = true;
+	for (int i = 0; i<3; i++){
+		entry->grids[i] = 0;
+		if (!ok || varNames[i].compare("0") == 0) continue;
+		entry->grids[i] = dataMgr->GetGrid(ts, varNames[i], numXForms, lod, minReg, maxReg, 1);
+		if (!entry->grids[i]) ok = false;
+	}
+	if (!ok){
+		for (int i = 0; i<3; i++){
+			if (entry->grids[i]) dataMgr->UnlockGrid(entry->grids[i]);
+			entry->grids[i] = 0;
+		}
+	}
+#ifndef WIN32
+	if (threaded) pthread_mutex_unlock(&dataMgrLock);
+#endif
+	entry->ok = ok;
+	return ok;
+}
+
+void FieldPrefetcher::releaseEntry(Entry* entry)
+{
+#ifndef WIN32
+	if (threaded) pthread_mutex_lock(&dataMgrLock);
+#endif
+	for (int i = 0; i<3; i++){
+		if (entry->grids[i]) dataMgr->UnlockGrid(entry->grids[i]);
+		entry->grids[i] = 0;
+	}
+#ifndef WIN32
+	if (threaded) pthread_mutex_unlock(&dataMgrLock);
+#endif
+}
+
+#ifndef WIN32
+void FieldPrefetcher::runWorker()
+{
+	//Failures are retried, and reported, by Get() on the caller's thread
+	MyBase::DivertThreadErrMsg(true);
+
+	pthread_mutex_lock(&stateLock);
+	for (;;){
+		while (!shutdown && queue.empty())
+			pthread_cond_wait(&stateChanged, &stateLock);
+		if (shutdown) break;
+
+		busyTimestep = queue.front();
+		queue.pop_front();
+		busy = true;
+		pthread_mutex_unlock(&stateLock);
+
+		Entry entry;
+		readGrids(busyTimestep, &entry);
+
+		pthread_mutex_lock(&stateLock);
+		ready[busyTimestep] = entry;
+		busy = false;
+		pthread_cond_broadcast(&stateChanged);
+	}
+	pthread_mutex_unlock(&stateLock);
+}
+#endif
@@ -0,0 +1,108 @@
+//	File:		FieldPrefetcher.h
+//
+//	Description:	Sliding time window over the u,v,w grids of an
+//					unsteady field.  Grids for upcoming sampled time
+//					steps are read from the DataMgr on a background
+//					thread while integration proceeds on the current
+//					pair of time steps.
+//
+
+#ifndef	_FieldPrefetcher_h_
+#define	_FieldPrefetcher_h_
+
+#include <string>
+#include <map>
+#include <deque>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+#include <vapor/DataMgr.h>
+#include <vapor/MyBase.h>
+#include <vapor/common.h>
+
+namespace VAPoR
+{
+	//Grids are locked in the DataMgr when read, and are unlocked by
+	//Release(), or by the destructor if they were never handed out.
+	//All DataMgr access made through this class is serialized.  The DataMgr
+	//is not thread safe, so while a FieldPrefetcher exists the caller must
+	//bracket any other DataMgr calls with LockDataMgr() and UnlockDataMgr().
+	//The read-ahead is bounded by the memory budget and by the DataMgr
+	//cache: the caller is assumed to hold two timesteps, and read-ahead
+	//uses at most half of the rest of the cache.  A background read that
+	//fails, e.g. for lack of cache space, is retried in Get(), so errors
+	//are reported on the caller's thread.
+	//On Windows, and when the memory budget is 0, no background thread
+	//is used and all reads are done synchronously in Get().
+	class FLOW_API FieldPrefetcher : public VetsUtil::MyBase
+	{
+	public:
+		FieldPrefetcher(DataMgr* dm, const std::string varNames[3],
+			int numXForms, int lod, const size_t minReg[3], const size_t maxReg[3],
+			size_t memBudgetMB);
+		~FieldPrefetcher();
+
+		//Queue a timestep to be read in the background.  Ignored if the
+		//timestep is already queued or read, or if reading it would exceed
+		//the memory budget.
+		void Request(size_t ts);
+
+		//Obtain the three grids for a timestep, waiting for the background
+		//read if one is in progress, or reading them now otherwise.
+		//Grids of components named "0" are set to NULL.
+		//Returns false if the data could not be read.
+		bool Get(size_t ts, RegularGrid** xGrid, RegularGrid** yGrid, RegularGrid** zGrid);
+
+		//Unlock grids obtained from Get()
+		void Release(RegularGrid* xGrid, RegularGrid* yGrid, RegularGrid* zGrid);
+
+		//Number of timesteps that fit in the read-ahead budget
+		int GetDepth() const {return depth;}
+
+		//Serialize the caller's own DataMgr calls with the background reads
+		void LockDataMgr();
+		void UnlockDataMgr();
+
+		//Cumulative time (seconds) Get() has waited for data
+		double GetWaitTime() const {return waitTime;}
+
+	private:
+		struct Entry {
+			RegularGrid* grids[3];
+			bool ok;
+		};
+
+		bool readGrids(size_t ts, Entry* entry);
+		void releaseEntry(Entry* entry);
+		void dropReadAhead();
+		size_t numResident() const;
+
+		DataMgr* dataMgr;
+		std::string varNames[3];
+		int numXForms;
+		int lod;
+		size_t minReg[3], maxReg[3];
+		size_t bytesPerStep;
+		size_t memBudget;
+		int depth;
+		double waitTime;
+
+		std::deque<size_t> queue;			//timesteps waiting to be read
+		std::map<size_t, Entry> ready;		//timesteps read but not yet handed out
+		bool busy;							//worker is reading busyTimestep
+		size_t busyTimestep;
+		bool shutdown;
+		bool threaded;
+
+#ifndef WIN32
+		pthread_t worker;
+		pthread_mutex_t stateLock;			//protects the queue and ready map
+		pthread_mutex_t dataMgrLock;		//serializes DataMgr grid access
+		pthread_cond_t stateChanged;
+	public:
+		void runWorker();
+#endif
+	};
+};
+
+#endif
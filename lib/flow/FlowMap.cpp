@@ -0,0 +1,430 @@
+#ifdef WIN32
+#define _USE_MATH_DEFINES
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include <vapor/FlowMap.h>
+#include <vapor/flowlinedata.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+namespace VAPoR {
+
+	// thread helper functions
+	//
+	void	*RunFlowMapAdvectThread(void *object) {
+		FlowMap::ThreadObj *X = (FlowMap::ThreadObj *) object;
+		X->AdvectThread();
+		return(0);
+	}
+
+	void	*RunFlowMapFTLEThread(void *object) {
+		FlowMap::ThreadObj *X = (FlowMap::ThreadObj *) object;
+		X->FTLEThread();
+		return(0);
+	}
+};
+
+namespace {
+
+//
+// Largest eigenvalue of a symmetric, positive semi-definite 3x3 matrix
+// (trigonometric solution of the characteristic polynomial)
+//
+double max_eigenvalue(const double c[3][3]) {
+
+	double p1 = c[0][1]*c[0][1] + c[0][2]*c[0][2] + c[1][2]*c[1][2];
+	double q = (c[0][0] + c[1][1] + c[2][2]) / 3.0;
+
+	if (p1 == 0.0) {
+		double m = c[0][0];
+		if (c[1][1] > m) m = c[1][1];
+		if (c[2][2] > m) m = c[2][2];
+		return(m);
+	}
+
+	double p2 = (c[0][0]-q)*(c[0][0]-q) + (c[1][1]-q)*(c[1][1]-q) +
+		(c[2][2]-q)*(c[2][2]-q) + 2.0*p1;
+	double p = sqrt(p2 / 6.0);
+
+	double b[3][3];
+	for (int i=0; i<3; i++) {
+	for (int j=0; j<3; j++) {
+		b[i][j] = (c[i][j] - (i==j ? q : 0.0)) / p;
+	}
+	}
+	double r = 0.5 * (
+		b[0][0]*(b[1][1]*b[2][2] - b[1][2]*b[2][1]) -
+		b[0][1]*(b[1][0]*b[2][2] - b[1][2]*b[2][0]) +
+		b[0][2]*(b[1][0]*b[2][1] - b[1][1]*b[2][0])
+	);
+
+	double phi;
+	if (r <= -1.0) phi = M_PI / 3.0;
+	else if (r >= 1.0) phi = 0.0;
+	else phi = acos(r) / 3.0;
+
+	return(q + 2.0 * p * cos(phi));
+}
+
+};
+
+FlowMap::FlowMap(int nthreads) : _et(nthreads) {
+
+	_integrationTime = 1.0;
+	_numSteps = 100;
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_ugrid = _vgrid = _wgrid = NULL;
+	_lattice = NULL;
+	_ftleGrid = NULL;
+	_endpos = NULL;
+	for (int i=0; i<3; i++) {
+		_dims[i] = _tileDims[i] = _ntiles[i] = 0;
+	}
+}
+
+FlowMap::~FlowMap() {
+}
+
+void FlowMap::_setLattice(const RegularGrid *lattice) {
+	_lattice = lattice;
+	_lattice->GetDimensions(_dims);
+	_lattice->GetBlockSize(_tileDims);
+	for (int i=0; i<3; i++) {
+		if (_tileDims[i] < 1) _tileDims[i] = 1;
+		_ntiles[i] = (_dims[i] + _tileDims[i] - 1) / _tileDims[i];
+	}
+}
+
+int FlowMap::_run(void *(*start)(void *)) {
+
+	vector <ThreadObj *> objs;
+	for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+	int rc = 0;
+	if (_nthreads <= 1) {
+		(*start)((void *) objs[0]);
+	}
+	else {
+		rc = _et.ParRun(start, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+
+	for (int t=0; t<_nthreads; t++) delete objs[t];
+	return(rc < 0 ? -1 : 0);
+}
+
+int FlowMap::Advect(
+	const RegularGrid *u, const RegularGrid *v, const RegularGrid *w,
+	const RegularGrid *lattice, float *endpos
+) {
+	if (! (u || v || w)) {
+		SetErrMsg("No field components specified");
+		return(-1);
+	}
+	_ugrid = u;
+	_vgrid = v;
+	_wgrid = w;
+	_endpos = endpos;
+	_setLattice(lattice);
+
+	return(_run(RunFlowMapAdvectThread));
+}
+
+int FlowMap::ComputeFTLE(
+	const RegularGrid *u, const RegularGrid *v, const RegularGrid *w,
+	RegularGrid *ftle
+) {
+	if (_integrationTime == 0.0) {
+		SetErrMsg("Integration time must be non-zero");
+		return(-1);
+	}
+
+	size_t dims[3];
+	ftle->GetDimensions(dims);
+
+	float *endpos = new float[3*dims[0]*dims[1]*dims[2]];
+
+	int rc = FlowMap::Advect(u, v, w, ftle, endpos);
+	if (rc < 0) {
+		delete [] endpos;
+		return(-1);
+	}
+
+	_ftleGrid = ftle;
+	rc = _run(RunFlowMapFTLEThread);
+	_ftleGrid = NULL;
+	_endpos = NULL;
+
+	delete [] endpos;
+	return(rc);
+}
+
+//
+// Sample the vector field at p. *valid is false if p is outside the
+// domain or any component is missing there
+//
+void FlowMap::ThreadObj::_velocity(
+	const double p[3], double vel[3], bool *valid
+) const {
+	const RegularGrid *grids[] = {_fm->_ugrid, _fm->_vgrid, _fm->_wgrid};
+
+	*valid = true;
+	for (int i=0; i<3; i++) {
+		vel[i] = 0.0;
+		const RegularGrid *rg = grids[i];
+		if (! rg) continue;
+
+		if (! rg->InsideGrid(p[0], p[1], p[2])) {
+			*valid = false;
+			return;
+		}
+		float f = rg->GetValue(p[0], p[1], p[2]);
+		if (rg->HasMissingData() && f == rg->GetMissingValue()) {
+			*valid = false;
+			return;
+		}
+		vel[i] = f;
+	}
+}
+
+void FlowMap::ThreadObj::AdvectThread() {
+
+	const size_t *dims = _fm->_dims;
+	const size_t *tdims = _fm->_tileDims;
+	const size_t *ntiles = _fm->_ntiles;
+	size_t ntotal = ntiles[0]*ntiles[1]*ntiles[2];
+
+	double h = _fm->_integrationTime / (double) _fm->_numSteps;
+
+	for (size_t index = _id; index<ntotal; index+=_fm->_nthreads) {
+		size_t tx = index % ntiles[0];
+		size_t ty = (index / ntiles[0]) % ntiles[1];
+		size_t tz = index / (ntiles[0]*ntiles[1]);
+
+		size_t kmax = min((tz+1)*tdims[2], dims[2]);
+		size_t jmax = min((ty+1)*tdims[1], dims[1]);
+		size_t imax = min((tx+1)*tdims[0], dims[0]);
+
+		for (size_t k=tz*tdims[2]; k<kmax; k++) {
+		for (size_t j=ty*tdims[1]; j<jmax; j++) {
+		for (size_t i=tx*tdims[0]; i<imax; i++) {
+			float *out = _fm->_endpos + 3*(k*dims[0]*dims[1] + j*dims[0] + i);
+
+			double p[3];
+			_fm->_lattice->GetUserCoordinates(i,j,k, &p[0], &p[1], &p[2]);
+
+			double k1[3], k2[3], k3[3], k4[3], q[3];
+			bool valid;
+			_velocity(p, k1, &valid);
+			if (! valid) {
+				out[0] = out[1] = out[2] = END_FLOW_FLAG;
+				continue;
+			}
+
+			for (int step=0; step<_fm->_numSteps; step++) {
+				if (step) {
+					_velocity(p, k1, &valid);
+					if (! valid) break;
+				}
+
+				for (int c=0; c<3; c++) q[c] = p[c] + 0.5*h*k1[c];
+				_velocity(q, k2, &valid);
+				if (! valid) break;
+
+				for (int c=0; c<3; c++) q[c] = p[c] + 0.5*h*k2[c];
+				_velocity(q, k3, &valid);
+				if (! valid) break;
+
+				for (int c=0; c<3; c++) q[c] = p[c] + h*k3[c];
+				_velocity(q, k4, &valid);
+				if (! valid) break;
+
+				for (int c=0; c<3; c++) {
+					p[c] += h/6.0 * (k1[c] + 2.0*k2[c] + 2.0*k3[c] + k4[c]);
+				}
+			}
+			out[0] = p[0];
+			out[1] = p[1];
+			out[2] = p[2];
+		}
+		}
+		}
+	}
+}
+
+void FlowMap::ThreadObj::FTLEThread() {
+
+	const size_t *dims = _fm->_dims;
+	const size_t *tdims = _fm->_tileDims;
+	const size_t *ntiles = _fm->_ntiles;
+	size_t ntotal = ntiles[0]*ntiles[1]*ntiles[2];
+	const float *endpos = _fm->_endpos;
+	RegularGrid *ftle = _fm->_ftleGrid;
+
+	float mv = ftle->HasMissingData() ? ftle->GetMissingValue() : 0.0;
+	double absT = fabs(_fm->_integrationTime);
+
+	size_t stride[] = {3, 3*dims[0], 3*dims[0]*dims[1]};
+
+	for (size_t index = _id; index<ntotal; index+=_fm->_nthreads) {
+		size_t tx = index % ntiles[0];
+		size_t ty = (index / ntiles[0]) % ntiles[1];
+		size_t tz = index / (ntiles[0]*ntiles[1]);
+
+		size_t kmax = min((tz+1)*tdims[2], dims[2]);
+		size_t jmax = min((ty+1)*tdims[1], dims[1]);
+		size_t imax = min((tx+1)*tdims[0], dims[0]);
+
+		for (size_t k=tz*tdims[2]; k<kmax; k++) {
+		for (size_t j=ty*tdims[1]; j<jmax; j++) {
+		for (size_t i=tx*tdims[0]; i<imax; i++) {
+			size_t ijk[] = {i,j,k};
+			const float *center = endpos +
+				3*(k*dims[0]*dims[1] + j*dims[0] + i);
+
+			//
+			// Flow map gradient, F[r][c] = d(phi_r)/d(x_c), by central
+			// differences (one sided on the boundary). Degenerate axes
+			// (dimension 1) contribute the identity.
+			//
+			double F[3][3];
+			bool valid = (center[0] != END_FLOW_FLAG);
+			for (int c=0; c<3 && valid; c++) {
+				if (dims[c] < 2) {
+					for (int r=0; r<3; r++) F[r][c] = (r == c) ? 1.0 : 0.0;
+					continue;
+				}
+				size_t lo = ijk[c] > 0 ? ijk[c]-1 : ijk[c];
+				size_t hi = ijk[c] < dims[c]-1 ? ijk[c]+1 : ijk[c];
+
+				const float *plo = center - (ijk[c]-lo)*stride[c];
+				const float *phi = center + (hi-ijk[c])*stride[c];
+				if (plo[0] == END_FLOW_FLAG || phi[0] == END_FLOW_FLAG) {
+					valid = false;
+					break;
+				}
+
+				size_t ilo[] = {i,j,k}, ihi[] = {i,j,k};
+				ilo[c] = lo;
+				ihi[c] = hi;
+				double xlo[3], xhi[3];
+				_fm->_lattice->GetUserCoordinates(
+					ilo[0],ilo[1],ilo[2], &xlo[0],&xlo[1],&xlo[2]
+				);
+				_fm->_lattice->GetUserCoordinates(
+					ihi[0],ihi[1],ihi[2], &xhi[0],&xhi[1],&xhi[2]
+				);
+				double dx = xhi[c] - xlo[c];
+				if (dx == 0.0) {
+					valid = false;
+					break;
+				}
+				for (int r=0; r<3; r++) F[r][c] = (phi[r] - plo[r]) / dx;
+			}
+
+			if (! valid) {
+				ftle->AccessIJK(i,j,k) = mv;
+				continue;
+			}
+
+			// Cauchy-Green tensor C = transpose(F) * F
+			//
+			double C[3][3];
+			for (int r=0; r<3; r++) {
+			for (int c=0; c<3; c++) {
+				C[r][c] = F[0][r]*F[0][c] + F[1][r]*F[1][c] + F[2][r]*F[2][c];
+			}
+			}
+
+			double lambda = max_eigenvalue(C);
+			if (lambda <= 0.0) {
+				ftle->AccessIJK(i,j,k) = mv;
+				continue;
+			}
+			ftle->AccessIJK(i,j,k) = 0.5 * log(lambda) / absT;
+		}
+		}
+		}
+	}
+}
+
+vector <string> FTLEPipeLine::_inputs(
+	string xvar, string yvar, string zvar
+) {
+	vector <string> inputs;
+	if (xvar.compare("0") != 0) inputs.push_back(xvar);
+	if (yvar.compare("0") != 0) inputs.push_back(yvar);
+	if (zvar.compare("0") != 0) inputs.push_back(zvar);
+	return(inputs);
+}
+
+vector <pair <string, DataMgr::VarType_T> > FTLEPipeLine::_outputs(
+	string outvar
+) {
+	vector <pair <string, DataMgr::VarType_T> > outputs;
+	outputs.push_back(make_pair(outvar, DataMgr::VAR3D));
+	return(outputs);
+}
+
+FTLEPipeLine::FTLEPipeLine(
+	string name, string xvar, string yvar, string zvar, string outvar,
+	double integrationTime, int numSteps, int numTransforms
+) : PipeLine(name, _inputs(xvar, yvar, zvar), _outputs(outvar)) {
+
+	_zeroComponent.push_back(xvar.compare("0") == 0);
+	_zeroComponent.push_back(yvar.compare("0") == 0);
+	_zeroComponent.push_back(zvar.compare("0") == 0);
+	_integrationTime = integrationTime;
+	_numSteps = numSteps;
+	_numTransforms = numTransforms;
+}
+
+int FTLEPipeLine::GetNumSteps(int reflevel) const {
+	int nsteps = _numSteps;
+	if (_numTransforms < 0 || reflevel < 0) return(nsteps);
+
+	for (int l = reflevel; l < _numTransforms && nsteps > 1; l++) {
+		nsteps = (nsteps + 1) / 2;
+	}
+	return(nsteps);
+}
+
+int FTLEPipeLine::Calculate (
+	vector <const RegularGrid *> input_grids,
+	vector <RegularGrid *> output_grids,
+	size_t ts,
+	int reflevel,
+	int lod
+) {
+	const RegularGrid *field[] = {NULL, NULL, NULL};
+	int n = 0;
+	for (int i=0; i<3; i++) {
+		if (_zeroComponent[i]) continue;
+		assert(n < input_grids.size());
+		field[i] = input_grids[n++];
+	}
+	assert(output_grids.size() == 1);
+
+	//
+	// The input grids were read at ts and lod; only the step count
+	// depends on the refinement level
+	//
+	int nsteps = GetNumSteps(reflevel);
+	MyBase::SetDiagMsg(
+		"FTLEPipeLine::Calculate(%d, %d, %d) : %d steps",
+		(int) ts, reflevel, lod, nsteps
+	);
+
+	FlowMap flowmap;
+	flowmap.SetIntegrationTime(_integrationTime);
+	flowmap.SetNumSteps(nsteps);
+
+	return(flowmap.ComputeFTLE(field[0], field[1], field[2], output_grids[0]));
+}
@@ -3,16 +3,21 @@
 #endif
 
 #include <vapor/VaporFlow.h>
+#include <vapor/FlowMap.h>
 #include <vapor/flowlinedata.h>
 #include <vapor/errorcodes.h>
 #include "Rake.h"
 #include "VTFieldLine.h"
+#include "FieldPrefetcher.h"
 #include "math.h"
 
 #define SMALLEST_MAX_STEP 0.25f
 #define SMALLEST_MIN_STEP 0.01f
 #define LARGEST_MAX_STEP 10.f
 #define LARGEST_MIN_STEP 4.f
+//Maximum number of sampled timesteps read ahead of the integration window.
+//Fewer are read if the DataMgr cache is small.
+#define PREFETCH_DEPTH 2
 
 using namespace VetsUtil;
 using namespace VAPoR;
@@ -60,6 +65,7 @@ VaporFlow::VaporFlow(DataMgr* dm)
 	
 	bUseRandomSeeds = false;
 	periodicDim[0]= periodicDim[1]= periodicDim[2]= false;
+	prefetchMemBudgetMB = 256;
 
 }
 
@@ -579,6 +585,50 @@ bool VaporFlow::GenStreamLinesNoRake(FlowLineData* container,
 	return true;
 }
 
+//Dense seeding:  Only the end positions of the seeds are computed, so that a seed
+//can be placed at every point of a large lattice.  The lattice spans the
+//current rake extents.
+bool VaporFlow::GenFlowMap(int timestep, const size_t latticeDims[3], 
+	double integrationTime, int numSteps, float* endPositions)
+{
+	RegularGrid *pUGrid, *pVGrid, *pWGrid;
+	bool gotData = Get3GridData(timestep, xSteadyVarName, ySteadyVarName,
+		zSteadyVarName, minRegion, maxRegion, &pUGrid, &pVGrid, &pWGrid);
+	if (!gotData) return false;
+
+	//Lattice coordinates are in user coordinates, offset by time-varying extents:
+	const vector<double>& usrExts = dataMgr->GetExtents((size_t)timestep);
+	double latticeExts[6];
+	size_t latticeMin[3] = {0,0,0};
+	size_t latticeMax[3];
+	size_t bs[3];
+	RegularGrid* fieldGrid = pUGrid ? pUGrid : (pVGrid ? pVGrid : pWGrid);
+	fieldGrid->GetBlockSize(bs);
+	bool periodic[3] = {false, false, false};
+	for (int i = 0; i<3; i++){
+		latticeExts[i] = usrExts[i]+minLocalRakeExt[i];
+		latticeExts[i+3] = usrExts[i]+maxLocalRakeExt[i];
+		latticeMax[i] = latticeDims[i] > 0 ? latticeDims[i]-1 : 0;
+	}
+	//Dataless grid, only used for seed coordinates and tiling:
+	RegularGrid lattice(bs, latticeMin, latticeMax, latticeExts, periodic, NULL);
+
+	FlowMap flowMap;
+	flowMap.SetIntegrationTime(integrationTime*steadyUserTimeStepMultiplier);
+	flowMap.SetNumSteps(numSteps);
+	int rc = flowMap.Advect(pUGrid, pVGrid, pWGrid, &lattice, endPositions);
+
+	if(pUGrid)dataMgr->UnlockGrid(pUGrid);
+	if(pVGrid)dataMgr->UnlockGrid(pVGrid);
+	if(pWGrid)dataMgr->UnlockGrid(pWGrid);
+
+	if (rc < 0) {
+		MyBase::SetErrMsg(VAPOR_ERROR_FLOW, "Flow map computation failed");
+		return false;
+	}
+	return true;
+}
+
 void VaporFlow::SetPeriodicDimensions(bool xdim, bool ydim, bool zdim){
 	periodicDim[0] = xdim;
 	periodicDim[1] = ydim;
@@ -687,6 +737,14 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 		pWGrid = new RegularGrid*[numTimeSamples];
 		memset(pWGrid, 0, sizeof(float*)*numTimeSamples);
 	}
+	//Sliding window of unsteady field data.  Sampled timesteps beyond the current
+	//pair are read in the background while integration proceeds.
+	std::string unsteadyVarNames[3] = {xUnsteadyVarName, yUnsteadyVarName, zUnsteadyVarName};
+	FieldPrefetcher prefetcher(dataMgr, unsteadyVarNames, (int)numXForms, compressLevel,
+		minRegion, maxRegion, prefetchMemBudgetMB);
+	int minSampleIndex = Min(sampleStartIndex, sampleEndIndex);
+	int maxSampleIndex = Max(sampleStartIndex, sampleEndIndex);
+
 	pSolution = new Solution(pUGrid, pVGrid, pWGrid, numTimesteps, periodicDim);
 	pSolution->SetTimeScaleFactor((float)unsteadyUserTimeStepMultiplier);
 	
@@ -697,7 +755,9 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 	
 	// set the boundary of physical grid
 	//The region extents must be converted based on time-varying extents
-	const vector<double>& usrExts = dataMgr->GetExtents(startTimeStep);
+	prefetcher.LockDataMgr();
+	vector<double> usrExts = dataMgr->GetExtents(startTimeStep);
+	prefetcher.UnlockDataMgr();
 	double rMin[3],rMax[3];
 	for (int i = 0; i<3; i++){
 		rMin[i] = usrExts[i]+regionLocalExtents[i];
@@ -725,8 +785,10 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 	{
 		int prevSampledStep = unsteadyTimestepList[sampleIndex];
 		int nextSampledStep = unsteadyTimestepList[sampleIndex+timeDir];
+		prefetcher.LockDataMgr();
 		double prevTime = dataMgr->GetTSUserTime(prevSampledStep);
 		double nextTime = dataMgr->GetTSUserTime(nextSampledStep);
+		prefetcher.UnlockDataMgr();
 		pUserTimeSteps[tIndex] = (float)(nextTime - prevTime);
 
 		//following should make the value always positive
@@ -778,9 +840,12 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 		// get usertimestep differences between the current time step and previous and next sampled time steps
 		//Currently only one vapor time step is integrated at a time.
 		double diff = 0.0, curDiff = 0.0;
+		//The prefetcher may be reading from the DataMgr:
+		prefetcher.LockDataMgr();
 		double iforTime = dataMgr->GetTSUserTime(iFor);
 		double prevTime = dataMgr->GetTSUserTime(prevSample);
 		double nextTime = dataMgr->GetTSUserTime(nextSample);
+		prefetcher.UnlockDataMgr();
 		
 		diff = iforTime - prevTime;
 		curDiff = nextTime - iforTime; 
@@ -797,8 +862,7 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 		{
 			//For the very first sample time, get data for current time (get the next sampled timestep in next line)
 			if(iFor == startTimeStep){
-				bool gotData = Get3GridData(iFor, xUnsteadyVarName, yUnsteadyVarName,
-					zUnsteadyVarName, minRegion, maxRegion, &xGridPtr, &yGridPtr, &zGridPtr);
+				bool gotData = prefetcher.Get(iFor, &xGridPtr, &yGridPtr, &zGridPtr);
 				if(!gotData){
 					delete[] pUserTimeSteps;
 					delete pStreakLine;
@@ -813,9 +877,7 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 				//If it's not the very first time, need to release data for previous 
 				//time step, and move end ptrs to start:
 				//Now can release first pointers:
-				if(!zeroX)dataMgr->UnlockGrid(xGridPtr);
-				if(!zeroY)dataMgr->UnlockGrid(yGridPtr);
-				if(!zeroZ)dataMgr->UnlockGrid(zGridPtr);
+				prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
 				//And use them to save the second pointers:
 				xGridPtr = xGridPtr2;
 				yGridPtr = yGridPtr2;
@@ -824,16 +886,19 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 				pField->ClearSolutionGrid(tsIndex-1);
 			}
 			//now get data for second ( next) sampled timestep. 
-			bool gotData = Get3GridData(nextSample, xUnsteadyVarName,yUnsteadyVarName, zUnsteadyVarName, 
-				minRegion, maxRegion, &xGridPtr2, &yGridPtr2,&zGridPtr2);
+			bool gotData = prefetcher.Get(nextSample, &xGridPtr2, &yGridPtr2, &zGridPtr2);
+			//and queue the sampled timesteps that follow:
+			for (int ahead = 1; ahead <= Min(PREFETCH_DEPTH, prefetcher.GetDepth()); ahead++){
+				int aheadIndex = currIndex + (ahead+1)*timeDir;
+				if (aheadIndex < minSampleIndex || aheadIndex > maxSampleIndex) break;
+				prefetcher.Request(unsteadyTimestepList[aheadIndex]);
+			}
 			if(!gotData){
 				// if we failed:  release resources for 2 time steps:
 				delete[] pUserTimeSteps;
 				delete pStreakLine;
 				delete pField;
-				if (!zeroX && xGridPtr) dataMgr->UnlockGrid(xGridPtr);
-				if (!zeroY && yGridPtr) dataMgr->UnlockGrid(yGridPtr);
-				if (!zeroZ && zGridPtr) dataMgr->UnlockGrid(zGridPtr);
+				prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
 				return false;
 			}
 			pField->SetSolutionGrid(tsIndex+1,&xGridPtr2,&yGridPtr2, &zGridPtr2, periodicDim); 
@@ -853,12 +918,8 @@ bool VaporFlow::ExtendPathLines(PathLineData* container, int startTimeStep, int
 	
 	// release resources.  we always have valid start and end pointers
 	// at this point.
-	if(!zeroX) dataMgr->UnlockGrid(xGridPtr);
-	if(!zeroY) dataMgr->UnlockGrid(yGridPtr);
-	if(!zeroZ) dataMgr->UnlockGrid(zGridPtr);
-	if(!zeroX) dataMgr->UnlockGrid(xGridPtr2);
-	if(!zeroY) dataMgr->UnlockGrid(yGridPtr2);
-	if(!zeroZ) dataMgr->UnlockGrid(zGridPtr2);
+	prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
+	prefetcher.Release(xGridPtr2, yGridPtr2, zGridPtr2);
 	
 	pField->ClearSolutionGrid(tsIndex);
 	pField->ClearSolutionGrid(tsIndex+1);
@@ -941,6 +1002,14 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 		pWGrid = new RegularGrid*[numTimeSamples];
 		memset(pWGrid, 0, sizeof(float*)*numTimeSamples);
 	}
+	//Sliding window of unsteady field data.  Sampled timesteps beyond the current
+	//pair are read in the background while integration proceeds.
+	std::string unsteadyVarNames[3] = {xUnsteadyVarName, yUnsteadyVarName, zUnsteadyVarName};
+	FieldPrefetcher prefetcher(dataMgr, unsteadyVarNames, (int)numXForms, compressLevel,
+		minRegion, maxRegion, prefetchMemBudgetMB);
+	int minSampleIndex = Min(sampleStartIndex, sampleEndIndex);
+	int maxSampleIndex = Max(sampleStartIndex, sampleEndIndex);
+
 	pSolution = new Solution(pUGrid, pVGrid, pWGrid, numTimesteps, periodicDim);
 	
 	pSolution->SetTimeScaleFactor(unsteadyUserTimeStepMultiplier);
@@ -953,7 +1022,9 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 	
 	// set the boundary of physical grid
 	//The region extents must be converted based on time-varying extents
-	const vector<double>& usrExts = dataMgr->GetExtents(startTimeStep);
+	prefetcher.LockDataMgr();
+	vector<double> usrExts = dataMgr->GetExtents(startTimeStep);
+	prefetcher.UnlockDataMgr();
 	double rMin[3],rMax[3];
 	for (int i = 0; i<3; i++){
 		rMin[i] = usrExts[i]+regionLocalExtents[i];
@@ -982,8 +1053,10 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 		int prevSampledStep = unsteadyTimestepList[sampleIndex];
 		int nextSampledStep = unsteadyTimestepList[sampleIndex+timeDir];
 		
+		prefetcher.LockDataMgr();
 		double prevTime = dataMgr->GetTSUserTime(prevSampledStep);
 		double nextTime = dataMgr->GetTSUserTime(nextSampledStep);
+		prefetcher.UnlockDataMgr();
 		pUserTimeSteps[tIndex] = nextTime - prevTime;	
 
 		//following should make the value always positive
@@ -1043,9 +1116,12 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 		
 		// get usertimestep differences between the current time step and previous and next sampled time steps
 		double diff = 0.0, curDiff = 0.0;
+		//The prefetcher may be reading from the DataMgr:
+		prefetcher.LockDataMgr();
 		double iforTime = dataMgr->GetTSUserTime(iFor);
 		double prevTime = dataMgr->GetTSUserTime(prevSample);
 		double nextTime = dataMgr->GetTSUserTime(nextSample);
+		prefetcher.UnlockDataMgr();
 		
 		diff = iforTime - prevTime;
 		curDiff = nextTime - iforTime;
@@ -1062,15 +1138,13 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 		{
 			//For the very first sample time, get data for current time (get the next sampled timestep in next line)
 			if(iFor == startTimeStep){
-				bool gotData = Get3GridData(iFor, xUnsteadyVarName, yUnsteadyVarName,
-					zUnsteadyVarName, minRegion, maxRegion, &xGridPtr, &yGridPtr, &zGridPtr);
+				bool gotData = prefetcher.Get(iFor, &xGridPtr, &yGridPtr, &zGridPtr);
 				if(!gotData){
 					// release resources
 					delete[] pUserTimeSteps;
 					delete pStreakLine;
 					delete pField;
-					if (!zeroX && xGridPtr) dataMgr->UnlockGrid(xGridPtr);
-					if (!zeroY && yGridPtr) dataMgr->UnlockGrid(yGridPtr);
+					prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
 					return false;
 				}
 				pField->SetSolutionGrid(tsIndex,&xGridPtr,&yGridPtr,&zGridPtr, periodicDim);
@@ -1081,9 +1155,7 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 				//If it's not the very first time, need to release data for previous 
 				//time step, and move end ptrs to start:
 				//Now can release first pointers:
-				if(!zeroX) dataMgr->UnlockGrid(xGridPtr);
-				if(!zeroY) dataMgr->UnlockGrid(yGridPtr);
-				if(!zeroZ) dataMgr->UnlockGrid(zGridPtr);
+				prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
 				//And use them to save the second pointers:
 				xGridPtr = xGridPtr2;
 				yGridPtr = yGridPtr2;
@@ -1092,16 +1164,19 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 				pField->ClearSolutionGrid(tsIndex-1);
 			}
 			//now get data for second ( next) sampled timestep.
-			bool gotData = Get3GridData(nextSample, xUnsteadyVarName, yUnsteadyVarName,
-				zUnsteadyVarName, minRegion, maxRegion, &xGridPtr2, &yGridPtr2, &zGridPtr2);
+			bool gotData = prefetcher.Get(nextSample, &xGridPtr2, &yGridPtr2, &zGridPtr2);
+			//and queue the sampled timesteps that follow:
+			for (int ahead = 1; ahead <= Min(PREFETCH_DEPTH, prefetcher.GetDepth()); ahead++){
+				int aheadIndex = currIndex + (ahead+1)*timeDir;
+				if (aheadIndex < minSampleIndex || aheadIndex > maxSampleIndex) break;
+				prefetcher.Request(unsteadyTimestepList[aheadIndex]);
+			}
 			if (!gotData){
 				// if we failed:  release resources
 				delete[] pUserTimeSteps;
 				delete pStreakLine;
 				delete pField;
-				if (!zeroX && xGridPtr) dataMgr->UnlockGrid(xGridPtr);
-				if (!zeroY && yGridPtr) dataMgr->UnlockGrid(yGridPtr);
-				if (!zeroZ && zGridPtr) dataMgr->UnlockGrid(zGridPtr);
+				prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
 				return false;
 			}
 			pField->SetSolutionGrid(tsIndex+1,&xGridPtr2,&yGridPtr2,&zGridPtr2,periodicDim); 
@@ -1116,12 +1191,8 @@ bool VaporFlow::AdvectFieldLines(FlowLineData** flArray, int startTimeStep, int
 	
 	// release resources.  we always have valid start and end pointers
 	// at this point.
-	if(!zeroX)dataMgr->UnlockGrid(xGridPtr);
-	if(!zeroY)dataMgr->UnlockGrid(yGridPtr);
-	if(!zeroZ)dataMgr->UnlockGrid(zGridPtr);
-	if(!zeroX)dataMgr->UnlockGrid(xGridPtr2);
-	if(!zeroY)dataMgr->UnlockGrid(yGridPtr2);
-	if(!zeroZ)dataMgr->UnlockGrid(zGridPtr2);
+	prefetcher.Release(xGridPtr, yGridPtr, zGridPtr);
+	prefetcher.Release(xGridPtr2, yGridPtr2, zGridPtr2);
 	
 	pField->ClearSolutionGrid(tsIndex);
 	pField->ClearSolutionGrid(tsIndex+1);
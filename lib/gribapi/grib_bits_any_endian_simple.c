@@ -55,6 +55,8 @@ int grib_decode_long_array(const unsigned char* p, long *bitp, long bitsPerValue
 }
 
 
+#include "grib_bits_decode_fast.c"
+
 int grib_decode_double_array(const unsigned char* p, long *bitp, long bitsPerValue,
                              double reference_value,double s,double d,
                              size_t n_vals,double* val) {
@@ -62,6 +64,10 @@ int grib_decode_double_array(const unsigned char* p, long *bitp, long bitsPerVal
   unsigned long lvalue = 0;
   double x;
 
+  if(grib_decode_double_array_fast(p,bitp,bitsPerValue,reference_value,
+                                   s,d,n_vals,val) == 0)
+    return 0;
+
   if(bitsPerValue%8)
   {
     int j=0;
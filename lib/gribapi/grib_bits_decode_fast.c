@@ -0,0 +1,143 @@
+/*
+ * Copyright 2005-2014 ECMWF.
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * In applying this licence, ECMWF does not waive the privileges and immunities granted to it by
+ * virtue of its status as an intergovernmental organisation nor does it submit to any jurisdiction.
+ */
+
+/*
+ * Fast path of grib_decode_double_array for 8, 12, 16 and 24 bits per
+ * value, the widths of most simple packed fields. Values are unpacked a
+ * block at a time from whole bytes, with SSSE3 byte shuffles when the
+ * compiler targets them, and then scaled in a loop of their own that
+ * compilers vectorize. The scaling is the expression of the generic
+ * loops of grib_bits_any_endian_simple.c, so the values are identical.
+ *
+ * Included by grib_bits_any_endian_simple.c. Needs nothing from grib_api,
+ * so that the test programs can include it and compare it with the
+ * generic loops. Returns 0 if the values were decoded, and -1 if they
+ * are left to the generic loops.
+ */
+#include <stddef.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define DECODE_BLOCK_SIZE 512
+
+/* Unpack n values starting at p, where nbytes bytes of packed data are left */
+static void grib_unpack_block(const unsigned char* p, size_t nbytes,
+                              long bitsPerValue, size_t n, int* iv) {
+  size_t i=0;
+  const unsigned char* q;
+
+#if defined(__SSSE3__)
+  /* The vector loops read 16 bytes at a time */
+  switch(bitsPerValue) {
+  case 8:
+  {
+    __m128i zero = _mm_setzero_si128();
+    for(; i+16 <= n; i+=16) {
+      __m128i b = _mm_loadu_si128((const __m128i*)(p+i));
+      __m128i lo = _mm_unpacklo_epi8(b,zero);
+      __m128i hi = _mm_unpackhi_epi8(b,zero);
+      _mm_storeu_si128((__m128i*)(iv+i),   _mm_unpacklo_epi16(lo,zero));
+      _mm_storeu_si128((__m128i*)(iv+i+4), _mm_unpackhi_epi16(lo,zero));
+      _mm_storeu_si128((__m128i*)(iv+i+8), _mm_unpacklo_epi16(hi,zero));
+      _mm_storeu_si128((__m128i*)(iv+i+12),_mm_unpackhi_epi16(hi,zero));
+    }
+    break;
+  }
+  case 12:
+  {
+    /* Each lane takes the two bytes holding its value. Even values are
+       the high 12 bits of their pair, odd values the low 12 bits */
+    __m128i m0 = _mm_setr_epi8(1,0,-1,-1, 2,1,-1,-1, 4,3,-1,-1, 5,4,-1,-1);
+    __m128i m1 = _mm_setr_epi8(7,6,-1,-1, 8,7,-1,-1, 10,9,-1,-1, 11,10,-1,-1);
+    __m128i even = _mm_setr_epi32(-1,0,-1,0);
+    __m128i mask = _mm_set1_epi32(0xfff);
+    for(; i+8 <= n && (i/2)*3+16 <= nbytes; i+=8) {
+      __m128i b = _mm_loadu_si128((const __m128i*)(p+(i/2)*3));
+      __m128i v0 = _mm_shuffle_epi8(b,m0);
+      __m128i v1 = _mm_shuffle_epi8(b,m1);
+      v0 = _mm_or_si128(_mm_and_si128(even,_mm_srli_epi32(v0,4)),
+                        _mm_andnot_si128(even,_mm_and_si128(v0,mask)));
+      v1 = _mm_or_si128(_mm_and_si128(even,_mm_srli_epi32(v1,4)),
+                        _mm_andnot_si128(even,_mm_and_si128(v1,mask)));
+      _mm_storeu_si128((__m128i*)(iv+i),  v0);
+      _mm_storeu_si128((__m128i*)(iv+i+4),v1);
+    }
+    break;
+  }
+  case 16:
+  {
+    __m128i m0 = _mm_setr_epi8(1,0,-1,-1, 3,2,-1,-1, 5,4,-1,-1, 7,6,-1,-1);
+    __m128i m1 = _mm_setr_epi8(9,8,-1,-1, 11,10,-1,-1, 13,12,-1,-1, 15,14,-1,-1);
+    for(; i+8 <= n; i+=8) {
+      __m128i b = _mm_loadu_si128((const __m128i*)(p+i*2));
+      _mm_storeu_si128((__m128i*)(iv+i),  _mm_shuffle_epi8(b,m0));
+      _mm_storeu_si128((__m128i*)(iv+i+4),_mm_shuffle_epi8(b,m1));
+    }
+    break;
+  }
+  case 24:
+  {
+    __m128i m = _mm_setr_epi8(2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1);
+    for(; i+4 <= n && i*3+16 <= nbytes; i+=4) {
+      __m128i b = _mm_loadu_si128((const __m128i*)(p+i*3));
+      _mm_storeu_si128((__m128i*)(iv+i),_mm_shuffle_epi8(b,m));
+    }
+    break;
+  }
+  }
+#endif
+
+  switch(bitsPerValue) {
+  case 8:
+    for(; i < n; i++) iv[i] = p[i];
+    break;
+  case 12:
+    /* i is even here */
+    for(q = p+(i/2)*3; i+2 <= n; i+=2, q+=3) {
+      iv[i]   = (q[0] << 4) | (q[1] >> 4);
+      iv[i+1] = ((q[1] & 0x0f) << 8) | q[2];
+    }
+    if(i < n) iv[i] = (q[0] << 4) | (q[1] >> 4);
+    break;
+  case 16:
+    for(q = p+i*2; i < n; i++, q+=2) iv[i] = (q[0] << 8) | q[1];
+    break;
+  case 24:
+    for(q = p+i*3; i < n; i++, q+=3) iv[i] = (q[0] << 16) | (q[1] << 8) | q[2];
+    break;
+  }
+}
+
+static int grib_decode_double_array_fast(const unsigned char* p, long *bitp, long bitsPerValue,
+                             double reference_value,double s,double d,
+                             size_t n_vals,double* val) {
+  int iv[DECODE_BLOCK_SIZE];
+  size_t nbytes = (n_vals*bitsPerValue+7)/8;
+  size_t i,j,n,o;
+
+  if(*bitp != 0) return -1;
+  if(bitsPerValue != 8 && bitsPerValue != 12 &&
+     bitsPerValue != 16 && bitsPerValue != 24) return -1;
+
+  /* Blocks start on a whole byte, DECODE_BLOCK_SIZE being even */
+  for(j=0; j < n_vals; j+=n) {
+    n = n_vals-j < DECODE_BLOCK_SIZE ? n_vals-j : DECODE_BLOCK_SIZE;
+    o = j*bitsPerValue/8;
+    grib_unpack_block(p+o,nbytes-o,bitsPerValue,n,iv);
+    for(i=0; i < n; i++) val[j+i] = ((iv[i]*s)+reference_value)*d;
+  }
+
+  /* As the generic loop does for widths that aren't whole bytes */
+  if(bitsPerValue%8) *bitp += bitsPerValue*n_vals;
+
+  return 0;
+}
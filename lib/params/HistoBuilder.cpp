@@ -0,0 +1,392 @@
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <typeinfo>
+#include <vector>
+#include <vapor/CFuncs.h>
+#include <vapor/StretchedGrid.h>
+#include "HistoBuilder.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Number of private sub-histograms each thread counts into. Spreading
+// consecutive samples over several histograms avoids stalls when runs
+// of samples fall in the same bin.
+//
+#define NUM_SUBHISTOS 4
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunHistoBuilderThread(void *object) {
+		HistoBuilder::ThreadObj *X = (HistoBuilder::ThreadObj *) object;
+		X->HistoThread();
+		return(0);
+	}
+};
+
+HistoBuilder::HistoBuilder(int nthreads, int maxEntries) : _et(nthreads) {
+
+	_maxEntries = maxEntries < 1 ? 1 : maxEntries;
+
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_mvoxelsPerSec = 0.0;
+
+	_rg = NULL;
+	_exts = NULL;
+	_numBins = 0;
+	_rangeMin = 0.0;
+	_scale = 1.0;
+	_clipped = false;
+	_i0 = _i1 = _j0 = _j1 = _k0 = _k1 = 0;
+}
+
+int HistoBuilder::Build(
+	const RegularGrid *rg, const double exts[6], const float range[2],
+	int numBins, vector <int> &bins
+) {
+	if (numBins < 1) {
+		SetErrMsg("Invalid number of bins : %d", numBins);
+		return(-1);
+	}
+	bins.assign(numBins, 0);
+	if (! (range[0] < range[1])) return(0);
+
+	double t0 = GetTime();
+
+	_rg = rg;
+	_exts = exts;
+	_numBins = numBins;
+	_rangeMin = range[0];
+	_scale = (float) (numBins-1) / (range[1] - range[0]);
+	_clipped = _clip(rg, exts);
+
+	//
+	// Start no more threads than there are slabs
+	//
+	int nslabs = (int) (_k1 - _k0);
+	EasyThreads *et = &_et;
+	if (nslabs > 1 && nslabs < _nthreads) et = new EasyThreads(nslabs);
+	int nthreads = nslabs > 1 ? et->GetNumThreads() : 1;
+	if (nthreads < 1) nthreads = 1;
+
+	vector <ThreadObj *> objs;
+	for (int t=0; t<nthreads; t++) {
+		objs.push_back(new ThreadObj(this, t, nthreads, numBins));
+	}
+
+	int rc = 0;
+	if (nthreads <= 1) {
+		objs[0]->HistoThread();
+	}
+	else {
+		rc = et->ParRun(RunHistoBuilderThread, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+
+	for (int t=0; t<nthreads; t++) {
+		const vector <unsigned int> &tbins = objs[t]->GetBins();
+		for (int b=0; b<numBins; b++) bins[b] += tbins[b];
+		delete objs[t];
+	}
+	if (et != &_et) delete et;
+
+	double elapsed = GetTime() - t0;
+	double nvoxels = (double) (_i1-_i0) * (double) (_j1-_j0) * (double) nslabs;
+	_mvoxelsPerSec = elapsed > 0.0 ? nvoxels / elapsed * 1.0e-6 : 0.0;
+
+	_rg = NULL;
+	_exts = NULL;
+	return(rc < 0 ? -1 : 0);
+}
+
+//
+// Restrict the grid points visited to those inside the box, if the
+// grid coordinates allow it. Returns true if every grid point visited
+// is inside the box.
+//
+bool HistoBuilder::_clip(const RegularGrid *rg, const double exts[6]) {
+
+	size_t dims[3];
+	rg->GetDimensions(dims);
+
+	_i0 = _j0 = _k0 = 0;
+	_i1 = dims[0];
+	_j1 = dims[1];
+	_k1 = dims[2];
+
+	if (typeid(*rg) != typeid(RegularGrid) &&
+		typeid(*rg) != typeid(StretchedGrid)) {
+
+		return(false);
+	}
+
+	size_t *lo[3] = {&_i0, &_j0, &_k0};
+	size_t *hi[3] = {&_i1, &_j1, &_k1};
+	for (int axis=0; axis<3; axis++) {
+		size_t first = dims[axis];
+		size_t last = 0;
+		size_t count = 0;
+		for (size_t n=0; n<dims[axis]; n++) {
+			size_t ijk[3] = {0, 0, 0};
+			ijk[axis] = n;
+			double xyz[3];
+			rg->GetUserCoordinates(
+				ijk[0], ijk[1], ijk[2], &xyz[0], &xyz[1], &xyz[2]
+			);
+			if (xyz[axis] < exts[axis] || xyz[axis] > exts[axis+3]) continue;
+
+			if (n < first) first = n;
+			last = n;
+			count++;
+		}
+		if (! count) {
+			_i1 = _i0;
+			_j1 = _j0;
+			_k1 = _k0;
+			return(true);
+		}
+
+		// Coordinates aren't monotonic. Test every grid point.
+		//
+		if (count != last - first + 1) {
+			_i0 = _j0 = _k0 = 0;
+			_i1 = dims[0];
+			_j1 = dims[1];
+			_k1 = dims[2];
+			return(false);
+		}
+		*lo[axis] = first;
+		*hi[axis] = last + 1;
+	}
+	return(true);
+}
+
+HistoBuilder::ThreadObj::ThreadObj(
+	HistoBuilder *hb, int id, int nthreads, int numBins
+) {
+	_hb = hb;
+	_id = id;
+	_nthreads = nthreads;
+	_bins.assign(numBins, 0);
+}
+
+void HistoBuilder::ThreadObj::HistoThread() {
+
+	size_t bs[3], dims[3];
+	_hb->_rg->GetBlockSize(bs);
+	_hb->_rg->GetDimensions(dims);
+	vector <int> q(bs[0] > dims[0] ? bs[0] : dims[0]);
+
+	int numBins = _hb->_numBins;
+	size_t stride = numBins + 1;	// last bin counts missing values
+	vector <unsigned int> bins(NUM_SUBHISTOS * stride, 0);
+
+	for (size_t k = _hb->_k0 + _id; k < _hb->_k1; k += _nthreads) {
+		if (_hb->_clipped) _hb->_histoSlab(k, q, &bins[0]);
+		else _hb->_histoSlabTest(k, q, &bins[0]);
+	}
+
+	for (int s=0; s<NUM_SUBHISTOS; s++) {
+		for (int b=0; b<numBins; b++) _bins[b] += bins[s*stride + b];
+	}
+}
+
+//
+// Histogram one slab (constant k) of the grid points inside the box,
+// a block-contiguous run of each line at a time
+//
+void HistoBuilder::_histoSlab(
+	size_t k, vector <int> &q, unsigned int *bins
+) const {
+
+	size_t origin[3], dims[3], bs[3];
+	_rg->GetIJKOrigin(origin);
+	_rg->GetDimensions(dims);
+	_rg->GetBlockSize(bs);
+	float **blks = _rg->GetBlks();
+
+	//
+	// The grid's first block starts goff voxels before the grid origin
+	//
+	size_t goff[3], gbdim[3];
+	for (int i=0; i<3; i++) {
+		goff[i] = origin[i] % bs[i];
+		gbdim[i] = (goff[i] + dims[i] - 1) / bs[i] + 1;
+	}
+
+	size_t kk = k + goff[2];
+	size_t gbz = kk / bs[2];
+	size_t zoff = kk % bs[2];
+
+	for (size_t j = _j0; j < _j1; j++) {
+		size_t jj = j + goff[1];
+		size_t gby = jj / bs[1];
+		size_t yoff = jj % bs[1];
+
+		for (size_t i = _i0; i < _i1; ) {
+			size_t ii = i + goff[0];
+			size_t gbx = ii / bs[0];
+			size_t xoff = ii % bs[0];
+
+			size_t n = bs[0] - xoff;
+			if (n > _i1 - i) n = _i1 - i;
+
+			const float *line = blks[(gbz*gbdim[1] + gby)*gbdim[0] + gbx] +
+				(zoff*bs[1] + yoff)*bs[0] + xoff;
+
+			_quantize(line, n, &q[0]);
+			_count(&q[0], n, bins);
+			i += n;
+		}
+	}
+}
+
+//
+// Histogram one slab (constant k) of a grid whose coordinates can't
+// be clipped in index space, testing the coordinates of each grid point
+//
+void HistoBuilder::_histoSlabTest(
+	size_t k, vector <int> &q, unsigned int *bins
+) const {
+
+	size_t dims[3];
+	_rg->GetDimensions(dims);
+
+	vector <float> values(dims[0]);
+	for (size_t j = 0; j < dims[1]; j++) {
+		size_t n = 0;
+		for (size_t i = 0; i < dims[0]; i++) {
+			double x, y, z;
+			_rg->GetUserCoordinates(i, j, k, &x, &y, &z);
+			if (x < _exts[0] || x > _exts[3] ||
+				y < _exts[1] || y > _exts[4] ||
+				z < _exts[2] || z > _exts[5]) continue;
+
+			values[n++] = _rg->AccessIJK(i, j, k);
+		}
+		_quantize(&values[0], n, &q[0]);
+		_count(&q[0], n, bins);
+	}
+}
+
+//
+// Map values to bins. Missing values (and NaNs) map to bin numBins. The
+// loop has no branches so that the compiler can vectorize it.
+//
+// Positions are rounded to the nearest bin, ties to the even one, as
+// rint() did, by comparing the fraction with one half, which is exact.
+// Adding 0.5 and truncating is not: the sum is itself rounded, so
+// positions just below one half land in the next bin.
+//
+void HistoBuilder::_quantize(const float *v, size_t n, int *q) const {
+
+	float mv = _rg->GetMissingValue();
+	float rmin = _rangeMin;
+	float scale = _scale;
+	float qmax = (float) (_numBins - 1);
+	int skip = _numBins;
+
+	for (size_t i = 0; i < n; i++) {
+		float x = (v[i] - rmin) * scale;
+		x = x > 0.f ? x : 0.f;
+		x = x < qmax ? x : qmax;
+		int qi = (int) x;
+		float f = x - (float) qi;
+		qi += (f > 0.5f) | ((f == 0.5f) & (qi & 1));
+		q[i] = (v[i] == mv || v[i] != v[i]) ? skip : qi;
+	}
+}
+
+void HistoBuilder::_count(const int *q, size_t n, unsigned int *bins) const {
+
+	size_t stride = _numBins + 1;
+	unsigned int *b0 = bins;
+	unsigned int *b1 = bins + stride;
+	unsigned int *b2 = bins + 2*stride;
+	unsigned int *b3 = bins + 3*stride;
+
+	size_t i = 0;
+	for (; i+4 <= n; i += 4) {
+		b0[q[i]]++;
+		b1[q[i+1]]++;
+		b2[q[i+2]]++;
+		b3[q[i+3]]++;
+	}
+	for (; i < n; i++) b0[q[i]]++;
+}
+
+bool HistoBuilder::Find(
+	size_t ts, const string &varname, int reflevel, int lod,
+	const size_t min[3], const size_t max[3], const double exts[6],
+	const float range[2], int numBins, vector <int> &bins
+) {
+	std::list <Entry>::iterator itr;
+	for (itr = _entries.begin(); itr != _entries.end(); ++itr) {
+		const Entry &e = *itr;
+		if (e._ts != ts || e._reflevel != reflevel || e._lod != lod) continue;
+		if (e._varname != varname) continue;
+		if (e._bins.size() != numBins) continue;
+		if (e._range[0] != range[0] || e._range[1] != range[1]) continue;
+
+		bool match = true;
+		for (int i=0; i<3; i++) {
+			if (e._min[i] != min[i] || e._max[i] != max[i]) match = false;
+		}
+		for (int i=0; i<6; i++) {
+			if (e._exts[i] != exts[i]) match = false;
+		}
+		if (match) break;
+	}
+	if (itr == _entries.end()) return(false);
+
+	// Move to the front of the list
+	//
+	if (itr != _entries.begin()) {
+		_entries.splice(_entries.begin(), _entries, itr);
+	}
+	bins = _entries.front()._bins;
+	return(true);
+}
+
+void HistoBuilder::Insert(
+	size_t ts, const string &varname, int reflevel, int lod,
+	const size_t min[3], const size_t max[3], const double exts[6],
+	const float range[2], const vector <int> &bins
+) {
+	vector <int> dummy;
+	if (Find(ts, varname, reflevel, lod, min, max, exts, range, bins.size(), dummy)) {
+		_entries.pop_front();
+	}
+
+	_entries.push_front(Entry());
+	Entry &e = _entries.front();
+	e._ts = ts;
+	e._varname = varname;
+	e._reflevel = reflevel;
+	e._lod = lod;
+	for (int i=0; i<3; i++) {
+		e._min[i] = min[i];
+		e._max[i] = max[i];
+	}
+	for (int i=0; i<6; i++) e._exts[i] = exts[i];
+	e._range[0] = range[0];
+	e._range[1] = range[1];
+	e._bins = bins;
+
+	while ((int) _entries.size() > _maxEntries) _entries.pop_back();
+}
+
+void HistoBuilder::Purge(const string &varname) {
+	std::list <Entry>::iterator itr;
+	for (itr = _entries.begin(); itr != _entries.end(); ) {
+		if (itr->_varname == varname) itr = _entries.erase(itr);
+		else ++itr;
+	}
+}
@@ -0,0 +1,167 @@
+//	File:		HistoBuilder.h
+//
+//	Description:	Parallel computation of the data histograms displayed
+//					behind transfer functions, and a cache of the
+//					results.
+//
+
+#ifndef _HistoBuilder_h_
+#define _HistoBuilder_h_
+
+#include <list>
+#include <vector>
+#include <string>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class HistoBuilder
+//! \brief Computes histograms of the grid points inside a box
+//!
+//! Values are quantized to \a numBins bins spanning a data range; values
+//! outside of the range are counted in the first or last bin, and
+//! missing values are ignored. Bin \a i counts the values whose
+//! quantized position, (v-min)/(max-min)*(numBins-1), rounds to \a i.
+//! Positions exactly half way between two bins round up.
+//!
+//! For grids whose coordinates vary along one axis at a time (regular and
+//! stretched grids) the box is clipped in index space before the grid is
+//! visited, and no coordinates are computed per grid point. Other grids
+//! test the user coordinates of each grid point. Grid points are
+//! visited a storage block at a time, and each thread counts into
+//! private histograms that are summed at the end.
+//!
+//! The builder also keeps the most recently computed histograms, keyed
+//! by everything that determines them, so that histograms may be
+//! redisplayed without reading data.
+//
+class PARAMS_API HistoBuilder : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //! \param[in] maxEntries Maximum number of histograms cached
+ //
+ HistoBuilder(int nthreads = 0, int maxEntries = 64);
+ virtual ~HistoBuilder() {}
+
+ //! Histogram the grid points inside a box
+ //!
+ //! \param[in] rg Grid to histogram
+ //! \param[in] exts Box, in user coordinates (min x,y,z then max x,y,z)
+ //! \param[in] range Data range spanned by the bins. If range[0] >=
+ //! range[1] all bins are zero.
+ //! \param[in] numBins Number of bins
+ //! \param[out] bins The \p numBins bin counts
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Build(
+	const RegularGrid *rg, const double exts[6], const float range[2],
+	int numBins, std::vector <int> &bins
+ );
+
+ //! Look up a cached histogram
+ //!
+ //! The histogram of variable \p varname at time step \p ts, refinement
+ //! level \p reflevel and level of detail \p lod, restricted to the
+ //! voxels \p min through \p max and the box \p exts, with bins spanning
+ //! \p range, is returned if it was previously added with Insert().
+ //!
+ //! \retval found true if the histogram was found, in which case it
+ //! becomes the most recently used one. \p bins is not modified otherwise.
+ //
+ bool Find(
+	size_t ts, const std::string &varname, int reflevel, int lod,
+	const size_t min[3], const size_t max[3], const double exts[6],
+	const float range[2], int numBins, std::vector <int> &bins
+ );
+
+ //! Add a histogram to the cache, discarding the least recently used
+ //! one if the cache is full
+ //!
+ //! \sa Find()
+ //
+ void Insert(
+	size_t ts, const std::string &varname, int reflevel, int lod,
+	const size_t min[3], const size_t max[3], const double exts[6],
+	const float range[2], const std::vector <int> &bins
+ );
+
+ //! Discard the cached histograms of a variable
+ //
+ void Purge(const std::string &varname);
+
+ //! Discard all cached histograms
+ //
+ void Clear() { _entries.clear(); }
+
+ int GetNumEntries() const { return((int) _entries.size()); }
+
+ //! Return the throughput of the last call to Build(), in millions
+ //! of grid points per second
+ //
+ double GetMVoxelsPerSec() const { return(_mvoxelsPerSec); }
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(HistoBuilder *hb, int id, int nthreads, int numBins);
+	void HistoThread();
+	const std::vector <unsigned int> &GetBins() const { return(_bins); }
+ private:
+	HistoBuilder *_hb;
+	int _id;	// thread id
+	int _nthreads;	// # of threads sharing the slabs
+	std::vector <unsigned int> _bins;
+ };
+
+private:
+ class Entry {
+ public:
+	size_t _ts;
+	std::string _varname;
+	int _reflevel;
+	int _lod;
+	size_t _min[3];
+	size_t _max[3];
+	double _exts[6];
+	float _range[2];
+	std::vector <int> _bins;
+ };
+
+ std::list <Entry> _entries;	// most recently used first
+ int _maxEntries;
+
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+ double _mvoxelsPerSec;
+
+ //
+ // State shared by the thread objects for the current histogram
+ //
+ const RegularGrid *_rg;
+ const double *_exts;
+ int _numBins;
+ float _rangeMin;
+ float _scale;			// maps range to 0..numBins-1
+ bool _clipped;			// box clipped in index space?
+ size_t _i0, _i1;		// grid points visited, relative to grid origin,
+ size_t _j0, _j1;		// from i0 up to but not including i1, etc.
+ size_t _k0, _k1;
+
+ bool _clip(const RegularGrid *rg, const double exts[6]);
+ void _histoSlab(size_t k, std::vector <int> &q, unsigned int *bins) const;
+ void _histoSlabTest(size_t k, std::vector <int> &q, unsigned int *bins) const;
+ void _quantize(const float *v, size_t n, int *q) const;
+ void _count(const int *q, size_t n, unsigned int *bins) const;
+};
+
+};
+
+#endif	// _HistoBuilder_h_
@@ -0,0 +1,293 @@
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include "IBFVFieldCache.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunIBFVAdvectThread(void *object) {
+		IBFVFieldCache::ThreadObj *X = (IBFVFieldCache::ThreadObj *) object;
+		X->AdvectThread();
+		return(0);
+	}
+};
+
+IBFVFieldCache::IBFVFieldCache(int maxEntries, int nthreads) : _et(nthreads) {
+
+	_maxEntries = maxEntries < 1 ? 1 : maxEntries;
+
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_width = 0;
+	_height = 0;
+	_u = NULL;
+	_v = NULL;
+	_fieldScale = 1.0;
+	_nmesh = 0;
+	_mesh = NULL;
+}
+
+void IBFVFieldCache::SetMaxEntries(int maxEntries) {
+	_maxEntries = maxEntries < 1 ? 1 : maxEntries;
+	while ((int) _entries.size() > _maxEntries) _entries.pop_back();
+}
+
+std::list <IBFVFieldCache::Entry>::iterator IBFVFieldCache::_find(
+	size_t ts, const vector <double> &key, int width, int height
+) {
+	std::list <Entry>::iterator itr;
+	for (itr = _entries.begin(); itr != _entries.end(); ++itr) {
+		if (itr->_ts == ts && itr->_width == width &&
+			itr->_height == height && itr->_key == key) break;
+	}
+	return(itr);
+}
+
+void IBFVFieldCache::MakeKey(
+	const float transform[12], const double angles[3], const int varNums[3],
+	int refLevel, int lod, vector <double> &key
+) {
+	key.clear();
+	for (int i=0; i<12; i++) key.push_back(transform[i]);
+	for (int i=0; i<3; i++) key.push_back(angles[i]);
+	for (int i=0; i<3; i++) key.push_back(varNums[i]);
+	key.push_back(refLevel);
+	key.push_back(lod);
+}
+
+bool IBFVFieldCache::Find(
+	size_t ts, const vector <double> &key, int width, int height,
+	float *u, float *v, unsigned char *valid, float *mag
+) {
+	std::list <Entry>::iterator itr = _find(ts, key, width, height);
+	if (itr == _entries.end()) return(false);
+
+	// Move to the front of the list
+	//
+	if (itr != _entries.begin()) {
+		_entries.splice(_entries.begin(), _entries, itr);
+	}
+	const Entry &e = _entries.front();
+
+	size_t n = (size_t) width * (size_t) height;
+	for (size_t i=0; i<n; i++) {
+		u[i] = HalfToFloat(e._u[i]) * e._scale;
+		v[i] = HalfToFloat(e._v[i]) * e._scale;
+	}
+	memcpy(valid, &e._valid[0], n);
+	*mag = e._mag;
+	return(true);
+}
+
+void IBFVFieldCache::Insert(
+	size_t ts, const vector <double> &key, int width, int height,
+	const float *u, const float *v, const unsigned char *valid, float mag
+) {
+	std::list <Entry>::iterator itr = _find(ts, key, width, height);
+	if (itr != _entries.end()) _entries.erase(itr);
+
+	_entries.push_front(Entry());
+	Entry &e = _entries.front();
+
+	size_t n = (size_t) width * (size_t) height;
+	e._ts = ts;
+	e._key = key;
+	e._width = width;
+	e._height = height;
+	e._mag = mag;
+
+	float maxAbs = 0.0;
+	for (size_t i=0; i<n; i++) {
+		if (fabs(u[i]) > maxAbs) maxAbs = fabs(u[i]);
+		if (fabs(v[i]) > maxAbs) maxAbs = fabs(v[i]);
+	}
+	e._scale = maxAbs > 0.0 ? maxAbs : 1.0;
+
+	float rscale = 1.0 / e._scale;
+	e._u.resize(n);
+	e._v.resize(n);
+	for (size_t i=0; i<n; i++) {
+		e._u[i] = FloatToHalf(u[i] * rscale);
+		e._v[i] = FloatToHalf(v[i] * rscale);
+	}
+	e._valid.assign(valid, valid + n);
+
+	while ((int) _entries.size() > _maxEntries) _entries.pop_back();
+}
+
+size_t IBFVFieldCache::GetMemSize() const {
+	size_t size = 0;
+	std::list <Entry>::const_iterator itr;
+	for (itr = _entries.begin(); itr != _entries.end(); ++itr) {
+		size += itr->_u.size() * sizeof(itr->_u[0]);
+		size += itr->_v.size() * sizeof(itr->_v[0]);
+		size += itr->_valid.size();
+	}
+	return(size);
+}
+
+void IBFVFieldCache::AdvectMesh(
+	int width, int height, const float *u, const float *v,
+	float fieldScale, int nmesh, float *mesh
+) {
+	if (nmesh < 2) return;
+
+	_width = width;
+	_height = height;
+	_u = u;
+	_v = v;
+	_fieldScale = fieldScale;
+	_nmesh = nmesh;
+	_mesh = mesh;
+
+	vector <ThreadObj *> objs;
+	for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+	int rc = 0;
+	if (_nthreads <= 1 || nmesh < _nthreads) {
+		for (int i=0; i<nmesh; i++) _advectColumn(i);
+	}
+	else {
+		rc = _et.ParRun(RunIBFVAdvectThread, (void **) &objs[0]);
+	}
+	if (rc < 0) {
+		// Couldn't spawn threads, do it here
+		//
+		for (int i=0; i<nmesh; i++) _advectColumn(i);
+	}
+	for (int t=0; t<_nthreads; t++) delete objs[t];
+
+	_u = _v = NULL;
+	_mesh = NULL;
+}
+
+void IBFVFieldCache::ThreadObj::AdvectThread() {
+	for (int i = _id; i < _fc->_nmesh; i += _fc->_nthreads) {
+		_fc->_advectColumn(i);
+	}
+}
+
+void IBFVFieldCache::_advectColumn(int i) const {
+
+	int nmesh = _nmesh;
+	float DM = ((float) (0.999999/(nmesh-1.0)));
+	float xa = DM*i;
+
+	float x = xa * (float)(_width-1);
+	int x0 = (int) x;
+	float xfrac = x - floor(x);
+	float maxDisp2 = 16.f*_fieldScale*_fieldScale/(_width*_height);
+
+	float *mesh = _mesh + 2*nmesh*i;
+	for (int j = 0; j < nmesh; j++, mesh += 2) {
+		float ya = DM*j;
+		assert(xa >= 0.f && ya >= 0.f && xa < 1.f && ya < 1.f);
+
+		float y = ya * (float)(_height-1);
+		int y0 = (int) y;
+		float yfrac = y - floor(y);
+
+		int p00 = x0 + _width*y0;
+		int p01 = p00 + _width;
+
+		float u00 = _u[p00];
+		float u10 = _u[p00+1];
+		float u11 = _u[p01+1];
+		float u01 = _u[p01];
+		float uval = (1.-xfrac)*((1.-yfrac)*u00+yfrac*u01)+
+			xfrac*((1.-yfrac)*u10+yfrac*u11);
+
+		float v00 = _v[p00];
+		float v10 = _v[p00+1];
+		float v11 = _v[p01+1];
+		float v01 = _v[p01];
+		float vval = (1.-xfrac)*((1.-yfrac)*v00+yfrac*v01)+
+			xfrac*((1.-yfrac)*v10+yfrac*v11);
+
+		float r = uval*uval+vval*vval;
+		if (r > maxDisp2) {
+			r = sqrt(r);
+			uval *= 4.f*_fieldScale/(_width*r);
+			vval *= 4.f*_fieldScale/(_height*r);
+		}
+		mesh[0] = xa + uval;
+		mesh[1] = ya + vval;
+	}
+}
+
+//
+// IEEE 754 binary16 conversions, rounding to nearest even
+//
+unsigned short IBFVFieldCache::FloatToHalf(float f) {
+	unsigned int bits;
+	memcpy(&bits, &f, sizeof(bits));
+
+	unsigned short sign = (unsigned short) ((bits >> 16) & 0x8000);
+	int exp = (int) ((bits >> 23) & 0xff);
+	unsigned int mant = bits & 0x7fffff;
+
+	if (exp == 0xff) {	// Inf or NaN
+		return(sign | 0x7c00 | (mant ? 0x200 : 0));
+	}
+
+	exp = exp - 127 + 15;
+	if (exp >= 0x1f) return(sign | 0x7c00);	// overflow to Inf
+
+	if (exp <= 0) {	// subnormal or zero
+		if (exp < -10) return(sign);
+		mant |= 0x800000;
+		int shift = 14 - exp;
+		unsigned int half = mant >> shift;
+		unsigned int rem = mant & ((1u << shift) - 1);
+		unsigned int mid = 1u << (shift - 1);
+		if (rem > mid || (rem == mid && (half & 1))) half++;
+		return(sign | (unsigned short) half);
+	}
+
+	unsigned int half = ((unsigned int) exp << 10) | (mant >> 13);
+	unsigned int rem = mant & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;	// may carry into Inf
+	return(sign | (unsigned short) half);
+}
+
+float IBFVFieldCache::HalfToFloat(unsigned short h) {
+	unsigned int sign = (unsigned int) (h & 0x8000) << 16;
+	int exp = (h >> 10) & 0x1f;
+	unsigned int mant = h & 0x3ff;
+	unsigned int bits;
+
+	if (exp == 0x1f) {
+		bits = sign | 0x7f800000 | (mant << 13);
+	}
+	else if (exp == 0) {
+		if (mant == 0) {
+			bits = sign;
+		}
+		else {	// normalize subnormal
+			exp = 1;
+			while (! (mant & 0x400)) {
+				mant <<= 1;
+				exp--;
+			}
+			mant &= 0x3ff;
+			bits = sign | ((unsigned int) (exp - 15 + 127) << 23) | (mant << 13);
+		}
+	}
+	else {
+		bits = sign | ((unsigned int) (exp - 15 + 127) << 23) | (mant << 13);
+	}
+
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return(f);
+}
@@ -0,0 +1,178 @@
+//	File:		IBFVFieldCache.h
+//
+//	Description:	Bounded cache of the projected 2D vector fields used
+//					by the probe's image based flow visualization (IBFV),
+//					and parallel advection of the IBFV mesh.
+//
+
+#ifndef _IBFVFieldCache_h_
+#define _IBFVFieldCache_h_
+
+#include <list>
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class IBFVFieldCache
+//! \brief Keeps the most recently used IBFV fields in a compact form
+//!
+//! Each entry holds the u and v components of a field projected onto
+//! the probe plane, together with a per-texel validity flag, for one
+//! time step and one probe configuration. The probe configuration is
+//! described by an arbitrary vector of doubles (the key): entries are
+//! only found if the key matches exactly, so anything that affects the
+//! field (probe transform, texture size, refinement, variables) must be
+//! part of it.
+//!
+//! Components are stored as half precision floats scaled by the largest
+//! component magnitude of the field, i.e. with a relative error of about
+//! 5e-4 of the largest vector. The number of entries is bounded; the least
+//! recently used entry is discarded when the bound is exceeded.
+//
+class PARAMS_API IBFVFieldCache : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] maxEntries Maximum number of fields retained
+ //! \param[in] nthreads Number of threads used by AdvectMesh(). If less
+ //! than one the number of available processors is used.
+ //
+ IBFVFieldCache(int maxEntries = 16, int nthreads = 0);
+ virtual ~IBFVFieldCache() {}
+
+ //! Change the maximum number of entries, discarding the least recently
+ //! used ones if necessary
+ //
+ void SetMaxEntries(int maxEntries);
+ int GetMaxEntries() const { return(_maxEntries); }
+
+ //! Discard all entries
+ //
+ void Clear() { _entries.clear(); }
+
+ //! Build the key of a probe configuration
+ //!
+ //! \param[in] transform Probe to volume transform
+ //! \param[in] angles Probe rotation angles
+ //! \param[in] varNums Session variable numbers of the field components
+ //! \param[in] refLevel Refinement level
+ //! \param[in] lod Level of detail
+ //! \param[out] key Key of the configuration
+ //
+ static void MakeKey(
+	const float transform[12], const double angles[3], const int varNums[3],
+	int refLevel, int lod, std::vector <double> &key
+ );
+
+ //! Look up a field
+ //!
+ //! \param[in] ts Time step
+ //! \param[in] key Probe configuration
+ //! \param[in] width Width of the field
+ //! \param[in] height Height of the field
+ //! \param[out] u,v width*height components of the field
+ //! \param[out] valid width*height validity flags
+ //! \param[out] mag Magnitude recorded by Insert()
+ //!
+ //! \retval found true if the field was in the cache, in which case it
+ //! becomes the most recently used entry. Outputs are not modified
+ //! otherwise.
+ //
+ bool Find(
+	size_t ts, const std::vector <double> &key, int width, int height,
+	float *u, float *v, unsigned char *valid, float *mag
+ );
+
+ //! Add a field, replacing any entry with the same time step and key
+ //!
+ //! \param[in] mag A magnitude associated with the field, returned by
+ //! Find()
+ //
+ void Insert(
+	size_t ts, const std::vector <double> &key, int width, int height,
+	const float *u, const float *v, const unsigned char *valid, float mag
+ );
+
+ //! Return the number of fields currently cached
+ //
+ int GetNumEntries() const { return((int) _entries.size()); }
+
+ //! Return the number of bytes of field data held by the cache
+ //
+ size_t GetMemSize() const;
+
+ //! Advect the vertices of the IBFV mesh through a field
+ //!
+ //! The mesh has \p nmesh by \p nmesh vertices spaced
+ //! 0.999999/(nmesh-1) apart in texture coordinates (0..1). Each vertex
+ //! (x,y) is displaced by the bilinearly interpolated field, with the
+ //! displacement clamped to a length of 4*fieldScale texels, as
+ //! ProbeParams::getIBFVValue() does for a single point.
+ //!
+ //! \param[in] width,height Dimensions of the field
+ //! \param[in] u,v Components of the field, in texture coordinates
+ //! \param[in] fieldScale Probe field scale
+ //! \param[in] nmesh Number of mesh vertices along each axis
+ //! \param[out] mesh 2*nmesh*nmesh advected (x,y) positions. The
+ //! vertex for mesh column \a i, row \a j is at 2*(j + nmesh*i).
+ //
+ void AdvectMesh(
+	int width, int height, const float *u, const float *v,
+	float fieldScale, int nmesh, float *mesh
+ );
+
+ static unsigned short FloatToHalf(float f);
+ static float HalfToFloat(unsigned short h);
+
+ class ThreadObj {
+ public:
+	ThreadObj(IBFVFieldCache *fc, int id) { _fc = fc; _id = id; }
+	void AdvectThread();
+ private:
+	IBFVFieldCache *_fc;
+	int _id;	// thread id
+ };
+
+private:
+ class Entry {
+ public:
+	size_t _ts;
+	std::vector <double> _key;
+	int _width;
+	int _height;
+	float _mag;
+	float _scale;	// multiplies the stored components
+	std::vector <unsigned short> _u;
+	std::vector <unsigned short> _v;
+	std::vector <unsigned char> _valid;
+ };
+
+ std::list <Entry> _entries;	// most recently used first
+ int _maxEntries;
+
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+
+ //
+ // State shared by the thread objects during AdvectMesh()
+ //
+ int _width;
+ int _height;
+ const float *_u;
+ const float *_v;
+ float _fieldScale;
+ int _nmesh;
+ float *_mesh;
+
+ std::list <Entry>::iterator _find(
+	size_t ts, const std::vector <double> &key, int width, int height
+ );
+ void _advectColumn(int i) const;
+};
+
+};
+
+#endif	// _IBFVFieldCache_h_
@@ -0,0 +1,224 @@
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cstring>
+#include <vector>
+#include <vapor/CFuncs.h>
+#include <vapor/MapperFunctionBase.h>
+#include "TextureBuilder.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Number of texture rows handed to a thread at a time
+//
+#define BAND_HEIGHT 8
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunTextureBuilderThread(void *object) {
+		TextureBuilder::ThreadObj *X = (TextureBuilder::ThreadObj *) object;
+		X->RowThread();
+		return(0);
+	}
+};
+
+TextureBuilder::TextureBuilder(int nthreads) : _et(nthreads) {
+
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_numEntries = 0;
+	_minValue = 0.0;
+	_maxValue = 1.0;
+	_mtexelsPerSec = 0.0;
+
+	for (int i=0; i<3; i++) _grids[i] = NULL;
+	_mapper = NULL;
+	_width = 0;
+	_height = 0;
+	_texture = NULL;
+	_values = NULL;
+	_valid = NULL;
+}
+
+void TextureBuilder::SetLut(
+	const float *clut, int numEntries, float minValue, float maxValue
+) {
+	_numEntries = numEntries;
+	_minValue = minValue;
+	_maxValue = maxValue;
+
+	_lut.resize(4*numEntries);
+	for (int i=0; i<4*numEntries; i++) {
+		_lut[i] = (unsigned char)(0.5+ clut[i]*255.f);
+	}
+}
+
+int TextureBuilder::Build(
+	const RegularGrid *grid, const TexelMapper *mapper,
+	int width, int height, unsigned char *texture
+) {
+	if (_numEntries < 1) {
+		SetErrMsg("Lookup table not set");
+		return(-1);
+	}
+	if (width < 1 || height < 1) return(0);
+
+	_grids[0] = grid;
+	_grids[1] = _grids[2] = NULL;
+	_texture = texture;
+
+	int rc = _run(mapper, width, height);
+
+	_texture = NULL;
+	return(rc);
+}
+
+int TextureBuilder::Sample(
+	const RegularGrid *const grids[3], const TexelMapper *mapper,
+	int width, int height, float *values, unsigned char *valid
+) {
+	if (width < 1 || height < 1) return(0);
+
+	for (int i=0; i<3; i++) _grids[i] = grids[i];
+	_values = values;
+	_valid = valid;
+
+	int rc = _run(mapper, width, height);
+
+	_values = NULL;
+	_valid = NULL;
+	return(rc);
+}
+
+int TextureBuilder::_run(const TexelMapper *mapper, int width, int height) {
+
+	_mapper = mapper;
+	_width = width;
+	_height = height;
+
+	double t0 = GetTime();
+
+	//
+	// Start no more threads than there are bands of rows
+	//
+	int nbands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	EasyThreads *et = &_et;
+	if (nbands > 1 && nbands < _nthreads) et = new EasyThreads(nbands);
+	int nthreads = nbands > 1 ? et->GetNumThreads() : 1;
+	if (nthreads < 1) nthreads = 1;
+
+	vector <ThreadObj *> objs;
+	for (int t=0; t<nthreads; t++) {
+		objs.push_back(new ThreadObj(this, t, nthreads));
+	}
+
+	int rc = 0;
+	if (nthreads <= 1) {
+		objs[0]->RowThread();
+	}
+	else {
+		rc = et->ParRun(RunTextureBuilderThread, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+	for (int t=0; t<nthreads; t++) delete objs[t];
+	if (et != &_et) delete et;
+
+	double elapsed = GetTime() - t0;
+	_mtexelsPerSec = elapsed > 0.0 ?
+		(double) width * (double) height / elapsed * 1.0e-6 : 0.0;
+
+	for (int i=0; i<3; i++) _grids[i] = NULL;
+	_mapper = NULL;
+	return(rc < 0 ? -1 : 0);
+}
+
+void TextureBuilder::ThreadObj::RowThread() {
+
+	int width = _tb->_width;
+	int height = _tb->_height;
+	int nbands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+	vector <double> coords(3*width);
+	bool *valid = new bool[width];	// not vector<bool>: bit packed
+	vector <float> values(width);
+
+	for (int band = _id; band < nbands; band += _nthreads) {
+		int iy0 = band * BAND_HEIGHT;
+		int iy1 = iy0 + BAND_HEIGHT;
+		if (iy1 > height) iy1 = height;
+		for (int iy = iy0; iy < iy1; iy++) {
+			if (_tb->_texture) {
+				_tb->_buildRow(iy, &coords[0], valid, &values[0]);
+			}
+			else {
+				_tb->_sampleRow(iy, &coords[0], valid);
+			}
+		}
+	}
+	delete [] valid;
+}
+
+void TextureBuilder::_sampleRow(int iy, double *coords, bool *valid) const {
+
+	_mapper->MapRow(iy, _width, _height, coords, valid);
+
+	float *values = _values + 3*_width*iy;
+	unsigned char *validOut = _valid + _width*iy;
+	for (int ix = 0; ix < _width; ix++, values += 3) {
+		const double *c = coords + 3*ix;
+		validOut[ix] = valid[ix] ? 1 : 0;
+		for (int k = 0; k < 3; k++) {
+			values[k] = 0.0;
+			if (! valid[ix] || ! _grids[k]) continue;
+
+			float v = _grids[k]->GetValue(c[0], c[1], c[2]);
+			if (v == _grids[k]->GetMissingValue()) validOut[ix] = 0;
+			else values[k] = v;
+		}
+	}
+}
+
+void TextureBuilder::_buildRow(
+	int iy, double *coords, bool *valid, float *values
+) const {
+
+	_mapper->MapRow(iy, _width, _height, coords, valid);
+
+	//
+	// Sample the grid along the row. Consecutive samples usually fall
+	// in the same or an adjacent cell of the grid.
+	//
+	const RegularGrid *grid = _grids[0];
+	float mv = grid->GetMissingValue();
+	for (int ix = 0; ix < _width; ix++) {
+		if (! valid[ix]) continue;
+		const double *c = coords + 3*ix;
+		values[ix] = grid->GetValue(c[0], c[1], c[2]);
+		if (values[ix] == mv) valid[ix] = false;
+	}
+
+	//
+	// Map the samples through the lookup table, copying whole RGBA texels
+	//
+	const unsigned char *lut = &_lut[0];
+	unsigned char *texel = _texture + 4*_width*iy;
+	int hSize = _numEntries - 1;
+	for (int ix = 0; ix < _width; ix++, texel += 4) {
+		if (! valid[ix]) {
+			memset(texel, 0, 4);
+			continue;
+		}
+		int indx = MapperFunctionBase::mapPosition(
+			values[ix], _minValue, _maxValue, hSize
+		);
+		if (indx < 0) indx = 0;
+		if (indx > hSize) indx = hSize;
+		memcpy(texel, lut + 4*indx, 4);
+	}
+}
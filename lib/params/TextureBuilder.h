@@ -0,0 +1,166 @@
+//	File:		TextureBuilder.h
+//
+//	Description:	Parallel construction of the RGBA data textures
+//					displayed by the probe and 2D data renderers.
+//
+
+#ifndef _TextureBuilder_h_
+#define _TextureBuilder_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class TexelMapper
+//! \brief Maps the texels of a data texture into the user coordinates
+//! of the volume
+//!
+//! Implementations must be safe to call concurrently from several
+//! threads, i.e. MapRow() may not modify shared state.
+//
+class PARAMS_API TexelMapper {
+public:
+ virtual ~TexelMapper() {}
+
+ //! Compute the user coordinates of each texel in a row of the texture
+ //!
+ //! \param[in] iy Row index
+ //! \param[in] width Width of the texture
+ //! \param[in] height Height of the texture
+ //! \param[out] coords 3*width user coordinates, x varying fastest
+ //! \param[out] valid Set to false for texels that lie outside of the
+ //! data volume, true otherwise
+ //
+ virtual void MapRow(
+	int iy, int width, int height, double *coords, bool *valid
+ ) const = 0;
+};
+
+//
+//! \class TextureBuilder
+//! \brief Fills an RGBA texture by sampling a grid through a transfer
+//! function lookup table
+//!
+//! The rows of the texture are divided into bands of fixed height that
+//! are distributed across threads. Each thread maps a whole row of
+//! texels to user coordinates, samples the grid along the row, and
+//! then maps the row of samples through a byte-valued copy of the
+//! lookup table. The result is identical to texel-at-a-time evaluation
+//! with MapperFunctionBase::mapFloatToColorIndex() and a float lookup
+//! table converted with (unsigned char)(0.5+c*255.f).
+//!
+//! Texels that are outside of the volume, or where the grid has its
+//! missing value, are set to zero.
+//
+class PARAMS_API TextureBuilder : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ TextureBuilder(int nthreads = 0);
+ virtual ~TextureBuilder() {}
+
+ //! Set the lookup table
+ //!
+ //! \param[in] clut RGBA lookup table with \p numEntries entries, as
+ //! produced by TransferFunction::makeLut()
+ //! \param[in] numEntries Number of entries in \p clut
+ //! \param[in] minValue Data value mapped to the first entry
+ //! \param[in] maxValue Data value mapped to the last entry
+ //
+ void SetLut(
+	const float *clut, int numEntries, float minValue, float maxValue
+ );
+
+ //! Build a texture
+ //!
+ //! \param[in] grid Grid to sample
+ //! \param[in] mapper Texel to user coordinate mapping
+ //! \param[in] width Width of the texture
+ //! \param[in] height Height of the texture
+ //! \param[out] texture width*height*4 bytes receiving the texture
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Build(
+	const RegularGrid *grid, const TexelMapper *mapper,
+	int width, int height, unsigned char *texture
+ );
+
+ //! Sample up to three grids at the texels of a texture
+ //!
+ //! The grids are sampled as in Build(), but the samples are returned
+ //! instead of being mapped through the lookup table.
+ //!
+ //! \param[in] grids Grids to sample. A NULL grid is taken to be zero
+ //! everywhere.
+ //! \param[in] mapper Texel to user coordinate mapping
+ //! \param[in] width Width of the texture
+ //! \param[in] height Height of the texture
+ //! \param[out] values 3*width*height floats receiving the samples,
+ //! interleaved by texel. Samples outside of the volume, and missing
+ //! values, are set to zero.
+ //! \param[out] valid width*height bytes, set to zero for texels that
+ //! are outside of the volume or where any grid has its missing value,
+ //! and to one otherwise.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Sample(
+	const RegularGrid *const grids[3], const TexelMapper *mapper,
+	int width, int height, float *values, unsigned char *valid
+ );
+
+ //! Return the throughput of the last call to Build() or Sample(), in
+ //! millions of texels per second
+ //
+ double GetMTexelsPerSec() const { return(_mtexelsPerSec); }
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(TextureBuilder *tb, int id, int nthreads) {
+		_tb = tb; _id = id; _nthreads = nthreads;
+	}
+	void RowThread();
+ private:
+	TextureBuilder *_tb;
+	int _id;	// thread id
+	int _nthreads;	// # of threads sharing the bands
+ };
+
+private:
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+ std::vector <unsigned char> _lut;	// RGBA lookup table, as bytes
+ int _numEntries;
+ float _minValue;
+ float _maxValue;
+ double _mtexelsPerSec;
+
+ //
+ // State shared by the thread objects for the current texture
+ //
+ const RegularGrid *_grids[3];
+ const TexelMapper *_mapper;
+ int _width;
+ int _height;
+ unsigned char *_texture;	// Build() output
+ float *_values;			// Sample() output
+ unsigned char *_valid;		// Sample() output
+
+ int _run(const TexelMapper *mapper, int width, int height);
+ void _buildRow(int iy, double *coords, bool *valid, float *values) const;
+ void _sampleRow(int iy, double *coords, bool *valid) const;
+};
+
+};
+
+#endif	// _TextureBuilder_h_
@@ -40,6 +40,7 @@
 #include <vapor/errorcodes.h>
 #include "datastatus.h"
 #include "pythonpipeline.h"
+#include "HistoBuilder.h"
 
 using namespace VAPoR;
 using namespace VetsUtil;
@@ -105,6 +106,7 @@ DataStatus()
 {
 	
 	dataMgr = 0;
+	histoBuilder = 0;
 	renderOK = false;
 	
 	minTimeStep = 0;
@@ -142,6 +144,7 @@ reset(DataMgr* dm, size_t cachesize, QApplication* app){
 	cacheMB = cachesize;
 	
 	dataMgr = dm;
+	if (histoBuilder) histoBuilder->Clear();
 	unsigned int numTS = (unsigned int)dataMgr->GetNumTimeSteps();
 	if (numTS == 0) return false;
 	MetadataVDC* md = dynamic_cast<MetadataVDC*>(dataMgr);
@@ -522,8 +525,13 @@ DataStatus::
 	for (int i = 0; i< dataAtLevel.size(); i++){
 		delete [] dataAtLevel[i];
 	}
+	if (histoBuilder) delete histoBuilder;
 	theDataStatus = 0;
 }
+HistoBuilder* DataStatus::getHistoBuilder(){
+	if (!histoBuilder) histoBuilder = new HistoBuilder();
+	return histoBuilder;
+}
 void DataStatus::setDefaultPrefs(){
 	doWarnIfDataMissing = true;
 	trackMouseInTfe = true;
@@ -816,11 +824,13 @@ int DataStatus::getDerivedScriptId(const string& outvar) {
 void DataStatus::purgeAllCachedDerivedVariables() {
 	DataMgr* dataMgr = getInstance()->getDataMgr();
 	if (!dataMgr) return;
+	HistoBuilder* hb = getInstance()->getHistoBuilder();
 	map <int, vector<string> > :: const_iterator outIter = derived2DOutputMap.begin();
 	while (outIter != derived2DOutputMap.end()){
 		vector<string> vars = outIter->second;
 		for (int i = 0; i<vars.size(); i++){
 			dataMgr->PurgeVariable(vars[i]);
+			hb->Purge(vars[i]);
 		}
 		outIter++;
 	}
@@ -829,6 +839,7 @@ void DataStatus::purgeAllCachedDerivedVariables() {
 		vector<string> vars = outIter->second;
 		for (int i = 0; i<vars.size(); i++){
 			dataMgr->PurgeVariable(vars[i]);
+			hb->Purge(vars[i]);
 		}
 		outIter++;
 	}
@@ -987,10 +998,12 @@ int DataStatus::replaceDerivedScript(int id, const vector<string>& in2DVars, con
 		vector<string> oldOut2dvars = getDerived2DOutputVars(id);
 		for (int i = 0; i<oldOut2dvars.size(); i++){
 			dataMgr->PurgeVariable(oldOut2dvars[i]);
+			getHistoBuilder()->Purge(oldOut2dvars[i]);
 		}	
 		vector<string> oldOut3dvars = getDerived3DOutputVars(id);
 		for (int i = 0; i<oldOut3dvars.size(); i++){
 			dataMgr->PurgeVariable(oldOut3dvars[i]);
+			getHistoBuilder()->Purge(oldOut3dvars[i]);
 		}
 	}
 	removeDerivedScript(id);
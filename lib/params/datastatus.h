@@ -32,6 +32,7 @@
 class QApplication;
 
 namespace VAPoR {
+class HistoBuilder;
 //! \class DataStatus
 //! \brief A class for describing the currently loaded dataset
 //! \author Alan Norton
@@ -473,6 +474,11 @@ public:
 	//! Invalidate current data manager:
 	void invalidateDataMgr(){dataMgr = 0;}
 
+	//! Returns the builder used for the histograms displayed in transfer
+	//! function editors.  It caches the histograms of the current data.
+	//! \retval HistoBuilder* pointer to the histogram builder
+	HistoBuilder* getHistoBuilder();
+
 	//! Method indicates if user requested a warning when data is missing.
 	//! \retval bool true if warning is requested.
 	static bool warnIfDataMissing() {return doWarnIfDataMissing;}
@@ -755,6 +761,7 @@ private:
 	std::vector<int*> maxLevel3D;
 	std::vector<int*> maxLevel2D;
 	DataMgr* dataMgr;
+	HistoBuilder* histoBuilder;
 	bool renderOK;
 	QApplication* theApp;
 	
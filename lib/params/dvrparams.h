@@ -52,6 +52,7 @@ public:
       DVR_SPHERICAL_SHADER,
       DVR_RAY_CASTER,
 	  DVR_RAY_CASTER_2_VAR,
+	  DVR_CPU_RAY_CASTER,
 	  DVR_INVALID_TYPE
     };
 	 void setType(DvrType val) {type = val; }
@@ -121,6 +121,7 @@ using namespace VAPoR;
 	
 	myBox= 0;
 	transferFunction = 0;
+	waitCursor = true;
 	
 	//Set all parameters to default values
 	restart();
@@ -1084,7 +1085,7 @@ regenerateSteadyFieldLines(VaporFlow* myFlowLib, FlowLineData* flowLines, PathLi
 	FlowLineData* steadyFlowData = flowLines;
 	if (!steadyFlowData) steadyFlowData = new FlowLineData(numSeedPoints, maxPoints, useSpeeds, steadyFlowDirection, doRGBAs); 
 
-	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+	if (waitCursor) QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 
 	bool rc;
 	if (flowLines) { //Use the seedlist constructed above:
@@ -1100,7 +1101,7 @@ regenerateSteadyFieldLines(VaporFlow* myFlowLib, FlowLineData* flowLines, PathLi
 		}
 	}
 	//Restore original cursor:
-	QApplication::restoreOverrideCursor();
+	if (waitCursor) QApplication::restoreOverrideCursor();
 
 	if (!rc){
 		MyBase::SetErrMsg(VAPOR_ERROR_INTEGRATION, "Error integrating steady flow lines");	
@@ -2317,9 +2318,9 @@ mapColors(FlowLineData* container, int currentTimeStep, int minFrame, RegionPara
 			useLOD = maxLOD;
 		}
 
-		QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+		if (waitCursor) QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 		colorGrid = dataMgr->GetGrid(timeStep, colorVarname[0],colorRefLevel, useLOD,min_dim,max_dim,0);
-		QApplication::restoreOverrideCursor();
+		if (waitCursor) QApplication::restoreOverrideCursor();
 
 		if (!colorGrid){
 			DataStatus::getInstance()->getDataMgr()->SetErrCode(0);
@@ -2869,7 +2870,7 @@ float FlowParams::getAvgVectorMag(RegionParams* rParams, int numrefts, int timeS
 	DataStatus* ds = DataStatus::getInstance();
 	
 	DataMgr* dataMgr = (DataMgr*)(ds->getDataMgr());
-	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+	if (waitCursor) QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 	//Obtain the variables from the dataMgr:
 	for (int var = 0; var<3; var++){
 		if (steadyVarNum[var]== 0) varData[var] = 0;
@@ -2888,7 +2889,7 @@ float FlowParams::getAvgVectorMag(RegionParams* rParams, int numrefts, int timeS
 					if (varData[k])
 						dataMgr->UnlockGrid(varData[k]);
 				}
-				QApplication::restoreOverrideCursor();
+				if (waitCursor) QApplication::restoreOverrideCursor();
 				return -2.f;
 			}	
 		}
@@ -2936,7 +2937,7 @@ float FlowParams::getAvgVectorMag(RegionParams* rParams, int numrefts, int timeS
 	for (int k = 0; k<3; k++){
 		if(varData[k]) dataMgr->UnlockGrid(varData[k]);
 	}
-	QApplication::restoreOverrideCursor();
+	if (waitCursor) QApplication::restoreOverrideCursor();
 	if (numPts == 0) return -1.f;
 	return (dataSum/(float)numPts);
 	
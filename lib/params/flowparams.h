@@ -117,6 +117,9 @@ public:
 	bool multiAdvectFieldLines(VaporFlow*, FlowLineData**, int startTime, int endTime, int minFrame, RegionParams*);
 
 	bool singleAdvectFieldLines(VaporFlow*, FlowLineData**, PathLineData*, int startTime, int endTime, int minFrame, RegionParams*);
+	//The wait cursor is not shown while a copy of the params integrates flow
+	//lines on a worker thread, as Qt cursors can only be set on the GUI thread.
+	void showWaitCursor(bool val) {waitCursor = val;}
 	//Methods to allow iteration over unsteady timestep samples in either direction,
 	//within a prescribed min/max interval.  Returns -1 at end of interval 
 	int getUnsteadyTimestepSample(int index, int minStep, int maxStep, int flowDir);
@@ -529,6 +532,7 @@ protected:
 	
 	bool useTimestepSampleList;
 	bool useDisplayLists;
+	bool waitCursor;
 	bool periodicDim[3];
 	//Parameters controlling flowDataAccess.  These are established each time
 	//The flow data is regenerated:
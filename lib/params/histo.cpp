@@ -17,6 +17,7 @@
 //	Description:  Implementation of Histo class 
 //
 #include "histo.h"
+#include "HistoBuilder.h"
 #include "regionparams.h"
 #include "dvrparams.h"
 #include "animationparams.h"
@@ -32,38 +33,44 @@ Histo::Histo(int numberBins, float mnData, float mxData){
 	binArray = new int[numBins];
 	reset();
 }
-Histo::Histo(const RegularGrid *rg, const double exts[6], const float range[2]) {
+Histo::Histo(const RegularGrid *rg, const double exts[6], const float range[2],
+	HistoBuilder *builder) {
 	binArray = new int[256];
 	minData = range[0];
 	maxData = range[1];
 	numBins = 256;
 	reset();
 	if (range[0]>= range[1]) return;
-	unsigned int qv;	// quantized value
-	float v;
-	RegularGrid *rg_const = (RegularGrid *) rg;   // kludge - no const_iterator
-	RegularGrid::Iterator itr;
-	double point[3];
-	for (itr = rg_const->begin(); itr!=rg_const->end(); ++itr) {
-		v = *itr;
-		if (v == rg->GetMissingValue()) continue;
-		itr.GetUserCoordinates(point, point+1, point+2);
-		bool isIn = true;
-		for (int j = 0; j<3; j++){
-			if (point[j]>exts[j+3] || point[j] < exts[j]) isIn = false;
-		}
-		if (!isIn) continue;
-		if (v<range[0]) qv=0;
-		else if (v>range[1]) qv=255;
-		else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 255);
 
-		binArray[qv]++;
-		if (qv > 0 && qv < 255 && binArray[qv] > maxBinSize) {
-			maxBinSize = binArray[qv];
-			largestBin = qv;
+	vector<int> bins;
+	if (builder) builder->Build(rg, exts, range, numBins, bins);
+	else {
+		HistoBuilder hb;
+		hb.Build(rg, exts, range, numBins, bins);
+	}
+	if (bins.size() != numBins) return;
+	for (int i = 0; i<numBins; i++) binArray[i] = bins[i];
+	setLargestBin();
+}
+Histo::Histo(const vector<int>& bins, float mnData, float mxData){
+	numBins = bins.size();
+	minData = mnData;
+	maxData = mxData;
+	binArray = new int[numBins];
+	reset();
+	for (int i = 0; i<numBins; i++) binArray[i] = bins[i];
+	setLargestBin();
+}
+//The largest bin ignores the end bins, which also count out-of-range values
+void Histo::setLargestBin(){
+	maxBinSize = 0;
+	largestBin = -1;
+	for (int i = 1; i< numBins-1; i++){
+		if (binArray[i] > maxBinSize) {
+			maxBinSize = binArray[i];
+			largestBin = i;
 		}
 	}
-	
 }
 	
 Histo::~Histo(){
@@ -20,19 +20,27 @@
 //
 #ifndef HISTO_H
 #define HISTO_H
+#include <vector>
 #include <vapor/MyBase.h>
 #include <vapor/RegularGrid.h>
 
 namespace VAPoR {
 
 class Params;
+class HistoBuilder;
 	
 class PARAMS_API Histo{
 public:
 	Histo(int numberBins, float mnData, float mxData);
 	//Special constructor for unsigned char data:
+	//Histograms the points of rg inside exts into 256 bins, using
+	//builder if provided:
 	//
-	Histo(const RegularGrid *rg, const double exts[6], const float range[2]);
+	Histo(const RegularGrid *rg, const double exts[6], const float range[2],
+		HistoBuilder *builder = 0);
+	//Construct from bin counts, e.g. cached by a HistoBuilder:
+	//
+	Histo(const std::vector<int>& bins, float mnData, float mxData);
 	~Histo();
 	void reset(int newNumBins = -1);
 	void reset(int newNumBins, float mnData, float mxData){
@@ -52,6 +60,7 @@ private:
 	float minData, maxData;
 	int maxBinSize;
 	int largestBin;
+	void setLargestBin();
 };
 };
 
@@ -742,9 +742,14 @@ void Params::clearDummyParamsInstances(){
 //Extents are reduced if data not available at requested extents.
 //Vector of varnames can include "0" for zero variable.
 //Variables can be 2D or 3D depending on value of "varsAre2D"
-//Returns 0 on failure
+//Returns 0 on failure.  If errCode is not null it is set to the error code of the
+//failure, so that a caller whose messages are diverted can report it later.
 //
-int Params::getGrids(size_t ts, const vector<string>& varnames, double extents[6], int* refLevel, int* lod, RegularGrid** grids){
+int Params::getGrids(size_t ts, const vector<string>& varnames, double extents[6], int* refLevel, int* lod, RegularGrid** grids, int* errCode){
+	
+	int dummy;
+	if (!errCode) errCode = &dummy;
+	*errCode = VAPOR_ERROR_DATA_UNAVAILABLE;
 	
 	DataStatus* ds = DataStatus::getInstance();
 	DataMgr* dataMgr = ds->getDataMgr();
@@ -764,7 +769,7 @@ int Params::getGrids(size_t ts, const vector<string>& varnames, double extents[6
 		*refLevel = tempRefLevel;
 	} else {
 		if (tempRefLevel< *refLevel || tempLOD < *lod){
-			MyBase::SetErrMsg(VAPOR_ERROR_DATA_UNAVAILABLE, "Variable not present at required refinement and LOD\n");
+			MyBase::SetErrMsg(*errCode, "Variable not present at required refinement and LOD\n");
 			return 0;
 		}
 	}
@@ -814,7 +819,8 @@ int Params::getGrids(size_t ts, const vector<string>& varnames, double extents[6
 	} 	
 	int cacheSize = DataStatus::getInstance()->getCacheMB();
 	if (numMBs > (int)(cacheSize*0.75)){
-		MyBase::SetErrMsg(VAPOR_ERROR_DATA_TOO_BIG, "Current cache size is too small\nfor current probe and resolution.\n%s",
+		*errCode = VAPOR_ERROR_DATA_TOO_BIG;
+		MyBase::SetErrMsg(*errCode, "Current cache size is too small\nfor current probe and resolution.\n%s",
 						  "Lower the refinement level, reduce the size, or increase the cache size.");
 		return 0;
 	}
@@ -530,7 +530,7 @@ Params(int winNum, const string& name) : ParamsBase(name) {
 	//Determine a new value of theta and phi when the probe is rotated around either the
 	//x-, y-, or z- axis.  axis is 0,1,or 1. rotation is in degrees.
 	void convertThetaPhiPsi(float *newTheta, float* newPhi, float* newPsi, int axis, float rotation);
-	static int getGrids(size_t ts, const vector<string>& varnames, double extents[6], int* refLevel, int* lod, RegularGrid** grids);
+	static int getGrids(size_t ts, const vector<string>& varnames, double extents[6], int* refLevel, int* lod, RegularGrid** grids, int* errCode = 0);
 	
 	
 protected:
@@ -41,6 +41,8 @@
 
 #include "histo.h"
 #include "animationparams.h"
+#include "TextureBuilder.h"
+#include "IBFVFieldCache.h"
 
 #include <math.h>
 #include <vapor/DataMgr.h>
@@ -82,8 +84,14 @@ ProbeParams::ProbeParams(int winnum) : RenderParams(winnum, Params::_probeParams
 	ibfvUField = 0;
 	ibfvVField = 0;
 	ibfvValid = 0;
+	ibfvTimestep = -1;
+	ibfvCache = 0;
+	ibfvMesh = 0;
+	ibfvMeshSize = 0;
+	ibfvMeshScale = 0.f;
 	ibfvMag = -1.f;
 	mergeColor = false;
+	textureVersion = 0;
 	restart();
 	
 }
@@ -108,16 +116,11 @@ ProbeParams::~ProbeParams(){
 		}
 		delete [] probeIBFVTextures;
 	}
-	if (ibfvUField) {
-		for (int i = 0; i<= maxTimestep; i++){
-			if (ibfvUField[i]) delete ibfvUField[i];
-			if (ibfvVField[i]) delete ibfvVField[i];
-			if (ibfvValid[i]) delete ibfvValid[i];
-		}
-		delete [] ibfvUField;
-		delete [] ibfvVField;
-		delete [] ibfvValid;
-	}
+	if (ibfvUField) delete [] ibfvUField;
+	if (ibfvVField) delete [] ibfvVField;
+	if (ibfvValid) delete [] ibfvValid;
+	if (ibfvMesh) delete [] ibfvMesh;
+	if (ibfvCache) delete ibfvCache;
 	ibfvMag = -1.f;
 	
 }
@@ -155,6 +158,10 @@ deepCopy(ParamNode*){
 	newParams->ibfvUField = 0;
 	newParams->ibfvVField = 0;
 	newParams->ibfvValid = 0;
+	newParams->ibfvTimestep = -1;
+	newParams->ibfvCache = 0;
+	newParams->ibfvMesh = 0;
+	newParams->ibfvMeshSize = 0;
 	newParams->ibfvMag = -1.f;
 	
 	//never keep the SavedCommand:
@@ -438,14 +445,11 @@ reinit(bool doOverride){
 	setProbeDirty();
 	if (probeDataTextures) delete [] probeDataTextures;
 	if (probeIBFVTextures) delete [] probeIBFVTextures;
-	if (ibfvUField) delete [] ibfvUField;
-	if (ibfvVField) delete [] ibfvVField;
-	if (ibfvValid) delete [] ibfvValid;
 	maxTimestep = ds->getNumTimesteps()-1;
 	probeDataTextures = 0;
 	probeIBFVTextures = 0;
-	ibfvUField = 0;
-	ibfvVField = 0;
+	//Cached fields belong to the previous data
+	if (ibfvCache) ibfvCache->Clear();
 	initializeBypassFlags();
 	return true;
 }
@@ -468,11 +472,7 @@ restart(){
 	probeDataTextures = 0;
 	if (probeIBFVTextures) delete [] probeIBFVTextures;
 	probeIBFVTextures = 0;
-	if (ibfvUField) delete [] ibfvUField;
-	if (ibfvVField) delete [] ibfvVField;
-	if (ibfvValid) delete [] ibfvValid;
-	ibfvUField = 0;
-	ibfvVField = 0;
+	if (ibfvCache) ibfvCache->Clear();
 	ibfvMag = -1.f;
 	mergeColor = false;
 	ibfvSessionVarNum[0]= 1;
@@ -1037,69 +1037,139 @@ void ProbeParams::setProbeDirty(){
 		}
 	}
 	textureSize[0]= textureSize[1] = 0;
-	if (ibfvUField) {
-		for (int i = 0; i<= maxTimestep; i++){
-			if (ibfvUField[i]) delete ibfvUField[i];
-			ibfvUField[i] = 0;
-			if (ibfvVField[i])delete ibfvVField[i];
-			ibfvVField[i] = 0;
-			if (ibfvValid[i]) delete ibfvValid[i];
-			ibfvValid[i] = 0;
-		}
-	}
+	textureVersion++;
+	//The current fields are scaled by ibfvMag, so they must be rebuilt.
+	//ibfvCache is kept; its entries are only used when the probe
+	//configuration they were sampled with is unchanged.
+	ibfvTimestep = -1;
+	ibfvMeshSize = 0;
 	ibfvMag = -1.f;
 	setAllBypass(false);
 }
 
 
+namespace {
+	//Maps texels of the probe texture to user coordinates in the volume.
+	//Pixel centers map to edges of probe.
+	class ProbeTexelMapper : public TexelMapper {
+	public:
+		ProbeTexelMapper(const float mat[12], const float extExtents[6], const vector<double>& userExts){
+			for (int i = 0; i<12; i++) transformMatrix[i] = mat[i];
+			for (int i = 0; i<6; i++) extendedExtents[i] = extExtents[i];
+			for (int i = 0; i<3; i++) userExtents[i] = userExts[i];
+		}
+		void MapRow(int iy, int texWidth, int texHeight, double* coords, bool* valid) const {
+			float probeCoord[3];
+			//Can ignore depth, just mapping center plane
+			probeCoord[2] = 0.f;
+			//Map iy to a value between -1 and 1
+			probeCoord[1] = -1.f + 2.f*(float)iy/(float)(texHeight-1);
+			for (int ix = 0; ix < texWidth; ix++){
+				probeCoord[0] = -1.f + 2.f*(float)ix/(float)(texWidth-1);
+				double* dataCoord = coords+3*ix;
+				vtransform(probeCoord, (float*)transformMatrix, dataCoord);
+				//find the coords that the texture maps to
+				//probeCoord is the coord in the probe, dataCoord is in data volume 
+				valid[ix] = true;
+				for (int i = 0; i< 3; i++){
+					if (dataCoord[i] < extendedExtents[i] || dataCoord[i] > extendedExtents[i+3]) valid[ix] = false;
+					dataCoord[i] += userExtents[i]; //Convert to user coordinates.
+				}
+			}
+		}
+	private:
+		float transformMatrix[12];
+		float extendedExtents[6];
+		double userExtents[3];
+	};
+};
+
 //Calculate the probe texture (if it needs refreshing).
 //It's kept (cached) in the probe params
 //If nonzero texture dimensions are provided, then the cached image
 //is not affected 
 unsigned char* ProbeParams::
 calcProbeDataTexture(int ts, int texWidth, int texHeight){
-	
-	
-	if (!isEnabled()) return 0;
+	bool doCache = (texWidth == 0 && texHeight == 0);
+	DataTextureSpec spec;
+	if (!getDataTextureSpec(ts, texWidth, texHeight, spec)) return 0;
+	unsigned char* probeTexture = buildDataTexture(spec);
+	if (probeTexture && doCache) setProbeTexture(probeTexture,ts, 0);
+	return probeTexture;
+}
+
+//Capture what is needed to calculate the data texture at a timestep.
+//With zero texture dimensions, the texture is sized for the cache.
+bool ProbeParams::
+getDataTextureSpec(int ts, int texWidth, int texHeight, DataTextureSpec& spec){
+	if (!isEnabled()) return false;
 	DataStatus* ds = DataStatus::getInstance();
-	if (!ds->getDataMgr()) return 0;
+	if (!ds->getDataMgr()) return false;
 
-	if (doBypass(ts)) return 0;
-	bool doCache = (texWidth == 0 && texHeight == 0);
+	if (doBypass(ts)) return false;
 
-	int actualRefLevel = GetRefinementLevel();
-	int lod = GetCompressionLevel();
+	spec.timestep = ts;
+	spec.refLevel = GetRefinementLevel();
+	spec.lod = GetCompressionLevel();
 		
-	const vector<double>&userExts = ds->getDataMgr()->GetExtents((size_t)ts);
-	RegularGrid* probeGrid;
-	vector<string>varnames;
-	varnames.push_back(ds->getVariableName3D(firstVarNum));
-	double extents[6];
+	spec.userExts = ds->getDataMgr()->GetExtents((size_t)ts);
+	spec.varnames.clear();
+	spec.varnames.push_back(ds->getVariableName3D(firstVarNum));
+	//Find the levels present now, as DataStatus caches them
+	ds->maxXFormPresent(spec.varnames[0], ts);
+	ds->maxLODPresent(spec.varnames[0], ts);
 	float boxmin[3],boxmax[3];
 	getLocalContainingRegion(boxmin, boxmax);
 	for (int i = 0; i<3; i++){
-		extents[i] = boxmin[i]+userExts[i];
-		extents[i+3] = boxmax[i]+userExts[i];
+		spec.extents[i] = boxmin[i]+spec.userExts[i];
+		spec.extents[i+3] = boxmax[i]+spec.userExts[i];
 	}
+	spec.linearInterp = linearInterpTex();
+
+	//Set up to transform from probe into volume:
+	buildLocalCoordTransform(spec.transformMatrix, 0.f, -1);
+
+	TransferFunction* transFunc = GetTransFunc();
+	assert(transFunc);
+	transFunc->makeLut(spec.clut);
+	spec.numEntries = transFunc->getNumEntries();
+	spec.minColorMapValue = transFunc->getMinColorMapValue();
+	spec.maxColorMapValue = transFunc->getMaxColorMapValue();
 	
-	int rc = getGrids( ts, varnames, extents, &actualRefLevel, &lod, &probeGrid);
+	if (texWidth == 0 && texHeight == 0) {
+		int txsize[2];
+		adjustTextureSize(txsize);
+		texWidth = txsize[0];
+		texHeight = txsize[1];
+	}
+	spec.width = texWidth;
+	spec.height = texHeight;
+	return true;
+}
+
+//Calculate a data texture.  Does not use the params, so it may be called
+//from any thread.
+unsigned char* ProbeParams::
+buildDataTexture(DataTextureSpec& spec, int* errCode){
+	DataStatus* ds = DataStatus::getInstance();
+	DataMgr* dataMgr = ds->getDataMgr();
+	if (!dataMgr) return 0;
+
+	RegularGrid* probeGrid;
+	int rc = getGrids( spec.timestep, spec.varnames, spec.extents, &spec.refLevel, &spec.lod, &probeGrid, errCode);
 	
 	if(!rc){
 		return 0;
 	}
 	
-	if (linearInterpTex())probeGrid->SetInterpolationOrder(1);
+	if (spec.linearInterp)probeGrid->SetInterpolationOrder(1);
 	else probeGrid->SetInterpolationOrder(0);
 
-	float transformMatrix[12];
-	//Set up to transform from probe into volume:
-	buildLocalCoordTransform(transformMatrix, 0.f, -1);
-
 	//Get the data dimensions (at this resolution):
 	int dataSize[3];
 	//Start by initializing extents
 	for (int i = 0; i< 3; i++){
-		dataSize[i] = (int)ds->getFullSizeAtLevel(actualRefLevel,i);
+		dataSize[i] = (int)ds->getFullSizeAtLevel(spec.refLevel,i);
 	}
 	//Now calculate the texture.
 	//
@@ -1109,13 +1179,6 @@ calcProbeDataTexture(int ts, int texWidth, int texHeight){
 	//We first map the coords in the probe to the volume.  
 	//Then we map the volume into the region provided by dataMgr
 	
-	float clut[256*4];
-	TransferFunction* transFunc = GetTransFunc();
-	assert(transFunc);
-	transFunc->makeLut(clut);
-	
-	float probeCoord[3];
-	double dataCoord[3];
 	const float* sizes = ds->getFullSizes();
 	float extExtents[6]; //Extend extents 1/2 voxel on each side so no bdry issues.
 	for (int i = 0; i<3; i++){
@@ -1124,65 +1187,15 @@ calcProbeDataTexture(int ts, int texWidth, int texHeight){
 		extExtents[i] = mid - halfExtendedSize;
 		extExtents[i+3] = mid + halfExtendedSize;
 	}
-	//Can ignore depth, just mapping center plane
-	probeCoord[2] = 0.f;
-	
-	if (doCache) {
-		int txsize[2];
-		adjustTextureSize(txsize);
-		texWidth = txsize[0];
-		texHeight = txsize[1];
-	}
 	
-	unsigned char* probeTexture = new unsigned char[texWidth*texHeight*4];
+	unsigned char* probeTexture = new unsigned char[spec.width*spec.height*4];
 
-	//Use the region reader to calculate coordinates in volume
-	DataMgr* dataMgr = ds->getDataMgr();
-
-	//Loop over pixels in texture.  Pixel centers map to edges of probe
+	//Loop over pixels in texture, using all available threads.
+	ProbeTexelMapper mapper(spec.transformMatrix, extExtents, spec.userExts);
+	TextureBuilder builder;
+	builder.SetLut(spec.clut, spec.numEntries, spec.minColorMapValue, spec.maxColorMapValue);
+	builder.Build(probeGrid, &mapper, spec.width, spec.height, probeTexture);
 	
-	for (int iy = 0; iy < texHeight; iy++){
-		//Map iy to a value between -1 and 1
-		probeCoord[1] = -1.f + 2.f*(float)iy/(float)(texHeight-1);
-		for (int ix = 0; ix < texWidth; ix++){
-			
-			
-			probeCoord[0] = -1.f + 2.f*(float)ix/(float)(texWidth-1);
-			vtransform(probeCoord, transformMatrix, dataCoord);
-			//find the coords that the texture maps to
-			//probeCoord is the coord in the probe, dataCoord is in data volume 
-			bool dataOK = true;
-			for (int i = 0; i< 3; i++){
-				if (dataCoord[i] < extExtents[i] || dataCoord[i] > extExtents[i+3]) dataOK = false;
-				dataCoord[i] += userExts[i]; //Convert to user coordinates.
-			}
-			float varVal;
-			if(dataOK) { //find the coordinate in the data array
-				
-				varVal = probeGrid->GetValue(dataCoord[0],dataCoord[1],dataCoord[2]);
-				if (varVal == probeGrid->GetMissingValue()) dataOK = false;
-			}
-			if (dataOK) {				
-				//Use the transfer function to map the data:
-				int lutIndex = transFunc->mapFloatToIndex(varVal);
-				
-				probeTexture[4*(ix+texWidth*iy)] = (unsigned char)(0.5+ clut[4*lutIndex]*255.f);
-				probeTexture[4*(ix+texWidth*iy)+1] = (unsigned char)(0.5+ clut[4*lutIndex+1]*255.f);
-				probeTexture[4*(ix+texWidth*iy)+2] = (unsigned char)(0.5+ clut[4*lutIndex+2]*255.f);
-				probeTexture[4*(ix+texWidth*iy)+3] = (unsigned char)(0.5+ clut[4*lutIndex+3]*255.f);
-			}
-				
-			else {//point out of region, or missing value
-				probeTexture[4*(ix+texWidth*iy)] = 0;
-				probeTexture[4*(ix+texWidth*iy)+1] = 0;
-				probeTexture[4*(ix+texWidth*iy)+2] = 0;
-				probeTexture[4*(ix+texWidth*iy)+3] = 0;
-			}
-
-		}//End loop over ix
-	}//End loop over iy
-	
-	if (doCache) setProbeTexture(probeTexture,ts, 0);
 	dataMgr->UnlockGrid(probeGrid);
 	delete probeGrid;
 	return probeTexture;
@@ -1262,7 +1275,7 @@ void ProbeParams::adjustTextureSize(int sz[2]){
 //Input xa,ya are between 0 and 1, and *px, *py are in same coord space.
 //Requires valid data
 void ProbeParams::getIBFVValue(int ts, float xa, float ya, float* px, float* py){
-	assert(ibfvUField && ibfvUField[ts]);
+	assert(ibfvUField && ts == ibfvTimestep);
 	assert(xa >= 0.f && ya >= 0.f && xa < 1.f && ya < 1.f);
 	//convert xa and ya to grid coords
 	float x = xa * (float)(textureSize[0]-1);
@@ -1270,18 +1283,18 @@ void ProbeParams::getIBFVValue(int ts, float xa, float ya, float* px, float* py)
 	
 	float xfrac = x - floor(x);
 	float yfrac = y - floor(y);
-	float u00 = ibfvUField[ts][(int)x + textureSize[0]*(int)y];
-	float u10 = ibfvUField[ts][1+(int)x + textureSize[0]*(int)y];
-	float u11 = ibfvUField[ts][1+(int)x + textureSize[0]*(1+(int)y)];
-	float u01 = ibfvUField[ts][(int)x + textureSize[0]*(1+(int)y)];
+	float u00 = ibfvUField[(int)x + textureSize[0]*(int)y];
+	float u10 = ibfvUField[1+(int)x + textureSize[0]*(int)y];
+	float u11 = ibfvUField[1+(int)x + textureSize[0]*(1+(int)y)];
+	float u01 = ibfvUField[(int)x + textureSize[0]*(1+(int)y)];
 	
 	float uval = (1.-xfrac)*((1.-yfrac)*u00+yfrac*u01)+
 		xfrac*((1.-yfrac)*u10+yfrac*u11);
 
-	float v00 = ibfvVField[ts][(int)x + textureSize[0]*(int)y];
-	float v10 = ibfvVField[ts][1+(int)x + textureSize[0]*(int)y];
-	float v11 = ibfvVField[ts][1+(int)x + textureSize[0]*(1+(int)y)];
-	float v01 = ibfvVField[ts][(int)x + textureSize[0]*(1+(int)y)];
+	float v00 = ibfvVField[(int)x + textureSize[0]*(int)y];
+	float v10 = ibfvVField[1+(int)x + textureSize[0]*(int)y];
+	float v11 = ibfvVField[1+(int)x + textureSize[0]*(1+(int)y)];
+	float v01 = ibfvVField[(int)x + textureSize[0]*(1+(int)y)];
 	float vval = (1.-xfrac)*((1.-yfrac)*v00+yfrac*v01)+
 		xfrac*((1.-yfrac)*v10+yfrac*v11);
 
@@ -1297,22 +1310,25 @@ void ProbeParams::getIBFVValue(int ts, float xa, float ya, float* px, float* py)
 	*py = ya + vval;
 	
 }
+const float* ProbeParams::getIBFVMesh(int timestep){
+	if (timestep != ibfvTimestep && !buildIBFVFields(timestep)) return 0;
+	if (ibfvMesh && ibfvMeshSize == NMESH && ibfvMeshScale == fieldScale) return ibfvMesh;
+	if (ibfvMesh) delete [] ibfvMesh;
+	ibfvMesh = new float[2*NMESH*NMESH];
+	//All mesh vertices are advected at once, in parallel, rather than
+	//once per vertex per frame:
+	ibfvCache->AdvectMesh(textureSize[0], textureSize[1], ibfvUField, ibfvVField,
+		fieldScale, NMESH, ibfvMesh);
+	ibfvMeshSize = NMESH;
+	ibfvMeshScale = fieldScale;
+	return ibfvMesh;
+}
 bool ProbeParams::buildIBFVFields(int timestep){
-	//Set up the cache if it's not ready:
 	DataStatus* ds = DataStatus::getInstance();
 	if (!ds->getDataMgr()) return false;
-	if (!ibfvUField) {
-		ibfvUField = new float*[maxTimestep + 1];
-		ibfvVField = new float*[maxTimestep + 1];
-		ibfvValid = new unsigned char*[maxTimestep + 1];
-		ibfvMag = -1.f;
-		for (int i = 0; i<= maxTimestep; i++) {ibfvUField[i] = 0; ibfvVField[i] = 0; ibfvValid[i] = 0;}
-	}
 	//If the required data is valid, just return true:
-	if(ibfvUField[timestep] && ibfvVField[timestep]) return true;
+	if (ibfvUField && ibfvTimestep == timestep) return true;
 	
-	const vector<double>&userExts = ds->getDataMgr()->GetExtents((size_t)timestep);
-	//Now obtain the field values for the current probe
 	//Session variable nums are -1 if the variable is 0
 	vector<string> varnames;
 	for (int i = 0; i<3; i++){
@@ -1320,31 +1336,9 @@ bool ProbeParams::buildIBFVFields(int timestep){
 		if (svnum < 0) varnames.push_back("0");
 		else varnames.push_back(ds->getVariableName3D(svnum));
 	}
-	double extents[6];
-	float boxmin[3],boxmax[3];
-	getLocalContainingRegion(boxmin, boxmax);
-	for (int i = 0; i<3; i++){
-		extents[i] = boxmin[i]+userExts[i];
-		extents[i+3] = boxmax[i]+userExts[i];
-	}							
 	int actualRefLevel = GetRefinementLevel();
 	int lod = GetCompressionLevel();
-	RegularGrid* grids[3];
-	
-	int rc = getGrids( timestep, varnames, extents, &actualRefLevel, &lod,  grids);
-	if (!rc) return false;
-	
 
-	//Then go through the grids, projecting the field values to the 2D plane.
-	//Each (x,y) probe coord is converted to the closest point in the probe grid
-	//Each field value is also multiplied by scale factor, times a factor that relates the
-	//user coord system to the probe grid coords.
-	
-	//Get the data dimensions (at this resolution):
-	int dataSize[3];
-	for (int i = 0; i< 3; i++){
-		dataSize[i] = (int)ds->getFullSizeAtLevel(actualRefLevel,i);
-	}
 	//Set up to transform from probe into volume:
 	float transformMatrix[12];
 	buildLocalCoordTransform(transformMatrix, 0.f, -1);
@@ -1365,16 +1359,6 @@ bool ProbeParams::buildIBFVFields(int timestep){
 	invMatrix[7] = rotMatrix[5];
 
 	float probeCoord[3];
-	double dataCoord[3];
-	
-	const float* fullSizes = ds->getFullSizes();
-	float extExtents[6]; //Extend extents 1/2 voxel on each side so no bdry issues.
-	for (int i = 0; i<3; i++){
-		float mid = fullSizes[i]*0.5;
-		float halfExtendedSize = fullSizes[i]*0.5*(1.f+dataSize[i])/(float)(dataSize[i]);
-		extExtents[i] = mid - halfExtendedSize;
-		extExtents[i+3] = mid + halfExtendedSize;
-	}
 	float localCorner[4][3];
 	//Map corners of probe into volume 
 	probeCoord[2] = 0.f;
@@ -1397,98 +1381,103 @@ bool ProbeParams::buildIBFVFields(int timestep){
 	ibfvXScale = (float)texWidth/xside;  //Cells per meter
 	ibfvYScale = (float)texHeight/yside;
 
-	if (ibfvUField[timestep]) delete ibfvUField[timestep];
-	if (ibfvVField[timestep]) delete ibfvVField[timestep];
-	if (ibfvValid[timestep]) delete ibfvValid[timestep];
+	//Everything the projected field depends on, other than the timestep:
+	vector<double> key;
+	IBFVFieldCache::MakeKey(transformMatrix, &angles[0], ibfvSessionVarNum, actualRefLevel, lod, key);
 
-	ibfvUField[timestep] = new float[textureSize[0]*textureSize[1]];
-	ibfvVField[timestep] = new float[textureSize[0]*textureSize[1]];
-	ibfvValid[timestep] = new unsigned char[textureSize[0]*textureSize[1]];
-	float sumMag = 0.f;
-	int numValidPoints = 0;
-	//Use the RegularGrid to calculate coordinates in volume
-	DataMgr* dataMgr = ds->getDataMgr();
+	if (ibfvUField) delete [] ibfvUField;
+	if (ibfvVField) delete [] ibfvVField;
+	if (ibfvValid) delete [] ibfvValid;
+	ibfvUField = new float[texWidth*texHeight];
+	ibfvVField = new float[texWidth*texHeight];
+	ibfvValid = new unsigned char[texWidth*texHeight];
+	ibfvTimestep = -1;
+	ibfvMeshSize = 0;
+
+	if (!ibfvCache) ibfvCache = new IBFVFieldCache();
+	float fieldMag;
+	if (!ibfvCache->Find((size_t)timestep, key, texWidth, texHeight,
+			ibfvUField, ibfvVField, ibfvValid, &fieldMag)){
+		
+		const vector<double>&userExts = ds->getDataMgr()->GetExtents((size_t)timestep);
+		//Now obtain the field values for the current probe
+		double extents[6];
+		float boxmin[3],boxmax[3];
+		getLocalContainingRegion(boxmin, boxmax);
+		for (int i = 0; i<3; i++){
+			extents[i] = boxmin[i]+userExts[i];
+			extents[i+3] = boxmax[i]+userExts[i];
+		}							
+		RegularGrid* grids[3];
+		
+		int rc = getGrids( timestep, varnames, extents, &actualRefLevel, &lod,  grids);
+		if (!rc) return false;
 
-	//Loop over pixels in texture
-	for (int iy = 0; iy < texHeight; iy++){
-		//Map iy to a value between -1 and 1
-		probeCoord[1] = -1.f + 2.f*(float)iy/(float)(texHeight-1);
-		for (int ix = 0; ix < texWidth; ix++){
-			
-			//find the coords that the texture maps to
-			//probeCoord is the coord in the probe, dataCoord is in data volume 
-			//probeCoord goes from -1 to 1, 
-			//datacoord is a point in probe in world coords.
-			probeCoord[0] = -1.f + 2.f*(float)ix/(float)(texWidth-1);
-			vtransform(probeCoord, transformMatrix, dataCoord);
-			
-			bool dataOK = true;
-			for (int i = 0; i< 3; i++){
-				if (dataCoord[i] < extExtents[i] || dataCoord[i] > extExtents[i+3]) dataOK = false;
-				//Convert to user coordinates:
-				dataCoord[i] += userExts[i];
-			}
-			
-			int texPos = ix + texWidth*iy;
-			
-			if(dataOK) { //find the coordinate in the data array
-				float vecField[3];
-				
-				for (int k = 0; k<3; k++){
-					if(grids[k]) {
-						float fieldval = grids[k]->GetValue(dataCoord[0],dataCoord[1],dataCoord[2]);
-						if (fieldval == grids[k]->GetMissingValue()) {
-							dataOK = false;
-							vecField[k]=0.;
-						}
-						else vecField[k] = fieldval;
-					}
-					else vecField[k] = 0.f;
-				}
-				
-				if (dataOK){
-					//Project this vector to the probe plane, saving the magnitude:
-					numValidPoints++;
-					float uVal, vVal;
-					projToPlane(vecField, invMatrix, &uVal,&vVal);
-					if(ibfvMag < 0.f) sumMag += (uVal*uVal + vVal*vVal);
-					ibfvUField[timestep][texPos] = uVal;
-					ibfvVField[timestep][texPos] = vVal;
-					ibfvValid[timestep][texPos] = 1;
-				} else {
-					ibfvUField[timestep][texPos] = 0;
-					ibfvVField[timestep][texPos] = 0;
-					ibfvValid[timestep][texPos] = 0;
-				}
+		//Then go through the grids, projecting the field values to the 2D plane.
+		//Each (x,y) probe coord is converted to the closest point in the probe grid
+		//Each field value is also multiplied by scale factor, times a factor that relates the
+		//user coord system to the probe grid coords.
+		
+		//Get the data dimensions (at this resolution):
+		int dataSize[3];
+		for (int i = 0; i< 3; i++){
+			dataSize[i] = (int)ds->getFullSizeAtLevel(actualRefLevel,i);
+		}
+		const float* fullSizes = ds->getFullSizes();
+		float extExtents[6]; //Extend extents 1/2 voxel on each side so no bdry issues.
+		for (int i = 0; i<3; i++){
+			float mid = fullSizes[i]*0.5;
+			float halfExtendedSize = fullSizes[i]*0.5*(1.f+dataSize[i])/(float)(dataSize[i]);
+			extExtents[i] = mid - halfExtendedSize;
+			extExtents[i+3] = mid + halfExtendedSize;
+		}
+
+		//Sample the three grids at all texels, in parallel:
+		float* vecFields = new float[3*texWidth*texHeight];
+		ProbeTexelMapper mapper(transformMatrix, extExtents, userExts);
+		TextureBuilder builder;
+		builder.Sample(grids, &mapper, texWidth, texHeight, vecFields, ibfvValid);
+
+		//Project the vectors to the probe plane, saving the magnitude:
+		float sumMag = 0.f;
+		for (int texPos = 0; texPos < texWidth*texHeight; texPos++){
+			if (ibfvValid[texPos]){
+				float uVal, vVal;
+				projToPlane(vecFields+3*texPos, invMatrix, &uVal,&vVal);
+				sumMag += (uVal*uVal + vVal*vVal);
+				ibfvUField[texPos] = uVal;
+				ibfvVField[texPos] = vVal;
+			} else {
+				ibfvUField[texPos] = 0;
+				ibfvVField[texPos] = 0;
 			}
-			else {//point is out of region
-				ibfvUField[timestep][texPos] = 0;
-				ibfvVField[timestep][texPos] = 0;
-				ibfvValid[timestep][texPos] = 0;
+		}
+		delete [] vecFields;
+		if (sumMag > 0.f) sumMag = sqrt(sumMag);
+		fieldMag = sumMag;
+
+		DataMgr* dataMgr = ds->getDataMgr();
+		for (int i = 0; i<3; i++){
+			if (grids[i]){
+				dataMgr->UnlockGrid(grids[i]);
+				delete grids[i];
 			}
+		}
+		ibfvCache->Insert((size_t)timestep, key, texWidth, texHeight,
+			ibfvUField, ibfvVField, ibfvValid, fieldMag);
+	}
 
-		}//End loop over ix
-	}//End loop over iy
-	if (ibfvMag < 0.f) {  //calculate new magnitude, or use previously calculated mag
-		if (sumMag > 0.f) sumMag = sqrt(sumMag);
-		ibfvMag = sumMag;
+	if (ibfvMag < 0.f) {  //use magnitude of this field, or use previously calculated mag
+		ibfvMag = fieldMag;
 		if (ibfvMag == 0.f) ibfvMag = 1.f; //special case for constant 0 field
 	}
 	float scaleFac = 4.f*fieldScale/ibfvMag;
 	//Now renormalize
-	for (int iy = 0; iy < texHeight; iy++){
-		for (int ix = 0; ix < texWidth; ix++){
-			int texPos = ix + texWidth*iy;
-			ibfvUField[timestep][texPos] *= scaleFac;
-			ibfvVField[timestep][texPos] *= scaleFac;
-		}
-	}
-	for (int i = 0; i<3; i++){
-		if (grids[i]){
-			dataMgr->UnlockGrid(grids[i]);
-			delete grids[i];
-		}
+	for (int texPos = 0; texPos < texWidth*texHeight; texPos++){
+		ibfvUField[texPos] *= scaleFac;
+		ibfvVField[texPos] *= scaleFac;
 	}
+	ibfvTimestep = timestep;
 			
 	return true;
 }
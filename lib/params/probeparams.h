@@ -40,6 +40,7 @@ class XmlNode;
 class ParamNode;
 class FlowParams;
 class Histo;
+class IBFVFieldCache;
 class PARAMS_API ProbeParams : public RenderParams{
 	
 public: 
@@ -203,6 +204,26 @@ public:
 		if (textureType == 0) probeDataTextures = textureArray; else probeIBFVTextures = textureArray;
 	}
 	unsigned char* calcProbeDataTexture(int timestep, int wid, int ht);
+	//What calcProbeDataTexture() reads from the params, captured by getDataTextureSpec()
+	//so that buildDataTexture() can calculate the texture on a worker thread.
+	struct DataTextureSpec {
+		int timestep;
+		vector<string> varnames;
+		double extents[6];
+		int refLevel;
+		int lod;
+		bool linearInterp;
+		float transformMatrix[12];
+		float clut[256*4];
+		int numEntries;
+		float minColorMapValue, maxColorMapValue;
+		vector<double> userExts;
+		int width, height;
+	};
+	bool getDataTextureSpec(int timestep, int wid, int ht, DataTextureSpec& spec);
+	static unsigned char* buildDataTexture(DataTextureSpec& spec, int* errCode = 0);
+	//Incremented whenever setProbeDirty() discards the textures
+	int getTextureVersion() {return textureVersion;}
 	
 	unsigned char* getCurrentProbeTexture(int timestep, int texType) {
 		if( texType == 0) return probeDataTextures[timestep];
@@ -255,6 +276,12 @@ public:
 	//all 4 are in grid coords of current probe
 	void getIBFVValue(int timestep, float x, float y, float* px, float* py);
 	bool buildIBFVFields(int timestep);
+	//Return the NMESH*NMESH mesh vertices advected by the field of the timestep,
+	//as (x,y) pairs, vertex (i,j) at 2*(j+NMESH*i).  Equivalent to calling
+	//getIBFVValue() at x = i*DM, y = j*DM, DM = 0.999999/(NMESH-1).
+	//The mesh is kept until the field or the field scale changes.
+	//Returns 0 if the field cannot be built.
+	const float* getIBFVMesh(int timestep);
 	//Project a 3-vector to the probe plane, provide the inverse 3x3 rotation matrix
 	void projToPlane(float vecField[3], float invRotMtrx[9], float* U, float* V);
 	void setIBFVComboVarNum(int indx, int varnum){
@@ -266,7 +293,8 @@ public:
 	}
 	int getIBFVSessionVarNum(int indx) {return ibfvSessionVarNum[indx];}
 	bool ibvfPointIsValid(int timestep, int uv){
-		return (ibfvValid[timestep][uv] != 0);
+		assert(timestep == ibfvTimestep);
+		return (ibfvValid[uv] != 0);
 	}
 	bool ibfvColorMerged() {return mergeColor;}
 	bool linearInterpTex() {return linearInterp;}
@@ -357,18 +385,28 @@ protected:
 	float cursorCoords[2];
 	
 	int textureSize[2];
+	int textureVersion;
 	//Values used for IBFV sampling
 	int NPN;
 	int NMESH;
 	//IBFV parameters:
 	float alpha, fieldScale;
 	bool mergeColor;
-	//There are 2 ibfv fields for each time step
-	//ibfvUField[t][w] is the U-value at point w = (x+wid*y) at timestep t
+	//The 2 ibfv fields of the timestep being rendered (ibfvTimestep, -1 if none)
+	//ibfvUField[w] is the U-value at point w = (x+wid*y)
 	//ibfvValid indicates that the associated texture point is within valid region.
-	float** ibfvUField;
-	float** ibfvVField;
-	unsigned char** ibfvValid;
+	//Fields of recently used timesteps are kept (unscaled, at reduced precision)
+	//in ibfvCache, so they are not resampled when only the scaling changes or
+	//when returning to a timestep.
+	float* ibfvUField;
+	float* ibfvVField;
+	unsigned char* ibfvValid;
+	int ibfvTimestep;
+	IBFVFieldCache* ibfvCache;
+	//Advected mesh for ibfvTimestep, see getIBFVMesh()
+	float* ibfvMesh;
+	int ibfvMeshSize;
+	float ibfvMeshScale;
 	float ibfvMag; //Saves the average magnitude of the 2d field at the first time step calculated.
 	//This avoids change in normalization per timestep; perhaps it would be better to normalize
 	//different timesteps differently?
@@ -40,6 +40,7 @@
 #include "histo.h"
 #include "animationparams.h"
 #include "viewpointparams.h"
+#include "TextureBuilder.h"
 
 #include <vapor/DataMgr.h>
 #include <vapor/errorcodes.h>
@@ -898,6 +899,55 @@ void TwoDDataParams::setTwoDDirty(){
 	setAllBypass(false);
 }
 
+namespace {
+	//Maps texels of the twoD texture to user coordinates in the volume.
+	//Pixel centers start at 1/2 pixel from edge
+	class TwoDTexelMapper : public TexelMapper {
+	public:
+		TwoDTexelMapper(const float a[2], const float b[2], float constVal,
+			const int mapDims[3], int dataOrientation,
+			const float extExtents[6], const vector<double>& usrExts){
+			for (int i = 0; i<2; i++){ scale[i] = a[i]; offset[i] = b[i];}
+			constValue = constVal;
+			for (int i = 0; i<3; i++) dims[i] = mapDims[i];
+			orientation = dataOrientation;
+			for (int i = 0; i<6; i++) extendedExtents[i] = extExtents[i];
+			for (int i = 0; i<3; i++) userExtents[i] = usrExts[i];
+		}
+		void MapRow(int iy, int texWidth, int texHeight, double* coords, bool* valid) const {
+			float twoDCoord[2];
+			float halfPixHt = 1./(float)texHeight;
+			float halfPixWid = 1./(float)texWidth;
+			//Map iy to a value between -1 and 1
+			// .5*h - 1 and 1 -.5*h, where h is the height of a pixel relative to [-1,1]
+			twoDCoord[1] = halfPixHt-1.f + 2.f*(1.-halfPixHt)*(float)iy/(float)(texHeight-1);
+			for (int ix = 0; ix < texWidth; ix++){
+				double* dataCoord = coords+3*ix;
+				twoDCoord[0] = halfPixWid-1.f + 2.f*(1.-halfPixWid)*(float)ix/(float)(texWidth-1);
+				//find the coords that the texture maps to
+				//twoDCoord is the coord in the twoD slice, dataCoord is in data volume 
+				dataCoord[dims[2]] = constValue;
+				dataCoord[dims[0]] = twoDCoord[0]*scale[0]+offset[0];
+				dataCoord[dims[1]] = twoDCoord[1]*scale[1]+offset[1];
+				valid[ix] = true;
+				for (int i = 0; i< 3; i++){
+					if (i == orientation) continue;
+					if (dataCoord[i] < extendedExtents[i] || dataCoord[i] > extendedExtents[i+3]) valid[ix] = false;
+				}
+				//Convert to user coordinates
+				for (int k=0; k<3; k++) dataCoord[k] += userExtents[k];
+			}
+		}
+	private:
+		float scale[2], offset[2];
+		float constValue;
+		int dims[3];
+		int orientation;
+		float extendedExtents[6];
+		double userExtents[3];
+	};
+};
+
 //Calculate the twoD texture (if it needs refreshing).
 //It's kept (cached) in the twoD params
 //If nonzero texture dimensions are provided, then the cached image
@@ -998,57 +1048,12 @@ calcTwoDDataTexture(int ts, int &texWidth, int &texHeight){
 
 	_texBuf = new unsigned char[texWidth*texHeight*4];
 
-	//Loop over pixels in texture.  Pixel centers start at 1/2 pixel from edge
+	//Loop over pixels in texture, using all available threads.
 	int dataOrientation = ds->get2DOrientation(firstVarNum);
-	float halfPixHt = 1./(float)texHeight;
-	float halfPixWid = 1./(float)texWidth;
-
-	for (int iy = 0; iy < texHeight; iy++){
-		//Map iy to a value between -1 and 1
-		// .5*h - 1 and 1 -.5*h, where h is the height of a pixel relative to [-1,1]
-		
-		twoDCoord[1] = halfPixHt-1.f + 2.f*(1.-halfPixHt)*(float)iy/(float)(texHeight-1);
-		for (int ix = 0; ix < texWidth; ix++){
-			bool dataOK = true;
-			twoDCoord[0] = halfPixWid-1.f + 2.f*(1.-halfPixWid)*(float)ix/(float)(texWidth-1);
-			//find the coords that the texture maps to
-			//twoDCoord is the coord in the twoD slice, dataCoord is in data volume 
-			dataCoord[mapDims[2]] = constValue[0];
-			dataCoord[mapDims[0]] = twoDCoord[0]*a[0]+b[0];
-			dataCoord[mapDims[1]] = twoDCoord[1]*a[1]+b[1];
-			
-			for (int i = 0; i< 3; i++){
-				if (i == dataOrientation) continue;
-				if (dataCoord[i] < extExtents[i] || dataCoord[i] > extExtents[i+3]) dataOK = false;
-			}
-			
-			if(dataOK) { //find the coordinate in the data array
-				//Convert to user coordinates
-				
-				for (int k=0; k<3; k++) dataCoord[k] += _usrExts[k];
-				float varVal = twoDGrid->GetValue(dataCoord[0],dataCoord[1],dataCoord[2]);
-
-				if (varVal != twoDGrid->GetMissingValue()){ 
-	
-					//Use the transfer function to map the data:
-					int lutIndex = transFunc->mapFloatToIndex(varVal);
-				
-					_texBuf[4*(ix+texWidth*iy)] = (unsigned char)(0.5+ clut[4*lutIndex]*255.f);
-					_texBuf[4*(ix+texWidth*iy)+1] = (unsigned char)(0.5+ clut[4*lutIndex+1]*255.f);
-					_texBuf[4*(ix+texWidth*iy)+2] = (unsigned char)(0.5+ clut[4*lutIndex+2]*255.f);
-					_texBuf[4*(ix+texWidth*iy)+3] = (unsigned char)(0.5+ clut[4*lutIndex+3]*255.f);
-				} else {dataOK = false;}
-				
-			}
-			if(!dataOK) {//point out of region or missing value:
-				_texBuf[4*(ix+texWidth*iy)] = 0;
-				_texBuf[4*(ix+texWidth*iy)+1] = 0;
-				_texBuf[4*(ix+texWidth*iy)+2] = 0;
-				_texBuf[4*(ix+texWidth*iy)+3] = 0;
-			}
-
-		}//End loop over ix
-	}//End loop over iy
+	TwoDTexelMapper mapper(a, b, constValue[0], mapDims, dataOrientation, extExtents, _usrExts);
+	TextureBuilder builder;
+	builder.SetLut(clut, transFunc->getNumEntries(), transFunc->getMinColorMapValue(), transFunc->getMaxColorMapValue());
+	builder.Build(twoDGrid, &mapper, texWidth, texHeight, _texBuf);
 	
 	dataMgr->UnlockGrid(twoDGrid);
 	delete twoDGrid;
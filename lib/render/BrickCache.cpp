@@ -0,0 +1,119 @@
+//-- BrickCache.cpp ----------------------------------------------------------
+//
+// Least recently used cache of texture bricks
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4251)
+#endif
+
+#include "BrickCache.h"
+
+using namespace VAPoR;
+
+BrickCache::bkey_t::bkey_t(
+	int reflevel, const size_t min[3], const size_t max[3]
+) {
+	_reflevel = reflevel;
+	for (int i=0; i<3; i++) {
+		_box[i] = min[i];
+		_box[i+3] = max[i];
+	}
+}
+
+bool BrickCache::bkey_t::operator<(const bkey_t &k) const {
+	if (_reflevel != k._reflevel) return(_reflevel < k._reflevel);
+	for (int i=0; i<6; i++) {
+		if (_box[i] != k._box[i]) return(_box[i] < k._box[i]);
+	}
+	return(false);
+}
+
+BrickCache::BrickCache(size_t maxBytes, Release_T release) {
+	_maxBytes = maxBytes;
+	_release = release;
+	_nbytes = 0;
+	_nevicted = 0;
+}
+
+BrickCache::~BrickCache() {
+	Clear();
+}
+
+void *BrickCache::Get(int reflevel, const size_t min[3], const size_t max[3]) {
+	std::map <bkey_t, std::list <entry_t>::iterator>::iterator itr;
+	itr = _index.find(bkey_t(reflevel, min, max));
+	if (itr == _index.end()) return(NULL);
+
+	_lru.splice(_lru.begin(), _lru, itr->second);
+	return(itr->second->brick);
+}
+
+bool BrickCache::Contains(
+	int reflevel, const size_t min[3], const size_t max[3]
+) const {
+	return(_index.find(bkey_t(reflevel, min, max)) != _index.end());
+}
+
+void BrickCache::Put(
+	int reflevel, const size_t min[3], const size_t max[3],
+	void *brick, size_t nbytes
+) {
+	if (nbytes > _maxBytes) {
+		if (_release) _release(brick);
+		_nevicted++;
+		return;
+	}
+
+	bkey_t key(reflevel, min, max);
+	std::map <bkey_t, std::list <entry_t>::iterator>::iterator itr;
+	itr = _index.find(key);
+	if (itr != _index.end()) {
+		entry_t &e = *(itr->second);
+		if (e.brick != brick && _release) _release(e.brick);
+		_nbytes -= e.nbytes;
+		_lru.erase(itr->second);
+		_index.erase(itr);
+	}
+
+	_evict(_maxBytes - nbytes);
+
+	entry_t e;
+	e.key = NULL;
+	e.brick = brick;
+	e.nbytes = nbytes;
+	_lru.push_front(e);
+	itr = _index.insert(std::make_pair(key, _lru.begin())).first;
+	_lru.front().key = (bkey_t *) &itr->first;
+	_nbytes += nbytes;
+}
+
+void BrickCache::Clear() {
+	std::list <entry_t>::iterator itr;
+	for (itr = _lru.begin(); itr != _lru.end(); ++itr) {
+		if (_release) _release(itr->brick);
+	}
+	_lru.clear();
+	_index.clear();
+	_nbytes = 0;
+}
+
+void BrickCache::SetMaxBytes(size_t maxBytes) {
+	_maxBytes = maxBytes;
+	_evict(_maxBytes);
+}
+
+//
+// Release least recently used bricks until at most maxBytes are used
+//
+void BrickCache::_evict(size_t maxBytes) {
+	while (_nbytes > maxBytes && ! _lru.empty()) {
+		entry_t &e = _lru.back();
+		if (_release) _release(e.brick);
+		_nbytes -= e.nbytes;
+		_index.erase(*e.key);
+		_lru.pop_back();
+		_nevicted++;
+	}
+}
@@ -0,0 +1,115 @@
+//-- BrickCache.h ------------------------------------------------------------
+//
+// Bounded cache of the texture bricks of a multiresolution volume, evicted
+// in least recently used order. No OpenGL calls are made: the bricks are
+// released through a callback.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _BrickCache_h_
+#define _BrickCache_h_
+
+#include <list>
+#include <map>
+#include <cstddef>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class BrickCache
+//! \brief A least recently used cache of bricks
+//!
+//! Bricks are identified by their refinement level and voxel box at that
+//! level. The cache owns the bricks it holds, and releases them when they
+//! are evicted, when they are replaced, or when the cache is cleared.
+//
+class RENDER_API BrickCache {
+public:
+
+ //! Function releasing a brick
+ //
+ typedef void (*Release_T)(void *brick);
+
+ //! \param[in] maxBytes Size of the cache, in bytes
+ //! \param[in] release Function releasing the bricks
+ //
+ BrickCache(size_t maxBytes, Release_T release);
+
+ //! Release every brick
+ //
+ ~BrickCache();
+
+ //! Look up a brick, making it the most recently used one
+ //!
+ //! \retval brick The brick, or NULL if it isn't in the cache
+ //
+ void *Get(int reflevel, const size_t min[3], const size_t max[3]);
+
+ //! Return true if a brick is in the cache, without touching it
+ //
+ bool Contains(int reflevel, const size_t min[3], const size_t max[3]) const;
+
+ //! Add a brick, evicting least recently used bricks until the cache
+ //! holds at most its size. A brick larger than the cache is released
+ //! at once.
+ //!
+ //! \param[in] nbytes Memory used by the brick
+ //
+ void Put(
+	int reflevel, const size_t min[3], const size_t max[3],
+	void *brick, size_t nbytes
+ );
+
+ //! Release every brick
+ //
+ void Clear();
+
+ //! Change the size of the cache, evicting bricks if needed
+ //
+ void SetMaxBytes(size_t maxBytes);
+
+ size_t GetMaxBytes() const { return(_maxBytes); }
+
+ //! Return the memory used by the bricks held
+ //
+ size_t GetBytes() const { return(_nbytes); }
+
+ //! Return the number of bricks held
+ //
+ size_t GetSize() const { return(_index.size()); }
+
+ //! Return the number of bricks evicted since the cache was created
+ //
+ size_t GetNumEvicted() const { return(_nevicted); }
+
+private:
+ class bkey_t {
+ public:
+	bkey_t(int reflevel, const size_t min[3], const size_t max[3]);
+	bool operator<(const bkey_t &k) const;
+
+	int _reflevel;
+	size_t _box[6];
+ };
+
+ typedef struct {
+	bkey_t *key;
+	void *brick;
+	size_t nbytes;
+ } entry_t;
+
+ size_t _maxBytes;
+ Release_T _release;
+ size_t _nbytes;
+ size_t _nevicted;
+
+ std::list <entry_t> _lru;		// most recently used first
+ std::map <bkey_t, std::list <entry_t>::iterator> _index;
+
+ void _evict(size_t maxBytes);
+};
+
+};
+
+#endif	// _BrickCache_h_
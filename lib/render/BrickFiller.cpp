@@ -0,0 +1,364 @@
+//-- BrickFiller.cpp ---------------------------------------------------------
+//
+// Quantization of RegularGrid values into texture bricks
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cmath>
+#include <cstring>
+#include "BrickFiller.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+namespace {
+
+	//
+	// Combine the hash of a line or slab with its index. Hashes
+	// of different lines (slabs) are summed, so the order in which
+	// they're computed doesn't matter.
+	//
+	unsigned long long mix(unsigned long long h, unsigned long long index) {
+		h ^= (index + 1) * 0x9e3779b97f4a7c15ULL;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		return(h);
+	}
+};
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunBrickFillerThread(void *object) {
+		BrickFiller::ThreadObj *X = (BrickFiller::ThreadObj *) object;
+		X->FillThread();
+		return(0);
+	}
+};
+
+BrickFiller::BrickFiller(int nthreads) : _et(nthreads) {
+
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_hash = 0;
+
+	_szcomp = 1;
+	_ncomp = 1;
+	_missing = false;
+	_layered = false;
+	_zscale = 1.0;
+
+	_rg = NULL;
+	for (int i=0; i<6; i++) _extents[i] = 0.0;
+	_range[0] = _range[1] = 0.0;
+	_data = NULL;
+	_nx = _ny = _nz = 0;
+	_xoffset = _yoffset = _zoffset = 0;
+	_rowStride = _slabStride = 0;
+}
+
+int BrickFiller::SetFormat(
+	int szcomp, int ncomp, bool missing, bool layered, float zscale
+) {
+	int nused = 1;
+	if (missing) nused++;
+	if (layered) nused++;
+
+	if (! (szcomp == 1 || szcomp == 2) || ncomp < nused || ncomp > 4) {
+		SetErrMsg("Invalid texel format");
+		return(-1);
+	}
+	_szcomp = szcomp;
+	_ncomp = ncomp;
+	_missing = missing;
+	_layered = layered;
+	_zscale = zscale;
+	return(0);
+}
+
+int BrickFiller::Fill(
+	const RegularGrid *rg, const float range[2], unsigned char *data,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset, int yoffset, int zoffset
+) {
+	_range[0] = range[0];
+	_range[1] = range[1];
+	return(_run(rg, data, bx, by, bz, dnx, dny, dnz, xoffset, yoffset, zoffset));
+}
+
+int BrickFiller::Hash(
+	const RegularGrid *rg,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset, int yoffset, int zoffset
+) {
+	return(_run(rg, NULL, bx, by, bz, dnx, dny, dnz, xoffset, yoffset, zoffset));
+}
+
+void BrickFiller::GetBlocks(const RegularGrid *rg, vector <float *> &blks) {
+	blks.clear();
+
+	float **gblks = rg->GetBlks();
+	if (! gblks) return;
+
+	size_t origin[3], dims[3], bs[3];
+	rg->GetIJKOrigin(origin);
+	rg->GetDimensions(dims);
+	rg->GetBlockSize(bs);
+
+	size_t nblks = 1;
+	for (int i=0; i<3; i++) {
+		nblks *= ((origin[i] % bs[i]) + dims[i] - 1) / bs[i] + 1;
+	}
+	blks.assign(gblks, gblks + nblks);
+}
+
+int BrickFiller::_run(
+	const RegularGrid *rg, unsigned char *data,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset, int yoffset, int zoffset
+) {
+	_hash = 0;
+
+	size_t dims[3];
+	rg->GetDimensions(dims);
+
+	_rg = rg;
+	_data = data;
+	rg->GetUserExtents(_extents);
+
+	if (xoffset == 0 && yoffset == 0 && zoffset == 0 &&
+		dims[0] <= bx && dims[1] <= by && dims[2] <= bz) {
+
+		// Store the whole grid densely
+		//
+		_nx = dims[0];
+		_ny = dims[1];
+		_nz = dims[2];
+		_rowStride = dims[0];
+		_slabStride = dims[0] * dims[1];
+	}
+	else {
+		_nx = bx < dnx ? bx : dnx;
+		_ny = by < dny ? by : dny;
+		_nz = bz < dnz ? bz : dnz;
+		_rowStride = bx;
+		_slabStride = (size_t) bx * (size_t) by;
+	}
+	_xoffset = xoffset;
+	_yoffset = yoffset;
+	_zoffset = zoffset;
+
+	int rc = 0;
+	if (_nx > 0 && _ny > 0 && _nz > 0) {
+		vector <ThreadObj *> objs;
+		for (int t=0; t<_nthreads; t++) {
+			objs.push_back(new ThreadObj(this, t));
+		}
+
+		if (_nthreads <= 1 || _nz <= 1) {
+			objs[0]->FillThread();
+		}
+		else {
+			rc = _et.ParRun(RunBrickFillerThread, (void **) &objs[0]);
+			if (rc < 0) SetErrMsg("Error spawning threads");
+		}
+
+		for (int t=0; t<_nthreads; t++) {
+			_hash += objs[t]->GetHash();
+			delete objs[t];
+		}
+	}
+
+	_rg = NULL;
+	_data = NULL;
+	return(rc < 0 ? -1 : 0);
+}
+
+BrickFiller::ThreadObj::ThreadObj(BrickFiller *bf, int id) {
+	_bf = bf;
+	_id = id;
+	_hash = 0;
+}
+
+void BrickFiller::ThreadObj::FillThread() {
+
+	int nthreads = _bf->_nthreads;
+
+	// A single thread does all of the work if there are too few slabs
+	//
+	if (_bf->_nz < nthreads) {
+		if (_id != 0) return;
+		nthreads = 1;
+	}
+
+	vector <float> values(_bf->_nx);
+	vector <unsigned int> q(_bf->_nx);
+
+	for (int z = _id; z < _bf->_nz; z += nthreads) {
+		_hash += mix(_bf->_fillSlab(z, values, q), z);
+	}
+}
+
+//
+// Fill (or just hash) one slab of the brick. Returns the hash of
+// the slab's grid values.
+//
+unsigned long long BrickFiller::_fillSlab(
+	int z, vector <float> &values, vector <unsigned int> &q
+) const {
+
+	unsigned long long hash = 0;
+	for (int y = 0; y < _ny; y++) {
+		_readLine(y, z, &values[0]);
+
+		unsigned int h = 0;
+		for (int x = 0; x < _nx; x++) {
+			unsigned int bits;
+			memcpy(&bits, &values[x], sizeof(bits));
+			h += bits * (unsigned int) (2*x + 1);
+		}
+		hash += mix(h, y);
+
+		if (! _data) continue;
+
+		_quantize(&values[0], _nx, &q[0]);
+		_store(y, z, &values[0], &q[0]);
+	}
+	return(hash);
+}
+
+//
+// Read the grid values of one line of the brick, a block-contiguous
+// run at a time
+//
+void BrickFiller::_readLine(int y, int z, float *values) const {
+
+	size_t origin[3], dims[3], bs[3];
+	_rg->GetIJKOrigin(origin);
+	_rg->GetDimensions(dims);
+	_rg->GetBlockSize(bs);
+	float **blks = _rg->GetBlks();
+	float mv = _rg->GetMissingValue();
+
+	size_t yy = y + _yoffset;
+	size_t zz = z + _zoffset;
+
+	int x = 0;
+	if (blks && yy < dims[1] && zz < dims[2]) {
+
+		//
+		// The grid's first block starts goff voxels before the grid origin
+		//
+		size_t goff[3], gbdim[3];
+		for (int i=0; i<3; i++) {
+			goff[i] = origin[i] % bs[i];
+			gbdim[i] = (goff[i] + dims[i] - 1) / bs[i] + 1;
+		}
+
+		size_t gbz = (zz + goff[2]) / bs[2];
+		size_t zoff = (zz + goff[2]) % bs[2];
+		size_t gby = (yy + goff[1]) / bs[1];
+		size_t yoff = (yy + goff[1]) % bs[1];
+
+		while (x < _nx && x + _xoffset < dims[0]) {
+			size_t xx = x + _xoffset + goff[0];
+			size_t gbx = xx / bs[0];
+			size_t xoff = xx % bs[0];
+
+			size_t n = bs[0] - xoff;
+			if (n > dims[0] - (x + _xoffset)) n = dims[0] - (x + _xoffset);
+			if (n > _nx - x) n = _nx - x;
+
+			const float *line = blks[(gbz*gbdim[1] + gby)*gbdim[0] + gbx] +
+				(zoff*bs[1] + yoff)*bs[0] + xoff;
+
+			memcpy(values + x, line, n * sizeof(values[0]));
+			x += n;
+		}
+	}
+
+	// Grid points outside of the grid
+	//
+	for (; x < _nx; x++) values[x] = mv;
+}
+
+//
+// Quantize values, rounding to nearest even like rint(). Adding 2^23
+// to a float between 0 and 2^23 rounds it to an integer. The loop has
+// no branches so that the compiler can vectorize it.
+//
+void BrickFiller::_quantize(const float *v, int n, unsigned int *q) const {
+
+	float r0 = _range[0];
+	float d = _range[1] - _range[0];
+	float qmax = _szcomp == 1 ? 255.f : 65535.f;
+
+	for (int i = 0; i < n; i++) {
+		float x = (v[i] - r0) / d * qmax;
+		x = x > 0.f ? x : 0.f;
+		x = x < qmax ? x : qmax;
+		q[i] = (unsigned int) ((int) (x + 8388608.f) - 8388608);
+	}
+}
+
+//
+// Interleave one line of quantized values, and the optional missing
+// value flags and layered coordinates, into the brick
+//
+void BrickFiller::_store(
+	int y, int z, const float *v, const unsigned int *q
+) const {
+
+	size_t step = _szcomp * _ncomp;
+	unsigned char *line = _data +
+		((size_t) z * _slabStride + (size_t) y * _rowStride) * step;
+
+	int c = 0;	// component
+	unsigned char *ucptr = line;
+	if (_szcomp == 1) {
+		for (int x = 0; x < _nx; x++, ucptr += step) {
+			ucptr[0] = (unsigned char) q[x];
+		}
+	}
+	else {
+		for (int x = 0; x < _nx; x++, ucptr += step) {
+			ucptr[0] = (unsigned char) (q[x] & 0xff);
+			ucptr[1] = (unsigned char) ((q[x] >> 8) & 0xff);
+		}
+	}
+	c++;
+
+	if (_missing) {
+		float mv = _rg->GetMissingValue();
+		ucptr = line + c * _szcomp;
+		for (int x = 0; x < _nx; x++, ucptr += step) {
+			unsigned char flag = v[x] == mv ? 0xff : 0;
+			ucptr[0] = flag;
+			if (_szcomp == 2) ucptr[1] = flag;
+		}
+		c++;
+	}
+
+	if (_layered) {
+		double qmax = _szcomp == 1 ? 255 : 65535;
+		ucptr = line + c * _szcomp;
+		for (int x = 0; x < _nx; x++, ucptr += step) {
+			double x_f, y_f, z_f;
+			(void) _rg->GetUserCoordinates(
+				x + _xoffset, y + _yoffset, z + _zoffset, &x_f, &y_f, &z_f
+			);
+			unsigned int qv = (unsigned int) rint(
+				(z_f-_extents[2])/(_extents[5]-_extents[2]) * _zscale * qmax
+			);
+			ucptr[0] = (unsigned char) (qv & 0xff);
+			if (_szcomp == 2) ucptr[1] = (unsigned char) ((qv >> 8) & 0xff);
+		}
+		c++;
+	}
+}
@@ -0,0 +1,162 @@
+//-- BrickFiller.h -----------------------------------------------------------
+//
+// Quantization of RegularGrid values into the interleaved 8 or 16 bit
+// texels of a texture brick. No OpenGL calls are made.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _BrickFiller_h_
+#define _BrickFiller_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class BrickFiller
+//! \brief Fills texture bricks from a RegularGrid
+//!
+//! Each texel of a brick has \a ncomp components of \a szcomp bytes (16 bit
+//! components are little endian). A grid value \a v is quantized to
+//! rint((v-min)/(max-min) * (2^(8*szcomp)-1)), clamped to the component's
+//! range. The quantized value may be followed by a missing value flag,
+//! all ones if \a v is the grid's missing value and zero otherwise, and
+//! by the quantized normalized z user coordinate of the grid point, for
+//! layered grids. Texels of grid points that aren't filled are untouched.
+//!
+//! Slabs of constant z are spread over threads. Grid values are read a
+//! storage block run at a time and quantized a line at a time by a loop
+//! free of branches, which the compiler may vectorize.
+//!
+//! The filler also computes a hash of the grid values read, which may be
+//! used to detect that the values stored in a brick haven't changed.
+//
+class RENDER_API BrickFiller : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ BrickFiller(int nthreads = 0);
+ virtual ~BrickFiller() {}
+
+ //! Set the texel format
+ //!
+ //! \param[in] szcomp Size of a component in bytes, 1 or 2
+ //! \param[in] ncomp Number of components per texel
+ //! \param[in] missing If true the quantized value is followed by a
+ //! missing value flag
+ //! \param[in] layered If true the quantized value (and missing value
+ //! flag) is followed by the z coordinate of the grid point, normalized
+ //! to the grid's z extents and scaled by \p zscale
+ //! \param[in] zscale Scale factor of the z coordinate
+ //!
+ //! \retval status A negative int is returned if the format is invalid
+ //
+ int SetFormat(
+	int szcomp, int ncomp, bool missing = false, bool layered = false,
+	float zscale = 1.0
+ );
+
+ //! Fill a brick
+ //!
+ //! Grid point (x+xoffset, y+yoffset, z+zoffset), relative to the grid
+ //! origin, is stored in texel (x, y, z) of a \p bx by \p by by \p bz
+ //! brick, for x less than both \p bx and \p dnx, etc. Grid points
+ //! outside of the grid have the grid's missing value.
+ //!
+ //! If the offsets are zero and the grid fits in the brick the grid
+ //! is instead stored densely, in a brick with the grid's dimensions.
+ //!
+ //! \param[in] rg Source grid
+ //! \param[in] range Data range mapped to the range of a component
+ //! \param[out] data First component of the first texel
+ //!
+ //! \retval status A negative int is returned on failure
+ //!
+ //! \sa GetHash()
+ //
+ int Fill(
+	const RegularGrid *rg, const float range[2], unsigned char *data,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset = 0, int yoffset = 0, int zoffset = 0
+ );
+
+ //! Compute the hash of the grid values Fill() would read, without
+ //! filling anything
+ //!
+ //! \retval status A negative int is returned on failure
+ //!
+ //! \sa GetHash()
+ //
+ int Hash(
+	const RegularGrid *rg,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset = 0, int yoffset = 0, int zoffset = 0
+ );
+
+ //! Return the hash of the grid values read by the last call to
+ //! Fill() or Hash()
+ //
+ unsigned long long GetHash() const { return(_hash); }
+
+ //! Return the storage blocks of a grid
+ //
+ static void GetBlocks(const RegularGrid *rg, std::vector <float *> &blks);
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(BrickFiller *bf, int id);
+	void FillThread();
+	unsigned long long GetHash() const { return(_hash); }
+ private:
+	BrickFiller *_bf;
+	int _id;	// thread id
+	unsigned long long _hash;
+ };
+
+private:
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+ unsigned long long _hash;
+
+ int _szcomp;
+ int _ncomp;
+ bool _missing;
+ bool _layered;
+ float _zscale;
+
+ //
+ // State shared by the thread objects for the current brick
+ //
+ const RegularGrid *_rg;
+ double _extents[6];	// user extents of the grid
+ float _range[2];
+ unsigned char *_data;	// NULL if only hashing
+ int _nx, _ny, _nz;		// grid points stored along each axis
+ int _xoffset, _yoffset, _zoffset;
+ size_t _rowStride;		// texels between the starts of rows
+ size_t _slabStride;	// texels between the starts of slabs
+
+ int _run(
+	const RegularGrid *rg, unsigned char *data,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset, int yoffset, int zoffset
+ );
+ unsigned long long _fillSlab(
+	int z, std::vector <float> &values, std::vector <unsigned int> &q
+ ) const;
+ void _readLine(int y, int z, float *values) const;
+ void _quantize(const float *v, int n, unsigned int *q) const;
+ void _store(int y, int z, const float *v, const unsigned int *q) const;
+};
+
+};
+
+#endif	// _BrickFiller_h_
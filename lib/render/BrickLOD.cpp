@@ -0,0 +1,353 @@
+//-- BrickLOD.cpp ------------------------------------------------------------
+//
+// View dependent selection of the refinement level of volume bricks
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267)
+#endif
+
+#include <cfloat>
+#include <queue>
+#include <algorithm>
+#include "BrickLOD.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+namespace {
+
+	//
+	// Order in which selected bricks are fetched: coarsest first, then
+	// largest error first
+	//
+	class FetchOrder {
+	public:
+		FetchOrder(const BrickLOD *lod) : _lod(lod) {}
+		bool operator()(int a, int b) const {
+			const BrickLOD::brick_t &ba = _lod->GetNode(a);
+			const BrickLOD::brick_t &bb = _lod->GetNode(b);
+			if (ba.reflevel != bb.reflevel) return(ba.reflevel < bb.reflevel);
+			return(ba.error > bb.error);
+		}
+	private:
+		const BrickLOD *_lod;
+	};
+};
+
+BrickLOD::BrickLOD() {
+	SetClassName("BrickLOD");
+
+	for (int i=0; i<3; i++) {
+		_dims[i] = _min[i] = _max[i] = 0;
+		_extents[i] = _extents[i+3] = 0.0;
+	}
+	_maxRefLevel = 0;
+	_rootLevel = 0;
+	_brickDim = 1;
+	for (int i=0; i<16; i++) _mvp[i] = (i % 5 == 0) ? 1.0 : 0.0;
+	for (int i=0; i<4; i++) _viewport[i] = 0;
+}
+
+int BrickLOD::SetRegion(
+	const size_t dims[3], const size_t min[3], const size_t max[3],
+	const double extents[6], int maxRefLevel, int brickDim
+) {
+	_nodes.clear();
+	_selected.clear();
+
+	if (maxRefLevel < 0 || brickDim < 1) {
+		SetErrMsg("Invalid refinement level or brick dimension");
+		return(-1);
+	}
+	for (int i=0; i<3; i++) {
+		if (min[i] > max[i] || max[i] >= dims[i]) {
+			SetErrMsg("Invalid region");
+			return(-1);
+		}
+		_dims[i] = dims[i];
+		_min[i] = min[i];
+		_max[i] = max[i];
+		_extents[i] = extents[i];
+		_extents[i+3] = extents[i+3];
+	}
+	_maxRefLevel = maxRefLevel;
+	_brickDim = brickDim;
+
+	//
+	// The root level is the finest one at which the region spans at most
+	// a brick along each axis (and is covered by at most eight bricks)
+	//
+	_rootLevel = 0;
+	for (int l = 0; l <= _maxRefLevel; l++) {
+		int s = _maxRefLevel - l;
+		bool fits = true;
+		for (int i=0; i<3; i++) {
+			size_t lo = _min[i] >> s;
+			size_t hi = (_max[i] + (1 << s) - 1) >> s;
+			if (hi - lo > (size_t) _brickDim) fits = false;
+		}
+		if (! fits) break;
+		_rootLevel = l;
+	}
+	return(0);
+}
+
+//
+// Set up the node for a brick, clipped to the region. Returns false if
+// the brick doesn't intersect the region.
+//
+bool BrickLOD::_makeNode(
+	int reflevel, const size_t tile[3], int parent, node_t &node
+) const {
+	int s = _maxRefLevel - reflevel;
+	size_t bd = _brickDim;
+
+	node.brick.reflevel = reflevel;
+	node.brick.error = 0.0;
+	node.parent = parent;
+	node.firstChild = -1;
+	node.nchildren = 0;
+
+	for (int i=0; i<3; i++) {
+		node.tile[i] = tile[i];
+
+		//
+		// Region and grid at the brick's level
+		//
+		size_t dim = ((_dims[i] - 1) >> s) + 1;
+		size_t rmin = _min[i] >> s;
+		size_t rmax = (_max[i] + (1 << s) - 1) >> s;
+		if (rmax > dim - 1) rmax = dim - 1;
+
+		size_t lo = tile[i] * bd;
+		size_t hi = (tile[i] + 1) * bd;
+		bool intersects = hi > rmin && (lo < rmax || lo == rmin);
+		if (! intersects) return(false);
+		lo = lo < rmin ? rmin : lo;
+		hi = hi > rmax ? rmax : hi;
+
+		//
+		// Keep at least two grid points along each axis
+		//
+		if (lo == hi) {
+			if (hi < dim - 1) hi++;
+			else if (lo > 0) lo--;
+		}
+		node.brick.min[i] = lo;
+		node.brick.max[i] = hi;
+
+		//
+		// The user extents covered follow from the brick's box at the
+		// finest level, so that children exactly tile their parent
+		//
+		size_t f0 = (tile[i] * bd) << s;
+		size_t f1 = ((tile[i] + 1) * bd) << s;
+		f0 = f0 < _min[i] ? _min[i] : f0;
+		f1 = f1 > _max[i] ? _max[i] : f1;
+
+		double e0 = _extents[i];
+		double e1 = _extents[i+3];
+		size_t n = _max[i] - _min[i];
+		node.brick.extents[i] = n ? e0 + (e1-e0) * (f0-_min[i]) / n : e0;
+		node.brick.extents[i+3] = n ? e0 + (e1-e0) * (f1-_min[i]) / n : e1;
+	}
+	return(true);
+}
+
+//
+// Compute the pixels a voxel of a brick projects to. Returns false if the
+// brick is outside the view frustum.
+//
+bool BrickLOD::_project(brick_t &brick) const {
+	const double *m = _mvp;
+	const double *e = brick.extents;
+
+	int outside[6] = {0,0,0,0,0,0};
+	bool behind = false;
+	double xmin = DBL_MAX, xmax = -DBL_MAX;
+	double ymin = DBL_MAX, ymax = -DBL_MAX;
+
+	for (int c=0; c<8; c++) {
+		double x = e[(c & 1) ? 3 : 0];
+		double y = e[(c & 2) ? 4 : 1];
+		double z = e[(c & 4) ? 5 : 2];
+
+		double cx = m[0]*x + m[4]*y + m[8]*z + m[12];
+		double cy = m[1]*x + m[5]*y + m[9]*z + m[13];
+		double cz = m[2]*x + m[6]*y + m[10]*z + m[14];
+		double cw = m[3]*x + m[7]*y + m[11]*z + m[15];
+
+		if (cx < -cw) outside[0]++;
+		if (cx > cw) outside[1]++;
+		if (cy < -cw) outside[2]++;
+		if (cy > cw) outside[3]++;
+		if (cz < -cw) outside[4]++;
+		if (cz > cw) outside[5]++;
+
+		if (cw <= 0.0) {
+			behind = true;
+			continue;
+		}
+		double px = (cx / cw * 0.5 + 0.5) * _viewport[2];
+		double py = (cy / cw * 0.5 + 0.5) * _viewport[3];
+		xmin = px < xmin ? px : xmin;
+		xmax = px > xmax ? px : xmax;
+		ymin = py < ymin ? py : ymin;
+		ymax = py > ymax ? py : ymax;
+	}
+	for (int p=0; p<6; p++) {
+		if (outside[p] == 8) return(false);
+	}
+
+	//
+	// A brick straddling the eye plane is refined as far as possible
+	//
+	if (behind) {
+		brick.error = FLT_MAX;
+		return(true);
+	}
+
+	size_t n = 1;
+	for (int i=0; i<3; i++) {
+		size_t ni = brick.max[i] - brick.min[i];
+		n = ni > n ? ni : n;
+	}
+	double size = xmax - xmin > ymax - ymin ? xmax - xmin : ymax - ymin;
+	brick.error = size / n;
+	return(true);
+}
+
+void BrickLOD::Select(
+	const double modelview[16], const double projection[16],
+	const int viewport[4], float maxError, size_t maxBricks
+) {
+	_nodes.clear();
+	_selected.clear();
+	if (_brickDim < 1 || _dims[0] == 0) return;
+
+	for (int i=0; i<4; i++) _viewport[i] = viewport[i];
+	for (int c=0; c<4; c++) {
+	for (int r=0; r<4; r++) {
+		double v = 0.0;
+		for (int k=0; k<4; k++) v += projection[k*4+r] * modelview[c*4+k];
+		_mvp[c*4+r] = v;
+	}
+	}
+
+	//
+	// Bricks to refine, largest error first
+	//
+	std::priority_queue <std::pair <float, int> > candidates;
+
+	int s = _maxRefLevel - _rootLevel;
+	size_t t0[3], t1[3];
+	for (int i=0; i<3; i++) {
+		size_t rmin = _min[i] >> s;
+		size_t rmax = (_max[i] + (1 << s) - 1) >> s;
+		t0[i] = rmin / _brickDim;
+		t1[i] = rmax > rmin ? (rmax - 1) / _brickDim : t0[i];
+	}
+	size_t tile[3];
+	for (tile[2] = t0[2]; tile[2] <= t1[2]; tile[2]++) {
+	for (tile[1] = t0[1]; tile[1] <= t1[1]; tile[1]++) {
+	for (tile[0] = t0[0]; tile[0] <= t1[0]; tile[0]++) {
+		node_t node;
+		if (! _makeNode(_rootLevel, tile, -1, node)) continue;
+		if (! _project(node.brick)) continue;
+		_nodes.push_back(node);
+		candidates.push(std::make_pair(node.brick.error, (int) _nodes.size()-1));
+	}
+	}
+	}
+
+	size_t nbricks = _nodes.size();
+	while (! candidates.empty()) {
+		int n = candidates.top().second;
+		candidates.pop();
+
+		const node_t parent = _nodes[n];
+		if (parent.brick.error <= maxError ||
+			parent.brick.reflevel >= _maxRefLevel) {
+
+			_selected.push_back(n);
+			continue;
+		}
+
+		//
+		// The children intersecting the region and the view frustum
+		//
+		std::vector <node_t> children;
+		int reflevel = parent.brick.reflevel + 1;
+		size_t c[3];
+		for (c[2] = 0; c[2] < 2; c[2]++) {
+		for (c[1] = 0; c[1] < 2; c[1]++) {
+		for (c[0] = 0; c[0] < 2; c[0]++) {
+			for (int i=0; i<3; i++) tile[i] = parent.tile[i] * 2 + c[i];
+
+			node_t node;
+			if (! _makeNode(reflevel, tile, n, node)) continue;
+			if (! _project(node.brick)) continue;
+			children.push_back(node);
+		}
+		}
+		}
+
+		if (children.empty() || nbricks - 1 + children.size() > maxBricks) {
+			_selected.push_back(n);
+			continue;
+		}
+
+		nbricks += children.size() - 1;
+		_nodes[n].firstChild = _nodes.size();
+		_nodes[n].nchildren = children.size();
+		for (int i=0; i<children.size(); i++) {
+			_nodes.push_back(children[i]);
+			candidates.push(
+				std::make_pair(children[i].brick.error, (int) _nodes.size()-1)
+			);
+		}
+	}
+
+	std::sort(_selected.begin(), _selected.end(), FetchOrder(this));
+}
+
+bool BrickLOD::_resolve(
+	int n, const std::vector <bool> &available, std::vector <int> &out
+) const {
+	const node_t &node = _nodes[n];
+
+	if (node.nchildren) {
+		size_t size = out.size();
+		bool covered = true;
+		for (int c = 0; c < node.nchildren && covered; c++) {
+			covered = _resolve(node.firstChild + c, available, out);
+		}
+		if (covered) return(true);
+
+		//
+		// Fall back to the brick itself
+		//
+		out.resize(size);
+	}
+
+	if (! available[n]) return(false);
+
+	out.push_back(n);
+	return(true);
+}
+
+bool BrickLOD::Resolve(
+	const std::vector <bool> &available, std::vector <int> &drawable
+) const {
+	drawable.clear();
+	for (int n=0; n<_nodes.size(); n++) {
+		if (_nodes[n].parent < 0) _resolve(n, available, drawable);
+	}
+
+	for (int i=0; i<_selected.size(); i++) {
+		if (! available[_selected[i]]) return(false);
+	}
+	return(true);
+}
@@ -0,0 +1,159 @@
+//-- BrickLOD.h --------------------------------------------------------------
+//
+// View dependent selection of the refinement level of the bricks of a
+// volume, for out-of-core rendering of multiresolution data. No OpenGL
+// calls are made.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _BrickLOD_h_
+#define _BrickLOD_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class BrickLOD
+//! \brief Chooses the refinement level of each part of a volume
+//!
+//! At refinement level \a L the grid is divided into bricks of \a brickDim
+//! voxel intervals along each axis, aligned with the grid origin, so that
+//! the eight bricks at level \a L + 1 covering a brick at level \a L form
+//! its children in an octree. Bricks are clipped to the region rendered.
+//! Since they are aligned with the grid rather than with the region, a
+//! brick keeps its voxel box, and may be reused, when the region changes.
+//!
+//! Select() refines the octree, starting with the coarsest level at
+//! which the region fits in a brick, and splitting first the bricks whose
+//! voxels project to the most pixels, until every voxel projects to at
+//! most \a maxError pixels, the finest level is reached, or the number of
+//! bricks would exceed a budget. Bricks outside the view frustum are
+//! dropped. The bricks selected are returned coarsest first, which is
+//! the order in which they should be fetched.
+//!
+//! Resolve() then finds the bricks to draw given the ones whose data is
+//! at hand: a brick that isn't available is replaced, together with its
+//! siblings, by its nearest available ancestor, so that the bricks drawn
+//! never overlap.
+//
+class RENDER_API BrickLOD : public VetsUtil::MyBase {
+public:
+
+ //
+ // A brick of the octree
+ //
+ typedef struct {
+	int reflevel;		// refinement level
+	size_t min[3];		// voxel box, at the brick's refinement level
+	size_t max[3];
+	double extents[6];	// user extents of the part of the region covered
+	float error;		// pixels a voxel projects to, at most
+ } brick_t;
+
+ BrickLOD();
+ virtual ~BrickLOD() {}
+
+ //! Set the region rendered
+ //!
+ //! \param[in] dims Grid dimensions at refinement level \p maxRefLevel
+ //! \param[in] min Minimum voxel of the region, at \p maxRefLevel
+ //! \param[in] max Maximum voxel of the region, at \p maxRefLevel
+ //! \param[in] extents User extents of the region
+ //! \param[in] maxRefLevel Finest refinement level that may be selected
+ //! \param[in] brickDim Voxel intervals along each axis of a brick
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int SetRegion(
+	const size_t dims[3], const size_t min[3], const size_t max[3],
+	const double extents[6], int maxRefLevel, int brickDim
+ );
+
+ //! Select the bricks to render from a view
+ //!
+ //! \param[in] modelview Modelview matrix, mapping user coordinates to
+ //! eye coordinates, in OpenGL (column major) order
+ //! \param[in] projection Projection matrix
+ //! \param[in] viewport Viewport, as returned by glGetIntegerv()
+ //! \param[in] maxError Pixels a voxel may project to before its brick
+ //! is refined
+ //! \param[in] maxBricks Maximum number of bricks selected
+ //!
+ //! \sa GetSelected()
+ //
+ void Select(
+	const double modelview[16], const double projection[16],
+	const int viewport[4], float maxError, size_t maxBricks
+ );
+
+ //! Return the bricks selected by the last call to Select(), as indices
+ //! of nodes of the octree, coarsest first and, within a level, largest
+ //! error first
+ //
+ const std::vector <int> &GetSelected() const { return(_selected); }
+
+ //! Return the number of nodes of the octree refined by the last call to
+ //! Select(). Nodes are numbered from zero.
+ //
+ int GetNumNodes() const { return((int) _nodes.size()); }
+
+ //! Return a node of the octree
+ //
+ const brick_t &GetNode(int node) const { return(_nodes[node].brick); }
+
+ //! Find the bricks to draw
+ //!
+ //! \param[in] available Flag, for every node of the octree, telling
+ //! whether the node's data is available
+ //! \param[out] drawable Nodes to draw
+ //!
+ //! \retval complete True if every brick selected is drawn
+ //
+ bool Resolve(
+	const std::vector <bool> &available, std::vector <int> &drawable
+ ) const;
+
+ int GetMaxRefLevel() const { return(_maxRefLevel); }
+
+ int GetBrickDim() const { return(_brickDim); }
+
+private:
+ typedef struct {
+	brick_t brick;
+	size_t tile[3];		// brick index, at its refinement level
+	int parent;
+	int firstChild;		// children are consecutive, if refined
+	int nchildren;
+ } node_t;
+
+ size_t _dims[3];
+ size_t _min[3];
+ size_t _max[3];
+ double _extents[6];
+ int _maxRefLevel;
+ int _rootLevel;
+ int _brickDim;
+
+ std::vector <node_t> _nodes;
+ std::vector <int> _selected;
+
+ //
+ // View of the last selection
+ //
+ double _mvp[16];	// projection * modelview
+ int _viewport[4];
+
+ bool _makeNode(int reflevel, const size_t tile[3], int parent, node_t &node)
+	const;
+ bool _project(brick_t &brick) const;
+ bool _resolve(
+	int node, const std::vector <bool> &available, std::vector <int> &out
+ ) const;
+};
+
+};
+
+#endif	// _BrickLOD_h_
@@ -314,8 +314,8 @@ void DVRRayCaster::drawVolumeFaces(
 void DVRRayCaster::render_backface(
 	const TextureBrick *brick
 ) {
-	const BBox &volumeBox  = brick->volumeBox();
-	const BBox &textureBox = brick->textureBox();
+	const BBox volumeBox  = brickVolumeBox(brick);
+	const BBox textureBox = brickTextureBox(brick);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
 
@@ -373,8 +373,8 @@ void DVRRayCaster::raycasting_pass(
 								   const Matrix3d &modelviewInverse
 								   ) {
 
-	const BBox &volumeBox  = brick->volumeBox();
-	const BBox &textureBox = brick->textureBox();
+	const BBox volumeBox  = brickVolumeBox(brick);
+	const BBox textureBox = brickTextureBox(brick);
 
 	if (GLEW_VERSION_2_0) {
 		
@@ -574,6 +574,12 @@ void DVRRayCaster::SetIsoValues(
 		_colors[i*4+3] = colors[i*4+3];
 	}
 
+	//
+	// Rays need only be cast through the macrocells containing an
+	// isovalue
+	//
+	_macroCells.ClassifyIso(_values, _nisos);
+	updateOccupancy();
 }
 
 
@@ -77,6 +77,11 @@ private:
 
   virtual void drawVolumeFaces(const BBox &box, const BBox &tbox);
 
+  // The macrocells are classified against the isovalues, not the
+  // opacity map
+  //
+  virtual void classifyMacroCells(const float atab[256][4]) {}
+
   virtual void render_backface(const TextureBrick *brick);
 
   virtual void raycasting_pass(
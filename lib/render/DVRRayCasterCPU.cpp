@@ -0,0 +1,767 @@
+//--DVRRayCasterCPU.cpp ------------------------------------------------------
+//
+// Volume rendering engine that ray casts RegularGrid data on the CPU
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cmath>
+#include <typeinfo>
+#include "BrickFiller.h"
+#include "DVRRayCasterCPU.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Macrocell size, in voxels, and image tile size, in pixels
+//
+#define MACROCELL 8
+#define TILE 16
+
+namespace {
+
+	//
+	// Invert a column major 4x4 matrix. Returns false if it's singular.
+	//
+	bool invert4(const double m[16], double inv[16]) {
+		double a[4][8];
+		for (int r=0; r<4; r++) {
+			for (int c=0; c<4; c++) {
+				a[r][c] = m[c*4 + r];
+				a[r][c+4] = r == c ? 1.0 : 0.0;
+			}
+		}
+		for (int c=0; c<4; c++) {
+			int pivot = c;
+			for (int r=c+1; r<4; r++) {
+				if (fabs(a[r][c]) > fabs(a[pivot][c])) pivot = r;
+			}
+			if (a[pivot][c] == 0.0) return(false);
+			if (pivot != c) {
+				for (int i=0; i<8; i++) {
+					double tmp = a[c][i];
+					a[c][i] = a[pivot][i];
+					a[pivot][i] = tmp;
+				}
+			}
+			double s = 1.0 / a[c][c];
+			for (int i=0; i<8; i++) a[c][i] *= s;
+			for (int r=0; r<4; r++) {
+				if (r == c || a[r][c] == 0.0) continue;
+				double f = a[r][c];
+				for (int i=0; i<8; i++) a[r][i] -= f * a[c][i];
+			}
+		}
+		for (int r=0; r<4; r++) {
+			for (int c=0; c<4; c++) inv[c*4 + r] = a[r][c+4];
+		}
+		return(true);
+	}
+
+	void transform4(const double m[16], const double v[4], double r[4]) {
+		for (int i=0; i<4; i++) {
+			r[i] = m[i]*v[0] + m[4+i]*v[1] + m[8+i]*v[2] + m[12+i]*v[3];
+		}
+	}
+};
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunDVRRayCasterCPUThread(void *object) {
+		DVRRayCasterCPU::ThreadObj *X = (DVRRayCasterCPU::ThreadObj *) object;
+		X->RenderThread();
+		return(0);
+	}
+};
+
+//----------------------------------------------------------------------------
+// Constructor
+//----------------------------------------------------------------------------
+DVRRayCasterCPU::DVRRayCasterCPU(int nthreads) :
+  _et(nthreads), _macroCells(MACROCELL, nthreads)
+{
+  _nthreads = _et.GetNumThreads();
+  if (_nthreads < 1) _nthreads = 1;
+
+  for (int i=0; i<3; i++) {
+    _dims[i] = 0;
+  }
+  for (int i=0; i<6; i++) _extents[i] = 0.0;
+
+  for (int i=0; i<256; i++) {
+    for (int c=0; c<4; c++) _atab[i][c] = 0.0;
+  }
+  _numRefinements = 0;
+  _correct = false;
+  _tablesDirty = true;
+  _stepDone = 0.0;
+  _preintegration = false;
+
+  _lighting = false;
+  _kd = _ka = _ks = _expS = 0.0;
+  _lpos[0] = 0.0;
+  _lpos[1] = 0.0;
+  _lpos[2] = 1.0;
+
+  _renderFast = false;
+  _maxOpacity = 0.99;
+  _skipping = true;
+
+  _width = 0;
+  _height = 0;
+  for (int i=0; i<16; i++) {
+    _modelview[i] = _invMVP[i] = (i % 5 == 0) ? 1.0 : 0.0;
+  }
+  for (int i=0; i<9; i++) _normal[i] = (i % 4 == 0) ? 1.0 : 0.0;
+
+  _step = 0.5;
+}
+
+//----------------------------------------------------------------------------
+// Quantize the volume to 16 bits and compute the macrocells
+//----------------------------------------------------------------------------
+int DVRRayCasterCPU::SetRegion(
+	const RegularGrid *rg, const float range[2], int num
+) {
+  if (num != 0) {
+    SetErrMsg("Only one variable may be rendered");
+    return(-1);
+  }
+  if (typeid(*rg) != typeid(RegularGrid)) {
+    SetErrMsg("Grid type not supported by the CPU ray caster");
+    return(-1);
+  }
+
+  size_t dims[3];
+  rg->GetDimensions(dims);
+  double extents[6];
+  rg->GetUserExtents(extents);
+  for (int i=0; i<3; i++) {
+    if (dims[i] < 2 || ! (extents[i] < extents[i+3])) {
+      SetErrMsg("Invalid volume dimensions");
+      return(-1);
+    }
+  }
+
+  bool missing = rg->HasMissingData();
+  int ncomp = missing ? 2 : 1;
+  size_t nvoxels = dims[0] * dims[1] * dims[2];
+
+  BrickFiller filler(_nthreads);
+  filler.SetFormat(2, ncomp, missing);
+  std::vector <unsigned char> texels(nvoxels * 2 * ncomp);
+  int rc = filler.Fill(
+    rg, range, &texels[0], dims[0], dims[1], dims[2],
+    dims[0], dims[1], dims[2]
+  );
+  if (rc < 0) return(-1);
+
+  for (int i=0; i<3; i++) _dims[i] = dims[i];
+  for (int i=0; i<6; i++) _extents[i] = extents[i];
+
+  _volume.resize(nvoxels);
+  _missing.clear();
+  if (missing) _missing.resize(nvoxels);
+
+  const unsigned char *tptr = &texels[0];
+  for (size_t v=0; v<nvoxels; v++, tptr += 2*ncomp) {
+    _volume[v] = (unsigned short) (tptr[0] | (tptr[1] << 8));
+    if (missing) _missing[v] = tptr[2];
+  }
+
+  if (_macroCells.Build(rg, range) < 0) {
+    _volume.clear();
+    return(-1);
+  }
+  _tablesDirty = true;
+  return(0);
+}
+
+//----------------------------------------------------------------------------
+// Color table used to render the volume without any opacity correction.
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::SetCLUT(const float ctab[256][4])
+{
+  for (int i=0; i<256; i++) {
+    for (int c=0; c<4; c++) _atab[i][c] = ctab[i][c];
+  }
+  _correct = false;
+  _tablesDirty = true;
+}
+
+//----------------------------------------------------------------------------
+// Color table used to render the volume applying an opacity correction.
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::SetOLUT(const float atab[256][4], const int numRefinements)
+{
+  for (int i=0; i<256; i++) {
+    for (int c=0; c<4; c++) _atab[i][c] = atab[i][c];
+  }
+  _numRefinements = numRefinements;
+  _correct = true;
+  _tablesDirty = true;
+}
+
+void DVRRayCasterCPU::SetPreIntegrationTable(
+	const float atab[256][4], const int numRefinements
+) {
+  SetOLUT(atab, numRefinements);
+}
+
+void DVRRayCasterCPU::SetPreintegrationOnOff(int on)
+{
+  if ((bool) on != _preintegration) _tablesDirty = true;
+  _preintegration = on;
+}
+
+void DVRRayCasterCPU::SetLightingOnOff(int on)
+{
+  _lighting = on;
+}
+
+void DVRRayCasterCPU::SetLightingCoeff(float kd, float ka, float ks, float expS)
+{
+  _kd = kd;
+  _ka = ka;
+  _ks = ks;
+  _expS = expS;
+}
+
+void DVRRayCasterCPU::SetLightingLocation(const float *pos)
+{
+  _lpos[0] = pos[0];
+  _lpos[1] = pos[1];
+  _lpos[2] = pos[2];
+}
+
+void DVRRayCasterCPU::Resize(int width, int height)
+{
+  _width = width > 0 ? width : 0;
+  _height = height > 0 ? height : 0;
+}
+
+int DVRRayCasterCPU::SetMatrices(
+	const double modelview[16], const double projection[16]
+) {
+  double mvp[16];
+  for (int c=0; c<4; c++) {
+    for (int r=0; r<4; r++) {
+      double sum = 0.0;
+      for (int i=0; i<4; i++) sum += projection[i*4 + r] * modelview[c*4 + i];
+      mvp[c*4 + r] = sum;
+    }
+  }
+
+  double inv[16];
+  if (! invert4(mvp, inv)) {
+    SetErrMsg("Singular viewing transformation");
+    return(-1);
+  }
+
+  //
+  // Gradients transform by the inverse transpose of the modelview matrix
+  //
+  double mv[16], mvinv[16];
+  for (int i=0; i<16; i++) mv[i] = modelview[i];
+  mv[12] = mv[13] = mv[14] = 0.0;
+  mv[3] = mv[7] = mv[11] = 0.0;
+  mv[15] = 1.0;
+  if (! invert4(mv, mvinv)) {
+    SetErrMsg("Singular viewing transformation");
+    return(-1);
+  }
+
+  for (int i=0; i<16; i++) {
+    _modelview[i] = modelview[i];
+    _invMVP[i] = inv[i];
+  }
+  for (int r=0; r<3; r++) {
+    for (int c=0; c<3; c++) _normal[r*3 + c] = mvinv[r*4 + c];
+  }
+  return(0);
+}
+
+//----------------------------------------------------------------------------
+// Build the opacity corrected (and pre-integrated) lookup tables for the
+// current sampling distance
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::_buildTables()
+{
+  //
+  // The tables are defined for a sampling distance of half a voxel at the
+  // finest refinement level
+  //
+  double delta = _correct ? 2.0 * _step * (double) (1<<_numRefinements) : 1.0;
+
+  float opac[256];
+  for (int i=0; i<256; i++) {
+    double a = _atab[i][3];
+    if (_correct) a = 1.0 - pow((1.0 - a), delta);
+    opac[i] = a > 1.0 ? 1.0 : a;
+  }
+
+  if (! _preintegration) {
+    _cmap.resize(256*4);
+    for (int i=0; i<256; i++) {
+      _cmap[i*4+0] = _atab[i][0];
+      _cmap[i*4+1] = _atab[i][1];
+      _cmap[i*4+2] = _atab[i][2];
+      _cmap[i*4+3] = opac[i];
+    }
+    return;
+  }
+
+  //
+  // Pre-integrated table, computed as DVRShader does
+  //
+  double ifunc[256][4];
+  for (int c=0; c<4; c++) ifunc[0][c] = 0.0;
+
+  for (int i=1; i<256; i++)
+  {
+    double a = 255.0*(opac[i-1]+opac[i])/2.0;
+
+    ifunc[i][0] = ifunc[i-1][0] + (_atab[i-1][0]+_atab[i][0])/2.0*255;
+    ifunc[i][1] = ifunc[i-1][1] + (_atab[i-1][1]+_atab[i][1])/2.0*255;
+    ifunc[i][2] = ifunc[i-1][2] + (_atab[i-1][2]+_atab[i][2])/2.0*255;
+    ifunc[i][3] = ifunc[i-1][3] + a;
+  }
+
+  _cmap.resize(256*256*4);
+  for (int sb=0; sb<256; sb++)
+  {
+    for (int sf=0; sf<256; sf++)
+    {
+      int smin = sb < sf ? sb : sf;
+      int smax = sb < sf ? sf : sb;
+      double r, g, b, a;
+
+      if (smin != smax)
+      {
+        double factor = 1.0 / (double)(smax - smin);
+
+        r = factor * (ifunc[smax][0] - ifunc[smin][0]);
+        g = factor * (ifunc[smax][1] - ifunc[smin][1]);
+        b = factor * (ifunc[smax][2] - ifunc[smin][2]);
+        a = 256.0 *
+          (1.0 - exp(-(ifunc[smax][3] - ifunc[smin][3]) * factor / 255.0));
+      }
+      else
+      {
+        r = 255.0 * _atab[smin][0];
+        g = 255.0 * _atab[smin][1];
+        b = 255.0 * _atab[smin][2];
+        a = 256 * (1.0 - exp(-opac[smin]));
+      }
+
+      double rgba[4] = {r/255.0, g/255.0, b/255.0, a/255.0};
+      int index = (sf + sb*256) * 4;
+      for (int c=0; c<4; c++) {
+        _cmap[index + c] = rgba[c] < 0.0 ? 0.0 : (rgba[c] > 1.0 ? 1.0 : rgba[c]);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Render the volume into the image
+//----------------------------------------------------------------------------
+int DVRRayCasterCPU::Render()
+{
+  if (! _volume.size()) {
+    SetErrMsg("No volume to render");
+    return(-1);
+  }
+
+  float step = _renderFast ? 1.0 : 0.5;
+  if (_tablesDirty || step != _stepDone) {
+    _step = step;
+    _buildTables();
+    _macroCells.Classify(_atab);
+    _tablesDirty = false;
+    _stepDone = step;
+  }
+
+  _image.assign((size_t) _width * (size_t) _height * 4, 0);
+  if (! _image.size()) return(0);
+
+  std::vector <ThreadObj *> objs;
+  for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+  int rc = 0;
+  if (_nthreads <= 1) {
+    objs[0]->RenderThread();
+  }
+  else {
+    rc = _et.ParRun(RunDVRRayCasterCPUThread, (void **) &objs[0]);
+    if (rc < 0) SetErrMsg("Error spawning threads");
+  }
+  for (int t=0; t<_nthreads; t++) delete objs[t];
+
+  return(rc < 0 ? -1 : 0);
+}
+
+void DVRRayCasterCPU::ThreadObj::RenderThread()
+{
+  int ntx = (_rc->_width + TILE - 1) / TILE;
+  int nty = (_rc->_height + TILE - 1) / TILE;
+
+  for (int tile = _id; tile < ntx*nty; tile += _rc->_nthreads) {
+    _rc->_renderTile(tile);
+  }
+}
+
+void DVRRayCasterCPU::_renderTile(int tile)
+{
+  int ntx = (_width + TILE - 1) / TILE;
+  int x0 = (tile % ntx) * TILE;
+  int y0 = (tile / ntx) * TILE;
+
+  for (int py = y0; py < y0 + TILE && py < _height; py += 2) {
+    for (int px = x0; px < x0 + TILE && px < _width; px += 2) {
+      _tracePacket(px, py);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Compute a ray, in voxel coordinates, through the center of a pixel.
+// The ray is o + t*d, where t is 0 on the near plane and 1 on the far
+// plane, and t0 and t1 bound the part of the ray inside the volume.
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::_setupRay(
+	int px, int py, double o[3], double d[3], double *t0, double *t1
+) const {
+
+  double ndc[2] = {
+    ((double) px + 0.5) / (double) _width * 2.0 - 1.0,
+    ((double) py + 0.5) / (double) _height * 2.0 - 1.0
+  };
+
+  double clipn[4] = {ndc[0], ndc[1], -1.0, 1.0};
+  double clipf[4] = {ndc[0], ndc[1], 1.0, 1.0};
+  double n[4], f[4];
+  transform4(_invMVP, clipn, n);
+  transform4(_invMVP, clipf, f);
+
+  *t0 = 0.0;
+  *t1 = 1.0;
+  for (int i=0; i<3; i++) {
+    double scale = (double) (_dims[i]-1) / (_extents[i+3] - _extents[i]);
+    o[i] = (n[i]/n[3] - _extents[i]) * scale;
+    d[i] = (f[i]/f[3] - _extents[i]) * scale - o[i];
+
+    double lo = 0.0;
+    double hi = (double) (_dims[i]-1);
+    if (d[i] == 0.0) {
+      if (o[i] < lo || o[i] > hi) *t1 = -1.0;
+      continue;
+    }
+    double ta = (lo - o[i]) / d[i];
+    double tb = (hi - o[i]) / d[i];
+    if (ta > tb) {
+      double tmp = ta;
+      ta = tb;
+      tb = tmp;
+    }
+    if (ta > *t0) *t0 = ta;
+    if (tb < *t1) *t1 = tb;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Trace a packet of 2x2 rays
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::_tracePacket(int px, int py)
+{
+  const int N = 4;
+  double o[N][3], d[N][3], t0[N], t1[N], dt[N];
+  long k[N];
+  float color[N][4];
+  float prev[N];
+  bool prevValid[N], prevEmpty[N], active[N];
+
+  int nactive = 0;
+  for (int l=0; l<N; l++) {
+    int x = px + (l & 1);
+    int y = py + (l >> 1);
+    for (int c=0; c<4; c++) color[l][c] = 0.0;
+    active[l] = false;
+    if (x >= _width || y >= _height) continue;
+
+    _setupRay(x, y, o[l], d[l], &t0[l], &t1[l]);
+    double len = sqrt(d[l][0]*d[l][0] + d[l][1]*d[l][1] + d[l][2]*d[l][2]);
+    if (! (t0[l] <= t1[l]) || len == 0.0) continue;
+
+    dt[l] = _step / len;
+    k[l] = 0;
+    prev[l] = 0.0;
+    prevValid[l] = false;
+    prevEmpty[l] = false;
+    active[l] = true;
+    nactive++;
+  }
+
+  //
+  // March the rays in lock step, a sample (or a skipped macrocell) at
+  // a time
+  //
+  while (nactive) {
+    for (int l=0; l<N; l++) {
+      if (! active[l]) continue;
+
+      double t = t0[l] + k[l]*dt[l];
+      double p[3] = {
+        o[l][0] + t*d[l][0], o[l][1] + t*d[l][1], o[l][2] + t*d[l][2]
+      };
+
+      bool empty = _skipping && _cellEmpty(p);
+      if (empty && (! _preintegration || prevEmpty[l])) {
+
+        //
+        // Skip to the first sample past the macrocell
+        //
+        double te = t + _cellExit(p, d[l]);
+        long knext = (long) ceil((te - t0[l]) / dt[l]);
+        k[l] = knext > k[l] ? knext : k[l] + 1;
+        if (t0[l] + k[l]*dt[l] > t1[l]) {
+          active[l] = false;
+          nactive--;
+          continue;
+        }
+
+        //
+        // The sample before it, which pre-integration pairs it with
+        //
+        if (_preintegration) {
+          double tp = t0[l] + (k[l]-1)*dt[l];
+          double pp[3] = {
+            o[l][0] + tp*d[l][0], o[l][1] + tp*d[l][1], o[l][2] + tp*d[l][2]
+          };
+          prevValid[l] = _sample(pp, &prev[l]);
+        }
+        continue;
+      }
+
+      float s;
+      bool valid = _sample(p, &s);
+      if (k[l] == 0) {
+        prev[l] = s;
+        prevValid[l] = valid;
+      }
+
+      if (valid && (prevValid[l] || ! _preintegration)) {
+        float rgba[4];
+        _classify(prev[l], s, p, rgba);
+
+        float w = (1.0 - color[l][3]) * rgba[3];
+        color[l][0] += w * rgba[0];
+        color[l][1] += w * rgba[1];
+        color[l][2] += w * rgba[2];
+        color[l][3] += w;
+      }
+      prev[l] = s;
+      prevValid[l] = valid;
+      prevEmpty[l] = empty;
+
+      k[l]++;
+      if (t0[l] + k[l]*dt[l] > t1[l] || color[l][3] >= _maxOpacity) {
+        active[l] = false;
+        nactive--;
+      }
+    }
+  }
+
+  for (int l=0; l<N; l++) {
+    int x = px + (l & 1);
+    int y = py + (l >> 1);
+    if (x >= _width || y >= _height) continue;
+
+    unsigned char *pixel = &_image[((size_t) y * _width + x) * 4];
+    for (int c=0; c<4; c++) {
+      float v = color[l][c];
+      v = v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+      pixel[c] = (unsigned char) (v * 255.0 + 0.5);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Trilinearly interpolate the volume at a point, in voxel coordinates.
+// The value is normalized to [0,1]. Returns false if any of the voxels
+// interpolated is missing.
+//----------------------------------------------------------------------------
+bool DVRRayCasterCPU::_sample(const double p[3], float *s) const
+{
+  size_t ijk[3];
+  float w[3];
+  for (int a=0; a<3; a++) {
+    double x = p[a];
+    double xmax = (double) (_dims[a] - 1);
+    x = x > 0.0 ? x : 0.0;
+    x = x < xmax ? x : xmax;
+    ijk[a] = (size_t) x;
+    if (ijk[a] > _dims[a] - 2) ijk[a] = _dims[a] - 2;
+    w[a] = x - (double) ijk[a];
+  }
+
+  size_t sx = 1;
+  size_t sy = _dims[0];
+  size_t sz = _dims[0] * _dims[1];
+  size_t v = (ijk[2]*_dims[1] + ijk[1])*_dims[0] + ijk[0];
+
+  if (_missing.size()) {
+    const unsigned char *m = &_missing[v];
+    if (m[0] | m[sx] | m[sy] | m[sy+sx] |
+      m[sz] | m[sz+sx] | m[sz+sy] | m[sz+sy+sx]) return(false);
+  }
+
+  const unsigned short *q = &_volume[v];
+  float c00 = q[0] + w[0] * ((float) q[sx] - q[0]);
+  float c10 = q[sy] + w[0] * ((float) q[sy+sx] - q[sy]);
+  float c01 = q[sz] + w[0] * ((float) q[sz+sx] - q[sz]);
+  float c11 = q[sz+sy] + w[0] * ((float) q[sz+sy+sx] - q[sz+sy]);
+  float c0 = c00 + w[1] * (c10 - c00);
+  float c1 = c01 + w[1] * (c11 - c01);
+  *s = (c0 + w[2] * (c1 - c0)) * (1.0f / 65535.0f);
+  return(true);
+}
+
+bool DVRRayCasterCPU::_cellEmpty(const double p[3]) const
+{
+  size_t cdims[3], c[3];
+  _macroCells.GetDimensions(cdims);
+  for (int a=0; a<3; a++) {
+    c[a] = p[a] > 0.0 ? (size_t) p[a] / MACROCELL : 0;
+    if (c[a] > cdims[a] - 1) c[a] = cdims[a] - 1;
+  }
+  return(_macroCells.IsEmpty(c[0], c[1], c[2]));
+}
+
+//----------------------------------------------------------------------------
+// Return the increment of t that takes the ray from p to the boundary
+// of p's macrocell
+//----------------------------------------------------------------------------
+double DVRRayCasterCPU::_cellExit(const double p[3], const double d[3]) const
+{
+  size_t cdims[3];
+  _macroCells.GetDimensions(cdims);
+
+  double texit = -1.0;
+  for (int a=0; a<3; a++) {
+    if (d[a] == 0.0) continue;
+
+    size_t c = p[a] > 0.0 ? (size_t) p[a] / MACROCELL : 0;
+    if (c > cdims[a] - 1) c = cdims[a] - 1;
+
+    double boundary = d[a] > 0.0 ? (double) ((c+1) * MACROCELL) :
+      (double) (c * MACROCELL);
+    double t = (boundary - p[a]) / d[a];
+    if (t < 0.0) t = 0.0;
+    if (texit < 0.0 || t < texit) texit = t;
+  }
+  return(texit < 0.0 ? 0.0 : texit);
+}
+
+//----------------------------------------------------------------------------
+// Look up the color and opacity of a sample, pre-integrated over the
+// segment from the previous sample if enabled, and shade it
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::_classify(
+	float sf, float sb, const double p[3], float rgba[4]
+) const {
+  if (_preintegration) {
+    int f = (int) (sf * 255.0f + 0.5f);
+    int b = (int) (sb * 255.0f + 0.5f);
+    const float *e = &_cmap[(f + b*256) * 4];
+    for (int c=0; c<4; c++) rgba[c] = e[c];
+  }
+  else {
+
+    // Linear interpolation between the entries, as a 1D texture lookup
+    //
+    float x = sb * 256.0f - 0.5f;
+    x = x > 0.0f ? x : 0.0f;
+    x = x < 255.0f ? x : 255.0f;
+    int i0 = (int) x;
+    int i1 = i0 < 255 ? i0 + 1 : 255;
+    float w = x - (float) i0;
+    const float *e0 = &_cmap[i0*4];
+    const float *e1 = &_cmap[i1*4];
+    for (int c=0; c<4; c++) rgba[c] = e0[c] + w * (e1[c] - e0[c]);
+  }
+
+  if (_lighting && rgba[3] > 0.0) _shade(p, rgba);
+}
+
+//----------------------------------------------------------------------------
+// Shade a sample with the lighting model of the DVR shader
+//----------------------------------------------------------------------------
+void DVRRayCasterCPU::_shade(const double p[3], float rgba[4]) const
+{
+  //
+  // Central difference gradient, in user coordinates
+  //
+  double g[3];
+  for (int a=0; a<3; a++) {
+    double p0[3] = {p[0], p[1], p[2]};
+    double p1[3] = {p[0], p[1], p[2]};
+    p0[a] = p[a] - 1.0 > 0.0 ? p[a] - 1.0 : 0.0;
+    p1[a] = p[a] + 1.0 < _dims[a]-1 ? p[a] + 1.0 : _dims[a]-1;
+    float s0 = 0.0, s1 = 0.0;
+    (void) _sample(p0, &s0);
+    (void) _sample(p1, &s1);
+    g[a] = p1[a] > p0[a] ? (s1 - s0) / (p1[a] - p0[a]) : 0.0;
+    g[a] *= (double) (_dims[a]-1) / (_extents[a+3] - _extents[a]);
+  }
+
+  double n[3];
+  for (int r=0; r<3; r++) {
+    n[r] = _normal[0*3+r]*g[0] + _normal[1*3+r]*g[1] + _normal[2*3+r]*g[2];
+  }
+  double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+  double diffuse = 0.0;
+  double specular = 0.0;
+  if (len > 0.0) {
+    for (int i=0; i<3; i++) n[i] /= len;
+
+    double l[3] = {_lpos[0], _lpos[1], _lpos[2]};
+    double llen = sqrt(l[0]*l[0] + l[1]*l[1] + l[2]*l[2]);
+    if (llen > 0.0) for (int i=0; i<3; i++) l[i] /= llen;
+
+    double ndotl = n[0]*l[0] + n[1]*l[1] + n[2]*l[2];
+    diffuse = fabs(ndotl);
+
+    if (diffuse > 0.0) {
+
+      // Eye coordinates of the sample, and the view vector
+      //
+      double u[4] = {0.0, 0.0, 0.0, 1.0};
+      for (int a=0; a<3; a++) {
+        u[a] = _extents[a] +
+          p[a] / (double) (_dims[a]-1) * (_extents[a+3] - _extents[a]);
+      }
+      double ec[4];
+      transform4(_modelview, u, ec);
+      double v[3] = {-ec[0], -ec[1], -ec[2]};
+      double vlen = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+      if (vlen > 0.0) for (int i=0; i<3; i++) v[i] /= vlen;
+
+      double h[3];	// reflect(-l, n)
+      for (int i=0; i<3; i++) h[i] = -l[i] + 2.0 * ndotl * n[i];
+      specular = pow(fabs(h[0]*v[0] + h[1]*v[1] + h[2]*v[2]), (double) _expS);
+    }
+  }
+
+  for (int c=0; c<3; c++) {
+    double v = rgba[c] * (_ka + _kd*diffuse) + _ks*specular;
+    rgba[c] = v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+  }
+}
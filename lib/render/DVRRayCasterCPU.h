@@ -0,0 +1,193 @@
+//--DVRRayCasterCPU.h --------------------------------------------------------
+//
+// Volume rendering engine that ray casts RegularGrid data on the CPU.
+// No OpenGL calls are made: the volume is rendered into an image buffer.
+//
+//----------------------------------------------------------------------------
+
+#ifndef DVRRayCasterCPU_h
+#define DVRRayCasterCPU_h
+
+#include <vector>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include "DVRBase.h"
+#include "MacroCellGrid.h"
+
+namespace VAPoR {
+
+//
+//! \class DVRRayCasterCPU
+//! \brief A volume rendering driver that needs no GPU
+//!
+//! Rays are cast from the center of each pixel of a \a width by \a height
+//! image through a regular grid, sampling the volume twice per voxel (once
+//! per voxel in fast mode) with trilinear interpolation. Samples are
+//! classified with the color and opacity tables, optionally
+//! pre-integrated and shaded, and composited front to back, as the
+//! OpenGL drivers do. Samples interpolated from missing values are
+//! discarded.
+//!
+//! The image is divided into tiles that are spread over threads, and
+//! each tile is traced in packets of 2x2 rays. A ray is terminated when
+//! its opacity reaches a threshold, and skips the 8x8x8 voxel
+//! macrocells of a MacroCellGrid whose minimum and maximum values map to
+//! fully transparent transfer function entries.
+//!
+//! The viewing transformation is specified with OpenGL style modelview
+//! and projection matrices, applied to the user coordinates of the grid.
+//! The image is returned as premultiplied RGBA bytes, bottom row first.
+//
+class RENDER_API DVRRayCasterCPU : public DVRBase
+{
+ public:
+
+  //! \param[in] nthreads Number of execution threads. If less than
+  //! one the number of available processors is used.
+  //
+  DVRRayCasterCPU(int nthreads = 0);
+  virtual ~DVRRayCasterCPU() {}
+
+  virtual int GraphicsInit() { return(0); }
+
+  //! Set the volume to render
+  //!
+  //! Only grids of class RegularGrid, with at least two grid points along
+  //! each axis, and a single variable (\p num == 0) are supported.
+  //
+  virtual int SetRegion(const RegularGrid *rg, const float range[2], int num=0);
+
+  //! Render the volume into the image
+  //!
+  //! \retval status A negative int is returned on failure
+  //
+  virtual int Render();
+
+  virtual int HasPreintegration() const { return true; };
+  virtual int HasLighting() const { return true; };
+
+  virtual void SetCLUT(const float ctab[256][4]);
+  virtual void SetOLUT(const float ftab[256][4], const int numRefinements);
+
+  virtual void SetPreintegrationOnOff(int on);
+  virtual void SetPreIntegrationTable(const float tab[256][4], const int nR);
+
+  virtual void SetLightingOnOff(int on);
+  virtual void SetLightingCoeff(float kd, float ka, float ks, float expS);
+  virtual void SetLightingLocation(const float *pos);
+
+  virtual bool GetRenderFast() const { return _renderFast; }
+  virtual void SetRenderFast(bool fast) { _renderFast = fast; }
+
+  //! Set the image size
+  //
+  virtual void Resize(int width, int height);
+
+  //! Set the viewing transformation
+  //!
+  //! \param[in] modelview Column major modelview matrix, mapping the user
+  //! coordinates of the grid to eye coordinates
+  //! \param[in] projection Column major projection matrix, mapping eye
+  //! coordinates to clip coordinates
+  //!
+  //! \retval status A negative int is returned if the matrices can not be
+  //! inverted
+  //
+  int SetMatrices(const double modelview[16], const double projection[16]);
+
+  //! Set the opacity at which rays are terminated. A value greater
+  //! than one disables early ray termination.
+  //
+  void SetTerminationOpacity(float opacity) { _maxOpacity = opacity; }
+
+  //! Enable or disable empty space skipping
+  //
+  void SetSkipping(bool enable) { _skipping = enable; }
+
+  //! Return the image rendered by the last call to Render(): GetWidth() x
+  //! GetHeight() premultiplied RGBA pixels, bottom row first
+  //
+  const unsigned char *GetImage() const {
+	return(_image.size() ? &_image[0] : NULL);
+  }
+  int GetWidth() const { return(_width); }
+  int GetHeight() const { return(_height); }
+
+  int GetNumThreads() const { return(_nthreads); }
+
+  class ThreadObj {
+  public:
+	ThreadObj(DVRRayCasterCPU *rc, int id) : _rc(rc), _id(id) {}
+	void RenderThread();
+  private:
+	DVRRayCasterCPU *_rc;
+	int _id;	// thread id
+  };
+
+ private:
+  VetsUtil::EasyThreads _et;
+  int _nthreads;
+
+  //
+  // Volume, quantized to 16 bits, and the missing value flags
+  //
+  size_t _dims[3];
+  double _extents[6];
+  std::vector <unsigned short> _volume;
+  std::vector <unsigned char> _missing;	// empty if no missing values
+
+  //
+  // Macrocells, classified against the current tables
+  //
+  MacroCellGrid _macroCells;
+
+  //
+  // Transfer function
+  //
+  float _atab[256][4];			// tables as given
+  int _numRefinements;
+  bool _correct;				// opacity correct _atab?
+  bool _tablesDirty;
+  float _stepDone;				// step the tables were built for
+  std::vector <float> _cmap;	// 256 RGBA entries, or 256x256 if
+								// preintegrating
+  bool _preintegration;
+
+  bool _lighting;
+  float _kd, _ka, _ks, _expS;
+  float _lpos[3];
+
+  bool _renderFast;
+  float _maxOpacity;
+  bool _skipping;
+
+  //
+  // View
+  //
+  int _width;
+  int _height;
+  double _modelview[16];
+  double _invMVP[16];		// clip to user coordinates
+  double _normal[9];		// gradient to eye coordinates
+  std::vector <unsigned char> _image;
+
+  float _step;				// sampling distance, in voxels
+
+  void _buildTables();
+  void _renderTile(int tile);
+  void _tracePacket(int px, int py);
+  void _setupRay(
+	int px, int py, double o[3], double d[3], double *t0, double *t1
+  ) const;
+  bool _sample(const double p[3], float *s) const;
+  bool _cellEmpty(const double p[3]) const;
+  double _cellExit(const double p[3], const double d[3]) const;
+  void _classify(
+	float sf, float sb, const double p[3], float rgba[4]
+  ) const;
+  void _shade(const double p[3], float rgba[4]) const;
+};
+
+};
+
+#endif
@@ -190,6 +190,26 @@ int DVRShader::SetRegion(const RegularGrid *rg, const float range[2], int num)
 	return DVRTexture3d::SetRegion(rg, range, num);
 }
 
+//----------------------------------------------------------------------------
+// The bricks of a region rendered out of core hold a single variable, on a
+// regular grid, without missing data
+//----------------------------------------------------------------------------
+int DVRShader::SetRegionLOD(
+	Source *source, const size_t dims[3],
+	const size_t min[3], const size_t max[3], const double extents[6],
+	int maxRefLevel, const float range[2]
+) {
+	MyBase::SetDiagMsg("SetRegionLOD()");
+
+	_midx = 0;
+	_zidx = 0;
+	_stretched = false;
+
+	return DVRTexture3d::SetRegionLOD(
+		source, dims, min, max, extents, maxRefLevel, range
+	);
+}
+
 //
 // Generate a lookup table to peform an inverse mapping from user coordinates
 // to texture coordinates
@@ -500,6 +520,11 @@ void DVRShader::SetCLUT(const float ctab[256][4])
 //----------------------------------------------------------------------------
 void DVRShader::SetOLUT(const float atab[256][4], const int numRefinements)
 {
+  //
+  // Find the space the new opacity map makes transparent
+  //
+  classifyMacroCells(atab);
+
   //
   // Compute the sampling distance and rate
   //
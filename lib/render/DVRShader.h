@@ -36,6 +36,12 @@ class RENDER_API DVRShader : public DVRTexture3d
   
   virtual int SetRegion(const RegularGrid *rg, const float range[2], int num=0);
 
+  virtual int SetRegionLOD(
+    Source *source, const size_t dims[3],
+    const size_t min[3], const size_t max[3], const double extents[6],
+    int maxRefLevel, const float range[2]
+  );
+
   virtual void loadTexture(TextureBrick *brick);
 
   virtual int Render();
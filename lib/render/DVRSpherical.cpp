@@ -210,8 +210,13 @@ int DVRSpherical::SetRegionSpherical(
     //
     for (int i=0; i<_bricks.size(); i++)
     {
+      //
+      // Bricks whose data haven't changed needn't be reloaded
+      //
       _bricks[i]->refill(rg, range, num);
-      if (num == _nvars - 1) loadTexture(_bricks[i]);
+      if (num == _nvars - 1 && _bricks[i]->dirty()) {
+        loadTexture(_bricks[i]);
+      }
     }
   }
 
@@ -13,6 +13,8 @@
 #include <qgl.h>
 #include <qgl.h>
 #include <cctype>
+#include <typeinfo>
+#include <vapor/CFuncs.h>
 #include "params.h"
 #include "DVRTexture3d.h"
 #include "TextureBrick.h"
@@ -30,11 +32,22 @@
 #endif
 
 using namespace VAPoR;
+using namespace VetsUtil;
 
 //
 // Static member data initalization
 //
 
+namespace {
+  //
+  // Releases the bricks evicted from the brick cache
+  //
+  void releaseBrick(void *brick)
+  {
+    delete (TextureBrick *) brick;
+  }
+};
+
 
 //----------------------------------------------------------------------------
 // Constructor
@@ -55,7 +68,15 @@ DVRTexture3d::DVRTexture3d(
   _maxBrickDim(128), // NOTE: This should always be <= _maxTexture
   _lastRegion(),
   _precision(precision),
-  _nvars(nvars)
+  _nvars(nvars),
+  _macroCells(8, nthreads),
+  _tightBricks(false),
+  _lodMode(false),
+  _source(NULL),
+  _brickCache(256*1024*1024, releaseBrick),
+  _fetchTime(0.1),
+  _refining(false),
+  _frame(0)
 {
 	MyBase::SetDiagMsg(
 		"DVRTexture3d::DVRTexture3d( %d %d %d)", 
@@ -77,6 +98,10 @@ DVRTexture3d::~DVRTexture3d()
   }
 
   _bricks.clear();
+  _occupancy.clear();
+
+  _lodBricks.clear();
+  _brickCache.Clear();
 }
 
 //----------------------------------------------------------------------------
@@ -89,6 +114,13 @@ int DVRTexture3d::SetRegion(
   size_t dims[3];
   rg->GetDimensions(dims);
 
+  if (_lodMode)
+  {
+    _lodMode = false;
+    _source = NULL;
+    ClearBrickCache();
+  }
+
   _dmin.x = 0;
   _dmin.y = 0;
   _dmin.z = 0;
@@ -124,6 +156,7 @@ int DVRTexture3d::SetRegion(
     }
     
     _bricks.clear();
+    _occupancy.clear();
     
     if (_nx <= _maxTexture && _ny <= _maxTexture && _nz <= _maxTexture)
     {
@@ -151,6 +184,11 @@ int DVRTexture3d::SetRegion(
       float deltatz = 1.0 / (float) bz;
       _bricks[0]->textureMin(deltatx/2.0, deltaty/2.0, deltatz/2.0);
       _bricks[0]->textureMax(1.0-(deltatx*0.5), 1.0-(deltaty*0.5), 1.0-(deltatz*0.5));
+
+      size_t bmin[3] = {0, 0, 0};
+      size_t bmax[3] = {dims[0]-1, dims[1]-1, dims[2]-1};
+      setBrickRegion(_bricks[0], bmin, bmax);
+
       _bricks[0]->fill(rg, range, num);
       
       if (num == _nvars - 1) loadTexture(_bricks[0]);
@@ -173,14 +211,305 @@ int DVRTexture3d::SetRegion(
     //
     for (int i=0; i<_bricks.size(); i++)
     {
+      //
+      // Bricks whose data haven't changed needn't be reloaded
+      //
       _bricks[i]->refill(rg, range, num);
-      if (num == _nvars - 1) loadTexture(_bricks[i]);
+      if (num == _nvars - 1 && _bricks[i]->dirty()) {
+        loadTexture(_bricks[i]);
+      }
     }
   }
 
+  //
+  // Compute the macrocells of the first variable, which the transfer
+  // function or isovalues apply to
+  //
+  if (num == 0)
+  {
+    _tightBricks = typeid(*rg) == typeid(RegularGrid);
+    if (_macroCells.Build(rg, range) < 0) return(-1);
+
+    size_t cdims[3];
+    _macroCells.GetDimensions(cdims);
+    MyBase::SetDiagMsg(
+      "DVRTexture3d::SetRegion() - %dx%dx%d macrocells (%d not empty) built in %f s",
+      (int) cdims[0], (int) cdims[1], (int) cdims[2],
+      (int) _macroCells.GetNumOccupied(), _macroCells.GetBuildTime()
+    );
+    updateOccupancy();
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// Render a region out of core, fetching its bricks from a source as the
+// view requires them.
+//----------------------------------------------------------------------------
+int DVRTexture3d::SetRegionLOD(
+  Source *source, const size_t dims[3],
+  const size_t min[3], const size_t max[3], const double extents[6],
+  int maxRefLevel, const float range[2]
+) {
+  //
+  // Bricks have a voxel more than their extent along each axis, and
+  // another as their data box may straddle that of their parent
+  //
+  int brickDim = _maxBrickDim;
+  if (_maxTexture > 0 && _maxTexture < brickDim) brickDim = _maxTexture;
+  brickDim -= 2;
+
+  if (_lod.SetRegion(dims, min, max, extents, maxRefLevel, brickDim) < 0)
+  {
+    return -1;
+  }
+
+  //
+  // Release the bricks of the region last rendered in core
+  //
+  for (int i=0; i<_bricks.size(); i++)
+  {
+    delete _bricks[i];
+    _bricks[i] = NULL;
+  }
+  _bricks.clear();
+  _occupancy.clear();
+  _macroCells.Clear();
+  _tightBricks = false;
+  _lastRegion = RegionState();
+
+  if (! _lodMode || _lodRange[0] != range[0] || _lodRange[1] != range[1])
+  {
+    ClearBrickCache();
+  }
+  _lodRange[0] = range[0];
+  _lodRange[1] = range[1];
+  _source = source;
+  _lodMode = true;
+  _refining = true;
+
+  _nx = max[0] - min[0] + 1;
+  _ny = max[1] - min[1] + 1;
+  _nz = max[2] - min[2] + 1;
+
+  _dmin.x = 0;
+  _dmin.y = 0;
+  _dmin.z = 0;
+  _dmax.x = _nx-1;
+  _dmax.y = _ny-1;
+  _dmax.z = _nz-1;
+
+  _vmin.x = extents[0];
+  _vmin.y = extents[1];
+  _vmin.z = extents[2];
+  _vmax.x = extents[3];
+  _vmax.y = extents[4];
+  _vmax.z = extents[5];
+
+  MyBase::SetDiagMsg(
+    "DVRTexture3d::SetRegionLOD() - %dx%dx%d region, level %d, %d^3 bricks",
+    _nx, _ny, _nz, maxRefLevel, brickDim
+  );
   return 0;
 }
 
+void DVRTexture3d::ClearBrickCache()
+{
+  _lodBricks.clear();
+  _brickCache.Clear();
+  _failedBricks.clear();
+}
+
+//----------------------------------------------------------------------------
+// Select the bricks to draw from the current view. Missing bricks are
+// fetched coarsest first, and those that can't be fetched in time, or
+// are waiting to be fetched again after failing, are stood in for by
+// their nearest cached ancestor.
+//----------------------------------------------------------------------------
+void DVRTexture3d::selectBricks()
+{
+  _frame++;
+
+  GLdouble modelview[16], projection[16];
+  GLint viewport[4];
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+  glGetDoublev(GL_PROJECTION_MATRIX, projection);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  //
+  // Select no more bricks than the cache holds
+  //
+  size_t nvoxels = _lod.GetBrickDim() + 2;
+  nvoxels = nvoxels * nvoxels * nvoxels;
+  size_t nbytes = 2 * nvoxels * (_precision > 8 ? 2 : 1) * _nvars;
+  size_t maxBricks = _brickCache.GetMaxBytes() / nbytes;
+  maxBricks = maxBricks > 16 ? maxBricks - 8 : 8;
+
+  float maxError = _renderFast ? 4.0 : 1.0;
+  _lod.Select(modelview, projection, viewport, maxError, maxBricks);
+
+  //
+  // The coarsest bricks are always fetched, so that the whole region is
+  // drawn. The others are fetched while time remains.
+  //
+  double t0 = GetTime();
+  int nfetched = 0;
+  int nnodes = _lod.GetNumNodes();
+  int rootLevel = nnodes ? _lod.GetNode(0).reflevel : 0;
+
+  for (int n=0; n<nnodes; n++)
+  {
+    const BrickLOD::brick_t &b = _lod.GetNode(n);
+    if (b.reflevel != rootLevel) break;
+    if (_brickCache.Contains(b.reflevel, b.min, b.max)) continue;
+    if (brickWaiting(b)) continue;
+    fetchBrick(b);
+    nfetched++;
+  }
+
+  const vector<int> &selected = _lod.GetSelected();
+  for (int i=0; i<selected.size(); i++)
+  {
+    const BrickLOD::brick_t &b = _lod.GetNode(selected[i]);
+    if (_brickCache.Contains(b.reflevel, b.min, b.max)) continue;
+    if (brickWaiting(b)) continue;
+    if (_fetchTime >= 0.0 && GetTime() - t0 > _fetchTime) break;
+    fetchBrick(b);
+    nfetched++;
+  }
+
+  vector<bool> available(nnodes);
+  for (int n=0; n<nnodes; n++)
+  {
+    const BrickLOD::brick_t &b = _lod.GetNode(n);
+    available[n] = _brickCache.Contains(b.reflevel, b.min, b.max);
+  }
+
+  vector<int> drawable;
+  (void) _lod.Resolve(available, drawable);
+
+  //
+  // Draw again while selected bricks remain to be fetched, but not just
+  // to retry failed ones
+  //
+  _refining = false;
+  for (int i=0; i<selected.size(); i++)
+  {
+    const BrickLOD::brick_t &b = _lod.GetNode(selected[i]);
+    if (! available[selected[i]] && ! brickWaiting(b)) _refining = true;
+  }
+
+  _lodBricks.clear();
+  for (int i=0; i<drawable.size(); i++)
+  {
+    const BrickLOD::brick_t &b = _lod.GetNode(drawable[i]);
+    TextureBrick *brick = (TextureBrick *) _brickCache.Get(
+      b.reflevel, b.min, b.max
+    );
+    if (brick) _lodBricks.push_back(brick);
+  }
+
+  MyBase::SetDiagMsg(
+    "DVRTexture3d::selectBricks() - %d bricks selected, %d fetched in %f s, %d drawn",
+    (int) selected.size(), nfetched, GetTime() - t0, (int) _lodBricks.size()
+  );
+}
+
+//----------------------------------------------------------------------------
+// Key of a brick in _failedBricks
+//----------------------------------------------------------------------------
+static vector<size_t> brickKey(const BrickLOD::brick_t &b)
+{
+  vector<size_t> key(1, (size_t) b.reflevel);
+  key.insert(key.end(), b.min, b.min+3);
+  key.insert(key.end(), b.max, b.max+3);
+  return key;
+}
+
+//----------------------------------------------------------------------------
+// True if a brick failed to be fetched, and isn't to be fetched again yet
+//----------------------------------------------------------------------------
+bool DVRTexture3d::brickWaiting(const BrickLOD::brick_t &b) const
+{
+  if (_failedBricks.empty()) return false;
+
+  std::map <vector<size_t>, failure_t>::const_iterator itr;
+  itr = _failedBricks.find(brickKey(b));
+  return itr != _failedBricks.end() && itr->second.retryFrame > _frame;
+}
+
+//----------------------------------------------------------------------------
+// Read a brick from the source and load it into a texture. A brick that
+// can't be read, e.g. because the data cache is full for now, isn't
+// cached. It is fetched again after 1, 2, 4, ... up to 64 frames.
+//----------------------------------------------------------------------------
+TextureBrick *DVRTexture3d::fetchBrick(const BrickLOD::brick_t &b)
+{
+  RegularGrid *rg = _source ? _source->GetGrid(b.reflevel, b.min, b.max) : NULL;
+  if (! rg)
+  {
+    vector<size_t> key = brickKey(b);
+    std::map <vector<size_t>, failure_t>::iterator itr;
+    itr = _failedBricks.find(key);
+
+    failure_t f;
+    f.backoff = 1;
+    if (itr != _failedBricks.end() && itr->second.backoff < 64)
+    {
+      f.backoff = 2 * itr->second.backoff;
+    }
+    else if (itr != _failedBricks.end()) f.backoff = 64;
+    f.retryFrame = _frame + f.backoff;
+    _failedBricks[key] = f;
+    return NULL;
+  }
+  if (! _failedBricks.empty()) _failedBricks.erase(brickKey(b));
+
+  size_t dims[3];
+  rg->GetDimensions(dims);
+  double extents[6];
+  rg->GetUserExtents(extents);
+
+  TextureBrick *brick = new TextureBrick(rg, _precision, _nvars);
+  brick->dataMin(extents[0], extents[1], extents[2]);
+  brick->dataMax(extents[3], extents[4], extents[5]);
+
+  //
+  // The brick renders the part of the region it was selected for, which
+  // the grid's box may slightly overhang, so that neighboring bricks of
+  // different levels don't overlap. Texel centers lie at (i+0.5) / n.
+  //
+  double vmin[3], vmax[3], tmin[3], tmax[3];
+  for (int i=0; i<3; i++)
+  {
+    vmin[i] = MAX(b.extents[i], extents[i]);
+    vmax[i] = MIN(b.extents[i+3], extents[i+3]);
+
+    double d = extents[i+3] - extents[i];
+    double n = dims[i];
+    tmin[i] = d > 0.0 ? (0.5 + (vmin[i]-extents[i]) / d * (n-1)) / n : 0.5;
+    tmax[i] = d > 0.0 ? (0.5 + (vmax[i]-extents[i]) / d * (n-1)) / n : 0.5;
+  }
+  brick->volumeMin(vmin[0], vmin[1], vmin[2]);
+  brick->volumeMax(vmax[0], vmax[1], vmax[2]);
+  brick->textureMin(tmin[0], tmin[1], tmin[2]);
+  brick->textureMax(tmax[0], tmax[1], tmax[2]);
+
+  brick->fill(rg, _lodRange, 0);
+  loadTexture(brick);
+  _source->ReleaseGrid(rg);
+
+  //
+  // The brick's data are held both in host and in texture memory
+  //
+  size_t nbytes = 2 * brick->nx() * brick->ny() * brick->nz() *
+    brick->ncomp() * brick->szcomp();
+  _brickCache.Put(b.reflevel, b.min, b.max, brick, nbytes);
+
+  return brick;
+}
+
 //----------------------------------------------------------------------------
 // Render the bricks
 //----------------------------------------------------------------------------
@@ -196,21 +525,28 @@ void DVRTexture3d::renderBricks()
   Matrix3d modelviewInverse;
   modelview.inverse(modelviewInverse);
 
+  //
+  // Select the bricks rendered out of core
+  //
+  if (_lodMode) selectBricks();
+
+  vector<TextureBrick*> &bricks = _lodMode ? _lodBricks : _bricks;
+
   //
   // Sort the bricks into rendering order.
   //
-  sortBricks(modelview);
+  sortBricks(modelview, bricks);
 
   //
   // Render the bricks
   //
   vector<TextureBrick*>::iterator iter;
 
-  for (iter=_bricks.begin(); iter!=_bricks.end(); iter++)
+  for (iter=bricks.begin(); iter!=bricks.end(); iter++)
   {
     TextureBrick *brick = *iter;
 
-    if (brick->valid())
+    if (brick->valid() && ! brickEmpty(brick))
     {
       glBindTexture(GL_TEXTURE_3D, brick->handle());
       renderBrick(brick, modelview, modelviewInverse);
@@ -355,8 +691,8 @@ void DVRTexture3d::drawViewAlignedSlices(const TextureBrick *brick,
   //
   //  
   //
-  BBox volumeBox  = brick->volumeBox();
-  BBox textureBox = brick->textureBox();
+  BBox volumeBox  = brickVolumeBox(brick);
+  BBox textureBox = brickTextureBox(brick);
   BBox rotatedBox(volumeBox);
 
   //
@@ -391,6 +727,16 @@ void DVRTexture3d::drawViewAlignedSlices(const TextureBrick *brick,
                      volumeBox, verts, 
                      textureBox, tverts, 
                      rotatedBox, rverts);
+
+    //
+    // Slices missing the (possibly shrunk) box are skipped
+    //
+    if (size < 3)
+    {
+      slicePoint += sliceDelta;
+      continue;
+    }
+
     //
     // Calculate the convex hull of the vertices (eye coordinates)
     //
@@ -716,6 +1062,8 @@ void DVRTexture3d::buildBricks(
           float deltatz = 1.0 / (float) bz;
           brick->textureMin(deltatx*0.5, deltaty*0.5, deltatz*0.5);
           brick->textureMax(1.0-(deltatx*0.5), 1.0-(deltaty*0.5), 1.0-(deltatz*0.5));
+
+          setBrickRegion(brick, broi, broi+3);
         }
 
         //
@@ -761,33 +1109,35 @@ void DVRTexture3d::buildBricks(
 //----------------------------------------------------------------------------
 // Sort the bricks in back to front order.
 //----------------------------------------------------------------------------
-void DVRTexture3d::sortBricks(const Matrix3d &modelview)
+void DVRTexture3d::sortBricks(
+  const Matrix3d &modelview, vector<TextureBrick*> &bricks
+)
 {
-  if (_bricks.size() > 1)
+  if (bricks.size() > 1)
   {
     vector<double> sortvals;
     
-    for(int i=0; i<_bricks.size(); i++)
+    for(int i=0; i<bricks.size(); i++)
     {
-      Vect3d center = modelview * _bricks[i]->center();
+      Vect3d center = modelview * bricks[i]->center();
   
       sortvals.push_back(center.magSq());
     }
 
-    for(int i=0; i<_bricks.size(); i++)
+    for(int i=0; i<bricks.size(); i++)
     {
-      for(int j=i+1; j<_bricks.size(); ++j)
+      for(int j=i+1; j<bricks.size(); ++j)
       {
         if(sortvals[i] < sortvals[j])
         {
           double valtmp          = sortvals[i];
-          TextureBrick *bricktmp = _bricks[i];
+          TextureBrick *bricktmp = bricks[i];
           
           sortvals[i] = sortvals[j]; 
           sortvals[j] = valtmp;
           
-          _bricks[i] = _bricks[j]; 
-          _bricks[j] = bricktmp;
+          bricks[i] = bricks[j]; 
+          bricks[j] = bricktmp;
         }
       }
     }
@@ -795,6 +1145,128 @@ void DVRTexture3d::sortBricks(const Matrix3d &modelview)
 }
 
 
+//----------------------------------------------------------------------------
+// Record the grid points a brick renders: its volume box runs from the
+// user coordinates of min to those of max.
+//----------------------------------------------------------------------------
+void DVRTexture3d::setBrickRegion(
+  const TextureBrick *brick, const size_t min[3], const size_t max[3]
+) {
+  occupancy_t &o = _occupancy[brick];
+  for (int i=0; i<3; i++)
+  {
+    o.min[i] = min[i];
+    o.max[i] = max[i];
+  }
+  o.empty = false;
+  o.vmin = brick->volumeMin();
+  o.vmax = brick->volumeMax();
+  o.tmin = brick->textureMin();
+  o.tmax = brick->textureMax();
+}
+
+//----------------------------------------------------------------------------
+// Classify the macrocells against the opacity map
+//----------------------------------------------------------------------------
+void DVRTexture3d::classifyMacroCells(const float atab[256][4])
+{
+  _macroCells.Classify(atab);
+  updateOccupancy();
+}
+
+//----------------------------------------------------------------------------
+// Find the bricks that are empty with the current classification, and the
+// part of the others that isn't.
+//----------------------------------------------------------------------------
+void DVRTexture3d::updateOccupancy()
+{
+  size_t dims[3] = {(size_t) _nx, (size_t) _ny, (size_t) _nz};
+
+  std::map <const TextureBrick *, occupancy_t>::iterator itr;
+  for (itr = _occupancy.begin(); itr != _occupancy.end(); ++itr)
+  {
+    const TextureBrick *brick = itr->first;
+    occupancy_t &o = itr->second;
+
+    //
+    // The brick's texels extend one grid point past its volume box
+    // (the ghost zone of interior bricks)
+    //
+    size_t qmax[3];
+    for (int i=0; i<3; i++)
+    {
+      qmax[i] = o.max[i] + 1 < dims[i] ? o.max[i] + 1 : o.max[i];
+    }
+
+    size_t omin[3], omax[3];
+    o.empty = ! _macroCells.GetOccupiedBox(o.min, qmax, omin, omax);
+
+    Point3d vmin = brick->volumeMin();
+    Point3d vmax = brick->volumeMax();
+    Point3d tmin = brick->textureMin();
+    Point3d tmax = brick->textureMax();
+    o.vmin = vmin; o.vmax = vmax;
+    o.tmin = tmin; o.tmax = tmax;
+    if (o.empty || ! _tightBricks) continue;
+
+    //
+    // Shrink the boxes, keeping a margin of two grid points as the
+    // texels of interior bricks are slightly stretched over their
+    // volume box
+    //
+    float f0[3], f1[3];
+    for (int i=0; i<3; i++)
+    {
+      size_t lo = omin[i] > o.min[i] + 2 ? omin[i] - 2 : o.min[i];
+      size_t hi = omax[i] + 2 < o.max[i] ? omax[i] + 2 : o.max[i];
+      size_t n = o.max[i] - o.min[i];
+      f0[i] = n ? (float) (lo - o.min[i]) / (float) n : 0.0;
+      f1[i] = n ? (float) (hi - o.min[i]) / (float) n : 1.0;
+    }
+
+    o.vmin.x = vmin.x + f0[0] * (vmax.x - vmin.x);
+    o.vmin.y = vmin.y + f0[1] * (vmax.y - vmin.y);
+    o.vmin.z = vmin.z + f0[2] * (vmax.z - vmin.z);
+    o.vmax.x = vmin.x + f1[0] * (vmax.x - vmin.x);
+    o.vmax.y = vmin.y + f1[1] * (vmax.y - vmin.y);
+    o.vmax.z = vmin.z + f1[2] * (vmax.z - vmin.z);
+
+    o.tmin.x = tmin.x + f0[0] * (tmax.x - tmin.x);
+    o.tmin.y = tmin.y + f0[1] * (tmax.y - tmin.y);
+    o.tmin.z = tmin.z + f0[2] * (tmax.z - tmin.z);
+    o.tmax.x = tmin.x + f1[0] * (tmax.x - tmin.x);
+    o.tmax.y = tmin.y + f1[1] * (tmax.y - tmin.y);
+    o.tmax.z = tmin.z + f1[2] * (tmax.z - tmin.z);
+  }
+}
+
+bool DVRTexture3d::brickEmpty(const TextureBrick *brick) const
+{
+  std::map <const TextureBrick *, occupancy_t>::const_iterator itr;
+  itr = _occupancy.find(brick);
+  return(itr != _occupancy.end() && itr->second.empty);
+}
+
+//----------------------------------------------------------------------------
+// The part of a brick's volume and texture boxes that isn't empty, or the
+// whole boxes.
+//----------------------------------------------------------------------------
+BBox DVRTexture3d::brickVolumeBox(const TextureBrick *brick) const
+{
+  std::map <const TextureBrick *, occupancy_t>::const_iterator itr;
+  itr = _occupancy.find(brick);
+  if (itr == _occupancy.end()) return(brick->volumeBox());
+  return(BBox(itr->second.vmin, itr->second.vmax));
+}
+
+BBox DVRTexture3d::brickTextureBox(const TextureBrick *brick) const
+{
+  std::map <const TextureBrick *, occupancy_t>::const_iterator itr;
+  itr = _occupancy.find(brick);
+  if (itr == _occupancy.end()) return(brick->textureBox());
+  return(BBox(itr->second.tmin, itr->second.tmax));
+}
+
 void DVRTexture3d::SetMaxTexture(int texsize) {
 	_maxTexture = texsize;
 }
@@ -13,6 +13,9 @@
 
 #include <vapor/RegularGrid.h>
 #include "DVRBase.h"
+#include "MacroCellGrid.h"
+#include "BrickLOD.h"
+#include "BrickCache.h"
 #include "Vect3d.h"
 #include "Matrix3d.h"
 
@@ -65,7 +68,65 @@ class RENDER_API DVRTexture3d : public DVRBase
 
   virtual void loadTexture(TextureBrick *brick) = 0;
 
+  //
+  // Source of the bricks of a region rendered out of core
+  //
+  class Source {
+  public:
+    virtual ~Source() {}
+
+    //
+    // Return the grid of a voxel box at a refinement level, or NULL on
+    // failure. The grid is released by the caller with ReleaseGrid().
+    //
+    virtual RegularGrid *GetGrid(
+      int reflevel, const size_t min[3], const size_t max[3]
+    ) = 0;
+
+    //
+    // Release a grid returned by GetGrid()
+    //
+    virtual void ReleaseGrid(RegularGrid *rg) { delete rg; }
+  };
+
+  //
+  // Render a region out of core. Every frame the bricks are selected
+  // from the view, each at the coarsest refinement level, up to
+  // maxRefLevel, whose voxels project to about a pixel (or a few when
+  // rendering fast). The bricks missing are fetched from the source,
+  // coarsest first, for up to the fetch time, and kept in a bounded LRU
+  // cache. Until they arrive their coarser ancestors are drawn. dims is
+  // the grid dimensions at maxRefLevel, and min and max the region's
+  // voxel box at that level. Only a single variable without missing data
+  // can be rendered this way.
+  //
+  // The cache is cleared if the data range changes. The caller must
+  // clear it, with ClearBrickCache(), when the source's data change.
+  //
+  virtual int SetRegionLOD(
+    Source *source, const size_t dims[3],
+    const size_t min[3], const size_t max[3], const double extents[6],
+    int maxRefLevel, const float range[2]
+  );
+
+  void ClearBrickCache();
 
+  void SetBrickCacheSize(size_t nbytes) { _brickCache.SetMaxBytes(nbytes); }
+
+  //
+  // Time, in seconds, spent fetching bricks each frame. The coarsest
+  // bricks are always fetched. A negative time fetches every brick.
+  //
+  void SetBrickFetchTime(double seconds) { _fetchTime = seconds; }
+
+  //
+  // True if bricks selected by the last frame rendered out of core are
+  // still missing, in which case the volume should be drawn again.
+  // Bricks that couldn't be fetched don't count: they are retried on
+  // later frames, waiting a number of frames that doubles with each
+  // failure.
+  //
+  bool IsRefining() const { return _lodMode && _refining; }
 
 
   protected:
@@ -94,7 +155,29 @@ class RENDER_API DVRTexture3d : public DVRBase
   void findVertexOrder(const Vect3d verts[6], int order[6], int degree);
 
   void buildBricks(const RegularGrid *rg, const float range[2], int num);
-  void sortBricks(const Matrix3d &modelview);
+  void sortBricks(const Matrix3d &modelview, vector<TextureBrick*> &bricks);
+
+  //
+  // Out of core rendering: select the bricks to draw from the current
+  // view into _lodBricks, fetching the missing ones
+  //
+  void selectBricks();
+  TextureBrick *fetchBrick(const BrickLOD::brick_t &b);
+  bool brickWaiting(const BrickLOD::brick_t &b) const;
+
+  //
+  // Empty space skipping. Derived classes classify the macrocells, by
+  // default against the opacity map, and update the bricks' occupancy.
+  // Bricks whose macrocells are all empty aren't rendered, and the proxy
+  // geometry of the others is shrunk to the box enclosing their
+  // non-empty macrocells.
+  //
+  virtual void classifyMacroCells(const float atab[256][4]);
+  void updateOccupancy();
+
+  bool brickEmpty(const TextureBrick *brick) const;
+  BBox brickVolumeBox(const TextureBrick *brick) const;
+  BBox brickTextureBox(const TextureBrick *brick) const;
 
   virtual void SetMaxTexture(int texsize);
 
@@ -146,6 +229,56 @@ protected:
   // num vars stored in a texture
   int _nvars;
 
+  // Macrocells of the first variable
+  MacroCellGrid _macroCells;
+
+  //
+  // Voxel region of each brick, and the part of its volume and texture
+  // boxes that isn't empty
+  //
+  typedef struct {
+    size_t min[3];
+    size_t max[3];
+    bool empty;
+    Point3d vmin, vmax;
+    Point3d tmin, tmax;
+  } occupancy_t;
+
+  std::map <const TextureBrick *, occupancy_t> _occupancy;
+
+  // Shrink the proxy geometry? Only if voxels map linearly to user
+  // coordinates.
+  bool _tightBricks;
+
+  void setBrickRegion(
+    const TextureBrick *brick, const size_t min[3], const size_t max[3]
+  );
+
+  //
+  // Out of core rendering state. The cache owns the bricks in
+  // _lodBricks.
+  //
+  bool _lodMode;
+  Source *_source;
+  float _lodRange[2];
+  BrickLOD _lod;
+  BrickCache _brickCache;
+  double _fetchTime;
+  bool _refining;
+  vector<TextureBrick*> _lodBricks;
+
+  //
+  // Bricks that couldn't be fetched, keyed by refinement level and voxel
+  // box, and the frame from which they may be fetched again
+  //
+  typedef struct {
+    int retryFrame;
+    int backoff;	// frames waited after the last failure
+  } failure_t;
+
+  std::map <vector<size_t>, failure_t> _failedBricks;
+  int _frame;
+
   void SetMinimumSamples(int normal, int fast) {
 	_minimumSamples = normal;
 	_minimumSamplesFast = fast;
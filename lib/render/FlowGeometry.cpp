@@ -0,0 +1,781 @@
+//-- FlowGeometry.cpp --------------------------------------------------------
+//
+// Generation of flow tube and arrow geometry on the CPU
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cmath>
+#include <cfloat>
+#include "FlowGeometry.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Flow lines, or lattice rows, per block
+//
+#define BLOCK 64
+
+//
+// Fraction of an arrow's length taken by its shaft
+//
+#define ARROW_LENGTH_FACTOR 0.9f
+
+namespace {
+
+	//
+	// Cosines and sines at 60 degree intervals: tubes are really
+	// hexagonal, the shading makes them look round
+	//
+	const float Coses[6] = {1.f, 0.5f, -0.5f, -1.f, -0.5f, 0.5f};
+	const float Sines[6] = {
+		0.f, 0.8660254f, 0.8660254f, 0.f, -0.8660254f, -0.8660254f
+	};
+
+	inline float dot(const float a[3], const float b[3]) {
+		return(a[0]*b[0] + a[1]*b[1] + a[2]*b[2]);
+	}
+
+	inline void cross(const float a[3], const float b[3], float c[3]) {
+		c[0] = a[1]*b[2] - a[2]*b[1];
+		c[1] = a[2]*b[0] - a[0]*b[2];
+		c[2] = a[0]*b[1] - a[1]*b[0];
+	}
+
+	inline void copy(const float a[3], float b[3]) {
+		b[0] = a[0]; b[1] = a[1]; b[2] = a[2];
+	}
+
+	//
+	// Normalize a vector, returning false if it has zero length
+	//
+	inline bool normalize(float a[3]) {
+		float len = dot(a, a);
+		if (len == 0.f) return(false);
+		len = 1.f / sqrt(len);
+		a[0] *= len; a[1] *= len; a[2] *= len;
+		return(true);
+	}
+
+	//
+	// A unit vector orthogonal to the unit vector dir
+	//
+	inline void orthogonal(const float dir[3], float u[3]) {
+		const float xaxis[3] = {1.f, 0.f, 0.f};
+		const float yaxis[3] = {0.f, 1.f, 0.f};
+		cross(dir, xaxis, u);
+		if (dot(u, u) == 0.f) cross(dir, yaxis, u);
+		normalize(u);
+	}
+
+	inline void push3(std::vector <float> &v, const float a[3]) {
+		v.push_back(a[0]); v.push_back(a[1]); v.push_back(a[2]);
+	}
+
+	inline void push4(std::vector <float> &v, const float a[4]) {
+		v.push_back(a[0]); v.push_back(a[1]);
+		v.push_back(a[2]); v.push_back(a[3]);
+	}
+};
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunFlowGeometryThread(void *object) {
+		FlowGeometry::ThreadObj *X = (FlowGeometry::ThreadObj *) object;
+		X->RunThread();
+		return(0);
+	}
+};
+
+FlowGeometry::FlowGeometry(int nthreads) : _et(nthreads) {
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_radius = 1.0;
+	_headRadius = 3.0;
+	_headSetBack = 0.0;
+	_headTilt = false;
+	_stationaryRadius = 0.0;
+	for (int i=0; i<4; i++) _color[i] = 1.0;
+	for (int i=0; i<3; i++) {
+		_periodic[i] = false;
+		_periodicExtents[i] = _periodicExtents[i+3] = 0.0;
+	}
+
+	_phase = TUBES;
+	_nitems = 0;
+	_fld = NULL;
+	_firstAge = _lastAge = 0;
+	_constColors = true;
+	_advectionEnds = false;
+	for (int i=0; i<3; i++) {
+		_field[i] = NULL;
+		_grid[i] = 0;
+		_scales[i] = 1.0;
+	}
+	_height = NULL;
+	for (int i=0; i<6; i++) _extents[i] = _bounds[i] = 0.0;
+	_alignedXY = false;
+	_zBase = 0.0;
+	_vectorScale = 1.0;
+}
+
+void FlowGeometry::SetArrowHead(float radius, float setBack, bool tilt) {
+	_headRadius = radius;
+	_headSetBack = setBack;
+	_headTilt = tilt;
+}
+
+void FlowGeometry::SetColor(const float rgba[4]) {
+	for (int i=0; i<4; i++) _color[i] = rgba[i];
+}
+
+void FlowGeometry::SetPeriodic(const bool periodic[3], const float extents[6]) {
+	for (int i=0; i<3; i++) _periodic[i] = periodic[i];
+	for (int i=0; i<6; i++) _periodicExtents[i] = extents[i];
+}
+
+int FlowGeometry::BuildTubes(
+	FlowLineData *fld, int firstAge, int lastAge, bool constColors,
+	bool advectionEnds
+) {
+	_fld = fld;
+	_firstAge = firstAge;
+	_lastAge = lastAge;
+	_constColors = constColors || ! fld->getNumLines() ||
+		! fld->getFlowRGBAs(0, 0);
+	_advectionEnds = advectionEnds;
+
+	int rc = _run(TUBES, firstAge < lastAge ? fld->getNumLines() : 0);
+	_fld = NULL;
+	return(rc);
+}
+
+int FlowGeometry::BuildArrows(
+	FlowLineData *fld, int firstAge, int lastAge, bool constColors
+) {
+	_fld = fld;
+	_firstAge = firstAge;
+	_lastAge = lastAge;
+	_constColors = constColors || ! fld->getNumLines() ||
+		! fld->getFlowRGBAs(0, 0);
+	_advectionEnds = false;
+
+	int rc = _run(ARROWS, firstAge < lastAge ? fld->getNumLines() : 0);
+	_fld = NULL;
+	return(rc);
+}
+
+int FlowGeometry::BuildLattice(
+	const RegularGrid *field[3], const RegularGrid *height,
+	const double extents[6], const int grid[3], bool alignedXY,
+	double zBase, const float scales[3], float vectorScale
+) {
+	for (int i=0; i<3; i++) {
+		if (grid[i] < 0) {
+			SetErrMsg("Invalid lattice size : %dx%dx%d", grid[0],grid[1],grid[2]);
+			return(-1);
+		}
+		_field[i] = field[i];
+		_grid[i] = grid[i];
+		_scales[i] = scales[i];
+	}
+	for (int i=0; i<6; i++) _extents[i] = extents[i];
+	_height = height;
+	_alignedXY = alignedXY;
+	_zBase = zBase;
+	_vectorScale = vectorScale;
+
+	int rc = _run(LATTICE, grid[0] ? grid[1] * grid[2] : 0);
+	for (int i=0; i<3; i++) _field[i] = NULL;
+	_height = NULL;
+	return(rc);
+}
+
+void FlowGeometry::Clear() {
+	_verts.clear();
+	_norms.clear();
+	_colors.clear();
+	_indices.clear();
+	for (int i=0; i<6; i++) _bounds[i] = 0.0;
+}
+
+bool FlowGeometry::GetBounds(float bounds[6]) const {
+	for (int i=0; i<6; i++) bounds[i] = _bounds[i];
+	return(_verts.size() != 0);
+}
+
+int FlowGeometry::_run(phase_t phase, int nitems) {
+	Clear();
+
+	_phase = phase;
+	_nitems = nitems;
+	_blocks.clear();
+	_blocks.resize((nitems + BLOCK - 1) / BLOCK);
+	if (_blocks.empty()) return(0);
+
+	std::vector <ThreadObj *> objs;
+	for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+	int rc = 0;
+	if (_nthreads <= 1) {
+		objs[0]->RunThread();
+	}
+	else {
+		rc = _et.ParRun(RunFlowGeometryThread, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+	for (int t=0; t<_nthreads; t++) delete objs[t];
+
+	if (rc == 0) _join();
+	_blocks.clear();
+
+	return(rc < 0 ? -1 : 0);
+}
+
+void FlowGeometry::ThreadObj::RunThread() {
+	int nblocks = _fg->_blocks.size();
+	for (int b = _id; b < nblocks; b += _fg->_nthreads) {
+		_fg->_block(b);
+	}
+}
+
+void FlowGeometry::_block(int block) {
+	geom_t &g = _blocks[block];
+	int last = (block + 1) * BLOCK;
+	if (last > _nitems) last = _nitems;
+
+	//
+	// Vertices per flow line or lattice row, if every point is drawn
+	//
+	size_t nverts = 0;
+	switch (_phase) {
+	case TUBES: nverts = 6 * (_lastAge - _firstAge + 1) + 12; break;
+	case ARROWS: nverts = 25 * (_lastAge - _firstAge); break;
+	case LATTICE: nverts = 25 * _grid[0]; break;
+	}
+	nverts *= last - block * BLOCK;
+	g.verts.reserve(nverts * 3);
+	g.norms.reserve(nverts * 3);
+	g.colors.reserve(nverts * 4);
+	g.indices.reserve(nverts * 3);
+
+	for (int item = block * BLOCK; item < last; item++) {
+		switch (_phase) {
+		case TUBES: _tube(g, item); break;
+		case ARROWS: _flowArrows(g, item); break;
+		case LATTICE: _latticeRow(g, item); break;
+		}
+	}
+}
+
+//
+// Append the blocks, in order, offsetting their indices
+//
+void FlowGeometry::_join() {
+	size_t nverts = 0;
+	size_t nindices = 0;
+	for (int b=0; b<_blocks.size(); b++) {
+		nverts += _blocks[b].verts.size() / 3;
+		nindices += _blocks[b].indices.size();
+	}
+	_verts.reserve(nverts * 3);
+	_norms.reserve(nverts * 3);
+	_colors.reserve(nverts * 4);
+	_indices.reserve(nindices);
+
+	for (int b=0; b<_blocks.size(); b++) {
+		geom_t &g = _blocks[b];
+		unsigned int offset = _verts.size() / 3;
+
+		_verts.insert(_verts.end(), g.verts.begin(), g.verts.end());
+		_norms.insert(_norms.end(), g.norms.begin(), g.norms.end());
+		_colors.insert(_colors.end(), g.colors.begin(), g.colors.end());
+		for (size_t i=0; i<g.indices.size(); i++) {
+			_indices.push_back(g.indices[i] + offset);
+		}
+		g = geom_t();
+	}
+
+	for (int i=0; i<3; i++) {
+		_bounds[i] = FLT_MAX;
+		_bounds[i+3] = -FLT_MAX;
+	}
+	for (size_t v=0; v<nverts; v++) {
+		for (int i=0; i<3; i++) {
+			float x = _verts[v*3+i];
+			if (x < _bounds[i]) _bounds[i] = x;
+			if (x > _bounds[i+3]) _bounds[i+3] = x;
+		}
+	}
+	if (! nverts) {
+		for (int i=0; i<6; i++) _bounds[i] = 0.0;
+	}
+}
+
+const float *FlowGeometry::_lineColor(int line, int index) const {
+	return(_constColors ? _color : _fld->getFlowRGBAs(line, index));
+}
+
+//
+// Map a point into the periodic extents. The point is first shifted by
+// oldCycle periods; newCycle is set to the cycle the result falls in.
+// Returns true if the point left the cycle oldCycle.
+//
+bool FlowGeometry::_mapPeriodic(
+	const float orig[3], float mapped[3], const int oldCycle[3],
+	int newCycle[3]
+) const {
+	bool changed = false;
+	for (int i=0; i<3; i++) {
+		mapped[i] = orig[i];
+		newCycle[i] = oldCycle[i];
+		if (! _periodic[i]) continue;
+
+		float period = _periodicExtents[i+3] - _periodicExtents[i];
+		mapped[i] -= (float) oldCycle[i] * period;
+		float x = mapped[i];
+		while (x < _periodicExtents[i]) {
+			x += period;
+			newCycle[i]--;
+			changed = true;
+		}
+		while (x > _periodicExtents[i+3]) {
+			x -= period;
+			newCycle[i]++;
+			changed = true;
+		}
+	}
+	return(changed);
+}
+
+//
+// Add six vertices around center, in the plane spanned by u and b. The
+// normals point outward, leaning halfway toward tiltDir if given. Returns
+// the index of the first vertex.
+//
+unsigned int FlowGeometry::_ring(
+	geom_t &g, const float center[3], const float u[3], const float b[3],
+	float radius, const float color[4], const float *tiltDir
+) const {
+	unsigned int first = g.verts.size() / 3;
+	for (int k=0; k<6; k++) {
+		float n[3], v[3];
+		for (int i=0; i<3; i++) {
+			n[i] = u[i] * Coses[k] + b[i] * Sines[k];
+			v[i] = center[i] + n[i] * radius;
+			if (tiltDir) n[i] = 0.5f * n[i] + 0.5f * tiltDir[i];
+		}
+		push3(g.verts, v);
+		push3(g.norms, n);
+		push4(g.colors, color);
+	}
+	return(first);
+}
+
+//
+// Join two rings with a band of twelve triangles
+//
+void FlowGeometry::_joinRings(geom_t &g, unsigned int r0, unsigned int r1) const {
+	for (int k=0; k<6; k++) {
+		int l = (k + 1) % 6;
+		g.indices.push_back(r0 + k);
+		g.indices.push_back(r1 + k);
+		g.indices.push_back(r0 + l);
+
+		g.indices.push_back(r0 + l);
+		g.indices.push_back(r1 + k);
+		g.indices.push_back(r1 + l);
+	}
+}
+
+//
+// Close a ring with a flat hexagon of the ring's color
+//
+void FlowGeometry::_cap(
+	geom_t &g, unsigned int ring, const float normal[3]
+) const {
+	unsigned int first = g.verts.size() / 3;
+	for (int k=0; k<6; k++) {
+		float v[3], c[4];
+		copy(&g.verts[(ring + k) * 3], v);
+		for (int i=0; i<4; i++) c[i] = g.colors[(ring + k) * 4 + i];
+		push3(g.verts, v);
+		push3(g.norms, normal);
+		push4(g.colors, c);
+	}
+	for (int k=1; k<5; k++) {
+		g.indices.push_back(first);
+		g.indices.push_back(first + k);
+		g.indices.push_back(first + k + 1);
+	}
+}
+
+//
+// Add an arrow from start to end. The shaft ends short of the end point,
+// where the head begins, and the tip lies a shaft radius further.
+//
+void FlowGeometry::_arrow(
+	geom_t &g, const float start[3], const float end[3], const float dir[3],
+	const float u[3], const float b[3], const float color[4]
+) const {
+	float next[3], tip[3], head[3];
+	for (int i=0; i<3; i++) {
+		next[i] = (1.f - ARROW_LENGTH_FACTOR) * start[i] +
+			ARROW_LENGTH_FACTOR * end[i];
+		tip[i] = next[i] + dir[i] * _radius;
+		head[i] = next[i] - dir[i] * _headSetBack;
+	}
+
+	unsigned int r0 = _ring(g, start, u, b, _radius, color);
+	unsigned int r1 = _ring(g, next, u, b, _radius, color);
+	_joinRings(g, r0, r1);
+	_cap(g, r0, dir);
+
+	unsigned int apex = g.verts.size() / 3;
+	push3(g.verts, tip);
+	push3(g.norms, dir);
+	push4(g.colors, color);
+	unsigned int r2 = _ring(
+		g, head, u, b, _headRadius, color, _headTilt ? dir : NULL
+	);
+	for (int k=0; k<6; k++) {
+		g.indices.push_back(apex);
+		g.indices.push_back(r2 + k);
+		g.indices.push_back(r2 + (k + 1) % 6);
+	}
+}
+
+//
+// Add an octahedron marking a stationary point
+//
+void FlowGeometry::_stationary(geom_t &g, const float point[3]) const {
+	if (_stationaryRadius <= 0.f) return;
+
+	const float color[4] = {0.5f, 0.5f, 0.5f, 1.f};
+	const float r = _stationaryRadius;
+
+	//
+	// Corners: top, bottom, +x, +y, -x, -y. Each face is listed
+	// counterclockwise as seen from outside, with its normal.
+	//
+	const float offsets[6][3] = {
+		{0,0,r}, {0,0,-r}, {r,0,0}, {0,r,0}, {-r,0,0}, {0,-r,0}
+	};
+	const int faces[8][3] = {
+		{0,2,3}, {0,3,4}, {0,4,5}, {0,5,2},
+		{1,3,2}, {1,4,3}, {1,5,4}, {1,2,5}
+	};
+	const float normals[8][3] = {
+		{0.5f,0.5f,0.707f}, {-0.5f,0.5f,0.707f},
+		{-0.5f,-0.5f,0.707f}, {0.5f,-0.5f,0.707f},
+		{0.5f,0.5f,-0.707f}, {-0.5f,0.5f,-0.707f},
+		{-0.5f,-0.5f,-0.707f}, {0.5f,-0.5f,-0.707f}
+	};
+
+	for (int f=0; f<8; f++) {
+		for (int c=0; c<3; c++) {
+			float v[3];
+			for (int i=0; i<3; i++) v[i] = point[i] + offsets[faces[f][c]][i];
+			g.indices.push_back(g.verts.size() / 3);
+			push3(g.verts, v);
+			push3(g.norms, normals[f]);
+			push4(g.colors, color);
+		}
+	}
+}
+
+//
+// Find the first point of a flow line from which a tube or arrows can be
+// drawn, adding the stationary symbols found on the way. Returns -1 if
+// there is nothing more to draw.
+//
+int FlowGeometry::_lineStart(
+	geom_t &g, int line, int firstIndex, int lastIndex
+) const {
+	FlowLineData *fld = _fld;
+
+	if (*fld->getFlowPoint(line, firstIndex) == END_FLOW_FLAG) return(-1);
+
+	int start;
+	bool stationaryStart = false;
+	for (start = firstIndex; start < lastIndex; start++) {
+		const float *point = fld->getFlowPoint(line, start);
+		if (*point != STATIONARY_STREAM_FLAG) break;
+
+		//
+		// Consecutive stationary flags are an error: skip the line
+		//
+		if (stationaryStart) {
+			stationaryStart = false;
+			start = lastIndex;
+			break;
+		}
+		stationaryStart = true;
+	}
+	if (stationaryStart) _stationary(g, fld->getFlowPoint(line, start));
+	if (start == lastIndex) return(-1);
+
+	float next = *fld->getFlowPoint(line, start+1);
+	if (next == STATIONARY_STREAM_FLAG) {
+		_stationary(g, fld->getFlowPoint(line, start));
+		return(-1);
+	}
+	if (next == END_FLOW_FLAG) return(-1);
+	return(start);
+}
+
+//
+// Tube along a flow line. The rings are oriented with a frame that is
+// carried from point to point, each ring lying in the plane bisecting the
+// adjacent segments.
+//
+void FlowGeometry::_tube(geom_t &g, int line) const {
+	FlowLineData *fld = _fld;
+	int firstIndex = _firstAge > fld->getStartIndex(line) ?
+		_firstAge : fld->getStartIndex(line);
+	int lastIndex = _lastAge < fld->getEndIndex(line) ?
+		_lastAge : fld->getEndIndex(line);
+	if (firstIndex >= lastIndex) return;
+
+	int start = _lineStart(g, line, firstIndex, lastIndex);
+	if (start < 0) return;
+
+	float prevN[3], prevA[3], prevU[3];
+	float curN[3], curA[3], curU[3], curB[3];
+	float startA[3];
+
+	const float *p0 = fld->getFlowPoint(line, start);
+	const float *p1 = fld->getFlowPoint(line, start+1);
+	for (int i=0; i<3; i++) prevA[i] = p1[i] - p0[i];
+	if (! normalize(prevA)) {
+		prevA[0] = prevA[1] = 0.f;
+		prevA[2] = 1.f;
+	}
+	copy(prevA, prevN);
+	copy(prevA, startA);
+	copy(prevA, curA);
+	orthogonal(prevA, prevU);
+
+	float startPoint[3], endPoint[3];
+	int cycle[3] = {0,0,0};
+	int newCycle[3];
+	unsigned int firstRing = 0, prevRing = 0;
+
+	const float *point = p1;
+	for (int t = start+1; t <= lastIndex; t++) {
+		point = fld->getFlowPoint(line, t);
+		if (*point == END_FLOW_FLAG || *point == STATIONARY_STREAM_FLAG) break;
+		const float *color = _lineColor(line, t);
+
+		for (int i=0; i<3; i++) curN[i] = point[i] - point[i-3];
+		if (! normalize(curN)) copy(prevN, curN);
+
+		for (int i=0; i<3; i++) curA[i] = prevN[i] + curN[i];
+		if (! normalize(curA)) copy(prevA, curA);
+
+		//
+		// Project the previous U orthogonal to A
+		//
+		float d = dot(prevU, curA);
+		for (int i=0; i<3; i++) curU[i] = prevU[i] - curA[i] * d;
+		if (! normalize(curU)) {
+			copy(prevA, curU);
+			normalize(curU);
+		}
+		cross(curU, curA, curB);
+
+		bool wrapped;
+		if (t > start+1) {
+			wrapped = _mapPeriodic(point, endPoint, cycle, newCycle);
+		}
+		else {
+			//
+			// The first segment sets the cycle of the line
+			//
+			if (_mapPeriodic(point-3, startPoint, cycle, newCycle)) {
+				_mapPeriodic(point-3, startPoint, newCycle, cycle);
+			}
+			wrapped = _mapPeriodic(point, endPoint, cycle, newCycle);
+			firstRing = prevRing = _ring(
+				g, startPoint, curU, curB, _radius, color
+			);
+		}
+		unsigned int ring = _ring(g, endPoint, curU, curB, _radius, color);
+		_joinRings(g, prevRing, ring);
+		prevRing = ring;
+
+		//
+		// A tube leaving the periodic extents restarts at the translated
+		// end point
+		//
+		if (wrapped) {
+			_mapPeriodic(point, endPoint, newCycle, cycle);
+			prevRing = _ring(g, endPoint, curU, curB, _radius, color);
+		}
+
+		copy(curN, prevN);
+		copy(curA, prevA);
+		copy(curU, prevU);
+	}
+
+	_cap(g, firstRing, startA);
+	_cap(g, prevRing, curA);
+
+	if (*point == STATIONARY_STREAM_FLAG) _stationary(g, point-3);
+
+	//
+	// Field line advection marks the points following the line
+	//
+	if (_advectionEnds && start+1 < lastIndex) {
+		int maxPoints = fld->getMaxPoints();
+		if (lastIndex+1 >= maxPoints) return;
+		point = fld->getFlowPoint(line, lastIndex+1);
+		if (*point == END_FLOW_FLAG || *point == STATIONARY_STREAM_FLAG) return;
+		_stationary(g, point);
+
+		if (lastIndex+3 >= maxPoints) return;
+		if (*fld->getFlowPoint(line, lastIndex+2) != STATIONARY_STREAM_FLAG) {
+			return;
+		}
+		point = fld->getFlowPoint(line, lastIndex+3);
+		if (*point != END_FLOW_FLAG && *point != STATIONARY_STREAM_FLAG) {
+			_stationary(g, point);
+		}
+	}
+}
+
+//
+// Arrows along the segments of a flow line
+//
+void FlowGeometry::_flowArrows(geom_t &g, int line) const {
+	FlowLineData *fld = _fld;
+	int firstIndex = _firstAge > fld->getStartIndex(line) ?
+		_firstAge : fld->getStartIndex(line);
+	int lastIndex = _lastAge < fld->getEndIndex(line) ?
+		_lastAge : fld->getEndIndex(line);
+	if (firstIndex >= lastIndex) return;
+
+	int start = _lineStart(g, line, firstIndex, lastIndex);
+	if (start < 0) return;
+
+	float prevN[3], prevU[3];
+	float curN[3], curU[3], curB[3];
+
+	const float *p0 = fld->getFlowPoint(line, start);
+	const float *p1 = fld->getFlowPoint(line, start+1);
+	for (int i=0; i<3; i++) prevN[i] = p1[i] - p0[i];
+	float len = dot(prevN, prevN);
+	if (len == 0.f || len > 1.e36f) {
+		prevN[0] = prevN[1] = 0.f;
+		prevN[2] = 1.f;
+	}
+	else normalize(prevN);
+	orthogonal(prevN, prevU);
+
+	float startPoint[3], endPoint[3];
+	int cycle[3] = {0,0,0};
+	int newCycle[3];
+
+	for (int t = start+1; t <= lastIndex; t++) {
+		const float *point = fld->getFlowPoint(line, t);
+		if (*point == END_FLOW_FLAG || *point == STATIONARY_STREAM_FLAG) break;
+		const float *color = _lineColor(line, t);
+
+		for (int i=0; i<3; i++) curN[i] = point[i] - point[i-3];
+		if (! normalize(curN)) copy(prevN, curN);
+
+		float d = dot(prevU, curN);
+		for (int i=0; i<3; i++) curU[i] = prevU[i] - curN[i] * d;
+		if (! normalize(curU)) {
+			copy(prevN, curU);
+			normalize(curU);
+		}
+		cross(curU, curN, curB);
+
+		bool wrapped;
+		if (t > start+1) {
+			copy(endPoint, startPoint);
+			wrapped = _mapPeriodic(point, endPoint, cycle, newCycle);
+		}
+		else {
+			if (_mapPeriodic(point-3, startPoint, cycle, newCycle)) {
+				_mapPeriodic(point-3, startPoint, newCycle, cycle);
+			}
+			wrapped = _mapPeriodic(point, endPoint, cycle, newCycle);
+		}
+
+		float dist[3];
+		for (int i=0; i<3; i++) dist[i] = endPoint[i] - startPoint[i];
+		if (sqrt(dot(dist, dist)) > 1.e-10) {
+			_arrow(g, startPoint, endPoint, curN, curU, curB, color);
+		}
+
+		//
+		// An arrow leaving the periodic extents is repeated translated
+		// back inside them
+		//
+		if (wrapped) {
+			_mapPeriodic(point, endPoint, newCycle, cycle);
+			_mapPeriodic(point-3, startPoint, cycle, newCycle);
+			_arrow(g, startPoint, endPoint, curN, curU, curB, color);
+		}
+
+		copy(curN, prevN);
+		copy(curU, prevU);
+	}
+}
+
+//
+// Arrows of a row of the lattice, row j + k * grid[1]
+//
+void FlowGeometry::_latticeRow(geom_t &g, int row) const {
+	int j = row % _grid[1];
+	int k = row / _grid[1];
+	const double *e = _extents;
+
+	double zc = e[2] + (0.5 + k) * ((e[5] - e[2]) / _grid[2]);
+	double point[3];
+	point[1] = _alignedXY ?
+		e[1] + (double) j * ((e[4] - e[1]) / _grid[1]) :
+		e[1] + (0.5 + j) * ((e[4] - e[1]) / _grid[1]);
+
+	for (int i=0; i<_grid[0]; i++) {
+		point[0] = _alignedXY ?
+			e[0] + (double) i * ((e[3] - e[0]) / _grid[0]) :
+			e[0] + (0.5 + i) * ((e[3] - e[0]) / _grid[0]);
+
+		float offset = 0.f;
+		if (_height) {
+			offset = _height->GetValue(point[0], point[1], 0.);
+			if (offset == _height->GetMissingValue()) continue;
+			offset -= _zBase;
+		}
+		point[2] = zc + offset;
+
+		bool missing = false;
+		float start[3], end[3], dir[3];
+		for (int d=0; d<3; d++) {
+			float v = 0.f;
+			if (_field[d]) {
+				v = _field[d]->GetValue(point[0], point[1], point[2]);
+				if (v == _field[d]->GetMissingValue()) missing = true;
+			}
+			start[d] = (float) (point[d] * _scales[d]);
+			end[d] = _scales[d] * (point[d] + _vectorScale * v);
+			dir[d] = end[d] - start[d];
+		}
+		if (missing || ! normalize(dir)) continue;
+
+		float u[3], b[3];
+		orthogonal(dir, u);
+		cross(u, dir, b);
+		_arrow(g, start, end, dir, u, b, _color);
+	}
+}
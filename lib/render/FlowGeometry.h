@@ -0,0 +1,259 @@
+//-- FlowGeometry.h ----------------------------------------------------------
+//
+// Generation of the tube and arrow geometry of flow lines and of arrow
+// lattices, on the CPU. No OpenGL calls are made.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _FlowGeometry_h_
+#define _FlowGeometry_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/flowlinedata.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class FlowGeometry
+//! \brief Builds the triangles of flow tubes and arrows
+//!
+//! Tubes and arrows are hexagonal in cross section. The geometry is
+//! returned as packed arrays of vertices, normals and colors, and a list
+//! of triangles indexing them, so that it may be drawn with a single
+//! glDrawElements(GL_TRIANGLES, ...) call, and kept until the flow data or
+//! the parameters it depends on change.
+//!
+//! Flow lines, or rows of the arrow lattice, are split into blocks that
+//! are spread over threads. The blocks are joined in order, so that the
+//! geometry is the same whatever the number of threads.
+//!
+//! The points of flow lines flagged with END_FLOW_FLAG end a line, and
+//! those flagged with STATIONARY_STREAM_FLAG get a stationary symbol (an
+//! octahedron) as the FlowRenderer has always drawn them.
+//
+class RENDER_API FlowGeometry : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ FlowGeometry(int nthreads = 0);
+ virtual ~FlowGeometry() {}
+
+ //! Set the radius of tubes, and of the shafts of arrows
+ //
+ void SetRadius(float radius) { _radius = radius; }
+
+ //! Set the shape of arrow heads
+ //!
+ //! \param[in] radius Radius of the base of the head
+ //! \param[in] setBack Distance from the end of the shaft back to the
+ //! base of the head
+ //! \param[in] tilt If true the normals of the head lean toward the tip
+ //
+ void SetArrowHead(float radius, float setBack, bool tilt);
+
+ //! Set the radius of stationary symbols. No symbols are made if it
+ //! isn't positive.
+ //
+ void SetStationaryRadius(float radius) { _stationaryRadius = radius; }
+
+ //! Set the color used when flow lines carry no colors, and for arrow
+ //! lattices
+ //
+ void SetColor(const float rgba[4]);
+
+ //! Set the periodic axes of the flow. Lines leaving the periodic
+ //! extents along such an axis are wrapped back inside them.
+ //!
+ //! \param[in] extents Periodic extents, in the stretched coordinates of
+ //! the flow lines
+ //
+ void SetPeriodic(const bool periodic[3], const float extents[6]);
+
+ //! Build tubes along flow lines
+ //!
+ //! \param[in] fld Flow lines, whose points are in stretched user
+ //! coordinates
+ //! \param[in] firstAge First point index drawn
+ //! \param[in] lastAge Last point index drawn
+ //! \param[in] constColors If true the color set with SetColor() is used
+ //! rather than the colors of the flow lines
+ //! \param[in] advectionEnds If true the points following the end of a
+ //! field line advection line get stationary symbols
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int BuildTubes(
+	FlowLineData *fld, int firstAge, int lastAge, bool constColors,
+	bool advectionEnds
+ );
+
+ //! Build an arrow along each segment of flow lines
+ //!
+ //! \sa BuildTubes()
+ //
+ int BuildArrows(
+	FlowLineData *fld, int firstAge, int lastAge, bool constColors
+ );
+
+ //! Build an arrow lattice
+ //!
+ //! An arrow is placed at each point of a \p grid[0] x \p grid[1] x
+ //! \p grid[2] lattice spanning \p extents, pointing along the field
+ //! sampled there. Points are at cell centers, or along x and y at cell
+ //! corners if \p alignedXY is true. Points where a field component is
+ //! missing get no arrow.
+ //!
+ //! \param[in] field Field components, NULL for a zero component
+ //! \param[in] height Terrain height, added to the z coordinate of the
+ //! points, or NULL
+ //! \param[in] extents Extents of the lattice, in user coordinates
+ //! \param[in] zBase Minimum z user coordinate of the data, subtracted
+ //! from the terrain height
+ //! \param[in] scales Stretch factors applied to the arrows
+ //! \param[in] vectorScale Length of an arrow per unit of the field
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int BuildLattice(
+	const RegularGrid *field[3], const RegularGrid *height,
+	const double extents[6], const int grid[3], bool alignedXY,
+	double zBase, const float scales[3], float vectorScale
+ );
+
+ //! Discard the geometry
+ //
+ void Clear();
+
+ size_t GetNumVertices() const { return(_verts.size() / 3); }
+
+ //! Return the vertices, three floats per vertex
+ //
+ const float *GetVertices() const {
+	return(_verts.size() ? &_verts[0] : NULL);
+ }
+
+ //! Return the normals, three floats per vertex
+ //
+ const float *GetNormals() const {
+	return(_norms.size() ? &_norms[0] : NULL);
+ }
+
+ //! Return the colors, four floats (RGBA) per vertex
+ //
+ const float *GetColors() const {
+	return(_colors.size() ? &_colors[0] : NULL);
+ }
+
+ //! Return the number of triangle indices, three per triangle
+ //
+ size_t GetNumIndices() const { return(_indices.size()); }
+
+ const unsigned int *GetIndices() const {
+	return(_indices.size() ? &_indices[0] : NULL);
+ }
+
+ //! Return the bounding box of the vertices
+ //!
+ //! \retval empty False if there is no geometry
+ //
+ bool GetBounds(float bounds[6]) const;
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(FlowGeometry *fg, int id) : _fg(fg), _id(id) {}
+	void RunThread();
+ private:
+	FlowGeometry *_fg;
+	int _id;	// thread id
+ };
+
+private:
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+
+ float _radius;
+ float _headRadius;
+ float _headSetBack;
+ bool _headTilt;
+ float _stationaryRadius;
+ float _color[4];
+ bool _periodic[3];
+ float _periodicExtents[6];
+
+ //
+ // Geometry of a block of flow lines or lattice rows
+ //
+ typedef struct {
+	std::vector <float> verts;
+	std::vector <float> norms;
+	std::vector <float> colors;
+	std::vector <unsigned int> indices;
+ } geom_t;
+
+ enum phase_t {TUBES, ARROWS, LATTICE};
+ phase_t _phase;
+ std::vector <geom_t> _blocks;
+ int _nitems;
+
+ //
+ // Inputs of the build in progress
+ //
+ FlowLineData *_fld;
+ int _firstAge;
+ int _lastAge;
+ bool _constColors;
+ bool _advectionEnds;
+ const RegularGrid *_field[3];
+ const RegularGrid *_height;
+ double _extents[6];
+ int _grid[3];
+ bool _alignedXY;
+ double _zBase;
+ float _scales[3];
+ float _vectorScale;
+
+ std::vector <float> _verts;
+ std::vector <float> _norms;
+ std::vector <float> _colors;
+ std::vector <unsigned int> _indices;
+ float _bounds[6];
+
+ int _run(phase_t phase, int nitems);
+ void _join();
+ void _block(int block);
+
+ int _lineStart(geom_t &g, int line, int firstIndex, int lastIndex) const;
+ void _tube(geom_t &g, int line) const;
+ void _flowArrows(geom_t &g, int line) const;
+ void _latticeRow(geom_t &g, int row) const;
+
+ const float *_lineColor(int line, int index) const;
+ bool _mapPeriodic(
+	const float orig[3], float mapped[3], const int oldCycle[3],
+	int newCycle[3]
+ ) const;
+
+ unsigned int _ring(
+	geom_t &g, const float center[3], const float u[3], const float b[3],
+	float radius, const float color[4], const float *tiltDir = NULL
+ ) const;
+ void _joinRings(geom_t &g, unsigned int r0, unsigned int r1) const;
+ void _cap(geom_t &g, unsigned int ring, const float normal[3]) const;
+ void _arrow(
+	geom_t &g, const float start[3], const float end[3], const float dir[3],
+	const float u[3], const float b[3], const float color[4]
+ ) const;
+ void _stationary(geom_t &g, const float point[3]) const;
+};
+
+};
+
+#endif	// _FlowGeometry_h_
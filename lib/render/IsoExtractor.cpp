@@ -0,0 +1,914 @@
+//-- IsoExtractor.cpp --------------------------------------------------------
+//
+// Isosurface extraction from RegularGrid data on the CPU
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+#include <typeinfo>
+#include "IsoExtractor.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Block size, in cells
+//
+#define BLOCK 8
+
+namespace {
+
+	//
+	// Corner n of a cell is at (n&1, (n>>1)&1, (n>>2)&1). Edges 0-3 are
+	// parallel to the x axis, 4-7 to y and 8-11 to z.
+	//
+	int EdgeLo[12];			// first corner of each edge
+	int EdgeAxis[12];
+	int TriTable[256][16];	// edges of the triangles of each case, or -1
+	bool TablesBuilt = false;
+
+	int edge_of(int c0, int c1) {
+		int lo = c0 & c1;
+		int axis = (c0 ^ c1) == 1 ? 0 : ((c0 ^ c1) == 2 ? 1 : 2);
+		for (int e=0; e<12; e++) {
+			if (EdgeAxis[e] == axis && EdgeLo[e] == lo) return(e);
+		}
+		assert(0);
+		return(-1);
+	}
+
+	//
+	// Build the marching cubes case table. The isosurface of each case
+	// is traced on the six faces of the cell: walking around a face
+	// counterclockwise, as seen from outside the cell, every edge going
+	// from a corner below the isovalue to a corner above it starts a
+	// segment that ends at the next edge crossed. Faces with alternating
+	// corners thus separate the corners above the isovalue, as seen
+	// from either cell sharing the face, so no cracks open between
+	// cells. The segments are chained into loops, which are split into
+	// triangle fans.
+	//
+	void build_tables() {
+		if (TablesBuilt) return;
+
+		for (int e=0; e<12; e++) {
+			int a = e / 4;
+			int m = e % 4;
+			int u = (m & 1);
+			int v = (m >> 1);
+			EdgeAxis[e] = a;
+			if (a == 0) EdgeLo[e] = (u << 1) | (v << 2);
+			else if (a == 1) EdgeLo[e] = u | (v << 2);
+			else EdgeLo[e] = u | (v << 1);
+		}
+
+		int faces[6][4];
+		for (int a=0; a<3; a++) {
+			int u = (a+1) % 3;
+			int v = (a+2) % 3;
+			int uv[4][2] = {{0,0}, {1,0}, {1,1}, {0,1}};
+			for (int s=0; s<2; s++) {
+				for (int t=0; t<4; t++) {
+					int tt = s ? t : 3-t;	// reverse faces facing -a
+					faces[a*2+s][t] =
+						(s << a) | (uv[tt][0] << u) | (uv[tt][1] << v);
+				}
+			}
+		}
+
+		for (int c=0; c<256; c++) {
+			int next[12];
+			for (int e=0; e<12; e++) next[e] = -1;
+
+			for (int f=0; f<6; f++) {
+				int crossed[4];
+				bool start[4];
+				int n = 0;
+				for (int t=0; t<4; t++) {
+					int c0 = faces[f][t];
+					int c1 = faces[f][(t+1) % 4];
+					bool above0 = (c >> c0) & 1;
+					bool above1 = (c >> c1) & 1;
+					if (above0 == above1) continue;
+					crossed[n] = edge_of(c0, c1);
+					start[n] = above1;
+					n++;
+				}
+				for (int i=0; i<n; i++) {
+					if (start[i]) next[crossed[i]] = crossed[(i+1) % n];
+				}
+			}
+
+			int ntri = 0;
+			bool visited[12] = {false};
+			for (int e=0; e<12; e++) {
+				if (next[e] < 0 || visited[e]) continue;
+
+				int loop[12];
+				int n = 0;
+				for (int x = e; ! visited[x]; x = next[x]) {
+					visited[x] = true;
+					loop[n++] = x;
+				}
+				for (int i=1; i<n-1; i++) {
+					TriTable[c][ntri*3+0] = loop[0];
+					TriTable[c][ntri*3+1] = loop[i];
+					TriTable[c][ntri*3+2] = loop[i+1];
+					ntri++;
+				}
+			}
+			assert(ntri <= 5);
+			for (int i=ntri*3; i<16; i++) TriTable[c][i] = -1;
+		}
+		TablesBuilt = true;
+	}
+
+	//
+	// Read n grid values of row (j,k), starting at i, a storage
+	// block run at a time
+	//
+	void read_row(
+		const RegularGrid *rg, size_t i, size_t j, size_t k, size_t n,
+		float *values
+	) {
+		float **blks = rg->GetBlks();
+		if (! blks) {
+			for (size_t x=0; x<n; x++) values[x] = rg->AccessIJK(i+x, j, k);
+			return;
+		}
+
+		size_t origin[3], dims[3], bs[3];
+		rg->GetIJKOrigin(origin);
+		rg->GetDimensions(dims);
+		rg->GetBlockSize(bs);
+
+		size_t goff[3], gbdim[3];
+		for (int a=0; a<3; a++) {
+			goff[a] = origin[a] % bs[a];
+			gbdim[a] = (goff[a] + dims[a] - 1) / bs[a] + 1;
+		}
+		size_t gbz = (k + goff[2]) / bs[2];
+		size_t zoff = (k + goff[2]) % bs[2];
+		size_t gby = (j + goff[1]) / bs[1];
+		size_t yoff = (j + goff[1]) % bs[1];
+
+		size_t x = 0;
+		while (x < n) {
+			size_t xx = i + x + goff[0];
+			size_t gbx = xx / bs[0];
+			size_t xoff = xx % bs[0];
+			size_t m = bs[0] - xoff;
+			if (m > n - x) m = n - x;
+
+			const float *line = blks[(gbz*gbdim[1] + gby)*gbdim[0] + gbx] +
+				(zoff*bs[1] + yoff)*bs[0] + xoff;
+			memcpy(values + x, line, m * sizeof(values[0]));
+			x += m;
+		}
+	}
+
+	void put(std::vector <unsigned char> &buf, const void *ptr, size_t n) {
+		const unsigned char *p = (const unsigned char *) ptr;
+		buf.insert(buf.end(), p, p + n);
+	}
+};
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunIsoExtractorThread(void *object) {
+		IsoExtractor::ThreadObj *X = (IsoExtractor::ThreadObj *) object;
+		X->RunThread();
+		return(0);
+	}
+};
+
+//----------------------------------------------------------------------------
+// IsoMesh
+//----------------------------------------------------------------------------
+
+size_t IsoMesh::GetMemoryUsage() const {
+	return(
+		verts.capacity() * sizeof(float) +
+		normals.capacity() * sizeof(float) +
+		values.capacity() * sizeof(float) +
+		colors.capacity() * sizeof(unsigned char) +
+		tris.capacity() * sizeof(unsigned int)
+	);
+}
+
+void IsoMesh::Clear() {
+	verts.clear();
+	normals.clear();
+	values.clear();
+	colors.clear();
+	tris.clear();
+}
+
+int IsoMesh::WritePLY(const string &path) const {
+
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (! fp) {
+		SetErrMsg("fopen(%s) : %M", path.c_str());
+		return(-1);
+	}
+
+	size_t nverts = GetNumVertices();
+	size_t ntris = GetNumTriangles();
+	bool hasNormals = normals.size() == verts.size();
+	bool hasColors = colors.size() == nverts * 4;
+
+	unsigned int one = 1;
+	bool little = *((unsigned char *) &one) == 1;
+
+	fprintf(fp, "ply\n");
+	fprintf(fp, "format %s 1.0\n",
+		little ? "binary_little_endian" : "binary_big_endian"
+	);
+	fprintf(fp, "comment VAPOR isosurface\n");
+	fprintf(fp, "element vertex %lu\n", (unsigned long) nverts);
+	fprintf(fp, "property float x\nproperty float y\nproperty float z\n");
+	if (hasNormals) {
+		fprintf(fp, "property float nx\nproperty float ny\nproperty float nz\n");
+	}
+	if (hasColors) {
+		fprintf(fp, "property uchar red\nproperty uchar green\n");
+		fprintf(fp, "property uchar blue\nproperty uchar alpha\n");
+	}
+	fprintf(fp, "element face %lu\n", (unsigned long) ntris);
+	fprintf(fp, "property list uchar int vertex_indices\n");
+	fprintf(fp, "end_header\n");
+
+	//
+	// Records are buffered a chunk at a time
+	//
+	const size_t chunk = 65536;
+	std::vector <unsigned char> buf;
+	for (size_t v0 = 0; v0 < nverts; v0 += chunk) {
+		buf.clear();
+		for (size_t v = v0; v < nverts && v < v0 + chunk; v++) {
+			put(buf, &verts[v*3], 3 * sizeof(float));
+			if (hasNormals) put(buf, &normals[v*3], 3 * sizeof(float));
+			if (hasColors) put(buf, &colors[v*4], 4);
+		}
+		fwrite(&buf[0], 1, buf.size(), fp);
+	}
+	for (size_t t0 = 0; t0 < ntris; t0 += chunk) {
+		buf.clear();
+		for (size_t t = t0; t < ntris && t < t0 + chunk; t++) {
+			unsigned char n = 3;
+			int idx[3] = {(int) tris[t*3], (int) tris[t*3+1], (int) tris[t*3+2]};
+			put(buf, &n, 1);
+			put(buf, idx, sizeof(idx));
+		}
+		fwrite(&buf[0], 1, buf.size(), fp);
+	}
+
+	bool error = ferror(fp);
+	if (fclose(fp) != 0 || error) {
+		SetErrMsg("Error writing PLY file %s : %M", path.c_str());
+		return(-1);
+	}
+	return(0);
+}
+
+int IsoMesh::WriteOBJ(const string &path) const {
+
+	FILE *fp = fopen(path.c_str(), "w");
+	if (! fp) {
+		SetErrMsg("fopen(%s) : %M", path.c_str());
+		return(-1);
+	}
+
+	size_t nverts = GetNumVertices();
+	size_t ntris = GetNumTriangles();
+	bool hasNormals = normals.size() == verts.size();
+	bool hasColors = colors.size() == nverts * 4;
+
+	fprintf(fp, "# VAPOR isosurface\n");
+	for (size_t v = 0; v < nverts; v++) {
+		const float *p = &verts[v*3];
+		if (hasColors) {
+			const unsigned char *c = &colors[v*4];
+			fprintf(fp, "v %g %g %g %g %g %g\n", p[0], p[1], p[2],
+				c[0] / 255.0, c[1] / 255.0, c[2] / 255.0
+			);
+		}
+		else {
+			fprintf(fp, "v %g %g %g\n", p[0], p[1], p[2]);
+		}
+	}
+	if (hasNormals) {
+		for (size_t v = 0; v < nverts; v++) {
+			const float *n = &normals[v*3];
+			fprintf(fp, "vn %g %g %g\n", n[0], n[1], n[2]);
+		}
+	}
+	for (size_t t = 0; t < ntris; t++) {
+		unsigned long a = tris[t*3] + 1;
+		unsigned long b = tris[t*3+1] + 1;
+		unsigned long c = tris[t*3+2] + 1;
+		if (hasNormals) {
+			fprintf(fp, "f %lu//%lu %lu//%lu %lu//%lu\n", a, a, b, b, c, c);
+		}
+		else {
+			fprintf(fp, "f %lu %lu %lu\n", a, b, c);
+		}
+	}
+
+	bool error = ferror(fp);
+	if (fclose(fp) != 0 || error) {
+		SetErrMsg("Error writing OBJ file %s : %M", path.c_str());
+		return(-1);
+	}
+	return(0);
+}
+
+//----------------------------------------------------------------------------
+// IsoExtractor
+//----------------------------------------------------------------------------
+
+IsoExtractor::IsoExtractor(int nthreads) : _et(nthreads) {
+
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	build_tables();
+
+	_rg = NULL;
+	_map = NULL;
+	_isRegular = false;
+	for (int i=0; i<3; i++) {
+		_dims[i] = 0;
+		_nb[i] = 0;
+	}
+	for (int i=0; i<6; i++) _extents[i] = 0.0;
+	_doNormals = false;
+	_skipping = true;
+	for (int i=0; i<256; i++) {
+		for (int c=0; c<4; c++) _ctab[i][c] = 0.0;
+	}
+	_crange[0] = _crange[1] = 0.0;
+	_doColors = false;
+
+	_phase = RANGE;
+	_isovalue = 0.0;
+	_nactive = 0;
+}
+
+int IsoExtractor::SetGrid(const RegularGrid *rg) {
+
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	for (int i=0; i<3; i++) {
+		if (dims[i] < 2) {
+			SetErrMsg("Invalid grid dimensions");
+			return(-1);
+		}
+	}
+
+	_rg = rg;
+	_map = NULL;
+	_isRegular = typeid(*rg) == typeid(RegularGrid);
+	rg->GetUserExtents(_extents);
+
+	for (int i=0; i<3; i++) {
+		_dims[i] = dims[i];
+		_nb[i] = (dims[i] - 2) / BLOCK + 1;
+	}
+
+	//
+	// Compute the range of each block, and build the levels of the
+	// octree above them
+	//
+	_omin.clear();
+	_omax.clear();
+	_odims.clear();
+
+	std::vector <size_t> odims(_nb, _nb+3);
+	size_t n = _nb[0]*_nb[1]*_nb[2];
+	_omin.push_back(std::vector <float> (n));
+	_omax.push_back(std::vector <float> (n));
+	_odims.push_back(odims);
+
+	int rc = _run(RANGE);
+	if (rc < 0) return(-1);
+
+	while (odims[0] > 1 || odims[1] > 1 || odims[2] > 1) {
+		const std::vector <size_t> cdims = odims;
+		for (int i=0; i<3; i++) odims[i] = (cdims[i] + 1) / 2;
+
+		std::vector <float> pmin(odims[0]*odims[1]*odims[2], FLT_MAX);
+		std::vector <float> pmax(odims[0]*odims[1]*odims[2], -FLT_MAX);
+		const std::vector <float> &cmin = _omin.back();
+		const std::vector <float> &cmax = _omax.back();
+
+		for (size_t z=0; z<cdims[2]; z++) {
+		for (size_t y=0; y<cdims[1]; y++) {
+		for (size_t x=0; x<cdims[0]; x++) {
+			size_t c = (z*cdims[1] + y)*cdims[0] + x;
+			size_t p = ((z/2)*odims[1] + y/2)*odims[0] + x/2;
+			if (cmin[c] < pmin[p]) pmin[p] = cmin[c];
+			if (cmax[c] > pmax[p]) pmax[p] = cmax[c];
+		}
+		}
+		}
+		_omin.push_back(pmin);
+		_omax.push_back(pmax);
+		_odims.push_back(odims);
+	}
+	return(0);
+}
+
+int IsoExtractor::SetMapGrid(const RegularGrid *map) {
+	if (map) {
+		size_t dims[3];
+		map->GetDimensions(dims);
+		for (int i=0; i<3; i++) {
+			if (dims[i] != _dims[i]) {
+				SetErrMsg("Map grid dimensions differ from isosurface grid");
+				return(-1);
+			}
+		}
+	}
+	_map = map;
+	return(0);
+}
+
+void IsoExtractor::SetColorMap(const float ctab[256][4], const float range[2]) {
+	_doColors = ctab != NULL;
+	if (! ctab) return;
+
+	for (int i=0; i<256; i++) {
+		for (int c=0; c<4; c++) _ctab[i][c] = ctab[i][c];
+	}
+	_crange[0] = range[0];
+	_crange[1] = range[1];
+}
+
+size_t IsoExtractor::GetMemoryUsage() const {
+	size_t size = _blockMap.capacity() * sizeof(int);
+	for (int l=0; l<_omin.size(); l++) {
+		size += (_omin[l].capacity() + _omax[l].capacity()) * sizeof(float);
+	}
+	return(size);
+}
+
+int IsoExtractor::Extract(float isovalue, IsoMesh *mesh) {
+
+	mesh->Clear();
+	if (! _rg) {
+		SetErrMsg("No grid");
+		return(-1);
+	}
+
+	_isovalue = isovalue;
+	_active.clear();
+	_blockMap.assign(GetNumBlocks(), -1);
+
+	//
+	// Find the blocks that may intersect the isosurface
+	//
+	if (_skipping) {
+		size_t root[3] = {0, 0, 0};
+		_traverse(_omin.size() - 1, root);
+	}
+	else {
+		for (size_t z=0; z<_nb[2]; z++) {
+		for (size_t y=0; y<_nb[1]; y++) {
+		for (size_t x=0; x<_nb[0]; x++) {
+			block_t blk;
+			blk.b[0] = x;
+			blk.b[1] = y;
+			blk.b[2] = z;
+			blk.voffset = 0;
+			_active.push_back(blk);
+		}
+		}
+		}
+	}
+	_nactive = _active.size();
+	for (size_t a=0; a<_active.size(); a++) {
+		const size_t *b = _active[a].b;
+		_blockMap[(b[2]*_nb[1] + b[1])*_nb[0] + b[0]] = a;
+	}
+
+	//
+	// Compute the vertices of each block, number them, and assemble
+	// the triangles
+	//
+	int rc = _run(VERTICES);
+	if (rc < 0) return(-1);
+
+	size_t nverts = 0;
+	for (size_t a=0; a<_active.size(); a++) {
+		_active[a].voffset = nverts;
+		nverts += _active[a].verts.size() / 3;
+	}
+
+	rc = _run(TRIANGLES);
+	if (rc < 0) return(-1);
+
+	size_t ntris = 0;
+	for (size_t a=0; a<_active.size(); a++) ntris += _active[a].tris.size() / 3;
+
+	mesh->verts.reserve(nverts * 3);
+	if (_doNormals) mesh->normals.reserve(nverts * 3);
+	if (_map) mesh->values.reserve(nverts);
+	mesh->tris.reserve(ntris * 3);
+
+	for (size_t a=0; a<_active.size(); a++) {
+		block_t &blk = _active[a];
+		mesh->verts.insert(mesh->verts.end(), blk.verts.begin(), blk.verts.end());
+		mesh->normals.insert(
+			mesh->normals.end(), blk.normals.begin(), blk.normals.end()
+		);
+		mesh->values.insert(
+			mesh->values.end(), blk.values.begin(), blk.values.end()
+		);
+		mesh->tris.insert(mesh->tris.end(), blk.tris.begin(), blk.tris.end());
+	}
+	_active.clear();
+
+	if (_map && _doColors) {
+		mesh->colors.resize(nverts * 4);
+		float scale = _crange[1] > _crange[0] ?
+			255.0 / (_crange[1] - _crange[0]) : 0.0;
+		for (size_t v=0; v<nverts; v++) {
+			unsigned char *rgba = &mesh->colors[v*4];
+			float value = mesh->values[v];
+			if (_isMissing(_map, value)) {
+				rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0;
+				continue;
+			}
+			float x = (value - _crange[0]) * scale;
+			x = x > 0.0 ? x : 0.0;
+			x = x < 255.0 ? x : 255.0;
+			const float *c = _ctab[(int) (x + 0.5)];
+			for (int i=0; i<4; i++) {
+				rgba[i] = (unsigned char) (c[i] * 255.0 + 0.5);
+			}
+		}
+	}
+	return(0);
+}
+
+int IsoExtractor::_run(phase_t phase) {
+	_phase = phase;
+
+	std::vector <ThreadObj *> objs;
+	for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+	int rc = 0;
+	if (_nthreads <= 1) {
+		objs[0]->RunThread();
+	}
+	else {
+		rc = _et.ParRun(RunIsoExtractorThread, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+	for (int t=0; t<_nthreads; t++) delete objs[t];
+
+	return(rc < 0 ? -1 : 0);
+}
+
+void IsoExtractor::ThreadObj::RunThread() {
+
+	int nthreads = _ex->_nthreads;
+
+	switch (_ex->_phase) {
+	case RANGE:
+		for (size_t b = _id; b < _ex->GetNumBlocks(); b += nthreads) {
+			_ex->_blockRange(b);
+		}
+		break;
+
+	case VERTICES:
+		for (size_t a = _id; a < _ex->_active.size(); a += nthreads) {
+			_ex->_blockVertices(_ex->_active[a]);
+		}
+		break;
+
+	case TRIANGLES:
+		for (size_t a = _id; a < _ex->_active.size(); a += nthreads) {
+			_ex->_blockTriangles(_ex->_active[a]);
+		}
+		break;
+	}
+}
+
+void IsoExtractor::_traverse(int level, const size_t node[3]) {
+	const std::vector <size_t> &odims = _odims[level];
+	size_t n = (node[2]*odims[1] + node[1])*odims[0] + node[0];
+
+	if (! (_omin[level][n] < _isovalue && _omax[level][n] >= _isovalue)) {
+		return;
+	}
+
+	if (level == 0) {
+		block_t blk;
+		for (int i=0; i<3; i++) blk.b[i] = node[i];
+		blk.voffset = 0;
+		_active.push_back(blk);
+		return;
+	}
+
+	const std::vector <size_t> &cdims = _odims[level-1];
+	for (int z=0; z<2; z++) {
+	for (int y=0; y<2; y++) {
+	for (int x=0; x<2; x++) {
+		size_t child[3] = {node[0]*2 + x, node[1]*2 + y, node[2]*2 + z};
+		if (child[0] < cdims[0] && child[1] < cdims[1] && child[2] < cdims[2]) {
+			_traverse(level-1, child);
+		}
+	}
+	}
+	}
+}
+
+//
+// Cells c0 through c1-1 of a block, along each axis, and the grid
+// points c0 through o1-1 that own the edges starting at them. The last
+// block along an axis also owns the last grid point.
+//
+void IsoExtractor::_blockBounds(
+	const size_t b[3], size_t c0[3], size_t c1[3], size_t o1[3]
+) const {
+	for (int i=0; i<3; i++) {
+		c0[i] = b[i] * BLOCK;
+		c1[i] = c0[i] + BLOCK < _dims[i] - 1 ? c0[i] + BLOCK : _dims[i] - 1;
+		o1[i] = b[i] == _nb[i] - 1 ? _dims[i] : c1[i];
+	}
+}
+
+//
+// Read the grid points from lo through hi, inclusive
+//
+void IsoExtractor::_readBlock(
+	const RegularGrid *rg, const size_t lo[3], const size_t hi[3],
+	std::vector <float> &buf
+) const {
+	size_t nx = hi[0] - lo[0] + 1;
+	size_t ny = hi[1] - lo[1] + 1;
+	size_t nz = hi[2] - lo[2] + 1;
+	buf.resize(nx * ny * nz);
+
+	for (size_t k=0; k<nz; k++) {
+		for (size_t j=0; j<ny; j++) {
+			read_row(rg, lo[0], lo[1]+j, lo[2]+k, nx, &buf[(k*ny + j)*nx]);
+		}
+	}
+}
+
+void IsoExtractor::_coords(size_t i, size_t j, size_t k, double p[3]) const {
+	if (_isRegular) {
+		size_t ijk[3] = {i, j, k};
+		for (int a=0; a<3; a++) {
+			p[a] = _extents[a] + (_extents[a+3] - _extents[a]) *
+				(double) ijk[a] / (double) (_dims[a] - 1);
+		}
+	}
+	else {
+		(void) _rg->GetUserCoordinates(i, j, k, &p[0], &p[1], &p[2]);
+	}
+}
+
+void IsoExtractor::_blockRange(size_t b) {
+	size_t bc[3] = {
+		b % _nb[0], (b / _nb[0]) % _nb[1], b / (_nb[0] * _nb[1])
+	};
+	size_t c0[3], c1[3], o1[3];
+	_blockBounds(bc, c0, c1, o1);
+
+	std::vector <float> buf;
+	_readBlock(_rg, c0, c1, buf);
+
+	float vmin = FLT_MAX;
+	float vmax = -FLT_MAX;
+	for (size_t i=0; i<buf.size(); i++) {
+		float v = buf[i];
+		if (_isMissing(_rg, v)) continue;
+		if (v < vmin) vmin = v;
+		if (v > vmax) vmax = v;
+	}
+	_omin[0][b] = vmin;
+	_omax[0][b] = vmax;
+}
+
+//
+// Compute the vertices on the edges a block owns
+//
+void IsoExtractor::_blockVertices(block_t &blk) const {
+	size_t c0[3], c1[3], o1[3];
+	_blockBounds(blk.b, c0, c1, o1);
+
+	// Grid points read, with a layer of neighbors for the gradients
+	//
+	size_t lo[3], hi[3];
+	for (int a=0; a<3; a++) {
+		lo[a] = c0[a] > 0 ? c0[a] - 1 : 0;
+		hi[a] = c1[a] + 1 < _dims[a] ? c1[a] + 1 : _dims[a] - 1;
+	}
+	size_t nx = hi[0] - lo[0] + 1;
+	size_t ny = hi[1] - lo[1] + 1;
+	size_t stride[3] = {1, nx, nx*ny};
+
+	std::vector <float> buf, mbuf;
+	_readBlock(_rg, lo, hi, buf);
+	if (_map) _readBlock(_map, lo, hi, mbuf);
+
+	size_t n[3];
+	for (int a=0; a<3; a++) n[a] = o1[a] - c0[a];
+	blk.edges.assign(n[0]*n[1]*n[2]*3, -1);
+	blk.verts.clear();
+	blk.normals.clear();
+	blk.values.clear();
+
+	double delta[3];
+	for (int a=0; a<3; a++) {
+		delta[a] = (_extents[a+3] - _extents[a]) / (double) (_dims[a] - 1);
+		if (delta[a] <= 0.0) delta[a] = 1.0;
+	}
+
+	int nverts = 0;
+	for (size_t k=c0[2]; k<o1[2]; k++) {
+	for (size_t j=c0[1]; j<o1[1]; j++) {
+	for (size_t i=c0[0]; i<o1[0]; i++) {
+		size_t ijk[3] = {i, j, k};
+		size_t l0 = ((k-lo[2])*ny + (j-lo[1]))*nx + (i-lo[0]);
+		float v0 = buf[l0];
+		if (_isMissing(_rg, v0)) continue;
+
+		for (int a=0; a<3; a++) {
+			if (ijk[a] + 1 >= _dims[a]) continue;
+
+			size_t l1 = l0 + stride[a];
+			float v1 = buf[l1];
+			if (_isMissing(_rg, v1)) continue;
+			if ((v0 < _isovalue) == (v1 < _isovalue)) continue;
+
+			double t = (_isovalue - v0) / (v1 - v0);
+
+			size_t ijk1[3] = {i, j, k};
+			ijk1[a]++;
+			double p0[3], p1[3];
+			_coords(i, j, k, p0);
+			_coords(ijk1[0], ijk1[1], ijk1[2], p1);
+			for (int c=0; c<3; c++) {
+				blk.verts.push_back(p0[c] + t * (p1[c] - p0[c]));
+			}
+
+			if (_doNormals) {
+
+				// Central difference gradients at the end points, one
+				// sided at the grid boundary or next to missing values
+				//
+				double g[2][3];
+				const size_t *pts[2] = {ijk, ijk1};
+				size_t ls[2] = {l0, l1};
+				for (int e=0; e<2; e++) {
+					float v = buf[ls[e]];
+					for (int d=0; d<3; d++) {
+						float vm = v, vp = v;
+						double h = 0.0;
+						if (pts[e][d] > lo[d] &&
+							! _isMissing(_rg, buf[ls[e] - stride[d]])) {
+
+							vm = buf[ls[e] - stride[d]];
+							h += delta[d];
+						}
+						if (pts[e][d] < hi[d] &&
+							! _isMissing(_rg, buf[ls[e] + stride[d]])) {
+
+							vp = buf[ls[e] + stride[d]];
+							h += delta[d];
+						}
+						g[e][d] = h > 0.0 ? (vp - vm) / h : 0.0;
+					}
+				}
+
+				// Normals point down the gradient
+				//
+				double nrm[3];
+				double len = 0.0;
+				for (int d=0; d<3; d++) {
+					nrm[d] = -(g[0][d] + t * (g[1][d] - g[0][d]));
+					len += nrm[d] * nrm[d];
+				}
+				len = sqrt(len);
+				for (int d=0; d<3; d++) {
+					blk.normals.push_back(len > 0.0 ? nrm[d] / len : 0.0);
+				}
+			}
+
+			if (_map) {
+				float m0 = mbuf[l0];
+				float m1 = mbuf[l1];
+				bool miss0 = _isMissing(_map, m0);
+				bool miss1 = _isMissing(_map, m1);
+				float m;
+				if (miss0 && miss1) m = _map->GetMissingValue();
+				else if (miss0) m = m1;
+				else if (miss1) m = m0;
+				else m = m0 + t * (m1 - m0);
+				blk.values.push_back(m);
+			}
+
+			size_t e = (((k-c0[2])*n[1] + (j-c0[1]))*n[0] + (i-c0[0]))*3 + a;
+			blk.edges[e] = nverts++;
+		}
+	}
+	}
+	}
+}
+
+//
+// Triangulate the cells of a block
+//
+void IsoExtractor::_blockTriangles(block_t &blk) const {
+	size_t c0[3], c1[3], o1[3];
+	_blockBounds(blk.b, c0, c1, o1);
+
+	std::vector <float> buf;
+	_readBlock(_rg, c0, c1, buf);
+	size_t nx = c1[0] - c0[0] + 1;
+	size_t ny = c1[1] - c0[1] + 1;
+	size_t stride[3] = {1, nx, nx*ny};
+
+	size_t corner[8];
+	for (int c=0; c<8; c++) {
+		corner[c] = (c & 1)*stride[0] + ((c>>1) & 1)*stride[1] +
+			((c>>2) & 1)*stride[2];
+	}
+
+	blk.tris.clear();
+	for (size_t k=c0[2]; k<c1[2]; k++) {
+	for (size_t j=c0[1]; j<c1[1]; j++) {
+	for (size_t i=c0[0]; i<c1[0]; i++) {
+		const float *v = &buf[((k-c0[2])*ny + (j-c0[1]))*nx + (i-c0[0])];
+
+		int mask = 0;
+		bool missing = false;
+		for (int c=0; c<8; c++) {
+			float vc = v[corner[c]];
+			if (_isMissing(_rg, vc)) missing = true;
+			if (vc >= _isovalue) mask |= 1 << c;
+		}
+		if (missing || mask == 0 || mask == 255) continue;
+
+		const int *edges = TriTable[mask];
+		for (int t=0; edges[t] >= 0; t += 3) {
+			unsigned int tri[3];
+			bool ok = true;
+			for (int x=0; x<3 && ok; x++) {
+				int e = edges[t+x];
+
+				// The grid point the edge starts at, and the block
+				// owning it
+				//
+				int lo = EdgeLo[e];
+				size_t p[3] = {i + (lo & 1), j + ((lo>>1) & 1), k + ((lo>>2) & 1)};
+				size_t ob[3];
+				for (int a=0; a<3; a++) {
+					ob[a] = p[a] / BLOCK;
+					if (ob[a] > _nb[a] - 1) ob[a] = _nb[a] - 1;
+				}
+				const block_t *owner = &blk;
+				if (ob[0] != blk.b[0] || ob[1] != blk.b[1] || ob[2] != blk.b[2]) {
+					int idx = _blockMap[(ob[2]*_nb[1] + ob[1])*_nb[0] + ob[0]];
+					if (idx < 0) {
+						ok = false;
+						continue;
+					}
+					owner = &_active[idx];
+				}
+
+				size_t oc0[3], oc1[3], oo1[3];
+				_blockBounds(owner->b, oc0, oc1, oo1);
+				size_t l = (((p[2]-oc0[2])*(oo1[1]-oc0[1]) + (p[1]-oc0[1])) *
+					(oo1[0]-oc0[0]) + (p[0]-oc0[0]))*3 + EdgeAxis[e];
+				int vi = owner->edges[l];
+				if (vi < 0) {
+					ok = false;
+					continue;
+				}
+				tri[x] = owner->voffset + vi;
+			}
+			if (! ok) continue;
+			blk.tris.push_back(tri[0]);
+			blk.tris.push_back(tri[1]);
+			blk.tris.push_back(tri[2]);
+		}
+	}
+	}
+	}
+}
@@ -0,0 +1,225 @@
+//-- IsoExtractor.h ----------------------------------------------------------
+//
+// Isosurface extraction from RegularGrid data on the CPU, and export of
+// the resulting triangle meshes. No OpenGL calls are made.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _IsoExtractor_h_
+#define _IsoExtractor_h_
+
+#include <vector>
+#include <string>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class IsoMesh
+//! \brief An indexed triangle mesh
+//!
+//! Vertices are in user coordinates. The optional per vertex normals,
+//! values of a mapped variable, and RGBA colors are either empty or
+//! have an entry for every vertex. Triangles are counterclockwise when
+//! seen from the side of the surface with values lower than the
+//! isovalue, which normals point to.
+//
+class RENDER_API IsoMesh : public VetsUtil::MyBase {
+public:
+
+ std::vector <float> verts;			// x, y, z per vertex
+ std::vector <float> normals;		// nx, ny, nz per vertex
+ std::vector <float> values;		// mapped variable per vertex
+ std::vector <unsigned char> colors;	// RGBA per vertex
+ std::vector <unsigned int> tris;	// three vertex indices per triangle
+
+ size_t GetNumVertices() const { return(verts.size() / 3); }
+ size_t GetNumTriangles() const { return(tris.size() / 3); }
+
+ //! Return the number of bytes used by the mesh
+ //
+ size_t GetMemoryUsage() const;
+
+ void Clear();
+
+ //! Write the mesh to a binary PLY file, with the normals and colors
+ //! if present
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int WritePLY(const std::string &path) const;
+
+ //! Write the mesh to a Wavefront OBJ file, with the normals if
+ //! present. Colors, if present, follow the vertex coordinates.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int WriteOBJ(const std::string &path) const;
+};
+
+//
+//! \class IsoExtractor
+//! \brief Extracts isosurfaces from a RegularGrid with marching cubes
+//!
+//! The grid's cells are partitioned into blocks of 8x8x8 cells. The
+//! minimum and maximum of the (non-missing) values of each block are
+//! stored in the leaves of a min-max octree, which is built once per
+//! grid and lets Extract() visit only the blocks an isosurface may
+//! cross. The blocks visited are spread over threads.
+//!
+//! Vertices are shared by the triangles of adjacent cells, and blocks,
+//! without any global hash table: each block owns the cell edges
+//! starting at its grid points, and records the vertices of its edges
+//! in a table indexed by edge. Triangles are assembled once the vertices
+//! of all blocks have been numbered.
+//!
+//! Cells with a missing (or NaN) value at any corner are not
+//! triangulated. Vertex coordinates of layered and other non-regular
+//! grids are interpolated from the user coordinates of the grid points.
+//
+class RENDER_API IsoExtractor : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ IsoExtractor(int nthreads = 0);
+ virtual ~IsoExtractor() {}
+
+ //! Set the grid isosurfaces are extracted from, and build its min-max
+ //! octree
+ //!
+ //! The grid is not copied, and must not be modified or deleted while
+ //! it is in use by the extractor.
+ //!
+ //! \retval status A negative int is returned if the grid has fewer
+ //! than two grid points along any axis
+ //
+ int SetGrid(const RegularGrid *rg);
+
+ //! Set the grid of a variable mapped onto the isosurfaces
+ //!
+ //! \param[in] map Grid with the dimensions of the grid set by SetGrid(),
+ //! or NULL to map nothing
+ //!
+ //! \retval status A negative int is returned if the dimensions differ
+ //
+ int SetMapGrid(const RegularGrid *map);
+
+ //! Set the color table the mapped variable is colored with
+ //!
+ //! \param[in] ctab RGBA color table, or NULL for no colors
+ //! \param[in] range Values of the mapped variable mapped to the first
+ //! and last table entries
+ //
+ void SetColorMap(const float ctab[256][4], const float range[2]);
+
+ //! Enable or disable the computation of vertex normals from the
+ //! gradient of the grid
+ //
+ void SetNormals(bool enable) { _doNormals = enable; }
+
+ //! Enable or disable skipping of the blocks the octree excludes
+ //
+ void SetSkipping(bool enable) { _skipping = enable; }
+
+ //! Extract an isosurface
+ //!
+ //! \param[in] isovalue Isovalue
+ //! \param[out] mesh Mesh of the isosurface. Values of the mapped
+ //! variable, and colors, are computed if a map grid (and color table)
+ //! has been set.
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Extract(float isovalue, IsoMesh *mesh);
+
+ //! Return the number of blocks, and the number visited by the last call
+ //! to Extract()
+ //
+ size_t GetNumBlocks() const { return(_nb[0]*_nb[1]*_nb[2]); }
+ size_t GetNumActiveBlocks() const { return(_nactive); }
+
+ //! Return the number of bytes used by the octree
+ //
+ size_t GetMemoryUsage() const;
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(IsoExtractor *ex, int id) : _ex(ex), _id(id) {}
+	void RunThread();
+ private:
+	IsoExtractor *_ex;
+	int _id;	// thread id
+ };
+
+private:
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+
+ const RegularGrid *_rg;
+ const RegularGrid *_map;
+ bool _isRegular;			// grid coordinates are computed from extents
+ size_t _dims[3];
+ double _extents[6];
+ bool _doNormals;
+ bool _skipping;
+ float _ctab[256][4];
+ float _crange[2];
+ bool _doColors;
+
+ //
+ // Min-max octree. Level 0 holds the blocks.
+ //
+ size_t _nb[3];				// blocks along each axis
+ std::vector <std::vector <float> > _omin;
+ std::vector <std::vector <float> > _omax;
+ std::vector <std::vector <size_t> > _odims;	// 3 dims per level
+
+ //
+ // Per block state of an extraction
+ //
+ typedef struct {
+	size_t b[3];			// block coordinates
+	std::vector <int> edges;	// vertex of each owned edge, or -1
+	std::vector <float> verts;
+	std::vector <float> normals;
+	std::vector <float> values;
+	std::vector <unsigned int> tris;
+	size_t voffset;			// index of the first vertex in the mesh
+ } block_t;
+
+ enum phase_t {RANGE, VERTICES, TRIANGLES};
+ phase_t _phase;
+ float _isovalue;
+ std::vector <block_t> _active;	// blocks visited
+ size_t _nactive;
+ std::vector <int> _blockMap;	// index in _active of each block, or -1
+
+ int _run(phase_t phase);
+ void _blockRange(size_t b);
+ void _blockVertices(block_t &blk) const;
+ void _blockTriangles(block_t &blk) const;
+ void _traverse(int level, const size_t node[3]);
+
+ void _blockBounds(
+	const size_t b[3], size_t c0[3], size_t c1[3], size_t o1[3]
+ ) const;
+ void _readBlock(
+	const RegularGrid *rg, const size_t lo[3], const size_t hi[3],
+	std::vector <float> &buf
+ ) const;
+ bool _isMissing(const RegularGrid *rg, float v) const {
+	return((rg->HasMissingData() && v == rg->GetMissingValue()) || v != v);
+ }
+ void _coords(size_t i, size_t j, size_t k, double p[3]) const;
+};
+
+};
+
+#endif	// _IsoExtractor_h_
@@ -0,0 +1,381 @@
+//-- IsolineExtractor.cpp ----------------------------------------------------
+//
+// Isoline extraction from a plane on the CPU
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cassert>
+#include "IsolineExtractor.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Rows of cells per band
+//
+#define BAND 32
+
+namespace {
+
+	//
+	// The edges of a cell are numbered counterclockwise starting with the
+	// bottom one: 0 joins corners (i,j) and (i+1,j), 1 joins (i+1,j) and
+	// (i+1,j+1), 2 joins (i,j+1) and (i+1,j+1), and 3 joins (i,j) and
+	// (i,j+1). The segments of each combination of crossed edges (bit n
+	// set if edge n is crossed) are listed as pairs of edges. All four
+	// edges are crossed in two ways, decided by the cell's average.
+	//
+	const int NumSegs[16] = {0, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 2};
+	const int SegEdges[16][2][2] = {
+		{{0,0},{0,0}}, {{0,0},{0,0}}, {{0,0},{0,0}}, {{0,1},{0,0}},
+		{{0,0},{0,0}}, {{0,2},{0,0}}, {{1,2},{0,0}}, {{0,0},{0,0}},
+		{{0,0},{0,0}}, {{3,0},{0,0}}, {{1,3},{0,0}}, {{0,0},{0,0}},
+		{{2,3},{0,0}}, {{0,0},{0,0}}, {{0,0},{0,0}}, {{0,0},{0,0}}
+	};
+	const int SaddleSame[2][2] = {{0,1},{2,3}};	// average on side of (i,j)
+	const int SaddleOther[2][2] = {{3,0},{1,2}};
+
+	//
+	// Plane coordinate of sample n
+	//
+	inline float coord(int n, int gridSize) {
+		return(-1. + 2.*(double)(n)/(gridSize-1.));
+	}
+
+	//
+	// Plane coordinate of the isovalue crossing on the line from sample n,
+	// value v0, to sample n+1, value v1
+	//
+	inline float interp(int n, int gridSize, float isoval, float v0, float v1) {
+		return(
+			-1. + 2.*(double)(n)/((double)gridSize-1.) +
+			2./(double)(gridSize-1.) * (isoval - v0)/(v1 - v0)
+		);
+	}
+};
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunIsolineExtractorThread(void *object) {
+		IsolineExtractor::ThreadObj *X = (IsolineExtractor::ThreadObj *) object;
+		X->RunThread();
+		return(0);
+	}
+};
+
+IsolineExtractor::IsolineExtractor(int nthreads) : _et(nthreads) {
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+
+	_gridSize = 0;
+	_mv = 0.0;
+	_rg = NULL;
+	for (int i=0; i<3; i++) _origin[i] = _du[i] = _dv[i] = 0.0;
+	for (int i=0; i<6; i++) _bounds[i] = 0.0;
+
+	_phase = SAMPLE;
+	_nbands = 0;
+	_edgeSegs.resize(_nthreads);
+}
+
+int IsolineExtractor::SamplePlane(
+	const RegularGrid *rg, int gridSize, const double origin[3],
+	const double du[3], const double dv[3], const double bounds[6]
+) {
+	if (gridSize < 2) {
+		SetErrMsg("Invalid plane size : %d", gridSize);
+		return(-1);
+	}
+
+	_rg = rg;
+	_gridSize = gridSize;
+	_mv = rg->GetMissingValue();
+	for (int i=0; i<3; i++) {
+		_origin[i] = origin[i];
+		_du[i] = du[i];
+		_dv[i] = dv[i];
+	}
+	for (int i=0; i<6; i++) _bounds[i] = bounds[i];
+
+	_values.resize((size_t) gridSize * gridSize);
+
+	int rc = _run(SAMPLE);
+	_rg = NULL;
+	return(rc);
+}
+
+int IsolineExtractor::SetPlane(
+	const float *values, int gridSize, float missingValue
+) {
+	if (gridSize < 2) {
+		SetErrMsg("Invalid plane size : %d", gridSize);
+		return(-1);
+	}
+	_gridSize = gridSize;
+	_mv = missingValue;
+	_values.assign(values, values + (size_t) gridSize * gridSize);
+	return(0);
+}
+
+int IsolineExtractor::Extract(const std::vector <double> &isovalues, bool curves) {
+	if (_gridSize < 2) {
+		SetErrMsg("No plane to extract isolines from");
+		return(-1);
+	}
+
+	_nbands = (_gridSize - 1 + BAND - 1) / BAND;
+
+	_isos.clear();
+	_isos.resize(isovalues.size());
+	for (int iso=0; iso<_isos.size(); iso++) {
+		_isos[iso].isoval = (float) isovalues[iso];
+		_isos[iso].bandSegs.resize(_nbands);
+		_isos[iso].bandEdges.resize(_nbands);
+	}
+
+	int rc = _run(SEGMENTS);
+	if (rc < 0) return(-1);
+
+	//
+	// Join the bands
+	//
+	for (int iso=0; iso<_isos.size(); iso++) {
+		iso_t &iv = _isos[iso];
+		size_t nsegs = 0;
+		for (int b=0; b<_nbands; b++) nsegs += iv.bandEdges[b].size() / 2;
+
+		iv.segs.reserve(nsegs * 4);
+		iv.edges.reserve(nsegs * 2);
+		for (int b=0; b<_nbands; b++) {
+			iv.segs.insert(
+				iv.segs.end(), iv.bandSegs[b].begin(), iv.bandSegs[b].end()
+			);
+			iv.edges.insert(
+				iv.edges.end(), iv.bandEdges[b].begin(), iv.bandEdges[b].end()
+			);
+		}
+		iv.bandSegs.clear();
+		iv.bandEdges.clear();
+	}
+
+	if (curves) {
+		for (int t=0; t<_nthreads; t++) {
+			if (_edgeSegs[t].size() != 2 * _numEdges()) {
+				_edgeSegs[t].assign(2 * _numEdges(), -1);
+			}
+		}
+		rc = _run(CURVES);
+		if (rc < 0) return(-1);
+	}
+	return(0);
+}
+
+int IsolineExtractor::_run(phase_t phase) {
+	_phase = phase;
+
+	std::vector <ThreadObj *> objs;
+	for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+	int rc = 0;
+	if (_nthreads <= 1) {
+		objs[0]->RunThread();
+	}
+	else {
+		rc = _et.ParRun(RunIsolineExtractorThread, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+	for (int t=0; t<_nthreads; t++) delete objs[t];
+
+	return(rc < 0 ? -1 : 0);
+}
+
+void IsolineExtractor::ThreadObj::RunThread() {
+
+	int nthreads = _ex->_nthreads;
+
+	switch (_ex->_phase) {
+	case SAMPLE:
+		for (int j = _id; j < _ex->_gridSize; j += nthreads) {
+			_ex->_sampleRow(j);
+		}
+		break;
+
+	case SEGMENTS: {
+		int nitems = _ex->_isos.size() * _ex->_nbands;
+		for (int item = _id; item < nitems; item += nthreads) {
+			_ex->_bandSegments(
+				_ex->_isos[item / _ex->_nbands], item % _ex->_nbands
+			);
+		}
+		break;
+	}
+
+	case CURVES:
+		for (int iso = _id; iso < _ex->_isos.size(); iso += nthreads) {
+			_ex->_stitch(_ex->_isos[iso], _ex->_edgeSegs[_id]);
+		}
+		break;
+	}
+}
+
+void IsolineExtractor::_sampleRow(int j) {
+	float *row = &_values[(size_t) j * _gridSize];
+
+	for (int i=0; i<_gridSize; i++) {
+		double p[3];
+		bool inside = true;
+		for (int k=0; k<3; k++) {
+			p[k] = _origin[k] + i * _du[k] + j * _dv[k];
+			if (p[k] < _bounds[k] || p[k] > _bounds[k+3]) inside = false;
+		}
+		row[i] = inside ? _rg->GetValue(p[0], p[1], p[2]) : _mv;
+	}
+}
+
+//
+// Find the segments of the cells of a band of rows. Horizontal edge (i,j),
+// from sample (i,j) to (i+1,j), has index j*(gridSize-1)+i. Vertical
+// edge (i,j), from sample (i,j) to (i,j+1), follows the horizontal ones
+// with index gridSize*(gridSize-1) + j*gridSize+i.
+//
+void IsolineExtractor::_bandSegments(iso_t &iv, int band) const {
+	int g = _gridSize;
+	int nh = g * (g-1);
+	float isoval = iv.isoval;
+	const float *v = &_values[0];
+
+	std::vector <float> &segs = iv.bandSegs[band];
+	std::vector <int> &edges = iv.bandEdges[band];
+
+	int j1 = (band+1) * BAND;
+	if (j1 > g-1) j1 = g-1;
+
+	for (int j = band * BAND; j < j1; j++) {
+		const float *r0 = v + (size_t) j * g;
+		const float *r1 = r0 + g;
+
+		for (int i=0; i<g-1; i++) {
+			float v0 = r0[i];
+			float v1 = r0[i+1];
+			float v2 = r1[i+1];
+			float v3 = r1[i];
+			if (v0 == _mv || v1 == _mv || v2 == _mv || v3 == _mv) continue;
+
+			bool a0 = v0 >= isoval;
+			bool a1 = v1 >= isoval;
+			bool a2 = v2 >= isoval;
+			bool a3 = v3 >= isoval;
+			int code = (a0 != a1) | (a1 != a2) << 1 | (a2 != a3) << 2 |
+				(a3 != a0) << 3;
+			if (! code) continue;
+
+			const int (*cellSegs)[2] = SegEdges[code];
+			int n = NumSegs[code];
+			if (code == 15) {
+				float avg = 0.25 * (v0 + v3 + v2 + v1);
+				if ((v0 < isoval && avg < isoval) || (v0 > isoval && avg > isoval)) {
+					cellSegs = SaddleSame;
+				}
+				else {
+					cellSegs = SaddleOther;
+				}
+			}
+
+			for (int s=0; s<n; s++) {
+				for (int e=0; e<2; e++) {
+					switch (cellSegs[s][e]) {
+					case 0:
+						segs.push_back(interp(i, g, isoval, v0, v1));
+						segs.push_back(coord(j, g));
+						edges.push_back(j*(g-1) + i);
+						break;
+					case 1:
+						segs.push_back(coord(i+1, g));
+						segs.push_back(interp(j, g, isoval, v1, v2));
+						edges.push_back(nh + j*g + i+1);
+						break;
+					case 2:
+						segs.push_back(interp(i, g, isoval, v3, v2));
+						segs.push_back(coord(j+1, g));
+						edges.push_back((j+1)*(g-1) + i);
+						break;
+					case 3:
+						segs.push_back(coord(i, g));
+						segs.push_back(interp(j, g, isoval, v0, v3));
+						edges.push_back(nh + j*g + i);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+//
+// Stitch the segments of an isovalue into curves. Slots 2e and 2e+1 of
+// edgeSegs hold the (at most two) segments ending on edge e. The table
+// is left cleared.
+//
+void IsolineExtractor::_stitch(iso_t &iv, std::vector <int> &edgeSegs) const {
+	int nsegs = iv.edges.size() / 2;
+	const int *edges = nsegs ? &iv.edges[0] : NULL;
+
+	for (int s=0; s<nsegs; s++) {
+		for (int e=0; e<2; e++) {
+			int slot = 2 * edges[2*s+e];
+			if (edgeSegs[slot] >= 0) slot++;
+			assert(edgeSegs[slot] < 0);
+			edgeSegs[slot] = s;
+		}
+	}
+
+	iv.csegs.clear();
+	iv.cstart.clear();
+	iv.csegs.reserve(nsegs);
+	iv.cstart.push_back(0);
+
+	std::vector <unsigned char> visited(nsegs, 0);
+	for (int s=0; s<nsegs; s++) {
+		if (visited[s]) continue;
+
+		//
+		// Walk back to an end of the curve, or around a closed one to s
+		//
+		int cur = s;
+		int entry = edges[2*s];
+		while (1) {
+			int other = edgeSegs[2*entry] == cur ?
+				edgeSegs[2*entry+1] : edgeSegs[2*entry];
+			if (other < 0 || other == s) break;
+			entry = edges[2*other] == entry ? edges[2*other+1] : edges[2*other];
+			cur = other;
+		}
+
+		//
+		// Walk forward, collecting the segments
+		//
+		while (1) {
+			iv.csegs.push_back(cur);
+			visited[cur] = 1;
+
+			int exit = edges[2*cur] == entry ? edges[2*cur+1] : edges[2*cur];
+			int next = edgeSegs[2*exit] == cur ?
+				edgeSegs[2*exit+1] : edgeSegs[2*exit];
+			if (next < 0 || visited[next]) break;
+			entry = exit;
+			cur = next;
+		}
+		iv.cstart.push_back(iv.csegs.size());
+	}
+
+	for (int s=0; s<nsegs; s++) {
+		edgeSegs[2*edges[2*s]] = edgeSegs[2*edges[2*s]+1] = -1;
+		edgeSegs[2*edges[2*s+1]] = edgeSegs[2*edges[2*s+1]+1] = -1;
+	}
+}
@@ -0,0 +1,176 @@
+//-- IsolineExtractor.h ------------------------------------------------------
+//
+// Isoline extraction from a plane sampled through a RegularGrid, on the
+// CPU. No OpenGL calls are made.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _IsolineExtractor_h_
+#define _IsolineExtractor_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class IsolineExtractor
+//! \brief Extracts isolines from a plane with marching squares
+//!
+//! The plane is a square array of \a gridSize x \a gridSize samples. Its
+//! coordinates range from -1 to 1 along both axes, sample (i,j) being at
+//! (-1 + 2i/(gridSize-1), -1 + 2j/(gridSize-1)). The plane is either
+//! sampled from a grid with SamplePlane(), rows being spread over
+//! threads, or given with SetPlane().
+//!
+//! Extract() classifies the cells of the plane for every isovalue, the
+//! work being split into bands of rows that are spread over threads, and
+//! optionally stitches the segments into curves. Each cell edge has a
+//! slot in a flat table, indexed by the edge's position in the plane, so
+//! the segments sharing an edge are found without searching.
+//!
+//! Cells with a missing value at a corner hold no segments. Cells whose
+//! four edges are crossed are disambiguated with the average of their
+//! corner values. The segments of an isovalue are in the same order
+//! whatever the number of threads.
+//
+class RENDER_API IsolineExtractor : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ IsolineExtractor(int nthreads = 0);
+ virtual ~IsolineExtractor() {}
+
+ //! Sample a plane from a grid
+ //!
+ //! Sample (i,j) is the value of \p rg at \p origin + i * \p du +
+ //! j * \p dv, in user coordinates. Samples outside of \p bounds, and
+ //! missing values of the grid, are set to the grid's missing value.
+ //!
+ //! \param[in] bounds Box, in user coordinates, samples must lie in
+ //!
+ //! \retval status A negative int is returned if \p gridSize is less
+ //! than two
+ //
+ int SamplePlane(
+	const RegularGrid *rg, int gridSize, const double origin[3],
+	const double du[3], const double dv[3], const double bounds[6]
+ );
+
+ //! Set the plane's samples
+ //!
+ //! \param[in] values \p gridSize x \p gridSize values, the first index
+ //! varying fastest. The values are copied.
+ //! \param[in] missingValue Value of missing samples
+ //
+ int SetPlane(const float *values, int gridSize, float missingValue);
+
+ //! Return the plane's samples, as set by SamplePlane() or SetPlane()
+ //
+ const float *GetPlane() const {
+	return(_values.size() ? &_values[0] : NULL);
+ }
+ int GetGridSize() const { return(_gridSize); }
+
+ //! Extract isolines
+ //!
+ //! \param[in] isovalues Isovalues
+ //! \param[in] curves If true the segments of each isovalue are
+ //! stitched into curves
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Extract(const std::vector <double> &isovalues, bool curves);
+
+ //! Return the segments of isovalue \p iso, four floats (x1, y1, x2, y2)
+ //! in plane coordinates per segment
+ //
+ const std::vector <float> &GetSegments(int iso) const {
+	return(_isos[iso].segs);
+ }
+
+ //! Return the number of curves of isovalue \p iso found by the last
+ //! call to Extract() with \a curves true
+ //
+ int GetNumCurves(int iso) const {
+	return(_isos[iso].cstart.size() ? _isos[iso].cstart.size() - 1 : 0);
+ }
+
+ //! Return the segments of curve \p c of isovalue \p iso, as indices in
+ //! GetSegments(), in the order they are connected. Consecutive segments
+ //! share an end point, but the end points of a segment need not be
+ //! listed in the direction of the curve. Closed curves start at an
+ //! arbitrary segment.
+ //!
+ //! \param[out] n Number of segments of the curve
+ //
+ const int *GetCurve(int iso, int c, int *n) const {
+	const iso_t &iv = _isos[iso];
+	*n = iv.cstart[c+1] - iv.cstart[c];
+	return(&iv.csegs[iv.cstart[c]]);
+ }
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(IsolineExtractor *ex, int id) : _ex(ex), _id(id) {}
+	void RunThread();
+ private:
+	IsolineExtractor *_ex;
+	int _id;	// thread id
+ };
+
+private:
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+
+ std::vector <float> _values;
+ int _gridSize;
+ float _mv;
+
+ //
+ // Plane sampling
+ //
+ const RegularGrid *_rg;
+ double _origin[3];
+ double _du[3];
+ double _dv[3];
+ double _bounds[6];
+
+ //
+ // Per isovalue results. Segments are found in bands of rows, then
+ // joined in band order.
+ //
+ typedef struct {
+	float isoval;
+	std::vector <std::vector <float> > bandSegs;
+	std::vector <std::vector <int> > bandEdges;
+	std::vector <float> segs;
+	std::vector <int> edges;		// two edge indices per segment
+	std::vector <int> csegs;		// segments of the curves
+	std::vector <int> cstart;		// first entry in csegs of each curve
+ } iso_t;
+
+ enum phase_t {SAMPLE, SEGMENTS, CURVES};
+ phase_t _phase;
+ std::vector <iso_t> _isos;
+ int _nbands;
+ std::vector <std::vector <int> > _edgeSegs;	// stitching table per thread
+
+ int _run(phase_t phase);
+ void _sampleRow(int j);
+ void _bandSegments(iso_t &iv, int band) const;
+ void _stitch(iso_t &iv, std::vector <int> &edgeSegs) const;
+
+ int _numEdges() const { return(2 * _gridSize * (_gridSize-1)); }
+};
+
+};
+
+#endif	// _IsolineExtractor_h_
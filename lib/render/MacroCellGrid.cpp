@@ -0,0 +1,360 @@
+//-- MacroCellGrid.cpp -------------------------------------------------------
+//
+// Min-max macrocells of a RegularGrid, for empty space skipping
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4244 4251 4267 4100 4996)
+#endif
+
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <vapor/CFuncs.h>
+#include "MacroCellGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunMacroCellGridThread(void *object) {
+		MacroCellGrid::ThreadObj *X = (MacroCellGrid::ThreadObj *) object;
+		X->RunThread();
+		return(0);
+	}
+};
+
+MacroCellGrid::MacroCellGrid(int cellDim, int nthreads) : _et(nthreads) {
+	_nthreads = _et.GetNumThreads();
+	if (_nthreads < 1) _nthreads = 1;
+	_cellDim = cellDim < 1 ? 1 : cellDim;
+
+	_rg = NULL;
+	_range[0] = 0.0;
+	_range[1] = 1.0;
+	for (int i=0; i<3; i++) _dims[i] = _cdims[i] = 0;
+	_noccupied = 0;
+	_buildTime = 0.0;
+
+	_mode = ALL;
+	for (int i=0; i<257; i++) _opaque[i] = i;
+}
+
+int MacroCellGrid::Build(const RegularGrid *rg, const float range[2]) {
+	double t0 = GetTime();
+
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	for (int i=0; i<3; i++) {
+		if (dims[i] < 1) {
+			SetErrMsg("Invalid grid dimensions");
+			return(-1);
+		}
+		_dims[i] = dims[i];
+		_cdims[i] = dims[i] < 2 ? 1 : (dims[i] - 2) / _cellDim + 1;
+	}
+	_range[0] = range[0];
+	_range[1] = range[1];
+
+	size_t bs[3] = {_cellDim, _cellDim, _cellDim};
+	size_t bmin[3] = {0, 0, 0};
+	_summary.Init(bs, bmin, _cdims);
+
+	_rg = rg;
+	std::vector <ThreadObj *> objs;
+	for (int t=0; t<_nthreads; t++) objs.push_back(new ThreadObj(this, t));
+
+	int rc = 0;
+	if (_nthreads <= 1) {
+		objs[0]->RunThread();
+	}
+	else {
+		rc = _et.ParRun(RunMacroCellGridThread, (void **) &objs[0]);
+		if (rc < 0) SetErrMsg("Error spawning threads");
+	}
+	for (int t=0; t<_nthreads; t++) delete objs[t];
+	_rg = NULL;
+
+	if (rc < 0) {
+		Clear();
+		return(-1);
+	}
+
+	_classify();
+
+	_buildTime = GetTime() - t0;
+	return(0);
+}
+
+void MacroCellGrid::Clear() {
+	for (int i=0; i<3; i++) _dims[i] = _cdims[i] = 0;
+	size_t bs[3] = {_cellDim, _cellDim, _cellDim};
+	size_t zero[3] = {0, 0, 0};
+	_summary.Init(bs, zero, zero);
+	_empty.clear();
+	_noccupied = 0;
+}
+
+void MacroCellGrid::ThreadObj::RunThread() {
+	std::vector <float> values(_mg->_dims[0]);
+
+	for (size_t ck = _id; ck < _mg->_cdims[2]; ck += _mg->_nthreads) {
+		_mg->_buildSlab(ck, values);
+	}
+}
+
+//
+// Compute the statistics of the macrocells of slab ck. A grid line on
+// the boundary between two macrocells contributes to both.
+//
+void MacroCellGrid::_buildSlab(size_t ck, std::vector <float> &values) {
+	size_t cd = _cellDim;
+	bool missing = _rg->HasMissingData();
+	float mv = _rg->GetMissingValue();
+
+	size_t nslab = _cdims[0] * _cdims[1];
+	std::vector <float> cmin(nslab, FLT_MAX);
+	std::vector <float> cmax(nslab, -FLT_MAX);
+	std::vector <double> csum(nslab, 0.0);
+	std::vector <size_t> ccount(nslab, 0);
+
+	size_t k0 = ck * cd;
+	size_t k1 = (ck+1) * cd < _dims[2] ? (ck+1) * cd : _dims[2] - 1;
+
+	for (size_t k = k0; k <= k1; k++) {
+	for (size_t j = 0; j < _dims[1]; j++) {
+		_readLine(j, k, &values[0]);
+
+		size_t cjhi = j / cd;
+		size_t cjlo = (j % cd == 0 && j > 0) ? cjhi - 1 : cjhi;
+		if (cjhi >= _cdims[1]) cjhi = _cdims[1] - 1;
+		if (cjlo >= _cdims[1]) cjlo = _cdims[1] - 1;
+
+		for (size_t ci = 0; ci < _cdims[0]; ci++) {
+			size_t i0 = ci * cd;
+			size_t i1 = (ci+1) * cd < _dims[0] ? (ci+1) * cd : _dims[0] - 1;
+
+			float vmin = FLT_MAX;
+			float vmax = -FLT_MAX;
+			double sum = 0.0;
+			size_t count = 0;
+			for (size_t i = i0; i <= i1; i++) {
+				float v = values[i];
+				if ((missing && v == mv) || v != v) continue;
+				vmin = v < vmin ? v : vmin;
+				vmax = v > vmax ? v : vmax;
+				sum += v;
+				count++;
+			}
+
+			for (size_t cj = cjlo; cj <= cjhi; cj++) {
+				size_t c = cj*_cdims[0] + ci;
+				if (vmin < cmin[c]) cmin[c] = vmin;
+				if (vmax > cmax[c]) cmax[c] = vmax;
+				csum[c] += sum;
+				ccount[c] += count;
+			}
+		}
+	}
+	}
+
+	//
+	// The slabs are distinct blocks of the summary, which may be set
+	// concurrently
+	//
+	for (size_t cj = 0; cj < _cdims[1]; cj++) {
+	for (size_t ci = 0; ci < _cdims[0]; ci++) {
+		size_t c = cj*_cdims[0] + ci;
+		size_t bcoord[3] = {ci, cj, ck};
+		float mean = ccount[c] ? csum[c] / ccount[c] : 0.0;
+		_summary.SetBlock(bcoord, cmin[c], cmax[c], mean, ccount[c]);
+	}
+	}
+}
+
+//
+// Read a line of grid values, a block-contiguous run at a time
+//
+void MacroCellGrid::_readLine(size_t j, size_t k, float *values) const {
+
+	size_t origin[3], bs[3];
+	_rg->GetIJKOrigin(origin);
+	_rg->GetBlockSize(bs);
+	float **blks = _rg->GetBlks();
+
+	if (! blks) {
+		float mv = _rg->GetMissingValue();
+		for (size_t i = 0; i < _dims[0]; i++) values[i] = mv;
+		return;
+	}
+
+	//
+	// The grid's first block starts goff voxels before the grid origin
+	//
+	size_t goff[3], gbdim[3];
+	for (int i=0; i<3; i++) {
+		goff[i] = origin[i] % bs[i];
+		gbdim[i] = (goff[i] + _dims[i] - 1) / bs[i] + 1;
+	}
+
+	size_t gbz = (k + goff[2]) / bs[2];
+	size_t zoff = (k + goff[2]) % bs[2];
+	size_t gby = (j + goff[1]) / bs[1];
+	size_t yoff = (j + goff[1]) % bs[1];
+
+	size_t i = 0;
+	while (i < _dims[0]) {
+		size_t xx = i + goff[0];
+		size_t gbx = xx / bs[0];
+		size_t xoff = xx % bs[0];
+
+		size_t n = bs[0] - xoff;
+		if (n > _dims[0] - i) n = _dims[0] - i;
+
+		const float *line = blks[(gbz*gbdim[1] + gby)*gbdim[0] + gbx] +
+			(zoff*bs[1] + yoff)*bs[0] + xoff;
+
+		memcpy(values + i, line, n * sizeof(values[0]));
+		i += n;
+	}
+}
+
+void MacroCellGrid::Classify(const float atab[256][4]) {
+	_mode = OPACITY;
+	_opaque[0] = 0;
+	for (int i=0; i<256; i++) {
+		_opaque[i+1] = _opaque[i] + (atab[i][3] > 0.0 ? 1 : 0);
+	}
+	_classify();
+}
+
+void MacroCellGrid::ClassifyIso(const float *isovalues, int n) {
+	_mode = ISO;
+	_isovalues.assign(isovalues, isovalues + n);
+	_classify();
+}
+
+void MacroCellGrid::ClassifyAll() {
+	_mode = ALL;
+	_classify();
+}
+
+//
+// Return the range of a macrocell normalized as a texture brick does, or
+// false if its values are all missing
+//
+bool MacroCellGrid::_normRange(
+	size_t ci, size_t cj, size_t ck, float range[2]
+) const {
+	size_t bcoord[3] = {ci, cj, ck};
+	float r[2], mean;
+	size_t count;
+	if (! _summary.GetBlock(bcoord, r, &mean, &count)) return(false);
+
+	float d = _range[1] - _range[0];
+	for (int i=0; i<2; i++) {
+		float v = d != 0.0 ? (r[i] - _range[0]) / d : 0.0;
+		range[i] = v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+	}
+	return(true);
+}
+
+void MacroCellGrid::_classify() {
+	size_t ncells = _cdims[0] * _cdims[1] * _cdims[2];
+	_empty.resize(ncells);
+	_noccupied = 0;
+
+	//
+	// Margin covering the quantization of the values into 8 bit texels
+	//
+	const float eps = 1.5 / 255.0;
+
+	size_t c = 0;
+	for (size_t ck=0; ck<_cdims[2]; ck++) {
+	for (size_t cj=0; cj<_cdims[1]; cj++) {
+	for (size_t ci=0; ci<_cdims[0]; ci++, c++) {
+		float cr[2];
+		bool empty = ! _normRange(ci, cj, ck, cr);	// all missing
+
+		if (! empty && _mode == OPACITY) {
+
+			//
+			// Entries that may be used by the linear or pre-integrated
+			// lookup of the macrocell's values, with a margin of one entry
+			//
+			int lo = (int) floor(cr[0] * 256.0 - 1.5);
+			int hi = (int) ceil(cr[1] * 256.0 + 1.0);
+			if (lo < 0) lo = 0;
+			if (hi > 255) hi = 255;
+			empty = _opaque[hi+1] - _opaque[lo] == 0;
+		}
+		else if (! empty && _mode == ISO) {
+			empty = true;
+			for (int i=0; i<_isovalues.size(); i++) {
+				if (_isovalues[i] >= cr[0] - eps &&
+					_isovalues[i] <= cr[1] + eps) {
+
+					empty = false;
+					break;
+				}
+			}
+		}
+		_empty[c] = empty;
+		if (! empty) _noccupied++;
+	}
+	}
+	}
+}
+
+bool MacroCellGrid::GetOccupiedBox(
+	const size_t min[3], const size_t max[3], size_t omin[3], size_t omax[3]
+) const {
+	if (! IsBuilt()) {
+		for (int i=0; i<3; i++) {
+			omin[i] = min[i];
+			omax[i] = max[i];
+		}
+		return(true);
+	}
+
+	//
+	// Macrocells intersecting the box
+	//
+	size_t c0[3], c1[3];
+	for (int i=0; i<3; i++) {
+		c0[i] = min[i] / _cellDim;
+		c1[i] = max[i] > min[i] ? (max[i] - 1) / _cellDim : c0[i];
+		if (c0[i] >= _cdims[i]) c0[i] = _cdims[i] - 1;
+		if (c1[i] >= _cdims[i]) c1[i] = _cdims[i] - 1;
+	}
+
+	bool occupied = false;
+	size_t b0[3], b1[3];	// bounds of the non-empty macrocells
+	for (size_t ck = c0[2]; ck <= c1[2]; ck++) {
+	for (size_t cj = c0[1]; cj <= c1[1]; cj++) {
+	for (size_t ci = c0[0]; ci <= c1[0]; ci++) {
+		if (IsEmpty(ci, cj, ck)) continue;
+
+		size_t cell[3] = {ci, cj, ck};
+		for (int i=0; i<3; i++) {
+			if (! occupied || cell[i] < b0[i]) b0[i] = cell[i];
+			if (! occupied || cell[i] > b1[i]) b1[i] = cell[i];
+		}
+		occupied = true;
+	}
+	}
+	}
+	if (! occupied) return(false);
+
+	for (int i=0; i<3; i++) {
+		omin[i] = b0[i] * _cellDim;
+		omax[i] = (b1[i] + 1) * _cellDim;
+		if (omin[i] < min[i]) omin[i] = min[i];
+		if (omax[i] > max[i]) omax[i] = max[i];
+	}
+	return(true);
+}
@@ -0,0 +1,175 @@
+//-- MacroCellGrid.h ---------------------------------------------------------
+//
+// Coarse min-max grid over a RegularGrid, classified against a transfer
+// function, used by the volume renderers to skip transparent space. No
+// OpenGL calls are made.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _MacroCellGrid_h_
+#define _MacroCellGrid_h_
+
+#include <vector>
+#include <vapor/MyBase.h>
+#include <vapor/EasyThreads.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/BlockSummary.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class MacroCellGrid
+//! \brief Finds the parts of a volume a transfer function makes visible
+//!
+//! The volume is divided into macrocells of \a cellDim x \a cellDim x
+//! \a cellDim voxel intervals. Macrocell (i,j,k) covers the grid points
+//! from (i,j,k) * \a cellDim to (i+1,j+1,k+1) * \a cellDim, inclusive, so
+//! that neighboring macrocells share a face, and the samples interpolated
+//! inside a macrocell lie between its minimum and maximum values.
+//! Missing values are ignored.
+//!
+//! Build() computes the minimum and maximum of every macrocell, slabs of
+//! macrocells being spread over threads, and records them in a
+//! BlockSummary whose block (i,j,k) is macrocell (i,j,k). As the
+//! macrocells overlap, the ranges the summary returns for a region
+//! remain conservative. For classification the values are normalized
+//! to the data range the volume is rendered with, as in a texture
+//! brick. The macrocells are then
+//! classified, either against an opacity map, or against isovalues,
+//! which is cheap enough to be done whenever the map changes. A macrocell
+//! is empty if none of the opacity map entries its values may be looked
+//! up in is opaque, or if it contains none of the isovalues. The
+//! classification is kept when the grid is rebuilt.
+//
+class RENDER_API MacroCellGrid : public VetsUtil::MyBase {
+public:
+
+ //! \param[in] cellDim Number of voxel intervals along each axis of a
+ //! macrocell
+ //! \param[in] nthreads Number of execution threads. If less than
+ //! one the number of available processors is used.
+ //
+ MacroCellGrid(int cellDim = 8, int nthreads = 0);
+ virtual ~MacroCellGrid() {}
+
+ //! Compute the macrocells of a grid
+ //!
+ //! \param[in] rg Grid
+ //! \param[in] range Data range mapped to [0,1]
+ //!
+ //! \retval status A negative int is returned on failure
+ //
+ int Build(const RegularGrid *rg, const float range[2]);
+
+ //! Forget the macrocells. IsBuilt() returns false until the next call
+ //! to Build().
+ //
+ void Clear();
+
+ bool IsBuilt() const { return(_empty.size() != 0); }
+
+ //! Return the minimum, maximum and mean of the macrocells, in data
+ //! units. Block coordinates are relative to the grid origin.
+ //
+ const BlockSummary &GetSummary() const { return(_summary); }
+
+ //! Classify the macrocells against an opacity map
+ //!
+ //! \param[in] atab Transfer function table, whose fourth component is
+ //! the opacity of the values mapped to the entry
+ //
+ void Classify(const float atab[256][4]);
+
+ //! Classify the macrocells against isovalues
+ //!
+ //! \param[in] isovalues Isovalues, normalized like the grid values
+ //! \param[in] n Number of isovalues
+ //
+ void ClassifyIso(const float *isovalues, int n);
+
+ //! Make every macrocell that has a value not missing non-empty
+ //
+ void ClassifyAll();
+
+ //! Return the number of macrocells along each axis
+ //
+ void GetDimensions(size_t dims[3]) const {
+	for (int i=0; i<3; i++) dims[i] = _cdims[i];
+ }
+
+ int GetCellDim() const { return((int) _cellDim); }
+
+ //! Return true if macrocell (i,j,k) is empty
+ //
+ bool IsEmpty(size_t i, size_t j, size_t k) const {
+	return(_empty[(k*_cdims[1] + j)*_cdims[0] + i] != 0);
+ }
+
+ //! Return the number of macrocells that aren't empty
+ //
+ size_t GetNumOccupied() const { return(_noccupied); }
+
+ //! Find the visible part of a box of grid points
+ //!
+ //! \param[in] min Minimum grid point of the box
+ //! \param[in] max Maximum grid point of the box
+ //! \param[out] omin Minimum grid point of the smallest box, within
+ //! \p min and \p max, containing the parts of the non-empty macrocells
+ //! that are inside the box
+ //! \param[out] omax Maximum grid point of that box
+ //!
+ //! \retval occupied False if every macrocell intersecting the box is
+ //! empty, in which case \p omin and \p omax are undefined. True if the
+ //! grid hasn't been built.
+ //
+ bool GetOccupiedBox(
+	const size_t min[3], const size_t max[3], size_t omin[3], size_t omax[3]
+ ) const;
+
+ //! Return the time, in seconds, taken by the last call to Build()
+ //
+ double GetBuildTime() const { return(_buildTime); }
+
+ int GetNumThreads() const { return(_nthreads); }
+
+ class ThreadObj {
+ public:
+	ThreadObj(MacroCellGrid *mg, int id) : _mg(mg), _id(id) {}
+	void RunThread();
+ private:
+	MacroCellGrid *_mg;
+	int _id;	// thread id
+ };
+
+private:
+ VetsUtil::EasyThreads _et;
+ int _nthreads;
+ size_t _cellDim;
+
+ const RegularGrid *_rg;
+ float _range[2];
+ size_t _dims[3];
+ size_t _cdims[3];
+ BlockSummary _summary;			// range of each macrocell
+ std::vector <unsigned char> _empty;
+ size_t _noccupied;
+ double _buildTime;
+
+ //
+ // Current classification
+ //
+ enum mode_t {ALL, OPACITY, ISO};
+ mode_t _mode;
+ int _opaque[257];		// number of opaque entries below each entry
+ std::vector <float> _isovalues;
+
+ void _buildSlab(size_t ck, std::vector <float> &values);
+ bool _normRange(size_t ci, size_t cj, size_t ck, float range[2]) const;
+ void _readLine(size_t j, size_t k, float *values) const;
+ void _classify();
+};
+
+};
+
+#endif	// _MacroCellGrid_h_
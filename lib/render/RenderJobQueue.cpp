@@ -0,0 +1,265 @@
+//-- RenderJobQueue.cpp ------------------------------------------------------
+//
+// Preparation of render data on worker threads
+//
+//----------------------------------------------------------------------------
+
+#ifdef WIN32
+#pragma warning(disable : 4251 4100)
+#endif
+
+#include <algorithm>
+#include <vapor/EasyThreads.h>
+#include "RenderJobQueue.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+RenderJobQueue *RenderJobQueue::_instance = NULL;
+
+#ifndef WIN32
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunRenderJobWorker(void *object) {
+		RenderJobQueue *queue = (RenderJobQueue *) object;
+		queue->RunWorker();
+		return(0);
+	}
+};
+#endif
+
+RenderJobQueue::RenderJobQueue(int nthreads) {
+	SetClassName("RenderJobQueue");
+
+	_nthreads = nthreads < 1 ? EasyThreads::NProc() : nthreads;
+	if (_nthreads < 1) _nthreads = 1;
+	_shutdown = false;
+
+#ifndef WIN32
+	pthread_mutex_init(&_lock, 0);
+	pthread_cond_init(&_changed, 0);
+	for (int t=0; t<_nthreads; t++) {
+		pthread_t worker;
+		if (pthread_create(&worker, 0, RunRenderJobWorker, this) != 0) break;
+		_workers.push_back(worker);
+	}
+	_nthreads = _workers.size();
+#else
+	_nthreads = 0;
+#endif
+}
+
+RenderJobQueue::~RenderJobQueue() {
+
+#ifndef WIN32
+	pthread_mutex_lock(&_lock);
+	_shutdown = true;
+	std::map <const void *, client_t>::iterator itr;
+	for (itr = _clients.begin(); itr != _clients.end(); ++itr) {
+		if (itr->second.running) itr->second.running->_cancelled = true;
+	}
+	pthread_cond_broadcast(&_changed);
+	pthread_mutex_unlock(&_lock);
+
+	for (int t=0; t<_workers.size(); t++) pthread_join(_workers[t], 0);
+
+	pthread_cond_destroy(&_changed);
+	pthread_mutex_destroy(&_lock);
+#endif
+
+	std::map <const void *, client_t>::iterator itr1;
+	for (itr1 = _clients.begin(); itr1 != _clients.end(); ++itr1) {
+		if (itr1->second.waiting) delete itr1->second.waiting;
+		if (itr1->second.completed) delete itr1->second.completed;
+	}
+	_clients.clear();
+
+	if (_instance == this) _instance = NULL;
+}
+
+RenderJobQueue *RenderJobQueue::GetInstance() {
+	if (! _instance) _instance = new RenderJobQueue();
+	return(_instance);
+}
+
+RenderJobQueue::client_t &RenderJobQueue::_client(const void *client) {
+	std::map <const void *, client_t>::iterator itr = _clients.find(client);
+	if (itr != _clients.end()) return(itr->second);
+
+	client_t &c = _clients[client];
+	c.waiting = c.running = c.completed = NULL;
+	c.callback = NULL;
+	c.clientData = NULL;
+	return(c);
+}
+
+//
+// Make a job the client's completed job, replacing the one not taken
+//
+void RenderJobQueue::_complete(client_t &c, RenderJob *job) {
+	if (c.completed) delete c.completed;
+	c.completed = job;
+}
+
+void RenderJobQueue::Submit(
+	const void *client, RenderJob *job, Callback_T callback, void *clientData
+) {
+	job->_cancelled = false;
+
+	if (! _nthreads) {
+		client_t &c = _client(client);
+		job->_status = job->Run();
+		_complete(c, job);
+		return;
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&_lock);
+
+	client_t &c = _client(client);
+	c.callback = callback;
+	c.clientData = clientData;
+
+	if (c.waiting) {
+		delete c.waiting;
+	}
+	else if (! c.running) {
+		_queue.push_back(client);
+		pthread_cond_broadcast(&_changed);
+	}
+	c.waiting = job;
+	if (c.running) c.running->_cancelled = true;
+
+	pthread_mutex_unlock(&_lock);
+#endif
+}
+
+RenderJob *RenderJobQueue::TakeCompleted(const void *client) {
+#ifndef WIN32
+	if (_nthreads) pthread_mutex_lock(&_lock);
+#endif
+
+	client_t &c = _client(client);
+	RenderJob *job = c.completed;
+	c.completed = NULL;
+
+#ifndef WIN32
+	if (_nthreads) pthread_mutex_unlock(&_lock);
+#endif
+	return(job);
+}
+
+bool RenderJobQueue::IsBusy(const void *client) {
+	if (! _nthreads) return(false);
+
+	bool busy = false;
+#ifndef WIN32
+	pthread_mutex_lock(&_lock);
+	client_t &c = _client(client);
+	busy = c.waiting || c.running;
+	pthread_mutex_unlock(&_lock);
+#endif
+	return(busy);
+}
+
+void RenderJobQueue::Wait(const void *client) {
+	if (! _nthreads) return;
+
+#ifndef WIN32
+	pthread_mutex_lock(&_lock);
+	client_t &c = _client(client);
+	while (c.waiting || c.running) pthread_cond_wait(&_changed, &_lock);
+	pthread_mutex_unlock(&_lock);
+#endif
+}
+
+void RenderJobQueue::Cancel(const void *client) {
+#ifndef WIN32
+	if (_nthreads) pthread_mutex_lock(&_lock);
+#endif
+
+	client_t &c = _client(client);
+	if (c.waiting) {
+		delete c.waiting;
+		c.waiting = NULL;
+		_queue.erase(
+			std::remove(_queue.begin(), _queue.end(), client), _queue.end()
+		);
+	}
+	if (c.running) c.running->_cancelled = true;
+	if (c.completed) {
+		delete c.completed;
+		c.completed = NULL;
+	}
+
+#ifndef WIN32
+	if (_nthreads) pthread_mutex_unlock(&_lock);
+#endif
+}
+
+void RenderJobQueue::Remove(const void *client) {
+	Cancel(client);
+
+#ifndef WIN32
+	if (_nthreads) {
+		pthread_mutex_lock(&_lock);
+		client_t &c = _client(client);
+		while (c.running) pthread_cond_wait(&_changed, &_lock);
+
+		// A job submitted meanwhile is dropped too
+		//
+		if (c.waiting) delete c.waiting;
+		if (c.completed) delete c.completed;
+		_queue.erase(
+			std::remove(_queue.begin(), _queue.end(), client), _queue.end()
+		);
+		_clients.erase(client);
+		pthread_mutex_unlock(&_lock);
+		return;
+	}
+#endif
+	_clients.erase(client);
+}
+
+#ifndef WIN32
+void RenderJobQueue::RunWorker() {
+
+	pthread_mutex_lock(&_lock);
+	while (1) {
+		while (! _shutdown && _queue.empty()) {
+			pthread_cond_wait(&_changed, &_lock);
+		}
+		if (_shutdown) break;
+
+		const void *client = _queue.front();
+		_queue.pop_front();
+		client_t &c = _clients[client];
+		RenderJob *job = c.waiting;
+		c.waiting = NULL;
+		c.running = job;
+
+		pthread_mutex_unlock(&_lock);
+		int status = job->Run();
+		pthread_mutex_lock(&_lock);
+
+		//
+		// The client can't have been removed: Remove() waits for the
+		// running job
+		//
+		job->_status = status;
+		c.running = NULL;
+		if (job->_cancelled) {
+			delete job;
+		}
+		else {
+			_complete(c, job);
+			if (c.callback) c.callback(c.clientData);
+		}
+		if (c.waiting) _queue.push_back(client);
+		pthread_cond_broadcast(&_changed);
+	}
+	pthread_mutex_unlock(&_lock);
+}
+#endif
@@ -0,0 +1,173 @@
+//-- RenderJobQueue.h --------------------------------------------------------
+//
+// Preparation of render data (reading data, computing geometry) on
+// worker threads, so that the GL thread can keep drawing while it runs.
+//
+//----------------------------------------------------------------------------
+
+#ifndef _RenderJobQueue_h_
+#define _RenderJobQueue_h_
+
+#include <map>
+#include <deque>
+#include <vector>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+#include <vapor/MyBase.h>
+#include <vapor/common.h>
+
+namespace VAPoR {
+
+//
+//! \class RenderJob
+//! \brief The preparation of the data a renderer draws
+//!
+//! A job captures everything it needs when it is created, on the GL
+//! thread, and computes its results in Run(), on a worker thread. Run()
+//! must not make OpenGL calls, nor read params the GUI may change. The
+//! results are read by the renderer once the job has completed.
+//
+class RENDER_API RenderJob {
+public:
+ RenderJob() : _cancelled(false), _status(0) {}
+ virtual ~RenderJob() {}
+
+ //! Compute the job's results
+ //!
+ //! \retval status A negative int is returned on failure, or if the job
+ //! was cancelled
+ //
+ virtual int Run() = 0;
+
+ //! Return true if the job has been cancelled, in which case its results
+ //! will be discarded. Long running jobs should poll this method and
+ //! return early.
+ //
+ bool IsCancelled() const { return(_cancelled); }
+
+ //! Return the value returned by Run()
+ //
+ int GetStatus() const { return(_status); }
+
+private:
+ friend class RenderJobQueue;
+ volatile bool _cancelled;
+ int _status;
+};
+
+//
+//! \class RenderJobQueue
+//! \brief Runs render jobs on worker threads
+//!
+//! Jobs are submitted on behalf of a client, typically a renderer. Each
+//! client has at most one job waiting to run, one job running, and one
+//! completed job waiting to be taken: submitting a job replaces the
+//! client's waiting job, and cancels its running one, so stale work is
+//! dropped as soon as the params or time step change. A client's jobs
+//! run one at a time, in the order submitted, while jobs of different
+//! clients run concurrently. A completed job is handed over whole by
+//! TakeCompleted(), so a client never sees partial results.
+//!
+//! On Windows, or if no worker thread could be started, jobs are run
+//! when submitted, and no callbacks are made.
+//
+class RENDER_API RenderJobQueue : public VetsUtil::MyBase {
+public:
+
+ //! Function called, on the worker thread, when a job of a client has
+ //! completed and was not cancelled. It is called with the queue locked,
+ //! so it must return quickly and must not call the queue.
+ //
+ typedef void (*Callback_T)(void *clientData);
+
+ //! \param[in] nthreads Number of worker threads. If less than one the
+ //! number of available processors is used.
+ //
+ RenderJobQueue(int nthreads = 0);
+
+ //! Cancel all jobs, and wait for the running ones to return
+ //
+ virtual ~RenderJobQueue();
+
+ //! Return the queue shared by the renderers
+ //
+ static RenderJobQueue *GetInstance();
+
+ //! Submit a job
+ //!
+ //! The queue takes ownership of the job. The client's waiting job, if
+ //! any, is deleted, and its running job is cancelled.
+ //!
+ //! \param[in] client Client the job is submitted for
+ //! \param[in] job Job
+ //! \param[in] callback Function called when the job has completed, or
+ //! NULL
+ //! \param[in] clientData Argument of \p callback
+ //
+ void Submit(
+	const void *client, RenderJob *job,
+	Callback_T callback = NULL, void *clientData = NULL
+ );
+
+ //! Take the client's most recently completed job
+ //!
+ //! \retval job The job, now owned by the caller, or NULL if no job has
+ //! completed since the last call
+ //
+ RenderJob *TakeCompleted(const void *client);
+
+ //! Return true if the client has a job waiting or running
+ //
+ bool IsBusy(const void *client);
+
+ //! Wait until the client has no job waiting or running
+ //
+ void Wait(const void *client);
+
+ //! Cancel the client's waiting and running jobs, and discard its
+ //! completed one
+ //
+ void Cancel(const void *client);
+
+ //! Cancel the client's jobs, wait for its running job to return, and
+ //! forget the client. Must be called before a client is destroyed.
+ //
+ void Remove(const void *client);
+
+ int GetNumThreads() const { return(_nthreads); }
+
+#ifndef WIN32
+ void RunWorker();
+#endif
+
+private:
+ typedef struct {
+	RenderJob *waiting;
+	RenderJob *running;
+	RenderJob *completed;
+	Callback_T callback;
+	void *clientData;
+ } client_t;
+
+ std::map <const void *, client_t> _clients;
+ std::deque <const void *> _queue;	// clients with a job waiting to run,
+									// and none running
+ int _nthreads;
+ bool _shutdown;
+
+ static RenderJobQueue *_instance;
+
+#ifndef WIN32
+ std::vector <pthread_t> _workers;
+ pthread_mutex_t _lock;		// protects the clients and the queue
+ pthread_cond_t _changed;	// signaled when a job is queued or completes
+#endif
+
+ client_t &_client(const void *client);
+ void _complete(client_t &c, RenderJob *job);
+};
+
+};
+
+#endif	// _RenderJobQueue_h_
@@ -46,9 +46,11 @@ TextureBrick::TextureBrick(const RegularGrid *rg, int precision, int nvars) :
   _dnz(0),
   _missing(false),
   _layered(false),
-  _nvars(nvars)
+  _nvars(nvars),
+  _dirty(false)
 
 {
+  _sources.resize(nvars);
 
   _configure(
     rg, precision, nvars,
@@ -182,6 +184,8 @@ void TextureBrick::invalidate()
   _tmax = Point3d(0,0,0);
   if (_data) delete [] _data;
   _data = NULL;
+  _texSzBytes = 0;
+  _sources.assign(_nvars, Source());
 }
 
 //----------------------------------------------------------------------------
@@ -218,6 +222,7 @@ void TextureBrick::load()
   glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
   glTexImage3D(GL_TEXTURE_3D, 0, _internalFormat,
                  _bx, _by, _bz, 0, _format, _type, _data);
+  _dirty = false;
 }
 
 //----------------------------------------------------------------------------
@@ -232,287 +237,36 @@ void TextureBrick::reload()
 
   glTexImage3D(GL_TEXTURE_3D, 0, _internalFormat,
                  _bx, _by, _bz, 0, _format, _type, _data);
+  _dirty = false;
 }
 
+//----------------------------------------------------------------------------
+// Quantize the grid values into the first component of each texel
+//----------------------------------------------------------------------------
 void TextureBrick::copytex_fast(
 	const RegularGrid *rg, unsigned char *data, const float range[2], 
 	int bx, int by, int bz, int dnx, int dny, int dnz,
 	int xoffset, int yoffset, int zoffset
 ) {
-
-  size_t dims[3];
-  rg->GetDimensions(dims);
-
-	//
-	// Copy over the data
-	//
-	float v;
-	unsigned int qv;
-	unsigned char *ucptr = data;
-	size_t step = _szcomp * _ncomp;
-
-	if (xoffset == 0 && yoffset == 0 && zoffset == 0 && 
-		dims[0]<=bx && dims[1]<=by && dims[2]<= bz
-	) {
-		// Fast copy with iterator
-
-		RegularGrid::ConstIterator itr;
-
-		if (_szcomp == 1) {
-			for (itr = rg->begin(); itr!=rg->end(); ++itr) {
-				v = *itr;
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=255;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 255);
-
-				ucptr[0] = qv;
-				ucptr+=step;
-			}
-		} else if (_szcomp == 2) {
-			for (itr = rg->begin(); itr!=rg->end(); ++itr) {
-				v = *itr;
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=65535;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 65535);
-
-				ucptr[0] = (unsigned char) (qv & 0xff);
-				ucptr[1] = (unsigned char) ((qv >> 8) & 0xff);
-
-				ucptr+=step;
-			}
-		}
-	}
-	else {
-
-		if (_szcomp == 1) {
-			for (int z=0; z<bz && z<dnz; z++) {
-			for (int y=0; y<by && y<dny; y++) {
-			ucptr = data+z*bx*by*step + y*bx*step;
-			for (int x=0; x<bx && x<dnx; x++) {
-				v = rg->AccessIJK(x+xoffset,y+yoffset,z+zoffset);
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=255;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 255);
-
-				ucptr[0] = qv;
-				ucptr += step;
-			}
-			}
-			}
-		}
-		else if (_szcomp == 2) {
-			for (int z=0; z<bz && z<dnz; z++) {
-			for (int y=0; y<by && y<dny; y++) {
-			ucptr = data+z*bx*by*step + y*bx*step;
-			for (int x=0; x<bx && x<dnx; x++) {
-				v = rg->AccessIJK(x+xoffset,y+yoffset,z+zoffset);
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=65535;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 65535);
-
-				ucptr[0] = (unsigned char) (qv & 0xff);
-				ucptr[1] = (unsigned char) ((qv >> 8) & 0xff);
-				ucptr+=step;
-			}
-			}
-			}
-		}
-	}
+  _filler.SetFormat(_szcomp, _ncomp);
+  _filler.Fill(
+    rg, range, data, bx, by, bz, dnx, dny, dnz, xoffset, yoffset, zoffset
+  );
 }
 
+//----------------------------------------------------------------------------
+// Quantize the grid values, followed by the missing data flags and the
+// layered coordinates if the brick stores them
+//----------------------------------------------------------------------------
 void TextureBrick::copytex(
 	const RegularGrid *rg, unsigned char *data, const float range[2], 
 	int bx, int by, int bz, int dnx, int dny, int dnz,
 	int xoffset, int yoffset, int zoffset
 ) {
-
-  size_t dims[3];
-  rg->GetDimensions(dims);
-
-	//
-	// Copy over the data
-	//
-	float v;
-	unsigned int qv;
-	unsigned char *ucptr = data;
-	size_t step = _szcomp * _ncomp;
-	double x_f, y_f, z_f;
-
-	double extents[6];
-	rg->GetUserExtents(extents);
-	float mv = 0;
-	if (_missing) mv = rg->GetMissingValue();
-
-	if (xoffset == 0 && yoffset == 0 && zoffset == 0 && 
-		dims[0]<=bx && dims[1]<=by && dims[2]<= bz
-	) {
-		size_t x = 0;
-		size_t y = 0;
-		size_t z = 0;
-    
-		// Fast copy with iterator
-
-		RegularGrid::ConstIterator itr;
-
-		if (_szcomp == 1) {
-			for (itr = rg->begin(); itr!=rg->end(); ++itr) {
-				v = *itr;
-				int c = 0;
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=255;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 255);
-
-				ucptr[c++] = qv;
-
-				if (_missing) {
-					if (v == mv ) ucptr[c++] = 255;
-					else ucptr[c++] = 0;
-				}
-				if (_layered) {
-					(void) rg->GetUserCoordinates(x,y,z,&x_f, &y_f, &z_f);
-					qv = (unsigned int) rint(
-						(z_f-extents[2])/(extents[5]-extents[2]) *
-						_tmax.z * 255
-					);
-					ucptr[c++] = qv;
-				}
-				ucptr+=step;
-
-				x++;
-				if (x>=dnx) {
-					x = 0;
-					y++;
-				}
-				if (y>=dny) {
-					y = 0;
-					z++;
-				}
-			}
-		} else if (_szcomp == 2) {
-			for (itr = rg->begin(); itr!=rg->end(); ++itr) {
-				int c = 0;
-				v = *itr;
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=65535;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 65535);
-
-				ucptr[c++] = (unsigned char) (qv & 0xff);
-				ucptr[c++] = (unsigned char) ((qv >> 8) & 0xff);
-
-				if (_missing) {
-					if (v == mv ) {
-						ucptr[c++] = (unsigned char) 0xff;
-						ucptr[c++] = (unsigned char) 0xff;
-					}
-					else {
-						ucptr[c++] = 0;
-						ucptr[c++] = 0;
-					}
-				}
-				if (_layered) {
-					(void) rg->GetUserCoordinates(x,y,z,&x_f, &y_f, &z_f);
-					qv = (unsigned int) rint(
-						(z_f-extents[2])/(extents[5]-extents[2]) * 
-						_tmax.z * 65535
-					);
-					ucptr[c++] = (unsigned char) (qv & 0xff);
-					ucptr[c++] = (unsigned char) ((qv >> 8) & 0xff);
-				}
-
-				ucptr+=step;
-
-				x++;
-				if (x>=dnx) {
-					x = 0;
-					y++;
-				}
-				if (y>=dny) {
-					y = 0;
-					z++;
-				}
-			}
-		}
-	}
-	else {
-
-		if (_szcomp == 1) {
-			for (int z=0; z<bz && z<dnz; z++) {
-			for (int y=0; y<by && y<dny; y++) {
-			ucptr = data+z*bx*by*step + y*bx*step;
-			for (int x=0; x<bx && x<dnx; x++) {
-				int c = 0;
-				v = rg->AccessIJK(x+xoffset,y+yoffset,z+zoffset);
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=255;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 255);
-
-				ucptr[c++] = qv;
-				if (_missing) {
-					if (v == mv ) ucptr[c++] = 255;
-					else ucptr[c++] = 0;
-				}
-				if (_layered) {
-					(void) rg->GetUserCoordinates(
-						x+xoffset,y+yoffset,z+zoffset,&x_f, &y_f, &z_f
-					);
-					qv = (unsigned int) rint(
-						(z_f-extents[2])/(extents[5]-extents[2]) *
-						_tmax.z * 255
-					);
-					ucptr[c++] = qv;
-				}
-				ucptr += step;
-			}
-			}
-			}
-		}
-		else if (_szcomp == 2) {
-			for (int z=0; z<bz && z<dnz; z++) {
-			for (int y=0; y<by && y<dny; y++) {
-			ucptr = data+z*bx*by*step + y*bx*step;
-			for (int x=0; x<bx && x<dnx; x++) {
-				int c = 0;
-				v = rg->AccessIJK(x+xoffset,y+yoffset,z+zoffset);
-
-				if (v<range[0]) qv=0;
-				else if (v>range[1]) qv=65535;
-				else qv = (unsigned int) rint((v-range[0])/(range[1]-range[0]) * 65535);
-
-				ucptr[c++] = (unsigned char) (qv & 0xff);
-				ucptr[c++] = (unsigned char) ((qv >> 8) & 0xff);
-				if (_missing) {
-					if (v == mv ) {
-						ucptr[c++] = (unsigned char) 0xff;
-						ucptr[c++] = (unsigned char) 0xff;
-					}
-					else {
-						ucptr[c++] = 0;
-						ucptr[c++] = 0;
-					}
-				}
-				if (_layered) {
-					(void) rg->GetUserCoordinates(
-						x+xoffset,y+yoffset,z+zoffset,&x_f, &y_f, &z_f);
-					qv = (unsigned int) rint(
-						(z_f-extents[2])/(extents[5]-extents[2]) * 
-						_tmax.z * 65535
-					);
-					ucptr[c++] = (unsigned char) (qv & 0xff);
-					ucptr[c++] = (unsigned char) ((qv >> 8) & 0xff);
-				}
-				ucptr+=step;
-			}
-			}
-			}
-		}
-	}
+  _filler.SetFormat(_szcomp, _ncomp, _missing, _layered, _tmax.z);
+  _filler.Fill(
+    rg, range, data, bx, by, bz, dnx, dny, dnz, xoffset, yoffset, zoffset
+  );
 }
 
 
@@ -552,29 +306,11 @@ void TextureBrick::fill(const RegularGrid *rg,
   assert(_data != NULL);
 
   //
-  // Copy over the data
+  // The brick's layout may have changed
   //
-  if ((! _missing  && ! _layered) || num != 0) {
-    //
-    // Only variable # 0 contains useable missing or layered data info.
-    // 
-    size_t offset = num;
-	if (_missing) offset++;
-	if (_layered) offset++;
-	offset *= _szcomp;
-	
-    copytex_fast(
-	  rg, _data + offset, range, _bx, _by, _bz, _dnx, _dny, _dnz,
-	  _xoffset, _yoffset, _zoffset
-    );
-  }
-  else {
-    copytex(
-	  rg, _data, range, _bx, _by, _bz, _dnx, _dny, _dnz,
-	  _xoffset, _yoffset, _zoffset
-    );
-  }
+  _sources.assign(_nvars, Source());
 
+  _fill(rg, range, num);
 }
 
 //----------------------------------------------------------------------------
@@ -609,40 +345,52 @@ void TextureBrick::fill(
   }
 
   //
-  // Copy over the data
+  // The brick's layout may have changed
   //
-  if ((! _missing  && ! _layered) || num != 0) {
-    //
-    // Only variable # 0 contains useable missing or layered data info.
-    // 
-    size_t offset = num;
-	if (_missing) offset++;
-	if (_layered) offset++;
-	offset *= _szcomp;
-	
-    copytex_fast(
-	  rg, _data + offset, range, _bx, _by, _bz, _dnx, _dny, _dnz,
-	  _xoffset, _yoffset, _zoffset
-    );
-  }
-  else {
-    copytex(
-	  rg, _data, range, _bx, _by, _bz, _dnx, _dny, _dnz,
-	  _xoffset, _yoffset, _zoffset
-    );
-  }
+  _sources.assign(_nvars, Source());
 
+  _fill(rg, range, num);
 }
 
 //----------------------------------------------------------------------------
 // Update the brick's data.
 //----------------------------------------------------------------------------
-void TextureBrick::refill(
+bool TextureBrick::refill(
 	const RegularGrid *rg, const float range[2], int num
 ) { 
+  assert(num < _nvars);
+
   //
-  // Copy over the data
+  // Nothing to do if the grid values are read from the same storage
+  // blocks as last time, with the same data range, and hash to the
+  // same value (the blocks may have been reused for other data).
   //
+  const Source &src = _sources[num];
+  if (src._valid && 
+	src._range[0] == range[0] && src._range[1] == range[1] &&
+	src._mv == rg->GetMissingValue()
+  ) {
+    std::vector <float *> blks;
+    BrickFiller::GetBlocks(rg, blks);
+    if (blks == src._blks &&
+      _filler.Hash(
+        rg, _bx, _by, _bz, _dnx, _dny, _dnz, _xoffset, _yoffset, _zoffset
+      ) == 0 && _filler.GetHash() == src._hash
+    ) {
+      return(false);
+    }
+  }
+
+  _fill(rg, range, num);
+  return(true);
+}
+
+//----------------------------------------------------------------------------
+// Copy over the data of variable num and remember where it came from
+//----------------------------------------------------------------------------
+void TextureBrick::_fill(
+	const RegularGrid *rg, const float range[2], int num
+) { 
   if ((! _missing  && ! _layered) || num != 0) {
     //
     // Only variable # 0 contains useable missing or layered data info.
@@ -651,7 +399,7 @@ void TextureBrick::refill(
 	if (_missing) offset++;
 	if (_layered) offset++;
 	offset *= _szcomp;
-
+	
     copytex_fast(
 	  rg, _data + offset, range, _bx, _by, _bz, _dnx, _dny, _dnz,
 	  _xoffset, _yoffset, _zoffset
@@ -663,6 +411,19 @@ void TextureBrick::refill(
 	  _xoffset, _yoffset, _zoffset
     );
   }
+  _dirty = true;
+
+  //
+  // Layered coordinates aren't hashed, so bricks storing them are
+  // always refilled
+  //
+  Source &src = _sources[num];
+  src._valid = ! (num == 0 && _layered);
+  BrickFiller::GetBlocks(rg, src._blks);
+  src._range[0] = range[0];
+  src._range[1] = range[1];
+  src._mv = rg->GetMissingValue();
+  src._hash = _filler.GetHash();
 }
 
 
@@ -21,6 +21,7 @@
 #include <vapor/LayeredGrid.h>
 #include "BBox.h"
 #include "Point3d.h"
+#include "BrickFiller.h"
 
 namespace VAPoR {
 
@@ -62,6 +63,12 @@ class RENDER_API TextureBrick
   void load();
   void reload();
 
+  //
+  // True if the brick's data changed since it was last loaded into the
+  // texture object
+  //
+  bool dirty() const { return _dirty; }
+
   void copytex(
 	const RegularGrid *rg, unsigned char *data, const float range[2],
 	int bx, int by, int bz,
@@ -86,7 +93,12 @@ class RENDER_API TextureBrick
 	const RegularGrid *rg, const float range[2], int num
   );
 
-  void refill(
+  //
+  // Refill the brick from a grid with the same dimensions as the one it
+  // was filled from. Returns false, without touching the brick's data, if
+  // the values stored for variable num haven't changed.
+  //
+  bool refill(
 	const RegularGrid *rg, const float range[2], int num
   );
 
@@ -214,8 +226,32 @@ class RENDER_API TextureBrick
   bool _missing;	// Grid has missing data
   bool _layered;	// grid is of type LayeredGrid
   int _nvars;		// # of vars stored in a texture.
+  bool _dirty;		// data changed since last load
 
 private:
+
+  // Quantizes grid values into _data
+  BrickFiller _filler;
+
+  //
+  // Source of the values stored for a variable. Used to skip refills
+  // of bricks whose values haven't changed.
+  //
+  class Source {
+  public:
+    Source() : _valid(false), _mv(0.0), _hash(0) {
+      _range[0] = _range[1] = 0.0;
+    }
+    bool _valid;
+    std::vector <float *> _blks;	// grid storage blocks
+    float _range[2];
+    float _mv;
+    unsigned long long _hash;	// hash of the grid values
+  };
+  std::vector <Source> _sources;	// one per variable
+
+  void _fill(const RegularGrid *rg, const float range[2], int num);
+
   static int _configure(
     const RegularGrid *rg, int precision, int nvars,
     GLenum &format, GLint &internalFormat, size_t &ncomp, GLenum &type,
@@ -24,6 +24,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cfloat>
+#include <typeinfo>
 
 #ifndef WIN32
 #include <unistd.h>
@@ -52,10 +53,12 @@
 //#include "DVRLookup.h"
 #include "DVRShader.h"
 #include "DVRRayCaster.h"
+#include "DVRRayCasterCPU.h"
 #include "DVRSpherical.h"
 #include "DVRDebug.h"
 #include "params.h"
 #include "renderer.h"
+#include "RenderJobQueue.h"
 
 #include "Stopwatch.h"
 
@@ -68,9 +71,65 @@
 #define EPSILON 5.960464478e-8
 #define FLTEQ(a,b) (fabs(a-b) < fabs(a*EPSILON) && fabs(a-b) < fabs(b*EPSILON))
 
+// Regions with more voxels than this are streamed out of core
+#define LOD_MIN_VOXELS (256.0*256.0*256.0)
+
 using namespace VAPoR;
 using namespace VetsUtil;
 
+namespace VAPoR {
+
+//
+// Reads the grids of a region on a worker thread. The grids are locked
+// into the cache until the job is deleted.
+//
+class VolumeRegionJob : public RenderJob {
+public:
+	VolumeRegionJob() : dataMgr(NULL) {}
+	~VolumeRegionJob() {
+		for (int i=0; i<grids.size(); i++) {
+			dataMgr->UnlockGrid(grids[i]);
+			delete grids[i];
+		}
+	}
+	virtual int Run();
+
+	DataMgr *dataMgr;
+	size_t timestep;
+	vector <string> varnames;
+	int reflevel;
+	int lod;
+	size_t min[3], max[3];
+
+	// Results:
+	vector <RegularGrid *> grids;
+
+	// The error of a failed job, reported when it is installed on the 
+	// GL thread
+	string errMsg;
+};
+
+};
+
+int VolumeRegionJob::Run() {
+	bool diverted = MyBase::DivertThreadErrMsg(true);
+	int rc = 0;
+	for (int i=0; i<varnames.size() && ! IsCancelled(); i++) {
+		RegularGrid *rg = dataMgr->GetGrid(
+			timestep, varnames[i], reflevel, lod, min, max, 1
+		);
+		if (! rg) {
+			rc = -1;
+			break;
+		}
+		grids.push_back(rg);
+	}
+	if (IsCancelled()) rc = -1;
+	errMsg = rc < 0 ? MyBase::GetThreadErrMsg() : "";
+	MyBase::DivertThreadErrMsg(diverted);
+	return(rc);
+}
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
@@ -89,6 +148,7 @@ VolumeRenderer::VolumeRenderer(GLWindow* glw, DvrParams::DvrType type, RenderPar
 	_reflevel = -1;
 	_userTextureSizeIsSet = false;
 	_userTextureSize = 0;
+	_haveRegion = false;
 	_range[0] = FLT_MIN;
 	_range[1] = FLT_MAX;
 
@@ -210,6 +270,11 @@ return(false);
        return DVRRayCaster::supported();
      }
 
+     case DvrParams::DVR_CPU_RAY_CASTER:
+     {
+       return true;
+     }
+
      case DvrParams::DVR_DEBUG:
      {
 #    ifdef DEBUG
@@ -273,6 +338,10 @@ DVRBase* VolumeRenderer::create_driver(DvrParams::DvrType dvrType, int)
 	ParamsIso *rp = (ParamsIso *) currentRenderParams;
 	driver = new DVRRayCaster(rp->GetNumBits(), 2, myGLWindow, myGLWindow->getShaderMgr(), 1);
   }
+  else if (dvrType == DvrParams::DVR_CPU_RAY_CASTER)
+  {
+    driver = new DVRRayCasterCPU();
+  }
   else if (dvrType == DvrParams::DVR_DEBUG)
   {
     driver = new DVRDebug(&argc, argv, 1);
@@ -425,24 +494,62 @@ void VolumeRenderer::DrawVoxelScene(unsigned fast)
 		}
 
 		//
-		// Turn off error callback, look for memory allocation problem.
+		// A region read earlier is no longer wanted
 		//
-		QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+		cancelJobs();
 
-		int rc = _updateRegion(
-			dataMgr, currentRenderParams, myRegionParams,
-			timeStep, varname, availRefLevel, lod, min_dim, max_dim
-		);
-			
-		//Turn it back on:
-	    
-		QApplication::restoreOverrideCursor();
+		//
+		// Large regions are streamed out of core a brick at a time, 
+		// as they are drawn. Other regions are read by a job, and the 
+		// region last read is drawn until the job completes.
+		//
+		int rc = 1;
+		if (_type == DvrParams::DVR_TEXTURE3D_SHADER) {
+			double nvoxels = 1.0;
+			for (int i=0; i<3; i++) {
+				nvoxels *= (double) (max_dim[i] - min_dim[i] + 1);
+			}
+
+			if (nvoxels > LOD_MIN_VOXELS) {
+				rc = _updateRegionLOD(
+					dataMgr, currentRenderParams, timeStep, varname, 
+					availRefLevel, lod, min_dim, max_dim
+				);
+			}
+		}
 		if (rc < 0) {
 			setBypass(timeStep);
 			return;
 		}
+		if (rc == 0) {
+			_haveRegion = true;
+		}
+		else {
+			VolumeRegionJob *job = new VolumeRegionJob;
+			job->dataMgr = dataMgr;
+			job->timestep = timeStep;
+			_regionVarnames(currentRenderParams, varname, job->varnames);
+			job->reflevel = availRefLevel;
+			job->lod = lod;
+			for (int i=0; i<3; i++) {
+				job->min[i] = min_dim[i];
+				job->max[i] = max_dim[i];
+			}
+			submitJob(job);
+		}
 	}
 
+	//
+	// An image being captured must show the current region
+	//
+	if (myGLWindow->isCapturingImage()) waitForJob();
+	VolumeRegionJob *job = (VolumeRegionJob *) takeCompletedJob();
+	if (job && _installJob(job, myRegionParams) < 0) {
+		setBypass(timeStep);
+		return;
+	}
+	if (! _haveRegion) return;
+
 	//cerr << "transforming everything to unit box coords :-(\n";
 	myGLWindow->TransformToUnitBox();
 
@@ -450,10 +557,25 @@ void VolumeRenderer::DrawVoxelScene(unsigned fast)
 	glScalef(scales[0], scales[1], scales[2]);
 	
 
-	if (myGLWindow->vizIsDirty(ViewportBit)) {
+	//
+	// The CPU ray caster renders an image the size of the viewport, 
+	// with the current GL transformation
+	//
+	DVRRayCasterCPU *cpuDriver = dynamic_cast<DVRRayCasterCPU *>(_driver);
+	if (myGLWindow->vizIsDirty(ViewportBit) || cpuDriver) {
 		const GLint* viewport = myGLWindow->getViewport();
 		_driver->Resize(viewport[2], viewport[3]);
 	}
+	if (cpuDriver) {
+		GLdouble modelview[16], projection[16];
+		glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+		glGetDoublev(GL_PROJECTION_MATRIX, projection);
+		if (cpuDriver->SetMatrices(modelview, projection) < 0) {
+			setBypass(timeStep);
+			SetErrMsg(VAPOR_ERROR_DVR, "Unable to volume render");
+			return;
+		}
+	}
 
 
 	//
@@ -512,6 +634,14 @@ void VolumeRenderer::DrawVoxelScene(unsigned fast)
 	//
 	enableRegionClippingPlanes();
 
+	//
+	// An image being captured must show the volume fully refined
+	//
+	DVRTexture3d *texDriver = dynamic_cast<DVRTexture3d *>(_driver);
+	if (texDriver) {
+		texDriver->SetBrickFetchTime(myGLWindow->isCapturingImage() ? -1.0 : 0.1);
+	}
+
 	//qWarning("Starting render");
 	if (_driver->Render() < 0){
 		setBypass(timeStep);
@@ -521,6 +651,44 @@ void VolumeRenderer::DrawVoxelScene(unsigned fast)
 	}
 	disableRegionClippingPlanes();
 	//qWarning("Render done");
+
+	//
+	// Bricks streamed out of core are still missing: draw again once
+	// this frame is shown
+	//
+	if (texDriver && texDriver->IsRefining()) {
+		QMetaObject::invokeMethod(myGLWindow, "updateGL", Qt::QueuedConnection);
+	}
+
+	if (cpuDriver && cpuDriver->GetImage()) {
+
+		//
+		// Blend the premultiplied image over the scene
+		//
+		glMatrixMode(GL_PROJECTION);
+		glPushMatrix();
+		glLoadIdentity();
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadIdentity();
+
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glRasterPos2i(-1, -1);
+		glDrawPixels(
+			cpuDriver->GetWidth(), cpuDriver->GetHeight(), GL_RGBA, 
+			GL_UNSIGNED_BYTE, cpuDriver->GetImage()
+		);
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+
+		glPopMatrix();
+		glMatrixMode(GL_PROJECTION);
+		glPopMatrix();
+		glMatrixMode(GL_MODELVIEW);
+	}
 	
 	clearClutDirty();
 }
@@ -582,16 +750,42 @@ void VolumeRenderer::DrawVoxelWindow(unsigned fast)
 #endif
 }
 
-int	VolumeRenderer::_updateRegion(
-	DataMgr *dataMgr, RenderParams *rp, RegionParams *regp,
-	size_t ts, string varname, int reflevel, int lod,
-	const size_t min[3], const size_t max[3]
+void	VolumeRenderer::_regionVarnames(
+	RenderParams *rp, string varname, vector <string> &varnames
 ) {
+	varnames.clear();
+	varnames.push_back(varname);
+}
 
-	RegularGrid *rg = dataMgr->GetGrid(
-			ts, varname, reflevel, lod, min, max
+//
+// Hand the grids read by a job to the driver. The job is deleted.
+//
+int	VolumeRenderer::_installJob(VolumeRegionJob *job, RegionParams *regp) {
+	if (job->GetStatus() < 0) {
+		if (! job->errMsg.empty()) {
+			MyBase::SetErrMsg(
+				VAPOR_ERROR_DATA_UNAVAILABLE, "%s", job->errMsg.c_str()
+			);
+		}
+		delete job;
+		return(-1);
+	}
+
+	int rc = _updateRegion(
+		job->dataMgr, currentRenderParams, regp, job->timestep, job->grids
 	);
-	if (!rg) return(-1);
+	delete job;
+	if (rc < 0) return(rc);
+
+	_haveRegion = true;
+	return(0);
+}
+
+int	VolumeRenderer::_updateRegion(
+	DataMgr *dataMgr, RenderParams *rp, RegionParams *regp,
+	size_t ts, const vector <RegularGrid *> &grids
+) {
+	RegularGrid *rg = grids[0];
 
 	int rc = 0;
 	if (_type == DvrParams::DVR_SPHERICAL_SHADER)
@@ -627,11 +821,78 @@ int	VolumeRenderer::_updateRegion(
 		rc = _driver->SetRegion(rg, rp->getCurrentDatarange(), 0);
 	}
 
+	return(rc);
+}
+
+
+//
+// Stream a region out of core. Returns 1, without changing the driver's
+// region, if the region's grid can't be rendered this way.
+//
+int	VolumeRenderer::_updateRegionLOD(
+	DataMgr *dataMgr, RenderParams *rp,
+	size_t ts, string varname, int reflevel, int lod,
+	const size_t min[3], const size_t max[3]
+) {
+	DVRTexture3d *driver = dynamic_cast<DVRTexture3d *>(_driver);
+	if (! driver) return(1);
+
+	//
+	// A coarse grid of the region tells whether its type is supported
+	//
+	size_t cmin[3], cmax[3];
+	for (int i=0; i<3; i++) {
+		cmin[i] = min[i] >> reflevel;
+		cmax[i] = max[i] >> reflevel;
+	}
+	RegularGrid *rg = dataMgr->GetGrid(ts, varname, 0, lod, cmin, cmax, 1);
+	if (! rg) return(-1);
+	bool supported = typeid(*rg) == typeid(RegularGrid) && ! rg->HasMissingData();
+	dataMgr->UnlockGrid(rg);
 	delete rg;
+	if (! supported) return(1);
 
-	return(rc);
+	if (_brickSource.dataMgr != dataMgr || _brickSource.timestep != ts ||
+		_brickSource.varname != varname || _brickSource.lod != lod) {
+
+		driver->ClearBrickCache();
+	}
+	_brickSource.dataMgr = dataMgr;
+	_brickSource.timestep = ts;
+	_brickSource.varname = varname;
+	_brickSource.lod = lod;
+
+	size_t dims[3];
+	dataMgr->GetDim(dims, reflevel);
+
+	double extents[6];
+	dataMgr->MapVoxToUser(ts, min, extents, reflevel, lod);
+	dataMgr->MapVoxToUser(ts, max, extents+3, reflevel, lod);
+
+	return(driver->SetRegionLOD(
+		&_brickSource, dims, min, max, extents, reflevel,
+		rp->getCurrentDatarange()
+	));
 }
 
+RegularGrid *VolumeRenderer::BrickSource::GetGrid(
+	int reflevel, const size_t min[3], const size_t max[3]
+) {
+	size_t dims[3];
+	dataMgr->GetDim(dims, reflevel);
+
+	size_t bmin[3], bmax[3];
+	for (int i=0; i<3; i++) {
+		bmax[i] = max[i] < dims[i] ? max[i] : dims[i] - 1;
+		bmin[i] = min[i] < bmax[i] ? min[i] : bmax[i];
+	}
+	return(dataMgr->GetGrid(timestep, varname, reflevel, lod, bmin, bmax, 1));
+}
+
+void VolumeRenderer::BrickSource::ReleaseGrid(RegularGrid *rg) {
+	dataMgr->UnlockGrid(rg);
+	delete rg;
+}
 
 void VolumeRenderer::_updateDriverRenderParamsSpec(
 	RenderParams *rp
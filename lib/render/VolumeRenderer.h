@@ -24,12 +24,15 @@
 #include <stdio.h>
 #include <vapor/DataMgr.h>
 #include "DVRBase.h"
+#include "DVRTexture3d.h"
 #include "renderer.h"
 #include "glwindow.h"
 #include "dvrparams.h"
 
 namespace VAPoR {
 
+  class VolumeRegionJob;
+
   class RENDER_API VolumeRenderer : public Renderer 
   {
 	
@@ -66,10 +69,19 @@ namespace VAPoR {
     virtual void DrawVoxelScene(unsigned fast);
     virtual void DrawVoxelWindow(unsigned fast);
 
+	//
+	// The grids of a region are read by a job on a worker thread, and
+	// handed to the driver by _updateRegion() on the GL thread. 
+	// _regionVarnames() returns the variables the job reads, and
+	// _updateRegion() is passed one grid of each.
+	//
+	virtual void _regionVarnames(
+		RenderParams *rp, string varname, vector <string> &varnames
+	);
+
 	virtual int _updateRegion(
 		DataMgr *dataMgr, RenderParams *rp, RegionParams *regp,
-		size_t ts, string varname, int reflevel, int lod,
-		const size_t min[3], const size_t max[3]
+		size_t ts, const vector <RegularGrid *> &grids
 	);
 
 	virtual void _updateDriverRenderParamsSpec(RenderParams *rp);
@@ -82,6 +94,31 @@ namespace VAPoR {
     int    _frames;
     double _seconds;
 
+	//
+	// Source of the bricks of a region too large to be read at once,
+	// which is streamed a brick at a time
+	//
+	class BrickSource : public DVRTexture3d::Source {
+	public:
+		BrickSource() : dataMgr(NULL), timestep(0), lod(0) {}
+		virtual RegularGrid *GetGrid(
+			int reflevel, const size_t min[3], const size_t max[3]
+		);
+		virtual void ReleaseGrid(RegularGrid *rg);
+
+		DataMgr *dataMgr;
+		size_t timestep;
+		string varname;
+		int lod;
+	};
+	BrickSource _brickSource;
+
+	virtual int _updateRegionLOD(
+		DataMgr *dataMgr, RenderParams *rp,
+		size_t ts, string varname, int reflevel, int lod,
+		const size_t min[3], const size_t max[3]
+	);
+
   private:
 	size_t _timeStep;
 	double _extents[6];
@@ -91,6 +128,9 @@ namespace VAPoR {
 	int _reflevel;
 	bool _userTextureSizeIsSet;
 	int _userTextureSize;
+	bool _haveRegion;	// the driver has a region to render
+
+	int _installJob(VolumeRegionJob *job, RegionParams *regp);
 	  
   };
 };
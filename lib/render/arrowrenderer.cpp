@@ -16,8 +16,6 @@
 
 // Specify the arrowhead width compared with arrow diameter:
 #define ARROW_HEAD_FACTOR 3.0
-// Specify how long the arrow tube is, in front of where the arrowhead is attached:
-#define ARROW_LENGTH_FACTOR 0.9
 
 #include "glutil.h"	// Must be included first!!!
 #include <stdlib.h>
@@ -49,6 +47,9 @@ using namespace VetsUtil;
 ArrowRenderer::ArrowRenderer(GLWindow* glw, RenderParams* rp) 
   : Renderer(glw,  rp, "ArrowRenderer")
 {
+	arrowGeometry = new FlowGeometry();
+	geometryDataMgr = 0;
+	geometryDirty = true;
 }
 
 //----------------------------------------------------------------------------
@@ -56,6 +57,7 @@ ArrowRenderer::ArrowRenderer(GLWindow* glw, RenderParams* rp)
 //----------------------------------------------------------------------------
 ArrowRenderer::~ArrowRenderer()
 {
+	delete arrowGeometry;
 }
 
 void ArrowRenderer::initializeGL(){
@@ -69,28 +71,10 @@ void ArrowRenderer::paintGL(){
 	DataMgr* dataMgr = ds->getDataMgr();
 	if (!dataMgr) return;
 
-	//
-	//Set up the variable data required, while determining data extents to use in rendering
-	//
-	RegularGrid *varData[] = {NULL,NULL,NULL,NULL};
-	vector<string>varnames;
-	size_t voxExts[6];
-	double validExts[6];
-	int actualRefLevel = setupVariableData(varnames, varData, validExts, voxExts);
-	if (actualRefLevel < 0) return;
-	//
-	//Calculate the scale factors and radius to be used in rendering the arrows:
-	//
-	const vector<long> rakeGrid = aParams->GetRakeGrid();
-	double rakeExts[6];
-	aParams->GetRakeLocalExtents(rakeExts);
 	size_t timestep = (size_t)myGLWindow->getActiveAnimationParams()->getCurrentTimestep();
-	const vector<double>& userExts = dataMgr->GetExtents(timestep);
-	for (int i = 0; i<3; i++) rakeExts[i] += userExts[i];
-	
 	float vectorLengthScale = aParams->GetVectorScale();
 	//
-	//Also find the horizontal voxel size in user units at highest ref level.  This will be used to scale the vector radius.
+	//Find the horizontal voxel size in user units at highest ref level.  This will be used to scale the vector radius.
 	//
 	size_t dim[3];
 	dataMgr->GetDim(dim, -1);
@@ -102,166 +86,73 @@ void ArrowRenderer::paintGL(){
 	}
 	if (maxVoxSize == 0.f) maxVoxSize = 1.f;
 	float rad = 0.5*maxVoxSize*aParams->GetLineThickness();
+
 	//
-	//Perform OpenGL rendering of arrows
+	//The arrows are rebuilt only when the data or the settings they depend on change
 	//
-	performRendering(actualRefLevel, vectorLengthScale, rad, varData);
-	
-	//Release the locks on the data:
-	for (int k = 0; k<4; k++){
-		if (varData[k])
-			dataMgr->UnlockGrid(varData[k]);
-			delete varData[k];
-	}
-}
+	vector<double> key;
+	key.push_back((double)timestep);
+	key.push_back((double)aParams->GetRefinementLevel());
+	key.push_back((double)aParams->GetCompressionLevel());
+	const vector<double> rakeExts = aParams->GetRakeLocalExtents();
+	for (int i = 0; i<6; i++) key.push_back(rakeExts[i]);
+	const vector<long> rakeGrid = aParams->GetRakeGrid();
+	for (int i = 0; i<3; i++) key.push_back((double)rakeGrid[i]);
+	key.push_back((double)aParams->IsAlignedToData());
+	key.push_back((double)aParams->IsTerrainMapped());
+	key.push_back(vectorLengthScale);
+	key.push_back(rad);
+	const float* scales = ds->getStretchFactors();
+	for (int i = 0; i<3; i++) key.push_back(scales[i]);
 
-//Issue OpenGL calls to draw a cylinder with orthogonal ends from one point to another.
-//Then put an arrow head on the end
-//
-void ArrowRenderer::drawArrow(const float startPoint[3], const float endPoint[3], float radius) {
-	//Constants are needed for cosines and sines, at 60 degree intervals.
-	//The arrow is really a hexagonal tube, but the shading makes it look round.
-	const float sines[6] = {0.f, sqrt(3.)/2., sqrt(3.)/2., 0.f, -sqrt(3.)/2., -sqrt(3.)/2.};
-	const float coses[6] = {1.f, 0.5, -0.5, -1., -.5, 0.5};
-
-	float nextPoint[3];
-	float vertexPoint[3];
-	float headCenter[3];
-	float startNormal[18];
-	float nextNormal[18];
-	float startVertex[18];
-	float nextVertex[18];
-	float testVec[3];
-	float testVec2[3];
-	
-	//Calculate an orthonormal frame, dirVec, uVec, bVec.  dirVec is the arrow direction
-	float dirVec[3], bVec[3], uVec[3];
-	vsub(endPoint,startPoint,dirVec);
-	float len = vlength(dirVec);
-	if (len == 0.f) return;
-	vscale(dirVec,1./len);
-
-	//Calculate uVec, orthogonal to dirVec:
-	vset(testVec, 1.,0.,0.);
-	vcross(dirVec, testVec, uVec);
-	len = vdot(uVec,uVec);
-	if (len == 0.f){
-		vset(testVec, 0.,1.,0.);
-		vcross(dirVec, testVec, uVec);
-		len = vdot(uVec, uVec);
-	} 
-	vscale(uVec, 1.f/sqrt(len));
-	vcross(uVec, dirVec, bVec);
-	
-	int i;
-	//Calculate nextPoint and vertexPoint, for arrowhead
-	
-	for (i = 0; i< 3; i++){
-		nextPoint[i] = (1. - ARROW_LENGTH_FACTOR)*startPoint[i]+ ARROW_LENGTH_FACTOR*endPoint[i];
-		//Assume a vertex angle of 45 degrees:
-		vertexPoint[i] = nextPoint[i] + dirVec[i]*radius;
-		headCenter[i] = nextPoint[i] - dirVec[i]*(ARROW_HEAD_FACTOR*radius-radius); 
-	}
-	//calculate 6 points in plane orthog to dirVec, in plane of point
-	for (i = 0; i<6; i++){
-		//testVec and testVec2 are components of point in plane
-		vmult(uVec, coses[i], testVec);
-		vmult(bVec, sines[i], testVec2);
-		//Calc outward normal as a sideEffect..
-		//It is the vector sum of x,y components (norm 1)
-		vadd(testVec, testVec2, startNormal+3*i);
-		//stretch by radius to get current displacement
-		vmult(startNormal+3*i, radius, startVertex+3*i);
-		//add to current point
-		vadd(startVertex+3*i, startPoint, startVertex+3*i);
-	}
-	
-	glBegin(GL_POLYGON);
-	glNormal3fv(dirVec);
-	for (int k = 0; k<6; k++){
-		glVertex3fv(startVertex+3*k);
-	}
-	glEnd();
-	
-			
-	//calc for endpoints:
-	for (i = 0; i<6; i++){
-		//testVec and testVec2 are components of point in plane
-		vmult(uVec, coses[i], testVec);
-		vmult(bVec, sines[i], testVec2);
-		//Calc outward normal as a sideEffect..
-		//It is the vector sum of x,y components (norm 1)
-		vadd(testVec, testVec2, nextNormal+3*i);
-		//stretch by radius to get current displacement
-		vmult(nextNormal+3*i, radius, nextVertex+3*i);
-		//add to current point
-		vadd(nextVertex+3*i, nextPoint, nextVertex+3*i);		
-	}
-	
-	
-	//Now make a triangle strip for cylinder sides:
-	glBegin(GL_TRIANGLE_STRIP);
-	
-	for (i = 0; i< 6; i++){
-			
-		glNormal3fv(nextNormal+3*i);
-		glVertex3fv(nextVertex+3*i);
-			
-		glNormal3fv(startNormal+3*i);
-		glVertex3fv(startVertex+3*i);
-	}
-	//repeat first two vertices to close cylinder:
-		
-	glNormal3fv(nextNormal);
-	glVertex3fv(nextVertex);
+	vector<string> keyVars;
+	for (int i = 0; i<3; i++) keyVars.push_back(aParams->GetFieldVariableName(i));
+	if (aParams->IsTerrainMapped()) keyVars.push_back(aParams->GetHeightVariableName());
+
+	if (geometryDirty || dataMgr != geometryDataMgr || key != geometryKey || keyVars != geometryVars){
+		//
+		//Set up the variable data required, while determining data extents to use in rendering
+		//
+		RegularGrid *varData[] = {NULL,NULL,NULL,NULL};
+		vector<string>varnames;
+		size_t voxExts[6];
+		double validExts[6];
+		int actualRefLevel = setupVariableData(varnames, varData, validExts, voxExts);
+		if (actualRefLevel < 0) return;
+
+		int rc = buildGeometry(vectorLengthScale, rad, varData);
 		
-	glNormal3fv(startNormal);
-	glVertex3fv(startVertex);
-	
-	glEnd();
-	//Now draw the arrow head.  First calc 6 vertices at back of arrowhead
-	//Reuse startNormal and startVertex vectors
-	//calc for endpoints:
-	for (i = 0; i<6; i++){
-		//testVec and testVec2 are components of point in plane
-		//Can reuse them from previous (cylinder end) calculation
-		vmult(uVec, coses[i], testVec);
-		vmult(bVec, sines[i], testVec2);
-		//Calc outward normal as a sideEffect..
-		//It is the vector sum of x,y components (norm 1)
-		vadd(testVec, testVec2, startNormal+3*i);
-		//stretch by radius to get current displacement
-		vmult(startNormal+3*i, ARROW_HEAD_FACTOR*radius, startVertex+3*i);
-		//add to current point
-		vadd(startVertex+3*i, headCenter, startVertex+3*i);
-		//Now tilt normals in direction of arrow:
-		for (int k = 0; k<3; k++){
-			startNormal[3*i+k] = 0.5*startNormal[3*i+k] + 0.5*dirVec[k];
+		//Release the locks on the data:
+		for (int k = 0; k<4; k++){
+			if (varData[k])
+				dataMgr->UnlockGrid(varData[k]);
+				delete varData[k];
 		}
+		if (rc < 0) {
+			geometryDirty = true;
+			return;
+		}
+		geometryDirty = false;
+		geometryDataMgr = dataMgr;
+		geometryKey = key;
+		geometryVars = keyVars;
 	}
-	//Create a triangle fan from these 6 vertices.  
-	glBegin(GL_TRIANGLE_FAN);
-	glNormal3fv(dirVec);
-	glVertex3fv(vertexPoint);
-	for (i = 0; i< 6; i++){
-		glNormal3fv(startNormal+3*i);
-		glVertex3fv(startVertex+3*i);
-	}
-	//Repeat first point to close fan:
-	glNormal3fv(startNormal);
-	glVertex3fv(startVertex);
-	glEnd();
+	//
+	//Perform OpenGL rendering of arrows
+	//
+	performRendering();
 }
-//Perform the openGL rendering:
-void ArrowRenderer::performRendering(
-	int actualRefLevel, float vectorLengthScale, float rad, 
-	RegularGrid *variableData[4]
+
+//Build the arrows at the rake grid points.  The field is sampled, and the arrow
+//geometry generated, on worker threads.
+int ArrowRenderer::buildGeometry(
+	float vectorLengthScale, float rad, RegularGrid *variableData[4]
 ){
 
 	ArrowParams* aParams = (ArrowParams*)currentRenderParams;
 	DataStatus* ds = DataStatus::getInstance();
 	DataMgr* dataMgr = ds->getDataMgr();
-	if (!dataMgr) return;
+	if (!dataMgr) return -1;
 	size_t timestep = (size_t)myGLWindow->getActiveAnimationParams()->getCurrentTimestep();
 	
 	const vector<double> rExtents = aParams->GetRakeLocalExtents();
@@ -290,14 +181,36 @@ void ArrowRenderer::performRendering(
 		}
 	}
 	
-	//Perform setup of OpenGL transform matrix.  This transforms the full stretched domain into the unit box
-	//by scaling and translating.
-	myGLWindow->TransformToUnitBox();
-
-	//Then obtain stretch factors to use for coordinate mapping
+	//Obtain stretch factors to use for coordinate mapping
 	//Don't apply a glScale to stretch the scene, because that would distort the arrow shape
 	const float* scales = DataStatus::getInstance()->getStretchFactors();
+
+	//The arrow head is ARROW_HEAD_FACTOR times wider than the shaft, 
+	//with its base set back from the end of the shaft:
+	arrowGeometry->SetRadius(rad);
+	arrowGeometry->SetArrowHead(ARROW_HEAD_FACTOR*rad, ARROW_HEAD_FACTOR*rad-rad, true);
+
+	//Place an arrow at each point of the rake grid, pointing along the field there.
+	//With data alignment the horizontal grid points are at voxel positions, otherwise
+	//at the centers of the rake grid cells.
+	const RegularGrid* field[3] = {variableData[0], variableData[1], variableData[2]};
+	int rc = arrowGeometry->BuildLattice(field, variableData[3], rakeExts, rakeGrid, 
+		aParams->IsAlignedToData(), fullUsrExts[2], scales, vectorLengthScale);
+	if (rc < 0) {
+		SetErrMsg(VAPOR_ERROR_DATA_UNAVAILABLE,"Unable to build arrows at timestep %d\n", timestep);
+		return -1;
+	}
+	return 0;
+}
+//Perform the openGL rendering:
+void ArrowRenderer::performRendering(){
+
+	ArrowParams* aParams = (ArrowParams*)currentRenderParams;
 	
+	//Perform setup of OpenGL transform matrix.  This transforms the full stretched domain into the unit box
+	//by scaling and translating.  The arrows are built in stretched coordinates.
+	myGLWindow->TransformToUnitBox();
+
 	//Set up lighting and color
 	
 	ViewpointParams* vpParams =  myGLWindow->getActiveViewpointParams();
@@ -319,90 +232,18 @@ void ArrowRenderer::performRendering(
 	}
 	glColor3fv(aParams->GetConstantColor());
 	
-	//Loop through the points in the rake grid, find the field vector at each grid point.
-	//Render an arrow at each point.
+	if (arrowGeometry->GetNumIndices() == 0) return;
 
-	float dirVec[3], endPoint[3], fltPnt[3];
-	double point[3];
-	
-	if (!aParams->IsAlignedToData()){
-		for (int k = 0; k<rakeGrid[2]; k++){
-			float pntz= (rakeExts[2]+(0.5+(float)k)* ((rakeExts[5]-rakeExts[2])/(float)rakeGrid[2]));
-			
-			for (int j = 0; j<rakeGrid[1]; j++){
-				point[1]= (rakeExts[1]+(0.5+(float)j )* ((rakeExts[4]-rakeExts[1])/(float)rakeGrid[1]));
-					
-				for (int i = 0; i<rakeGrid[0]; i++){
-					point[0] = (rakeExts[0]+ (0.5+(float)i )* ((rakeExts[3]-rakeExts[0])/(float)rakeGrid[0]));
-					bool missing = false;
-					float offset = 0.;
-					if (variableData[3]){
-						offset = variableData[3]->GetValue(
-							point[0], point[1], 0.
-						);
-						if (offset == variableData[3]->GetMissingValue()) {
-							missing = true;
-							offset = 0.;
-						}
-						offset = offset - fullUsrExts[2];
-					}
-					point[2]=pntz+offset;
-					for (int dim = 0; dim<3; dim++){
-						dirVec[dim]=0.f;
-						if (variableData[dim]){
-							dirVec[dim] = variableData[dim]->GetValue(point[0], point[1], point[2]);
-							if (dirVec[dim] == variableData[dim]->GetMissingValue()) {
-								missing = true;
-							}
-						}
-						endPoint[dim] = scales[dim]*(point[dim]+vectorLengthScale*dirVec[dim]);
-						fltPnt[dim]=(float)(point[dim]*scales[dim]);
-					}
-					
-					if (! missing) drawArrow(fltPnt, endPoint, rad);
-				}
-			}
-		}
-	} else {
-		for (int k = 0; k<rakeGrid[2]; k++){
-			float pntz= (rakeExts[2]+(0.5+(float)k)* ((rakeExts[5]-rakeExts[2])/(float)rakeGrid[2]));
-			
-			for (int j = 0; j<rakeGrid[1]; j++){
-				point[1]= (rakeExts[1]+((double)j )* ((rakeExts[4]-rakeExts[1])/(double)rakeGrid[1]));
-					
-				for (int i = 0; i<rakeGrid[0]; i++){
-					bool missing = false;
-					float offset = 0.;
-					point[0] = rakeExts[0]+ ((double)i )* ((rakeExts[3]-rakeExts[0])/(double)rakeGrid[0]);
-					if (variableData[3]){
-						offset = variableData[3]->GetValue(
-							point[0], point[1], 0.
-						);
-						if (offset == variableData[3]->GetMissingValue()) {
-							missing = true;
-						}
-						offset = offset - fullUsrExts[2];
-					}
-					point[2]=pntz+offset;
-					for (int dim = 0; dim<3; dim++){
-						dirVec[dim]=0.f;
-						if (variableData[dim]){
-							dirVec[dim] = variableData[dim]->GetValue(
-								point[0], point[1], point[2]
-							);
-							if (dirVec[dim] == variableData[dim]->GetMissingValue()) {
-								missing = true;
-							}
-						}
-						endPoint[dim] = scales[dim]*(point[dim]+vectorLengthScale*dirVec[dim]);
-						fltPnt[dim]=(float)(point[dim]*scales[dim]);
-					}
-					
-					if (! missing) drawArrow(fltPnt, endPoint, rad);
-				}
-			}
-		}
-	}
+	//Draw all the arrows at once.  They all have the constant color.
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, arrowGeometry->GetVertices());
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, 0, arrowGeometry->GetNormals());
+
+	glDrawElements(GL_TRIANGLES, (GLsizei)arrowGeometry->GetNumIndices(), GL_UNSIGNED_INT, arrowGeometry->GetIndices());
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
 }
 //Prepare data needed for rendering
 int ArrowRenderer::
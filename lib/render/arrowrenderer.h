@@ -22,6 +22,7 @@
 
 #include "vapor/RegularGrid.h"
 #include "renderer.h"
+#include "FlowGeometry.h"
 
 namespace VAPoR {
 
@@ -35,7 +36,7 @@ namespace VAPoR {
     virtual ~ArrowRenderer();
 	virtual void initializeGL();
 	virtual void paintGL();
-	virtual void setAllDataDirty(){} //No need to do anything.
+	virtual void setAllDataDirty(){geometryDirty = true;}
 
   protected:
 	//Method that gets the required data from the DataMgr, while determining valid extents.
@@ -45,17 +46,20 @@ namespace VAPoR {
 		size_t voxExts[6]
 	);
 
-	//Perform the OpenGL rendering
-	void performRendering(
-		int actualRefLevel,float vectorScale, float arrowRadius, 
-		RegularGrid *variableData[4]
-	);
+	//Build the arrow geometry from the data.
+	//Returns -1 on failure.
+	int buildGeometry(float vectorScale, float arrowRadius, RegularGrid *variableData[4]);
 
-	//Draw one arrow
-	void drawArrow(const float startPoint[3], const float endPoint[3], float radius);
+	//Perform the OpenGL rendering of the arrow geometry
+	void performRendering();
 
   private:
-
+	//Arrow geometry, with the data manager, settings and variables it was built from
+	FlowGeometry* arrowGeometry;
+	DataMgr* geometryDataMgr;
+	vector<double> geometryKey;
+	vector<string> geometryVars;
+	bool geometryDirty;
 
   };
 };
@@ -37,19 +37,40 @@
 #include <qcursor.h>
 
 #include "renderer.h"
+#include "RenderJobQueue.h"
 #include "mapperfunction.h"
 
 #ifdef WIN32
 #pragma warning(disable : 4996)
 #endif
 
-//Constants used for arrow design:
-//VERTEX_ANGLE = 45 degrees (angle between direction vector and head edge
-#define ARROW_LENGTH_FACTOR  0.90f //fraction of full length used by cylinder
+using namespace VAPoR;
+
+namespace VAPoR {
+//A SteadyFlowJob integrates the steady flow lines of a timestep on a worker
+//thread, with copies of the flow and region params made on the GL thread.
+class SteadyFlowJob : public RenderJob {
+public:
+	SteadyFlowJob() {flowParams = 0; regionParams = 0; flowLines = 0;}
+	~SteadyFlowJob() {delete flowParams; delete regionParams; delete flowLines;}
+	virtual int Run();
+	int timestep;
+	int minFrame;
+	FlowParams* flowParams;
+	RegionParams* regionParams;
+	//The renderer's versions when the job was made.  Not used by Run()
+	int version, mapVersion;
+	//Result, colored and stretched for rendering:
+	FlowLineData* flowLines;
+	//The error of a failed job, reported when it is installed on the GL thread
+	int errCode;
+	string errMsg;
+};
+};
+
 /*!
   Create a FlowRenderer 
 */
-using namespace VAPoR;
 FlowRenderer::FlowRenderer(GLWindow* glw, FlowParams* fParams )
 :Renderer(glw, fParams, "FlowRenderer")
 {
@@ -99,6 +120,13 @@ FlowRenderer::FlowRenderer(GLWindow* glw, FlowParams* fParams )
 	flowDisplayList = glGenLists(1);
 	wasConstColors = true;
 	dirtyDL = true;
+
+	pendingTimestep = -1;
+	dataVersion = pendingVersion = 0;
+	mapVersion = 0;
+	flowGeometry = new FlowGeometry();
+	geometrySource = 0;
+	geometryDirty = true;
 }
 
 
@@ -128,6 +156,7 @@ FlowRenderer::~FlowRenderer()
 	delete[] vertexArray;
 	delete[] indexArray;
 	glDeleteLists(flowDisplayList, 1);
+	delete flowGeometry;
 }
 
 
@@ -158,14 +187,30 @@ void FlowRenderer::paintGL()
 	constFlowColor[1] = qGreen(constRgb)/255.f;
 	constFlowColor[2] = qBlue(constRgb)/255.f;
 
+	//Install the steady flow lines integrated since the last rendering
+	if (flowType == 0){
+		SteadyFlowJob* job = (SteadyFlowJob*)takeCompletedJob();
+		if (job) installJob(job);
+	}
 	//Check if the cache needs rebuilding, and/or rgba's need rebuilding:
 	if ((flowDataIsDirty(timeStep) && needsRefresh(myFlowParams,timeStep))){
-		if(!rebuildFlowData(timeStep)) {
+		bool pending = (flowType == 0 && jobIsPending() && 
+			pendingTimestep == timeStep && pendingVersion == dataVersion);
+		if(!pending && !rebuildFlowData(timeStep)) {
 			if(myFlowParams->refreshIsAuto())setBypass(timeStep);
 			return;
 		}
-		didRebuild = true;
-		didRemap = true;
+		if (flowType == 0){
+			//Until the job completes, the flow lines last integrated are drawn.
+			//An image being captured must show the current timestep
+			if (myGLWindow->isCapturingImage()) waitForJob();
+			//The job may have completed already, as when jobs run when submitted
+			SteadyFlowJob* job = (SteadyFlowJob*)takeCompletedJob();
+			if (job) installJob(job);
+		} else {
+			didRebuild = true;
+			didRemap = true;
+		}
 	} else { //just rebuild the rgba's if necessary:
 		if (!constColors && flowMapIsDirty(timeStep)){
 			if (flowType != 1){
@@ -199,6 +244,8 @@ void FlowRenderer::paintGL()
 	}
 	if (!wasConstColors && constColors) didRemap = true;
 	//OK, now render the cache.  The rgba's were rebuilt too.
+	//The tube and arrow geometry needs to be rebuilt with them:
+	if (didRebuild || didRemap) geometryDirty = true;
 
 	/* Decide if the display list needs to be re-compiled. */
 	newType = lastShapeType != myFlowParams->getShapeType();
@@ -361,7 +408,7 @@ renderFlowData(bool constColors, int currentFrameNum){
 				//Note that lastDisplayFrame is maxPoints -1
 				//and firstDisplayFrame is 0
 				//
-				renderTubes(flowLineData,userRadius, (nLights > 0), 0, mxPoints-1, constColors);
+				renderGeometry(flowLineData, userRadius, 0, mxPoints-1, constColors, false);
 				
 			}
 		} else if (myFlowParams->getShapeType() == 1 ){ //rendering points 
@@ -375,7 +422,7 @@ renderFlowData(bool constColors, int currentFrameNum){
 			//Note that lastDisplayFrame is maxPoints -1
 			//and firstDisplayFrame is 0
 			//
-			renderArrows(flowLineData,userRadius, (nLights > 0), 0, mxPoints-1, constColors);
+			renderGeometry(flowLineData, userRadius, 0, mxPoints-1, constColors, true);
 		}
 
 	} else { //unsteady flow:
@@ -402,8 +449,8 @@ renderFlowData(bool constColors, int currentFrameNum){
 				
 				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 				//Render all tubes
-				renderTubes(flowLineData, userRadius, (nLights > 0), firstGeom, lastGeom,
-						constColors);
+				renderGeometry(flowLineData, userRadius, firstGeom, lastGeom,
+						constColors, false);
 				
 			}
 		} else if(myFlowParams->getShapeType() == 1) { //rendering points 
@@ -414,8 +461,8 @@ renderFlowData(bool constColors, int currentFrameNum){
 			
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 			
-			renderArrows(flowLineData,userRadius, (nLights > 0), firstGeom, lastGeom,
-					constColors);
+			renderGeometry(flowLineData, userRadius, firstGeom, lastGeom,
+					constColors, true);
 		}
 	} //End unsteady flow 
 	glDisable(GL_LIGHTING);
@@ -469,82 +516,6 @@ void FlowRenderer::initializeGL()
  ********************************************************************************/
 //  Issue OpenGL calls for point list
 
-//Issue OpenGL calls to draw a cylinder with orthogonal ends from one point to another.
-//color indexed by startIndex and startIndex+1
-//Orthogonal frame at first point is (dirVec, UVec, bVec)
-//U and B are orthog to direction of cylinder, determine plane for 6 points
-//
-void FlowRenderer::drawArrow(bool isLit, float* firstColor, float* startPoint, float *endPoint, float* dirVec, float* bVec, float* uVec, float radius, bool constMap) {
-
-	//Parameters that control arrow head:
-	float nextPoint[3];
-	float vertexPoint[3];
-	float headCenter[3];
-	
-	//Calculate nextPoint and vertexPoint, for arrowhead
-	for (int i = 0; i< 3; i++){
-		nextPoint[i] = (1. - ARROW_LENGTH_FACTOR)*startPoint[i]+ ARROW_LENGTH_FACTOR*endPoint[i];
-		vertexPoint[i] = nextPoint[i] + dirVec[i]*radius;
-		headCenter[i] = nextPoint[i] - dirVec[i]*(arrowHeadRadius-radius); 
-	}
-	// add two rings to vertex array, one for each end of the new tube
-	makeRing(vertexArray, &curVaIndex, firstColor+4, startPoint, bVec, uVec, radius, constMap);
-	makeRing(vertexArray, &curVaIndex, firstColor+4, nextPoint, bVec, uVec, radius, constMap);
-
-	// copy arrow's point to vertex array
-	vcopy(dirVec, vertexArray[curVaIndex2].normal);
-	vcopy(vertexPoint, vertexArray[curVaIndex2].vertex);
-	for (int j=0; j<4 && (!constMap); j++ ) vertexArray[curVaIndex2].color[j]= firstColor[4+j];
-	curVaIndex2++;
-
-	// add outer ring of arrowhead to vertex array
-	makeRing(vertexArray, &curVaIndex2, firstColor+4, nextPoint, bVec, uVec, arrowHeadRadius, constMap);
-}
-
-//Issue OpenGL calls to draw a cylinder from one point to another.
-//center points indexed by startIndex and startIndex+1
-//Orthogonal frame at first point is (dirVec, UVec, bVec)
-//U and B are orthog to direction of cylinder, determine plane for 6 points
-//Note that this has the side-effect of evaluating currentNormal and currentVertex,
-//Uses existing values of prevNormal, PrevVertex
-//
-
-void FlowRenderer::drawTube(bool isLit, float* secondColor, float endPoint[3], float* currentB, float* currentU, float radius, bool constMap) {
-
-	// just add a ring around this point to the vertex array, index array will handle the rest
-	makeRing(vertexArray, &curVaIndex, secondColor, endPoint, currentB, currentU, radius, constMap);
-}
-
-void FlowRenderer::makeRing(flowTubeVertexData* storage, unsigned int* offset, float* color_in, float* point_in, float* B_in, float* U_in, float radius_in, bool constMap)
-{
-
-	//Constants are needed for cosines and sines, at 60 degree intervals
-	const float sines[6] = {0.f, sqrt(3.)/2., sqrt(3.)/2., 0.f, -sqrt(3.)/2., -sqrt(3.)/2.};
-	const float coses[6] = {1.f, 0.5, -0.5, -1., -.5, 0.5};
-	float tmpVec[3],tmpVec2[3];
-
-	//calculate 6 points in plane orthog to currentA, in plane of endPoint:
-	for (int i = 0; i<6; i++){
-		//testVec and testVec2 are components of point in plane
-		vmult(U_in, coses[i], tmpVec);
-		vmult(B_in, sines[i], tmpVec2);
-
-		vadd(tmpVec, tmpVec2, storage[*offset].normal);
-		vmult(storage[*offset].normal,  radius_in, storage[*offset].vertex);
-		vadd(storage[*offset].vertex, point_in, storage[*offset].vertex);
-
-		if (!constMap) {
-			storage[*offset].color[0]= color_in[0];	//r
-			storage[*offset].color[1]= color_in[1];	//g
-			storage[*offset].color[2]= color_in[2];	//b
-			storage[*offset].color[3]= color_in[3];	//a
-		}
-				
-		/* increment vertexarray position */
-		(*offset)++;
-	}
-}
-
 //Render a symbol for stationary flowline (octahedron?)
 void FlowRenderer::renderStationary(float* point){
 	if (stationaryRadius <= 0.f) return;
@@ -635,6 +606,10 @@ void FlowRenderer::setFlowMapClean(int timeStep){
 
 void FlowRenderer::setDataDirty(bool doInterrupt)
 {
+	//Flow lines being integrated are no longer wanted
+	cancelJobs();
+	dataVersion++;
+	mapVersion++;
 	interruptFlag = doInterrupt;
 	FlowParams* myFlowParams = (FlowParams*)currentRenderParams;
 	setRegionValid(true);  // reset this bit so we will try to render again...
@@ -650,6 +625,7 @@ void FlowRenderer::setDataDirty(bool doInterrupt)
 		flowMapDirty[i] = true;
 		if (doRefresh) needRefreshFlag[i] = true; 
 	}
+	geometryDirty = true;
 }
 void FlowRenderer::setDisplayListDirty() 
 {
@@ -657,11 +633,13 @@ void FlowRenderer::setDisplayListDirty()
 }
 void FlowRenderer::setGraphicsDirty()
 {
+	mapVersion++;
 	allFlowMapDirtyFlag = true;
 	for (int i = 0; i< numFrames; i++){
 		flowMapDirty[i] = true;
 	}
 	dirtyDL = true;
+	geometryDirty = true;
 }
 bool FlowRenderer::
 flowDataIsDirty(int timeStep){
@@ -751,9 +729,10 @@ bool FlowRenderer::rebuildFlowData(int timeStep){
 		!(flowDataIsDirty(timeStep) && needsRefresh(myFlowParams,timeStep)) );
 	bool constColors = (myFlowParams->getColorMapEntityIndex() == 0);
 	
-	//Clean the dirty parts of cache, unless this is just a rebuild of the graphics:
+	//Clean the dirty parts of cache, unless this is just a rebuild of the graphics.
+	//Steady flow lines are replaced when the job integrating them completes.
 	bool OK = true;
-	if (!graphicsOnly){
+	if (!graphicsOnly && flowType != 0){
 		if (allFlowDataIsDirty()){
 			if (steadyFlowCache[timeStep]){
 				delete steadyFlowCache[timeStep];
@@ -796,8 +775,11 @@ bool FlowRenderer::rebuildFlowData(int timeStep){
 		int numTimestepsToRender;
 		switch (flowType) {
 			case (0): 
-				steadyFlowCache[timeStep] = myFlowParams->regenerateSteadyFieldLines(myFlowLib, 0, 0, timeStep, minFrame, rParams, false);
-				OK = (steadyFlowCache[timeStep] != 0);
+				//The flow lines are installed by paintGL() when the job completes
+				pendingTimestep = timeStep;
+				pendingVersion = dataVersion;
+				submitJob(makeJob(timeStep, rParams));
+				OK = true;
 				break;
 			case (1):
 				
@@ -1017,6 +999,82 @@ bool FlowRenderer::rebuildFlowData(int timeStep){
 	return OK;
 }
 
+//Capture the flow params and region of the steady flow lines at a timestep in a job.
+//The levels of the variables present are found on the GL thread, as DataStatus
+//caches them.
+SteadyFlowJob* FlowRenderer::makeJob(int timeStep, RegionParams* rParams){
+	FlowParams* myFlowParams = (FlowParams*)currentRenderParams;
+	DataStatus* ds = DataStatus::getInstance();
+	const int* steadyVarNums = myFlowParams->getSteadyVarNums();
+	const int* seedDistVarNums = myFlowParams->getSeedDistVarNums();
+	bool seedDist = myFlowParams->rakeEnabled() && myFlowParams->isRandom();
+	for (int i = 0; i<3; i++){
+		if (steadyVarNums[i] > 0){
+			ds->maxXFormPresent3D(steadyVarNums[i]-1, timeStep);
+			ds->maxLODPresent3D(steadyVarNums[i]-1, timeStep);
+		}
+		if (seedDist){
+			ds->maxXFormPresent3D(seedDistVarNums[i], timeStep);
+			ds->maxLODPresent3D(seedDistVarNums[i], timeStep);
+		}
+	}
+	if (myFlowParams->getColorMapEntityIndex() > 2){
+		const string& colorVar = myFlowParams->getColorMapEntity(myFlowParams->getColorMapEntityIndex());
+		ds->maxXFormPresent(colorVar, timeStep);
+		ds->maxLODPresent(colorVar, timeStep);
+	}
+
+	SteadyFlowJob* job = new SteadyFlowJob;
+	job->timestep = timeStep;
+	job->minFrame = minFrame;
+	job->flowParams = (FlowParams*)myFlowParams->deepCopy();
+	job->flowParams->showWaitCursor(false);
+	job->regionParams = (RegionParams*)rParams->deepCopy();
+	job->version = dataVersion;
+	job->mapVersion = mapVersion;
+	return job;
+}
+
+//Messages of the worker thread are diverted, and kept with the job.
+//The integration is not interrupted if the job is cancelled.
+int SteadyFlowJob::Run(){
+	bool diverted = MyBase::DivertThreadErrMsg(true);
+	errCode = VAPOR_ERROR_INTEGRATION;
+	VaporFlow flowLib(DataStatus::getInstance()->getDataMgr());
+	flowLines = flowParams->regenerateSteadyFieldLines(&flowLib, 0, 0, timestep, minFrame, regionParams, false);
+	int rc = flowLines ? 0 : -1;
+	errMsg = rc < 0 ? MyBase::GetThreadErrMsg() : "";
+	MyBase::DivertThreadErrMsg(diverted);
+	return rc;
+}
+
+//Put the flow lines integrated by a job in the cache, unless the data was set
+//dirty since the job was made.  The job is deleted.
+void FlowRenderer::installJob(SteadyFlowJob* job){
+	FlowParams* myFlowParams = (FlowParams*)currentRenderParams;
+	int timeStep = job->timestep;
+	if (job->version != dataVersion || myFlowParams->getFlowType() != 0){
+		delete job;
+		return;
+	}
+	if (job->GetStatus() < 0){
+		if (!job->errMsg.empty())
+			MyBase::SetErrMsg(job->errCode, "%s", job->errMsg.c_str());
+		if(myFlowParams->refreshIsAuto())setBypass(timeStep);
+		delete job;
+		return;
+	}
+	if (steadyFlowCache[timeStep]) delete steadyFlowCache[timeStep];
+	steadyFlowCache[timeStep] = job->flowLines;
+	job->flowLines = 0;
+	setFlowDataClean(timeStep);
+	//The job mapped the colors, unless the mapping has changed since
+	if (job->mapVersion == mapVersion) setFlowMapClean(timeStep);
+	geometryDirty = true;
+	dirtyDL = true;
+	delete job;
+}
+
 void FlowRenderer::
 setAllNeedRefresh(bool value){
 	int mxframe = DataStatus::getInstance()->getNumTimesteps()-1;
@@ -1189,8 +1247,7 @@ renderCurves(FlowLineData* flowLineData,float radius, bool isLit, int firstAge,
 	bool newcycle;
 	if (firstAge >= lastAge) return;
 	
-	/* (re)allocate memory for Vertex Array - Allocate the same memory as needed 
-	 for renderTubes, since they use the same type-number. */
+	/* (re)allocate memory for Vertex Array */
 	if ((lastAge>=0) && (lastAge > curVaSize || newType ||!vertexArray)) {
 		delete[] vertexArray;
 		vertexArray = new flowTubeVertexData[(lastAge+1)*6];
@@ -1335,632 +1392,66 @@ renderCurves(FlowLineData* flowLineData,float radius, bool isLit, int firstAge,
 	if (!constMap) glDisableClientState(GL_COLOR_ARRAY);
 	
 }
-//  Issue OpenGL calls for a cylindrical (hexagonal cross-section) tube 
-//  following the stream or Path line
+//  Draw the tubes or arrows along the stream or path lines.
+//  The geometry is built by a FlowGeometry, on worker threads, and kept until
+//  the flow data, its colors or the sizes and ages rendered change, so that
+//  a repaint only issues one glDrawElements call.
 //
 void FlowRenderer::
-renderTubes(FlowLineData* flowLineData, float radius, bool isLit, int firstAge, int lastAge,  bool constMap ){
-	
-	//Declare values used repeatedly (toggle between even and odd)
-	//Tube will actually be hexagonal
-	
-	float evenU[3];//vector in plane of points, orthog to A
-	float oddU[3];
-	
-	float evenN[3];//vector pointing in direction to next point
-	float oddN[3];
-	float evenA[3];//normalized average of previous and next N
-	float oddA[3];
-	float currentB[3];//Binormal, U cross A
-	float finalA[3], startA[3];
-	
-	float len;
-	float testVec[3];
-	
-	//Vectors to hold the start and end arrow coordinates.
-	//They may be translated due to periodic boundary conditions.
-	float startPoint[3], endPoint[3];
-	int newCycle[3],currentCycle[3];
-	bool newcycle;
-
-	if (firstAge >= lastAge) return;
-
-	/* (re)allocate memory for Vertex Array */
-	if (lastAge >= 0 && (lastAge > curVaSize || newType ||!vertexArray)) {
-		delete[] vertexArray;
-		vertexArray = new flowTubeVertexData[(lastAge+1)*6];
-
-		curVaSize = lastAge;
-
-		/* reallocate and rebuild index array */
-		delete[] indexArray;
-		indexArray = new unsigned int [lastAge*2*7];
-
-		int ib=0;
-		for (int ia=0; ia<curVaSize*7; ia++) {
-			/* every 7th index needs to repeat the first 2 verticies of the tube to close it */
-			if ((ia+1) % 7 == 0) {
-				indexArray[2*ia + 0] = (unsigned int) ib - 6;
-				indexArray[2*ia + 1] = (unsigned int) ib;
-			} else {
-				indexArray[2*ia + 0] = (unsigned int) ib;
-				indexArray[2*ia + 1] = (unsigned int) ib + 6;
-				ib++;
-			}
-		}
-	}
-
-	/* enable client states for vertex arrays*/
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 10*sizeof(float), ((float*)vertexArray)+7);
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glNormalPointer(GL_FLOAT, 10*sizeof(float), ((float*)vertexArray)+4);
-
-	if (!constMap){ 
-		glEnableClientState(GL_COLOR_ARRAY);
-		glColorPointer(4, GL_FLOAT, 10*sizeof(float), vertexArray);
-	}
-
-	for (int tubeNum = 0; tubeNum < flowLineData->getNumLines(); tubeNum++){
-		//Skip the tube entirely if first point is end-flow 
-		//This can occur in the middle of a Pathline, 
-		//also with flowLineData after it's left the region
-		
-		int firstIndex = Max(firstAge, flowLineData->getStartIndex(tubeNum));
-		int lastIndex = Min(lastAge, flowLineData->getEndIndex(tubeNum));
-		if (firstIndex >= lastIndex) continue;
-		float* point = flowLineData->getFlowPoint(tubeNum, firstIndex);
-		if(*point == END_FLOW_FLAG) continue;
-		//assert(*point != END_FLOW_FLAG);
-		//Cycle through the points looking for a valid tubeStartIndex.
-		//If the first one is at the end, we don't render anything
-		//
-		int tubeStartIndex;
-		bool stationaryStart = false;
-		curVaIndex = 0;
-		// first loop is just to find a start for the tube:
-		for (tubeStartIndex = firstIndex; tubeStartIndex < lastIndex; tubeStartIndex++){
-		 
-			point = flowLineData->getFlowPoint(tubeNum,tubeStartIndex);
-			if (*point == IGNORE_FLAG) assert(0); //continue;  
-			if (*point == STATIONARY_STREAM_FLAG) {
-				//if Multiple STATIONARY_FLAGS, it's a bug...
-				if (stationaryStart) {
-					assert(0);
-					stationaryStart = false;
-					tubeStartIndex = lastIndex;
-					break;
-				}
-				stationaryStart = true;
-				continue;
-			}
-			//At this point we know it's a valid point
-			assert (*point != END_FLOW_FLAG);
-			break;
-		}
-		//check if we didn't find anything.  Possibly render a solitary
-		//stationary point if we didn't find anything else.
-		if (tubeStartIndex == lastIndex){
-			if (stationaryStart) {
-				point = flowLineData->getFlowPoint(tubeNum, tubeStartIndex);
-				renderStationary(point);
-			}
-			break;
-		}
-		//Check if the first point was preceded by stationary flag:
-		if (stationaryStart){
-			point = flowLineData->getFlowPoint(tubeNum, tubeStartIndex);
-			renderStationary(point);
-		}
-		assert(tubeStartIndex < lastIndex);
-
-		//startTube( intput: tubeStartIndex, flowRGBAs constFlowColor, flowDataArray, 
-
-		//output: point [continue, or break??], evenA, len, evenN, evenU
-
-		//OK, we are at the start of a real tube.
-		//Start the colors for the start of the tube 
-		if (!constMap){
-			float* rgba = flowLineData->getFlowRGBAs(tubeNum, tubeStartIndex);
-			glColor4fv(rgba);
-		} else {
-			 glColor4fv(constFlowColor);
-		}
-		//Check if the second point is a stationary flag:
-		if (*(flowLineData->getFlowPoint(tubeNum, (tubeStartIndex+1))) == STATIONARY_STREAM_FLAG) {
-			//If so just render the stationary symbol, and we are done.
-			float *point = flowLineData->getFlowPoint(tubeNum, (tubeStartIndex));
-			renderStationary(point);
-			continue;
-		} else if (*(flowLineData->getFlowPoint(tubeNum, (tubeStartIndex+1))) == END_FLOW_FLAG) {//render nothing:
-				//We could potentially have the second point be an end flow flag
-				continue;
-		} else {  //OK, now we can render a tube:
-			
-			
-			//data point is three floats starting at data[3*tubeStartIndex]
-			//evenA is the direction the line is pointing
-			vsub(flowLineData->getFlowPoint(tubeNum, tubeStartIndex+1), flowLineData->getFlowPoint(tubeNum, tubeStartIndex), evenA);
-			//Normalize evenA
-			len = vdot(evenA,evenA);
-			if (len == 0.f){//If 2nd is same as first set default normal
-				vset(evenA, 0.f,0.f,1.f);
-			} else {
-				vscale(evenA, 1.f/sqrt(len));
-			}
-			//The first time, N is equal to A:
-			vcopy(evenA, evenN);
-			//Calculate evenU, orthogonal to evenA:
-			vset(testVec, 1.,0.,0.);
-			vcross(evenA, testVec, evenU);
-			len = vdot(evenU,evenU);
-			if (len == 0.f){
-				vset(testVec, 0.,1.,0.);
-				vcross(evenA, testVec, evenU);
-				len = vdot(evenU, evenU);
-				assert(len != 0.f);
-			} 
-			vscale( evenU, 1.f/sqrt(len));
-			vcross(evenU, evenA, currentB);
-			
-			//copy first normal for endcap
-			vcopy(evenA, startA);
-
-
-			//Now render the cylinders:
-			//loop over points, starting with no. 1.
-			//toggle even and odd.
-			float* currentN;
-			float* currentU;
-			float* currentA = 0;
-			float* prevN;
-			float* prevA;
-			float* prevU;
-			
-			
-
-			//prepare to render the first cylinder in the tube.
-			currentCycle[0]=currentCycle[1]=currentCycle[2]=0;
-			newcycle = false;
-
-			bool currentIsEven = false;
-			int tubeIndex;				
-			
-			for (tubeIndex = tubeStartIndex+1; tubeIndex <= lastIndex; tubeIndex++){
-				point = flowLineData->getFlowPoint(tubeNum, tubeIndex);
-				if (*point == END_FLOW_FLAG || *point == STATIONARY_STREAM_FLAG) break;
-				//Toggle the meaning of "current" and "prev"
-				//First time thru current is odd
-				if (currentIsEven) {
-					currentN = evenN;
-					prevN = oddN;
-					currentA = evenA;
-					prevA = oddA;
-					currentU = evenU;
-					prevU = oddU;
-					currentIsEven = false;
-				} else {
-					currentN = oddN;
-					prevN = evenN;
-					currentA = oddA;
-					prevA = evenA;
-					currentU = oddU;
-					prevU = evenU;
-					currentIsEven = true;
-				}
-				
-				//Calc currentN
-				vsub(point, point-3, currentN);
-				//Normalize currentN:
-				len = vdot(currentN,currentN);
-				if (len == 0.f){// keep previous normal
-					vcopy(prevN,currentN);
-				} else {
-					vscale(currentN, 1.f/sqrt(len));
-				}
-				//Calc currentA, as sum (average) of prevN and currentN:
-				vadd(prevN, currentN, currentA);
-				//Normalize currentA
-				len = vdot(currentA,currentA);
-				if (len == 0.f){// keep previous normal
-					vcopy(prevA,currentA);
-				} else {
-					vscale(currentA, 1.f/sqrt(len));
-				}
-				//Now get next U, by projecting previous U orthog to currentA:
-				vmult(currentA, vdot(prevU,currentA), testVec);
-				vsub(prevU, testVec, currentU);
-				//Now normalize it:
-				len = vdot(currentU, currentU);
-				if (len == 0.f){
-					//If U is in direction of A, the previous A should work
-					vcopy(prevA, currentU);
-					len = vdot(currentU, currentU);
-					assert(len != 0.f);
-				} 
-				vscale(currentU, 1.f/sqrt(len));
-				vcross(currentU, currentA, currentB);
-				
-				if(tubeIndex > tubeStartIndex+1) {
-					//For each tube after the first, 
-					// the new tube goes from previous endpoint to mapping of point
-					//and map the endPoint in the same cycle as the startPoint:
-					vcopy(endPoint, startPoint);
-					newcycle = mapPeriodicCycle(point, endPoint, currentCycle, newCycle);
-				} else { //first time through, startPoint is point-3, endPoint is point
-					//Establish the first cycle, use it for first two points:
-					bool modifiedCycle = mapPeriodicCycle(point-3, startPoint, currentCycle, newCycle);
-					if (modifiedCycle) {
-						//remap start point
-						mapPeriodicCycle(point-3, startPoint, newCycle, currentCycle);
-					}
-					newcycle = mapPeriodicCycle(point, endPoint, currentCycle, newCycle);
-					
-					/* add first ring before looping through the rest */
-					makeRing(vertexArray, &curVaIndex, flowLineData->getFlowRGBAs(tubeNum,tubeIndex), startPoint, currentB, currentU, radius, constMap);
-				}
-				drawTube(isLit, flowLineData->getFlowRGBAs(tubeNum,tubeIndex), endPoint, currentB, currentU, radius, constMap);
-
-				//If the tube exited the region (in cyclic case) need to reset the points.  Note that
-				//the direction vectors don't need to be changed:
-				if (newcycle){
-					float nextStartPoint[3];
-					//Establish a new cycle for a translate of the last tube endpoint:
-					newcycle = mapPeriodicCycle(point, endPoint, newCycle, currentCycle);
-					assert(!newcycle);
-					//Also map the startPoint to the same cycle, but we don't use the resulting cycle
-					mapPeriodicCycle(point-3, nextStartPoint, currentCycle, newCycle);
-					
-					/* Render the current geometry & restart rendering in new position */
-					for (int ii = 0; ii+1 < curVaIndex/6; ii++) glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, &indexArray[ii*2*7]);
-					curVaIndex = 0;
-					
-					//Render the translation of the previous tube.  Note that we will need to first specify
-					//translated values for prevVertex.  prevNormal is OK.  The resulting values
-					//in currentVertex are translated appropriately, since they are offset from endPoint
-					//The repeated segment needs to translate prevVertex accordingly
-					
-					drawTube(isLit, flowLineData->getFlowRGBAs(tubeNum, tubeIndex),  endPoint, currentB, currentU, radius, constMap);
-				}
-			}
-
-			//Draw an end-cap on the cylinder, and potentially a stationary symbol:
-			vcopy(currentA, finalA);
-			if ((*point) == STATIONARY_STREAM_FLAG)
-				renderStationary(point-3);
-			
-		} //end of one tube rendering.  
-		//Hack for field line advection:  draw one or two points at end:
-		FlowParams* myFlowParams = (FlowParams*)getRenderParams();
-		if(myFlowParams->getFlowType()==2 && tubeStartIndex+1 < lastIndex){
-			
-			point = flowLineData->getFlowPoint(tubeNum, lastIndex+1);
-			if(*point != END_FLOW_FLAG && *point != STATIONARY_STREAM_FLAG){
-				renderStationary(point);
-				point = flowLineData->getFlowPoint(tubeNum, lastIndex+2);
-				if(*point == STATIONARY_STREAM_FLAG){
-					point = flowLineData->getFlowPoint(tubeNum, lastIndex+3);
-					if(*point != END_FLOW_FLAG && *point != STATIONARY_STREAM_FLAG)
-						renderStationary(point);
-				}
-			}
-		}
-		
-		/* render VA for this tube*/
-		for (int ii = 0; ii+1 < curVaIndex/6; ii++) {
-			//glDrawRangeElements(GL_TRIANGLE_STRIP, ii*6, (ii+2)*6-1, 14, GL_UNSIGNED_INT, &indexArray[ii*2*7]);
-			glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, &indexArray[ii*2*7]);
-		}
-
-		/* render endcaps from first/last hexagon in vertexArray if there's a tube*/
-		if (curVaIndex >= 12) { 
-			glDisableClientState(GL_NORMAL_ARRAY);
-			glNormal3fv(startA);
-			glDrawArrays(GL_POLYGON, 0, 6);
-			glNormal3fv(finalA);
-			glDrawArrays(GL_POLYGON, curVaIndex-6, 6);
-			glEnableClientState(GL_NORMAL_ARRAY);
-		}
-		
-
-		printOpenGLError();
-	} //end of loop over seedPoints
-
-	/* disable the other client states, so we don't accidentally interfere w/ other renderers */
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_NORMAL_ARRAY);
-	if (!constMap) glDisableClientState(GL_COLOR_ARRAY);
-	
-}
-//  Issue OpenGL calls for a cylindrical (hexagonal cross-section) arrow 
-//  following the stream or Path line
-//  tubeNum specifies which tube in the flowdata array to render
-//
-void FlowRenderer::
-renderArrows(FlowLineData* flowLineData, float radius, bool isLit, int firstAge, int lastAge,  bool constMap ){
-	
-	//Declare values used repeatedly (toggle between even and odd)
-	//Tube will actually be hexagonal
-	
-	float evenU[3];//vector in plane of points, orthog to A
-	float oddU[3];
-	
-	float evenN[3];//vector pointing in direction to next point
-	float oddN[3];
-	
-	float currentB[3];//Binormal, U cross A
-	
-	float len;
-	float testVec[3];
-	
-	if (firstAge >= lastAge) return;
-
-	//Vectors to hold the start and end arrow coordinates.
-	//They may be translated due to periodic boundary conditions.
-	float startPoint[3], endPoint[3];
-	int newCycle[3],currentCycle[3];
-	bool newcycle;
-
-	if ((lastAge >= 0) && (lastAge > curVaSize || newType ||!vertexArray)) {
-		curVaSize = lastAge;
-
-		/* realloc vertex array */
-		delete[] vertexArray;
-		vertexArray = new flowTubeVertexData[(curVaSize+1)*(6*2 + 7)]; //12/tube + 7/arrowhead
-
-		/* realloc, rebuild index array */
-		delete[] indexArray;
-		indexArray = new unsigned int [curVaSize*(2*7+8)]; // 14/tube + 8/arrowhead
+renderGeometry(FlowLineData* flowLineData, float radius, int firstAge, int lastAge, bool constMap, bool arrows){
+	FlowParams* myFlowParams = (FlowParams*)currentRenderParams;
 
-		int ib=0;
-		/* loop over tube indicies */
-		for (int ia=0; ia<curVaSize*7; ia++) {
-			if ((ia+1) % 7 == 0) {
-				indexArray[2*ia + 0] = (unsigned int) ib - 6;
-				indexArray[2*ia + 1] = (unsigned int) ib;
-				ib+=6; 
-			} else {
-				indexArray[2*ia + 0] = (unsigned int) ib;
-				indexArray[2*ia + 1] = (unsigned int) ib + 6;
-				ib++;
-			}
-		}
-		/* loop over arrowhead indicies */
-		ib = (curVaSize+1)*6*2;
-		for (int ia=curVaSize*2*7; ia<curVaSize*(2*7+8); ia++) {
-			if ((ia-curVaSize*2*7+1) % 8 == 0) {
-				indexArray[ia] = (unsigned int) ib - 6;
-			} else {
-				indexArray[ia] = (unsigned int) ib;
-				ib++;
-			}
+	//Everything the geometry depends on, besides the flow data:
+	vector<float> key;
+	key.push_back((float)arrows);
+	key.push_back((float)firstAge);
+	key.push_back((float)lastAge);
+	key.push_back(radius);
+	key.push_back(arrowHeadRadius);
+	key.push_back(stationaryRadius);
+	key.push_back((float)constMap);
+	for (int i = 0; i<4; i++) key.push_back(constFlowColor[i]);
+	for (int i = 0; i<3; i++) key.push_back((float)myFlowParams->getPeriodicDim(i));
+	for (int i = 0; i<6; i++) key.push_back(periodicExtents[i]);
+	key.push_back((float)myFlowParams->getFlowType());
+
+	if (geometryDirty || flowLineData != geometrySource || key != geometryKey){
+		bool periodic[3];
+		for (int i = 0; i<3; i++) periodic[i] = myFlowParams->getPeriodicDim(i);
+		flowGeometry->SetPeriodic(periodic, periodicExtents);
+		flowGeometry->SetRadius(radius);
+		flowGeometry->SetArrowHead(arrowHeadRadius, 0.f, false);
+		flowGeometry->SetStationaryRadius(stationaryRadius);
+		flowGeometry->SetColor(constFlowColor);
+		int rc;
+		if (arrows)
+			rc = flowGeometry->BuildArrows(flowLineData, firstAge, lastAge, constMap);
+		else
+			rc = flowGeometry->BuildTubes(flowLineData, firstAge, lastAge, constMap, myFlowParams->getFlowType() == 2);
+		if (rc < 0) {
+			geometryDirty = true;
+			return;
 		}
+		geometryDirty = false;
+		geometrySource = flowLineData;
+		geometryKey = key;
 	}
+	if (flowGeometry->GetNumIndices() == 0) return;
 
-	/* enable client states for vertex arrays*/
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 10*sizeof(float), ((float*)vertexArray)+7);
+	glVertexPointer(3, GL_FLOAT, 0, flowGeometry->GetVertices());
 	glEnableClientState(GL_NORMAL_ARRAY);
-	glNormalPointer(GL_FLOAT, 10*sizeof(float), ((float*)vertexArray)+4);
+	glNormalPointer(GL_FLOAT, 0, flowGeometry->GetNormals());
+	glEnableClientState(GL_COLOR_ARRAY);
+	glColorPointer(4, GL_FLOAT, 0, flowGeometry->GetColors());
 
-	if (!constMap){ 
-		glEnableClientState(GL_COLOR_ARRAY);
-		glColorPointer(4, GL_FLOAT, 10*sizeof(float), vertexArray);
-	}
+	glDrawElements(GL_TRIANGLES, (GLsizei)flowGeometry->GetNumIndices(), GL_UNSIGNED_INT, flowGeometry->GetIndices());
 
-	for (int tubeNum = 0; tubeNum < flowLineData->getNumLines(); tubeNum++){
-		//Skip the tube entirely if first point is end-flow 
-		//This can occur in the middle of a Pathline, but not with flowLineData!
-		//float* point = flowDataArray + 3*(startIndex+tubeNum*maxPoints +firstAge);
-		int firstIndex = Max(firstAge, flowLineData->getStartIndex(tubeNum));
-		int lastIndex = Min(lastAge, flowLineData->getEndIndex(tubeNum));
-		if (firstIndex >= lastIndex) continue;
-		float* point = flowLineData->getFlowPoint(tubeNum, firstIndex);
-		curVaIndex = 0;
-		curVaIndex2 = (curVaSize+1)*6*2;
-		
-		assert(*point != END_FLOW_FLAG);
-		//Cycle through the points looking for a valid tubeStartIndex.
-		//If the first one is at the end, we don't render anything
-		//
-		int tubeStartIndex;
-		bool stationaryStart = false;
-		// first loop is just to find a start for the tube:
-		for (tubeStartIndex = firstIndex; tubeStartIndex < lastIndex; tubeStartIndex++){
-		 
-			point = flowLineData->getFlowPoint(tubeNum,tubeStartIndex);
-			if (*point == IGNORE_FLAG) assert(0); //continue;  
-			if (*point == STATIONARY_STREAM_FLAG) {
-				//if Multiple STATIONARY_FLAGS, it's a bug...
-				if (stationaryStart) {
-					assert(0);
-					stationaryStart = false;
-					tubeStartIndex = lastIndex;
-					break;
-				}
-				stationaryStart = true;
-				continue;
-			}
-			//At this point we know it's a valid point
-			assert (*point != END_FLOW_FLAG);
-			break;
-		}
-		//check if we didn't find anything.  Possibly render a solitary
-		//stationary point if we didn't find anything else.
-		if (tubeStartIndex == lastIndex){
-			if (stationaryStart) {
-				point = flowLineData->getFlowPoint(tubeNum, tubeStartIndex);
-				renderStationary(point);
-			}
-			break;
-		}
-		//Check if the first point was preceded by stationary flag:
-		if (stationaryStart){
-			point = flowLineData->getFlowPoint(tubeNum, tubeStartIndex);
-			renderStationary(point);
-		}
-		assert(tubeStartIndex < lastIndex);
-
-		//OK, we are at the start of a real tube.
-		//Start the colors for the start of the tube 
-		if (!constMap) glColor4fv(flowLineData->getFlowRGBAs(tubeNum, tubeStartIndex));
-		else glColor4fv(constFlowColor);
-
-		//Check if the second point is a stationary flag:
-		if (*(flowLineData->getFlowPoint(tubeNum, (tubeStartIndex+1))) == STATIONARY_STREAM_FLAG) {
-			//If so just render the stationary symbol, and we are done.
-			float *point = flowLineData->getFlowPoint(tubeNum, (tubeStartIndex));
-			renderStationary(point);
-			continue;
-		} else if (*(flowLineData->getFlowPoint(tubeNum, (tubeStartIndex+1))) == END_FLOW_FLAG) {//render nothing:
-				//We could potentially have the second point be an end flow flag
-				continue;
-		} else {  //OK, now we can render a tube:
-
-			currentCycle[0]=currentCycle[1]=currentCycle[2]=0;
-			newcycle = false;
-		
-			
-			//data point is three floats starting at data[3*tubeStartIndex]
-			//evenN is the direction the line is pointing
-			vsub(flowLineData->getFlowPoint(tubeNum,(tubeStartIndex+1)), flowLineData->getFlowPoint(tubeNum,tubeStartIndex), evenN);
-			//Normalize even
-			len = vdot(evenN,evenN);
-			if (len == 0.f || len > 1.e36f ){//If 2nd is same as first set default normal
-				vset(evenN, 0.f,0.f,1.f);
-			} else {
-				vscale(evenN, 1.f/sqrt(len));
-			}
-			
-			//Calculate evenU, orthogonal to evenN:
-			vset(testVec, 1.,0.,0.);
-			vcross(evenN, testVec, evenU);
-			len = vdot(evenU,evenU);
-			if (len == 0.f){
-				vset(testVec, 0.,1.,0.);
-				vcross(evenN, testVec, evenU);
-				len = vdot(evenU, evenU);
-				assert(len != 0.f);
-			} 
-			vscale( evenU, 1.f/sqrt(len));
-			vcross(evenU, evenN, currentB);
-			
-			//Now loop over points, starting with no. 1.
-			//toggle even and odd.
-			float* currentN;
-			float* currentU;
-			float* prevN;
-			float* prevU;
-			
-			//tubeIndex counts the arrow coords along the data,
-			//tubeIndex is pointNum +startIndex+tubeNum*maxPoints
-			for (int tubeIndex = tubeStartIndex+1; tubeIndex <= lastIndex; tubeIndex++){
-				point = flowLineData->getFlowPoint(tubeNum,tubeIndex);
-			//for (int pointNum = firstAge+ 1; pointNum <= lastAge; pointNum++){
-			//	point = flowDataArray+3*(startIndex+tubeNum*maxPoints+pointNum);
-				if (*point == END_FLOW_FLAG || *point == STATIONARY_STREAM_FLAG) break;
-				//Toggle the meaning of "current" and "prev"
-				if (0 == (tubeIndex-tubeStartIndex)%2) {
-					currentN = evenN;
-					prevN = oddN;
-					currentU = evenU;
-					prevU = oddU;
-				} else {
-					currentN = oddN;
-					prevN = evenN;
-					currentU = oddU;
-					prevU = evenU;
-				}
-				
-				//Calc currentN
-				vsub(point, point-3, currentN);
-				//Normalize currentN:
-				len = vdot(currentN,currentN);
-				if (len == 0.f){// keep previous direction vector
-					vcopy(prevN,currentN);
-				} else {
-					vscale(currentN, 1.f/sqrt(len));
-				}
-				
-				//Now get next U, by projecting previous U orthog to currentN:
-				vmult(currentN, vdot(prevU,currentN), testVec);
-				vsub(prevU, testVec, currentU);
-				//Now normalize it:
-				len = vdot(currentU,currentU);
-				if (len == 0.f){
-					//If U is in direction of N, the previous N should work
-					vcopy(prevN, currentU);
-					len = vdot(currentU, currentU);
-					assert(len != 0.f);
-				} 
-				vscale(currentU, 1.f/sqrt(len));
-				vcross(currentU, currentN, currentB);
-				
-				
-				if(tubeIndex > tubeStartIndex+1) {
-					//For each arrow after the first, 
-					// the new arrow goes from previous endpoint to mapping of point
-					//and map the endPoint in the same cycle as the startPoint:
-					vcopy(endPoint, startPoint);
-					newcycle = mapPeriodicCycle(point, endPoint, currentCycle, newCycle);
-				} else { //first time through, startPoint is point-3, endPoint is point
-					//Establish the first cycle, use it for first two points:
-					bool modifiedCycle = mapPeriodicCycle(point-3, startPoint, currentCycle, newCycle);
-					if (modifiedCycle) mapPeriodicCycle(point-3, startPoint, newCycle, currentCycle);
-					//Then put the second point into the same cycle
-					newcycle = mapPeriodicCycle(point, endPoint, currentCycle, newCycle);
-					//vcopy(point-3, startPoint);
-					//vcopy(point, endPoint);
-				}
-				if (vdist(startPoint,endPoint) > 1.e-10)
-					drawArrow(isLit, flowLineData->getFlowRGBAs(tubeNum,tubeIndex-1), startPoint, endPoint, currentN, currentB, currentU, radius, constMap);
-
-				//If the arrow exited the region (in cyclic case) need to restart the points.  Note that
-				//the direction vectors don't need to be changed:
-				if (newcycle){
-					//Establish a new cycle for a translate of the last arrow endpoint:
-					newcycle = mapPeriodicCycle(point, endPoint, newCycle, currentCycle);
-					assert(!newcycle);
-					//Also map the startPoint to the same cycle, but we don't use the resulting cycle
-					mapPeriodicCycle(point-3, startPoint, currentCycle, newCycle);
-					
-					/* Render the current geometry & restart rendering in new position */
-					for (int ii = 0; ii+1 < curVaIndex/12; ii++) glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, &indexArray[ii*2*7]);
-					for (int ii = 0; ii+1 < curVaIndex/12; ii++) glDrawArrays(GL_POLYGON, ii*(2*6+0), 6);
-					for (int ii = 0; ii+1 < curVaIndex/12; ii++) glDrawElements(GL_TRIANGLE_FAN, 8, GL_UNSIGNED_INT, &indexArray[curVaSize*2*7 + ii*8]);
-					curVaIndex = 0;
-					curVaIndex2 = (curVaSize+1)*6*2;
-					
-					//Then render the new (cyclically offset) arrow:
-					drawArrow(isLit, flowLineData->getFlowRGBAs(tubeNum,tubeIndex-1), startPoint, endPoint, currentN, currentB, currentU, radius, constMap);
-				}
-				
-				
-				if ((*point) == STATIONARY_STREAM_FLAG)
-					renderStationary(point-3);
-			} //end of arrows along one flow line
-			
-		} //legitimate flow line
-
-		//Render tubes
-		for (int ii = 0; ii < curVaIndex/12; ii++) 
-			glDrawElements(GL_TRIANGLE_STRIP, 14, GL_UNSIGNED_INT, &indexArray[ii*2*7]);
-		
-		//Render endcaps
-		for (int ii = 0; ii < curVaIndex/12; ii++)
-			glDrawArrays(GL_POLYGON, ii*(2*6+0), 6);
-
-		//Render arrowheads
-		for (int ii = 0; ii < curVaIndex/12; ii++)
-			glDrawElements(GL_TRIANGLE_FAN, 8, GL_UNSIGNED_INT, &indexArray[curVaSize*2*7 + ii*8]);
-
-	} //end of loop over seedPoints
-	//Special symbol at stationary flow:
-
-	/* disable the other client states, so we don't accidentally interfere w/ other renderers */
+	/* disable the client states, so we don't accidentally interfere w/ other renderers */
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_NORMAL_ARRAY);
-	if (!constMap) glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	printOpenGLError();
 }
 //Turn off all the need refresh flags, as when autoRefresh is enabled.
 //Return true if anything was dirty, that would indicate the need to enable
@@ -24,7 +24,9 @@
 #include "assert.h"
 #include "renderer.h"
 #include "flowparams.h"
+#include "FlowGeometry.h"
 namespace VAPoR {
+class SteadyFlowJob;
 
 struct flowTubeVertexData {
 		float color [4];
@@ -123,24 +125,16 @@ protected:
 	//do it with FlowLineData:
 	void renderFlowData(bool constColors, int currentFrameNum);
 	
-	void renderTubes(FlowLineData*, float radius, bool isLit, int firstAge, int lastAge,  bool constMap);
 	void renderCurves(FlowLineData*, float radius, bool isLit, int firstAge, int lastAge,  bool constMap);
 	void renderPoints(FlowLineData*, float radius, int firstAge, int lastAge,  bool constMap);
-	void renderArrows(FlowLineData*, float radius, bool isLit, int firstAge, int lastAge,  bool constMap);
+	//Render tubes or arrows, rebuilding their geometry if needed
+	void renderGeometry(FlowLineData*, float radius, int firstAge, int lastAge, bool constMap, bool arrows);
 	
 	
 	//convert original coordinates to lie inside central cycle.  Identify the cycle it's in
 	bool mapPeriodicCycle(float origCoord[3], float mappedCoord[3], int oldcycle[3], int newcycle[3]);
 	// Render a "stationary symbol" at the specified point
 	void renderStationary(float* point);
-	//draw one arrow
-	void drawArrow(bool isLit, float* firstColor, float* firstPoint, float* endPoint, float* dirVec, float* bVec, 
-		float* UVec, float radius, bool constMap);
-	// draw one cylinder of tube
-	void drawTube(bool isLit, float* secondColor, float* endPoint, float* currentB, float* currentU, 
-		float radius, bool constMap);
-	// add 6 point orthogonal to point_in to storage array at offset
-	void makeRing(flowTubeVertexData* storage, unsigned int* offset, float* color_in, float* point_in, float* B_in, float* U_in, float radius_in, bool constMap);
 
 	//Constants that are used, recalculated in each rendering:
 	float constFlowColor[4];
@@ -212,8 +206,8 @@ protected:
 
 	/* array to hold data for tube verticies, normals and colors */
 	flowTubeVertexData	 *vertexArray;
-	/* index array, and counters for tubes and arrows */
-	unsigned int curVaIndex, curVaIndex2, curVaSize, *indexArray;
+	/* index array, and counters for points and curves */
+	unsigned int curVaIndex, curVaSize, *indexArray;
 	int lastShapeType;
 
 	/* markers used for display list logic */
@@ -221,6 +215,23 @@ protected:
 	/* id for display list(s) */
 	GLuint flowDisplayList;
 
+	/* tube and arrow geometry, with the flow data and settings it was built from */
+	FlowGeometry* flowGeometry;
+	FlowLineData* geometrySource;
+	vector<float> geometryKey;
+	bool geometryDirty;
+
+	//Steady flow lines are integrated by jobs run on worker threads.
+	//Unsteady flow and field line advection build on the flow of earlier
+	//timesteps, and are integrated in paintGL().
+	SteadyFlowJob* makeJob(int timeStep, RegionParams* rParams);
+	void installJob(SteadyFlowJob* job);
+	int pendingTimestep;
+	//Incremented when the data or the color mapping is set dirty, so that
+	//jobs made before can be recognized
+	int dataVersion, pendingVersion;
+	int mapVersion;
+
 };
 };
 
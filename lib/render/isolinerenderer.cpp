@@ -36,12 +36,48 @@
 #include <sstream>
 #include <string>
 #include "textRenderer.h"
+#include "RenderJobQueue.h"
+#include "IsolineExtractor.h"
 using namespace VAPoR;
 
+namespace VAPoR {
+//An IsolineJob captures, on the GL thread, what is needed to extract the isolines
+//of a timestep.  It reads the data, samples the plane and extracts the isolines on
+//a worker thread.
+class IsolineJob : public RenderJob {
+public:
+	virtual int Run();
+	int timestep;
+	vector<string> varname;
+	double extents[6];
+	int refLevel;
+	int lod;
+	bool is3D;
+	double transformMatrix[12];
+	float a[2], b[2];
+	double userExts[3];
+	float sizes[3];
+	vector<double> isovals;
+	bool annotate;
+	//Results:
+	int gridSize;
+	IsolineExtractor extractor;
+	//The error of a failed job, reported when it is installed on the GL thread
+	int errCode;
+	string errMsg;
+private:
+	int extract();
+	bool mayCross(DataMgr* dataMgr);
+};
+};
+
 IsolineRenderer::IsolineRenderer(GLWindow* glw, IsolineParams* pParams )
 :Renderer(glw, pParams, "IsolineRenderer")
 {
 	numIsovalsCached = 0;
+	shownJob = 0;
+	pendingTimestep = -1;
+	failedTimestep = -1;
 	setupCache();
 }
 
@@ -62,7 +98,7 @@ IsolineRenderer::~IsolineRenderer()
 	lineCache.clear();
 	
 	myGLWindow->clearTextObjects(this);
-	
+	if (shownJob) delete shownJob;
 }
 
 
@@ -78,17 +114,35 @@ void IsolineRenderer::paintGL()
 
 	int timestep = myGLWindow->getActiveAnimationParams()->getCurrentTimestep();
 
-	if (!cacheIsValid(timestep) || myGLWindow->textRenderersAreDirty()){
-		if (!buildLineCache(timestep)) return;
+	//Install the isolines extracted since the last paint
+	IsolineJob* job = (IsolineJob*)takeCompletedJob();
+	if (job) installJob(job);
+
+	if (!cacheIsValid(timestep)){
+		//Extract the isolines on a worker thread.  The window is repainted when
+		//they are ready; meanwhile the isolines last extracted are drawn.
+		if (timestep != failedTimestep && (!jobIsPending() || timestep != pendingTimestep)){
+			job = makeJob(timestep);
+			if (!job) return;
+			pendingTimestep = timestep;
+			failedTimestep = -1;
+			submitJob(job);
+		}
+		//An image being captured must show the current timestep
+		if (myGLWindow->isCapturingImage()) waitForJob();
+		//The job may have completed already, as when jobs run when submitted
+		job = (IsolineJob*)takeCompletedJob();
+		if (job) installJob(job);
+	} else if (myGLWindow->textRenderersAreDirty()){
+		if (shownJob && shownJob->timestep == timestep) buildAnnotation(shownJob);
+		else if (!buildLineCache(timestep)) return;
 	}
-		
 
-	
 	//
 	//Perform OpenGL rendering of line segments
 	//
-	performRendering(timestep);
-	
+	if (cacheIsValid(timestep)) performRendering(timestep);
+	else if (shownJob) performRendering(shownJob->timestep);
 	
 }
 void IsolineRenderer::performRendering(int timestep){
@@ -145,65 +199,97 @@ void IsolineRenderer::initializeGL()
 	initialized = true;
 }
 
-bool IsolineRenderer::buildLineCache(int timestep){
-	
+//Capture the params of the isolines at a timestep in a job
+IsolineJob* IsolineRenderer::makeJob(int timestep){
 	DataStatus* ds = DataStatus::getInstance();
 	DataMgr* dataMgr = ds->getDataMgr();
-	if (!dataMgr) return false;
+	if (!dataMgr) return 0;
 	IsolineParams* iParams = (IsolineParams*)getRenderParams();
-	if (doBypass(timestep)) return false;
+	if (doBypass(timestep)) return 0;
 
-	int actualRefLevel = iParams->GetRefinementLevel();
-	int lod = iParams->GetCompressionLevel();
-		
-	const vector<double>&userExts = dataMgr->GetExtents((size_t)timestep);
-	RegularGrid* isolineGrid;
-	vector<string>varname;
-	varname.push_back(iParams->GetVariableName());
+	IsolineJob* job = new IsolineJob;
+	job->timestep = timestep;
+	job->refLevel = iParams->GetRefinementLevel();
+	job->lod = iParams->GetCompressionLevel();
+	job->varname.push_back(iParams->GetVariableName());
+	//Find the levels present on the GL thread, as DataStatus caches them
+	ds->maxXFormPresent(job->varname[0], timestep);
+	ds->maxLODPresent(job->varname[0], timestep);
 
-	double extents[6];
+	const vector<double>&userExts = dataMgr->GetExtents((size_t)timestep);
 	float boxexts[6];
-
-	bool is3D = iParams->VariablesAre3D();
-	if (is3D) iParams->getLocalContainingRegion(boxexts, boxexts+3);
+	job->is3D = iParams->VariablesAre3D();
+	if (job->is3D) iParams->getLocalContainingRegion(boxexts, boxexts+3);
 	else iParams->GetBox()->GetLocalExtents(boxexts);
-
 	for (int i = 0; i<6; i++){
-		extents[i] = boxexts[i]+userExts[i%3];
+		job->extents[i] = boxexts[i]+userExts[i%3];
 	}
-	
-	int rc = iParams->getGrids( (size_t)timestep, varname, extents, &actualRefLevel, &lod, &isolineGrid);
-	if(!rc){
-		return false;
+	for (int i = 0; i<3; i++){
+		job->userExts[i] = userExts[i];
+		job->sizes[i] = ds->getFullSizes()[i];
 	}
-	isolineGrid->SetInterpolationOrder(1);
-	//Determine resolution of grid to use.  
-	size_t min_dim[3],max_dim[3];
-	dataMgr->GetEnclosingRegion((size_t)timestep, extents, extents+3, min_dim, max_dim, actualRefLevel,lod);
-	// Choose the grid sizes to both equal the largest number
-	//of integer extents.
-	gridSize = Max(max_dim[2]-min_dim[2],Max(max_dim[1]-min_dim[1],max_dim[0]-min_dim[0]));
-	float* dataVals = new float[gridSize*gridSize];
 	//Set up to transform from isoline plane into volume:
-	float a[2],b[2],constValue[2];
+	float constValue[2];
 	int mapDims[3];
-	double transformMatrix[12];
+	if(job->is3D)iParams->buildLocalCoordTransform(job->transformMatrix, 0.f, -1);
+	else iParams->buildLocal2DTransform(2, job->a,job->b,constValue,mapDims);
 
-	if(is3D)iParams->buildLocalCoordTransform(transformMatrix, 0.f, -1);
-	else iParams->buildLocal2DTransform(2, a,b,constValue,mapDims);
-	
-	double planeCoords[3], dataCoords[3];
-	planeCoords[2] = 0.;
+	job->isovals = iParams->GetIsovalues();
+	job->annotate = (iParams->GetTextDensity() > 0. && iParams->textEnabled());
+	job->gridSize = 0;
+	return job;
+}
 
-	
+//Messages of the worker thread are diverted, and kept with the job
+int IsolineJob::Run(){
+	bool diverted = MyBase::DivertThreadErrMsg(true);
+	errCode = VAPOR_ERROR_DATA_UNAVAILABLE;
+	int rc = extract();
+	errMsg = rc < 0 ? MyBase::GetThreadErrMsg() : "";
+	MyBase::DivertThreadErrMsg(diverted);
+	return rc;
+}
+
+int IsolineJob::extract(){
+	DataStatus* ds = DataStatus::getInstance();
+	DataMgr* dataMgr = ds->getDataMgr();
+	if (!dataMgr) return -1;
 
-	//Get the data dimensions (at this resolution):
+	//Hold the DataMgr while the data is read, so the GL thread's use of it does
+	//not interleave with ours
+	RegularGrid* isolineGrid;
+	size_t min_dim[3],max_dim[3];
 	int dataSize[3];
-	//Start by initializing extents
-	for (int i = 0; i< 3; i++){
-		dataSize[i] = (int)ds->getFullSizeAtLevel(actualRefLevel,i);
+	dataMgr->Lock();
+	if (!mayCross(dataMgr)){
+		dataMgr->Unlock();
+		//Extract from a plane of missing values, so the job has no isolines
+		float missing[4] = {0.f, 0.f, 0.f, 0.f};
+		gridSize = 2;
+		extractor.SetPlane(missing, gridSize, 0.f);
+		return extractor.Extract(isovals, annotate);
+	}
+	int rc = Params::getGrids( (size_t)timestep, varname, extents, &refLevel, &lod, &isolineGrid, &errCode);
+	if (rc){
+		//Determine resolution of grid to use.  
+		dataMgr->GetEnclosingRegion((size_t)timestep, extents, extents+3, min_dim, max_dim, refLevel,lod);
+		//Get the data dimensions (at this resolution):
+		for (int i = 0; i< 3; i++){
+			dataSize[i] = (int)ds->getFullSizeAtLevel(refLevel,i);
+		}
 	}
-	const float* sizes = ds->getFullSizes();
+	dataMgr->Unlock();
+	if(!rc) return -1;
+	if (IsCancelled()) {
+		dataMgr->UnlockGrid(isolineGrid);
+		delete isolineGrid;
+		return -1;
+	}
+	isolineGrid->SetInterpolationOrder(1);
+	// Choose the grid sizes to both equal the largest number
+	//of integer extents.
+	gridSize = Max(max_dim[2]-min_dim[2],Max(max_dim[1]-min_dim[1],max_dim[0]-min_dim[0]));
+
 	double extExtents[6]; //Extend extents 1/2 voxel on each side so no bdry issues.
 	for (int i = 0; i<3; i++){
 		double mid = (sizes[i])*0.5;
@@ -211,233 +297,128 @@ bool IsolineRenderer::buildLineCache(int timestep){
 		extExtents[i] = mid - halfExtendedSize;
 		extExtents[i+3] = mid + halfExtendedSize;
 	}
-	//Loop over grid, finding data values at each grid corner.
-	//Missing value is also valid.
-	float mv = isolineGrid->GetMissingValue();
-	for (int i = 0; i<gridSize; i++){
-		planeCoords[0] = -1. + 2.*(double)i/(gridSize-1.);
-		for (int j = 0; j<gridSize; j++){
-			dataVals[i+j*gridSize] = mv;  
-			planeCoords[1] = -1. + 2.*(double)j/(gridSize-1.);
-			if (is3D) vtransform(planeCoords, transformMatrix, dataCoords);
-			else {
-				//2D transform is a*x + b
-				dataCoords[0] = a[0]*planeCoords[0] + b[0];
-				dataCoords[1] = a[1]*planeCoords[1] + b[1];
-				dataCoords[2] = 0.;
-			}
-			//find the coords that the texture maps to
-			bool dataOK = true;
-			for (int k = 0; k< 3; k++){
-				if (dataCoords[k] < extExtents[k] || dataCoords[k] > extExtents[k+3]) dataOK = false;
-				dataCoords[k] += userExts[k]; //Convert to user coordinates.
-			}
-			if(dataOK) { //find the coordinate in the data array
-				dataVals[i+j*gridSize] = isolineGrid->GetValue(dataCoords[0],dataCoords[1],dataCoords[2]);
-			}
+	//
+	//The plane to data transformation is affine, so the grid point (i,j) of
+	//the plane is at origin + i*du + j*dv.  The plane is sampled, and the
+	//isolines extracted, by the worker threads of the extractor.
+	//
+	double planeCorners[3][3] = {{-1.,-1.,0.},{1.,-1.,0.},{-1.,1.,0.}};
+	double corners[3][3];
+	for (int c = 0; c<3; c++){
+		if (is3D) vtransform(planeCorners[c], transformMatrix, corners[c]);
+		else {
+			//2D transform is a*x + b
+			corners[c][0] = a[0]*planeCorners[c][0] + b[0];
+			corners[c][1] = a[1]*planeCorners[c][1] + b[1];
+			corners[c][2] = 0.;
 		}
 	}
-	//Loop over each isovalue and cell, and classify the cell as to which edges are crossed by the isoline.
-	//when there is an isoline crossing, a line segment is saved in the cache, defined by the two endpoints.
-	const vector<double>& isovals = iParams->GetIsovalues();
-	
-	//Clear the textObjects (if they exist)
-	myGLWindow->clearTextObjects(this);
-	//Create a new textObject for each isoline:
-	float bgc[4];
-	const QColor clr = DataStatus::getInstance()->getBackgroundColor();
-	bgc[0] = (float)clr.red()/255.;
-	bgc[1] = (float)clr.green()/255.;
-	bgc[2] = (float)clr.blue()/255.;
-	bgc[3] = 1.;
-	objectNums.clear();
-	for (int iso = 0; iso < isovals.size(); iso++){
-		if(iParams->GetTextDensity() > 0. && iParams->textEnabled()) { //put a textObject in the GLWindow to hold annotation of this isovalue
-			
-			float bgc[4] = {0,0,0,1.};
-			const QColor c = DataStatus::getInstance()->getBackgroundColor();
-			bgc[0] = c.redF();
-			bgc[1] = c.greenF();
-			bgc[2] = c.blueF();
-			float lineColor[4];
-			iParams->getLineColor(iso,lineColor);
-			lineColor[3]=1.;
-			vector<string> vec;
-			vec.push_back("fonts");
-			vec.push_back("Vera.ttf");
-			string isoText;
-			doubleToString((iParams->GetIsovalues()[iso]), isoText, iParams->GetNumDigits());
-			int objNum = myGLWindow->addTextObject(this, GetAppPath("VAPOR","share",vec).c_str(),(int)iParams->GetTextSize(),lineColor, bgc,1, isoText);
-			objectNums[iso] = objNum;
-		}
-		//Clear out temporary caches for this isovalue:
-		
-		edgeSeg.clear(); //map an edge to one segment
-		edgeEdge1.clear(); //map an edge to one adjacent edge;
-		edgeEdge2.clear(); //map an edge to other adjacent edge;
+	double origin[3], du[3], dv[3], bounds[6];
+	for (int k = 0; k<3; k++){
+		origin[k] = corners[0][k] + userExts[k];
+		du[k] = (corners[1][k] - corners[0][k])/(gridSize-1.);
+		dv[k] = (corners[2][k] - corners[0][k])/(gridSize-1.);
+		bounds[k] = extExtents[k] + userExts[k];
+		bounds[k+3] = extExtents[k+3] + userExts[k];
+	}
+	rc = extractor.SamplePlane(isolineGrid, gridSize, origin, du, dv, bounds);
+	dataMgr->UnlockGrid(isolineGrid);
+	delete isolineGrid;
+	if (rc < 0 || IsCancelled()) return -1;
 
-		float isoval = (float)isovals[iso];
-		int cellCase;
-		float x1,y1,x2,y2;  //coordinates of intersection points
-		int segIndex;
-		//loop over cells (identified by lower-left vertices
-		for (int i = 0; i<gridSize-1; i++){
-			for (int j = 0; j<gridSize-1; j++){
-				//Determine which case is associated with cell cornered at i,j
-				if ((dataVals[i+j*gridSize] == mv) || (dataVals[i+1+j*gridSize] == mv) ||
-					(dataVals[i+(j+1)*gridSize] == mv) || (dataVals[i+1+(j+1)*gridSize] == mv)) cellCase = 0;
-				else
-					cellCase = edgeCode(i,j, isoval, dataVals);
-			
-				//Note the vertices are numbered counterclockwise starting with 0 at (i,j)
-				switch (cellCase) {
-					case(0): //no lines
-						break;
-					case(1): //lines intersect 0-3 [point 1] and 0-1 [point 2]
-						{
-						y2 = -1. + 2.*(double)(j)/(gridSize-1.);
-						x1 = -1. + 2.*(double)(i)/(gridSize-1.);
-						
-						x2 = interp_i(i,j,isoval, dataVals);
-						y1 = interp_j(i,j,isoval, dataVals);
-						//line segment connects horizontal edge i,j with vertical edge (i,j)
-						pair<int,int> edge1 = make_pair(i,j);
-						pair<int,int> edge2 = make_pair(-i-1,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						}
-						break;
-					case(2): //lines intersect between vertices 0-1 [1] and vertices 1-2 [2]
-						{
-						y1 = -1. + 2.*(double)j/(gridSize-1.);
-						x2 = -1. + 2.*(double)(i+1)/(gridSize-1.);
-						x1 = interp_i(i,j,isoval,dataVals);
-						y2 = interp_j(i+1,j,isoval,dataVals);
-						//line segment connects horizontal edge i,j with vertical edge (i+1,j)
-						pair<int,int> edge1 = make_pair(i,j);
-						pair<int,int> edge2 = make_pair(-i-2,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						}
-						break;
-					case(3): //lines intersect 1-2 [1] and 2-3 [2]
-						{
-						y2 = -1. + 2.*(double)(j+1)/(gridSize-1.);
-						x1 = -1. + 2.*(double)(i+1)/(gridSize-1.);
-						x2 = interp_i(i,j+1,isoval,dataVals);
-						y1 = interp_j(i+1,j,isoval,dataVals);
-						//line segment connects horizontal edge i,j+1 with vertical edge (i+1,j)
-						pair<int,int> edge1 = make_pair(i,j+1);
-						pair<int,int> edge2 = make_pair(-i-2,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						}
-						break;
-					case(4): //lines intersect 2-3 [1] and 0-3 [2]
-						{
-						y1 = -1. + 2.*(double)(j+1)/(gridSize-1.);
-						x2 = -1. + 2.*(double)(i)/(gridSize-1.);
-						x1 = interp_i(i,j+1,isoval,dataVals);
-						y2 = interp_j(i,j,isoval,dataVals);
-						//line segment connects horizontal edge i,j+1 with vertical edge (i,j)
-						pair<int,int> edge1 = make_pair(i,j+1);
-						pair<int,int> edge2 = make_pair(-i-1,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						}
-						break;
-					
-					case(5): //lines intersect 0-1 [1] and 2-3 [2]
-						{
-						y2 = -1. + 2.*(double)(j+1)/(gridSize-1.);
-						y1 = -1. + 2.*(double)(j)/(gridSize-1.);
-						x1 = interp_i(i,j,isoval,dataVals);
-						x2 = interp_i(i,j+1,isoval,dataVals);
-						//line segment connects horizontal edge i,j with horizontal edge (i,j+1)
-						pair<int,int> edge1 = make_pair(i,j);
-						pair<int,int> edge2 = make_pair(i,j+1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						}
-						break;
-					case(6): //line intersect 1-2 [1] and 0-3 [2]
-						{
-						x1 = -1. + 2.*(double)(i+1)/(gridSize-1.);
-						x2 = -1. + 2.*(double)(i)/(gridSize-1.);
-						y1 = interp_j(i+1,j,isoval,dataVals);
-						y2 = interp_j(i,j,isoval,dataVals);
-						//line segment connects vertical edge i+1,j with vertical edge (i,j)
-						pair<int,int> edge1 = make_pair(-i-2,-j-1);
-						pair<int,int> edge2 = make_pair(-i-1,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						}
-						break;
-					case(7): //both cases 2 and 4
-						//lines intersect between vertices 0-1 [1] and vertices 1-2 [2]
-						{
-						y1 = -1. + 2.*(double)j/(gridSize-1.);
-						x2 = -1. + 2.*(double)(i+1)/(gridSize-1.);
-						x1 = interp_i(i,j,isoval,dataVals);
-						y2 = interp_j(i+1,j,isoval,dataVals);
-						//line segment connects horizontal edge i,j with vertical edge (i+1,j)
-						pair<int,int> edge1 = make_pair(i,j);
-						pair<int,int> edge2 = make_pair(-i-2,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						//lines intersect 2-3 [1] and 0-3 [2]
-						y1 = -1. + 2.*(double)(j+1)/(gridSize-1.);
-						x2 = -1. + 2.*(double)(i)/(gridSize-1.);
-						x1 = interp_i(i,j+1,isoval,dataVals);
-						y2 = interp_j(i,j,isoval,dataVals);
-						//line segment connects horizontal edge i,j+1 with vertical edge (i,j)
-						pair<int,int> edge3 = make_pair(i,j+1);
-						pair<int,int> edge4 = make_pair(-i-1,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge3,edge4);
-						}
-						break;
-					case(8):  //both cases 1 and 3
-						//lines intersect 0-3 [point 1] and 0-1 [point 2]
-						{
-						y2 = -1. + 2.*(double)(j)/(gridSize-1.);
-						x1 = -1. + 2.*(double)(i)/(gridSize-1.);
-						x2 = interp_i(i,j,isoval, dataVals);
-						y1 = interp_j(i,j,isoval, dataVals);
-						//line segment connects horizontal edge i,j with vertical edge (i,j)
-						pair<int,int> edge1 = make_pair(i,j);
-						pair<int,int> edge2 = make_pair(-i-1,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge1,edge2);
-						//lines intersect 1-2 [1] and 2-3 [2]
-						y2 = -1. + 2.*(double)(j+1)/(gridSize-1.);
-						x1 = -1. + 2.*(double)(i+1)/(gridSize-1.);
-						x2 = interp_i(i,j+1,isoval,dataVals);
-						y1 = interp_j(i+1,j,isoval,dataVals);
-						//line segment connects horizontal edge i,j+1 with vertical edge (i+1,j)
-						pair<int,int> edge3 = make_pair(i,j+1);
-						pair<int,int> edge4 = make_pair(-i-2,-j-1);
-						segIndex = addLineSegment(timestep,iso,x1,y1,x2,y2);
-						addEdges(segIndex,edge3,edge4);
-						}
-						break;
-					default:
-						assert(0);
-				}
-			} //for j
-		} //for i
+	//Find the line segments crossing the cells for every isovalue, and the curves
+	//they form if the isolines are annotated.
+	return extractor.Extract(isovals, annotate);
+}
 
-		//Now traverse the edges to determine the isolines in order
-		if(iParams->GetTextDensity() > 0. && iParams->textEnabled()) {
-			traverseCurves(iso, timestep);
-		}
+//Return false if a block summary of the variable, available without reading
+//the data, shows that no isovalue is in the range of the region.
+//The data must be locked by the caller.
+bool IsolineJob::mayCross(DataMgr* dataMgr){
+	if (!is3D) return true;
+	const BlockSummary* summary = dataMgr->GetBlockSummary((size_t)timestep, varname[0].c_str(), refLevel, lod, false);
+	if (!summary) return true;
+	size_t min_dim[3],max_dim[3];
+	dataMgr->GetEnclosingRegion((size_t)timestep, extents, extents+3, min_dim, max_dim, refLevel,lod);
+	float range[2];
+	if (!summary->GetRange(min_dim, max_dim, range)) return false;
+	for (int i = 0; i< isovals.size(); i++){
+		if (isovals[i] >= range[0] && isovals[i] <= range[1]) return true;
+	}
+	return false;
+}
+
+//Extract the isolines of a timestep on the calling thread
+bool IsolineRenderer::buildLineCache(int timestep){
+	cancelJobs();
+	IsolineJob* job = makeJob(timestep);
+	if (!job) return false;
+	job->Run();
+	return installJob(job);
+}
 
-	} //for iso...		
-	numIsovalsCached = isovals.size();
+//Put the isolines extracted by a job in the cache, and annotate them.
+//The job is kept, or deleted if it failed.
+bool IsolineRenderer::installJob(IsolineJob* job){
+	if (job->GetStatus() < 0){
+		if (!job->errMsg.empty() && !job->IsCancelled())
+			MyBase::SetErrMsg(job->errCode, "%s", job->errMsg.c_str());
+		failedTimestep = job->timestep;
+		delete job;
+		return false;
+	}
+	int timestep = job->timestep;
+	for (int iso = 0; iso < job->isovals.size(); iso++){
+		//Replace the line segments of this isovalue in the cache
+		vector<float*>& lines = getLineSegments(timestep, iso);
+		for (int i = 0; i< lines.size(); i++) delete [] lines[i];
+		lines.clear();
+		const vector<float>& segs = job->extractor.GetSegments(iso);
+		lines.reserve(segs.size()/4);
+		for (size_t i = 0; i< segs.size(); i += 4){
+			float* floatvec = new float[4];
+			floatvec[0] = segs[i]; floatvec[1] = segs[i+1]; floatvec[2] = segs[i+2]; floatvec[3] = segs[i+3];
+			lines.push_back(floatvec);
+		}
+	}
+	gridSize = job->gridSize;
+	numIsovalsCached = job->isovals.size();
 	cacheValidFlags[timestep] = true;
-	delete dataVals;
+	if (shownJob) delete shownJob;
+	shownJob = job;
+	buildAnnotation(job);
 	return true;
 }
+
+//Replace the text objects with the annotation of the isolines of a job
+void IsolineRenderer::buildAnnotation(IsolineJob* job){
+	IsolineParams* iParams = (IsolineParams*)getRenderParams();
+	//Clear the textObjects (if they exist)
+	myGLWindow->clearTextObjects(this);
+	objectNums.clear();
+	if (!job->annotate) return;
+	for (int iso = 0; iso < job->isovals.size(); iso++){
+		//put a textObject in the GLWindow to hold annotation of this isovalue
+		float bgc[4] = {0,0,0,1.};
+		const QColor c = DataStatus::getInstance()->getBackgroundColor();
+		bgc[0] = c.redF();
+		bgc[1] = c.greenF();
+		bgc[2] = c.blueF();
+		float lineColor[4];
+		iParams->getLineColor(iso,lineColor);
+		lineColor[3]=1.;
+		vector<string> vec;
+		vec.push_back("fonts");
+		vec.push_back("Vera.ttf");
+		string isoText;
+		doubleToString(job->isovals[iso], isoText, iParams->GetNumDigits());
+		int objNum = myGLWindow->addTextObject(this, GetAppPath("VAPOR","share",vec).c_str(),(int)iParams->GetTextSize(),lineColor, bgc,1, isoText);
+		objectNums[iso] = objNum;
+
+		//Now traverse the curves to place the annotation
+		traverseCurves(job, iso);
+	}
+}
 void IsolineRenderer::invalidateLineCache(int timestep){
 	int numisovals = numIsovalsInCache();
 	for (int iso = 0; iso<numisovals; iso++){
@@ -451,6 +432,9 @@ void IsolineRenderer::invalidateLineCache(int timestep){
 }
 void IsolineRenderer::invalidateLineCache(){
 	DataStatus* ds = DataStatus::getInstance();
+	//Isolines being extracted are stale
+	cancelJobs();
+	failedTimestep = -1;
 	
 	for (int ts = ds->getMinTimestep(); ts <= ds->getMaxTimestep(); ts++)
 		invalidateLineCache(ts);
@@ -469,272 +453,33 @@ void IsolineRenderer::setupCache(){
 	}
 	numIsovalsCached = iParams->getNumIsovalues();
 }
-//Classify a cell to one of 9 possibilities:
-//0: no crossing
-//1,2,3,4 : cross at 1 corner (vertices 0,1,2,3 respectively)
-//5,6: cross opposite edges (between vertices 0-1 & 2-3 for 5, and between  1-2 & 0-3 for 6.
-//7,8: cross all 4 corners, center agrees or disagrees with vertex 0
-//All but 7 & 8 come from a lookup of 8 inputs (4 vertices, each above or below isovalue)
-//Note that none of the vertices should have missing value
-int IsolineRenderer::edgeCode(int i, int j, float isoval, float* dataVals){
-	// intersection code is 1 if it intersects the first edge, 
-	// 2 for the second edge, 4 for the third, 8 for the fourth.
-	// resulting combinations include 1+2, 1+4, 1+8, 2+4, 2+8, 4+8, 1+2+4+8 = 3,5,6,9,10,12,15.
-	// These remap as follows: 3->2; 5->5; 6->3; 9->1; 10->6; 12->4; 15-> 7 or 8
-	int intersectionCode = 0;
-	//check for crossing between (i,j) and (i+1,j)
-	if((dataVals[i+gridSize*j] < isoval &&  dataVals[i+1+gridSize*j] >= isoval) ||
-			(dataVals[i+gridSize*j] >= isoval &&  dataVals[i+1+gridSize*j] < isoval)) intersectionCode+=1;
-	//check for crossing between (i+1,j+1) and (i+1,j)
-	if((dataVals[i+1+gridSize*j] < isoval &&  dataVals[i+1+gridSize*(j+1)] >= isoval) ||
-			(dataVals[i+1+gridSize*j] >= isoval &&  dataVals[i+1+gridSize*(j+1)] < isoval)) intersectionCode+=2;
-	//check for crossing between (i,j+1) and (i+1,j+1)
-	if((dataVals[i+gridSize*(j+1)] < isoval &&  dataVals[i+1+gridSize*(j+1)] >= isoval) ||
-			(dataVals[i+gridSize*(j+1)] >= isoval &&  dataVals[i+1+gridSize*(j+1)] < isoval)) intersectionCode+=4;
-	//check for crossing between (i,j+1) and (i,j)
-	if((dataVals[i+gridSize*j] < isoval &&  dataVals[i+gridSize*(j+1)] >= isoval) ||
-			(dataVals[i+gridSize*j] >= isoval &&  dataVals[i+gridSize*(j+1)] < isoval)) intersectionCode+=8;
-	
-	int ecode;
-	float avgvalue;
-	// Remap intersectionCode to ecode: 0->0, 3->2; 5->5; 6->3; 9->1; 10->6; 12->4; 15-> 7 or 8
-	switch(intersectionCode){
-		case(0):
-			ecode = 0; break;
-		case(3):
-			ecode = 2; break;
-		case(5):
-			ecode = 5; break;
-		case(6): 
-			ecode = 3; break;
-		case(9):
-			ecode = 1; break;
-		case(10):
-			ecode = 6; break;
-		case(12):
-			ecode = 4; break;
-		case(15):  //disambiguate 7 and 8, based on whether or not average is on same side of isovalue as (i,j) vertex.
-				//average is used as best approximation of value at center of cell.
-			avgvalue = 0.25*(dataVals[i+gridSize*j]+dataVals[i+gridSize*(j+1)]+dataVals[i+1+gridSize*(j+1)]+ dataVals[i+1+gridSize*j]);
-			if( ((dataVals[i+gridSize*j] < isoval) && (avgvalue < isoval)) ||
-				((dataVals[i+gridSize*j] > isoval) && (avgvalue > isoval)) ) {
-					//average agrees with (i,j), so use segments that connect 0-1 and 1-2 edge [case 2] as well as 2-3 and 3-0 [case 4]
-				ecode = 7;
-			} else //use segments that connect edges 1-2 and 2-3 as well as 3-0 and 0-1 [case 1 and case 3]
-				ecode = 8;
-			break;
-		default:
-			ecode = -1;
-			assert(0);
-	}
-	return ecode;
-}
-int IsolineRenderer::addLineSegment(int timestep, int isoIndex, float x1, float y1, float x2, float y2){
-	float* floatvec = new float[4];
-	floatvec[0] = x1; floatvec[1]=y1; floatvec[2]=x2; floatvec[3] = y2;
-	pair<int,int> indexpair = make_pair(timestep,isoIndex);
-	lineCache[indexpair].push_back(floatvec);
-	return (lineCache[indexpair].size()-1);
-	
-}
-	//recall temporary mappings
-	//std::map< pair<int,int>, int> edgeSeg; //map an edge to one segment
-	//std::map<pair<int,int>,pair<int,int> > edgeEdge1; //map an edge to one adjacent edge;
-	//std::map<pair<int,int>,pair<int,int> > edgeEdge2; //map an edge to other adjacent edge;
-	//std::map<pair<int,int>, bool> markerBit;  //indicate whether or not an edge has been visited during traversal
-
-//Whenever a segment is added, construct associated edge->edge mappings (both directions) 
-//and a mapping of the first edge to the segment.  The bidirectional edge mappings are used
-//to enable traversal of the isoline in segment order.  The edge->segment mapping is used to
-//determine the coordinates to place the annotation while traversing the isoline.
-void IsolineRenderer::addEdges(int segIndex, pair<int,int> edge1, pair<int,int> edge2) {
-	
-	std::map<pair<int,int>, pair<int,int> >::iterator edgeEdgeIter;
-	
-	//Set mapping of both edges to segment:
-	edgeSeg[edge1] = segIndex;
-	edgeSeg[edge2] = segIndex;
-	//Set marker bits for both edges:
-	markerBit[edge1] = false;
-	markerBit[edge2] = false;
-	//Create the edge1->edge2 mapping:
-	//See if edge1->?? mapping is in first map:
-	edgeEdgeIter = edgeEdge1.find(edge1);
-	if (edgeEdgeIter == edgeEdge1.end()){
-		//Not found; insert it:
-		edgeEdge1[edge1] = edge2;
-	} else {
-		//check:  It should not be in the second map yet
-		edgeEdgeIter = edgeEdge2.find(edge1);
-		assert(edgeEdgeIter == edgeEdge2.end());
-		edgeEdge2[edge1] = edge2;
-	}
-	//Now create the edge2->edge1 mapping
-	edgeEdgeIter = edgeEdge1.find(edge2);
-	if (edgeEdgeIter == edgeEdge1.end()){
-		//Not found; insert it:
-		edgeEdge1[edge2] = edge1;
-	} else {
-		//check:  It should not be in the second map yet
-		edgeEdgeIter = edgeEdge2.find(edge2);
-		assert(edgeEdgeIter == edgeEdge2.end());
-		edgeEdge2[edge2] = edge1;
-	}
-	
-}
-//Use the edge-edge mappings to traverse each isoline
-//First pass is simply to determine an endpoint and length.  
-//Second pass will write annotation
-void IsolineRenderer::traverseCurves(int iso, int timestep){
-	//Initialize counters:
-	int numComponents = 0;
-	int maxLength = -1;
-	int minLength = 100000000;
-	int totLength = 0;
-	int currentLength;  //length of current component
-	componentLength.clear();
-	endEdge.clear();
+//Use the curves found by the extractor to place the annotation of each isoline.
+//When textDensity is 1, there is annotation at every point.  When textDensity is 0.5 (typical)
+//there should be about A annotations in crossing the domain; i.e. annotation interval should be about 1/A times the grid size
+//when textDensity is .5, and A is a normalization constant.  So define 
+// annotSpace = (2-g/A) + (g/A-1)/density where g is grid length or 2*A, whichever is larger
+//If the interval is shorter than the component and larger than 0.1 times the component, then just one annotation is generated
+void IsolineRenderer::traverseCurves(IsolineJob* job, int iso){
 	IsolineParams* iParams = (IsolineParams*)getRenderParams();
 
-	//string isoText = std::to_string((long double)(iParams->GetIsovalues()[iso]));
-	string isoText;
-	doubleToString((iParams->GetIsovalues()[iso]), isoText, iParams->GetNumDigits());
 	//Prepare to convert the iso-box coordinates to user coordinates, then to unit box coords.
 	float transformMatrix[12];
 	iParams->buildLocalCoordTransform(transformMatrix, 0.f, -1);
 	float pointa[3]; //point in cache
 	float point1[3]; //point in local box
 	pointa[2] = 0.;
-	
-	
-	//Repeat the following until no more edges are found:
-	//Find an unmarked edge.  Mark it.
-	std::map<pair<int,int>, pair<int,int> >::iterator edgeEdgeIter;
-	std::map<pair<int,int>, pair<int,int> >::iterator edgeEdgeTestIter;
-	std::map<pair<int,int>, pair<int,int> >::iterator edgeEdgeTestIter2;
-	
-	//Iterate looking for unmarked edge in first mapping.  Note that all edges must appear in both mappings
-	for (edgeEdgeIter = edgeEdge1.begin(); edgeEdgeIter != edgeEdge1.end(); edgeEdgeIter++){
-		pair<int,int> startingEdge = edgeEdgeIter->first;
-		if (markerBit[startingEdge]) continue;  //already marked; keep looking
-		//OK, found an unmarked edge
-		markerBit[startingEdge] = true; //Mark it
-		currentLength = 0;
-		bool firstDirection = true;
-		//Make sure there is a second direction possible
-		edgeEdgeTestIter = edgeEdge2.find(startingEdge);
-		if (edgeEdgeTestIter == edgeEdge2.end()) firstDirection = false;
+	const vector<double>&tvExts = DataStatus::getInstance()->getDataMgr()->GetExtents(job->timestep);
+	const IsolineExtractor& extractor = job->extractor;
+	const vector<float>& segs = extractor.GetSegments(iso);
 
-		pair<int,int> currentEdge = startingEdge;
-		//Obtain next edges in both directions:
-		//Repeat until cannot go further:
-		while(1){
-			//Check an adjacent edge.  If it's not marked, make it the current edge, repeat
-			//make sure current edge is in at least one mapping
-			
-			edgeEdgeTestIter = edgeEdge1.find(currentEdge);
-			if(edgeEdgeTestIter == edgeEdge1.end()){
-				edgeEdgeTestIter = edgeEdge2.find(currentEdge);
-				if (edgeEdgeTestIter == edgeEdge2.end()){
-					//this means currentEdge goes nowhere (in either mapping)
-					//See if we can go the other direction from the start (note this code is replicated below...)
-					if (firstDirection){
-						firstDirection = false;
-						//Try other direction at start 		
-						currentEdge = edgeEdge2[startingEdge];
-						if (!markerBit[currentEdge]) {
-							currentLength++;
-							markerBit[currentEdge] = true;
-							continue; //continue our traversal with the new currentEdge
-						}
-					}
-					//Otherwise we are all done with this isoline; collect some stats
-					if (currentLength == 0) break;
-					numComponents++;
-					totLength += currentLength;
-					if (currentLength > maxLength) maxLength = currentLength;
-					if (currentLength < minLength) minLength = currentLength;
-					componentLength.push_back(currentLength);
-					endEdge.push_back(currentEdge);
-					assert(componentLength.size() == numComponents);
-					break;  //exit while(1) loop
-				}
-			} 
-			//set nextEdge to the connected edge we found
-			pair<int,int> nextEdge = edgeEdgeTestIter->second;
-			if (!markerBit[nextEdge]){
-				currentEdge = nextEdge;
-				currentLength++;
-				markerBit[currentEdge] = true; //mark it...
-				continue;
-			} else {
-				//it's marked false.  Need to consider other direction:
-				edgeEdgeTestIter = edgeEdge2.find(currentEdge);
-				
-				if ((edgeEdgeTestIter == edgeEdge2.end()) || (markerBit[edgeEdgeTestIter->second])){
-					//Both ends are marked (or there is no other end) so
-					//we are at (one) end of isoline
-					//See if we can go the other direction from the start (this is replication of above code!)
-					if (firstDirection){
-						firstDirection = false;
-						//Try other direction at start 		
-						currentEdge = edgeEdge2[startingEdge];
-						if (!markerBit[currentEdge]) {
-							markerBit[currentEdge] = true;
-							currentLength++;
-							continue; //continue our traversal with the new currentEdge
-						}
-					}
-					//Otherwise we are all done with this isoline; collect some stats
-					if (currentLength == 0) break;
-					numComponents++;
-					totLength += currentLength;
-					if (currentLength > maxLength) maxLength = currentLength;
-					if (currentLength < minLength) minLength = currentLength;
-					componentLength.push_back(currentLength);
-					endEdge.push_back(currentEdge);
-					assert(componentLength.size() == numComponents);
-					break;  //exit while(1) loop
-				} else {
-					//Not marked; continue with nextEdge:
-					currentEdge = edgeEdgeTestIter->second;
-					currentLength++;
-					markerBit[currentEdge] = true;
-					continue;
-				}
-			}
-		}
-	}
-	//Done with traversals.  check if every edge has been marked
-/* Comment out these tests for the release version:
-	for (edgeEdgeIter = edgeEdge1.begin(); edgeEdgeIter != edgeEdge1.end(); edgeEdgeIter++){
-		pair<int,int> thisEdge = edgeEdgeIter->first;
-		assert (markerBit[thisEdge]) ;
-	}
-	for (edgeEdgeIter = edgeEdge2.begin(); edgeEdgeIter != edgeEdge2.end(); edgeEdgeIter++){
-		pair<int,int> thisEdge = edgeEdgeIter->first;
-		assert (markerBit[thisEdge]) ;
-	}
-*/
-	//Now traverse each component, writing annotation at specified interval
-	//Note that all marker bits are true,so we can use markerBit[i]==false as a new marker
-	//When textDensity is 1, there is annotation at every point.  When textDensity is 0.5 (typical)
-	//there should be about A annotations in crossing the domain; i.e. annotation interval should be about 1/A times the grid size
-	//when textDensity is .5, and A is a normalization constant.  So define 
-	// annotSpace = (2-g/A) + (g/A-1)/density where g is grid length or 2*A, whichever is larger
-	//If the interval is shorter than the component and larger than 0.1 times the component, then just one annotation is generated
 	float A = 3.;
-	
-	float g = (float)gridSize;
+	float g = (float)job->gridSize;
 	if (g < 2*A) g = 2*A;
 	int annotSpace = (int) ((2- g/A) + (g/A -1.f)/iParams->GetTextDensity());
-	int numAnnotations = 0;
-	markerBit.clear();
-	for (int comp = 0; comp<numComponents; comp++){
+	for (int comp = 0; comp < extractor.GetNumCurves(iso); comp++){
+		int length;
+		const int* curve = extractor.GetCurve(iso, comp, &length);
 		int annotInterval = annotSpace;
-		pair<int,int> currentEdge = endEdge[comp];
-		markerBit[currentEdge] = true;  //Mark it
-		int length = componentLength[comp];
 		if (length < annotInterval/10) continue; //No annotation for this component
 		if (length < annotInterval) annotInterval = length;
 		//Modify annotInterval so that it evenly divides length
@@ -742,91 +487,16 @@ void IsolineRenderer::traverseCurves(int iso, int timestep){
 			int frac = length/annotInterval;
 			annotInterval = length/frac;
 		}
-		//Determine the first point as halfway between 0 and annotInterval-1;
 		assert(annotInterval>0);
-		int startDist = 1+annotInterval/2;
-		//Traverse along component, marking as we go.
-		//first, count until we get startDist along; after that, increment by annotInterval
-		//Obtain next edges in both directions for traversal, but no need to go back to start.
-		int advancedDist = 0;
-		int currentAdvancedDist = 0;
-		int gapInterval = startDist;
-		const vector<double>&tvExts = DataStatus::getInstance()->getDataMgr()->GetExtents(timestep);
-		std::pair<int,int> mapPair= make_pair(timestep, iso);
-		vector<float*> lines = lineCache[mapPair];
-		while(1){
-			//Check an adjacent edge.  If it's not marked, make it the current edge, repeat
-			//make sure current edge is in at least one mapping
-			
-			edgeEdgeTestIter = edgeEdge1.find(currentEdge);
-			if(edgeEdgeTestIter == edgeEdge1.end()){
-				edgeEdgeTestIter = edgeEdge2.find(currentEdge);
-				if (edgeEdgeTestIter == edgeEdge2.end()){
-					//this means currentEdge goes nowhere (in either mapping); must be at end already
-					assert(advancedDist == length);
-					break;  //exit while(1) loop
-				}
-			} 
-			//set nextEdge to the connected edge we found
-			pair<int,int> nextEdge = edgeEdgeTestIter->second;
-			if (!markerBit[nextEdge]){ //not marked, so ok to continue
-				currentEdge = nextEdge;
-				advancedDist++;
-				currentAdvancedDist++;
-				markerBit[currentEdge] = true; //mark it...
-				if (currentAdvancedDist == gapInterval){
-
-					//display annotation here!
-					int linenum = edgeSeg[currentEdge];
-					pointa[0] = lines[linenum][0];
-					pointa[1] = lines[linenum][1];
-					vtransform(pointa,transformMatrix,point1);
-					//Convert local to user:
-					for (int i = 0; i<3; i++) point1[i] += tvExts[i];
-					
-					myGLWindow->addText(this, objectNums[iso],point1);
-					numAnnotations++;
-					//Reset the next interval:
-					gapInterval = annotInterval;
-					currentAdvancedDist = 0;
-				}
-				continue;
-			} else {
-				//it's marked true.  Need to consider other direction:
-				edgeEdgeTestIter = edgeEdge2.find(currentEdge);
-				
-				if ((edgeEdgeTestIter == edgeEdge2.end()) || (markerBit[edgeEdgeTestIter->second])){
-					//Both ends are marked (or there is no other end) so
-					//we are at end of isoline
-					assert(advancedDist == length);
-					break;  //exit while(1) loop
-					
-				} else {
-					//Not marked; continue with nextEdge:
-					currentEdge = edgeEdgeTestIter->second;
-					advancedDist++;
-					currentAdvancedDist++;
-					markerBit[currentEdge] = true; //mark it...
-					if (currentAdvancedDist == gapInterval){
-						
-						//display annotation here!
-						int linenum = edgeSeg[currentEdge];
-						pointa[0] = lines[linenum][0];
-						pointa[1] = lines[linenum][1];
-						vtransform(pointa,transformMatrix,point1);
-						//Convert local to user:
-						for (int i = 0; i<3; i++) point1[i] += tvExts[i];
-					
-						myGLWindow->addText(this, objectNums[iso],point1);
-						numAnnotations++;
-						//Reset the next interval:
-						gapInterval = annotInterval;
-						currentAdvancedDist = 0;
-					}
-					continue;
-				}
-			}
+		//The first annotation is halfway along the first interval, the others
+		//follow at annotInterval
+		for (int pos = annotInterval/2; pos < length; pos += annotInterval){
+			pointa[0] = segs[4*curve[pos]];
+			pointa[1] = segs[4*curve[pos]+1];
+			vtransform(pointa,transformMatrix,point1);
+			//Convert local to user:
+			for (int i = 0; i<3; i++) point1[i] += tvExts[i];
+			myGLWindow->addText(this, objectNums[iso],point1);
 		}
-	//Done with component
 	}
 }
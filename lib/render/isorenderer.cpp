@@ -55,6 +55,7 @@
 //#include "DVRLookup.h"
 #include "DVRShader.h"
 #include "DVRRayCaster.h"
+#include "IsoExtractor.h"
 
 #include "DVRDebug.h"
 #include "params.h"
@@ -136,31 +137,29 @@ void IsoRenderer::_unregisterDirtyFlags() {
 	_myParamsIso = NULL;
 }
 
+void	IsoRenderer::_regionVarnames(
+	RenderParams *rp, string varname, vector <string> &varnames
+) {
+    ParamsIso *myParamsIso = (ParamsIso *) rp;
+
+	varnames.clear();
+	varnames.push_back(varname);
+	if (_type == DvrParams::DVR_RAY_CASTER_2_VAR) {
+		varnames.push_back(myParamsIso->GetMapVariableName());
+	}
+}
+
 int	IsoRenderer::_updateRegion(
 	DataMgr *dataMgr, RenderParams *rp, RegionParams *regp,
-	size_t ts, string varname, int reflevel, int lod,
-	const size_t min[3], const size_t max[3]
+	size_t ts, const vector <RegularGrid *> &grids
 ) {
     ParamsIso *myParamsIso = (ParamsIso *) rp;
 
-	RegularGrid *rg = dataMgr->GetGrid(
-			ts, varname, reflevel, lod, min, max
-	);
-	if (!rg) return(-1);
-
-	int rc = _driver->SetRegion(rg, myParamsIso->GetHistoBounds(),0);
-	delete rg;
+	int rc = _driver->SetRegion(grids[0], myParamsIso->GetHistoBounds(),0);
 	if (rc<0) return(rc);
 
 	if (_type == DvrParams::DVR_RAY_CASTER_2_VAR) {
-		string map_varname = myParamsIso->GetMapVariableName();
-		rg = dataMgr->GetGrid(
-			ts, map_varname, reflevel, lod, min, max
-		);
-		if (!rg) return(-1);
-
-		rc = _driver->SetRegion(rg, myParamsIso->GetMapBounds(),1);
-		delete rg;
+		rc = _driver->SetRegion(grids[1], myParamsIso->GetMapBounds(),1);
 		if (rc<0) return(rc);
 	}
 
@@ -215,3 +214,89 @@ void IsoRenderer::_updateDriverRenderParamsSpec(RenderParams *rp) {
 	//_colorMapDF.Clear(); // cleared by parent class
 	_dataDF.Clear(); // cleared by parent class
 }
+
+int IsoRenderer::ExportIsosurface(
+	ParamsIso *isoParams, RegionParams *regParams, size_t ts,
+	const string &path
+) {
+	DataStatus *ds = DataStatus::getInstance();
+	DataMgr *dataMgr = ds->getDataMgr();
+	if (! dataMgr) {
+		MyBase::SetErrMsg("No data loaded");
+		return(-1);
+	}
+
+	int varNums[2];
+	int numVars = 1;
+	varNums[0] = isoParams->GetIsoVariableNum();
+	int mapVarNum = isoParams->GetMapVariableNum();
+	if (mapVarNum >= 0) varNums[numVars++] = mapVarNum;
+
+	int reflevel = isoParams->GetRefinementLevel();
+	int lod = isoParams->GetCompressionLevel();
+	if (ds->useLowerAccuracy()) {
+		lod = Min(lod, ds->maxLODPresent3D(varNums[0], ts));
+	}
+
+	size_t min_dim[3], max_dim[3];
+	int availRefLevel = regParams->getAvailableVoxelCoords(
+		reflevel, lod, min_dim, max_dim, ts, varNums, numVars
+	);
+	if (availRefLevel < 0) {
+		MyBase::SetErrMsg(
+			VAPOR_ERROR_DATA_UNAVAILABLE,
+			"Data unavailable for variable %s at refinement level %d",
+			isoParams->GetIsoVariableName().c_str(), reflevel
+		);
+		return(-1);
+	}
+
+	//
+	// Both grids are locked, so that fetching the map variable can't
+	// free the blocks of the first
+	//
+	RegularGrid *rg = dataMgr->GetGrid(
+		ts, ds->getVariableName3D(varNums[0]), availRefLevel, lod,
+		min_dim, max_dim, 1
+	);
+	if (! rg) return(-1);
+
+	RegularGrid *map = NULL;
+	if (mapVarNum >= 0) {
+		map = dataMgr->GetGrid(
+			ts, ds->getVariableName3D(mapVarNum), availRefLevel, lod,
+			min_dim, max_dim, 1
+		);
+		if (! map) {
+			dataMgr->UnlockGrid(rg);
+			delete rg;
+			return(-1);
+		}
+	}
+
+	IsoExtractor extractor;
+	IsoMesh mesh;
+	extractor.SetNormals(isoParams->GetNormalOnOff());
+
+	int rc = extractor.SetGrid(rg);
+	if (rc == 0 && map) {
+		rc = extractor.SetMapGrid(map);
+		extractor.SetColorMap(isoParams->getClut(), isoParams->GetMapBounds());
+	}
+	if (rc == 0) rc = extractor.Extract(isoParams->GetIsoValue(), &mesh);
+
+	dataMgr->UnlockGrid(rg);
+	delete rg;
+	if (map) {
+		dataMgr->UnlockGrid(map);
+		delete map;
+	}
+
+	if (rc == 0) {
+		string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+		for (int i=0; i<ext.size(); i++) ext[i] = tolower(ext[i]);
+		if (ext == ".obj") rc = mesh.WriteOBJ(path);
+		else rc = mesh.WritePLY(path);
+	}
+	return(rc);
+}
@@ -56,14 +56,30 @@ namespace VAPoR {
 
 	virtual void setRenderParams(RenderParams* rp);
 
+	//! Extract the isosurface specified by \p isoParams, within the
+	//! region of \p regParams at time step \p ts, on the CPU and write
+	//! it to \p path. The mesh is written as a Wavefront OBJ file if
+	//! \p path ends in ".obj", otherwise as a binary PLY file. Vertices are
+	//! colored with the color map if a variable is mapped.
+	//!
+	//! \retval status A negative int is returned on failure
+	//
+	static int ExportIsosurface(
+		ParamsIso *isoParams, RegionParams *regParams, size_t ts,
+		const string &path
+	);
+
 
   protected:
 
 
+ void _regionVarnames(
+	RenderParams *rp, string varname, vector <string> &varnames
+ );
+
  int _updateRegion(
 	DataMgr *dataMgr, RenderParams *rp, RegionParams *regp, 
-	size_t ts, string varname, int reflevel, int lod,
-	const size_t min[3], const size_t max[3]
+	size_t ts, const vector <RegularGrid *> &grids
  );
 
  void _updateDriverRenderParamsSpec(RenderParams *rp);
@@ -32,9 +32,30 @@
 #include <qapplication.h>
 #include <qcursor.h>
 #include "renderer.h"
+#include "RenderJobQueue.h"
 #include <sstream>
 using namespace VAPoR;
 GLint ProbeRenderer::_storedBuffer = 0;
+
+namespace VAPoR {
+//A ProbeTextureJob calculates the data texture of a timestep on a worker thread,
+//from what the probe params captured on the GL thread.
+class ProbeTextureJob : public RenderJob {
+public:
+	ProbeTextureJob() {texture = 0;}
+	~ProbeTextureJob() {delete [] texture;}
+	virtual int Run();
+	ProbeParams::DataTextureSpec spec;
+	//The params, and their texture version, when the job was made.  Not used by Run()
+	const ProbeParams* params;
+	int version;
+	//Result:
+	unsigned char* texture;
+	//The error of a failed job, reported when it is installed on the GL thread
+	int errCode;
+	string errMsg;
+};
+};
 bool first = true;
 ProbeRenderer::ProbeRenderer(GLWindow* glw, ProbeParams* pParams )
 :Renderer(glw, pParams, "ProbeRenderer")
@@ -42,6 +63,9 @@ ProbeRenderer::ProbeRenderer(GLWindow* glw, ProbeParams* pParams )
 	_fbTexid = 0;
 	_probeTexid = 0;
 	_framebufferid = 0;
+	pendingTimestep = -1;
+	pendingVersion = -1;
+	shownTimestep = -1;
 }
 
 
@@ -70,7 +94,9 @@ void ProbeRenderer::paintGL()
 	
 	unsigned char* probeTex = 0;
 	
-	if (myProbeParams->probeIsDirty(currentTimestep)){
+	if (myProbeParams->getProbeType() == 0){
+		probeTex = getDataTexture(myProbeParams, currentTimestep);
+	} else if (myProbeParams->probeIsDirty(currentTimestep)){
 		QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 		probeTex = getProbeTexture(myProbeParams,currentTimestep, true, _framebufferid, _fbTexid);
 		QApplication::restoreOverrideCursor();
@@ -505,7 +531,7 @@ unsigned char* ProbeRenderer::getNextIBFVTexture(ProbeParams* pParams, int tstep
 
 }
 void ProbeRenderer::stepIBFVTexture(ProbeParams* pParams, int timestep, int frameNum, int listNum){
-	float x1, x2, y, px, py;
+	float x1, x2, y;
 	
 	
 	int txsize[2];
@@ -516,19 +542,22 @@ void ProbeRenderer::stepIBFVTexture(ProbeParams* pParams, int timestep, int fram
 	float tmaxx   = txsize[0]/(scale*npn);
 	float tmaxy   = txsize[1]/(scale*npn);
 	float DM = ((float) (0.999999/(nmesh-1.0)));
+	//The advected mesh is the same for every frame of the timestep:
+	const float* mesh = pParams->getIBFVMesh(timestep);
+	if (!mesh) return;
 	
 	for (int i = 0; i < nmesh-1; i++) {
-		x1 = DM*i; x2 = x1 + DM;
+		x1 = DM*i; x2 = DM*(i+1);
+		const float* col1 = mesh + 2*nmesh*i;
+		const float* col2 = col1 + 2*nmesh;
 		glBegin(GL_QUAD_STRIP);
 		for (int j = 0; j < nmesh; j++) {
 			y = DM*j;
 			glTexCoord2f(x1, y); 
-			pParams->getIBFVValue(timestep, x1, y, &px, &py);
-			glVertex2f(px, py);
+			glVertex2f(col1[2*j], col1[2*j+1]);
 
 			glTexCoord2f(x2, y); 
-			pParams->getIBFVValue(timestep, x2, y, &px, &py);
-			glVertex2f(px, py);
+			glVertex2f(col2[2*j], col2[2*j+1]);
 		}
 		glEnd();
 	}
@@ -546,6 +575,79 @@ void ProbeRenderer::stepIBFVTexture(ProbeParams* pParams, int timestep, int fram
 	glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 
 						0, 0, txsize[0], txsize[1], 0);
 }
+//Install the data texture calculated since the last paint, or calculate the texture
+//of the timestep on a worker thread.  The window is repainted when it is ready;
+//meanwhile the texture last calculated is drawn, if the probe has not changed.
+unsigned char* ProbeRenderer::getDataTexture(ProbeParams* pParams, int timestep){
+	ProbeTextureJob* job = (ProbeTextureJob*)takeCompletedJob();
+	if (job) installJob(job);
+	if (!pParams->probeIsDirty(timestep)) return pParams->getCurrentProbeTexture(timestep, 0);
+	if (pParams->doBypass(timestep)) return 0;
+
+	int version = pParams->getTextureVersion();
+	if (!jobIsPending() || pendingTimestep != timestep || pendingVersion != version){
+		job = makeJob(pParams, timestep);
+		if (!job) {
+			pParams->setBypass(timestep);
+			return 0;
+		}
+		pendingTimestep = timestep;
+		pendingVersion = version;
+		submitJob(job);
+	}
+	//An image being captured must show the current timestep
+	if (myGLWindow->isCapturingImage()) waitForJob();
+	//The job may have completed already, as when jobs run when submitted
+	job = (ProbeTextureJob*)takeCompletedJob();
+	if (job) installJob(job);
+	if (!pParams->probeIsDirty(timestep)) return pParams->getCurrentProbeTexture(timestep, 0);
+	if (shownTimestep >= 0 && !pParams->probeIsDirty(shownTimestep))
+		return pParams->getCurrentProbeTexture(shownTimestep, 0);
+	return 0;
+}
+
+//Capture the params of the data texture at a timestep in a job
+ProbeTextureJob* ProbeRenderer::makeJob(ProbeParams* pParams, int timestep){
+	ProbeTextureJob* job = new ProbeTextureJob;
+	if (!pParams->getDataTextureSpec(timestep, 0, 0, job->spec)){
+		delete job;
+		return 0;
+	}
+	job->params = pParams;
+	job->version = pParams->getTextureVersion();
+	return job;
+}
+
+//Messages of the worker thread are diverted, and kept with the job
+int ProbeTextureJob::Run(){
+	bool diverted = MyBase::DivertThreadErrMsg(true);
+	errCode = VAPOR_ERROR_DATA_UNAVAILABLE;
+	texture = ProbeParams::buildDataTexture(spec, &errCode);
+	int rc = texture ? 0 : -1;
+	errMsg = rc < 0 ? MyBase::GetThreadErrMsg() : "";
+	MyBase::DivertThreadErrMsg(diverted);
+	return rc;
+}
+
+//Put the texture calculated by a job in the params' cache, unless the probe has
+//changed since the job was made.  The job is deleted.
+void ProbeRenderer::installJob(ProbeTextureJob* job){
+	ProbeParams* pParams = (ProbeParams*)currentRenderParams;
+	if (job->params == pParams && job->version == pParams->getTextureVersion()){
+		int timestep = job->spec.timestep;
+		if (job->GetStatus() < 0){
+			if (!job->errMsg.empty())
+				MyBase::SetErrMsg(job->errCode, "%s", job->errMsg.c_str());
+			pParams->setBypass(timestep);
+		} else {
+			pParams->setProbeTexture(job->texture, timestep, 0);
+			job->texture = 0;
+			shownTimestep = timestep;
+		}
+	}
+	delete job;
+}
+
 //Static method to calculate the probe texture whether IBFV or data or both
 unsigned char* ProbeRenderer::getProbeTexture(ProbeParams* pParams, 
 		int timeStep, bool doCache, GLuint fbid, GLuint fbtexid){
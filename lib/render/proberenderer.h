@@ -32,6 +32,7 @@
 #include "renderer.h"
 #include "probeparams.h"
 namespace VAPoR {
+class ProbeTextureJob;
 
 class RENDER_API ProbeRenderer : public Renderer
 {
@@ -62,6 +63,14 @@ protected:
 	static int makeIBFVPatterns(ProbeParams*, int prevListNum);
 	static void stepIBFVTexture(ProbeParams*, int timeStep, int frameNum, int listNum);
 	std::string instanceName();		
+	//Data textures are calculated by jobs run on worker threads.  IBFV textures
+	//are built with OpenGL, so they are built in paintGL().
+	unsigned char* getDataTexture(ProbeParams*, int timestep);
+	ProbeTextureJob* makeJob(ProbeParams*, int timestep);
+	void installJob(ProbeTextureJob* job);
+	int pendingTimestep;
+	int pendingVersion;
+	int shownTimestep;
 	
 
 };
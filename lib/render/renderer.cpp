@@ -22,6 +22,7 @@
 #include <qpixmap.h>
 #include <qpainter.h>
 #include "renderer.h"
+#include "RenderJobQueue.h"
 #include <vapor/DataMgr.h>
 #include "regionparams.h"
 #include "viewpointparams.h"
@@ -58,6 +59,32 @@ Renderer::~Renderer()
    // context are deleted.
    //
    if (myGLWindow) myGLWindow->makeCurrent();
+
+	RenderJobQueue::GetInstance()->Remove(this);
+}
+
+namespace {
+	//Called by a render job worker thread when a job completes:
+	//queue a repaint of the window, which is done on the GUI thread.
+	void repaintWindow(void* window) {
+		QMetaObject::invokeMethod((GLWindow*) window, "updateGL", Qt::QueuedConnection);
+	}
+};
+
+void Renderer::submitJob(RenderJob* job){
+	RenderJobQueue::GetInstance()->Submit(this, job, repaintWindow, myGLWindow);
+}
+RenderJob* Renderer::takeCompletedJob(){
+	return RenderJobQueue::GetInstance()->TakeCompleted(this);
+}
+bool Renderer::jobIsPending(){
+	return RenderJobQueue::GetInstance()->IsBusy(this);
+}
+void Renderer::waitForJob(){
+	RenderJobQueue::GetInstance()->Wait(this);
+}
+void Renderer::cancelJobs(){
+	RenderJobQueue::GetInstance()->Cancel(this);
 }
 
 //Following methods are to support display of a colorscale in front of the data.
@@ -31,6 +31,7 @@ using namespace VetsUtil;
 
 namespace VAPoR {
 class DataMgr;
+class RenderJob;
 class Metadata;
 
 //! \class Renderer
@@ -126,6 +127,26 @@ signals:
     void statusMessage(const QString&);
 
 protected:
+	//! Submit a job preparing the data of a frame to the shared
+	//! RenderJobQueue. The job runs on a worker thread, and must not refer
+	//! to the renderer. A job submitted earlier and not yet completed is
+	//! cancelled. The window is repainted when the job completes.
+	//! \param[in] job Job, now owned by the queue
+	void submitJob(RenderJob* job);
+
+	//! Obtain the most recently completed job
+	//! \retval RenderJob* The job, now owned by the caller, or NULL
+	RenderJob* takeCompletedJob();
+
+	//! Indicate whether a submitted job has not yet completed
+	bool jobIsPending();
+
+	//! Wait for the submitted jobs to complete
+	void waitForJob();
+
+	//! Cancel the submitted jobs, and discard the completed one
+	void cancelJobs();
+
 	void enableClippingPlanes(const double extents[6]);
 	void enableFullClippingPlanes();
 	void enableRegionClippingPlanes();
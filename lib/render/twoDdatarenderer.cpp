@@ -33,13 +33,45 @@
 #include <qapplication.h>
 #include <qcursor.h>
 #include "renderer.h"
+#include "RenderJobQueue.h"
 #include "proj_api.h"
 
 using namespace VAPoR;
 
+namespace VAPoR {
+//An ElevGridJob captures, on the GL thread, what is needed to build the elevation
+//grid of a timestep.  It reads the height variable and computes the vertices and
+//normals of the grid on a worker thread.
+class ElevGridJob : public RenderJob {
+public:
+	ElevGridJob() {elevVert = 0; elevNorm = 0;}
+	~ElevGridJob() {delete [] elevVert; delete [] elevNorm;}
+	virtual int Run();
+	int timestep;
+	vector<string> varname;
+	double twoDExts[6];
+	double boxExts[6];
+	double usrExts[3];
+	float localTwoDMinZ;
+	int refLevel;
+	int lod;
+	float stretch[3];
+	float maxCubeSide;
+	//Results:
+	int maxx, maxy;
+	float *elevVert, *elevNorm;
+	//The error of a failed job, reported when it is installed on the GL thread
+	int errCode;
+	string errMsg;
+private:
+	int build();
+};
+};
+
 TwoDDataRenderer::TwoDDataRenderer(GLWindow* glw, TwoDDataParams* pParams )
 :TwoDRenderer(glw, pParams)
 {
+	pendingTimestep = -1;
 }
 
 
@@ -75,6 +107,8 @@ void TwoDDataRenderer::paintGL()
 	if(!twoDTex) {setBypass(currentTimestep); return;}
 
 	if (myTwoDParams->elevGridIsDirty()){
+		//The grid being built is stale
+		cancelJobs();
 		invalidateElevGrid();
 		myTwoDParams->setElevGridDirty(false);
 	}
@@ -140,96 +174,111 @@ void TwoDDataRenderer::paintGL()
 	disableFullClippingPlanes();
 }
 
+//Install the elevation grid built since the last paint, or build the grid of the
+//timestep on a worker thread.  The window is repainted when it is ready; meanwhile
+//the grid last built is drawn.  Returns false if the grid can't be built.
 bool TwoDDataRenderer::rebuildElevationGrid(size_t timeStep){
-	//Reconstruct the elevation grid.
-	
+	ElevGridJob* job = (ElevGridJob*)takeCompletedJob();
+	if (job){
+		int jobTimestep = job->timestep;
+		if (!installJob(job) && jobTimestep == (int)timeStep) return false;
+	}
+	if (elevVert && cachedTimeStep == (int)timeStep) return true;
 
-	//find the grid coordinate ranges
-	size_t min_dim[3], max_dim[3];
-	double regMin[3],regMax[3];
-	
+	if (!jobIsPending() || pendingTimestep != (int)timeStep){
+		job = makeJob(timeStep);
+		if (!job) return false;
+		pendingTimestep = (int)timeStep;
+		submitJob(job);
+	}
+	//An image being captured must show the current timestep
+	if (myGLWindow->isCapturingImage()) waitForJob();
+	//The job may have completed already, as when jobs run when submitted
+	job = (ElevGridJob*)takeCompletedJob();
+	if (job && !installJob(job)) return false;
+	return true;
+}
+
+//Capture the params of the elevation grid at a timestep in a job
+ElevGridJob* TwoDDataRenderer::makeJob(size_t timeStep){
 	DataStatus* ds = DataStatus::getInstance();
-	if (!ds->getDataMgr()) return false;
-	const float* localExtents = ds->getLocalExtents();
-	//See if there is a height variable
-	
 	DataMgr* dataMgr = ds->getDataMgr();
+	if (!dataMgr) return 0;
+
 	const vector<double>& usrExts = dataMgr->GetExtents(timeStep);
 	TwoDParams* tParams = (TwoDParams*) currentRenderParams;
 	double twoDExts[6];
 	for (int i = 0; i<3; i++){
-		regMin[i] = twoDExts[i] = tParams->getLocalTwoDMin(i) + usrExts[i];
-		regMax[i] = twoDExts[i+3] = tParams->getLocalTwoDMax(i) + usrExts[i];
+		twoDExts[i] = tParams->getLocalTwoDMin(i) + usrExts[i];
+		twoDExts[i+3] = tParams->getLocalTwoDMax(i) + usrExts[i];
 	}
-	
 	for (int i = 0; i< 2; i++){
-		
-		if (regMax[i] <= regMin[i]){
+		if (twoDExts[i+3] <= twoDExts[i]){
 			maxXElev = 0;
 			maxYElev = 0;
-			return false;
-		}
-
-	}
-	
-	regMin[2] = localExtents[2];
-	regMax[2] = localExtents[5];
-	//Convert to voxels:
-	
-	int elevGridRefLevel = tParams->GetRefinementLevel();
-	int lod = tParams->GetCompressionLevel();
-	vector<string>varname;
-	varname.push_back(tParams->GetHeightVariableName());
-	RegularGrid *hgtGrid;
-	
-	//Try to get requested refinement level or the nearest acceptable level:
-	int rc = tParams->getGrids(timeStep,varname, twoDExts, &elevGridRefLevel, &lod,  &hgtGrid); 
-	
-	if (!rc) {
-		
-		setBypass(timeStep);
-		if (ds->warnIfDataMissing()){
-			SetErrMsg(VAPOR_WARNING_DATA_UNAVAILABLE,"Height data unavailable at timestep %d.", 
-				timeStep);
+			return 0;
 		}
-		ds->setDataMissing2D(timeStep, elevGridRefLevel, lod, ds->getSessionVariableNum2D(tParams->GetHeightVariableName()));
-		return false;
 	}
-	
+
+	ElevGridJob* job = new ElevGridJob;
+	job->timestep = (int)timeStep;
+	job->refLevel = tParams->GetRefinementLevel();
+	job->lod = tParams->GetCompressionLevel();
+	job->varname.push_back(tParams->GetHeightVariableName());
+	//Find the levels present on the GL thread, as DataStatus caches them
+	ds->maxXFormPresent(job->varname[0], timeStep);
+	ds->maxLODPresent(job->varname[0], timeStep);
+
+	for (int i = 0; i<6; i++) job->twoDExts[i] = twoDExts[i];
+	for (int i = 0; i<3; i++) job->usrExts[i] = usrExts[i];
+	job->localTwoDMinZ = tParams->getLocalTwoDMin(2);
 	//get grid extents, based on user coordinate extents.
+	tParams->GetBox()->GetUserExtents(job->boxExts, timeStep);
+	//The vertices are in stretched cube coords
+	const float* stretch = ds->getStretchFactors();
+	for (int i = 0; i<3; i++) job->stretch[i] = stretch[i];
+	job->maxCubeSide = ViewpointParams::getMaxStretchedCubeSide();
+	job->maxx = job->maxy = 0;
+	return job;
+}
+
+//Messages of the worker thread are diverted, and kept with the job
+int ElevGridJob::Run(){
+	bool diverted = MyBase::DivertThreadErrMsg(true);
+	errCode = VAPOR_ERROR_DATA_UNAVAILABLE;
+	int rc = build();
+	errMsg = rc < 0 ? MyBase::GetThreadErrMsg() : "";
+	MyBase::DivertThreadErrMsg(diverted);
+	return rc;
+}
+
+int ElevGridJob::build(){
+	DataStatus* ds = DataStatus::getInstance();
+	DataMgr* dataMgr = ds->getDataMgr();
+	if (!dataMgr) return -1;
+
+	//Try to get requested refinement level or the nearest acceptable level.
+	//Hold the DataMgr while the data is read, so the GL thread's use of it does
+	//not interleave with ours
+	RegularGrid *hgtGrid;
 	size_t voxexts[6];
-	double dbexts[6];
-	tParams->GetBox()->GetUserExtents(dbexts, timeStep);
-	tParams->mapBoxToVox(dataMgr,dbexts, dbexts+3, elevGridRefLevel,lod,timeStep, voxexts);
-	for ( int i=0; i<3; i++){
-		min_dim[i] = voxexts[i];
-		max_dim[i] = voxexts[i+3];
+	dataMgr->Lock();
+	int rc = Params::getGrids((size_t)timestep, varname, twoDExts, &refLevel, &lod, &hgtGrid, &errCode);
+	if (rc){
+		dataMgr->MapUserToVox((size_t)timestep, boxExts, voxexts, refLevel, lod);
+		dataMgr->MapUserToVox((size_t)timestep, boxExts+3, voxexts+3, refLevel, lod);
 	}
+	dataMgr->Unlock();
+	if (!rc) return -1;
+
 	//Then create arrays to hold the vertices and their normals:
-	//Make each size be grid size + 2. 
-	int maxx = maxXElev = max_dim[0] - min_dim[0] +1;
-	int maxy = maxYElev = max_dim[1] - min_dim[1] +1;
-	if (elevVert) {
-		delete [] elevVert; 
-		delete [] elevNorm;
-	}
-	
+	maxx = voxexts[3] - voxexts[0] +1;
+	maxy = voxexts[4] - voxexts[1] +1;
 	elevVert = new float[3*maxx*maxy];
 	elevNorm = new float[3*maxx*maxy];
-	cachedTimeStep = timeStep;
 	float deltax = (twoDExts[3]-twoDExts[0])/(maxx-1); 
 	float deltay = (twoDExts[4]-twoDExts[1])/(maxy-1); 
 
-	//set minTex, maxTex values less than deltax, deltay so that the texture will
-	//map exactly to the original region bounds
-	
-
-	
-	minXTex = 0.f;
-	maxXTex = 1.f;
-	minYTex = 0.f;
-	maxYTex = 1.f;
-	 
 	//Then loop over all the vertices in the Elevation or height data. 
 	//For each vertex, construct the corresponding 3d point as well as the normal vector.
 	//These must be converted to
@@ -239,15 +288,9 @@ bool TwoDDataRenderer::rebuildElevationGrid(size_t timeStep){
 	//The z coordinate is taken from the data array, converted to 
 	//stretched cube coords
 	//using parameters in the viewpoint params.
-	
-	float minvals[3], maxvals[3];
-	for (int i = 0; i< 3; i++){
-		minvals[i] = 1.e30;
-		maxvals[i] = -1.e30;
-	}
 	float worldCoord[3], locCoord[3];
 	
-	for (int j = 0; j<maxy; j++){
+	for (int j = 0; j<maxy && !IsCancelled(); j++){
 		worldCoord[1] = twoDExts[1] + (float)j*deltay;
 			
 		for (int i = 0; i<maxx; i++){
@@ -275,25 +318,58 @@ bool TwoDDataRenderer::rebuildElevationGrid(size_t timeStep){
 						wc[1] = twoDExts[1] + (float)(j+ja)*deltay;
 						wc[2] = hgtGrid->GetValue(wc[0],wc[1], 0.);
 						if (wc[2] == hgtGrid->GetMissingValue()) continue;
-						locCoord[2] = wc[2] - usrExts[2]+tParams->getLocalTwoDMin(2);
+						locCoord[2] = wc[2] - usrExts[2]+localTwoDMinZ;
 						break;
 					}
 				}
 			}
-			else locCoord[2] = worldCoord[2] - usrExts[2]+tParams->getLocalTwoDMin(2);
-			//Convert and put results into elevation grid vertices:
-			ViewpointParams::localToStretchedCube(locCoord,elevVert+pntPos);
+			else locCoord[2] = worldCoord[2] - usrExts[2]+localTwoDMinZ;
+			//Convert and put results into elevation grid vertices, as
+			//ViewpointParams::localToStretchedCube() does:
 			for (int k = 0; k< 3; k++){
-				if( *(elevVert + pntPos+k) > maxvals[k])
-					maxvals[k] = *(elevVert + pntPos+k);
-				if( *(elevVert + pntPos+k) < minvals[k])
-					minvals[k] = *(elevVert + pntPos+k);
+				elevVert[pntPos+k] = locCoord[k]*stretch[k]/maxCubeSide;
 			}
 		}
 	}
-	//qWarning("min,max coords: %f %f %f %f %f %f",
-	//	minvals[0],minvals[1],minvals[2],maxvals[0],maxvals[1],maxvals[2]);
+	dataMgr->UnlockGrid(hgtGrid);
+	delete hgtGrid;
+	if (IsCancelled()) return -1;
+
 	//Now calculate normals:
-	calcElevGridNormals(timeStep);
+	TwoDRenderer::calcElevGridNormals(elevVert, elevNorm, maxx, maxy, stretch);
+	return 0;
+}
+
+//Use the elevation grid built by a job.  The job is deleted.
+bool TwoDDataRenderer::installJob(ElevGridJob* job){
+	size_t timeStep = (size_t)job->timestep;
+	if (job->GetStatus() < 0){
+		DataStatus* ds = DataStatus::getInstance();
+		if (!job->errMsg.empty() && !job->IsCancelled())
+			MyBase::SetErrMsg(job->errCode, "%s", job->errMsg.c_str());
+		setBypass(timeStep);
+		if (ds->warnIfDataMissing()){
+			SetErrMsg(VAPOR_WARNING_DATA_UNAVAILABLE,"Height data unavailable at timestep %d.", 
+				job->timestep);
+		}
+		ds->setDataMissing2D(timeStep, job->refLevel, job->lod, ds->getSessionVariableNum2D(job->varname[0]));
+		delete job;
+		return false;
+	}
+	invalidateElevGrid();
+	elevVert = job->elevVert;
+	elevNorm = job->elevNorm;
+	job->elevVert = job->elevNorm = 0;
+	maxXElev = job->maxx;
+	maxYElev = job->maxy;
+	cachedTimeStep = job->timestep;
+
+	//set minTex, maxTex values less than deltax, deltay so that the texture will
+	//map exactly to the original region bounds
+	minXTex = 0.f;
+	maxXTex = 1.f;
+	minYTex = 0.f;
+	maxYTex = 1.f;
+	delete job;
 	return true;
 }
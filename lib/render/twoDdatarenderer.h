@@ -33,6 +33,7 @@
 #include "twoDrenderer.h"
 #include "twoDdataparams.h"
 namespace VAPoR {
+class ElevGridJob;
 
 class RENDER_API TwoDDataRenderer : public TwoDRenderer
 {
@@ -46,7 +47,11 @@ public:
 
 	
 protected:
+	//The elevation grid is built by jobs run on worker threads
 	bool rebuildElevationGrid(size_t timestep);
+	int pendingTimestep;
+	ElevGridJob* makeJob(size_t timestep);
+	bool installJob(ElevGridJob* job);
 
 private:
 	
@@ -97,6 +97,8 @@ void TwoDRenderer::drawElevationGrid(size_t timeStep){
 		}
 
 	}
+	//The grid of the timestep may still be being prepared, with no earlier grid to draw
+	if (!elevVert) return;
 	int maxx = maxXElev;
 	int maxy = maxYElev;
 	if (maxx < 2 || maxy < 2) return;
@@ -313,13 +315,14 @@ void TwoDRenderer::invalidateElevGrid(){
 //adjacent vertices will be miniscule
 void TwoDRenderer::calcElevGridNormals(size_t timeStep){
 	const float* stretchFac = DataStatus::getInstance()->getStretchFactors();
-	int maxx = maxXElev;
-	int maxy = maxYElev;
+	calcElevGridNormals(elevVert, elevNorm, maxXElev, maxYElev, stretchFac);
+}
+void TwoDRenderer::calcElevGridNormals(const float* elevVert, float* elevNorm, int maxx, int maxy, const float stretchFac[3]){
 	//Go over the grid of vertices, calculating normals
 	//by looking at adjacent x,y,z coords.
 	for (int j = 0; j < maxy; j++){
 		for (int i = 0; i< maxx; i++){
-			float* point = elevVert+3*(i+maxx*j);
+			const float* point = elevVert+3*(i+maxx*j);
 			float* norm = elevNorm+3*(i+maxx*j);
 			//do differences of right point vs left point,
 			//except at edges of grid just do differences
@@ -50,6 +50,9 @@ public:
 
 	static const unsigned char* getTwoDTexture(TwoDParams* pParams, int frameNum, int &width, int &height);
 	void setAllDataDirty(){ ((TwoDParams*)getRenderParams())->setTwoDDirty();}
+	//Calculate the normals of an elevation grid of maxx by maxy vertices, in stretched
+	//cube coords, stretched by stretchFac.  Does not use the renderer, so render jobs may call it.
+	static void calcElevGridNormals(const float* elevVert, float* elevNorm, int maxx, int maxy, const float stretchFac[3]);
 	
 	
 protected:
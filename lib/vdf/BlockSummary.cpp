@@ -0,0 +1,398 @@
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <vapor/BlockSummary.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+#ifndef WIN32
+#include <stdint.h>
+#endif
+
+namespace {
+
+	//
+	// The file is written with fixed width types so that it can be shared
+	// by 32 and 64 bit builds. Values are in native byte order; the
+	// byte order mark is used to reject files written on a machine
+	// with a different order.
+	//
+#ifdef WIN32
+	typedef unsigned __int32 bsum_uint32_t;
+	typedef unsigned __int64 bsum_uint64_t;
+#else
+	typedef uint32_t bsum_uint32_t;
+	typedef uint64_t bsum_uint64_t;
+#endif
+
+	const char summaryMagic[8] = {'V','D','C','B','S','U','M','2'};
+	const bsum_uint32_t byteOrderMark = 0x01020304;
+
+	//
+	// Every member is naturally aligned, so the layout has no padding
+	//
+	typedef struct {
+		char magic[8];
+		bsum_uint32_t byteOrder;
+		bsum_uint32_t bs[3];
+		bsum_uint32_t bmin[3];
+		bsum_uint32_t bdim[3];
+		bsum_uint64_t dims[3];
+		bsum_uint64_t fingerprint;
+	} header_t;
+
+	// Bytes stored per block: min, max, mean and count
+	//
+	const size_t blockRecordSize = 3*sizeof(float) + sizeof(bsum_uint32_t);
+};
+
+BlockSummary::BlockSummary() {
+	for (int i=0; i<3; i++) {
+		_bs[i] = 1;
+		_bmin[i] = 0;
+		_bdim[i] = 0;
+		_dims[i] = 0;
+	}
+	_fingerprint = 0;
+}
+
+void BlockSummary::Init(
+	const size_t bs[3], const size_t bmin[3], const size_t bdim[3]
+) {
+	size_t n = 1;
+	for (int i=0; i<3; i++) {
+		_bs[i] = bs[i] ? bs[i] : 1;
+		_bmin[i] = bmin[i];
+		_bdim[i] = bdim[i];
+		n *= bdim[i];
+	}
+	_min.assign(n, 0.0);
+	_max.assign(n, 0.0);
+	_mean.assign(n, 0.0);
+	_count.assign(n, 0);
+}
+
+void BlockSummary::SetSource(
+	const size_t dims[3], unsigned long long fingerprint
+) {
+	for (int i=0; i<3; i++) _dims[i] = dims[i];
+	_fingerprint = fingerprint;
+}
+
+bool BlockSummary::_index(const size_t bcoord[3], size_t *idx) const {
+	for (int i=0; i<3; i++) {
+		if (bcoord[i] < _bmin[i] || bcoord[i] >= _bmin[i] + _bdim[i]) {
+			return(false);
+		}
+	}
+	*idx = (bcoord[2]-_bmin[2]) * _bdim[1] * _bdim[0] +
+		(bcoord[1]-_bmin[1]) * _bdim[0] + (bcoord[0]-_bmin[0]);
+	return(true);
+}
+
+void BlockSummary::Compute(const RegularGrid *rg, const size_t bs[3]) {
+
+	size_t origin[3], dims[3], gbs[3];
+	rg->GetIJKOrigin(origin);
+	rg->GetDimensions(dims);
+	rg->GetBlockSize(gbs);
+
+	size_t bmin[3], bdim[3];
+	for (int i=0; i<3; i++) {
+		size_t sbs = bs[i] ? bs[i] : 1;
+		bmin[i] = origin[i] / sbs;
+		bdim[i] = (origin[i] + dims[i] - 1) / sbs - bmin[i] + 1;
+	}
+	Init(bs, bmin, bdim);
+
+	//
+	// Summary block index of each grid coordinate, along each axis
+	//
+	vector <size_t> sidx[3];
+	for (int i=0; i<3; i++) {
+		sidx[i].resize(dims[i]);
+		for (size_t v=0; v<dims[i]; v++) {
+			sidx[i][v] = (origin[i] + v) / _bs[i] - _bmin[i];
+		}
+	}
+
+	size_t n = _count.size();
+	vector <double> sum(n, 0.0);
+	vector <float> mins(n, FLT_MAX);
+	vector <float> maxs(n, -FLT_MAX);
+	vector <size_t> counts(n, 0);
+
+	float mv = rg->GetMissingValue();
+	float **blks = rg->GetBlks();
+
+	//
+	// Visit the grid a storage block at a time. The grid's first
+	// block starts goff voxels before the grid origin.
+	//
+	size_t goff[3], gbdim[3];
+	for (int i=0; i<3; i++) {
+		goff[i] = origin[i] % gbs[i];
+		gbdim[i] = (goff[i] + dims[i] - 1) / gbs[i] + 1;
+	}
+
+	for (size_t gbz = 0; gbz < gbdim[2]; gbz++) {
+	for (size_t gby = 0; gby < gbdim[1]; gby++) {
+	for (size_t gbx = 0; gbx < gbdim[0]; gbx++) {
+		const float *blk = blks[gbz*gbdim[1]*gbdim[0] + gby*gbdim[0] + gbx];
+		size_t gb[3] = {gbx, gby, gbz};
+
+		// Range of grid coordinates covered by this block
+		//
+		size_t v0[3], v1[3];
+		for (int i=0; i<3; i++) {
+			size_t first = gb[i] * gbs[i];	// relative to block origin
+			v0[i] = first > goff[i] ? first - goff[i] : 0;
+			v1[i] = first + gbs[i] - goff[i];
+			if (v1[i] > dims[i]) v1[i] = dims[i];
+		}
+
+		for (size_t z = v0[2]; z < v1[2]; z++) {
+		for (size_t y = v0[1]; y < v1[1]; y++) {
+			const float *line = blk +
+				((z+goff[2]) % gbs[2]) * gbs[1] * gbs[0] +
+				((y+goff[1]) % gbs[1]) * gbs[0];
+			size_t base = sidx[2][z] * _bdim[1] * _bdim[0] +
+				sidx[1][y] * _bdim[0];
+
+			for (size_t x = v0[0]; x < v1[0]; x++) {
+				float v = line[(x+goff[0]) % gbs[0]];
+				if (v == mv || v != v) continue;
+
+				size_t idx = base + sidx[0][x];
+				if (v < mins[idx]) mins[idx] = v;
+				if (v > maxs[idx]) maxs[idx] = v;
+				sum[idx] += v;
+				counts[idx]++;
+			}
+		}
+		}
+	}
+	}
+	}
+
+	for (size_t idx=0; idx<n; idx++) {
+		if (! counts[idx]) continue;
+		_min[idx] = mins[idx];
+		_max[idx] = maxs[idx];
+		_mean[idx] = sum[idx] / (double) counts[idx];
+		_count[idx] = counts[idx];
+	}
+}
+
+void BlockSummary::SetBlock(
+	const size_t bcoord[3], float min, float max, float mean, size_t count
+) {
+	size_t idx;
+	if (! _index(bcoord, &idx)) return;
+
+	_min[idx] = count ? min : 0.0;
+	_max[idx] = count ? max : 0.0;
+	_mean[idx] = count ? mean : 0.0;
+	_count[idx] = count;
+}
+
+bool BlockSummary::GetBlock(
+	const size_t bcoord[3], float range[2], float *mean, size_t *count
+) const {
+	size_t idx;
+	if (! _index(bcoord, &idx)) return(false);
+	if (! _count[idx]) return(false);
+
+	range[0] = _min[idx];
+	range[1] = _max[idx];
+	*mean = _mean[idx];
+	*count = _count[idx];
+	return(true);
+}
+
+bool BlockSummary::GetRange(float range[2]) const {
+	range[0] = range[1] = 0.0;
+	bool first = true;
+	for (size_t idx=0; idx<_count.size(); idx++) {
+		if (! _count[idx]) continue;
+		if (first || _min[idx] < range[0]) range[0] = _min[idx];
+		if (first || _max[idx] > range[1]) range[1] = _max[idx];
+		first = false;
+	}
+	return(! first);
+}
+
+bool BlockSummary::GetRange(
+	const size_t min[3], const size_t max[3], float range[2]
+) const {
+	range[0] = range[1] = 0.0;
+
+	size_t b0[3], b1[3];
+	for (int i=0; i<3; i++) {
+		if (! _bdim[i]) return(false);
+
+		b0[i] = min[i] / _bs[i];
+		b1[i] = max[i] / _bs[i];
+		if (b0[i] < _bmin[i]) b0[i] = _bmin[i];
+		if (b1[i] > _bmin[i] + _bdim[i] - 1) b1[i] = _bmin[i] + _bdim[i] - 1;
+		if (b0[i] > b1[i]) return(false);
+	}
+
+	bool first = true;
+	for (size_t bz = b0[2]; bz <= b1[2]; bz++) {
+	for (size_t by = b0[1]; by <= b1[1]; by++) {
+	for (size_t bx = b0[0]; bx <= b1[0]; bx++) {
+		size_t idx = (bz-_bmin[2]) * _bdim[1] * _bdim[0] +
+			(by-_bmin[1]) * _bdim[0] + (bx-_bmin[0]);
+
+		if (! _count[idx]) continue;
+		if (first || _min[idx] < range[0]) range[0] = _min[idx];
+		if (first || _max[idx] > range[1]) range[1] = _max[idx];
+		first = false;
+	}
+	}
+	}
+	return(! first);
+}
+
+double BlockSummary::GetMean() const {
+	double sum = 0.0;
+	size_t count = 0;
+	for (size_t idx=0; idx<_count.size(); idx++) {
+		sum += (double) _mean[idx] * (double) _count[idx];
+		count += _count[idx];
+	}
+	return(count ? sum / (double) count : 0.0);
+}
+
+size_t BlockSummary::GetCount() const {
+	size_t count = 0;
+	for (size_t idx=0; idx<_count.size(); idx++) count += _count[idx];
+	return(count);
+}
+
+int BlockSummary::Write(const string &path) const {
+
+	header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, summaryMagic, sizeof(header.magic));
+	header.byteOrder = byteOrderMark;
+	for (int i=0; i<3; i++) {
+		header.bs[i] = (bsum_uint32_t) _bs[i];
+		header.bmin[i] = (bsum_uint32_t) _bmin[i];
+		header.bdim[i] = (bsum_uint32_t) _bdim[i];
+		header.dims[i] = (bsum_uint64_t) _dims[i];
+	}
+	header.fingerprint = (bsum_uint64_t) _fingerprint;
+
+	string tmppath = path + ".tmp";
+	FILE *fp = fopen(tmppath.c_str(), "wb");
+	if (! fp) {
+		SetErrMsg("fopen(%s) : %M", tmppath.c_str());
+		return(-1);
+	}
+
+	size_t n = _count.size();
+	vector <bsum_uint32_t> count(_count.begin(), _count.end());
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && n) {
+		ok = fwrite(&_min[0], sizeof(_min[0]), n, fp) == n &&
+			fwrite(&_max[0], sizeof(_max[0]), n, fp) == n &&
+			fwrite(&_mean[0], sizeof(_mean[0]), n, fp) == n &&
+			fwrite(&count[0], sizeof(count[0]), n, fp) == n;
+	}
+	if (fclose(fp) != 0) ok = false;
+
+	if (ok) {
+#ifdef WIN32
+		remove(path.c_str());	// rename() won't replace on Windows
+#endif
+		ok = rename(tmppath.c_str(), path.c_str()) == 0;
+	}
+	if (! ok) {
+		SetErrMsg("Error writing block summary file %s : %M", path.c_str());
+		remove(tmppath.c_str());
+		return(-1);
+	}
+	return(0);
+}
+
+int BlockSummary::Read(const string &path) {
+
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (! fp) {
+		SetErrMsg("fopen(%s) : %M", path.c_str());
+		return(-1);
+	}
+
+	header_t header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+		memcmp(header.magic, summaryMagic, sizeof(header.magic)) == 0 &&
+		header.byteOrder == byteOrderMark;
+
+	//
+	// The blocks must lie within the volume, if its dimensions were
+	// recorded, and the file must hold
+	// exactly one record per block. Checking the size first keeps a
+	// corrupt header from provoking a huge allocation.
+	//
+	long nbytes = 0;
+	if (ok) {
+		long here = ftell(fp);
+		ok = fseek(fp, 0, SEEK_END) == 0 && (nbytes = ftell(fp) - here) >= 0 &&
+			fseek(fp, here, SEEK_SET) == 0;
+	}
+	size_t bs[3], bmin[3], bdim[3], dims[3];
+	size_t n = 1;
+	for (int i=0; ok && i<3; i++) {
+		bs[i] = header.bs[i];
+		bmin[i] = header.bmin[i];
+		bdim[i] = header.bdim[i];
+		dims[i] = (size_t) header.dims[i];
+		if (! bs[i] || (bsum_uint64_t) dims[i] != header.dims[i]) ok = false;
+		else if (dims[i] && bdim[i] && (bmin[i]+bdim[i]-1) * bs[i] >= dims[i]) {
+			ok = false;
+		}
+		else if (bdim[i] && n > (size_t) nbytes / blockRecordSize / bdim[i]) {
+			ok = false;
+		}
+		n *= bdim[i];
+	}
+	if (ok && n * blockRecordSize != (size_t) nbytes) ok = false;
+
+	if (! ok) {
+		fclose(fp);
+		SetErrMsg("Invalid block summary file %s", path.c_str());
+		return(-1);
+	}
+
+	Init(bs, bmin, bdim);
+	SetSource(dims, header.fingerprint);
+
+	vector <bsum_uint32_t> count(n);
+	if (n) {
+		ok = fread(&_min[0], sizeof(_min[0]), n, fp) == n &&
+			fread(&_max[0], sizeof(_max[0]), n, fp) == n &&
+			fread(&_mean[0], sizeof(_mean[0]), n, fp) == n &&
+			fread(&count[0], sizeof(count[0]), n, fp) == n;
+	}
+	fclose(fp);
+
+	//
+	// A block can't have more valid values than voxels
+	//
+	size_t bsize = bs[0] * bs[1] * bs[2];
+	for (size_t idx=0; ok && idx<n; idx++) {
+		_count[idx] = count[idx];
+		if (count[idx] > bsize) ok = false;
+		else if (count[idx] && ! (_min[idx] <= _max[idx])) ok = false;
+	}
+
+	if (! ok) {
+		Init(bs, bmin, bdim);
+		SetErrMsg("Invalid block summary file %s", path.c_str());
+		return(-1);
+	}
+	return(0);
+}
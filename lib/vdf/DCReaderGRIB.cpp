@@ -25,6 +25,7 @@
 #include <string>
 #include <cmath>
 
+#include "vapor/CFuncs.h"
 #include "vapor/Proj4API.h"
 #include "vapor/GetAppPath.h"
 #include "vapor/DCReaderGRIB.h"
@@ -94,8 +95,76 @@ void DCReaderGRIB::Variable::_AddIndex(double time, float level, string file, in
     _indices[time][level] = location;
 }
 
-DCReaderGRIB::DCReaderGRIB(const vector <string> files) {
+namespace VAPoR {
 
+    // thread helper function
+    //
+    void *RunDCReaderGRIBThread(void *object) {
+        DCReaderGRIB::ThreadObj *X = (DCReaderGRIB::ThreadObj *) object;
+        X->RunThread();
+        return(0);
+    }
+};
+
+namespace {
+
+    // Read the GRIB message at the current position of fp into message.
+    // Section 0 gives the edition and the length of the message, except
+    // for GRIB 1 messages over 8 MB, whose length is coded elsewhere. 0
+    // is returned, with fp left where it was, for these and for anything
+    // that doesn't start with a section 0, for grib_api to read.
+    //
+    int readMessage(FILE *fp, std::vector<unsigned char> &message) {
+        unsigned char ind[16];
+        size_t n = fread(ind, 1, sizeof(ind), fp);
+
+        size_t len = 0;
+        if (n == sizeof(ind) && memcmp(ind, "GRIB", 4) == 0) {
+            if (ind[7] == 1) {
+                len = ((size_t) ind[4]<<16) | ((size_t) ind[5]<<8) | ind[6];
+                if (len & 0x800000) len = 0;
+            }
+            else if (ind[7] == 2) {
+                for (int i=8; i<16; i++) len = (len << 8) | ind[i];
+            }
+        }
+        if (len <= sizeof(ind)) {
+            return(fseek(fp, -(long) n, SEEK_CUR) == 0 ? 0 : -1);
+        }
+
+        message.resize(len);
+        memcpy(&message[0], ind, sizeof(ind));
+        n = len - sizeof(ind);
+        if (fread(&message[sizeof(ind)], 1, n, fp) != n) return(-1);
+        return(1);
+    }
+};
+
+// Copy a decoded GRIB field one row at a time. The row and direction
+// a GRIB row lands in depend only on the scan mode.
+//
+void DCReaderGRIB::ReorderField(
+    const double *src, int ni, int nj, bool iScanNeg, bool jScanPos,
+    double divisor, float *dst
+) {
+    for (int j=0; j<nj; j++) {
+        const double *s = src + (size_t) j*ni;
+        float *d = dst + (size_t) (jScanPos ? j : nj-1-j)*ni;
+        if (iScanNeg) {
+            d += ni-1;
+            for (int i=0; i<ni; i++) *d-- = (float) s[i] / divisor;
+        }
+        else {
+            for (int i=0; i<ni; i++) *d++ = (float) s[i] / divisor;
+        }
+    }
+}
+
+DCReaderGRIB::DCReaderGRIB(const vector <string> files) : _et(0) {
+
+    _nthreads = _et.GetNumThreads();
+    if (_nthreads < 1) _nthreads = 1;
+    _inFile = NULL;
     _iValues = NULL;
     _ignoreForecastData = 0;
     _Ni = 0;
@@ -127,31 +196,48 @@ int DCReaderGRIB::OpenVariableRead(size_t timestep, string varname,
         _sliceNum = _pressureLevels.size()-1;
         level = targetVar->GetLevel(_sliceNum);
         filename = targetVar->GetFileName(usertime,level);
-        _inFile = fopen(filename.c_str(),"rb");
-        if(!_inFile) {
-            MyBase::SetErrMsg("ERROR: unable to open file %s",filename.c_str());
-            return -1;
-        }
     }
     else if (_vars2d.find(varname) != _vars2d.end()) {  // we have a 2d var
         targetVar = _vars2d[_openVar];
         level = targetVar->GetLevel(0);
         filename = targetVar->GetFileName(usertime,level);
         _sliceNum = 0;
+    }
+    else {
+        MyBase::SetErrMsg("ERROR: Variable does not exist");
+        return -1;
+    }
+
+    if (_inFile && filename != _inFileName) {
+        fclose(_inFile);
+        _inFile = NULL;
+    }
+    if (! _inFile) {
         _inFile = fopen(filename.c_str(),"rb");
         if(!_inFile) {
+            _inFileName.clear();
             MyBase::SetErrMsg("ERROR: unable to open file %s",filename.c_str());
             return -1;
         }
-    }
-    else {
-        MyBase::SetErrMsg("ERROR: Variable does not exist");
-        return -1;
+        _inFileName = filename;
     }
     return 0;
 }
 
 int DCReaderGRIB::Read(float *_values) {
+    if (_sliceNum >= 0 && _openVar != "absv" &&
+        _vars3d.find(_openVar) != _vars3d.end()) {
+
+        // The remaining levels, bottom up
+        //
+        size_t nlevels = _pressureLevels.size();
+        size_t min[] = {0, 0, nlevels - _sliceNum - 1};
+        size_t max[] = {(size_t) _Ni-1, (size_t) _Nj-1, nlevels-1};
+        if (_ReadLevels(min, max, _values) < 0) return -1;
+        _sliceNum = -1;
+        return 0;
+    }
+
     float *ptr = _values;
     int rc;
     while ((rc = DCReaderGRIB::ReadSlice(ptr)) > 0) {
@@ -160,102 +246,244 @@ int DCReaderGRIB::Read(float *_values) {
     return rc;
 }
 
-int DCReaderGRIB::ReadSlice(float *values){
-    if (_sliceNum < 0) return 0;
+int DCReaderGRIB::ReadRegion(
+    const size_t min[3], const size_t max[3], float *region
+) {
+    bool is3d = _vars2d.find(_openVar) == _vars2d.end();
+    if (is3d && _openVar != "absv") {
+        if (max[2] >= _pressureLevels.size()) {
+            MyBase::SetErrMsg("Invalid region");
+            return -1;
+        }
+        return(_ReadLevels(min, max, region));
+    }
+    size_t nz = is3d ? max[2]-min[2]+1 : 1;
 
-    if (_openVar == "absv"){//"ELEVATION") {
-        for (int x=0; x<_Ni; x++){
-            for (int y=0; y<_Nj; y++){
-                values[x + y*_Ni] = _hydrostaticElevation[x + y*_Ni + (_pressureLevels.size()-_sliceNum-1)*_Ni*_Nj];
+    // Each level is a GRIB message holding the whole horizontal grid,
+    // so levels are decoded one at a time and cropped
+    //
+    float *slice = new float[_Ni*_Nj];
+    float *ptr = region;
+    for (size_t z=0; z<nz; z++) {
+        if (is3d) _sliceNum = _pressureLevels.size() - (min[2]+z) - 1;
+
+        int rc = DCReaderGRIB::ReadSlice(slice);
+        if (rc < 1) {
+            if (rc == 0) MyBase::SetErrMsg("Invalid region");
+            delete [] slice;
+            return -1;
+        }
+        for (size_t y=min[1]; y<=max[1]; y++) {
+            for (size_t x=min[0]; x<=max[0]; x++) {
+                *ptr++ = slice[x + y*_Ni];
             }
         }
-        _sliceNum--;
-        return 1;
     }
+    delete [] slice;
+    return 0;
+}
+
+DCReaderGRIB::ThreadObj::ThreadObj(
+    DCReaderGRIB *reader, int id,
+    const size_t min[3], const size_t max[3], float *region
+) {
+    _reader = reader;
+    _id = id;
+    for (int i=0; i<3; i++) {
+        _min[i] = min[i];
+        _max[i] = max[i];
+    }
+    _region = region;
+    _fp = NULL;
+    _rc = 0;
+}
+
+// Messages of the thread are diverted, and kept for _ReadLevels()
+//
+void DCReaderGRIB::ThreadObj::RunThread() {
+    bool diverted = MyBase::DivertThreadErrMsg(true);
+    _rc = _Run();
+    _errMsg = _rc < 0 ? MyBase::GetThreadErrMsg() : "";
+    MyBase::DivertThreadErrMsg(diverted);
+}
+
+int DCReaderGRIB::ThreadObj::_Run() {
+    int ni = _reader->_Ni;
+    int nj = _reader->_Nj;
+    size_t nlevels = _reader->_pressureLevels.size();
+    size_t nx = _max[0]-_min[0]+1;
+    size_t ny = _max[1]-_min[1]+1;
+    size_t nz = _max[2]-_min[2]+1;
+
+    // Whole levels are decoded in place
+    //
+    bool whole = nx == (size_t) ni && ny == (size_t) nj;
+    if (! whole) _slice.resize((size_t) ni*nj);
+
+    for (size_t z=_id; z<nz; z+=_reader->_nthreads) {
+        int sliceNum = nlevels - (_min[2]+z) - 1;
+        float *dst = _region + z*nx*ny;
+        float *slice = whole ? dst : &_slice[0];
+
+        int rc = _reader->_ReadLevel(
+            sliceNum, _fp, _fileName, _message, _dvalues, slice
+        );
+        if (rc < 0) return(-1);
+        if (whole) continue;
+
+        for (size_t y=_min[1]; y<=_max[1]; y++) {
+            memcpy(dst, slice + y*ni + _min[0], nx*sizeof(*dst));
+            dst += nx;
+        }
+    }
+    return(0);
+}
+
+int DCReaderGRIB::_ReadLevels(
+    const size_t min[3], const size_t max[3], float *region
+) {
+    std::vector <ThreadObj *> objs;
+    for (int t=0; t<_nthreads; t++) {
+        objs.push_back(new ThreadObj(this, t, min, max, region));
+    }
+
+    int rc = 0;
+    if (_nthreads <= 1) {
+        objs[0]->RunThread();
+    }
+    else {
+        rc = _et.ParRun(RunDCReaderGRIBThread, (void **) &objs[0]);
+        if (rc < 0) MyBase::SetErrMsg("Error spawning threads");
+    }
+    for (int t=0; t<_nthreads; t++) {
+        if (objs[t]->GetStatus() < 0 && rc >= 0) {
+            MyBase::SetErrMsg("%s", objs[t]->GetErrMsg().c_str());
+            rc = -1;
+        }
+        delete objs[t];
+    }
+    return(rc < 0 ? -1 : 0);
+}
+
+int DCReaderGRIB::_ReadLevel(
+    int sliceNum, FILE *&fp, string &fileName,
+    std::vector<unsigned char> &message,
+    std::vector<double> &dvalues, float *slice
+) {
     Variable *targetVar;
     if (_vars3d.find(_openVar) != _vars3d.end()) {     // we have a 3d var
         targetVar = _vars3d[_openVar];
     }
-
     else if (_vars2d.find(_openVar) != _vars2d.end()) {  // we have a 2d var
         targetVar = _vars2d[_openVar];
-        _sliceNum = 0;
     }
     else {
         MyBase::SetErrMsg("Variable %s not found in 2d or 3d variable set",_openVar.c_str());
         return -1;
     }
     double usertime = GetTSUserTime(_openTS);
-    float level = targetVar->GetLevel(_sliceNum);
+    float level = targetVar->GetLevel(sliceNum);
     int offset = targetVar->GetOffset(usertime,level);
     string filename = targetVar->GetFileName(usertime,level);
 
-    int rc = fseek(_inFile,offset,SEEK_SET);
+    if (fp && filename != fileName) {
+        fclose(fp);
+        fp = NULL;
+    }
+    if (! fp) {
+        fp = fopen(filename.c_str(),"rb");
+        if (! fp) {
+            fileName.clear();
+            MyBase::SetErrMsg("ERROR: unable to open file %s",filename.c_str());
+            return -1;
+        }
+        fileName = filename;
+    }
+
+    int rc = fseek(fp,offset,SEEK_SET);
     if (rc != 0) {
         MyBase::SetErrMsg("fseek error during GRIB ReadSlice");
         return -1;
     }
 
-    // create new handle from a message in a file
-    int err;
-    grib_handle* h = grib_handle_new_from_file(0,_inFile,&err);
+    // Threads read their messages, and reorder the values, concurrently.
+    // grib_api is built without thread support, and its decoders aren't
+    // known to leave shared state alone, so messages are decoded one at
+    // a time.
+    //
+    rc = readMessage(fp, message);
+    if (rc < 0) {
+        MyBase::SetErrMsg(
+            "Error reading GRIB message at offset %d of file %s",
+            offset, filename.c_str()
+        );
+        return -1;
+    }
+
+    _et.MutexLock();
+    int err = 0;
+    grib_handle* h = rc > 0 ?
+        grib_handle_new_from_message(0, &message[0], message.size()) :
+        grib_handle_new_from_file(0, fp, &err);
     if (h == NULL) {
+        _et.MutexUnlock();
         MyBase::SetErrMsg("Error: unable to create handle from file %s",filename.c_str());
         return -1;
     }
 
-    // get the size of the _values array
-    size_t values_len;
-    GRIB_CHECK(grib_get_size(h,"values",&values_len),0);
-    double* _dvalues = new double[values_len];
-
-    // get data _values
-    GRIB_CHECK(grib_get_double_array(h,"values",_dvalues,&values_len),0);
-
-    // re-order values according to scan direciton and convert doubles to floats
-    float min,max;
-    min = (float) _dvalues[0];
-    max = (float) _dvalues[0];
-    int vaporIndex, i, j;
-    for(size_t gribIndex = 0; gribIndex < values_len; gribIndex++) {
-        if (_iScanNeg == 1) {
-            if (_jScanPos == 1) {   // 1 1
-                i = _Ni - gribIndex%_Ni;
-                j = gribIndex/_Ni;
-                vaporIndex = j*_Ni + i;
-            }
-            else {            // 1 0
-                vaporIndex = _Ni*_Nj - gribIndex - 1;
-            }
-        }
-       else {
-            if (_jScanPos == 0) {  // 0 0
-                i = gribIndex % _Ni;
-                j = ((_Ni * _Nj) - 1 - gribIndex) / _Ni;
-                vaporIndex = j * _Ni + i;
-            }
-            else {
-                vaporIndex = gribIndex;
-            }
-        }
+    // get the size of the values array, and the values
+    //
+    size_t values_len = 0;
+    err = grib_get_size(h,"values",&values_len);
+    if (err == 0 && values_len != (size_t) _Ni*_Nj) err = GRIB_WRONG_ARRAY_SIZE;
+    if (err == 0) {
+        if (dvalues.size() < values_len) dvalues.resize(values_len);
+        err = grib_get_double_array(h,"values",&dvalues[0],&values_len);
+    }
 
-        if (_openVar == "z") {      // z is geopotential.  Divide by g to get geopotential height
-            values[vaporIndex] = (float) _dvalues[gribIndex] / 9.8;
-        }
-        else {
-            values[vaporIndex] = (float) _dvalues[gribIndex];
-        }
-        if (values[vaporIndex] < min) min = values[vaporIndex];
-        if (values[vaporIndex] > max) max = values[vaporIndex];
+    grib_handle_delete(h);
+    _et.MutexUnlock();
+
+    if (err != 0) {
+        MyBase::SetErrMsg(
+            "Error decoding GRIB message at offset %d of file %s : %s",
+            offset, filename.c_str(), grib_get_error_message(err)
+        );
+        return -1;
     }
 
+    // re-order values according to scan direction and convert doubles
+    // to floats. z is geopotential. Divide by g to get geopotential height
+    //
+    double divisor = _openVar == "z" ? 9.8 : 1.0;
+    ReorderField(&dvalues[0], _Ni, _Nj, _iScanNeg, _jScanPos, divisor, slice);
+
     // Apply linear interpolation on _values if we are on a gaussian grid
     //if(!strcmp(_gridType.c_str(),"regular_gg")) _LinearInterpolation(values);
 
-    //cout << _openVar << " " << _openTS << " " <<  usertime << " " << level << " " << _sliceNum << " " << offset << " " << filename << " " << min << " " << max <<
-    delete [] _dvalues;
+    return 0;
+}
 
-    grib_handle_delete(h);
+int DCReaderGRIB::ReadSlice(float *values){
+    if (_sliceNum < 0) return 0;
+
+    if (_openVar == "absv"){//"ELEVATION") {
+        for (int x=0; x<_Ni; x++){
+            for (int y=0; y<_Nj; y++){
+                values[x + y*_Ni] = _hydrostaticElevation[x + y*_Ni + (_pressureLevels.size()-_sliceNum-1)*_Ni*_Nj];
+            }
+        }
+        _sliceNum--;
+        return 1;
+    }
+    if (_vars2d.find(_openVar) != _vars2d.end()) _sliceNum = 0;
+
+    int rc = _ReadLevel(
+        _sliceNum, _inFile, _inFileName, _message, _dvalues, values
+    );
+    if (rc < 0) {
+        return -1;
+    }
 
     _sliceNum--;
     return 1;
@@ -1114,8 +1342,117 @@ DCReaderGRIB::GribParser::GribParser() {
     _err        = 0;
 }
 
+namespace {
+
+    const string gribIndexMagic = "VAPORGRIBINDEX1";
+};
+
+int DCReaderGRIB::ReadIndex(
+    const string &file,
+    std::vector<std::map<std::string, std::string> > &records
+) {
+    records.clear();
+
+    string stamp;
+    if (FileStamp(file, stamp) < 0) return(-1);
+
+    ifstream in((file + ".gidx").c_str());
+    if (! in) return(-1);
+
+    string line;
+    if (! getline(in, line) || line != gribIndexMagic) return(-1);
+    if (! getline(in, line) || line != stamp) return(-1);
+
+    size_t nrecords = 0;
+    if (! getline(in, line)) return(-1);
+    istringstream(line) >> nrecords;
+    if (nrecords == 0) return(-1);
+
+    std::vector<std::map<std::string, std::string> > recs(nrecords);
+    for (size_t r=0; r<nrecords; r++) {
+        size_t nkeys = 0;
+        if (! getline(in, line)) return(-1);
+        istringstream(line) >> nkeys;
+
+        for (size_t k=0; k<nkeys; k++) {
+            if (! getline(in, line)) return(-1);
+            string::size_type eq = line.find('=');
+            if (eq == string::npos) return(-1);
+            recs[r][line.substr(0, eq)] = line.substr(eq+1);
+        }
+        if (recs[r].find("offset") == recs[r].end()) return(-1);
+
+        // The file may have been moved along with its index
+        //
+        recs[r]["file"] = file;
+    }
+    if (! getline(in, line) || line != gribIndexMagic) return(-1);
+
+    records.swap(recs);
+    return(0);
+}
+
+int DCReaderGRIB::GribParser::_ReadIndex(const string &file) {
+    std::vector<std::map<std::string, std::string> > records;
+    if (DCReaderGRIB::ReadIndex(file, records) < 0) return(-1);
+
+    _recordKeys.insert(_recordKeys.end(), records.begin(), records.end());
+    return(0);
+}
+
+void DCReaderGRIB::WriteIndex(
+    const string &file,
+    const std::vector<std::map<std::string, std::string> > &records
+) {
+    string stamp;
+    if (FileStamp(file, stamp) < 0) return;
+
+    ostringstream oss;
+    oss << gribIndexMagic << endl << stamp << endl;
+    oss << records.size() << endl;
+    for (size_t r=0; r<records.size(); r++) {
+        const std::map<std::string, std::string> &keys = records[r];
+        oss << keys.size() - keys.count("file") << endl;
+
+        std::map<std::string, std::string>::const_iterator itr;
+        for (itr = keys.begin(); itr != keys.end(); ++itr) {
+            if (itr->first == "file") continue;
+            if (itr->second.find('\n') != string::npos) return;
+            oss << itr->first << "=" << itr->second << endl;
+        }
+    }
+    oss << gribIndexMagic << endl;
+
+    string path = file + ".gidx";
+    string tmppath = path + ".tmp";
+    ofstream out(tmppath.c_str());
+    if (! out) return;
+    out << oss.str();
+    out.close();
+    if (! out) {
+        remove(tmppath.c_str());
+        return;
+    }
+#ifdef WIN32
+    remove(path.c_str());	// rename() won't replace on Windows
+#endif
+    if (rename(tmppath.c_str(), path.c_str()) != 0) remove(tmppath.c_str());
+}
+
+void DCReaderGRIB::GribParser::_WriteIndex(
+    const string &file, size_t first
+) const {
+    std::vector<std::map<std::string, std::string> > records(
+        _recordKeys.begin() + first, _recordKeys.end()
+    );
+    DCReaderGRIB::WriteIndex(file, records);
+}
+
 int DCReaderGRIB::GribParser::_LoadRecordKeys(string file) {
 
+    if (_ReadIndex(file) == 0) return 0;
+    size_t first = _recordKeys.size();
+
     FILE* _in = fopen(file.c_str(),"rb");
     if(!_in) {
         MyBase::SetErrMsg("ERROR: unable to open file %s.",file.c_str());
@@ -1205,6 +1542,8 @@ int DCReaderGRIB::GribParser::_LoadRecordKeys(string file) {
 
     _grib_count=0;
     fclose(_in);
+
+    _WriteIndex(file, first);
     return 0;
 }
 
@@ -517,6 +517,82 @@ int DCReaderMOM::Read(float *data) {
 	return(rc);
 }
 
+int DCReaderMOM::ReadRegion(
+	const size_t min[3], const size_t max[3], float *region
+) {
+	size_t nx = max[0]-min[0]+1;
+	size_t ny = max[1]-min[1]+1;
+
+	//
+	// Deal with derived variables
+	//
+	if (IsVariableDerived(_ovr_varname)) {
+		const float *ptr;
+		if (_ovr_varname.compare("angleRAD") == 0) {
+			ptr = _angleRADBuf;
+		}
+		else {
+			ptr = _latDEGBuf;
+		}
+		for (size_t y=0; y<ny; y++) {
+		for (size_t x=0; x<nx; x++) {
+			region[y*nx + x] = ptr[(min[1]+y)*_dims[0] + min[0]+x];
+		}
+		}
+		return(0);
+	}
+	if (_ovr_fd < 0) return (-1);
+
+	vector <size_t> dims = _GetSpatialDims(_ncdfc, _ovr_varname);
+	if (dims.size() < 2) {
+		SetErrMsg("Invalid operation");
+		return(-1);
+	}
+	bool is3d = dims.size() == 3;
+	size_t nz = is3d ? max[2]-min[2]+1 : 1;
+
+	//
+	// Native grid rows and columns the resampling needs
+	//
+	size_t smin[2], smax[2];
+	_ovr_weight_tbl->sourceRegion(min, max, smin, smax);
+	size_t snx = smax[0]-smin[0]+1;
+	size_t sny = smax[1]-smin[1]+1;
+
+	size_t start[] = {0, smin[1], smin[0]};
+	size_t count[] = {nz, sny, snx};
+	if (is3d) start[0] = _reverseRead ? _ovr_nz-max[2]-1 : min[2];
+
+	float *buf = new float[nz*sny*snx];
+	int rc = _ncdfc->Read(
+		is3d ? start : start+1, is3d ? count : count+1, buf, _ovr_fd
+	);
+	if (rc<0) {
+		delete [] buf;
+		return(rc);
+	}
+
+	float mv;
+	bool has_missing = DCReaderMOM::GetMissingValue(_ovr_varname, mv);
+
+	//
+	// If there are no missing values resampling may still 
+	// introduce them.
+	//
+	if (! has_missing) mv = _defaultMV;
+
+	for (size_t z=0; z<nz; z++) {
+		size_t level = _reverseRead ? nz-z-1 : z;
+		_ovr_weight_tbl->interp2D(
+			buf + level*sny*snx, smin, smax, region + z*ny*nx, min, max, 
+			mv, mv
+		);
+	}
+	delete [] buf;
+
+	return(0);
+}
+
 int DCReaderMOM::CloseVariable() {
 
 	bool derived = IsVariableDerived(_ovr_varname);
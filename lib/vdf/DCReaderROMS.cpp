@@ -497,6 +497,94 @@ int DCReaderROMS::Read(float *data) {
 	return(rc);
 }
 
+int DCReaderROMS::ReadRegion(
+	const size_t min[3], const size_t max[3], float *region
+) {
+	size_t nx = max[0]-min[0]+1;
+	size_t ny = max[1]-min[1]+1;
+
+	//
+	// Deal with derived variables
+	//
+	if (IsVariableDerived(_ovr_varname)) {
+		const float *ptr;
+		if (_ovr_varname.compare("angleRAD") == 0) {
+			ptr = _angleRADBuf;
+		}
+		else {
+			ptr = _latDEGBuf;
+		}
+		for (size_t y=0; y<ny; y++) {
+		for (size_t x=0; x<nx; x++) {
+			region[y*nx + x] = ptr[(min[1]+y)*_dims[0] + min[0]+x];
+		}
+		}
+		return(0);
+	}
+
+	vector <size_t> dims = _GetSpatialDims(_ncdfc, _ovr_varname);
+	if (dims.size() < 2) {
+		SetErrMsg("Invalid operation");
+		return(-1);
+	}
+	bool is3d = dims.size() == 3;
+	size_t nz = is3d ? max[2]-min[2]+1 : 1;
+
+	//
+	// Native grid rows and columns the resampling needs
+	//
+	size_t smin[2], smax[2];
+	_weightTable->sourceRegion(min, max, smin, smax);
+	size_t snx = smax[0]-smin[0]+1;
+	size_t sny = smax[1]-smin[1]+1;
+
+	// If data is reversed the region's levels are read in reversed
+	// order. ELEVATION is already fed in reverse order w.r.t CAM.
+	//
+	bool reversed = (_dataReversed==1) && 
+		(_ovr_varname.compare("ELEVATION")!=0);
+
+	size_t start[] = {0, smin[1], smin[0]};
+	size_t count[] = {nz, sny, snx};
+	if (is3d) start[0] = reversed ? _dims[2]-max[2]-1 : min[2];
+
+	float *buf = new float[nz*sny*snx];
+	int rc = _ncdfc->Read(
+		is3d ? start : start+1, is3d ? count : count+1, buf, _ovr_fd
+	);
+	if (rc<0) {
+		delete [] buf;
+		return(rc);
+	}
+
+	float srcMV, dstMV;
+	bool has_missing = DCReaderROMS::GetMissingValue(_ovr_varname, srcMV);
+
+	//
+	// If there are no missing values  resampling may introduce them.
+	//
+	if (! has_missing) srcMV = _defaultMV;
+
+	if (_ovr_varname.compare("ELEVATION") == 0) {
+		vector <double> extents = DCReaderROMS::GetExtents(0);
+		dstMV = (float) extents[5];
+	}
+	else {
+		dstMV = srcMV;
+	}
+
+	for (size_t z=0; z<nz; z++) {
+		size_t level = reversed ? nz-z-1 : z;
+		_weightTable->interp2D(
+			buf + level*sny*snx, smin, smax, region + z*ny*nx, min, max, 
+			srcMV, dstMV
+		);
+	}
+	delete [] buf;
+
+	return(0);
+}
+
 int DCReaderROMS::CloseVariable() {
 	if (_ovr_fd < 0) return(0);
 
@@ -27,7 +27,7 @@ bool mycompare(const pair<int, float>  &a, const pair<int, float>  &b) {
 }
 };
 
-DCReaderWRF::DCReaderWRF(const vector <string> &files) {
+DCReaderWRF::DCReaderWRF(const vector <string> &files, bool lazyInit) {
 
 	_dims.clear();
 	_vars3d.clear();
@@ -51,6 +51,8 @@ DCReaderWRF::DCReaderWRF(const vector <string> &files) {
 
 	NetCDFCollection *ncdfc = new NetCDFCollection();
 
+	ncdfc->SetLazyInitialize(lazyInit);
+
 	int rc = ncdfc->Initialize(files, time_dimnames, time_coordvars);
 	if (rc<0) {
 		SetErrMsg("Failed to initialize netCDF data collection for reading");
@@ -854,6 +856,7 @@ int DCReaderWRF::OpenVariableRead(
 	ts = _timeLookup[ts];
 
 	_ovr_fd = _ncdfc->OpenRead(ts, varname);
+	if (_ovr_fd >= 0) _ovr_varname = varname;
 	return(_ovr_fd);
 }
 
@@ -872,10 +875,30 @@ int DCReaderWRF::Read(float *data) {
 	return(rc);
 }
 
+int DCReaderWRF::ReadRegion(
+	const size_t min[3], const size_t max[3], float *region
+) {
+	if (_ovr_fd < 0) {
+		SetErrMsg("No variable open");
+		return(-1);
+	}
+
+	//
+	// NetCDF dimension ordering, and no level dimension for 2D variables
+	//
+	size_t start[] = {min[2], min[1], min[0]};
+	size_t count[] = {max[2]-min[2]+1, max[1]-min[1]+1, max[0]-min[0]+1};
+	int offset = 0;
+	if (_ncdfc->GetSpatialDims(_ovr_varname).size() == 2) offset = 1;
+
+	return(_ncdfc->Read(start+offset, count+offset, region, _ovr_fd));
+}
+
 int DCReaderWRF::CloseVariable() {
 	if (_ovr_fd < 0) return (0);
 	int rc = _ncdfc->Close(_ovr_fd);
 	_ovr_fd = -1;
+	_ovr_varname.clear();
 	return(rc);
 }
 
@@ -979,8 +1002,17 @@ DCReaderWRF::DerivedVarElevation::DerivedVarElevation(
 		return;
 	}
 
-	_PH = new float[_dims[1] * _dims[2]];
-	_PHB = new float[_dims[1] * _dims[2]];
+	//
+	// PH and PHB are staggered along Z. The slice buffers hold native
+	// slices.
+	//
+	for (int i=0; i<3; i++) {
+		_stag[i] = _ncdfc->IsStaggeredDim(_dimnames[i]);
+	}
+	size_t nx = _stag[2] ? _dims[2]+1 : _dims[2];
+	size_t ny = _stag[1] ? _dims[1]+1 : _dims[1];
+	_PH = new float[nx * ny];
+	_PHB = new float[nx * ny];
 	_ok = true;
 }
 
@@ -1010,6 +1042,18 @@ int DCReaderWRF::DerivedVarElevation::Open(size_t ts) {
 	_PHfd = PHfd;
 	_PHBfd = PHBfd;
 
+	//
+	// ELEVATION = (PH + PHB) / g, unstaggered and combined in one pass
+	//
+	size_t nx = _stag[2] ? _dims[2]+1 : _dims[2];
+	size_t ny = _stag[1] ? _dims[1]+1 : _dims[1];
+	int rc = _kernel.Init(nx, ny, _stag[2], _stag[1], _stag[0], 2, _grav);
+	if (rc<0) {
+		_ncdfc->Close(PHfd);
+		_ncdfc->Close(PHBfd);
+		return(-1);
+	}
+
 	_is_open = true;
 	return(0);
 }
@@ -1024,37 +1068,69 @@ int DCReaderWRF::DerivedVarElevation::Read(float *buf, int) {
 
 	int rc;
 	float *ptr = buf;
-	while ((rc = DCReaderWRF::DerivedVarElevation::ReadSlice(buf, 0))>0) {
+	while ((rc = DCReaderWRF::DerivedVarElevation::ReadSlice(ptr, 0))>0) {
 		ptr += nx*ny;
 	}
 	return(rc);
-		
-	return(0);
 }
 
 int DCReaderWRF::DerivedVarElevation::ReadSlice(
 	float *slice, int
 ) {
-	size_t nx = _dims[2];
-	size_t ny = _dims[1];
+	const float *slices[] = {_PH, _PHB};
 
 	int rc;
-	rc = _ncdfc->ReadSlice(_PH, _PHfd);
-	if (rc<=0) return(rc);
+	do {
+		rc = _ncdfc->ReadSliceNative(_PH, _PHfd);
+		if (rc<=0) return(rc);
 
-	rc = _ncdfc->ReadSlice(_PHB, _PHBfd);
-	if (rc<=0) return(rc);
-	
-	for (size_t y=0; y<ny; y++) {
-	for (size_t x=0; x<nx; x++) {
-		slice[y*nx + x] = (_PH[y*nx + x] + _PHB[y*nx + x]) / _grav;
-	}
-	}
+		rc = _ncdfc->ReadSliceNative(_PHB, _PHBfd);
+		if (rc<=0) return(rc);
+
+		rc = _kernel.Apply(slices, slice);
+		if (rc<0) return(rc);
+	} while (rc == 0);
 
 	return(1);
 }
 
 
+int DCReaderWRF::DerivedVarElevation::ReadRegion(
+	size_t start[], size_t count[], float *region, int
+) {
+
+	//
+	// Read the native hyperslabs, extended by one sample along each
+	// staggered dimension
+	//
+	size_t nstart[3], ncount[3];
+	for (int i=0; i<3; i++) {
+		nstart[i] = start[i];
+		ncount[i] = _stag[i] ? count[i] + 1 : count[i];
+	}
+	size_t n = ncount[0] * ncount[1] * ncount[2];
+	if (_PHregion.size() < n) {
+		_PHregion.resize(n);
+		_PHBregion.resize(n);
+	}
+
+	int rc = _ncdfc->ReadNative(nstart, ncount, &_PHregion[0], _PHfd);
+	if (rc<0) return(rc);
+
+	rc = _ncdfc->ReadNative(nstart, ncount, &_PHBregion[0], _PHBfd);
+	if (rc<0) return(rc);
+
+	rc = _regionKernel.Init(
+		ncount[2], ncount[1], _stag[2], _stag[1], _stag[0], 2, _grav
+	);
+	if (rc<0) return(rc);
+
+	const float *volumes[] = {&_PHregion[0], &_PHBregion[0]};
+	(void) _regionKernel.ApplyVolume(volumes, ncount[0], region);
+
+	return(0);
+}
+
 int DCReaderWRF::DerivedVarElevation::SeekSlice(
     int offset, int whence, int
 ) {
@@ -1062,6 +1138,7 @@ int DCReaderWRF::DerivedVarElevation::SeekSlice(
 	int rc = 0;
 	if (_ncdfc->SeekSlice(offset, whence, _PHfd)<0) rc = -1;
 	if (_ncdfc->SeekSlice(offset, whence, _PHBfd)<0) rc = -1;
+	_kernel.Reset();
 
 	return(rc);
 }
@@ -5,15 +5,47 @@
 #include <cfloat>
 #include <vector>
 #include <map>
+#include <sstream>
 #include <vapor/DataMgr.h>
+#include <vapor/CFuncs.h>
 #include <vapor/common.h>
 #include <vapor/errorcodes.h>
 #ifdef WIN32
 #include <float.h>
+#include <windows.h>
+#else
+#include <pthread.h>
 #endif
 using namespace VetsUtil;
 using namespace VAPoR;
 
+namespace {
+
+	// Largest block size used for summaries computed from grids
+	//
+	const size_t summaryBlockSize = 32;
+
+	void fix_range(float range[2]) {
+		for (int i=0; i<2; i++) {
+#ifdef WIN32
+			if (! _finite(range[i]) || _isnan(range[i])) range[i] = FLT_MIN;
+#else
+			if (! finite(range[i]) || isnan(range[i])) range[i] = FLT_MIN;
+#endif
+		}
+	}
+
+	//
+	// Holds the lock of a DataMgr for the life of a scope
+	//
+	class DataMgrLock {
+	public:
+		DataMgrLock(const DataMgr *dm) : _dm(dm) { _dm->Lock(); }
+		~DataMgrLock() { _dm->Unlock(); }
+	private:
+		const DataMgr *_dm;
+	};
+};
 
 int	DataMgr::_DataMgr(
 	size_t mem_size
@@ -30,6 +62,18 @@ int	DataMgr::_DataMgr(
 
 	_extentsCache.clear();
 
+	_summaryCache.clear();
+	_summaryDir.clear();
+	_sourceFingerprint = 0;
+
+	_pyramidTransforms = 0;
+	_pyramidDir.clear();
+	_pyramidList.clear();
+
+	_nativeTS = 0;
+	_nativeVarname.clear();
+	_nativeReflevel = -1;
+
 	return(0);
 }
 
@@ -39,6 +83,20 @@ DataMgr::DataMgr(
 
 	SetDiagMsg("DataMgr::DataMgr(,%d)", mem_size);
 
+#ifdef WIN32
+	CRITICAL_SECTION *cs = new CRITICAL_SECTION;
+	InitializeCriticalSection(cs);
+	_mutex = cs;
+#else
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_t *mutex = new pthread_mutex_t;
+	pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	_mutex = mutex;
+#endif
+
 	if (_DataMgr(mem_size) < 0) return;
 }
 
@@ -52,6 +110,29 @@ DataMgr::~DataMgr(
 
 	_blk_mem_mgr = NULL;
 
+#ifdef WIN32
+	DeleteCriticalSection((CRITICAL_SECTION *) _mutex);
+	delete (CRITICAL_SECTION *) _mutex;
+#else
+	pthread_mutex_destroy((pthread_mutex_t *) _mutex);
+	delete (pthread_mutex_t *) _mutex;
+#endif
+}
+
+void DataMgr::Lock() const {
+#ifdef WIN32
+	EnterCriticalSection((CRITICAL_SECTION *) _mutex);
+#else
+	pthread_mutex_lock((pthread_mutex_t *) _mutex);
+#endif
+}
+
+void DataMgr::Unlock() const {
+#ifdef WIN32
+	LeaveCriticalSection((CRITICAL_SECTION *) _mutex);
+#else
+	pthread_mutex_unlock((pthread_mutex_t *) _mutex);
+#endif
 }
 
 RegularGrid *DataMgr::make_grid(
@@ -242,6 +323,7 @@ RegularGrid *DataMgr::GetGrid(
 	const size_t max[3],
 	bool	lock
 ) {
+	DataMgrLock guard(this);
 
 	RegularGrid *rg = NULL;
 	bool ondisk = false;
@@ -393,6 +475,7 @@ RegularGrid *DataMgr::GetGrid(
 }
 
 int	DataMgr::NewPipeline(PipeLine *pipeline) {
+	DataMgrLock guard(this);
 
 	//
 	// Delete any pipeline stage with the same name as the new one. This
@@ -475,6 +558,7 @@ int	DataMgr::NewPipeline(PipeLine *pipeline) {
 }
 
 void	DataMgr::RemovePipeline(string name) {
+	DataMgrLock guard(this);
 
 	vector <PipeLine *>::iterator itr;
 	for (itr = _PipeLines.begin(); itr != _PipeLines.end(); itr++) {
@@ -497,6 +581,7 @@ void	DataMgr::RemovePipeline(string name) {
 int DataMgr::VariableExists(
     size_t ts, const char *varname, int reflevel, int lod
 ) {
+	DataMgrLock guard(this);
 	if (reflevel < 0) reflevel = DataMgr::GetNumTransforms();
 	if (lod < 0) lod = DataMgr::GetCRatios().size()-1;
 
@@ -549,6 +634,7 @@ bool DataMgr::BestMatch(
     size_t ts, const char *varname, int req_reflevel, int req_lod,
 	int &reflevel, int &lod
 ) {
+	DataMgrLock guard(this);
 	if (req_reflevel < 0) reflevel = DataMgr::GetNumTransforms();
 	if (req_lod < 0) lod = DataMgr::GetCRatios().size()-1;
 
@@ -676,6 +762,7 @@ int DataMgr::GetDataRange(
 	int reflevel,
 	int lod
 ) {
+	DataMgrLock guard(this);
 	if (reflevel < 0) reflevel = DataMgr::GetNumTransforms();
 	if (lod < 0) lod = DataMgr::GetCRatios().size()-1;
 
@@ -691,6 +778,19 @@ int DataMgr::GetDataRange(
 		return(0);
 	}
 
+	// A block summary already in memory is cheaper than opening the
+	// variable
+	//
+	const BlockSummary *summary = get_summary(
+		ts, varname, reflevel, lod, false, false
+	);
+	if (summary) {
+		summary->GetRange(range);
+		fix_range(range);
+		_VarInfoCache.SetRange(ts, varname, reflevel, lod, range);
+		return(0);
+	}
+
 	// Range isn't cache'd. Need to get it from derived class
 	//
 	if (DataMgr::IsVariableNative(varname)) {
@@ -708,17 +808,7 @@ int DataMgr::GetDataRange(
 		if (r) {
 			range[0] = r[0];
 			range[1] = r[1];
-
-#ifdef WIN32
-			if (! _finite(range[0]) || _isnan(range[0])) range[0] = FLT_MIN;
-#else
-			if (! finite(range[0]) || isnan(range[0])) range[0] = FLT_MIN;
-#endif
-#ifdef WIN32
-			if (! _finite(range[1]) || _isnan(range[1])) range[1] = FLT_MIN;
-#else
-			if (! finite(range[1]) || isnan(range[1])) range[1] = FLT_MIN;
-#endif
+			fix_range(range);
 
 			_VarInfoCache.SetRange(ts, varname, reflevel, lod, range);
 
@@ -730,37 +820,15 @@ int DataMgr::GetDataRange(
 
 	//
 	// Argh. Child class doesn't know data range (or this is a
-	// derived variable). Have to caculate range
-	// ourselves
+	// derived variable). Try a saved summary, or caculate range
+	// ourselves. Summarize the variable while we're at it so
+	// that subsequent queries don't have to read it again.
 	//
-	size_t min[3], max[3];
-	rc = DataMgr::GetValidRegion(ts, varname, reflevel, min, max);
-	if (rc<0) return(-1);
-
-	
-	const RegularGrid *rg = DataMgr::GetGrid(
-		ts, varname, reflevel, lod, min, max, 1
-	);
-	if (! rg) return(-1);
-
-
-	RegularGrid::ConstIterator itr;
-	bool first = true;
-	float mv = rg->GetMissingValue();
-	for (itr = rg->begin(); itr!=rg->end(); ++itr) {
-		float v = *itr;
-		if (v != mv) {
-			if (first) {
-				range[0] = range[1] = v;
-				first = false;
-			}
-			if (v < range[0]) range[0] = v;
-			if (v > range[1]) range[1] = v;
-		}
-	}
-	DataMgr::UnlockGrid(rg);
-	delete rg;
+	summary = get_summary(ts, varname, reflevel, lod, true, true);
+	if (! summary) return(-1);
 
+	summary->GetRange(range);
+	fix_range(range);
 	_VarInfoCache.SetRange(ts, varname, reflevel, lod, range);
 
 	return(0);
@@ -773,6 +841,7 @@ int DataMgr::GetValidRegion(
 	size_t min[3],
 	size_t max[3]
 ) {
+	DataMgrLock guard(this);
 	if (reflevel < 0) reflevel = DataMgr::GetNumTransforms();
 
 	int	rc;
@@ -886,6 +955,7 @@ SetDiagMsg(
 void	DataMgr::UnlockGrid(
 	const RegularGrid *rg
 ) {
+	DataMgrLock guard(this);
 	SetDiagMsg("DataMgr::UnlockGrid()");
 	float **blks = rg->GetBlks();
 	if (blks) unlock_blocks(blks[0]);
@@ -953,21 +1023,22 @@ float *DataMgr::get_region_from_fs(
 	map_vox_to_blk(min, bmin, reflevel);
 	map_vox_to_blk(max, bmax, reflevel);
 
+	//
+	// The region is locked while it is read, as reading may make room
+	// in the cache (e.g. for a pyramid)
+	//
 	float *blks = alloc_region(
 		ts,varname.c_str(),vtype, reflevel, lod, 
-		min,max,lock,false
+		min,max,true,false
 	);
 	if (! blks) return(NULL);
 
     int rc = _OpenVariableRead(
 		ts, varname.c_str(), reflevel, lod
 	);
-    if (rc < 0) {
-		free_region(ts,varname.c_str(),reflevel,lod,min,max);
-		return(NULL);
-	}
+	if (rc >= 0) rc = _BlockReadRegion(bmin, bmax, blks);
 
-	rc = _BlockReadRegion(bmin, bmax, blks);
+	if (! lock || rc < 0) unlock_blocks(blks);
     if (rc < 0) {
 		free_region(ts,varname.c_str(),reflevel,lod,min,max);
 		return(NULL);
@@ -1141,6 +1212,7 @@ void	DataMgr::free_region(
 }
 
 void	DataMgr::Clear() {
+	DataMgrLock guard(this);
 
 	list <region_t>::iterator itr;
 	for(itr = _regionsList.begin(); itr!=_regionsList.end(); itr++) {
@@ -1151,6 +1223,18 @@ void	DataMgr::Clear() {
 	}
 	_regionsList.clear();
 	_VarInfoCache.Clear();
+
+	map <string, BlockSummary *>::iterator itr1;
+	for (itr1 = _summaryCache.begin(); itr1 != _summaryCache.end(); ++itr1) {
+		delete itr1->second;
+	}
+	_summaryCache.clear();
+
+	list <pyramid_t>::iterator itr2;
+	for (itr2 = _pyramidList.begin(); itr2 != _pyramidList.end(); ++itr2) {
+		free_pyramid(*itr2);
+	}
+	_pyramidList.clear();
 }
 
 void	DataMgr::free_var(const string &varname, int do_native) {
@@ -1172,6 +1256,7 @@ void	DataMgr::free_var(const string &varname, int do_native) {
 }
 
 void DataMgr::PrintCache(std::ostream &o) {
+	DataMgrLock guard(this);
 
 	// The least recently used region is at the front of the list
 	//
@@ -1210,6 +1295,14 @@ int	DataMgr::free_lru(
 		}
 	}
 
+	// then the least recently used pyramid
+	//
+	if (! _pyramidList.empty()) {
+		free_pyramid(_pyramidList.front());
+		_pyramidList.pop_front();
+		return(0);
+	}
+
 	// nothing to free
 	return(-1);
 }
@@ -1554,8 +1647,170 @@ bool DataMgr::GetMissingValue(string varname, float &mv) const {
 
  
 void DataMgr::PurgeVariable(string varname){
+	DataMgrLock guard(this);
 	free_var(varname,1);
 	_VarInfoCache.PurgeVariable(varname);
+	purge_summaries(varname);
+	purge_pyramids(varname);
+}
+
+void DataMgr::SetPyramid(int ntransforms, const string &dir) {
+	DataMgrLock guard(this);
+
+	SetDiagMsg("DataMgr::SetPyramid(%d,%s)", ntransforms, dir.c_str());
+
+	//
+	// Refinement levels change meaning, so nothing cached stays valid
+	//
+	Clear();
+	_pyramidTransforms = ntransforms > 0 ? ntransforms : 0;
+	_pyramidDir = dir;
+}
+
+const BlockSummary *DataMgr::GetBlockSummary(
+	size_t ts, const char *varname, int reflevel, int lod, bool compute
+) {
+	DataMgrLock guard(this);
+	if (reflevel < 0) reflevel = DataMgr::GetNumTransforms();
+	if (lod < 0) lod = DataMgr::GetCRatios().size()-1;
+
+	SetDiagMsg(
+		"DataMgr::GetBlockSummary(%d,%s,%d,%d)", ts, varname, reflevel, lod
+	);
+
+	return(get_summary(ts, varname, reflevel, lod, true, compute));
+}
+
+string DataMgr::_GetSummaryPath(
+	size_t ts, const string &varname, int reflevel, int lod
+) const {
+	if (_summaryDir.empty()) return("");
+
+	ostringstream oss;
+	oss << _summaryDir << "/" << varname << "." << ts << "." << 
+		reflevel << "." << lod << ".bsum";
+	return(oss.str());
+}
+
+BlockSummary *DataMgr::get_summary(
+	size_t ts, string varname, int reflevel, int lod, bool read, bool compute
+) {
+	ostringstream oss;
+	oss << ts << ":" << varname << ":" << reflevel << ":" << lod;
+	string key = oss.str();
+
+	map <string, BlockSummary *>::iterator itr = _summaryCache.find(key);
+	if (itr != _summaryCache.end()) return(itr->second);
+	if (! read) return(NULL);
+
+	//
+	// Only native variables have summary files. Derived variables
+	// may change with their pipeline.
+	//
+	string path;
+	unsigned long long fingerprint = 0;
+	if (DataMgr::IsVariableNative(varname)) {
+		path = _GetSummaryPath(ts, varname, reflevel, lod);
+		if (! path.empty()) fingerprint = _GetSourceFingerprint(ts, varname);
+	}
+
+	//
+	// Summaries record the volume dimensions, packed for 2D variables
+	//
+	size_t dim[3], pdim[3];
+	DataMgr::GetDim(dim, reflevel);
+	VarType_T vtype = DataMgr::GetVarType(varname);
+	switch (vtype) {
+	case VAR2D_XY:
+		pdim[0] = dim[0]; pdim[1] = dim[1]; pdim[2] = 1;
+		break;
+	case VAR2D_XZ:
+		pdim[0] = dim[0]; pdim[1] = dim[2]; pdim[2] = 1;
+		break;
+	case VAR2D_YZ:
+		pdim[0] = dim[1]; pdim[1] = dim[2]; pdim[2] = 1;
+		break;
+	default:
+		pdim[0] = dim[0]; pdim[1] = dim[1]; pdim[2] = dim[2];
+		break;
+	}
+
+	if (! path.empty()) {
+		BlockSummary *summary = new BlockSummary();
+
+		// A missing or unreadable summary file is not an error
+		//
+		bool enable = EnableErrMsg(false);
+		int rc = summary->Read(path);
+		EnableErrMsg(enable);
+		SetErrCode(0);
+
+		//
+		// Reject summaries of other volumes (e.g. written for a
+		// different refinement level) or of data that has since changed
+		//
+		size_t sdim[3];
+		summary->GetDims(sdim);
+		bool ok = rc == 0 && summary->GetFingerprint() == fingerprint;
+		for (int i=0; i<3; i++) {
+			if (sdim[i] != pdim[i]) ok = false;
+		}
+		if (ok) {
+			_summaryCache[key] = summary;
+			return(summary);
+		}
+		delete summary;
+	}
+
+	if (! compute) return(NULL);
+
+	size_t min[3], max[3];
+	int rc = DataMgr::GetValidRegion(ts, varname.c_str(), reflevel, min, max);
+	if (rc<0) return(NULL);
+
+	const RegularGrid *rg = DataMgr::GetGrid(
+		ts, varname, reflevel, lod, min, max, 1
+	);
+	if (! rg) return(NULL);
+
+	size_t bs[3];
+	rg->GetBlockSize(bs);
+	for (int i=0; i<3; i++) {
+		if (bs[i] > summaryBlockSize) bs[i] = summaryBlockSize;
+	}
+
+	BlockSummary *summary = new BlockSummary();
+	summary->Compute(rg, bs);
+	summary->SetSource(pdim, fingerprint);
+
+	DataMgr::UnlockGrid(rg);
+	delete rg;
+
+	if (! path.empty()) {
+		bool enable = EnableErrMsg(false);
+		string dir;
+		DirName(path, dir);
+		(void) MkDirHier(dir);
+		(void) summary->Write(path);
+		EnableErrMsg(enable);
+		SetErrCode(0);
+	}
+
+	_summaryCache[key] = summary;
+	return(summary);
+}
+
+void DataMgr::purge_summaries(const string &varname) {
+	map <string, BlockSummary *>::iterator itr;
+	for (itr = _summaryCache.begin(); itr != _summaryCache.end(); ) {
+		size_t p0 = itr->first.find(':');
+		size_t p1 = itr->first.rfind(':', itr->first.rfind(':') - 1);
+		if (itr->first.substr(p0+1, p1-p0-1) == varname) {
+			delete itr->second;
+			_summaryCache.erase(itr++);
+		}
+		else ++itr;
+	}
 }
 
 
@@ -1570,6 +1825,225 @@ void    DataMgr::map_vox_to_blk(
     }
 }
 
+void DataMgr::_GetNativeBlockSize(const size_t dim[3], size_t bs[3]) {
+	for (int i=0; i<3; i++) {
+		bs[i] = dim[i] < NATIVE_BLOCK_SIZE ? dim[i] : NATIVE_BLOCK_SIZE;
+		if (bs[i] < 1) bs[i] = 1;
+	}
+}
+
+void DataMgr::_CopyToBlocks(
+	const float *region, const size_t dim[3], const size_t bs[3], 
+	float *blks
+) {
+	size_t nb[3];
+	for (int i=0; i<3; i++) nb[i] = (dim[i] + bs[i] - 1) / bs[i];
+
+	float *dst = blks;
+	for (size_t bz=0; bz<nb[2]; bz++) {
+	for (size_t by=0; by<nb[1]; by++) {
+	for (size_t bx=0; bx<nb[0]; bx++) {
+
+		size_t x0 = bx*bs[0];
+		size_t nx = x0 + bs[0] <= dim[0] ? bs[0] : dim[0] - x0;
+
+		for (size_t z=bz*bs[2]; z<(bz+1)*bs[2]; z++) {
+		for (size_t y=by*bs[1]; y<(by+1)*bs[1]; y++) {
+
+			// Rows and layers past the region repeat its last one
+			//
+			size_t zz = z < dim[2] ? z : dim[2]-1;
+			size_t yy = y < dim[1] ? y : dim[1]-1;
+			const float *src = region + (zz*dim[1] + yy)*dim[0] + x0;
+
+			memcpy(dst, src, nx * sizeof(*dst));
+			for (size_t x=nx; x<bs[0]; x++) dst[x] = src[nx-1];
+			dst += bs[0];
+		}
+		}
+	}
+	}
+	}
+}
+
+void DataMgr::_SetNativeVariable(
+	size_t ts, const string &varname, int reflevel
+) {
+	_nativeTS = ts;
+	_nativeVarname = varname;
+	_nativeReflevel = reflevel;
+}
+
+int DataMgr::_BlockReadNativeRegion(
+	const size_t bmin[3], const size_t bmax[3], float *blks
+) {
+	bool is2D = GetVarType(_nativeVarname) == VAR2D_XY;
+
+	size_t bs[3];
+	_GetBlockSize(bs, _nativeReflevel);
+
+	size_t dim[3];
+	_GetDim(dim, -1);
+	if (is2D) bs[2] = dim[2] = 1;
+
+	bool native = _nativeReflevel < 0 || 
+		_nativeReflevel >= _pyramidTransforms;
+
+	MultiResPyramid *pyramid = NULL;
+	if (! native) {
+		pyramid = get_pyramid(_nativeTS, _nativeVarname);
+		if (! pyramid) return(-1);
+
+		size_t ldim[3];
+		_GetPyramidDim(dim, _nativeReflevel, ldim);
+		for (int i=0; i<3; i++) dim[i] = ldim[i];
+	}
+
+	size_t min[3], max[3], rdim[3];
+	for (int i=0; i<3; i++) {
+		min[i] = bmin[i] * bs[i];
+		max[i] = (bmax[i]+1) * bs[i] - 1;
+		if (max[i] >= dim[i]) max[i] = dim[i] - 1;
+		rdim[i] = max[i]-min[i]+1;
+	}
+
+	//
+	// A region that is a single, whole block is already blocked
+	//
+	bool blocked = rdim[0] == bs[0] && rdim[1] == bs[1] && rdim[2] == bs[2];
+	float *region = blocked ? blks : new float[rdim[0]*rdim[1]*rdim[2]];
+
+	int rc;
+	if (native) rc = _ReadNativeRegion(min, max, region);
+	else rc = pyramid->GetRegion(_nativeReflevel, min, max, region);
+
+	if (! blocked) {
+		if (rc >= 0) _CopyToBlocks(region, rdim, bs, blks);
+		delete [] region;
+	}
+	return(rc);
+}
+
+//
+// Return the pyramid of a variable, from memory, from its file, or built
+// from the native data of the opened variable. The pyramid is kept in
+// blocks of the cache, evicting least recently used regions and 
+// pyramids as needed.
+//
+MultiResPyramid *DataMgr::get_pyramid(size_t ts, const string &varname) {
+
+	ostringstream oss;
+	oss << ts << ":" << varname;
+	string key = oss.str();
+
+	list <pyramid_t>::iterator itr;
+	for (itr = _pyramidList.begin(); itr != _pyramidList.end(); ++itr) {
+		if (itr->key == key) {
+			_pyramidList.splice(_pyramidList.end(), _pyramidList, itr);
+			return(itr->pyramid);
+		}
+	}
+
+	size_t dim[3];
+	_GetDim(dim, -1);
+	if (GetVarType(varname) == VAR2D_XY) dim[2] = 1;
+
+	float mv = 0.0;
+	bool has_missing = _GetMissingValue(varname, mv);
+
+	size_t nbytes = MultiResPyramid::GetNumBytes(dim, _pyramidTransforms);
+	size_t mem_block_size = BlkMemMgr::GetBlkSize();
+	size_t nblocks = (nbytes + mem_block_size - 1) / mem_block_size;
+
+	float *blks;
+	while (! (blks = (float *) _blk_mem_mgr->Alloc(nblocks, false))) {
+		if (free_lru() < 0) {
+			SetErrMsg("Failed to allocate requested memory");
+			return(NULL);
+		}
+	}
+
+	MultiResPyramid *pyramid = new MultiResPyramid();
+	if (pyramid->Init(dim, _pyramidTransforms, has_missing, mv, blks) < 0) {
+		delete pyramid;
+		_blk_mem_mgr->FreeMem(blks);
+		return(NULL);
+	}
+
+	string path;
+	if (! _pyramidDir.empty()) {
+		ostringstream pss;
+		pss << _pyramidDir << "/" << varname << "." << ts << ".pyr";
+		path = pss.str();
+		pyramid->SetFingerprint(_GetSourceFingerprint(ts, varname));
+	}
+
+	//
+	// A missing or stale file is not an error: the pyramid is rebuilt
+	//
+	bool enable = EnableErrMsg(false);
+	bool have = ! path.empty() && pyramid->Read(path) >= 0;
+	EnableErrMsg(enable);
+	SetErrCode(0);
+
+	if (! have) {
+		size_t depth = pyramid->GetSlabDepth();
+		float *slab = new float[dim[0]*dim[1]*depth];
+
+		int rc = 0;
+		for (size_t z0=0; z0<dim[2] && rc>=0; z0+=depth) {
+			size_t nz = z0 + depth <= dim[2] ? depth : dim[2] - z0;
+			size_t min[] = {0, 0, z0};
+			size_t max[] = {dim[0]-1, dim[1]-1, z0+nz-1};
+
+			rc = _ReadNativeRegion(min, max, slab);
+			if (rc >= 0) rc = pyramid->AddSlab(slab, nz);
+		}
+		delete [] slab;
+
+		if (rc < 0) {
+			delete pyramid;
+			_blk_mem_mgr->FreeMem(blks);
+			return(NULL);
+		}
+		if (! path.empty()) {
+			enable = EnableErrMsg(false);
+			string dir;
+			DirName(path, dir);
+			(void) MkDirHier(dir);
+			(void) pyramid->Write(path);
+			EnableErrMsg(enable);
+			SetErrCode(0);
+		}
+	}
+
+	pyramid_t entry;
+	entry.key = key;
+	entry.pyramid = pyramid;
+	entry.blks = blks;
+	_pyramidList.push_back(entry);
+	return(pyramid);
+}
+
+void DataMgr::free_pyramid(pyramid_t &pyramid) {
+	delete pyramid.pyramid;
+	if (pyramid.blks) _blk_mem_mgr->FreeMem(pyramid.blks);
+	pyramid.pyramid = NULL;
+	pyramid.blks = NULL;
+}
+
+void DataMgr::purge_pyramids(const string &varname) {
+	list <pyramid_t>::iterator itr;
+	for (itr = _pyramidList.begin(); itr != _pyramidList.end(); ) {
+		const string &key = itr->key;
+		if (key.substr(key.find(':')+1) == varname) {
+			free_pyramid(*itr);
+			itr = _pyramidList.erase(itr);
+		}
+		else ++itr;
+	}
+}
+
 void    DataMgr::get_dim_blk(
 	size_t bdim[3], int reflevel
 ) const {
@@ -1646,6 +2120,7 @@ void   DataMgr::MapUserToVox(
     size_t timestep,
     const double xyz[3], size_t ijk[3], int reflevel, int lod
 ) {
+	DataMgrLock guard(this);
 
 	SetDiagMsg(
 		"DataMgr::MapUserToVox(%d, (%f, %f, %f), (,,) %d)",
@@ -1676,6 +2151,7 @@ void   DataMgr::MapVoxToUser(
     size_t timestep,
     const size_t ijk[3], double xyz[3], int reflevel, int lod
 ) {
+	DataMgrLock guard(this);
 	SetDiagMsg(
 		"DataMgr::MapVoxToUser(%d, (%d, %d, %d), (,,) %d)",
 		timestep, ijk[0], ijk[1], ijk[2], reflevel
@@ -1708,6 +2184,7 @@ void    DataMgr::GetEnclosingRegion(
     size_t min[3], size_t max[3],
     int reflevel, int lod
 ) {
+	DataMgrLock guard(this);
     size_t dims[3];
     DataMgr::GetDim(dims, reflevel);
 
@@ -1917,6 +2394,7 @@ bool DataMgr::IsCoordinateVariable(string varname) const {
 }
 
 vector<double> DataMgr::GetExtents(size_t ts) {
+	DataMgrLock guard(this);
 
 	// Check cache first
 	//
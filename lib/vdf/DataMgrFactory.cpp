@@ -1,7 +1,10 @@
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
 #include <cassert>
 #include <vector>
+#include <sstream>
+#include <vapor/CFuncs.h>
 #include <vapor/DataMgrFactory.h>
 #include <vapor/DataMgrWB.h>
 #include <vapor/DataMgrWC.h>
@@ -12,6 +15,35 @@
 #include <vapor/DataMgrGRIB.h>
 
 using namespace VAPoR;
+using namespace VetsUtil;
+
+namespace {
+
+	//
+	// Directory of the block summary files of a collection of model
+	// output files: $VAPOR_SUMMARY_DIR, or a directory next to the first
+	// file, with a subdirectory per collection named after its files.
+	// An empty $VAPOR_SUMMARY_DIR disables summary files.
+	//
+	string summary_dir(const vector <string> &files) {
+		string dir;
+		const char *s = getenv("VAPOR_SUMMARY_DIR");
+		if (s) dir = s;
+		else {
+			DirName(files[0], dir);
+			dir += ".vapor_summary";
+		}
+		if (dir.empty()) return("");
+
+		unsigned long long hash = HashInit;
+		for (int i=0; i<files.size(); i++) {
+			hash = HashString(files[i], hash);
+		}
+		ostringstream oss;
+		oss << dir << "/" << hex << hash;
+		return(oss.str());
+	}
+};
 
 DataMgr *DataMgrFactory::New(
 	const vector <string> &files, size_t mem_size, string ftype
@@ -35,23 +67,32 @@ DataMgr *DataMgrFactory::New(
 			return(NULL);
 		}
 	}
-	else if (ftype.compare("wrf") == 0) {
-		return new DataMgrWRF(files, mem_size);
+
+	DataMgr *dataMgr;
+	if (ftype.compare("wrf") == 0) {
+		dataMgr = new DataMgrWRF(files, mem_size);
 	}
 	else if (ftype.compare("roms") == 0) {
-		return new DataMgrROMS(files, mem_size);
+		dataMgr = new DataMgrROMS(files, mem_size);
 	}
 	else if (ftype.compare("mom4") == 0) {
-		return new DataMgrMOM(files, mem_size);
+		dataMgr = new DataMgrMOM(files, mem_size);
 	}
 	else if (ftype.compare("grib") == 0) {
-		return new DataMgrGRIB(files, mem_size);
+		dataMgr = new DataMgrGRIB(files, mem_size);
 	}
 	else if (ftype.compare("cam") == 0) {
-		return new DataMgrROMS(files, mem_size);	// CAM uses ROMS reader
+		dataMgr = new DataMgrROMS(files, mem_size);	// CAM uses ROMS reader
 	}
 	else {
 		SetErrMsg("Unknown data set type : %s", ftype.c_str());
 		return(NULL);
 	}
+
+	//
+	// Model output doesn't know the range of its variables. Keep the
+	// summaries computed for them, so the data are only scanned once.
+	//
+	dataMgr->SetSummaryDir(summary_dir(files));
+	return(dataMgr);
 }
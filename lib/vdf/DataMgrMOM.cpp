@@ -1,5 +1,6 @@
 #include <limits>
 #include <cassert>
+#include <vapor/CFuncs.h>
 #include <vapor/DataMgrMOM.h>
 
 using namespace VetsUtil;
@@ -10,4 +11,9 @@ DataMgrMOM::DataMgrMOM(
     size_t mem_size
 ) : DataMgr(mem_size), DCReaderMOM(files) 
 {
+	//
+	// Summary files, if the application asks for them with
+	// SetSummaryDir(), are discarded when any data file changes
+	//
+	DataMgr::_SetSourceFingerprint(FileFingerprint(files));
 }
@@ -1,5 +1,6 @@
 #include <limits>
 #include <cassert>
+#include <vapor/CFuncs.h>
 #include <vapor/DataMgrWRF.h>
 #include <vapor/common.h>
 
@@ -11,4 +12,9 @@ DataMgrWRF::DataMgrWRF(
     size_t mem_size
 ) : DataMgr(mem_size), DCReaderWRF(files) 
 {
+	//
+	// Summary files, if the application asks for them with
+	// SetSummaryDir(), are discarded when any data file changes
+	//
+	DataMgr::_SetSourceFingerprint(FileFingerprint(files));
 }
@@ -3,10 +3,56 @@
 #include <cmath>
 #include <cfloat>
 #include "vapor/LayeredGrid.h"
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 using namespace std;
 using namespace VAPoR;
 
+namespace {
+
+//
+// Serializes construction of the point location tables. Lookups only
+// take the lock when they find a grid's tables missing.
+//
+#ifdef WIN32
+class ColumnsLock {
+public:
+	ColumnsLock() { InitializeCriticalSection(&_cs); }
+	~ColumnsLock() { DeleteCriticalSection(&_cs); }
+	void Lock() { EnterCriticalSection(&_cs); }
+	void Unlock() { LeaveCriticalSection(&_cs); }
+private:
+	CRITICAL_SECTION _cs;
+};
+#else
+class ColumnsLock {
+public:
+	ColumnsLock() { pthread_mutex_init(&_mutex, NULL); }
+	~ColumnsLock() { pthread_mutex_destroy(&_mutex); }
+	void Lock() { pthread_mutex_lock(&_mutex); }
+	void Unlock() { pthread_mutex_unlock(&_mutex); }
+private:
+	pthread_mutex_t _mutex;
+};
+#endif
+ColumnsLock BuildLock;
+
+//
+// Varying index of the last cell found by _FindLevel() on this thread.
+// It is only a hint, validated before use, so the grids used by a
+// thread may share it.
+//
+#ifdef WIN32
+__declspec(thread) size_t LevelHint = 0;
+#else
+__thread size_t LevelHint = 0;
+#endif
+};
+
 LayeredGrid::LayeredGrid(
 	const size_t bs[3],
 	const size_t min[3],
@@ -38,6 +84,8 @@ LayeredGrid::LayeredGrid(
 	_GetUserExtents(_extents);
 	RegularGrid::_SetExtents(_extents);
 
+	_colTable = NULL;
+	_SetColumnDims();
 }
 
 LayeredGrid::LayeredGrid(
@@ -68,10 +116,14 @@ LayeredGrid::LayeredGrid(
 
 	_GetUserExtents(_extents);
 	RegularGrid::_SetExtents(_extents);
+
+	_colTable = NULL;
+	_SetColumnDims();
 }
 
 LayeredGrid::~LayeredGrid() {
     if (_coords) delete [] _coords;
+	_FreeColumns();
 }
 void LayeredGrid::GetBoundingBox(
     const size_t min[3],
@@ -361,6 +413,12 @@ float LayeredGrid::GetValue(double x, double y, double z) const {
 	RegularGrid::GetUserCoordinates(i0,j0,k0, &x0, &y0, &z0);
 	RegularGrid::GetUserCoordinates(i1,j1,k1, &x1, &y1, &z1);
 
+	// Columns of varying dimension coordinates surrounding the point
+	//
+	const float *cols[4];
+	double cwgt0, cwgt1;
+	_GetColumnStencil(i0,j0,k0,x,y,z,cols,&cwgt0,&cwgt1);
+
 	//
 	// Calculate interpolation weights. We always interpolate along
 	// the varying dimension last (the kwgt)
@@ -369,8 +427,8 @@ float LayeredGrid::GetValue(double x, double y, double z) const {
 	if (_varying_dim == 0) {
 		// We have to interpolate coordinate of varying dimension
 		//
-		x0 = _interpolateVaryingCoord(i0,j0,k0,x,y,z);
-		x1 = _interpolateVaryingCoord(i1,j0,k0,x,y,z);
+		x0 = _columnCoord(cols,cwgt0,cwgt1,i0);
+		x1 = _columnCoord(cols,cwgt0,cwgt1,i1);
 
 		if (y1!=y0) iwgt = fabs((y-y0) / (y1-y0));
 		else iwgt = 0.0;
@@ -380,8 +438,8 @@ float LayeredGrid::GetValue(double x, double y, double z) const {
 		else kwgt = 0.0;
 	}
 	else if (_varying_dim == 1) {
-		y0 = _interpolateVaryingCoord(i0,j0,k0,x,y,z);
-		y1 = _interpolateVaryingCoord(i0,j1,k0,x,y,z);
+		y0 = _columnCoord(cols,cwgt0,cwgt1,j0);
+		y1 = _columnCoord(cols,cwgt0,cwgt1,j1);
 
 		if (x1!=x0) iwgt = fabs((x-x0) / (x1-x0));
 		else iwgt = 0.0;
@@ -391,8 +449,8 @@ float LayeredGrid::GetValue(double x, double y, double z) const {
 		else kwgt = 0.0;
 	}
 	else {
-		z0 = _interpolateVaryingCoord(i0,j0,k0,x,y,z);
-		z1 = _interpolateVaryingCoord(i0,j0,k1,x,y,z);
+		z0 = _columnCoord(cols,cwgt0,cwgt1,k0);
+		z1 = _columnCoord(cols,cwgt0,cwgt1,k1);
 
 		if (x1!=x0) iwgt = fabs((x-x0) / (x1-x0));
 		else iwgt = 0.0;
@@ -586,170 +644,22 @@ void LayeredGrid::GetIJKIndexFloor(
 	// First get ijk index of non-varying dimensions
 	// N.B. index returned for varying dimension is bogus
 	//
-	size_t i0, j0, k0;
-	RegularGrid::GetIJKIndexFloor(x,y,z, &i0,&j0,&k0);
-
-	size_t dims[3];
-	GetDimensions(dims);
-
-	size_t i1, j1, k1;
-	if (i0 == dims[0]-1) i1 = i0;
-	else i1 = i0+1;
-	if (j0 == dims[1]-1) j1 = j0;
-	else j1 = j0+1;
-	if (k0 == dims[2]-1) k1 = k0;
-	else k1 = k0+1;
-
+	size_t ijk[3];
+	RegularGrid::GetIJKIndexFloor(x,y,z, &ijk[0],&ijk[1],&ijk[2]);
 
 	// At this point the ijk indecies are correct for the non-varying
 	// dimensions. We only need to find the index for the varying dimension
 	//
-	if (_varying_dim == 0) {
-		*j = j0; *k = k0;
-
-		i0 = 0;
-		i1 = dims[0]-1;
-		double x0 = _interpolateVaryingCoord(i0,j0,k0,x,y,z);
-		double x1 = _interpolateVaryingCoord(i1,j0,k0,x,y,z);
-
-		// see if point is outside grid or on boundary
-		//
-		if ((x-x0) * (x-x1) >= 0.0) { 	
-			if (x0<=x1) {
-				if (x<=x0) *i = 0;
-				else if (x>=x1) *i = dims[0]-1;
-			}
-			else {
-				if (x>=x0) *i = 0;
-				else if (x<=x1) *i = dims[0]-1;
-			}
-			return;
-		}
-
-		//
-		// X-coord of point must be between x0 and x1
-		//
-		while (i1-i0 > 1) {
-
-			x1 = _interpolateVaryingCoord((i0+i1)>>1,j0,k0,x,y,z);
-			if (x1 == x) {  // pathological case
-				//*i = (i0+i1)>>1;
-				i0 = (i0+i1)>>1;
-				break;
-			}
-
-			// if the signs of differences change then the coordinate 
-			// is between x0 and x1
-			//
-			if ((x-x0) * (x-x1) <= 0.0) { 
-				i1 = (i0+i1)>>1;
-			}
-			else {
-				i0 = (i0+i1)>>1;
-				x0 = x1;
-			}
-		}
-		*i = i0;
-
-	}
-	else if (_varying_dim == 1) {
-		*i = i0; *k = k0;
-
-		// Now search for the closest point
-		//
-		j0 = 0;
-		j1 = dims[1]-1;
-		double y0 = _interpolateVaryingCoord(i0,j0,k0,x,y,z);
-		double y1 = _interpolateVaryingCoord(i0,j1,k0,x,y,z);
-
-		// see if point is outside grid or on boundary
-		//
-		if ((y-y0) * (y-y1) >= 0.0) { 	
-			if (y0<=y1) {
-				if (y<=y0) *j = 0;
-				else if (y>=y1) *j = dims[1]-1;
-			}
-			else {
-				if (y>=y0) *j = 0;
-				else if (y<=y1) *j = dims[1]-1;
-			}
-			return;
-		}
-
-		//
-		// Y-coord of point must be between y0 and y1
-		//
-		while (j1-j0 > 1) {
-
-			y1 = _interpolateVaryingCoord(i0,(j0+j1)>>1,k0,x,y,z);
-			if (y1 == y) {  // pathological case
-				//*j = (j0+j1)>>1;
-				j0 = (j0+j1)>>1;
-				break;
-			}
-
-			// if the signs of differences change then the coordinate 
-			// is between y0 and y1
-			//
-			if ((y-y0) * (y-y1) <= 0.0) { 
-				j1 = (j0+j1)>>1;
-			}
-			else {
-				j0 = (j0+j1)>>1;
-				y0 = y1;
-			}
-		}
-		*j = j0;
-	}
-	else {	// _varying_dim == 2
-		*i = i0; *j = j0;
-
-		// Now search for the closest point
-		//
-		k0 = 0;
-		k1 = dims[2]-1;
-		double z0 = _interpolateVaryingCoord(i0,j0,k0,x,y,z);
-		double z1 = _interpolateVaryingCoord(i0,j0,k1,x,y,z);
-
-		// see if point is outside grid or on boundary
-		//
-		if ((z-z0) * (z-z1) >= 0.0) { 	
-			if (z0<=z1) {
-				if (z<=z0) *k = 0;
-				else if (z>=z1) *k = dims[2]-1;
-			}
-			else {
-				if (z>=z0) *k = 0;
-				else if (z<=z1) *k = dims[2]-1;
-			}
-			return;
-		}
-
-		//
-		// Z-coord of point must be between z0 and z1
-		//
-		while (k1-k0 > 1) {
+	const float *cols[4];
+	double iwgt, jwgt;
+	_GetColumnStencil(ijk[0],ijk[1],ijk[2],x,y,z,cols,&iwgt,&jwgt);
 
-			z1 = _interpolateVaryingCoord(i0,j0,(k0+k1)>>1,x,y,z);
-			if (z1 == z) {	// pathological case
-				//*k = (k0+k1)>>1;
-				k0 = (k0+k1)>>1;
-				break;
-			}
+	double xyz[] = {x,y,z};
+	ijk[_varying_dim] = _FindLevel(cols, iwgt, jwgt, xyz[_varying_dim]);
 
-			// if the signs of differences change then the coordinate 
-			// is between z0 and z1
-			//
-			if ((z-z0) * (z-z1) <= 0.0) { 
-				k1 = (k0+k1)>>1;
-			}
-			else {
-				k0 = (k0+k1)>>1;
-				z0 = z1;
-			}
-		}
-		*k = k0;
-	}
+	*i = ijk[0];
+	*j = ijk[1];
+	*k = ijk[2];
 }
 
 int LayeredGrid::Reshape(
@@ -760,7 +670,9 @@ int LayeredGrid::Reshape(
 	int rc = RegularGrid::Reshape(min,max,periodic);
 	if (rc<0) return(-1);
 
+	_FreeColumns();
 	_GetUserExtents(_extents);
+	_SetColumnDims();
 
 	return(0);
 }
@@ -812,128 +724,42 @@ bool LayeredGrid::InsideGrid(double x, double y, double z) const {
 	// Only the indecies for the non-varying dimensions are correctly
 	// returned by GetIJKIndexFloor()
 	//
-	size_t dims[3];
-	GetDimensions(dims);
-
 	size_t i0, j0, k0;
-	size_t i1, j1, k1;
 	RegularGrid::GetIJKIndexFloor(x,y,z, &i0,&j0,&k0);
-	if (i0 == dims[0]-1) i1 = i0;
-	else i1 = i0+1;
-	if (j0 == dims[1]-1) j1 = j0;
-	else j1 = j0+1;
-	if (k0 == dims[2]-1) k1 = k0;
-	else k1 = k0+1;
+
+	const float *cols[4];
+	double iwgt, jwgt;
+	_GetColumnStencil(i0,j0,k0,x,y,z,cols,&iwgt,&jwgt);
+
+	double xyz[] = {x,y,z};
+	double vc = xyz[_varying_dim];	// varying coordinate value
 
 	//
 	// See if the varying dimension coordinate of the point is 
-	// completely above or below all of the corner points in the first (last)
-	// cell in the column of cells containing the point
+	// completely above or below all of the grid points in the four
+	// columns surrounding the point, or between the bounds of all
+	// of them
 	//
-	double t00, t01, t10, t11;	// varying dimension coord of "top" cell
-	double b00, b01, b10, b11;	// varying dimension coord of "bottom" cell
-	double vc; // varying coordinate value
-	if (_varying_dim == 0) {
-
-		t00 = _GetVaryingCoord( dims[0]-1, j0, k0);
-		t01 = _GetVaryingCoord( dims[0]-1, j1, k0);
-		t10 = _GetVaryingCoord( dims[0]-1, j0, k1);
-		t11 = _GetVaryingCoord( dims[0]-1, j1, k1);
-
-		b00 = _GetVaryingCoord( 0, j0, k0);
-		b01 = _GetVaryingCoord( 0, j1, k0);
-		b10 = _GetVaryingCoord( 0, j0, k1);
-		b11 = _GetVaryingCoord( 0, j1, k1);
-		vc = x;
-
-	}
-	else if (_varying_dim == 1) {
-
-		t00 = _GetVaryingCoord( i0, dims[1]-1, k0);
-		t01 = _GetVaryingCoord( i1, dims[1]-1, k0);
-		t10 = _GetVaryingCoord( i0, dims[1]-1, k1);
-		t11 = _GetVaryingCoord( i1, dims[1]-1, k1);
-
-		b00 = _GetVaryingCoord( i0, 0, k0);
-		b01 = _GetVaryingCoord( i1, 0, k0);
-		b10 = _GetVaryingCoord( i0, 0, k1);
-		b11 = _GetVaryingCoord( i1, 0, k1);
-		vc = y;
-
-	}
-	else { // _varying_dim == 2
-
-		t00 = _GetVaryingCoord( i0, j0, dims[2]-1);
-		t01 = _GetVaryingCoord( i1, j0, dims[2]-1);
-		t10 = _GetVaryingCoord( i0, j1, dims[2]-1);
-		t11 = _GetVaryingCoord( i1, j1, dims[2]-1);
-
-		b00 = _GetVaryingCoord( i0, j0, 0);
-		b01 = _GetVaryingCoord( i1, j0, 0);
-		b10 = _GetVaryingCoord( i0, j1, 0);
-		b11 = _GetVaryingCoord( i1, j1, 0);
-		vc = z;
-	}
-
-	if (b00<t00) {
-		// If coordinate is between all of the cell's top and bottom
-		// coordinates the point must be in the grid
-		//
-		if (b00<vc && b01<vc && b10<vc && b11<vc &&
-			t00>vc && t01>vc && t10>vc && t11>vc) {
-
-			return(true);
-		}
-		//
-		// if coordinate is above or below all corner points 
-		// the input point must be outside the grid
-		//
-		if (b00>vc && b01>vc && b10>vc && b11>vc) return(false);
-		if (t00<vc && t01<vc && t10<vc && t11<vc) return(false);
-	}
-	else {
-		if (b00>vc && b01>vc && b10>vc && b11>vc &&
-			t00<vc && t01<vc && t10<vc && t11<vc) {
-
-			return(true);
-		}
-		if (b00<vc && b01<vc && b10<vc && b11<vc) return(false);
-		if (t00>vc && t01>vc && t10>vc && t11>vc) return(false);
+	const ColumnTable *ct = _GetColumns();
+	size_t nlevels = _colDims[2];
+	double outerMin = FLT_MAX, outerMax = -FLT_MAX;
+	double innerMin = -FLT_MAX, innerMax = FLT_MAX;
+	for (int n=0; n<4; n++) {
+		size_t col = (cols[n] - ct->coords) / nlevels;
+		if (ct->cmin[col] < outerMin) outerMin = ct->cmin[col];
+		if (ct->cmax[col] > outerMax) outerMax = ct->cmax[col];
+		if (ct->cmin[col] > innerMin) innerMin = ct->cmin[col];
+		if (ct->cmax[col] < innerMax) innerMax = ct->cmax[col];
 	}
+	if (vc < outerMin || vc > outerMax) return(false);
+	if (vc > innerMin && vc < innerMax) return(true);
 
 	// If we get this far the point is either inside or outside of a
 	// boundary cell on the varying dimension. Need to interpolate
 	// the varying coordinate of the cell
-
-	// Varying dimesion coordinate value returned by GetUserCoordinates
-	// is not valid
 	//
-	double x0, y0, z0, x1, y1, z1;
-	RegularGrid::GetUserCoordinates(i0,j0,k0, &x0, &y0, &z0);
-	RegularGrid::GetUserCoordinates(i1,j1,k1, &x1, &y1, &z1);
-
-	double iwgt, jwgt;
-	if (_varying_dim == 0) {
-		if (y1!=y0) iwgt = fabs((y-y0) / (y1-y0));
-		else iwgt = 0.0;
-		if (z1!=z0) jwgt = fabs((z-z0) / (z1-z0));
-		else jwgt = 0.0;
-	}
-	else if (_varying_dim == 1) {
-		if (x1!=x0) iwgt = fabs((x-x0) / (x1-x0));
-		else iwgt = 0.0;
-		if (z1!=z0) jwgt = fabs((z-z0) / (z1-z0));
-		else jwgt = 0.0;
-	}
-	else {
-		if (x1!=x0) iwgt = fabs((x-x0) / (x1-x0));
-		else iwgt = 0.0;
-		if (y1!=y0) jwgt = fabs((y-y0) / (y1-y0));
-		else jwgt = 0.0;
-	}
-
-	double t = t00+iwgt*(t01-t00) + jwgt*((t10+iwgt*(t11-t10))-(t00+iwgt*(t01-t00)));
-	double b = b00+iwgt*(b01-b00) + jwgt*((b10+iwgt*(b11-b10))-(b00+iwgt*(b01-b00)));
+	double b = _columnCoord(cols, iwgt, jwgt, 0);
+	double t = _columnCoord(cols, iwgt, jwgt, nlevels-1);
 
 	if (b<t) {
 		if (vc<b || vc>t) return(false);
@@ -977,8 +803,6 @@ double LayeredGrid::_GetVaryingCoord(size_t i, size_t j, size_t k) const {
 	double c = _AccessIJK(_coords, i, j, k);
 	if (c != mv) return (c);
 
-	assert (c != mv);
-
 	size_t dims[3];
 	GetDimensions(dims);
 	
@@ -1029,9 +853,116 @@ double LayeredGrid::_interpolateVaryingCoord(
 	size_t i0, size_t j0, size_t k0,
 	double x, double y, double z) const {
 
-	// varying dimension coord at corner grid points of cell face
+	const float *cols[4];
+	double iwgt, jwgt;
+	_GetColumnStencil(i0,j0,k0,x,y,z,cols,&iwgt,&jwgt);
+
+	size_t ijk[] = {i0,j0,k0};
+	return(_columnCoord(cols, iwgt, jwgt, ijk[_varying_dim]));
+}
+
+size_t LayeredGrid::GetLocatorMemSize() const {
+	if (! _colTable) return(0);
+
+	size_t ncols = _colDims[0] * _colDims[1];
+	return((ncols * _colDims[2] + 2 * ncols) * sizeof(float));
+}
+
+void LayeredGrid::_SetColumnDims() {
+
+	size_t dims[3];
+	GetDimensions(dims);
+
+	_colAxes[0] = _varying_dim == 0 ? 1 : 0;
+	_colAxes[1] = _varying_dim == 2 ? 1 : 2;
+	_colDims[0] = dims[_colAxes[0]];
+	_colDims[1] = dims[_colAxes[1]];
+	_colDims[2] = dims[_varying_dim];
+}
+
+//
+// Return the point location tables, building them if this is the
+// first query. The pointer to the tables is published with release
+// semantics once they are complete, so a thread that sees it set
+// also sees their contents.
+//
+const LayeredGrid::ColumnTable *LayeredGrid::_GetColumns() const {
+#ifdef WIN32
+	// volatile accesses have acquire/release semantics with MSVC
+	ColumnTable *ct = _colTable;
+#else
+	ColumnTable *ct = __atomic_load_n(&_colTable, __ATOMIC_ACQUIRE);
+#endif
+	if (ct) return(ct);
+
+	BuildLock.Lock();
+	ct = _colTable;
+	if (! ct) {
+		ct = _BuildColumns();
+#ifdef WIN32
+		_colTable = ct;
+#else
+		__atomic_store_n(&_colTable, ct, __ATOMIC_RELEASE);
+#endif
+	}
+	BuildLock.Unlock();
+	return(ct);
+}
+
+LayeredGrid::ColumnTable *LayeredGrid::_BuildColumns() const {
+
+	size_t ncols = _colDims[0] * _colDims[1];
+	ColumnTable *ct = new ColumnTable;
+	ct->coords = new float[ncols * _colDims[2]];
+	ct->cmin = new float[ncols];
+	ct->cmax = new float[ncols];
+
 	//
-	double c00, c01, c10, c11;	
+	// Copy the coordinates a column at a time, filling in any
+	// missing values
+	//
+	size_t ijk[3];
+	float *cptr = ct->coords;
+	for (size_t b=0; b<_colDims[1]; b++) {
+	for (size_t a=0; a<_colDims[0]; a++) {
+		size_t col = b*_colDims[0] + a;
+		ijk[_colAxes[0]] = a;
+		ijk[_colAxes[1]] = b;
+
+		ct->cmin[col] = FLT_MAX;
+		ct->cmax[col] = -FLT_MAX;
+		for (size_t l=0; l<_colDims[2]; l++) {
+			ijk[_varying_dim] = l;
+			float c = _GetVaryingCoord(ijk[0], ijk[1], ijk[2]);
+			*cptr++ = c;
+			if (c < ct->cmin[col]) ct->cmin[col] = c;
+			if (c > ct->cmax[col]) ct->cmax[col] = c;
+		}
+	}
+	}
+	return(ct);
+}
+
+void LayeredGrid::_FreeColumns() {
+	if (! _colTable) return;
+
+	delete [] _colTable->coords;
+	delete [] _colTable->cmin;
+	delete [] _colTable->cmax;
+	delete _colTable;
+	_colTable = NULL;
+}
+
+//
+// Find the four columns of varying dimension coordinates bounding the
+// cell (i0,j0,k0) and the bilinear weights of the point x,y,z within
+// the face of the cell spanned by the non-varying dimensions
+//
+void LayeredGrid::_GetColumnStencil(
+	size_t i0, size_t j0, size_t k0,
+	double x, double y, double z,
+	const float *cols[4], double *iwgt, double *jwgt
+) const {
 
 	size_t dims[3];
 	GetDimensions(dims);
@@ -1045,54 +976,100 @@ double LayeredGrid::_interpolateVaryingCoord(
 	else k1 = k0+1;
 
 	// Coordinates of grid points for non-varying dimensions 
-	double x0, y0, z0, x1, y1, z1;	
-	RegularGrid::GetUserCoordinates(i0,j0,k0, &x0, &y0, &z0);
-	RegularGrid::GetUserCoordinates(i1,j1,k1, &x1, &y1, &z1);
-	double iwgt, jwgt;
+	double xyz0[3], xyz1[3];	
+	RegularGrid::GetUserCoordinates(i0,j0,k0, &xyz0[0], &xyz0[1], &xyz0[2]);
+	RegularGrid::GetUserCoordinates(i1,j1,k1, &xyz1[0], &xyz1[1], &xyz1[2]);
+
+	size_t ijk0[] = {i0,j0,k0};
+	size_t ijk1[] = {i1,j1,k1};
+	double xyz[] = {x,y,z};
+	int a = _colAxes[0];
+	int b = _colAxes[1];
+	size_t na = _colDims[0];
+	size_t nlevels = _colDims[2];
+	const float *colCoords = _GetColumns()->coords;
+
+	cols[0] = colCoords + (ijk0[b]*na + ijk0[a]) * nlevels;
+	cols[1] = colCoords + (ijk0[b]*na + ijk1[a]) * nlevels;
+	cols[2] = colCoords + (ijk1[b]*na + ijk0[a]) * nlevels;
+	cols[3] = colCoords + (ijk1[b]*na + ijk1[a]) * nlevels;
+
+	if (xyz1[a]!=xyz0[a]) *iwgt = fabs((xyz[a]-xyz0[a]) / (xyz1[a]-xyz0[a]));
+	else *iwgt = 0.0;
+	if (xyz1[b]!=xyz0[b]) *jwgt = fabs((xyz[b]-xyz0[b]) / (xyz1[b]-xyz0[b]));
+	else *jwgt = 0.0;
+}
 
-	if (_varying_dim == 0) {
+//
+// Return the varying dimension index of the cell, in the column of
+// cells described by cols, iwgt and jwgt, containing the varying
+// coordinate vc
+//
+size_t LayeredGrid::_FindLevel(
+	const float *const cols[4], double iwgt, double jwgt, double vc
+) const {
 
-		// Now get user coordinates of vary-dimension grid point
-		// N.B. Could just call LayeredGrid:GetUserCoordinates() for 
-		// each of the four points but this is more efficient
-		//
-		c00 = _AccessIJK(_coords, i0, j0, k0);
-		c01 = _AccessIJK(_coords, i0, j1, k0);
-		c10 = _AccessIJK(_coords, i0, j0, k1);
-		c11 = _AccessIJK(_coords, i0, j1, k1);
+	size_t l0 = 0;
+	size_t l1 = _colDims[2]-1;
+	double v0 = _columnCoord(cols, iwgt, jwgt, l0);
+	double v1 = _columnCoord(cols, iwgt, jwgt, l1);
 
-		if (y1!=y0) iwgt = fabs((y-y0) / (y1-y0));
-		else iwgt = 0.0;
-		if (z1!=z0) jwgt = fabs((z-z0) / (z1-z0));
-		else jwgt = 0.0;
+	// see if point is outside grid or on boundary
+	//
+	if ((vc-v0) * (vc-v1) >= 0.0) { 	
+		if (v0<=v1) return(vc<=v0 ? 0 : l1);
+		else return(vc>=v0 ? 0 : l1);
 	}
-	else if (_varying_dim == 1) {
-
-		c00 = _AccessIJK(_coords, i0, j0, k0);
-		c01 = _AccessIJK(_coords, i1, j0, k0);
-		c10 = _AccessIJK(_coords, i0, j0, k1);
-		c11 = _AccessIJK(_coords, i1, j0, k1);
-
-		if (x1!=x0) iwgt = fabs((x-x0) / (x1-x0));
-		else iwgt = 0.0;
-		if (z1!=z0) jwgt = fabs((z-z0) / (z1-z0));
-		else jwgt = 0.0;
 
+	//
+	// Try the cell found by this thread's previous search first. Successive 
+	// lookups (e.g. along a trajectory) usually land in the same cell.
+	// If the point isn't in it the search is narrowed to the side
+	// of the cell containing the point.
+	//
+	size_t h = LevelHint;
+	if (h < l1) {
+		double s0 = vc-v0;
+		double h0 = _columnCoord(cols, iwgt, jwgt, h);
+		double h1 = _columnCoord(cols, iwgt, jwgt, h+1);
+		if ((vc-h0) * s0 > 0.0) {
+			if ((vc-h1) * s0 < 0.0) return(h);
+
+			l0 = h;
+			v0 = h0;
+			if ((vc-h1) * s0 > 0.0) {
+				l0 = h+1;
+				v0 = h1;
+			}
+		}
+		else if ((vc-h0) * s0 < 0.0) {
+			l1 = h;
+		}
 	}
-	else { // _varying_dim == 2
 
-		c00 = _AccessIJK(_coords, i0, j0, k0);
-		c01 = _AccessIJK(_coords, i1, j0, k0);
-		c10 = _AccessIJK(_coords, i0, j1, k0);
-		c11 = _AccessIJK(_coords, i1, j1, k0);
+	//
+	// Varying coordinate of point must be between v0 and v1
+	//
+	while (l1-l0 > 1) {
 
-		if (x1!=x0) iwgt = fabs((x-x0) / (x1-x0));
-		else iwgt = 0.0;
-		if (y1!=y0) jwgt = fabs((y-y0) / (y1-y0));
-		else jwgt = 0.0;
+		size_t lm = (l0+l1)>>1;
+		double vm = _columnCoord(cols, iwgt, jwgt, lm);
+		if (vm == vc) {	// pathological case
+			l0 = lm;
+			break;
+		}
 
+		// if the signs of differences change then the coordinate 
+		// is between v0 and vm
+		//
+		if ((vc-v0) * (vc-vm) <= 0.0) { 
+			l1 = lm;
+		}
+		else {
+			l0 = lm;
+			v0 = vm;
+		}
 	}
-
-	double c = c00+iwgt*(c01-c00) + jwgt*((c10+iwgt*(c11-c10))-(c00+iwgt*(c01-c00)));
-	return(c);
+	LevelHint = l0;
+	return(l0);
 }
@@ -0,0 +1,311 @@
+#include <cstdio>
+#include <cstring>
+#include <vapor/MultiResPyramid.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+#ifndef WIN32
+#include <stdint.h>
+#endif
+
+namespace {
+
+	//
+	// File header. The file is written with fixed width types so that
+	// it can be shared by 32 and 64 bit builds. Values are in native
+	// byte order; the byte order mark is used to reject files written
+	// on a machine with a different order.
+	//
+#ifdef WIN32
+	typedef unsigned __int32 pyr_uint32_t;
+	typedef unsigned __int64 pyr_uint64_t;
+#else
+	typedef uint32_t pyr_uint32_t;
+	typedef uint64_t pyr_uint64_t;
+#endif
+
+	const char pyramidMagic[8] = {'V','D','C','P','Y','R','M','2'};
+	const pyr_uint32_t byteOrderMark = 0x01020304;
+
+	//
+	// Every member is naturally aligned, so the layout has no padding
+	//
+	typedef struct {
+		char magic[8];
+		pyr_uint32_t byteOrder;
+		pyr_uint32_t ntransforms;
+		pyr_uint64_t dim[3];
+		pyr_uint64_t fingerprint;
+	} header_t;
+};
+
+MultiResPyramid::MultiResPyramid() {
+	for (int i=0; i<3; i++) _dim[i] = 1;
+	_ntransforms = 0;
+	_has_missing = false;
+	_mv = 0.0;
+	_fingerprint = 0;
+	_nextz = 0;
+	_storage = NULL;
+	_ownStorage = false;
+}
+
+MultiResPyramid::~MultiResPyramid() {
+	if (_ownStorage) delete [] _storage;
+}
+
+void MultiResPyramid::GetDim(
+	const size_t dim[3], int ntransforms, int reflevel, size_t ldim[3]
+) {
+	int ldelta = 0;
+	if (reflevel >= 0 && reflevel < ntransforms) ldelta = ntransforms-reflevel;
+
+	for (int i=0; i<3; i++) {
+		ldim[i] = dim[i];
+		for (int l=0; l<ldelta; l++) ldim[i] = (ldim[i] + 1) / 2;
+		if (ldim[i] < 1) ldim[i] = 1;
+	}
+}
+
+size_t MultiResPyramid::GetNumBytes(const size_t dim[3], int ntransforms) {
+	size_t n = 0;
+	for (int l=0; l<ntransforms; l++) {
+		size_t ldim[3];
+		GetDim(dim, ntransforms, l, ldim);
+		n += ldim[0]*ldim[1]*ldim[2];
+	}
+	return(n * sizeof(float));
+}
+
+int MultiResPyramid::Init(
+	const size_t dim[3], int ntransforms, bool has_missing, float mv,
+	float *storage
+) {
+	if (_ownStorage) delete [] _storage;
+	_storage = NULL;
+	_ownStorage = false;
+	_levels.clear();
+	_ntransforms = 0;
+	_nextz = 0;
+
+	if (ntransforms < 1) {
+		SetErrMsg("Invalid number of transforms : %d", ntransforms);
+		return(-1);
+	}
+	for (int i=0; i<3; i++) {
+		if (dim[i] < 1) {
+			SetErrMsg("Invalid dimensions");
+			return(-1);
+		}
+		_dim[i] = dim[i];
+	}
+	_ntransforms = ntransforms;
+	_has_missing = has_missing;
+	_mv = mv;
+
+	_storage = storage;
+	if (! _storage) {
+		_storage = new float[GetNumBytes(_dim, _ntransforms) / sizeof(float)];
+		_ownStorage = true;
+	}
+
+	_levels.resize(_ntransforms);
+	float *ptr = _storage;
+	for (int l=0; l<_ntransforms; l++) {
+		size_t ldim[3];
+		GetDim(_dim, _ntransforms, l, ldim);
+		_levels[l] = ptr;
+		ptr += ldim[0]*ldim[1]*ldim[2];
+	}
+	return(0);
+}
+
+//
+// Box filter the planes of src into the planes of dst, halving each
+// dimension. Partial cells along the last row, column or plane average
+// the voxels they have.
+//
+void MultiResPyramid::_reduce(
+	const float *src, const size_t sdim[3], float *dst, const size_t ddim[2]
+) const {
+	size_t snx = sdim[0];
+	size_t sny = sdim[1];
+	size_t snz = sdim[2];
+	size_t dnz = (snz + 1) / 2;
+
+	for (size_t k=0; k<dnz; k++) {
+	for (size_t j=0; j<ddim[1]; j++) {
+	for (size_t i=0; i<ddim[0]; i++) {
+		double sum = 0.0;
+		int n = 0;
+		for (size_t z=2*k; z<2*k+2 && z<snz; z++) {
+		for (size_t y=2*j; y<2*j+2 && y<sny; y++) {
+			const float *row = src + (z*sny + y)*snx;
+			for (size_t x=2*i; x<2*i+2 && x<snx; x++) {
+				if (_has_missing && row[x] == _mv) continue;
+				sum += row[x];
+				n++;
+			}
+		}
+		}
+		dst[(k*ddim[1] + j)*ddim[0] + i] = n ? (float) (sum / n) : _mv;
+	}
+	}
+	}
+}
+
+int MultiResPyramid::AddSlab(const float *slab, size_t nz) {
+	if (! _ntransforms) {
+		SetErrMsg("Pyramid not initialized");
+		return(-1);
+	}
+	if (nz < 1 || _nextz + nz > _dim[2] ||
+		(nz != GetSlabDepth() && _nextz + nz != _dim[2])) {
+
+		SetErrMsg("Invalid slab depth : %d", nz);
+		return(-1);
+	}
+
+	//
+	// Slabs start on a multiple of GetSlabDepth(), so each coarser
+	// level receives whole planes
+	//
+	const float *src = slab;
+	size_t sdim[] = {_dim[0], _dim[1], nz};
+	size_t z0 = _nextz;
+	for (int l=_ntransforms-1; l>=0; l--) {
+		size_t ldim[3];
+		GetDim(_dim, _ntransforms, l, ldim);
+
+		z0 /= 2;
+		float *dst = _levels[l] + z0*ldim[0]*ldim[1];
+		_reduce(src, sdim, dst, ldim);
+
+		sdim[0] = ldim[0];
+		sdim[1] = ldim[1];
+		sdim[2] = (sdim[2] + 1) / 2;
+		src = dst;
+	}
+	_nextz += nz;
+	return(0);
+}
+
+int MultiResPyramid::GetRegion(
+	int reflevel, const size_t min[3], const size_t max[3], float *region
+) const {
+	if (! IsComplete()) {
+		SetErrMsg("Pyramid not complete");
+		return(-1);
+	}
+	if (reflevel < 0 || reflevel >= _ntransforms) {
+		SetErrMsg("Invalid refinement level : %d", reflevel);
+		return(-1);
+	}
+
+	size_t ldim[3];
+	GetDim(_dim, _ntransforms, reflevel, ldim);
+	for (int i=0; i<3; i++) {
+		if (min[i] > max[i] || max[i] >= ldim[i]) {
+			SetErrMsg("Invalid region");
+			return(-1);
+		}
+	}
+
+	const float *level = _levels[reflevel];
+	size_t nx = max[0]-min[0]+1;
+	float *ptr = region;
+	for (size_t z=min[2]; z<=max[2]; z++) {
+	for (size_t y=min[1]; y<=max[1]; y++) {
+		memcpy(
+			ptr, level + (z*ldim[1] + y)*ldim[0] + min[0], nx*sizeof(*ptr)
+		);
+		ptr += nx;
+	}
+	}
+	return(0);
+}
+
+int MultiResPyramid::Write(const string &path) const {
+
+	if (! IsComplete()) {
+		SetErrMsg("Pyramid not complete");
+		return(-1);
+	}
+
+	header_t header;
+	memcpy(header.magic, pyramidMagic, sizeof(header.magic));
+	header.byteOrder = byteOrderMark;
+	header.ntransforms = (pyr_uint32_t) _ntransforms;
+	for (int i=0; i<3; i++) header.dim[i] = (pyr_uint64_t) _dim[i];
+	header.fingerprint = (pyr_uint64_t) _fingerprint;
+
+	string tmppath = path + ".tmp";
+	FILE *fp = fopen(tmppath.c_str(), "wb");
+	if (! fp) {
+		SetErrMsg("fopen(%s) : %M", tmppath.c_str());
+		return(-1);
+	}
+
+	size_t n = GetNumBytes() / sizeof(float);
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(_storage, sizeof(float), n, fp) == n;
+	if (fclose(fp) != 0) ok = false;
+
+	if (ok) {
+#ifdef WIN32
+		remove(path.c_str());	// rename() won't replace on Windows
+#endif
+		ok = rename(tmppath.c_str(), path.c_str()) == 0;
+	}
+	if (! ok) {
+		SetErrMsg("Error writing pyramid file %s : %M", path.c_str());
+		remove(tmppath.c_str());
+		return(-1);
+	}
+	return(0);
+}
+
+int MultiResPyramid::Read(const string &path) {
+
+	if (! _ntransforms) {
+		SetErrMsg("Pyramid not initialized");
+		return(-1);
+	}
+
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (! fp) {
+		SetErrMsg("fopen(%s) : %M", path.c_str());
+		return(-1);
+	}
+
+	header_t header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+		memcmp(header.magic, pyramidMagic, sizeof(header.magic)) == 0 &&
+		header.byteOrder == byteOrderMark &&
+		header.ntransforms == (pyr_uint32_t) _ntransforms &&
+		header.fingerprint == (pyr_uint64_t) _fingerprint;
+	for (int i=0; ok && i<3; i++) {
+		if (header.dim[i] != (pyr_uint64_t) _dim[i]) ok = false;
+	}
+	if (! ok) {
+		fclose(fp);
+		SetErrMsg("Invalid pyramid file %s", path.c_str());
+		return(-1);
+	}
+
+	//
+	// The levels must fill the rest of the file exactly
+	//
+	size_t n = GetNumBytes() / sizeof(float);
+	ok = fread(_storage, sizeof(float), n, fp) == n && fgetc(fp) == EOF;
+	fclose(fp);
+
+	if (! ok) {
+		_nextz = 0;
+		SetErrMsg("Invalid pyramid file size %s", path.c_str());
+		return(-1);
+	}
+	_nextz = _dim[2];
+	return(0);
+}
@@ -2,16 +2,33 @@
 
 #include <iostream>
 #include <cassert>
+#include <cstring>
 #ifdef PNETCDF
 #include <pnetcdf.h>
 #else
 #include <netcdf.h>
 #endif
+#include <vapor/CFuncs.h>
 #include <vapor/NCBuf.h>
 
 using namespace VetsUtil;
 using namespace VAPoR;
 
+#ifdef	NCBUF_ASYNC
+namespace {
+
+	//
+	// Serializes the netCDF writes of all NCBufs, e.g. the background
+	// writes of each refinement level's file
+	//
+	pthread_mutex_t ncLock = PTHREAD_MUTEX_INITIALIZER;
+
+	void *runNCBufWorker(void *object) {
+		((NCBuf *) object)->_RunWorker();
+		return(0);
+	}
+};
+#endif
 
 NCBuf::NCBuf(
 	     int ncid, int varid, nc_type xtype, vector <size_t> dims, bool useCollective, int rank,size_t bufsize
@@ -26,12 +43,18 @@ NCBuf::NCBuf(
 	_xtype = xtype;
 	_collective = useCollective;
 	_start = new size_t[NC_MAX_DIMS];
-	_count = new size_t[NC_MAX_DIMS];
 	for (int i=0; i<NC_MAX_DIMS; i++) {
 		_start[i] = 0;
-		_count[i] = 0;
 	}
+	_rowdim = -1;
+	_rowlen = 0;
 	_buf = new unsigned char[bufsize];
+	_flushbuf = NULL;
+	_status = NC_NOERR;
+	_flushTimer = 0.0;
+	_pending = false;
+	_shutdown = false;
+	_threaded = false;
 	switch (_xtype) {
     case NC_BYTE:
         _elem_size = 1;
@@ -59,13 +82,39 @@ NCBuf::NCBuf(
 #endif
     break;
 	}
+
+#ifdef	NCBUF_ASYNC
+	pthread_mutex_init(&_lock, 0);
+	pthread_cond_init(&_changed, 0);
+	_threaded = (pthread_create(&_worker, 0, runNCBufWorker, this) == 0);
+	if (_threaded) {
+		_flushbuf = new unsigned char[bufsize];
+	}
+	else {
+		pthread_cond_destroy(&_changed);
+		pthread_mutex_destroy(&_lock);
+	}
+#endif
 }
 
 NCBuf::~NCBuf() {
 	Flush();
+
+#ifdef	NCBUF_ASYNC
+	if (_threaded) {
+		pthread_mutex_lock(&_lock);
+		_shutdown = true;
+		pthread_cond_broadcast(&_changed);
+		pthread_mutex_unlock(&_lock);
+		pthread_join(_worker, 0);
+		pthread_cond_destroy(&_changed);
+		pthread_mutex_destroy(&_lock);
+	}
+#endif
+
 	if (_start) delete [] _start;
-	if (_count) delete [] _count;
 	if (_buf) delete [] _buf;
+	if (_flushbuf) delete [] _flushbuf;
 }
 
 void print_put_var(
@@ -90,18 +139,30 @@ int NCBuf::PutVara(
 		   const size_t start[], const size_t count[], const void *data
 ) {
 	size_t lstart, lcount;  // Start and count as a linear offset
-	size_t mylstart, mylcount;  // Start and count as a linear offset
 
 	linearize(start, count, &lstart, &lcount);
-	linearize(_start, _count, &mylstart, &mylcount);
+	if (lcount == 0) return(NC_NOERR);
+
+	int rc = NC_NOERR;
+
+	//
+	// Report the failure of a background write
+	//
+#ifdef	NCBUF_ASYNC
+	if (_threaded) {
+		pthread_mutex_lock(&_lock);
+		rc = _status;
+		_status = NC_NOERR;
+		pthread_mutex_unlock(&_lock);
+		if (rc != NC_NOERR) return(rc);
+	}
+#endif
 
 	//
 	// if the region of data descibed by start+count is not contiguous
-	// on disk we can not buffer the data and simply write it out. Ditto 
+	// on disk we can not buffer the data and simply write it out. Ditto
 	// if the region size is larger than the buffer.
 	//
-	// Should we flush the buffer as well?
-	//
 	if ((! contiguous(count)) || (lcount*_elem_size) > _bufsize) {
 
 	  if(!contiguous(count))
@@ -112,110 +173,294 @@ int NCBuf::PutVara(
 	  ss << "_bufsize Non-Buffered Write buffsize(" << _bufsize << ") " << "lcount(" << lcount << ") " << "elem_size( " << _elem_size << ")";
 		print_put_var(ss.str(), _ncid, _varid, start, count, _dims.size(), _rank);
 	    }
-	    
-#ifdef PNETCDF
 
-		MPI_Offset mp_start[4];
-		MPI_Offset mp_count[4];
-		mp_start[0] = start[0];
-		mp_start[1] = start[1];
-		mp_start[2] = start[2];
-		mp_start[3] = start[3];
-		mp_count[0] = count[0];
-		mp_count[1] = count[1];
-		mp_count[2] = count[2];
-		mp_count[3] = count[3];
-		MPI_Offset len = count[0] * count[1] * count[2] * count[3];
-#endif 
+		return(_Put(start, count, data, false));
+	}
 
-#ifdef PNETCDF
-		if(_collective)
-		  return(ncmpi_put_vara_all(_ncid, _varid, mp_start, mp_count, data, len, MPI_UNSIGNED_CHAR));
-		else
-		  return(ncmpi_put_vara(_ncid, _varid, mp_start, mp_count, data, len, MPI_UNSIGNED_CHAR));
+	//
+	// Hand the buffer off to be written if the current chunk of data
+	// doesn't follow what is in the buffer, or if there is not enough
+	// room in the buffer
+	//
+	if (! _Append(start, lstart, lcount)) {
+		rc = _Submit();
+		if (rc != NC_NOERR) return(rc);
+
+		bool ok = _Append(start, lstart, lcount);
+		assert(ok);
+	}
+
+	memcpy(_buf + _bufcount, data, lcount*_elem_size);
+	_bufcount += lcount * _elem_size;
+
+	return(NC_NOERR);
+}
+
+int NCBuf::Flush(
+) {
+	int rc = _Submit();
+	int rc2 = Wait();
+	return(rc != NC_NOERR ? rc : rc2);
+}
+
+int NCBuf::Wait() {
+	int rc = NC_NOERR;
+#ifdef	NCBUF_ASYNC
+	if (_threaded) {
+		pthread_mutex_lock(&_lock);
+		while (_pending) pthread_cond_wait(&_changed, &_lock);
+		rc = _status;
+		_status = NC_NOERR;
+		pthread_mutex_unlock(&_lock);
+	}
+#endif
+	return(rc);
+}
+
+double NCBuf::GetFlushTimer() const {
+#ifdef	NCBUF_ASYNC
+	pthread_mutex_lock(&ncLock);
+	double t = _flushTimer;
+	pthread_mutex_unlock(&ncLock);
+	return(t);
 #else
-		return(nc_put_vara(_ncid, _varid, start, count, data));
+	return(_flushTimer);
 #endif
-	}
+}
 
+#ifdef	NCBUF_ASYNC
+void NCBuf::_RunWorker() {
+	pthread_mutex_lock(&_lock);
+	for (;;) {
+		while (! _pending && ! _shutdown) {
+			pthread_cond_wait(&_changed, &_lock);
+		}
+		if (! _pending) break;
 
+		pthread_mutex_unlock(&_lock);
+		int rc = _WriteRegions(_flushbuf);
+		pthread_mutex_lock(&_lock);
 
-	
-	//
-	// Flush the buffer if either the current chunk of data is not
-	// adjacent to what is in the buffer, or if there is not enough
-	// room in the buffer;
-	//
-	if ((mylstart * _elem_size + _bufcount != lstart*_elem_size) || 
-		(_bufcount + (lcount * _elem_size) > _bufsize) ||
-		(mylcount+lcount > max_reg(_start))) {
+		if (rc != NC_NOERR && _status == NC_NOERR) _status = rc;
+		_pending = false;
+		pthread_cond_broadcast(&_changed);
+	}
+	pthread_mutex_unlock(&_lock);
+}
+#endif
 
-		int rc = Flush();
-		if (rc<0) return(rc);
+//
+// Returns true, and updates the description of the buffered data, if
+// the contiguous region at linear offset 'lstart' with 'lcount'
+// elements can be added to the buffer. It can if it follows the buffered
+// data on disk, or if the buffered data are rows of a hyperslab and it
+// continues the current row or starts the next one.
+//
+bool NCBuf::_Append(
+	const size_t start[], size_t lstart, size_t lcount
+) {
+	if (_bufcount + (lcount * _elem_size) > _bufsize) return(false);
+
+	size_t n = _bufcount / _elem_size;
+	if (n == 0) {
+		for (int i=0; i<_dims.size(); i++) _start[i] = start[i];
+		_rowdim = -1;
+		_rowlen = 0;
+		return(true);
 	}
 
-	if (_bufcount == 0) {
+	size_t count[NC_MAX_DIMS];
+	size_t mylstart, mylcount;
+	for (int i=0; i<_dims.size(); i++) count[i] = 1;
+	linearize(_start, count, &mylstart, &mylcount);
+
+	if (_rowdim < 0) {
+
+		// Collective writes must stay one per buffer on every task, so
+		// the buffered run must remain a single region
+		//
+		if (_collective) {
+			return(
+				mylstart + n == lstart &&
+				box(_start, n + lcount, count) == n + lcount
+			);
+		}
+		if (mylstart + n == lstart) return(true);
+
+		//
+		// The buffered run becomes the first row of a hyperslab if it can
+		// be described by a 'count' vector and the new region starts
+		// the next row, along a dimension slower than the run's, and
+		// fits in it
+		//
+		if (lcount > n || box(_start, n, count) != n) return(false);
+
+		int k = _dims.size()-1;
 		for (int i=0; i<_dims.size(); i++) {
-			_count[i] = 0;
-			_start[i] = start[i];
+			if (count[i] > 1) {
+				k = i;
+				break;
+			}
 		}
+		for (int rowdim = k-1; rowdim >= 0; rowdim--) {
+			if (_start[rowdim] + 1 >= _dims[rowdim]) continue;
+			if (lstart != mylstart + stride(rowdim)) continue;
+
+			_rowdim = rowdim;
+			_rowlen = n;
+			return(true);
+		}
+		return(false);
 	}
-			
-	memcpy(_buf + _bufcount, data, lcount*_elem_size);
-	_bufcount += lcount * _elem_size;
 
-	inc_count(lcount);
+	size_t row = n / _rowlen;
+	size_t offset = n % _rowlen;
+	if (offset + lcount > _rowlen) return(false);
+	if (_start[_rowdim] + row >= _dims[_rowdim]) return(false);
+	return(lstart == mylstart + row*stride(_rowdim) + offset);
+}
 
-	return(0);
+//
+// Describe the run of 'n' elements starting at 'start' as regions, each
+// the largest one a 'count' vector can describe
+//
+void NCBuf::_AddRun(
+	const size_t start[], size_t n, size_t offset, vector <region> &regions
+) const {
+	size_t lstart, lcount;
+	size_t one[NC_MAX_DIMS];
+	for (int i=0; i<_dims.size(); i++) one[i] = 1;
+	linearize(start, one, &lstart, &lcount);
+
+	while (n > 0) {
+		region r;
+		r.start.resize(_dims.size());
+		r.count.resize(_dims.size());
+		size_t l = lstart;
+		for (int i = _dims.size()-1; i>=0; i--) {
+			r.start[i] = l % _dims[i];
+			l /= _dims[i];
+		}
+		r.offset = offset;
+		size_t m = box(&r.start[0], n, &r.count[0]);
+		regions.push_back(r);
 
+		lstart += m;
+		offset += m * _elem_size;
+		n -= m;
+	}
 }
 
-int NCBuf::Flush(
-) {
+//
+// Hand the buffered data off to the background thread, once it is done
+// with the previous buffer, or write it now if there is no thread
+//
+int NCBuf::_Submit() {
+	size_t n = _bufcount / _elem_size;
+	if (n == 0) return(NC_NOERR);
 
-	if (_bufcount < 1) return(0);
+	vector <region> regions;
+	if (_rowdim < 0) {
+		_AddRun(_start, n, 0, regions);
+	}
+	else {
+		size_t nrows = n / _rowlen;
+		size_t tail = n % _rowlen;
+
+		region r;
+		r.start.assign(_start, _start + _dims.size());
+		r.count.resize(_dims.size());
+		(void) box(_start, _rowlen, &r.count[0]);
+		r.count[_rowdim] = nrows;
+		r.offset = 0;
+		regions.push_back(r);
+
+		if (tail) {
+			vector <size_t> start = r.start;
+			start[_rowdim] += nrows;
+			_AddRun(&start[0], tail, nrows*_rowlen*_elem_size, regions);
+		}
+	}
+	_bufcount = 0;
+	_rowdim = -1;
+
+#ifdef	NCBUF_ASYNC
+	if (_threaded) {
+		pthread_mutex_lock(&_lock);
+		while (_pending) pthread_cond_wait(&_changed, &_lock);
+		int rc = _status;
+		_status = NC_NOERR;
+
+		unsigned char *tmp = _flushbuf;
+		_flushbuf = _buf;
+		_buf = tmp;
+		_regions = regions;
+		_pending = true;
+		pthread_cond_broadcast(&_changed);
+		pthread_mutex_unlock(&_lock);
+		return(rc);
+	}
+#endif
+	_regions = regions;
+	return(_WriteRegions(_buf));
+}
 
-	delinearize(_count[_dims.size()-1], _count);
+int NCBuf::_WriteRegions(const unsigned char *buf) {
+	for (int i=0; i<_regions.size(); i++) {
+		const region &r = _regions[i];
+		int rc = _Put(&r.start[0], &r.count[0], buf + r.offset, true);
+		if (rc != NC_NOERR) return(rc);
+	}
+	return(NC_NOERR);
+}
 
-#ifdef PNETCDF
-	MPI_Offset mp_start[4];
-	MPI_Offset mp_count[4];
-	mp_start[0] = _start[0];
-	mp_start[1] = _start[1];
-	mp_start[2] = _start[2];
-	mp_start[3] = _start[3];
-	mp_count[0] = _count[0];
-	mp_count[1] = _count[1];
-	mp_count[2] = _count[2];
-	mp_count[3] = _count[3];
-	MPI_Offset len = _count[0] * _count[1] * _count[2] * _count[3];
+int NCBuf::_Put(
+	const size_t start[], const size_t count[], const void *data,
+	bool buffered
+) {
+#ifdef	NCBUF_ASYNC
+	pthread_mutex_lock(&ncLock);
 #endif
+	double t0 = GetTime();
 
 #ifdef PNETCDF
+	MPI_Offset mp_start[NC_MAX_DIMS];
+	MPI_Offset mp_count[NC_MAX_DIMS];
+	MPI_Offset len = 1;
+	for (int i=0; i<_dims.size(); i++) {
+		mp_start[i] = start[i];
+		mp_count[i] = count[i];
+		len *= count[i];
+	}
+
 	int rc;
-	if(_collective)
+	if (! buffered) {
+		if(_collective)
+		  rc = ncmpi_put_vara_all(_ncid, _varid, mp_start, mp_count, data, len, MPI_UNSIGNED_CHAR);
+		else
+		  rc = ncmpi_put_vara(_ncid, _varid, mp_start, mp_count, data, len, MPI_UNSIGNED_CHAR);
+	}
+	else if(_collective)
 	  {
-	    print_put_var("Collective Buffered write", _ncid, _varid, _start, _count, _dims.size(), _rank);
-	    rc = ncmpi_put_vara_all(_ncid, _varid, mp_start, mp_count, _buf, len, MPI_FLOAT);
+	    print_put_var("Collective Buffered write", _ncid, _varid, start, count, _dims.size(), _rank);
+	    rc = ncmpi_put_vara_all(_ncid, _varid, mp_start, mp_count, data, len, MPI_FLOAT);
 	  }
 	else
 	  {
-	    print_put_var("Independent Buffered write", _ncid, _varid, _start, _count, _dims.size(), _rank);
-	    rc = ncmpi_put_vara(_ncid, _varid, mp_start, mp_count, _buf, len, MPI_FLOAT);
+	    print_put_var("Independent Buffered write", _ncid, _varid, start, count, _dims.size(), _rank);
+	    rc = ncmpi_put_vara(_ncid, _varid, mp_start, mp_count, data, len, MPI_FLOAT);
 	  }
 
 #else
 
-	print_put_var("Buffered write", _ncid, _varid, _start, _count, _dims.size(), _rank);
-	int rc = (nc_put_vara(_ncid, _varid, _start, _count, _buf));
+	if (buffered) print_put_var("Buffered write", _ncid, _varid, start, count, _dims.size(), _rank);
+	int rc = (nc_put_vara(_ncid, _varid, start, count, data));
 #endif
 
-	_bufcount = 0;
-	for (int i=0; i<_dims.size(); i++) {
-		_count[i] = 0;
-		_start[i] = 0;
-	}
-
+	_flushTimer += GetTime() - t0;
+#ifdef	NCBUF_ASYNC
+	pthread_mutex_unlock(&ncLock);
+#endif
 	return(rc);
 }
 
@@ -250,15 +495,15 @@ bool NCBuf::contiguous(
 
 	return(true);
 }
-			
+
 //
 // Given a netCDF vector representation of a region (start and count),
 // transform the vector description into a scalar offset and number of
 // elements.
-// 
+//
 void NCBuf::linearize(
 	const size_t start[], const size_t count[], size_t *lstart, size_t *lcount
-) {
+) const {
 
 	*lstart = 0;
 	*lcount = 1;
@@ -272,35 +517,43 @@ void NCBuf::linearize(
 }
 
 //
-// Transform a linear description of the number of elements contained
-// in a contiguous region to a netCDF vector "count" representation
+// Number of elements between neighbors along dimension 'dim'
 //
-void NCBuf::delinearize(
-	size_t lcount, size_t count[]
-) {
+size_t NCBuf::stride(int dim) const {
+	size_t l = 1;
+	for (int j=dim+1; j<_dims.size(); j++) l *= _dims[j];
+	return(l);
+}
 
-	// assumes lcount defined a region that can be described by a 
-	// count vector 
-	//
+//
+// Calculate the largest region, of at most 'n' elements, that is
+// contiguous on disk and can be described by a 'count' vector with the
+// given 'start' location. Returns the number of elements in the region.
+//
+size_t NCBuf::box(
+	const size_t start[], size_t n, size_t count[]
+) const {
+	for (int i=0; i<_dims.size(); i++) count[i] = 1;
+
+	size_t lcount = 1;
 	for (int i = _dims.size()-1; i>=0; i--) {
-		if (lcount > _dims[i]) {
-			assert((lcount % _dims[i]) == 0);
-			count[i] = _dims[i];
-			lcount = lcount / _dims[i];
-		}
-		else if (lcount > 0) {
-			count[i] = lcount;
-			lcount = 0;
-		}
-		else {
-			count[i] = 1;
-		}
+		size_t d = _dims[i] - start[i];
+		if (lcount * d > n) d = n / lcount;
+
+		count[i] = d;
+		lcount *= d;
+
+		// We're done as soon as we process a non-zero start offset,
+		// or a partial dimension
+		//
+		if (start[i] != 0 || d != _dims[i]) break;
 	}
+	return(lcount);
 }
 
 //
 // Calculate the size of the largest contiguous region that can be described
-// by a 'count' vector with the given 'start' location, subject to the 
+// by a 'count' vector with the given 'start' location, subject to the
 // constraint that we don't exceed the buffer size
 //
 size_t NCBuf::max_reg(
@@ -312,7 +565,7 @@ size_t NCBuf::max_reg(
 
 		// lcount can't be larger than the buffer
 		//
-		while ((lcount * d * _elem_size > _bufsize) && d > 1) d--; 
+		while ((lcount * d * _elem_size > _bufsize) && d > 1) d--;
 
 		lcount *= d;
 
@@ -323,30 +576,3 @@ size_t NCBuf::max_reg(
 	}
 	return(lcount);
 }
-
-
-//
-// Increment the '_count' vector counter by lcount. Note, lcount is a
-// scalar quantity. 
-//
-// The resulting '_count' vector may not be valid for the current (4.1.x)
-// netcdf API, as its fastest varying dimension may exceed the dimension
-// length of the variable.  It needs to be "delinearized" before it is 
-// suitable for netCDF. N.B. We should probably delinearize _count in this
-// method...
-//
-void NCBuf::inc_count(size_t lcount)
-{
-	//
-	// Deal with initilization case when _count is zero
-	//
-	size_t mylstart, mylcount;
-	linearize(_start, _count, &mylstart, &mylcount);
-	if (mylcount == 0) {
-		for (int i=0; i<_dims.size()-1; i++) _count[i] = 1;
-		_count[_dims.size()-1] = 0;
-	}
-		
-	_count[_dims.size()-1] += lcount;
-	assert(contiguous(_count) == true);
-}
@@ -3,6 +3,7 @@
 #include <iterator>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #ifdef _WINDOWS
 #include "vapor/udunits2.h"
 #else
@@ -1093,21 +1094,30 @@ int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g1::Open(size_t) {
 	return(0);
 }
 
+//
+// s(z) = depth_c*s[z] + (depth - depth_c)*C[z], and the coordinate is 
+// s(z) + eta*(1 + s(z)/depth). The terms of z are computed once per slice.
+//
+void NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g1::_Slice(
+	size_t z, float *slice
+) const {
+	size_t nxy = _dims[1] * _dims[2];
+
+	float dcs = _depth_c*_s[z];
+	float C = _C[z];
+	for (size_t i=0; i<nxy; i++) {
+		float S = dcs + (_depth[i] - _depth_c)* C;
+		slice[i] = S + _eta[i] * (1+S/_depth[i]);
+	}
+}
+
 int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g1::Read(
 	float *buf, int
 ) {
-	size_t nx = _dims[2];
-	size_t ny = _dims[1];
 	size_t nz = _dims[0];
 
 	for (size_t z=0; z<nz; z++) {
-	for (size_t y=0; y<ny; y++) {
-	for (size_t x=0; x<nx; x++) {
-		buf[z*nx*ny + y*nx + x] = 
-			_depth_c*_s[z] + (_depth[y*nx+x] - _depth_c)* _C[z] + _eta[y*nx+x] *
-			(1+(_depth_c*_s[z] + (_depth[y*nx+x]-_depth_c)*_C[z])/_depth[y*nx+x]);
-	}
-	}
+		_Slice(z, buf + z*_dims[1]*_dims[2]);
 	}
 	return(0);
 }
@@ -1115,22 +1125,11 @@ int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g1::Read(
 int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g1::ReadSlice(
 	float *slice, int 
 ) {
-	size_t nx = _dims[2];
-	size_t ny = _dims[1];
 	size_t nz = _dims[0];
 
 	if (_slice_num >= nz) return(0);
 
-
-	size_t z = _slice_num;
-
-	for (size_t y=0; y<ny; y++) {
-	for (size_t x=0; x<nx; x++) {
-		slice[y*nx + x] = 
-			_depth_c*_s[z] + (_depth[y*nx+x] - _depth_c)* _C[z] + _eta[y*nx+x] *
-			(1+(_depth_c*_s[z] + (_depth[y*nx+x]-_depth_c)*_C[z])/_depth[y*nx+x]);
-	}
-	}
+	_Slice(_slice_num, slice);
 
 	_slice_num++;
 	return(1);
@@ -1306,44 +1305,43 @@ int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g2::Open(size_t) {
 	return(0);
 }
 
+//
+// The coordinate is eta + (eta + depth)*(depth_c*s[z] + depth*C[z]) /
+// (depth_c + depth). The terms of z are computed once per slice.
+//
+void NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g2::_Slice(
+	size_t z, float *slice
+) const {
+	size_t nxy = _dims[1] * _dims[2];
+
+	float dcs = _depth_c*_s[z];
+	float C = _C[z];
+	for (size_t i=0; i<nxy; i++) {
+		slice[i] = 
+			_eta[i] + (_eta[i] + _depth[i]) * ((dcs + 
+			_depth[i]*C)/(_depth_c+_depth[i]));
+	}
+}
+
 int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g2::Read(
 	float *buf, int
 ) {
-	size_t nx = _dims[2];
-	size_t ny = _dims[1];
 	size_t nz = _dims[0];
 
 	for (size_t z=0; z<nz; z++) {
-	for (size_t y=0; y<ny; y++) {
-	for (size_t x=0; x<nx; x++) {
-		buf[z*nx*ny + y*nx + x] = 
-			_eta[y*nx+x] + (_eta[y*nx+x] + _depth[y*nx+x]) * ((_depth_c*_s[z] + 
-			_depth[y*nx+x]*_C[z])/(_depth_c+_depth[y*nx+x]));
-	}
-	}
+		_Slice(z, buf + z*_dims[1]*_dims[2]);
 	}
 	return(0);
 }
 
 int NetCDFCFCollection::DerivedVar_ocean_s_coordinate_g2::ReadSlice(
-	float *slice, int fd
+	float *slice, int
 ) {
-	size_t nx = _dims[2];
-	size_t ny = _dims[1];
 	size_t nz = _dims[0];
 
 	if (_slice_num >= nz) return(0);
 
-
-	size_t z = _slice_num;
-
-	for (size_t y=0; y<ny; y++) {
-	for (size_t x=0; x<nx; x++) {
-		slice[y*nx + x] = 
-			_eta[y*nx+x] + (_eta[y*nx+x] + _depth[y*nx+x]) * ((_depth_c*_s[z] + 
-			_depth[y*nx+x]*_C[z])/(_depth_c+_depth[y*nx+x]));
-	}
-	}
+	_Slice(_slice_num, slice);
 
 	_slice_num++;
 	return(1);
@@ -1614,12 +1612,14 @@ int NetCDFCFCollection::DerivedVar_AHSPC::CalculateElevation() {
     float **PTERM  = new float*[_dims[2]];
     float **TV2    = new float*[_dims[2]];
     float **ZSLICE  = new float*[_dims[2]];
+    float **PMLN    = new float*[_dims[2]];
     for (size_t i=0; i<_dims[2]; i++) {
         HYPDLN[i] = new float[_dims[0]+1];
         HYALPH[i] = new float[_dims[0]];
         PTERM[i]  = new float[_dims[0]];
         TV2[i]    = new float[_dims[0]];
         ZSLICE[i]     = new float[_dims[0]];
+        PMLN[i]   = new float[_dims[0]+1];
     }
 
     // Feed hyai, hyam, hybi, and hybm into two arrays,
@@ -1669,7 +1669,8 @@ int NetCDFCFCollection::DerivedVar_AHSPC::CalculateElevation() {
                       HYPDLN, // scratch array
                       HYALPH, // scratch array
                       PTERM,  // scratch array
-                      ZSLICE); // calculated geopotential height
+                      ZSLICE, // calculated geopotential height
+                      PMLN);  // scratch array
 
 		if (rc>0) {
 			SetErrMsg("Unable to calculate vertical elevation slice");
@@ -1698,12 +1699,18 @@ int NetCDFCFCollection::DerivedVar_AHSPC::CalculateElevation() {
 		if (PTERM[i])  delete [] PTERM[i];
 		if (TV2[i])	delete [] TV2[i];
 		if (ZSLICE[i]) delete [] ZSLICE[i];
+		if (PMLN[i]) delete [] PMLN[i];
+	}
+	for (int i=0; i<2; i++){
+		if (HYBA[i]) delete [] HYBA[i];
+		if (HYBB[i]) delete [] HYBB[i];
 	}
 	if (HYPDLN) delete [] HYPDLN;
 	if (HYALPH) delete [] HYALPH;
 	if (PTERM)  delete [] PTERM;
 	if (TV2)	delete [] TV2;
 	if (ZSLICE) delete [] ZSLICE;
+	if (PMLN) delete [] PMLN;
 	if (PS1)	delete [] PS1;
 	if (PHIS1)	delete [] PHIS1;
 	if (HYBA)	delete [] HYBA;
@@ -1724,14 +1731,11 @@ int NetCDFCFCollection::DerivedVar_AHSPC::DCZ2(const float*  PS1,
                                                      float** HYPDLN,  // cannot make const...
                                                      float** HYALPH,  // cannot make const...
                                                      float** PTERM,
-                                                     float** ZSLICE){
+                                                     float** ZSLICE,
+                                                     float** PMLN){   // scratch, IDIM x KMAX+1
     // compute midpoint pressure levels (pmln)
     // cz2ccm_dp.f::222
     //float PMLN[IDIM][KMAX+1];
-	float** PMLN = new float*[IDIM];
-	for(size_t i=0; i<IDIM; i++){
-		PMLN[i] = new float[KMAX+1];
-	}
 	for (size_t I=0; I<IMAX; I++) {
         PMLN[I][0] = log( P0*HYBA[1][KMAX-1] + PS1[I]*HYBB[0][KMAX-1]);
         PMLN[I][KMAX]    = log( P0*HYBA[1][0]    + PS1[I]*HYBB[0][0]);
@@ -1794,12 +1798,6 @@ int NetCDFCFCollection::DerivedVar_AHSPC::DCZ2(const float*  PS1,
         }    
     }    
     
-    if (PMLN) {
-		for (size_t i=0; i<IDIM; i++){
-			delete [] PMLN[i];
-		}
-		delete [] PMLN;
-	}
 	return(0);
 }
 
@@ -1814,15 +1812,7 @@ int NetCDFCFCollection::DerivedVar_AHSPC::ReadSlice(
 
     size_t z = nz - _slice_num - 1;
 
-	float summation=0;
-	
-    for (size_t y=0; y<ny; y++) {
-    for (size_t x=0; x<nx; x++) {
-		slice[y*nx + x] = 
-           _Z3[(z*nx*ny) + (nx*y) + (x)];
-    	summation += slice[y*nx+x];
-	}    
-    }    
+	memcpy(slice, _Z3 + z*nx*ny, nx*ny*sizeof(*slice));
     
 	_slice_num++;
     return(1);
@@ -1,8 +1,14 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <utility>
 #include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
 #include <netcdf.h>
+#include <vapor/CFuncs.h>
 #include <vapor/NetCDFCollection.h>
 
 using namespace VAPoR;
@@ -20,31 +26,33 @@ NetCDFCollection::NetCDFCollection() {
 	_ovr_table.clear();
 	_ncdfmap.clear();
 	_failedVars.clear();
-
-
+	_openFiles.clear();
+	_maxOpenFiles = 32;
+	_readAheadSize = 16*1024*1024;
+	_regionBufSize = 8*1024*1024;
+	_lazyInit = false;
+	const char *s = getenv("VAPOR_NC_MANIFEST_DIR");
+	_manifestDir = s ? s : "";
+	_tcvValues.clear();
 }
 NetCDFCollection::~NetCDFCollection() {
 
+	while (_ovr_table.size()) {
+		(void) NetCDFCollection::Close(_ovr_table.begin()->first);
+	}
+
 	map <string, NetCDFSimple *>::iterator itr;
 	for (itr = _ncdfmap.begin(); itr != _ncdfmap.end(); ++itr) {
 		delete itr->second;
 	}
-
-	std::map <int, fileHandle>::iterator itr1;
-	for (itr1 = _ovr_table.begin(); itr1 != _ovr_table.end(); ++itr1) {
-		int fd = itr1->first;
-		(void) NetCDFCollection::Close(fd);
-	}
 }
 
 int NetCDFCollection::Initialize(
 	const vector <string> &files, const vector <string> &time_dimnames, 
 	const vector <string> &time_coordvars
 ) {
-	std::map <int, fileHandle>::iterator itr1;
-	for (itr1 = _ovr_table.begin(); itr1 != _ovr_table.end(); ++itr1) {
-		int fd = itr1->first;
-		(void) NetCDFCollection::Close(fd);
+	while (_ovr_table.size()) {
+		(void) NetCDFCollection::Close(_ovr_table.begin()->first);
 	}
 	
 	_variableList.clear();
@@ -57,26 +65,31 @@ int NetCDFCollection::Initialize(
 		delete itr->second;
 	}
 	_ncdfmap.clear();
+	_openFiles.clear();
+	_dimNames.clear();
+	_dimLens.clear();
+
+	//
+	// Read the header of each file, once
+	//
+	int rc = NetCDFCollection::_InitializeFiles(
+		files, time_dimnames, time_coordvars
+	);
+	if (rc<0) return(-1);
 
 	//
 	// Build a hash table to map a variable's time dimension
 	// to its time coordinates
 	//
 	int file_org; // case 1, 2, 3 (3a or 3b)
-	int rc = NetCDFCollection::_InitializeTimesMap(
+	rc = NetCDFCollection::_InitializeTimesMap(
 		files, time_dimnames, time_coordvars, _timesMap, _times, file_org
 	);
+	_tcvValues.clear();
 	if (rc<0) return(-1);
 		
 	for (int i=0; i<files.size(); i++) {
-		NetCDFSimple *netcdf = new NetCDFSimple();
-		_ncdfmap[files[i]] = netcdf;
-
-		rc = netcdf->Initialize(files[i]);
-		if (rc<0) {
-			SetErrMsg("NetCDFSimple::Initialize(%s)", files[i].c_str());
-			return(-1);
-		}
+		NetCDFSimple *netcdf = _ncdfmap[files[i]];
 
 		//
 		// Get dimension names and lengths 
@@ -722,6 +735,7 @@ int NetCDFCollection::OpenRead(size_t ts, string varname) {
 	);
 	
 	fh._ncdfptr = _ncdfmap[path];
+	_UseFile(fh._ncdfptr);
 	fh._fd = fh._ncdfptr->OpenRead(varinfo);
 	if (fh._fd<0) {
 		SetErrMsg(
@@ -888,6 +902,284 @@ int NetCDFCollection::ReadNative(int *data, int fd) {
 	return(NetCDFCollection::ReadNative(start, count, data, fd));
 }
 
+namespace {
+
+	const string manifestMagic = "VAPORNCMANIFEST1";
+
+	//
+	// How a file of a collection was initialized: not yet known, like the
+	// first file of the collection, or from its own header
+	//
+	enum {
+		fileUnknown = 0,
+		fileLike = 1,
+		fileFull = 2
+	};
+};
+
+//
+// Create and initialize a NetCDFSimple object for each file. With lazy
+// initialization only the first file's header is read in full. The other
+// files are either described by the manifest, or are checked to have the
+// same header as the first one. Files that were checked are only listed
+// in the manifest as like the first file while neither has changed, so
+// the headers of all the files are those read without lazy
+// initialization.
+//
+// The files are read one at a time: the netCDF library isn't thread safe.
+//
+int NetCDFCollection::_InitializeFiles(
+	const vector <string> &files, const vector <string> &time_dimnames,
+	const vector <string> &time_coordvars
+) {
+	_tcvValues.clear();
+
+	vector <int> status(files.size(), fileUnknown);
+	vector <vector <size_t> > dims(files.size());
+	string path;
+	if (_lazyInit && ! _manifestDir.empty()) {
+		path = _ManifestPath(files, time_dimnames, time_coordvars);
+		(void) _ReadManifest(path, files, status, dims);
+	}
+
+	bool dirty = false;
+	NetCDFSimple *like = NULL;
+	for (int i=0; i<files.size(); i++) {
+		if (_ncdfmap.find(files[i]) != _ncdfmap.end()) continue;
+
+		NetCDFSimple *netcdf = new NetCDFSimple();
+		_ncdfmap[files[i]] = netcdf;
+
+		bool known = status[i] != fileUnknown;
+
+		int rc;
+		if (! _lazyInit || ! like || status[i] == fileFull) {
+			rc = netcdf->Initialize(files[i]);
+			status[i] = fileFull;
+		}
+		else {
+			bool enable = EnableErrMsg(false);
+			rc = -1;
+			if (status[i] == fileLike) {
+				rc = netcdf->Initialize(files[i], *like, dims[i]);
+			}
+			if (rc<0) {
+				known = false;
+				rc = netcdf->Initialize(files[i], *like);
+			}
+			(void) EnableErrMsg(enable);
+			status[i] = fileLike;
+			if (rc<0) {
+				SetErrCode(0);
+				rc = netcdf->Initialize(files[i]);
+				status[i] = fileFull;
+			}
+		}
+		if (rc<0) {
+			SetErrMsg("NetCDFSimple::Initialize(%s)", files[i].c_str());
+			return(-1);
+		}
+		if (! like) like = netcdf;
+
+		if (_lazyInit && ! known) {
+			_ReadTimeCoords(files[i], time_coordvars);
+			dirty = true;
+		}
+	}
+
+	if (dirty && ! path.empty()) _WriteManifest(path, files, status);
+	return(0);
+}
+
+//
+// Read the time coordinate variables of a file into _tcvValues, and close
+// the file. Variables that can't be read are left for
+// _InitializeTimesMapCase3() to report.
+//
+void NetCDFCollection::_ReadTimeCoords(
+	const string &file, const vector <string> &time_coordvars
+) {
+	NetCDFSimple *netcdf = _ncdfmap[file];
+	const vector <NetCDFSimple::Variable> &variables = netcdf->GetVariables();
+
+	for (int j=0; j<time_coordvars.size(); j++) {
+		int index = _get_var_index(variables, time_coordvars[j]);
+		if (index < 0) continue;
+
+		bool enable = EnableErrMsg(false);
+		float *buf = _Get1DVar(netcdf, variables[index]);
+		(void) EnableErrMsg(enable);
+		if (! buf) {
+			SetErrCode(0);
+			continue;
+		}
+
+		size_t n = netcdf->DimLen(variables[index].GetDimNames()[0]);
+		_tcvValues[file][time_coordvars[j]] = vector <double> (buf, buf+n);
+		delete [] buf;
+	}
+	(void) netcdf->CloseFile();
+}
+
+string NetCDFCollection::_ManifestPath(
+	const vector <string> &files, const vector <string> &time_dimnames,
+	const vector <string> &time_coordvars
+) const {
+	unsigned long long hash = HashInit;
+	for (int i=0; i<files.size(); i++) {
+		hash = HashString(files[i], hash);
+	}
+	hash = HashString("", hash);
+	for (int i=0; i<time_dimnames.size(); i++) {
+		hash = HashString(time_dimnames[i], hash);
+	}
+	hash = HashString("", hash);
+	for (int i=0; i<time_coordvars.size(); i++) {
+		hash = HashString(time_coordvars[i], hash);
+	}
+
+	char name[64];
+	sprintf(name, "manifest_%08x%08x.ncm",
+		(unsigned int) (hash >> 32), (unsigned int) (hash & 0xffffffff)
+	);
+	return(_manifestDir + "/" + name);
+}
+
+//
+// Read a manifest written by _WriteManifest(). The status of each file
+// that hasn't changed since is set, along with its dimension lengths, and
+// its time coordinates are added to _tcvValues. Returns a negative int,
+// and leaves everything unknown, if the manifest is missing, damaged,
+// or the first file has changed.
+//
+int NetCDFCollection::_ReadManifest(
+	const string &path, const vector <string> &files,
+	vector <int> &status, vector <vector <size_t> > &dims
+) {
+	ifstream in(path.c_str());
+	if (! in) return(-1);
+
+	vector <int> mstatus(files.size(), fileUnknown);
+	vector <vector <size_t> > mdims(files.size());
+	map <string, map <string, vector <double> > > mtcvValues;
+
+	string line;
+	if (! getline(in, line) || line != manifestMagic) return(-1);
+
+	size_t nfiles = 0;
+	if (! getline(in, line)) return(-1);
+	istringstream(line) >> nfiles;
+	if (nfiles != files.size()) return(-1);
+
+	for (size_t i=0; i<nfiles; i++) {
+		string stamp, mstamp;
+		if (! getline(in, line) || line != files[i]) return(-1);
+		if (! getline(in, mstamp)) return(-1);
+
+		int fstatus = fileUnknown;
+		size_t ndims = 0;
+		if (! getline(in, line)) return(-1);
+		istringstream iss(line);
+		iss >> fstatus >> ndims;
+		vector <size_t> fdims(ndims);
+		for (size_t d=0; d<ndims; d++) iss >> fdims[d];
+		if (! iss || (fstatus != fileLike && fstatus != fileFull)) return(-1);
+
+		size_t ntcvs = 0;
+		if (! getline(in, line)) return(-1);
+		istringstream(line) >> ntcvs;
+		map <string, vector <double> > tcvs;
+		for (size_t j=0; j<ntcvs; j++) {
+			string name;
+			size_t n = 0;
+			if (! getline(in, name)) return(-1);
+			if (! getline(in, line)) return(-1);
+			istringstream iss(line);
+			iss >> n;
+			vector <double> values(n);
+			for (size_t t=0; t<n; t++) iss >> values[t];
+			if (! iss) return(-1);
+			tcvs[name] = values;
+		}
+
+		bool current = FileStamp(files[i], stamp) == 0 && stamp == mstamp;
+		if (i == 0 && ! current) return(-1);
+		if (! current) continue;
+
+		mstatus[i] = fstatus;
+		mdims[i] = fdims;
+		mtcvValues[files[i]] = tcvs;
+	}
+	if (! getline(in, line) || line != manifestMagic) return(-1);
+
+	status = mstatus;
+	dims = mdims;
+	_tcvValues.insert(mtcvValues.begin(), mtcvValues.end());
+	return(0);
+}
+
+// Failing to write a manifest only costs the next Initialize() a check of
+// each file, so errors are ignored
+//
+void NetCDFCollection::_WriteManifest(
+	const string &path, const vector <string> &files,
+	const vector <int> &status
+) const {
+	ostringstream oss;
+	oss.precision(17);
+	oss << manifestMagic << endl << files.size() << endl;
+	for (int i=0; i<files.size(); i++) {
+		string stamp;
+		if (FileStamp(files[i], stamp) < 0) return;
+		if (files[i].find('\n') != string::npos) return;
+
+		map <string, NetCDFSimple *>::const_iterator itr;
+		itr = _ncdfmap.find(files[i]);
+		vector <string> dimnames;
+		vector <size_t> dims;
+		itr->second->GetDimensions(dimnames, dims);
+
+		oss << files[i] << endl << stamp << endl;
+		oss << status[i] << " " << dims.size();
+		for (int d=0; d<dims.size(); d++) oss << " " << dims[d];
+		oss << endl;
+
+		map <string, map <string, vector <double> > >::const_iterator fitr;
+		fitr = _tcvValues.find(files[i]);
+		if (fitr == _tcvValues.end()) {
+			oss << 0 << endl;
+			continue;
+		}
+		oss << fitr->second.size() << endl;
+		map <string, vector <double> >::const_iterator titr;
+		for (titr = fitr->second.begin(); titr != fitr->second.end(); ++titr) {
+			if (titr->first.find('\n') != string::npos) return;
+			oss << titr->first << endl << titr->second.size();
+			for (int t=0; t<titr->second.size(); t++) {
+				oss << " " << titr->second[t];
+			}
+			oss << endl;
+		}
+	}
+	oss << manifestMagic << endl;
+
+	(void) MkDirHier(_manifestDir);
+
+	string tmppath = path + ".tmp";
+	ofstream out(tmppath.c_str());
+	if (! out) return;
+	out << oss.str();
+	out.close();
+	if (! out) {
+		remove(tmppath.c_str());
+		return;
+	}
+#ifdef WIN32
+	remove(path.c_str());	// rename() won't replace on Windows
+#endif
+	if (rename(tmppath.c_str(), path.c_str()) != 0) remove(tmppath.c_str());
+}
+
 int NetCDFCollection::_InitializeTimesMap(
 	const vector <string> &files, const vector <string> &time_dimnames, 
 	const vector <string> &time_coordvars, 
@@ -956,13 +1248,7 @@ int NetCDFCollection::_InitializeTimesMapCase1(
 	//
 
 	for (int i=0; i<files.size(); i++) {
-		NetCDFSimple *netcdf = new NetCDFSimple();
-
-		int rc = netcdf->Initialize(files[i]);
-		if (rc<0) {
-			SetErrMsg("NetCDFSimple::Initialize(%s)", files[i].c_str());
-			return(-1);
-		}
+		NetCDFSimple *netcdf = _ncdfmap.find(files[i])->second;
 
 		const vector <NetCDFSimple::Variable> &variables = netcdf->GetVariables();
 
@@ -987,7 +1273,6 @@ int NetCDFCollection::_InitializeTimesMapCase1(
 
 			currentTime[varname] += 1.0;
 		}
-		delete netcdf;
 	}
 	return(0);
 }
@@ -1009,13 +1294,7 @@ int NetCDFCollection::_InitializeTimesMapCase2(
 	//
 
 	for (int i=0; i<files.size(); i++) {
-		NetCDFSimple *netcdf = new NetCDFSimple();
-
-		int rc = netcdf->Initialize(files[i]);
-		if (rc<0) {
-			SetErrMsg("NetCDFSimple::Initialize(%s)", files[i].c_str());
-			return(-1);
-		}
+		NetCDFSimple *netcdf = _ncdfmap.find(files[i])->second;
 
 		const vector <NetCDFSimple::Variable> &variables = netcdf->GetVariables();
 
@@ -1052,7 +1331,6 @@ int NetCDFCollection::_InitializeTimesMapCase2(
 
 			timesMap[key] = times;
 		}
-		delete netcdf;
 	}
 	return(0);
 }
@@ -1076,10 +1354,10 @@ int NetCDFCollection::_InitializeTimesMapCase3(
 	}
 
 	for (int i=0; i<files.size(); i++) {
-		NetCDFSimple *netcdf = new NetCDFSimple();
+		NetCDFSimple *netcdf = _ncdfmap.find(files[i])->second;
 
-		int rc = netcdf->Initialize(files[i]);
-		if (rc<0) return(-1);
+		map <string, map <string, vector <double> > >::const_iterator fitr;
+		fitr = _tcvValues.find(files[i]);
 
 		const vector <NetCDFSimple::Variable> &variables = netcdf->GetVariables();
 
@@ -1096,24 +1374,37 @@ int NetCDFCollection::_InitializeTimesMapCase3(
 
 			tcvcount[time_coordvars[j]] += 1; 
 
-			// Read TCV
-			float *buf= _Get1DVar(netcdf, variables[index]);
-			if (! buf) {
-				SetErrMsg(	
-					"Failed to read time coordinate variable \"%s\"",
-					time_coordvars[j].c_str()
-				);
-				return(-1);
-			}
-
 			string timedim = variables[index].GetDimNames()[0];
-			size_t timedimlen = netcdf->DimLen(timedim);
 
+			//
+			// Use the TCV values read by _InitializeFiles(), if any.
+			// Otherwise read the TCV
+			//
 			vector <double> times;
-			for (int t=0; t<timedimlen; t++) {
-				times.push_back(buf[t]);
+			map <string, vector <double> >::const_iterator titr;
+			if (fitr != _tcvValues.end() && 
+				(titr = fitr->second.find(time_coordvars[j])) != 
+				fitr->second.end()) {
+
+				times = titr->second;
+			}
+			else {
+				float *buf= _Get1DVar(netcdf, variables[index]);
+				(void) netcdf->CloseFile();
+				if (! buf) {
+					SetErrMsg(	
+						"Failed to read time coordinate variable \"%s\"",
+						time_coordvars[j].c_str()
+					);
+					return(-1);
+				}
+
+				size_t timedimlen = netcdf->DimLen(timedim);
+				for (int t=0; t<timedimlen; t++) {
+					times.push_back(buf[t]);
+				}
+				delete [] buf;
 			}
-			delete [] buf;
 
 			//
 			// The hash key for timesMap is the file plus the
@@ -1136,8 +1427,6 @@ int NetCDFCollection::_InitializeTimesMapCase3(
 				}
 			}
 		}
-
-		delete netcdf;
 	}
 
 	//
@@ -1187,31 +1476,6 @@ void NetCDFCollection::_InterpolateLine(
 	}
 }
 
-void NetCDFCollection::_InterpolateSlice(
-	size_t nx, size_t ny, bool xstag, bool ystag, 
-	bool has_missing, float mv, float *slice
-) const {
-
-	if (xstag) {
-
-		for (int i=0; i<ny; i++) {
-			float *src = slice + (i*nx);
-			float *dst = slice + (i*(nx-1));
-			_InterpolateLine(src, nx, 1, has_missing, mv, dst);
-		}
-		nx--;
-	}
-
-	if (ystag) {
-		for (int i=0; i<nx; i++) {
-			float *src = slice + i;
-			float *dst = slice + i;
-			_InterpolateLine(src, ny, nx, has_missing, mv, dst);
-		}
-		ny--;
-	}
-}
-
 float *NetCDFCollection::_Get1DVar(
 	NetCDFSimple *netcdf, 
 	const NetCDFSimple::Variable &variable
@@ -1231,10 +1495,11 @@ float *NetCDFCollection::_Get1DVar(
 	size_t count[] = {dimlen};
 	float *buf = new float [dimlen];
 	int rc = netcdf->Read(start, count, buf, fd);
+	netcdf->Close(fd);
 	if (rc<0) {
+		delete [] buf;
 		return(NULL);
 	}
-	netcdf->Close(fd);
 	return(buf);
 }
 
@@ -1271,11 +1536,35 @@ int NetCDFCollection::ReadSliceNative(float *data, int fd) {
 
 	if (fh._slice >= nz) return(0);
 
+	//
+	// The slice may have been read ahead
+	//
+	if (fh._slice >= fh._ra_first && fh._slice < fh._ra_first+fh._ra_count) {
+		memcpy(
+			data, fh._rabuf + (fh._slice - fh._ra_first) * nx * ny,
+			sizeof(*data) * nx * ny
+		);
+		fh._last_slice = fh._slice;
+		fh._slice++;
+		return(1);
+	}
+
+	//
+	// Once slices are read in order, read the following ones with
+	// this one
+	//
+	size_t nslices = 1;
+	if (dims.size() > 2 && fh._slice == fh._last_slice + 1) {
+		nslices = _readAheadSize / (sizeof(*data) * nx * ny);
+		if (nslices > nz - fh._slice) nslices = nz - fh._slice;
+	}
+
 	size_t start[] = {0,0,0};
 	size_t count[] = {1,1,1};
 
 	if (dims.size() > 2) {
 		start[0] = fh._slice;
+		count[0] = nslices > 1 ? nslices : 1;
 		count[1] = ny;
 		count[2] = nx;
 	}
@@ -1283,8 +1572,27 @@ int NetCDFCollection::ReadSliceNative(float *data, int fd) {
 		count[0] = ny;
 		count[1] = nx;
 	}
-	
-	int rc = NetCDFCollection::ReadNative(start, count, data, fd);
+
+	int rc;
+	if (nslices > 1) {
+		if (fh._rabufsz < nslices * nx * ny) {
+			if (fh._rabuf) delete [] fh._rabuf;
+			fh._rabuf = new float[nslices * nx * ny];
+			fh._rabufsz = nslices * nx * ny;
+		}
+		fh._ra_count = 0;
+
+		rc = NetCDFCollection::ReadNative(start, count, fh._rabuf, fd);
+		if (rc >= 0) {
+			fh._ra_first = fh._slice;
+			fh._ra_count = nslices;
+			memcpy(data, fh._rabuf, sizeof(*data) * nx * ny);
+		}
+	}
+	else {
+		rc = NetCDFCollection::ReadNative(start, count, data, fd);
+	}
+	fh._last_slice = fh._slice;
 	fh._slice++;
 	if (rc<0) return(rc);
 	return(1);
@@ -1323,96 +1631,37 @@ int NetCDFCollection::ReadSlice(float *data, int fd) {
 	size_t nx = dims[dims.size()-1];
 	size_t ny = dims[dims.size()-2];
 
-	size_t nxus = xstag ? nx-1 : nx;
-	size_t nyus = ystag ? ny-1 : ny;
-
-	if (fh._slicebufsz < (2*nx*ny*sizeof(*data))) {
+	if (fh._slicebufsz < (nx*ny*sizeof(*data))) {
 		if (fh._slicebuf) delete [] fh._slicebuf;
-		fh._slicebuf = (unsigned char *) new float [2*nx*ny];
-		fh._slicebufsz = 2*nx*ny*sizeof(*data);
+		fh._slicebuf = (unsigned char *) new float [nx*ny];
+		fh._slicebufsz = nx*ny*sizeof(*data);
 	}
-
 	float *buffer = (float *) fh._slicebuf;	// cast to float*
-	float *slice1 = buffer;
-	float *slice2 = NULL;
 
-	int firstSlice = 0;	// index of first and second slice read
-	int secondSlice = 1;
 	if (fh._first_slice) {
-		firstSlice = fh._slice;
-		secondSlice = firstSlice + 1;
+		int rc = fh._kernel.Init(
+			nx, ny, xstag, ystag, zstag, 1, 1.0, fh._has_missing, 
+			fh._missing_value
+		);
+		if (rc<0) return(-1);
 		fh._first_slice = false;
 	}
-		
-	if (zstag) {
 
-		//
-		// If this is the first read we read the first slice into
-		// the front (first half) of buffer, and the second into 
-		// the back (second half) of
-		// buffer. For all other reads the previous slice is in
-		// the front of buffer, so we read the current slice into 
-		// the back of buffer
-		//
-		if (fh._slice == firstSlice) {
-			slice1 = buffer;
-			slice2 = buffer + (nxus * nyus);
-		}
-		else {
-			slice1 = buffer + (nxus * nyus);
-			slice2 = buffer;
-		}
-	}
-
-	int rc = NetCDFCollection::ReadSliceNative(slice1, fd);
-	if (rc < 1) return(rc);	// eof or error
-
-	_InterpolateSlice(
-		nx, ny, xstag, ystag, fh._has_missing, fh._missing_value, slice1
-	);
-
-	if (zstag) {
-		// N.B. ReadSliceNative increments fh._slice
-		//
-		if (fh._slice == secondSlice) {	
-			rc = NetCDFCollection::ReadSliceNative(slice2, fd);
-			if (rc < 1) return(rc);	// eof or error
-//			fh._slice--;
-
-			_InterpolateSlice(
-				nx, ny, xstag, ystag, 
-				fh._has_missing, fh._missing_value, slice2
-			);
-		}
-
-		//
-		// At this point the ith slice is in the front of buffer
-		// and the ith+1 slice is in the back of buffer. Moreover,
-		// any horizontal staggering has be taken care of. Hence, the
-		// horizontal dimensions are given by nxus x nyus.
-		//
-		//
-		for (int i=0; i < nxus*nyus; i++) {
-			float *src = buffer + i;
-			float *dst = buffer + i;
-			_InterpolateLine(
-				src, 2, nxus*nyus, fh._has_missing, fh._missing_value, dst
-			);
-		}
-	}
-
-	memcpy(data, buffer, sizeof(*data) * nxus * nyus);
-
-	if (zstag) {
+	//
+	// The kernel interpolates each native slice onto the unstaggered
+	// grid in a single pass, straight into data. If the variable is
+	// staggered along Z the first slice read after opening or seeking 
+	// is only retained, and averaged with the next one.
+	//
+	const float *slices[] = {buffer};
+	int rc;
+	do {
+		rc = NetCDFCollection::ReadSliceNative(buffer, fd);
+		if (rc < 1) return(rc);	// eof or error
 
-		//
-		// move the ith+1 slice to the front of the buffer
-		//
-		memcpy(
-			buffer, buffer+(nxus*nyus), 
-			sizeof(*data) * nxus * nyus
-		);
-	}
+		rc = fh._kernel.Apply(slices, data);
+		if (rc < 0) return(rc);
+	} while (rc == 0);
 
 	return(1);
 }
@@ -1468,11 +1717,88 @@ int NetCDFCollection::Read(size_t start[], size_t count[], float *data, int fd)
         SetErrMsg("Invalid file descriptor : %d", fd);
         return(-1);
     }
-    //fileHandle &fh = itr->second;
+    fileHandle &fh = itr->second;
 
+	if (fh._derived_var) {
+		return(fh._derived_var->ReadRegion(start, count, data, fh._fd));
+	}
 
-	SetErrMsg("Not implemented");
-	return(-1);
+	const TimeVaryingVar &var = fh._tvvars;
+	vector <size_t> dims = var.GetSpatialDims();
+	vector <string> dimnames = var.GetSpatialDimNames();
+
+	if (dims.size() > 3) {
+		SetErrMsg("Only 0D, 1D, 2D and 3D variables supported");
+		return(-1);
+	} 
+	if (dims.size() == 0 || ! IsStaggeredVar(var.GetName())) {
+		return(NetCDFCollection::ReadNative(start, count, data, fd));
+	}
+
+	//
+	// Read the hyperslab on the native grid, extended by one sample 
+	// along each staggered dimension, and interpolate it onto the 
+	// unstaggered grid. Dimensions are padded to 3D, slowest first.
+	//
+	size_t nstart[3] = {0,0,0};
+	size_t ncount[3] = {1,1,1};
+	bool stag[3] = {false, false, false};
+	int offset = 3 - dims.size();
+	for (int i=0; i<dims.size(); i++) {
+		stag[offset+i] = IsStaggeredDim(dimnames[i]);
+		nstart[offset+i] = start[i];
+		ncount[offset+i] = stag[offset+i] ? count[i] + 1 : count[i];
+		if (nstart[offset+i] + ncount[offset+i] > dims[i]) {
+			SetErrMsg("Invalid region");
+			return(-1);
+		}
+	}
+
+	size_t ny = ncount[1];
+	size_t nx = ncount[2];
+	size_t nxus = stag[2] ? nx-1 : nx;
+	size_t nyus = stag[1] ? ny-1 : ny;
+	size_t nzus = stag[0] ? ncount[0]-1 : ncount[0];
+
+	//
+	// The native hyperslab is read a chunk of Z slices at a time, so
+	// that the buffer stays bounded whatever the size of the hyperslab.
+	// Chunks staggered along Z overlap by one native slice.
+	//
+	size_t overlap = stag[0] ? 1 : 0;
+	size_t nzchunk = _regionBufSize / (nx*ny*sizeof(*data));
+	if (nzchunk < overlap+1) nzchunk = overlap+1;
+	if (nzchunk > nzus+overlap) nzchunk = nzus+overlap;
+
+	if (fh._slicebufsz < (nx*ny*nzchunk*sizeof(*data))) {
+		if (fh._slicebuf) delete [] fh._slicebuf;
+		fh._slicebuf = (unsigned char *) new float [nx*ny*nzchunk];
+		fh._slicebufsz = nx*ny*nzchunk*sizeof(*data);
+	}
+	float *buf = (float *) fh._slicebuf;	// cast to float*
+
+	int rc = fh._regionKernel.Init(
+		nx, ny, stag[2], stag[1], stag[0], 1, 1.0, fh._has_missing, 
+		fh._missing_value
+	);
+	if (rc<0) return(-1);
+
+	const float *volumes[] = {buf};
+	size_t cstart[3] = {nstart[0], nstart[1], nstart[2]};
+	size_t ccount[3] = {0, ncount[1], ncount[2]};
+	for (size_t z=0; z<nzus; z+=ccount[0]-overlap) {
+		cstart[0] = nstart[0] + z;
+		ccount[0] = min(nzus-z, nzchunk-overlap) + overlap;
+
+		rc = NetCDFCollection::ReadNative(
+			cstart+offset, ccount+offset, buf, fd
+		);
+		if (rc<0) return(rc);
+
+		data += fh._regionKernel.ApplyVolume(volumes, ccount[0], data) *
+			nxus*nyus;
+	}
+	return(0);
 }
 
 int NetCDFCollection::Read(
@@ -1680,11 +2006,64 @@ int NetCDFCollection::Close(int fd) {
 	int rc = fh._ncdfptr->Close(fh._fd);
 	if (fh._slicebuf) delete [] fh._slicebuf;
 	if (fh._linebuf) delete [] fh._linebuf;
+	if (fh._rabuf) delete [] fh._rabuf;
 
 	_ovr_table.erase(itr);
+
+	_TrimOpenFiles();
 	return(rc);
 }
 
+void NetCDFCollection::SetMaxOpenFiles(size_t n) {
+	_maxOpenFiles = n > 0 ? n : 1;
+	_TrimOpenFiles();
+}
+
+size_t NetCDFCollection::GetNumOpenFiles() const {
+	size_t n = 0;
+	std::list <NetCDFSimple *>::const_iterator itr;
+	for (itr = _openFiles.begin(); itr != _openFiles.end(); ++itr) {
+		if ((*itr)->IsFileOpen()) n++;
+	}
+	return(n);
+}
+
+//
+// Move a file to the most recently used end of the open files, before
+// it is opened (again) by NetCDFSimple::OpenRead(). The file itself is 
+// never closed to make room.
+//
+void NetCDFCollection::_UseFile(NetCDFSimple *netcdf) {
+	_openFiles.remove(netcdf);
+	_openFiles.push_back(netcdf);
+	_TrimOpenFiles(netcdf);
+}
+
+//
+// Close the least recently used files once too many are open. Files
+// with open variables, and the file keep, are skipped.
+//
+void NetCDFCollection::_TrimOpenFiles(const NetCDFSimple *keep) {
+	std::list <NetCDFSimple *>::iterator itr;
+	for (itr = _openFiles.begin(); itr != _openFiles.end(); ) {
+		if (_openFiles.size() <= _maxOpenFiles) break;
+
+		NetCDFSimple *netcdf = *itr;
+		if (netcdf == keep) {
+			++itr;
+		}
+		else if (! netcdf->IsFileOpen()) {
+			itr = _openFiles.erase(itr);
+		}
+		else if (netcdf->GetNumOpenVariables() == 0 && 
+			netcdf->CloseFile() >= 0) {
+
+			itr = _openFiles.erase(itr);
+		}
+		else ++itr;
+	}
+}
+
 namespace VAPoR {
 std::ostream &operator<<(
     std::ostream &o, const NetCDFCollection &ncdfc
@@ -1897,6 +2276,58 @@ bool NetCDFCollection::TimeVaryingVar::GetMissingValue(
 	return(true);
 }
 
+int NetCDFCollection::DerivedVar::ReadRegion(
+	size_t start[], size_t count[], float *region, int fd
+) {
+	vector <size_t> dims = GetSpatialDims();
+	vector <string> dimnames = GetSpatialDimNames();
+
+	if (dims.size() < 2 || dims.size() > 3) {
+		MyBase::SetErrMsg("Only 2D and 3D variables supported");
+		return(-1);
+	}
+
+	//
+	// Dimensions of the slices returned by ReadSlice()
+	//
+	int xdim = dims.size()-1;
+	int ydim = dims.size()-2;
+	size_t nx = dims[xdim];
+	size_t ny = dims[ydim];
+	if (_ncdfc->IsStaggeredDim(dimnames[xdim])) nx--;
+	if (_ncdfc->IsStaggeredDim(dimnames[ydim])) ny--;
+
+	size_t z0 = dims.size() == 3 ? start[0] : 0;
+	size_t nz = dims.size() == 3 ? count[0] : 1;
+
+	if (start[xdim] + count[xdim] > nx || start[ydim] + count[ydim] > ny) {
+		MyBase::SetErrMsg("Invalid region");
+		return(-1);
+	}
+
+	int rc = SeekSlice(z0, 0, fd);
+	if (rc<0) return(rc);
+
+	float *slice = new float[nx*ny];
+	float *ptr = region;
+	for (size_t k=0; k<nz; k++) {
+		rc = ReadSlice(slice, fd);
+		if (rc<1) {
+			if (rc == 0) MyBase::SetErrMsg("Invalid region");
+			rc = -1;
+			break;
+		}
+		for (size_t y=start[ydim]; y<start[ydim]+count[ydim]; y++) {
+			memcpy(
+				ptr, slice + y*nx + start[xdim], sizeof(*ptr) * count[xdim]
+			);
+			ptr += count[xdim];
+		}
+	}
+	delete [] slice;
+	return(rc<0 ? rc : 0);
+}
+
 NetCDFCollection::fileHandle::fileHandle() {
 
 	_derived_var = NULL;
@@ -1910,6 +2341,11 @@ NetCDFCollection::fileHandle::fileHandle() {
 	_linebufsz = 0;
 	_has_missing = false;
 	_missing_value = 0.0;
+	_rabuf = NULL;
+	_rabufsz = 0;
+	_ra_first = 0;
+	_ra_count = 0;
+	_last_slice = -2;
 }
 
 namespace VAPoR {
@@ -126,29 +126,117 @@ int NetCDFSimple::Initialize(string path)
 		}
 
 		Variable var(namebuf, dimnames, varid, xtype);
+		rc = _GetVarAtts(ncid, var);
+		if (rc<0) return(-1);
+
+		_variables.push_back(var);
+
+	}
+
+
+	nc_close(ncid);
+	return(0);
+}
 
+int NetCDFSimple::Initialize(string path, const NetCDFSimple &like) {
+	size_t chsz = _chsz;
+	int ncid;
+	int rc = nc__open(path.c_str(), NC_NOWRITE, &chsz, &ncid);
+	if (rc != 0) {
+		SetErrMsg("nc__open(%s,) : %s", path.c_str(), nc_strerror(rc));
+		return(-1);
+	}
+
+	int ndims, nvars;
+	rc = nc_inq_ndims(ncid, &ndims);
+	if (rc == 0) rc = nc_inq_nvars(ncid, &nvars);
+	if (rc != 0) {
+		SetErrMsg("nc_inq(%s) : %s", path.c_str(), nc_strerror(rc));
+		nc_close(ncid);
+		return(-1);
+	}
+
+	bool match = ndims == like._dimnames.size() && 
+		nvars == like._variables.size();
+
+	vector <size_t> dims;
+	for (int i=0; match && i<ndims; i++) {
+		char namebuf[NC_MAX_NAME+1];
+		size_t len;
+		rc = nc_inq_dim(ncid, i, namebuf, &len);
+		if (rc != 0 || like._dimnames[i].compare(namebuf) != 0) match = false;
+		dims.push_back(len);
+	}
+
+	//
+	// The global attributes must be those of \p like
+	//
+	if (match) {
 		vector <pair <string, vector <double> > > flt_atts;
 		vector <pair <string, vector <long> > > int_atts;
 		vector <pair <string, string> > str_atts;
-		rc = _GetAtts(ncid, varid, flt_atts, int_atts, str_atts);
-		if (rc<0) return(-1);
-		
-		for (int i=0; i<flt_atts.size(); i++) {
-			var.SetAtt(flt_atts[i].first, flt_atts[i].second);
+		rc = _GetAtts(ncid, NC_GLOBAL, flt_atts, int_atts, str_atts);
+		if (rc<0 || flt_atts != like._flt_atts || 
+			int_atts != like._int_atts || str_atts != like._str_atts) {
+
+			match = false;
 		}
-		for (int i=0; i<int_atts.size(); i++) {
-			var.SetAtt(int_atts[i].first, int_atts[i].second);
+	}
+
+	//
+	// Variables are read by ID, so each must be where it is in \p like,
+	// with the same attributes
+	//
+	for (int varid=0; match && varid<nvars; varid++) {
+		char namebuf[NC_MAX_NAME+1];
+		nc_type xtype;
+		int vndims;
+		int dimids[NC_MAX_VAR_DIMS];
+		rc = nc_inq_var(ncid, varid, namebuf, &xtype, &vndims, dimids, NULL);
+		if (rc != 0) {
+			match = false;
+			break;
 		}
-		for (int i=0; i<str_atts.size(); i++) {
-			var.SetAtt(str_atts[i].first, str_atts[i].second);
+
+		vector <string> dimnames;
+		for (int i=0; i<vndims; i++) {
+			if (dimids[i] < 0 || dimids[i] >= like._dimnames.size()) break;
+			dimnames.push_back(like._dimnames[dimids[i]]);
 		}
+		Variable var(namebuf, dimnames, varid, xtype);
+		if (dimnames.size() != vndims || _GetVarAtts(ncid, var) < 0 || 
+			! (var == like._variables[varid])) {
 
-		_variables.push_back(var);
+			match = false;
+		}
+	}
+	nc_close(ncid);
 
+	if (! match) {
+		SetErrMsg(
+			"File %s doesn't match %s", path.c_str(), like._path.c_str()
+		);
+		return(-1);
 	}
+	return(Initialize(path, like, dims));
+}
 
+int NetCDFSimple::Initialize(
+	string path, const NetCDFSimple &like, const vector <size_t> &dims
+) {
+	if (dims.size() != like._dims.size()) {
+		SetErrMsg("Invalid dimensions for file %s", path.c_str());
+		return(-1);
+	}
 
-	nc_close(ncid);
+	_dimnames = like._dimnames;
+	_dims = dims;
+	_unlimited_dimnames = like._unlimited_dimnames;
+	_flt_atts = like._flt_atts;
+	_int_atts = like._int_atts;
+	_str_atts = like._str_atts;
+	_variables = like._variables;
+	_path = path;
 	return(0);
 }
 
@@ -267,6 +355,22 @@ int NetCDFSimple::Close(int fd) {
 	return(0);
 }
 
+int NetCDFSimple::CloseFile() {
+	if (_ovr_table.size()) {
+		SetErrMsg("Variables still open : %s", _path.c_str());
+		return(-1);
+	}
+	if (_ncid == -1) return(0);
+
+	int rc = nc_close(_ncid);
+	_ncid = -1;
+	if (rc != 0) {
+		SetErrMsg("nc_close(%s) : %s", _path.c_str(), nc_strerror(rc));
+		return(-1);
+	}
+	return(0);
+}
+
 
 
 void NetCDFSimple::GetDimensions(
@@ -419,6 +523,28 @@ bool NetCDFSimple::IsNCTypeText(int type) {
 }
 
 
+//
+// Read the attributes of a variable into var
+//
+int NetCDFSimple::_GetVarAtts(int ncid, Variable &var) {
+	vector <pair <string, vector <double> > > flt_atts;
+	vector <pair <string, vector <long> > > int_atts;
+	vector <pair <string, string> > str_atts;
+	int rc = _GetAtts(ncid, var.GetVarID(), flt_atts, int_atts, str_atts);
+	if (rc<0) return(-1);
+	
+	for (int i=0; i<flt_atts.size(); i++) {
+		var.SetAtt(flt_atts[i].first, flt_atts[i].second);
+	}
+	for (int i=0; i<int_atts.size(); i++) {
+		var.SetAtt(int_atts[i].first, int_atts[i].second);
+	}
+	for (int i=0; i<str_atts.size(); i++) {
+		var.SetAtt(str_atts[i].first, str_atts[i].second);
+	}
+	return(0);
+}
+
 int NetCDFSimple::_GetAtts(
 	int ncid, int varid,
 	vector <pair <string, vector <double> > > &flt_atts,
@@ -0,0 +1,177 @@
+#include <cstring>
+#include <vapor/SliceKernel.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+namespace {
+
+	//
+	// Average two neighboring samples. The arithmetic matches the
+	// separate interpolation passes this kernel replaces.
+	//
+	inline float average(float a, float b, bool has_missing, float mv) {
+		if (has_missing && (a == mv || b == mv)) return(mv);
+		return(0.5 * (a + b));
+	}
+};
+
+SliceKernel::SliceKernel() {
+	_nx = _ny = _nxus = _nyus = 0;
+	_xstag = _ystag = _zstag = false;
+	_nterms = 0;
+	_divisor = 1.0;
+	_has_missing = false;
+	_mv = 0.0;
+	_primed = false;
+}
+
+int SliceKernel::Init(
+	size_t nx, size_t ny, bool xstag, bool ystag, bool zstag,
+	int nterms, float divisor, bool has_missing, float mv
+) {
+	_nterms = 0;
+	_primed = false;
+
+	if ((xstag && nx < 2) || (ystag && ny < 2) || nx < 1 || ny < 1) {
+		SetErrMsg("Invalid slice dimensions : %dx%d", nx, ny);
+		return(-1);
+	}
+	if (nterms < 1) {
+		SetErrMsg("Invalid number of terms : %d", nterms);
+		return(-1);
+	}
+
+	_nx = nx;
+	_ny = ny;
+	_nxus = xstag ? nx-1 : nx;
+	_nyus = ystag ? ny-1 : ny;
+	_xstag = xstag;
+	_ystag = ystag;
+	_zstag = zstag;
+	_nterms = nterms;
+	_divisor = divisor;
+	_has_missing = has_missing;
+	_mv = mv;
+
+	if (_zstag) _prev.resize(_nterms*_nxus*_nyus);
+	_row.resize(_nxus);
+	return(0);
+}
+
+//
+// Interpolate row y of the output slice from a native slice: along X,
+// then along Y between the X interpolated rows y and y+1
+//
+void SliceKernel::_interpolateRow(
+	const float *src, size_t y, float *row
+) const {
+	const float *src0 = src + y*_nx;
+	const float *src1 = src0 + _nx;
+
+	if (_xstag && _ystag) {
+		for (size_t x=0; x<_nxus; x++) {
+			row[x] = average(
+				average(src0[x], src0[x+1], _has_missing, _mv),
+				average(src1[x], src1[x+1], _has_missing, _mv),
+				_has_missing, _mv
+			);
+		}
+	}
+	else if (_xstag) {
+		for (size_t x=0; x<_nxus; x++) {
+			row[x] = average(src0[x], src0[x+1], _has_missing, _mv);
+		}
+	}
+	else if (_ystag) {
+		for (size_t x=0; x<_nxus; x++) {
+			row[x] = average(src0[x], src1[x], _has_missing, _mv);
+		}
+	}
+	else {
+		memcpy(row, src0, _nxus*sizeof(*row));
+	}
+}
+
+int SliceKernel::Apply(const float *const slices[], float *dst) {
+	if (! _nterms) {
+		SetErrMsg("Kernel not initialized");
+		return(-1);
+	}
+
+	size_t n = _nxus*_nyus;
+
+	if (_zstag && ! _primed) {
+		for (int t=0; t<_nterms; t++) {
+			float *prev = &_prev[t*n];
+			for (size_t y=0; y<_nyus; y++) {
+				_interpolateRow(slices[t], y, prev + y*_nxus);
+			}
+		}
+		_primed = true;
+		return(0);
+	}
+
+	for (size_t y=0; y<_nyus; y++) {
+		float *drow = dst + y*_nxus;
+
+		for (int t=0; t<_nterms; t++) {
+
+			//
+			// The first term is interpolated straight into the output.
+			// Interpolate along Z between the previous and the current
+			// slice, and keep the current one for the next call
+			//
+			float *row = t == 0 ? drow : &_row[0];
+			_interpolateRow(slices[t], y, row);
+			if (_zstag) {
+				float *prev = &_prev[t*n + y*_nxus];
+				for (size_t x=0; x<_nxus; x++) {
+					float v = row[x];
+					row[x] = average(prev[x], v, _has_missing, _mv);
+					prev[x] = v;
+				}
+			}
+
+			if (t == 0) continue;
+
+			if (! _has_missing) {
+				for (size_t x=0; x<_nxus; x++) drow[x] += row[x];
+			}
+			else {
+				for (size_t x=0; x<_nxus; x++) {
+					if (drow[x] == _mv || row[x] == _mv) drow[x] = _mv;
+					else drow[x] += row[x];
+				}
+			}
+		}
+
+		if (_divisor != 1.0) {
+			for (size_t x=0; x<_nxus; x++) {
+				if (_has_missing && drow[x] == _mv) continue;
+				drow[x] /= _divisor;
+			}
+		}
+	}
+	return(1);
+}
+
+size_t SliceKernel::ApplyVolume(
+	const float *const volumes[], size_t nz, float *dst
+) {
+	Reset();
+
+	std::vector <const float *> slices(_nterms);
+	size_t nslices = 0;
+	for (size_t z=0; z<nz; z++) {
+		for (int t=0; t<_nterms; t++) slices[t] = volumes[t] + z*_nx*_ny;
+
+		int rc = Apply(&slices[0], dst);
+		if (rc < 0) break;
+		if (rc == 0) continue;
+
+		dst += _nxus*_nyus;
+		nslices++;
+	}
+	return(nslices);
+}
@@ -9,6 +9,20 @@
 using namespace std;
 using namespace VAPoR;
 
+namespace {
+
+//
+// Index of the last cell found along each dimension by this thread.
+// Hints are checked before they are used, so one set per thread
+// serves every grid.
+//
+#ifdef WIN32
+__declspec(thread) size_t IndexHint[3] = {0,0,0};
+#else
+__thread size_t IndexHint[3] = {0,0,0};
+#endif
+};
+
 StretchedGrid::StretchedGrid(
 	const size_t bs[3],
 	const size_t min[3],
@@ -64,7 +78,6 @@ StretchedGrid::StretchedGrid(
 		_delta[2] = (extents[5] - extents[2])/(double) (_max[2]-_min[2]);
 	}
 	RegularGrid::_SetExtents(_extents);
-
 }
 
 StretchedGrid::StretchedGrid(
@@ -123,7 +136,6 @@ StretchedGrid::StretchedGrid(
 		_delta[2] = (extents[5] - extents[2])/(double) (_max[2]-_min[2]);
 	}
 	RegularGrid::_SetExtents(_extents);
-
 }
 
 
@@ -458,88 +470,77 @@ void StretchedGrid::GetIJKIndexFloor(
 	// Now get indecies for stretched coords not on or outside boundary
 	//
 	if (_xcoords.size() != 0 && ((x-_extents[0]) * (x-_extents[3]) < 0)) {
-		size_t i0 = 0;
-		size_t i1 = dims[0]-1;
-		double x0 = _xcoords[i0];
-		double x1 = _xcoords[i1];
-		while (i1-i0>1) {
-
-			x1 = _xcoords[(i0+i1)>>1];
-			if (x1 == x) {  // pathological case
-				//*i = (i0+i1)>>1;
-				i0 = (i0+i1)>>1;
-				break;
-			}
-
-			// if the signs of differences change then the coordinate
-			// is between x0 and x1
-			//
-			if ((x-x0) * (x-x1) <= 0.0) {
-				i1 = (i0+i1)>>1;
-			}
-			else {
-				i0 = (i0+i1)>>1;
-				x0 = x1;
-			}
-		}
-		*i = i0;
+		*i = _FindIndex(_xcoords, x, &IndexHint[0]);
 	}
 
 	if (_ycoords.size() != 0 && ((y-_extents[1]) * (y-_extents[4]) < 0)) {
-		size_t j0 = 0;
-		size_t j1 = dims[1]-1;
-		double y0 = _ycoords[j0];
-		double y1 = _ycoords[j1];
-		while (j1-j0>1) {
-
-			y1 = _ycoords[(j0+j1)>>1];
-			if (y1 == y) {  // pathological case
-				//*j = (j0+j1)>>1;
-				j0 = (j0+j1)>>1;
-				break;
-			}
+		*j = _FindIndex(_ycoords, y, &IndexHint[1]);
+	}
 
-			// if the signs of differences change then the coordinate
-			// is between y0 and y1
-			//
-			if ((y-y0) * (y-y1) <= 0.0) {
-				j1 = (j0+j1)>>1;
-			}
-			else {
-				j0 = (j0+j1)>>1;
-				y0 = y1;
+	if (_zcoords.size() != 0 && ((z-_extents[2]) * (z-_extents[5]) < 0)) {
+		*k = _FindIndex(_zcoords, z, &IndexHint[2]);
+	}
+}
+
+//
+// Return the index of the cell, along a stretched dimension with 
+// coordinates coords, containing the coordinate c. The coordinate must 
+// lie strictly between the first and last coordinates. 
+//
+size_t StretchedGrid::_FindIndex(
+	const vector <double> &coords, double c, size_t *hint
+) const {
+	size_t i0 = 0;
+	size_t i1 = coords.size()-1;
+	double c0 = coords[i0];
+	double c1;
+
+	//
+	// Try the cell found by the previous search first, then its 
+	// neighbors. Successive lookups (e.g. along a trajectory) usually 
+	// land in the same or an adjacent cell.
+	//
+	size_t h = *hint;
+	if (h < i1) {
+		double s0 = c-c0;
+		if ((c-coords[h]) * s0 > 0.0) {
+			if ((c-coords[h+1]) * s0 < 0.0) return(h);
+			if (h+1 < i1 && (c-coords[h+1]) * s0 > 0.0 && 
+				(c-coords[h+2]) * s0 < 0.0) {
+
+				*hint = h+1;
+				return(h+1);
 			}
 		}
-		*j = j0;
+		else if (h > 0 && (c-coords[h]) * s0 < 0.0 && 
+			(c-coords[h-1]) * s0 > 0.0) {
+
+			*hint = h-1;
+			return(h-1);
+		}
 	}
 
-	if (_zcoords.size() != 0 && ((z-_extents[2]) * (z-_extents[5]) < 0)) {
-		size_t k0 = 0;
-		size_t k1 = dims[2]-1;
-		double z0 = _zcoords[k0];
-		double z1 = _zcoords[k1];
-		while (k1-k0>1) {
-
-			z1 = _zcoords[(k0+k1)>>1];
-			if (z1 == z) {  // pathological case
-				//*k = (k0+k1)>>1;
-				k0 = (k0+k1)>>1;
-				break;
-			}
+	while (i1-i0>1) {
 
-			// if the signs of differences change then the coordinate
-			// is between z0 and z1
-			//
-			if ((z-z0) * (z-z1) <= 0.0) {
-				k1 = (k0+k1)>>1;
-			}
-			else {
-				k0 = (k0+k1)>>1;
-				z0 = z1;
-			}
+		c1 = coords[(i0+i1)>>1];
+		if (c1 == c) {  // pathological case
+			i0 = (i0+i1)>>1;
+			break;
+		}
+
+		// if the signs of differences change then the coordinate
+		// is between c0 and c1
+		//
+		if ((c-c0) * (c-c1) <= 0.0) {
+			i1 = (i0+i1)>>1;
+		}
+		else {
+			i0 = (i0+i1)>>1;
+			c0 = c1;
 		}
-		*k = k0;
 	}
+	*hint = i0;
+	return(i0);
 }
 
 int StretchedGrid::Reshape(
@@ -4,6 +4,7 @@
 #include <sstream>
 #include <sys/stat.h>
 #include <cstdlib>
+#include <cstdio>
 #include <cfloat>
 #ifdef WIN32
 #include <windows.h>
@@ -171,6 +172,7 @@ int WaveCodecIO::_WaveCodecIO(int nthreads) {
 	_methodTimer = 0.0;
 	_methodThreadTimer = 0.0;
 	_ioMPI = 0.0;
+	_flushTimer = 0.0;
 
 
 	//
@@ -480,6 +482,19 @@ int WaveCodecIO::OpenVariableWrite(
 		return(-1);
 	}
 
+	//
+	// Summary of the blocks written, saved by CloseVariable(). Remove
+	// any existing summary now; it will no longer match the data.
+	//
+	size_t bs[3], bs_p[3], bdim[3], bdim_p[3];
+	size_t bmin_p[3] = {0, 0, 0};
+	GetBlockSize(bs, -1);
+	Metadata::GetDimBlk(bdim, -1);
+	VDFIOBase::_PackCoord(_vtype, bs, bs_p, 1);
+	VDFIOBase::_PackCoord(_vtype, bdim, bdim_p, 1);
+	_summary.Init(bs_p, bmin_p, bdim_p);
+	(void) remove((basename + ".bsum").c_str());
+
 
 	int rc = _OpenVarWrite(basename);
 	if (rc<0) {
@@ -510,6 +525,7 @@ int WaveCodecIO::CloseVariable() {
 
 	for (int j=0; j<_ncbufs.size(); j++) {
 		int rc = _ncbufs[j]->Flush();
+		_flushTimer += _ncbufs[j]->GetFlushTimer();
 		NC_ERR_WRITE(rc, _ncpaths[j]);
 		delete _ncbufs[j];
 	}
@@ -613,6 +629,26 @@ SetDiagMsg("@MPI validreg min: %d %d %d, max: %d %d %d",_validRegMin[0],_validRe
 	}
 #endif
 	_WriteTimerStop();
+
+#ifndef PARALLEL
+#ifndef NOIO
+	//
+	// A missing summary only costs a data read later on, so failure
+	// to write it is not an error
+	//
+	if (_writeMode) {
+		string path = GetBlockSummaryPath(_timeStep, _varName);
+		size_t dim[3], dim_p[3];
+		Metadata::GetDim(dim, -1);
+		VDFIOBase::_PackCoord(_vtype, dim, dim_p, 1);
+		bool enable = EnableErrMsg(false);
+		_summary.SetSource(dim_p, GetDataFingerprint(_timeStep, _varName));
+		if (! path.empty()) (void) _summary.Write(path);
+		EnableErrMsg(enable);
+		SetErrCode(0);
+	}
+#endif
+#endif
 				
 	_isOpen = false;
     _vtype = VARUNKNOWN;
@@ -1011,6 +1047,20 @@ int WaveCodecIO::BlockWriteRegion(
 		if (v > _dataRange[1]) _dataRange[1] = v;
 		delete _rw_thread_objs[t];
 	}
+
+	//
+	// The blocks were compressed while the NCBufs wrote earlier blocks in
+	// the background. Those writes must complete before returning: the
+	// caller may make netCDF calls of its own, and the netCDF library
+	// isn't thread safe.
+	//
+	_WriteTimerStart();
+	for (int j=0; j<_ncbufs.size(); j++) {
+		int rc = _ncbufs[j]->Wait();
+		NC_ERR_WRITE(rc, _ncpaths[j]);
+	}
+	_WriteTimerStop();
+
 	_methodTimer += (MPI_Wtime() - starttime);
 
 	return(_threadStatus);
@@ -1146,6 +1196,18 @@ void WaveCodecIO::ReadWriteThreadObj::BlockWriteRegionThread() {
 		bool valid_data = true;
 		_wc->_MaskRemove(blockptr, valid_data);
 
+		//
+		// Block statistics for the summary only include voxels inside
+		// the volume, padded or not
+		//
+		size_t xvalid = xbdry ? _bs_p[0] - (_bdim_p[0]*_bs_p[0] - _dim_p[0]) : _bs_p[0];
+		size_t yvalid = ybdry ? _bs_p[1] - (_bdim_p[1]*_bs_p[1] - _dim_p[1]) : _bs_p[1];
+		size_t zvalid = zbdry ? _bs_p[2] - (_bdim_p[2]*_bs_p[2] - _dim_p[2]) : _bs_p[2];
+		float bmin = FLT_MAX;
+		float bmax = -FLT_MAX;
+		double bsum = 0.0;
+		size_t bcount = 0;
+
 		if (valid_data) {
 			for (int z = 0; z<_bs_p[2]; z++) {
 			for (int y = 0; y<_bs_p[1]; y++) {
@@ -1157,16 +1219,28 @@ void WaveCodecIO::ReadWriteThreadObj::BlockWriteRegionThread() {
 				if (isnan(v)) {
 #endif
 					blockptr[_bs_p[0]*_bs_p[1]*z + _bs_p[0]*y + x] = 0.0;
+					continue;
 				}
 
 				if (v < _dataRange[0]) _dataRange[0] = v;
 				if (v > _dataRange[1]) _dataRange[1] = v;
 
+				if (x < xvalid && y < yvalid && z < zvalid) {
+					if (v < bmin) bmin = v;
+					if (v > bmax) bmax = v;
+					bsum += v;
+					bcount++;
+				}
 			}
 			}
 			}
 		}
 
+		size_t bcoord[3] = {(size_t) bx, (size_t) by, (size_t) bz};
+		_wc->_summary.SetBlock(
+			bcoord, bmin, bmax, bcount ? bsum / (double) bcount : 0.0, bcount
+		);
+
 
 		double starttime = MPI_Wtime();
 		if (_id==0) _wc->_XFormTimerStart();
@@ -1723,6 +1797,28 @@ int    WaveCodecIO::VariableExists(
 }
 
 
+string WaveCodecIO::GetBlockSummaryPath(
+	size_t ts, const string &varname
+) const {
+	string basename;
+	if (ConstructFullVBase(ts, varname, &basename) < 0) return("");
+	return(basename + ".bsum");
+}
+
+unsigned long long WaveCodecIO::GetDataFingerprint(
+	size_t ts, const string &varname
+) const {
+	string basename;
+	if (ConstructFullVBase(ts, varname, &basename) < 0) return(0);
+
+	//
+	// Every level of detail is rewritten with the variable, so the
+	// first file alone identifies the data
+	//
+	vector <string> paths(1, basename + ".nc0");
+	return(VetsUtil::FileFingerprint(paths));
+}
+
 int WaveCodecIO::GetNumTransforms() const {
 
 	size_t ntotal = _compressor3D->GetNumWaveCoeffs();
@@ -8,9 +8,11 @@
 #include <sstream>
 #include <ctime>
 #include <cassert>
+#include <cstdlib>
 #include <netcdf.h>
 #include <vapor/CFuncs.h>
 #include <vapor/OptionParser.h>
+#include <vapor/EasyThreads.h>
 #include <vapor/WeightTable.h>	
 
 #ifdef _WINDOWS 
@@ -21,6 +23,52 @@
 using namespace VAPoR;
 using namespace VetsUtil;
 
+namespace VAPoR {
+
+	// thread helper function
+	//
+	void	*RunWeightTableThread(void *object) {
+		WeightTable::ThreadObj *X = (WeightTable::ThreadObj *) object;
+		X->RunThread();
+		return(0);
+	}
+};
+
+namespace {
+
+	//
+	// Cache file header. All values are in native byte order; the byte
+	// order mark is used to reject files written on a machine with
+	// a different order.
+	//
+	const char weightsMagic[8] = {'V','D','C','W','G','H','T','1'};
+	const unsigned int byteOrderMark = 0x01020304;
+
+	typedef struct {
+		char magic[8];
+		unsigned int byteOrder;
+		int nx, ny;
+		float lonLatExtents[4];
+		unsigned long long hash;
+	} header_t;
+};
+
+string WeightTable::_cacheDir;
+bool WeightTable::_cacheDirSet = false;
+
+void WeightTable::SetCacheDir(const string &dir) {
+	_cacheDir = dir;
+	_cacheDirSet = true;
+}
+
+string WeightTable::GetCacheDir() {
+	if (! _cacheDirSet) {
+		const char *s = getenv("VAPOR_WEIGHT_CACHE");
+		return(s ? s : "");
+	}
+	return(_cacheDir);
+}
+
 WeightTable::WeightTable(
 	const float *geo_lat, const float *geo_lon, 
 	int ny, int nx,
@@ -42,6 +90,9 @@ WeightTable::WeightTable(
 	_testValues = new float[nx*ny];
 	_cornerLons = new int[nx*ny];
 	_cornerLats = new int[nx*ny];
+	_gatherLons = new int[4*nx*ny];
+	_gatherLats = new int[2*nx*ny];
+	_gatherCoefs = new float[4*nx*ny];
 
 	for (int i = 0; i<nx*ny; i++){
 		_testValues[i] = 1.e30f;
@@ -70,7 +121,15 @@ WeightTable::WeightTable(
 	// Calc epsilon for checking outside rectangle
 	_epsRect = Max(_deltaLat,_deltaLon)*0.1;
 
-	calcWeights();
+	_hash = 0;
+	string path = _cachePath();
+	if (path.empty() || _readCache(path) < 0) {
+		calcWeights();
+		if (! path.empty()) _writeCache(path);
+	}
+	else {
+		_makeGather();
+	}
 }
 
 WeightTable::~WeightTable() {
@@ -79,6 +138,9 @@ WeightTable::~WeightTable() {
 	if (_testValues) delete [] _testValues;
 	if (_cornerLons) delete [] _cornerLons;
 	if (_cornerLats) delete [] _cornerLats;
+	if (_gatherLons) delete [] _gatherLons;
+	if (_gatherLats) delete [] _gatherLats;
+	if (_gatherCoefs) delete [] _gatherCoefs;
 	if (_geo_lat) delete [] _geo_lat;
 	if (_geo_lon) delete [] _geo_lon;
 }
@@ -88,75 +150,141 @@ WeightTable::~WeightTable() {
 //Following can also be used on slices of 3D data
 //If the corner latitude is at the top then
 void WeightTable::interp2D(const float* sourceData, float* resultData, float srcMV, float dstMV, const size_t* dims){
+	assert (dims[1] <= _ny && dims[0] <= _nx);
+
+	size_t smin[2] = {0, 0};
+	size_t smax[2] = {(size_t) _nx-1, (size_t) _ny-1};
+	size_t min[2] = {0, 0};
+	size_t max[2] = {dims[0]-1, dims[1]-1};
+	interp2D(sourceData, smin, smax, resultData, min, max, srcMV, dstMV);
+}
+
+//Look up the user grid vertices of the four corners used to interpolate the lon/lat vertex (i,j)
+void WeightTable::_corners(int i, int j, int lons[4], int lats[4]) const {
 	int corlon, corlat, corlatp, corlona, corlonb, corlonp;
-	
-	int latsize = dims[1];
-	int lonsize = dims[0];
-	float minin = sourceData[0];
-	float maxin = sourceData[0];
-	assert (latsize <= _ny && lonsize <= _nx);
-	for (int i = 0; i< _ny*_nx; i++){
-		if (sourceData[i] == srcMV) continue;
-		if (sourceData[i]<minin) minin = sourceData[i];
-		if (sourceData[i]>maxin) maxin = sourceData[i];
+
+	corlon = _cornerLons[i+_nx*j];//Lookup the user grid vertex lowerleft corner that contains (i,j) lon-lat vertex
+	corlat = _cornerLats[i+_nx*j];//corlon and corlat are not lon and lat, just x and y 
+	corlatp = corlat+1;
+	corlona = corlon;
+	corlonb = corlon+1;
+	corlonp = corlon+1;
+	if (MOMBased && corlon == _nx-1){ //Wrap-around longitude.  Note that longitude will not wrap at zipper.
+		corlonp = 0;
+		corlonb = 0;
+	} else if (MOMBased && corlat == _ny-1){ //Get corners on opposite side of zipper:
+		corlatp = corlat;
+		corlona = _nx - corlon -1;
+		corlonb = _nx - corlon -2;
 	}
+	lons[0] = corlon; lats[0] = corlat;
+	lons[1] = corlonp; lats[1] = corlat;
+	lons[2] = corlonb; lats[2] = corlatp;
+	lons[3] = corlona; lats[3] = corlatp;
+}
+
+//Precompute, for every lon/lat vertex, the corners of _corners() and the coefficients of their values, so that interp2D
+//is a gather without branches
+void WeightTable::_makeGather() {
+	int lons[4], lats[4];
+	for (int j = 0; j<_ny; j++){
+		for (int i = 0; i<_nx; i++){
+			size_t v = i+_nx*j;
+			if(_testValues[v] >= 1.) {
+				for (int k = 0; k<4; k++) {
+					_gatherLons[4*v+k] = 0;
+					_gatherCoefs[4*v+k] = 0.f;
+				}
+				_gatherLats[2*v] = _gatherLats[2*v+1] = 0;
+				continue;
+			}
+			_corners(i, j, lons, lats);
+			for (int k = 0; k<4; k++) _gatherLons[4*v+k] = lons[k];
+			//Corners 0 and 1, and corners 2 and 3, share their latitude
+			_gatherLats[2*v] = lats[0];
+			_gatherLats[2*v+1] = lats[2];
+
+			float alpha = _alphas[v];
+			float beta = _betas[v];
+			_gatherCoefs[4*v] = (1.-alpha)*(1.-beta);
+			_gatherCoefs[4*v+1] = alpha*(1.-beta);
+			_gatherCoefs[4*v+2] = alpha*beta;
+			_gatherCoefs[4*v+3] = (1.-alpha)*beta;
+		}
+	}
+}
+
+void WeightTable::sourceRegion(const size_t min[2], const size_t max[2], size_t smin[2], size_t smax[2]) const {
+	smin[0] = _nx-1; smin[1] = _ny-1;
+	smax[0] = 0; smax[1] = 0;
+	bool empty = true;
+	for (size_t j = min[1]; j<=max[1]; j++){
+		for (size_t i = min[0]; i<=max[0]; i++){
+			size_t v = i+_nx*j;
+			if(_testValues[v] >= 1.) continue;
+			const int *lons = _gatherLons + 4*v;
+			const int *lats = _gatherLats + 2*v;
+			for (int k = 0; k<4; k++){
+				if (lons[k] < smin[0]) smin[0] = lons[k];
+				if (lons[k] > smax[0]) smax[0] = lons[k];
+			}
+			for (int k = 0; k<2; k++){
+				if (lats[k] < smin[1]) smin[1] = lats[k];
+				if (lats[k] > smax[1]) smax[1] = lats[k];
+			}
+			empty = false;
+		}
+	}
+	//Every vertex of the region lies outside of the mapping; any source sample will do
+	if (empty) {
+		smin[0] = smax[0] = 0;
+		smin[1] = smax[1] = 0;
+	}
+}
+
+void WeightTable::interp2D(
+	const float* sourceData, const size_t smin[2], const size_t smax[2], 
+	float* resultData, const size_t min[2], const size_t max[2],
+	float srcMV, float dstMV
+) {
+	int snx = smax[0]-smin[0]+1;
+	int sminx = smin[0];
+	int sminy = smin[1];
+	size_t lonsize = max[0]-min[0]+1;
 	
-	for (int j = 0; j<latsize; j++){
-		for (int i = 0; i<lonsize; i++){
-			if(_testValues[i+_nx*j] >= 1.)  {
+	for (size_t j = min[1]; j<=max[1]; j++){
+		float *result = resultData + (j-min[1])*lonsize;
+		for (size_t i = min[0]; i<=max[0]; i++){
+			size_t v = i+_nx*j;
+			if(_testValues[v] >= 1.)  {
 				//Outside of range of mapping.  Provide missing value:
-				resultData[i+j*lonsize] = dstMV;
+				result[i-min[0]] = dstMV;
 				continue;
 			}
-			corlon = _cornerLons[i+_nx*j];//Lookup the user grid vertex lowerleft corner that contains (i,j) lon-lat vertex
-			corlat = _cornerLats[i+_nx*j];//corlon and corlat are not lon and lat, just x and y 
-			corlatp = corlat+1;
-			corlona = corlon;
-			corlonb = corlon+1;
-			corlonp = corlon+1;
-			if (MOMBased && corlon == _nx-1){ //Wrap-around longitude.  Note that longitude will not wrap at zipper.
-				corlonp = 0;
-				corlonb = 0;
-			} else if (MOMBased && corlat == _ny-1){ //Get corners on opposite side of zipper:
-				corlatp = corlat;
-				corlona = _nx - corlon -1;
-				corlonb = _nx - corlon -2;
-			}
-			float alpha = _alphas[i+_nx*j];
-			float beta = _betas[i+_nx*j];
-			float data0 = sourceData[corlon+_nx*corlat];
-			float data1 = sourceData[corlonp+_nx*corlat];
-			float data2 = sourceData[corlonb+_nx*corlatp];
-			float data3 = sourceData[corlona+_nx*corlatp];
+			const int *lons = _gatherLons + 4*v;
+			const int *lats = _gatherLats + 2*v;
+			const float *cf = _gatherCoefs + 4*v;
+			int row0 = snx*(lats[0]-sminy) - sminx;
+			int row1 = snx*(lats[1]-sminy) - sminx;
+			float data[4];
+			data[0] = sourceData[row0+lons[0]];
+			data[1] = sourceData[row0+lons[1]];
+			data[2] = sourceData[row1+lons[2]];
+			data[3] = sourceData[row1+lons[3]];
 			
-			float cf0 = (1.-alpha)*(1.-beta);
-			float cf1 = alpha*(1.-beta);
-			float cf2 = alpha*beta;
-			float cf3 = (1.-alpha)*beta;
-			float goodSum = 0.f;
-			float mvCoef = 0.f;
 			//Accumulate values and coefficients for missing and non-missing values
 			//If less than half the weight comes from missing value, then apply weights to non-missing values,
 			//otherwise just set result to missing value.
-			if (data0 == srcMV) mvCoef += cf0;
-			else {
-				goodSum += cf0*data0;
-			}
-			if (data1 == srcMV) mvCoef += cf1;
-			else {
-				goodSum += cf1*data1;
-			}
-			if (data2 == srcMV) mvCoef += cf2;
-			else {
-				goodSum += cf2*data2;
-			}
-			if (data3 == srcMV) mvCoef += cf3;
-			else {
-				goodSum += cf3*data3;
+			float goodSum = 0.f;
+			float mvCoef = 0.f;
+			for (int k = 0; k<4; k++){
+				bool missing = data[k] == srcMV;
+				mvCoef += missing ? cf[k] : 0.f;
+				goodSum += missing ? 0.f : cf[k]*data[k];
 			}
-			if (mvCoef >= 0.5f) resultData[i+j*lonsize] = dstMV;
+			if (mvCoef >= 0.5f) result[i-min[0]] = dstMV;
 			else {
-				resultData[i+j*lonsize] = goodSum/(1.-mvCoef);
+				result[i-min[0]] = goodSum/(1.-mvCoef);
 			}
 			
 		}
@@ -239,15 +367,39 @@ float WeightTable::bestLatLonPolar(int ilon, int ilat){
 	
 int WeightTable::calcWeights(){
 	
-	float eps = Max(_deltaLat,_deltaLon)*1.e-3;
-
 	//Check out the geolat, geolon variables
 	for (int i = 0; i<_nx*_ny; i++){
 		assert (_geo_lat[i] >= -90. && _geo_lat[i] <= 90.);
 		assert (_geo_lon[i] >= -360. && _geo_lon[i] <= 360.);
 	}
+
+	int nthreads = EasyThreads::NProc();
+	if (nthreads > _ny) nthreads = _ny;
+	EasyThreads et(nthreads);
+	nthreads = et.GetNumThreads();
+	if (nthreads < 1) nthreads = 1;
+
+	std::vector <ThreadObj *> objs;
+	for (int t=0; t<nthreads; t++) objs.push_back(new ThreadObj(this, t, nthreads));
+
+	int rc = 0;
+	if (nthreads <= 1) {
+		objs[0]->RunThread();
+	}
+	else {
+		rc = et.ParRun(RunWeightTableThread, (void **) &objs[0]);
+	}
+	for (int t=0; t<nthreads; t++) delete objs[t];
+	if (rc < 0) return rc;
+
+	_makeGather();
+	return 0;
+}
+
+void WeightTable::_calcWeights(int id, int nthreads){
 	
-	
+	float eps = Max(_deltaLat,_deltaLon)*1.e-3;
+
 	//	Loop over (_nx/_ny) user grid vertices.  These are x and y grid vertex indices
 	//  Call them ulat and ulon to suggest "lat and lon" in user coordinates
 	float lat[4],lon[4];
@@ -320,7 +472,9 @@ int WeightTable::calcWeights(){
 				}
 						
 				//Loop over all the lon/lat grid vertices in the maximized cell:
-				for (int qlat = latInd0; qlat<= latInd1; qlat++){
+				//Only the rows of this thread
+				int qlat0 = latInd0 + ((id-latInd0)%nthreads + nthreads)%nthreads;
+				for (int qlat = qlat0; qlat<= latInd1; qlat+=nthreads){
 					for (int plon = lonInd0; plon<= lonInd1; plon++){
 						
 						int plon1 = plon;
@@ -506,7 +660,8 @@ int WeightTable::calcWeights(){
 				if (latMax > _ny-1) latMax = _ny-1;
 				
 				//Test each point in lon/lat interval:
-				for (int qlat = latMin; qlat<= latMax; qlat++){
+				int qlat0 = latMin + ((id-latMin)%nthreads + nthreads)%nthreads;
+				for (int qlat = qlat0; qlat<= latMax; qlat+=nthreads){
 					for (int plon = lonMin; plon<= lonMax; plon++){
 						
 						float testLon = _lonLatExtents[0]+plon*_deltaLon;
@@ -567,8 +722,92 @@ int WeightTable::calcWeights(){
 		}
 	}
 #endif
-	return 0;				
 }
+string WeightTable::_cachePath() {
+	string dir = GetCacheDir();
+	if (dir.empty()) return("");
+
+	_hash = HashBytes(&_nx, sizeof(_nx));
+	_hash = HashBytes(&_ny, sizeof(_ny), _hash);
+	_hash = HashBytes(_lonLatExtents, sizeof(_lonLatExtents), _hash);
+	_hash = HashBytes(_geo_lat, sizeof(float)*_nx*_ny, _hash);
+	_hash = HashBytes(_geo_lon, sizeof(float)*_nx*_ny, _hash);
+
+	char name[64];
+	sprintf(name, "weights_%08x%08x.wgt",
+		(unsigned int) (_hash >> 32), (unsigned int) (_hash & 0xffffffff)
+	);
+	return(dir + "/" + name);
+}
+
+//Read the weights of a table written by _writeCache().  Returns a negative int if the file is missing or was written for
+//another grid.
+int WeightTable::_readCache(const string &path) {
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (! fp) return(-1);
+
+	header_t header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+		memcmp(header.magic, weightsMagic, sizeof(header.magic)) == 0 &&
+		header.byteOrder == byteOrderMark &&
+		header.nx == _nx && header.ny == _ny &&
+		memcmp(header.lonLatExtents, _lonLatExtents, sizeof(_lonLatExtents)) == 0 &&
+		header.hash == _hash;
+
+	size_t n = _nx*_ny;
+	ok = ok && fread(_alphas, sizeof(float), n, fp) == n;
+	ok = ok && fread(_betas, sizeof(float), n, fp) == n;
+	ok = ok && fread(_testValues, sizeof(float), n, fp) == n;
+	ok = ok && fread(_cornerLons, sizeof(int), n, fp) == n;
+	ok = ok && fread(_cornerLats, sizeof(int), n, fp) == n;
+	fclose(fp);
+
+	if (! ok) {
+		for (size_t i = 0; i<n; i++){
+			_testValues[i] = 1.e30f;
+			_alphas[i] = - 1.f;
+			_betas[i] = -1.f;
+		}
+		return(-1);
+	}
+	return(0);
+}
+
+//The file is written under a temporary name and renamed, so readers never see a partial table
+void WeightTable::_writeCache(const string &path) const {
+	(void) MkDirHier(GetCacheDir());
+
+	header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, weightsMagic, sizeof(header.magic));
+	header.byteOrder = byteOrderMark;
+	header.nx = _nx;
+	header.ny = _ny;
+	memcpy(header.lonLatExtents, _lonLatExtents, sizeof(_lonLatExtents));
+	header.hash = _hash;
+
+	string tmppath = path + ".tmp";
+	FILE *fp = fopen(tmppath.c_str(), "wb");
+	if (! fp) return;
+
+	size_t n = _nx*_ny;
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && fwrite(_alphas, sizeof(float), n, fp) == n;
+	ok = ok && fwrite(_betas, sizeof(float), n, fp) == n;
+	ok = ok && fwrite(_testValues, sizeof(float), n, fp) == n;
+	ok = ok && fwrite(_cornerLons, sizeof(int), n, fp) == n;
+	ok = ok && fwrite(_cornerLats, sizeof(int), n, fp) == n;
+	if (fclose(fp) != 0) ok = false;
+
+	if (ok) {
+#ifdef WIN32
+		remove(path.c_str());	// rename() won't replace on Windows
+#endif
+		ok = rename(tmppath.c_str(), path.c_str()) == 0;
+	}
+	if (! ok) remove(tmppath.c_str());
+}
+
 float WeightTable::testInQuad(float plon, float plat, int ilon, int ilat){
 	//Sides of quad are determined by lines thru the 4 points at user grid corners:
 	//(ilon,ilat), (ilon+1,ilat), (ilon+1,ilat+1), (ilon,ilat+1)
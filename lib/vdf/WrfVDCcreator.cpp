@@ -28,6 +28,7 @@ Wrf2vdf::Wrf2vdf() {
         _level = 0;
         _lod = 0;
         _nthreads = 0;
+        _lazy = false;
         _help = false;
         _quiet = false;
         _debug = false;
@@ -282,6 +283,9 @@ int	Wrf2vdf::launchWrf2Vdf(int argc, char **argv, DCReaderWRF *optionalReader) {
         	{"lod", 1,  "-1",   "Compression levels saved. 0 => coarsest, 1 => "
                 "next refinement, etc. -1 => all levels defined by the .vdf file"},
         	{"nthreads",1,  "0",    "Number of execution threads (0 => # processors)"},
+        	{"lazy",        0,      "",     "Read the full header of the first WRF "
+                "file only, and check that the others have the same header. "
+                "Speeds up runs of many files"},
         	{"help",        0,      "",     "Print this message and exit"},
         	{"quiet",       0,      "",     "Operate quietly"},
 	        {"debug",       0,      "",     "Turn on debugging"},
@@ -295,6 +299,7 @@ int	Wrf2vdf::launchWrf2Vdf(int argc, char **argv, DCReaderWRF *optionalReader) {
         	{"level", VetsUtil::CvtToInt, &_level, sizeof(_level)},
         	{"lod", VetsUtil::CvtToInt, &_lod, sizeof(_lod)},
         	{"nthreads", VetsUtil::CvtToInt, &_nthreads, sizeof(_nthreads)},
+        	{"lazy", VetsUtil::CvtToBoolean, &_lazy, sizeof(_lazy)},
         	{"help", VetsUtil::CvtToBoolean, &_help, sizeof(_help)},
         	{"quiet", VetsUtil::CvtToBoolean, &_quiet, sizeof(_quiet)},
         	{"debug", VetsUtil::CvtToBoolean, &_debug, sizeof(_debug)},
@@ -346,7 +351,7 @@ int	Wrf2vdf::launchWrf2Vdf(int argc, char **argv, DCReaderWRF *optionalReader) {
 		wcwriter = NULL;
 	}
 	if (wrfData == NULL){
-		wrfData = new DCReaderWRF(ncdffiles);
+		wrfData = new DCReaderWRF(ncdffiles, _lazy);
 	}
 
 	if (MyBase::GetErrCode() != 0) return -1;
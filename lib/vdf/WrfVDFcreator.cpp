@@ -31,6 +31,7 @@ wrfvdfcreate::wrfvdfcreate() {
 	_help = false;
 	_quiet = false;
 	_debug = false;
+	_lazy = false;
 }
 
 wrfvdfcreate::~wrfvdfcreate() {
@@ -247,6 +248,11 @@ int	wrfvdfcreate::launchVdfCreate(int argc, char **argv) {
 	        "Generate a VDC Type 2 .vdf file (default is VDC Type 1)"
 	    },
 	    {"append",  0,  "", "Append WRF files to an existing .vdfd"},
+	    {
+	        "lazy", 0,  "",
+	        "Read the full header of the first WRF file only, and check that "
+	        "the others have the same header. Speeds up runs of many files"
+	    },
 	    {"help",    0,  "", "Print this message and exit"},
 	    {"quiet",   0,  "", "Operate quietly"},
 	    {"debug",   0,  "", "Turn on debugging"},
@@ -258,6 +264,7 @@ int	wrfvdfcreate::launchVdfCreate(int argc, char **argv) {
 	    {"dervars", VetsUtil::CvtToStrVec, &_dervars, sizeof(_dervars)},
 	    {"vdc2", VetsUtil::CvtToBoolean, &_vdc2, sizeof(_vdc2)},
 	    {"append", VetsUtil::CvtToBoolean, &_append, sizeof(_append)},
+	    {"lazy", VetsUtil::CvtToBoolean, &_lazy, sizeof(_lazy)},
 	    {"help", VetsUtil::CvtToBoolean, &_help, sizeof(_help)},
 	    {"quiet", VetsUtil::CvtToBoolean, &_quiet, sizeof(_quiet)},
 	    {"debug", VetsUtil::CvtToBoolean, &_debug, sizeof(_debug)},
@@ -341,7 +348,7 @@ int	wrfvdfcreate::launchVdfCreate(int argc, char **argv) {
 		 ncdffiles.push_back(argv[i]);
 	}
 	
-	wrfData = new DCReaderWRF(ncdffiles);
+	wrfData = new DCReaderWRF(ncdffiles, _lazy);
 	if (MyBase::GetErrCode() != 0) return (-1);
 
 	if(wrfData->GetNumTimeSteps() < 0) {
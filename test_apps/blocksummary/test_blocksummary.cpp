@@ -0,0 +1,346 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/BlockSummary.h>
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for BlockSummary: summarizes a grid with missing
+// values whose origin is not block aligned, and checks block and region
+// ranges, and a summary file round trip, against brute force. Also checks
+// that damaged summary files are rejected.
+//
+
+struct {
+	int	dim;
+	int	bs;
+	char *file;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"75",	"Grid dimension along each axis"},
+	{"bs",		1, 	"16",	"Summary block size"},
+	{"file",	1, 	"test_blocksummary.bsum",	"Summary file to write"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"bs", VetsUtil::CvtToInt, &opt.bs, sizeof(opt.bs)},
+	{"file", VetsUtil::CvtToString, &opt.file, sizeof(opt.file)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float value(double, double, double) {
+	float v = (float) (rand() % 20001 - 10000) * 0.01;
+	if (rand() % 17 == 0) v = MissingValue;
+	return(v);
+}
+
+//
+// Grid with storage blocks of 32, starting at voxel (5,7,3)
+//
+RegularGrid *make_grid(int dim, vector <float *> &storage) {
+	size_t min[3] = {5, 7, 3};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	return(MakeTestGrid(
+		dim, min, extents, value, NULL, &MissingValue, storage
+	));
+}
+
+//
+// Brute force range of the valid values in a region, in global voxel
+// coordinates
+//
+bool brute_range(
+	const RegularGrid *rg, const size_t min[3], const size_t max[3],
+	float range[2], double *sum, size_t *count
+) {
+	size_t origin[3], dims[3];
+	rg->GetIJKOrigin(origin);
+	rg->GetDimensions(dims);
+
+	range[0] = FLT_MAX;
+	range[1] = -FLT_MAX;
+	*sum = 0.0;
+	*count = 0;
+	for (size_t k=min[2]; k<=max[2]; k++) {
+	for (size_t j=min[1]; j<=max[1]; j++) {
+	for (size_t i=min[0]; i<=max[0]; i++) {
+		if (i < origin[0] || j < origin[1] || k < origin[2]) continue;
+		if (i >= origin[0]+dims[0] || j >= origin[1]+dims[1] ||
+			k >= origin[2]+dims[2]) continue;
+
+		float v = rg->AccessIJK(i-origin[0], j-origin[1], k-origin[2]);
+		if (v == MissingValue) continue;
+		if (v < range[0]) range[0] = v;
+		if (v > range[1]) range[1] = v;
+		*sum += v;
+		(*count)++;
+	}
+	}
+	}
+	return(*count != 0);
+}
+
+int check_blocks(const BlockSummary &summary, const RegularGrid *rg) {
+	size_t bs[3], bmin[3], bdim[3];
+	summary.GetBlockSize(bs);
+	summary.GetBlockMin(bmin);
+	summary.GetBlockDims(bdim);
+
+	int nerrors = 0;
+	for (size_t bz=bmin[2]; bz<bmin[2]+bdim[2]; bz++) {
+	for (size_t by=bmin[1]; by<bmin[1]+bdim[1]; by++) {
+	for (size_t bx=bmin[0]; bx<bmin[0]+bdim[0]; bx++) {
+		size_t bcoord[3] = {bx, by, bz};
+		size_t min[3], max[3];
+		for (int i=0; i<3; i++) {
+			min[i] = bcoord[i] * bs[i];
+			max[i] = min[i] + bs[i] - 1;
+		}
+		float r0[2], r1[2], mean;
+		double sum;
+		size_t count0, count1;
+		bool ok0 = brute_range(rg, min, max, r0, &sum, &count0);
+		bool ok1 = summary.GetBlock(bcoord, r1, &mean, &count1);
+
+		if (ok0 != ok1 || (ok0 && (r0[0] != r1[0] || r0[1] != r1[1] ||
+			count0 != count1 || fabs(sum/count0 - mean) > 1e-3))) {
+
+			if (nerrors < 10) {
+				cerr << "Block (" << bx << "," << by << "," << bz << 
+					") mismatch" << endl;
+			}
+			nerrors++;
+		}
+	}
+	}
+	}
+	return(nerrors);
+}
+
+int check_regions(const BlockSummary &summary, const RegularGrid *rg) {
+	size_t origin[3], dims[3];
+	rg->GetIJKOrigin(origin);
+	rg->GetDimensions(dims);
+
+	int nerrors = 0;
+	for (int n=0; n<50; n++) {
+		size_t min[3], max[3];
+		for (int i=0; i<3; i++) {
+			size_t a = origin[i] + rand() % dims[i];
+			size_t b = origin[i] + rand() % dims[i];
+			min[i] = a < b ? a : b;
+			max[i] = a < b ? b : a;
+		}
+		float r0[2], r1[2];
+		double sum;
+		size_t count;
+		bool ok0 = brute_range(rg, min, max, r0, &sum, &count);
+		bool ok1 = summary.GetRange(min, max, r1);
+
+		//
+		// The summary's range must contain the true range
+		//
+		if (ok0 && (! ok1 || r1[0] > r0[0] || r1[1] < r0[1])) {
+			cerr << "Region " << n << " range not conservative" << endl;
+			nerrors++;
+		}
+	}
+
+	float r0[2], r1[2];
+	double sum;
+	size_t count;
+	size_t min[3] = {0, 0, 0};
+	size_t max[3] = {
+		origin[0]+dims[0]-1, origin[1]+dims[1]-1, origin[2]+dims[2]-1
+	};
+	brute_range(rg, min, max, r0, &sum, &count);
+	summary.GetRange(r1);
+	if (r0[0] != r1[0] || r0[1] != r1[1] || summary.GetCount() != count ||
+		fabs(summary.GetMean() - sum/count) > 1e-3) {
+
+		cerr << "Volume range, mean, or count mismatch" << endl;
+		nerrors++;
+	}
+	return(nerrors);
+}
+
+//
+// Write a summary file, changed by edit(), and make sure Read() rejects it
+//
+int check_rejected(
+	const BlockSummary &summary, const char *file, const char *what,
+	void (*edit)(vector <unsigned char> &bytes)
+) {
+	if (summary.Write(file) < 0) return(1);
+
+	vector <unsigned char> bytes;
+	FILE *fp = fopen(file, "rb");
+	if (! fp) return(1);
+	int c;
+	while ((c = fgetc(fp)) != EOF) bytes.push_back((unsigned char) c);
+	fclose(fp);
+
+	edit(bytes);
+
+	fp = fopen(file, "wb");
+	if (! fp) return(1);
+	if (bytes.size()) fwrite(&bytes[0], 1, bytes.size(), fp);
+	fclose(fp);
+
+	BlockSummary copy;
+	bool enable = MyBase::EnableErrMsg(false);
+	int rc = copy.Read(file);
+	MyBase::EnableErrMsg(enable);
+	MyBase::SetErrCode(0);
+	if (rc >= 0) {
+		cerr << "Read() accepted a " << what << " summary file" << endl;
+		return(1);
+	}
+	return(0);
+}
+
+//
+// Header offsets: magic (8), byte order (4), bs, bmin, bdim (3x4 each),
+// volume dimensions (3x8) and fingerprint (8)
+//
+void truncate_file(vector <unsigned char> &bytes) {
+	bytes.pop_back();
+}
+
+void extend_file(vector <unsigned char> &bytes) {
+	bytes.push_back(0);
+}
+
+void zero_block_size(vector <unsigned char> &bytes) {
+	for (int i=12; i<16; i++) bytes[i] = 0;
+}
+
+void grow_block_dims(vector <unsigned char> &bytes) {
+	bytes[36+3] = 0x40;	// bdim[0] of about a billion
+}
+
+void shrink_volume(vector <unsigned char> &bytes) {
+	for (int i=48; i<56; i++) bytes[i] = 0;
+	bytes[48] = 1;	// volume one voxel wide
+}
+
+int check_invalid(const BlockSummary &summary, const char *file) {
+	int nerrors = 0;
+	nerrors += check_rejected(summary, file, "truncated", truncate_file);
+	nerrors += check_rejected(summary, file, "extended", extend_file);
+	nerrors += check_rejected(summary, file, "zero block size", zero_block_size);
+	nerrors += check_rejected(summary, file, "oversized", grow_block_dims);
+	nerrors += check_rejected(summary, file, "misfit", shrink_volume);
+	return(nerrors);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	vector <float *> storage;
+	RegularGrid *rg = make_grid(opt.dim, storage);
+
+	size_t bs[3] = {(size_t) opt.bs, (size_t) opt.bs, (size_t) opt.bs};
+	BlockSummary summary;
+
+	double t0 = GetTime();
+	summary.Compute(rg, bs);
+	double t1 = GetTime();
+	cout << "Summarized " << summary.GetNumBlocks() << " blocks in " <<
+		t1-t0 << " seconds" << endl;
+
+	int nerrors = check_blocks(summary, rg);
+	nerrors += check_regions(summary, rg);
+
+	size_t origin[3], dims[3], vdims[3];
+	rg->GetIJKOrigin(origin);
+	rg->GetDimensions(dims);
+	for (int i=0; i<3; i++) vdims[i] = origin[i] + dims[i];
+	summary.SetSource(vdims, 0x0123456789abcdefULL);
+
+	BlockSummary copy;
+	if (summary.Write(opt.file) < 0 || copy.Read(opt.file) < 0) exit(1);
+	nerrors += check_blocks(copy, rg);
+
+	size_t cdims[3];
+	copy.GetDims(cdims);
+	if (cdims[0] != vdims[0] || cdims[1] != vdims[1] ||
+		cdims[2] != vdims[2] || copy.GetFingerprint() != 0x0123456789abcdefULL) {
+
+		cerr << "Summary file dimensions or fingerprint mismatch" << endl;
+		nerrors++;
+	}
+
+	//
+	// Rewriting a file must change its fingerprint
+	//
+	vector <string> paths(1, string(opt.file));
+	unsigned long long fp0 = FileFingerprint(paths);
+	FILE *fp = fopen(opt.file, "ab");
+	if (fp) {
+		fputc(0, fp);
+		fclose(fp);
+	}
+	if (FileFingerprint(paths) == fp0) {
+		cerr << "File fingerprint unchanged" << endl;
+		nerrors++;
+	}
+
+	nerrors += check_invalid(summary, opt.file);
+	remove(opt.file);
+
+	delete rg;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
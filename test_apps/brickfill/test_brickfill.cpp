@@ -0,0 +1,297 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/LayeredGrid.h>
+#include "BrickFiller.h"
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for BrickFiller: fills texture bricks
+// from a synthetic volume with missing values and compares them with
+// bricks filled a voxel at a time, the way TextureBrick used to. No
+// OpenGL context is needed.
+//
+
+struct {
+	int	dim;
+	int	brick;
+	int	nthreads;
+	int	loop;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"100",	"Grid dimension along each axis"},
+	{"brick",	1, 	"64",	"Brick dimension along each axis"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"loop",	1, 	"3",	"Number of times each brick is filled"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"brick", VetsUtil::CvtToInt, &opt.brick, sizeof(opt.brick)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"loop", VetsUtil::CvtToInt, &opt.loop, sizeof(opt.loop)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float value(double x, double y, double z) {
+	float v = sin(6.0*x) * cos(4.0*y) + z;
+	if (rand() % 13 == 0) v = MissingValue;
+	return(v);
+}
+
+// terrain following coordinate
+//
+double terrain(double x, double y, double z) {
+	double t = 0.1 * sin(3.0*x) * sin(5.0*y);
+	return(t + z * (1.0 - t));
+}
+
+//
+// Grid whose origin, (3,5,7), is not block aligned
+//
+RegularGrid *make_grid(int dim, bool layered, vector <float *> &storage) {
+	size_t min[3] = {3,5,7};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	return(MakeTestGrid(
+		dim, min, extents, value, layered ? terrain : NULL, &MissingValue,
+		storage
+	));
+}
+
+unsigned int quantize(float v, const float range[2], unsigned int qmax) {
+	if (v<range[0]) return(0);
+	if (v>range[1]) return(qmax);
+	return((unsigned int) rint((v-range[0])/(range[1]-range[0]) * qmax));
+}
+
+void put(unsigned char *ucptr, int szcomp, unsigned int qv) {
+	ucptr[0] = (unsigned char) (qv & 0xff);
+	if (szcomp == 2) ucptr[1] = (unsigned char) ((qv >> 8) & 0xff);
+}
+
+//
+// Voxel at a time reference, TextureBrick::copytex() before BrickFiller
+//
+void fill_reference(
+	const RegularGrid *rg, const float range[2], int szcomp, int ncomp,
+	bool missing, bool layered, float zscale, unsigned char *data,
+	int bx, int by, int bz, int dnx, int dny, int dnz,
+	int xoffset, int yoffset, int zoffset
+) {
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	double extents[6];
+	rg->GetUserExtents(extents);
+	float mv = rg->GetMissingValue();
+	unsigned int qmax = szcomp == 1 ? 255 : 65535;
+	size_t step = szcomp * ncomp;
+
+	bool dense = xoffset == 0 && yoffset == 0 && zoffset == 0 &&
+		dims[0]<=bx && dims[1]<=by && dims[2]<= bz;
+	int nx = dense ? dims[0] : (bx < dnx ? bx : dnx);
+	int ny = dense ? dims[1] : (by < dny ? by : dny);
+	int nz = dense ? dims[2] : (bz < dnz ? bz : dnz);
+	size_t rowStride = dense ? dims[0] : bx;
+	size_t slabStride = dense ? dims[0]*dims[1] : bx*by;
+
+	for (int z=0; z<nz; z++) {
+	for (int y=0; y<ny; y++) {
+	unsigned char *ucptr = data + (z*slabStride + y*rowStride)*step;
+	for (int x=0; x<nx; x++) {
+		float v = rg->AccessIJK(x+xoffset,y+yoffset,z+zoffset);
+
+		int c = 0;
+		put(ucptr + c*szcomp, szcomp, quantize(v, range, qmax));
+		c++;
+		if (missing) {
+			put(ucptr + c*szcomp, szcomp, v == mv ? qmax : 0);
+			c++;
+		}
+		if (layered) {
+			double x_f, y_f, z_f;
+			(void) rg->GetUserCoordinates(
+				x+xoffset,y+yoffset,z+zoffset,&x_f, &y_f, &z_f
+			);
+			unsigned int qv = (unsigned int) rint(
+				(z_f-extents[2])/(extents[5]-extents[2]) * zscale * qmax
+			);
+			put(ucptr + c*szcomp, szcomp, qv);
+		}
+		ucptr += step;
+	}
+	}
+	}
+}
+
+//
+// Fill every brick of the grid with both the reference and the filler,
+// and compare them
+//
+int test_fill(
+	const RegularGrid *rg, BrickFiller &filler, int szcomp, bool aux, int b
+) {
+	bool missing = aux && rg->HasMissingData();
+	bool layered = aux && dynamic_cast<const LayeredGrid *>(rg);
+	int ncomp = 2 + (missing ? 1 : 0) + (layered ? 1 : 0);
+	float zscale = 0.75;
+	float range[2] = {-0.5, 1.5};
+
+	if (filler.SetFormat(szcomp, ncomp, missing, layered, zscale) < 0) {
+		return(-1);
+	}
+
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	size_t size = (size_t) b*b*b*szcomp*ncomp;
+	vector <unsigned char> reference(size), bricks(size);
+
+	double rtime = 0.0;
+	double ftime = 0.0;
+	int rc = 0;
+	for (int zo = 0; zo < dims[2]; zo += b) {
+	for (int yo = 0; yo < dims[1]; yo += b) {
+	for (int xo = 0; xo < dims[0]; xo += b) {
+
+		// Bricks overlap by a voxel, as DVRTexture3d's do
+		//
+		int dnx = dims[0] - xo + 1;
+		int dny = dims[1] - yo + 1;
+		int dnz = dims[2] - zo + 1;
+
+		memset(&reference[0], 0x55, size);
+		memset(&bricks[0], 0x55, size);
+
+		double t0 = GetTime();
+		fill_reference(
+			rg, range, szcomp, ncomp, missing, layered, zscale,
+			&reference[0], b, b, b, dnx, dny, dnz, xo, yo, zo
+		);
+		rtime += GetTime() - t0;
+
+		for (int l=0; l<opt.loop; l++) {
+			t0 = GetTime();
+			if (filler.Fill(
+				rg, range, &bricks[0], b, b, b, dnx, dny, dnz, xo, yo, zo
+			) < 0) return(-1);
+			ftime += (GetTime() - t0) / opt.loop;
+		}
+
+		if (bricks != reference) {
+			cerr << ProgName << " : brick at (" << xo << "," << yo << "," <<
+				zo << ") differs from reference" << endl;
+			rc = -1;
+		}
+	}
+	}
+	}
+
+	double nvoxels = (double) dims[0]*dims[1]*dims[2];
+	cout << szcomp*8 << " bit, " << ncomp << " components : reference " <<
+		nvoxels / rtime * 1.0e-6 << " Mvoxel/s, BrickFiller (" <<
+		filler.GetNumThreads() << " threads) " <<
+		nvoxels / ftime * 1.0e-6 << " Mvoxel/s" << endl;
+
+	return(rc);
+}
+
+int test_hash(RegularGrid *rg, BrickFiller &filler) {
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	int b = dims[0];
+	float range[2] = {0.0, 1.0};
+
+	filler.SetFormat(1, 1);
+	vector <unsigned char> brick(b*b*b);
+	filler.Fill(rg, range, &brick[0], b, b, b, b, b, b);
+	unsigned long long h0 = filler.GetHash();
+
+	int rc = 0;
+	filler.Hash(rg, b, b, b, b, b, b);
+	if (filler.GetHash() != h0) rc = -1;
+
+	float v = rg->AccessIJK(1,2,3);
+	rg->AccessIJK(1,2,3) = v + 1.0;
+	filler.Hash(rg, b, b, b, b, b, b);
+	if (filler.GetHash() == h0) rc = -1;
+
+	rg->AccessIJK(1,2,3) = v;
+	filler.Hash(rg, b, b, b, b, b, b);
+	if (filler.GetHash() != h0) rc = -1;
+
+	if (rc < 0) cerr << ProgName << " : brick hash failed" << endl;
+	return(rc);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	BrickFiller filler(opt.nthreads);
+
+	int rc = 0;
+	for (int layered = 0; layered < 2; layered++) {
+		vector <float *> storage;
+		RegularGrid *rg = make_grid(opt.dim, layered, storage);
+		cout << (layered ? "Layered" : "Regular") << " grid" << endl;
+
+		for (int szcomp = 1; szcomp <= 2; szcomp++) {
+			for (int aux = 0; aux < 2; aux++) {
+
+				// A single brick holding the whole grid, and bricks
+				// smaller than the grid
+				//
+				if (test_fill(rg, filler, szcomp, aux, opt.dim) < 0) rc = 1;
+				if (test_fill(rg, filler, szcomp, aux, opt.brick) < 0) rc = 1;
+			}
+		}
+		if (test_hash(rg, filler) < 0) rc = 1;
+
+		delete rg;
+		for (int i=0; i<storage.size(); i++) delete [] storage[i];
+	}
+
+	exit(rc);
+}
@@ -0,0 +1,431 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include "BrickLOD.h"
+#include "BrickCache.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for BrickLOD and BrickCache: selects the
+// bricks of a large multiresolution volume from a few views, checks that
+// they tile the visible part of the region, that the bricks nearer the
+// eye are finer, and that the bricks drawn never overlap whatever bricks
+// are available. Checks the LRU eviction of the brick cache. Reports the
+// cost of a selection, and the fraction of the full resolution voxels
+// the selected bricks hold. No OpenGL context is needed.
+//
+
+struct {
+	int	dim;
+	int	reflevel;
+	int	brick;
+	float	error;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"2048",	"Volume dimension along each axis, at the finest level"},
+	{"reflevel",1, 	"4",	"Finest refinement level"},
+	{"brick",	1, 	"64",	"Brick dimension"},
+	{"error",	1, 	"1.0",	"Pixels a voxel may project to"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"reflevel", VetsUtil::CvtToInt, &opt.reflevel, sizeof(opt.reflevel)},
+	{"brick", VetsUtil::CvtToInt, &opt.brick, sizeof(opt.brick)},
+	{"error", VetsUtil::CvtToFloat, &opt.error, sizeof(opt.error)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// A camera at (x,y,z) looking down the -Z axis (or +Z if back is true)
+// with a 30 degree field of view
+//
+void make_view(
+	double x, double y, double z, bool back,
+	double modelview[16], double projection[16], int viewport[4]
+) {
+	for (int i=0; i<16; i++) modelview[i] = projection[i] = 0.0;
+
+	double s = back ? -1.0 : 1.0;
+	modelview[0] = s;
+	modelview[5] = 1.0;
+	modelview[10] = s;
+	modelview[15] = 1.0;
+	modelview[12] = -s * x;
+	modelview[13] = -y;
+	modelview[14] = -s * z;
+
+	double near = 0.01, far = 100.0;
+	double f = 1.0 / tan(15.0 * M_PI / 180.0);
+	projection[0] = f;
+	projection[5] = f;
+	projection[10] = (far + near) / (near - far);
+	projection[11] = -1.0;
+	projection[14] = 2.0 * far * near / (near - far);
+
+	viewport[0] = viewport[1] = 0;
+	viewport[2] = viewport[3] = 1024;
+}
+
+double volume(const double e[6]) {
+	return((e[3]-e[0]) * (e[4]-e[1]) * (e[5]-e[2]));
+}
+
+double overlap(const double a[6], const double b[6]) {
+	double v = 1.0;
+	for (int i=0; i<3; i++) {
+		double lo = a[i] > b[i] ? a[i] : b[i];
+		double hi = a[i+3] < b[i+3] ? a[i+3] : b[i+3];
+		if (hi <= lo) return(0.0);
+		v *= hi - lo;
+	}
+	return(v);
+}
+
+//
+// Check that bricks don't overlap, and return the volume they cover
+//
+double check_tiling(
+	const BrickLOD &lod, const vector <int> &nodes, const char *what
+) {
+	double total = 0.0;
+	double overlaps = 0.0;
+	for (int i=0; i<nodes.size(); i++) {
+		const BrickLOD::brick_t &a = lod.GetNode(nodes[i]);
+		total += volume(a.extents);
+		for (int j=i+1; j<nodes.size(); j++) {
+			overlaps += overlap(a.extents, lod.GetNode(nodes[j]).extents);
+		}
+	}
+	if (overlaps > 1e-9) {
+		cerr << ProgName << " : " << what << " bricks overlap" << endl;
+		return(-1.0);
+	}
+	return(total);
+}
+
+int test_select(BrickLOD &lod, const double extents[6]) {
+	double modelview[16], projection[16];
+	int viewport[4];
+	int rc = 0;
+	double region = volume(extents);
+
+	//
+	// The whole volume in view, close to its front face
+	//
+	make_view(0.5, 0.5, 4.0, false, modelview, projection, viewport);
+	lod.Select(modelview, projection, viewport, opt.error, 100000);
+	const vector <int> &selected = lod.GetSelected();
+
+	double covered = check_tiling(lod, selected, "selected");
+	if (covered < 0.0) return(-1);
+	if (fabs(covered - region) > 1e-6 * region) {
+		cerr << ProgName << " : selected bricks cover " << covered <<
+			" of " << region << endl;
+		rc = -1;
+	}
+
+	//
+	// Bricks not at the finest level meet the error bound, and the
+	// selection is ordered coarsest first
+	//
+	int nearLevel = -1, farLevel = -1;
+	for (int i=0; i<selected.size(); i++) {
+		const BrickLOD::brick_t &b = lod.GetNode(selected[i]);
+		if (b.reflevel < lod.GetMaxRefLevel() && b.error > opt.error) {
+			cerr << ProgName << " : brick not refined enough" << endl;
+			rc = -1;
+		}
+		if (i && b.reflevel < lod.GetNode(selected[i-1]).reflevel) {
+			cerr << ProgName << " : selection not coarsest first" << endl;
+			rc = -1;
+		}
+		if (b.extents[5] >= extents[5] && b.reflevel > nearLevel) {
+			nearLevel = b.reflevel;
+		}
+		if (b.extents[2] <= extents[2] && (farLevel < 0 || b.reflevel < farLevel)) {
+			farLevel = b.reflevel;
+		}
+	}
+	if (nearLevel <= farLevel) {
+		cerr << ProgName << " : near bricks (level " << nearLevel <<
+			") not finer than far ones (level " << farLevel << ")" << endl;
+		rc = -1;
+	}
+
+	//
+	// A budget on the number of bricks is met
+	//
+	size_t budget = selected.size() / 4;
+	lod.Select(modelview, projection, viewport, opt.error, budget);
+	if (lod.GetSelected().size() > budget) {
+		cerr << ProgName << " : brick budget exceeded" << endl;
+		rc = -1;
+	}
+	covered = check_tiling(lod, lod.GetSelected(), "budgeted");
+	if (fabs(covered - region) > 1e-6 * region) {
+		cerr << ProgName << " : budgeted bricks don't cover the region" << endl;
+		rc = -1;
+	}
+
+	//
+	// Nothing is selected looking away from the volume
+	//
+	make_view(0.5, 0.5, 4.0, true, modelview, projection, viewport);
+	lod.Select(modelview, projection, viewport, opt.error, 100000);
+	if (lod.GetSelected().size() != 0) {
+		cerr << ProgName << " : bricks behind the eye selected" << endl;
+		rc = -1;
+	}
+
+	//
+	// From inside the volume only part of it is selected
+	//
+	make_view(0.5, 0.5, 0.6, false, modelview, projection, viewport);
+	lod.Select(modelview, projection, viewport, opt.error, 100000);
+	covered = check_tiling(lod, lod.GetSelected(), "inner");
+	if (covered < 0.0 || covered >= region) {
+		cerr << ProgName << " : bricks outside the view selected" << endl;
+		rc = -1;
+	}
+
+	return(rc);
+}
+
+int test_resolve(BrickLOD &lod, const double extents[6]) {
+	double modelview[16], projection[16];
+	int viewport[4];
+	int rc = 0;
+	double region = volume(extents);
+
+	make_view(0.5, 0.5, 4.0, false, modelview, projection, viewport);
+	lod.Select(modelview, projection, viewport, opt.error, 100000);
+	const vector <int> &selected = lod.GetSelected();
+	int nnodes = lod.GetNumNodes();
+
+	//
+	// Everything available: the selection is drawn
+	//
+	vector <bool> available(nnodes, true);
+	vector <int> drawable;
+	if (! lod.Resolve(available, drawable) || drawable.size() != selected.size()) {
+		cerr << ProgName << " : selection not drawn" << endl;
+		rc = -1;
+	}
+
+	//
+	// Only the roots available: the roots are drawn
+	//
+	for (int n=0; n<nnodes; n++) {
+		available[n] = lod.GetNode(n).reflevel == lod.GetNode(0).reflevel;
+	}
+	if (lod.Resolve(available, drawable)) {
+		cerr << ProgName << " : incomplete refinement not reported" << endl;
+		rc = -1;
+	}
+	for (int i=0; i<drawable.size(); i++) {
+		if (lod.GetNode(drawable[i]).reflevel != lod.GetNode(0).reflevel) {
+			cerr << ProgName << " : unavailable brick drawn" << endl;
+			rc = -1;
+			break;
+		}
+	}
+
+	//
+	// Random availability, as when streaming: the bricks drawn are
+	// available, cover the region, and don't overlap
+	//
+	srand(1);
+	for (int trial=0; trial<20; trial++) {
+		for (int n=0; n<nnodes; n++) {
+			const BrickLOD::brick_t &b = lod.GetNode(n);
+			available[n] = b.reflevel == lod.GetNode(0).reflevel ||
+				rand() % 100 < 70;
+		}
+		lod.Resolve(available, drawable);
+		for (int i=0; i<drawable.size(); i++) {
+			if (! available[drawable[i]]) {
+				cerr << ProgName << " : unavailable brick drawn" << endl;
+				return(-1);
+			}
+		}
+		double covered = check_tiling(lod, drawable, "drawable");
+		if (covered < 0.0) return(-1);
+		if (fabs(covered - region) > 1e-6 * region) {
+			cerr << ProgName << " : drawable bricks cover " << covered <<
+				" of " << region << endl;
+			return(-1);
+		}
+	}
+
+	return(rc);
+}
+
+//
+// The cache holds ints, and counts the ones released
+//
+int nreleased = 0;
+void release(void *brick) {
+	nreleased++;
+	delete (int *) brick;
+}
+
+int test_cache() {
+	int rc = 0;
+	BrickCache cache(1000, release);
+
+	size_t min[3] = {0, 0, 0};
+	size_t max[3] = {64, 64, 64};
+	for (int i=0; i<10; i++) {
+		min[0] = i * 64;
+		cache.Put(2, min, max, new int(i), 100);
+	}
+	if (cache.GetSize() != 10 || cache.GetBytes() != 1000 || nreleased) {
+		cerr << ProgName << " : cache not filled" << endl;
+		rc = -1;
+	}
+
+	//
+	// Touch the oldest brick: the next one is evicted instead
+	//
+	min[0] = 0;
+	int *b = (int *) cache.Get(2, min, max);
+	if (! b || *b != 0) {
+		cerr << ProgName << " : brick not found" << endl;
+		rc = -1;
+	}
+	min[0] = 640;
+	cache.Put(2, min, max, new int(10), 100);
+	min[0] = 64;
+	if (cache.Contains(2, min, max) || nreleased != 1) {
+		cerr << ProgName << " : least recently used brick not evicted" << endl;
+		rc = -1;
+	}
+	min[0] = 0;
+	if (! cache.Contains(2, min, max)) {
+		cerr << ProgName << " : recently used brick evicted" << endl;
+		rc = -1;
+	}
+	if (cache.Get(3, min, max)) {
+		cerr << ProgName << " : bricks of different levels confused" << endl;
+		rc = -1;
+	}
+
+	//
+	// Replacing a brick releases the old one. Shrinking the cache evicts.
+	//
+	cache.Put(2, min, max, new int(11), 300);
+	if (nreleased != 4 || cache.GetBytes() > 1000) {
+		cerr << ProgName << " : replaced brick not released" << endl;
+		rc = -1;
+	}
+	cache.SetMaxBytes(300);
+	if (cache.GetSize() != 1 || *(int *) cache.Get(2, min, max) != 11) {
+		cerr << ProgName << " : cache not shrunk" << endl;
+		rc = -1;
+	}
+	cache.Clear();
+	if (cache.GetSize() || cache.GetBytes() || nreleased != 12) {
+		cerr << ProgName << " : cache not cleared" << endl;
+		rc = -1;
+	}
+	return(rc);
+}
+
+void benchmark(BrickLOD &lod) {
+	double modelview[16], projection[16];
+	int viewport[4];
+
+	int nframes = 100;
+	double t0 = GetTime();
+	double nvoxels = 0.0;
+	size_t nbricks = 0;
+	for (int f=0; f<nframes; f++) {
+		double z = 1.2 + 3.0 * f / nframes;
+		make_view(0.5, 0.5, z, false, modelview, projection, viewport);
+		lod.Select(modelview, projection, viewport, opt.error, 100000);
+
+		const vector <int> &selected = lod.GetSelected();
+		nbricks += selected.size();
+		for (int i=0; i<selected.size(); i++) {
+			const BrickLOD::brick_t &b = lod.GetNode(selected[i]);
+			nvoxels += (double) (b.max[0]-b.min[0]+1) *
+				(b.max[1]-b.min[1]+1) * (b.max[2]-b.min[2]+1);
+		}
+	}
+	double t = (GetTime() - t0) / nframes;
+	double full = (double) opt.dim * opt.dim * opt.dim;
+
+	cout << opt.dim << "^3 volume, " << opt.brick << "^3 bricks, " <<
+		opt.reflevel + 1 << " levels : selected in " << t * 1000.0 <<
+		" ms, " << nbricks / nframes << " bricks holding " <<
+		100.0 * nvoxels / nframes / full <<
+		"% of the full resolution voxels" << endl;
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	//
+	// The unit cube, less a few voxels on some sides so that the region
+	// isn't aligned with the bricks
+	//
+	size_t dim = opt.dim;
+	size_t dims[3] = {dim, dim, dim};
+	size_t min[3] = {3, 0, 5};
+	size_t max[3] = {dim-1, dim-8, dim-1};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	BrickLOD lod;
+	if (lod.SetRegion(dims, min, max, extents, opt.reflevel, opt.brick) < 0) {
+		exit(1);
+	}
+
+	int rc = 0;
+	if (test_select(lod, extents) < 0) rc = 1;
+	if (test_resolve(lod, extents) < 0) rc = 1;
+	if (test_cache() < 0) rc = 1;
+
+	benchmark(lod);
+
+	exit(rc);
+}
@@ -0,0 +1,101 @@
+//
+//	File:		TestGrid.h
+//
+//	Description:	Grid fixture shared by the test programs. Header
+//					only, as each test builds just its own sources.
+//
+
+#ifndef	_TestGrid_h_
+#define	_TestGrid_h_
+
+#include <vector>
+#include <cstdlib>
+#include <vapor/RegularGrid.h>
+#include <vapor/LayeredGrid.h>
+
+//
+// Construct a grid of dim^3 points stored in blocks of 32^3, whose first
+// point is voxel min of the block grid, so that the grid origin need not
+// be block aligned. The grid spans extents.
+//
+// value() returns the value at user coordinates x, y, z. It is called
+// with i varying fastest, after srand(1), so it may draw random numbers
+// and still produce the same grid on every call. If zcoord is not NULL
+// the grid is a LayeredGrid varying along z, whose z coordinate at a
+// grid point is zcoord(x,y,z). If missing is not NULL the grid has the
+// missing value *missing.
+//
+// The block storage is appended to storage, and must be freed by the
+// caller after the grid is deleted.
+//
+inline VAPoR::RegularGrid *MakeTestGrid(
+	int dim, const size_t min[3], const double extents[6],
+	float (*value)(double x, double y, double z),
+	double (*zcoord)(double x, double y, double z),
+	const float *missing, std::vector <float *> &storage
+) {
+	size_t bs[3] = {32,32,32};
+	size_t max[3];
+	bool periodic[3] = {false, false, false};
+
+	size_t nblocks = 1;
+	for (int i=0; i<3; i++) {
+		max[i] = min[i] + dim - 1;
+		nblocks *= max[i]/bs[i] - min[i]/bs[i] + 1;
+	}
+	size_t bsize = bs[0]*bs[1]*bs[2];
+	float *data = new float[nblocks*bsize];
+	float *coords = zcoord ? new float[nblocks*bsize] : NULL;
+	storage.push_back(data);
+	if (coords) storage.push_back(coords);
+
+	float **blks = new float*[nblocks];
+	float **cblks = new float*[nblocks];
+	for (size_t b=0; b<nblocks; b++) {
+		blks[b] = data + b*bsize;
+		cblks[b] = coords ? coords + b*bsize : NULL;
+	}
+
+	//
+	// Fill the blocks through a regular grid. The coordinate blocks are
+	// laid out like the data blocks
+	//
+	VAPoR::RegularGrid fill(bs,min,max,extents,periodic,blks);
+
+	srand(1);
+	for (int k=0; k<dim; k++) {
+	for (int j=0; j<dim; j++) {
+	for (int i=0; i<dim; i++) {
+		double x = extents[0] + (extents[3]-extents[0]) * i / (dim-1);
+		double y = extents[1] + (extents[4]-extents[1]) * j / (dim-1);
+		double z = extents[2] + (extents[5]-extents[2]) * k / (dim-1);
+		float *vp = &fill.AccessIJK(i,j,k);
+		*vp = value(x,y,z);
+		if (coords) coords[vp - data] = zcoord(x,y,z);
+	}
+	}
+	}
+
+	VAPoR::RegularGrid *rg;
+	if (zcoord && missing) {
+		rg = new VAPoR::LayeredGrid(
+			bs,min,max,extents,periodic,blks,cblks,2,*missing
+		);
+	}
+	else if (zcoord) {
+		rg = new VAPoR::LayeredGrid(bs,min,max,extents,periodic,blks,cblks,2);
+	}
+	else if (missing) {
+		rg = new VAPoR::RegularGrid(
+			bs,min,max,extents,periodic,blks,*missing
+		);
+	}
+	else {
+		rg = new VAPoR::RegularGrid(bs,min,max,extents,periodic,blks);
+	}
+	delete [] blks;
+	delete [] cblks;
+	return(rg);
+}
+
+#endif
@@ -25,6 +25,8 @@ struct {
 	int	level;
 	int	lod;
 	char *ftype;
+	int pyramid;
+	char *pyramiddir;
 	OptionParser::Boolean_T	help;
 	OptionParser::Boolean_T	quiet;
 	OptionParser::Boolean_T	debug;
@@ -43,6 +45,8 @@ OptionParser::OptDescRec_T	set_opts[] = {
 	{"level",1, "0","Multiresution refinement level. Zero implies coarsest resolution"},
 	{"lod",1, "0","Level of detail. Zero implies coarsest resolution"},
 	{"ftype",	1,	"vdf",	"data set type (vdf|wrf)"},
+	{"pyramid",	1,	"0",	"Number of coarser refinement levels computed for data sets that have none"},
+	{"pyramiddir",	1,	"",	"Directory of pyramid files"},
 	{"help",	0,	"",	"Print this message and exit"},
 	{"quiet",	0,	"",	"Operate quitely"},
 	{"debug",	0,	"",	"Debug mode"},
@@ -65,6 +69,8 @@ OptionParser::Option_T	get_options[] = {
 	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
 	{"quiet", VetsUtil::CvtToBoolean, &opt.quiet, sizeof(opt.quiet)},
 	{"ftype", VetsUtil::CvtToString, &opt.ftype, sizeof(opt.ftype)},
+	{"pyramid", VetsUtil::CvtToInt, &opt.pyramid, sizeof(opt.pyramid)},
+	{"pyramiddir", VetsUtil::CvtToString, &opt.pyramiddir, sizeof(opt.pyramiddir)},
 	{"debug", VetsUtil::CvtToBoolean, &opt.debug, sizeof(opt.debug)},
 	{"xregion", VetsUtil::CvtToIntRange, &opt.xregion, sizeof(opt.xregion)},
 	{"yregion", VetsUtil::CvtToIntRange, &opt.yregion, sizeof(opt.yregion)},
@@ -187,6 +193,7 @@ int main(int argc, char **argv) {
 	if (DataMgrFactory::GetErrCode() != 0) {
 		exit (1);
 	}
+	if (opt.pyramid > 0) datamgr->SetPyramid(opt.pyramid, opt.pyramiddir);
 
 	print_info(datamgr);
 
@@ -0,0 +1,401 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/DataMgr.h>
+#include <vapor/VaporFlow.h>
+#include "FieldPrefetcher.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for FieldPrefetcher: the grids Get() returns, with and
+// without read-ahead, are compared with those read synchronously by
+// VaporFlow::Get3GridData() from an in-memory data collection. One
+// timestep of the collection can't be read, and reading another one is
+// slow, so that a failed Get() drops the read-ahead while the background
+// thread is reading it. No grid may stay locked in the DataMgr after
+// the read-ahead is dropped.
+//
+
+struct {
+	int	dim;
+	int	nts;
+	int	memsize;
+	int	budget;
+	int	failts;
+	int	slowts;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"24",	"Dimension of the data"},
+	{"nts",		1, 	"8",	"Number of timesteps"},
+	{"memsize",	1, 	"32",	"DataMgr cache size in MBs"},
+	{"budget",	1, 	"16",	"Read-ahead memory budget in MBs"},
+	{"failts",	1, 	"3",	"Timestep whose V component can't be read"},
+	{"slowts",	1, 	"5",	"Timestep that is slow to read"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"nts", VetsUtil::CvtToInt, &opt.nts, sizeof(opt.nts)},
+	{"memsize", VetsUtil::CvtToInt, &opt.memsize, sizeof(opt.memsize)},
+	{"budget", VetsUtil::CvtToInt, &opt.budget, sizeof(opt.budget)},
+	{"failts", VetsUtil::CvtToInt, &opt.failts, sizeof(opt.failts)},
+	{"slowts", VetsUtil::CvtToInt, &opt.slowts, sizeof(opt.slowts)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+const char *VarNames[] = {"U", "V", "W"};
+
+float value(size_t ts, int c, size_t x, size_t y, size_t z) {
+	return(ts * 1000.0 + c * 100.0 + x + 0.5 * y + 0.25 * z);
+}
+
+//
+// A collection of three 3D variables, computed on the fly, with a single
+// refinement level
+//
+class TestDataMgr : public DataMgr {
+public:
+	TestDataMgr(size_t dim, size_t nts, size_t mem_size) : DataMgr(mem_size) {
+		_dim = dim;
+		_nts = nts;
+		_ts = 0;
+		_comp = 0;
+		pthread_mutex_init(&_startedLock, 0);
+	}
+	virtual ~TestDataMgr() {
+		pthread_mutex_destroy(&_startedLock);
+	}
+
+	//
+	// Has a read of timestep ts been started since ClearStarted() was
+	// called?
+	//
+	bool Started(size_t ts) {
+		pthread_mutex_lock(&_startedLock);
+		bool started = _started.find(ts) != _started.end();
+		pthread_mutex_unlock(&_startedLock);
+		return(started);
+	}
+	void ClearStarted() {
+		pthread_mutex_lock(&_startedLock);
+		_started.clear();
+		pthread_mutex_unlock(&_startedLock);
+	}
+
+protected:
+	virtual void _GetDim(size_t dim[3], int reflevel) const {
+		dim[0] = dim[1] = dim[2] = _dim;
+	}
+	virtual void _GetBlockSize(size_t bs[3], int reflevel) const {
+		size_t dim[3] = {_dim, _dim, _dim};
+		DataMgr::_GetNativeBlockSize(dim, bs);
+	}
+	virtual int _GetNumTransforms() const { return(0); }
+	virtual vector<double> _GetExtents(size_t ts) const {
+		vector <double> extents(3, 0.0);
+		extents.resize(6, 1.0);
+		return(extents);
+	}
+	virtual long _GetNumTimeSteps() const { return((long) _nts); }
+	virtual vector <string> _GetVariables3D() const {
+		return(vector <string> (VarNames, VarNames+3));
+	}
+	virtual vector <string> _GetVariables2DXY() const {
+		return(vector <string>());
+	}
+	virtual vector <string> _GetVariables2DXZ() const {
+		return(vector <string>());
+	}
+	virtual vector <string> _GetVariables2DYZ() const {
+		return(vector <string>());
+	}
+	virtual vector<long> _GetPeriodicBoundary() const {
+		return(vector <long> (3, 0));
+	}
+	virtual double _GetTSUserTime(size_t ts) const { return((double) ts); }
+	virtual void _GetTSUserTimeStamp(size_t ts, string &s) const {
+		ostringstream oss;
+		oss << ts;
+		s = oss.str();
+	}
+	virtual int _VariableExists(
+		size_t ts, const char *varname, int reflevel = 0, int lod = 0
+	) const {
+		return(ts < _nts);
+	}
+	virtual int _OpenVariableRead(
+		size_t ts, const char *varname, int reflevel, int lod
+	) {
+		string name = varname;
+		pthread_mutex_lock(&_startedLock);
+		_started.insert(ts);
+		pthread_mutex_unlock(&_startedLock);
+
+		if (ts == (size_t) opt.failts && name == "V") {
+			SetErrMsg("Can't read variable %s at timestep %d", varname, ts);
+			return(-1);
+		}
+		if (ts == (size_t) opt.slowts) usleep(200000);
+
+		_ts = ts;
+		for (_comp = 0; _comp < 3 && name != VarNames[_comp]; _comp++);
+		DataMgr::_SetNativeVariable(ts, varname, reflevel);
+		return(0);
+	}
+	virtual void _GetValidRegion(
+		size_t min[3], size_t max[3], int reflevel
+	) const {
+		for (int i=0; i<3; i++) {
+			min[i] = 0;
+			max[i] = _dim-1;
+		}
+	}
+	virtual int _BlockReadRegion(
+		const size_t bmin[3], const size_t bmax[3], float *blks
+	) {
+		return(DataMgr::_BlockReadNativeRegion(bmin, bmax, blks));
+	}
+	virtual int _ReadNativeRegion(
+		const size_t min[3], const size_t max[3], float *region
+	) {
+		for (size_t z=min[2]; z<=max[2]; z++) {
+		for (size_t y=min[1]; y<=max[1]; y++) {
+		for (size_t x=min[0]; x<=max[0]; x++) {
+			*region++ = value(_ts, _comp, x, y, z);
+		}
+		}
+		}
+		return(0);
+	}
+	virtual int _CloseVariable() { return(0); }
+
+private:
+	size_t _dim;
+	size_t _nts;
+	size_t _ts;
+	int _comp;
+	std::set <size_t> _started;
+	pthread_mutex_t _startedLock;
+};
+
+//
+// Number of locks held on regions of the DataMgr cache
+//
+int num_locks(DataMgr *dm) {
+	ostringstream oss;
+	dm->PrintCache(oss);
+	istringstream iss(oss.str());
+	string word;
+	int nlocks = 0;
+	while (iss >> word) {
+		if (word == "lock_counter:") {
+			int n;
+			iss >> n;
+			nlocks += n;
+		}
+	}
+	return(nlocks);
+}
+
+//
+// Get timestep ts from the prefetcher and from VaporFlow, and compare
+// the results
+//
+int check_get(
+	FieldPrefetcher &prefetcher, VaporFlow &flow, DataMgr *dm, size_t ts,
+	size_t min[3], size_t max[3]
+) {
+	bool failing = ts == (size_t) opt.failts;
+	bool enable = MyBase::EnableErrMsg(! failing);
+
+	RegularGrid *pgrids[3];
+	bool pok = prefetcher.Get(ts, &pgrids[0], &pgrids[1], &pgrids[2]);
+
+	RegularGrid *sgrids[3];
+	prefetcher.LockDataMgr();
+	bool sok = flow.Get3GridData(
+		ts, VarNames[0], VarNames[1], VarNames[2], min, max,
+		&sgrids[0], &sgrids[1], &sgrids[2]
+	);
+	prefetcher.UnlockDataMgr();
+
+	MyBase::EnableErrMsg(enable);
+	MyBase::SetErrCode(0);
+
+	if (pok != sok || pok == failing) {
+		cerr << "Timestep " << ts << " : Get() returned " << pok <<
+			", Get3GridData() returned " << sok << endl;
+		if (pok) prefetcher.Release(pgrids[0], pgrids[1], pgrids[2]);
+		if (sok) prefetcher.Release(sgrids[0], sgrids[1], sgrids[2]);
+		return(1);
+	}
+	if (! pok) return(0);
+
+	int nerrors = 0;
+	for (int c=0; c<3; c++) {
+		size_t dims[3];
+		pgrids[c]->GetDimensions(dims);
+		for (size_t k=0; k<dims[2]; k++) {
+		for (size_t j=0; j<dims[1]; j++) {
+		for (size_t i=0; i<dims[0]; i++) {
+			float p = pgrids[c]->AccessIJK(i,j,k);
+			float s = sgrids[c]->AccessIJK(i,j,k);
+			if (p != s && nerrors++ < 10) {
+				cerr << "Timestep " << ts << ", " << VarNames[c] <<
+					"(" << i << "," << j << "," << k << ") : " <<
+					p << " != " << s << endl;
+			}
+		}
+		}
+		}
+	}
+	prefetcher.Release(pgrids[0], pgrids[1], pgrids[2]);
+	prefetcher.Release(sgrids[0], sgrids[1], sgrids[2]);
+	return(nerrors ? 1 : 0);
+}
+
+//
+// Read every timestep in order, with read-ahead of up to depth timesteps
+//
+int test_sequence(DataMgr *dm, VaporFlow &flow, size_t min[3], size_t max[3], int budget) {
+	int nerrors = 0;
+	{
+		string names[3] = {VarNames[0], VarNames[1], VarNames[2]};
+		FieldPrefetcher prefetcher(dm, names, 0, 0, min, max, budget);
+		for (size_t ts=0; ts<opt.nts; ts++) {
+			for (int ahead=1; ahead<=prefetcher.GetDepth(); ahead++) {
+				if (ts+ahead < opt.nts) prefetcher.Request(ts+ahead);
+			}
+			nerrors += check_get(prefetcher, flow, dm, ts, min, max);
+		}
+	}
+	if (num_locks(dm)) {
+		cerr << "Budget " << budget << "MB : " << num_locks(dm) <<
+			" locks held after the prefetcher is destroyed" << endl;
+		nerrors++;
+	}
+	return(nerrors);
+}
+
+//
+// Fail a background read, and retry it while the background thread reads
+// a slow timestep. The read-ahead, including that timestep, must be
+// dropped.
+//
+int test_drop(TestDataMgr *dm, VaporFlow &flow, size_t min[3], size_t max[3]) {
+	int nerrors = 0;
+
+	// Nothing may be read from the cache
+	//
+	dm->Clear();
+	dm->ClearStarted();
+
+	string names[3] = {VarNames[0], VarNames[1], VarNames[2]};
+	FieldPrefetcher prefetcher(dm, names, 0, 0, min, max, opt.budget);
+	if (prefetcher.GetDepth() < 2) {
+		cerr << "Read-ahead budget too small" << endl;
+		return(1);
+	}
+
+	//
+	// Once the failing timestep is being read in the background, the slow
+	// one is read right after it, while Get() retries the failing one
+	//
+	prefetcher.Request(opt.failts);
+	prefetcher.Request(opt.slowts);
+	while (! dm->Started(opt.failts)) usleep(1000);
+
+	bool enable = MyBase::EnableErrMsg(false);
+	RegularGrid *grids[3];
+	bool ok = prefetcher.Get(opt.failts, &grids[0], &grids[1], &grids[2]);
+	MyBase::EnableErrMsg(enable);
+	MyBase::SetErrCode(0);
+
+	if (ok) {
+		cerr << "Timestep " << opt.failts << " was read" << endl;
+		prefetcher.Release(grids[0], grids[1], grids[2]);
+		nerrors++;
+	}
+	if (num_locks(dm)) {
+		cerr << num_locks(dm) <<
+			" locks held after the read-ahead was dropped" << endl;
+		nerrors++;
+	}
+
+	nerrors += check_get(prefetcher, flow, dm, opt.slowts, min, max);
+	return(nerrors);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	TestDataMgr dm(opt.dim, opt.nts, opt.memsize);
+	if (DataMgr::GetErrCode() != 0) exit(1);
+
+	//
+	// A region that doesn't start on a block boundary
+	//
+	size_t min[3] = {3, 2, 1};
+	size_t max[3] = {
+		(size_t) opt.dim-2, (size_t) opt.dim-3, (size_t) opt.dim-1
+	};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	VaporFlow flow(&dm);
+	flow.SetLocalRegion(0, 0, min, max, extents);
+
+	int nerrors = 0;
+	nerrors += test_sequence(&dm, flow, min, max, 0);
+	nerrors += test_sequence(&dm, flow, min, max, opt.budget);
+	nerrors += test_drop(&dm, flow, min, max);
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
@@ -0,0 +1,434 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/flowlinedata.h>
+#include "FlowGeometry.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for FlowGeometry: builds tubes and
+// arrows along helical flow lines, and an arrow lattice, checking the
+// number of vertices and triangles, the bounds of the geometry, the
+// handling of end and stationary flags and of periodic flow, and that
+// threads don't change the geometry. Reports the cost of building the
+// geometry. No OpenGL context is needed.
+//
+
+struct {
+	int	lines;
+	int	points;
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"lines",	1, 	"10000",	"Number of flow lines benchmarked"},
+	{"points",	1, 	"100",	"Number of points per flow line"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"lines", VetsUtil::CvtToInt, &opt.lines, sizeof(opt.lines)},
+	{"points", VetsUtil::CvtToInt, &opt.points, sizeof(opt.points)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	Radius = 0.01;
+const float	HeadRadius = 0.02;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Helical flow lines rising through the unit box, each with its own
+// color
+//
+FlowLineData *make_lines(int nlines, int npoints) {
+	FlowLineData *fld = new FlowLineData(nlines, npoints, false, 1, true);
+	for (int l=0; l<nlines; l++) {
+		float cx = 0.2 + 0.6 * (l % 17) / 16.0;
+		float cy = 0.2 + 0.6 * (l % 13) / 12.0;
+		for (int p=0; p<npoints; p++) {
+			float t = (float) p / (npoints-1);
+			float a = 12.0 * t + l;
+			fld->setFlowPoint(
+				l, p, cx + 0.1 * cos(a), cy + 0.1 * sin(a), 0.1 + 0.8 * t
+			);
+			fld->setRGBA(l, p, t, 1.0 - t, (float) (l % 2), 1.0);
+		}
+	}
+	return(fld);
+}
+
+//
+// Bounding box of the points of a flow line, from index first to last
+//
+void line_bounds(FlowLineData *fld, int l, int first, int last, float b[6]) {
+	for (int i=0; i<3; i++) {
+		b[i] = 1e30;
+		b[i+3] = -1e30;
+	}
+	for (int p=first; p<=last; p++) {
+		float *pt = fld->getFlowPoint(l, p);
+		for (int i=0; i<3; i++) {
+			b[i] = pt[i] < b[i] ? pt[i] : b[i];
+			b[i+3] = pt[i] > b[i+3] ? pt[i] : b[i+3];
+		}
+	}
+}
+
+//
+// Check the size of the geometry, and that its bounds hold the box b
+// and lie within the box b padded by pad
+//
+int check(
+	const FlowGeometry &fg, const char *what, size_t nverts,
+	size_t nindices, const float b[6], float pad
+) {
+	int rc = 0;
+	if (fg.GetNumVertices() != nverts || fg.GetNumIndices() != nindices) {
+		cerr << ProgName << " : " << what << " : " << fg.GetNumVertices() <<
+			" vertices and " << fg.GetNumIndices() << " indices, expected " <<
+			nverts << " and " << nindices << endl;
+		rc = -1;
+	}
+
+	const unsigned int *indices = fg.GetIndices();
+	for (size_t i=0; i<fg.GetNumIndices(); i++) {
+		if (indices[i] >= fg.GetNumVertices()) {
+			cerr << ProgName << " : " << what << " : index out of range" << endl;
+			return(-1);
+		}
+	}
+
+	float bounds[6];
+	if (! fg.GetBounds(bounds)) {
+		if (nverts) {
+			cerr << ProgName << " : " << what << " : no bounds" << endl;
+			rc = -1;
+		}
+		return(rc);
+	}
+	for (int i=0; i<3; i++) {
+		if (bounds[i] > b[i] + 1e-5 || bounds[i+3] < b[i+3] - 1e-5 ||
+			bounds[i] < b[i] - pad - 1e-5 || bounds[i+3] > b[i+3] + pad + 1e-5) {
+
+			cerr << ProgName << " : " << what << " : bounds [" <<
+				bounds[i] << ", " << bounds[i+3] << "] along axis " << i <<
+				" not within " << pad << " of [" << b[i] << ", " << b[i+3] <<
+				"]" << endl;
+			rc = -1;
+		}
+	}
+	return(rc);
+}
+
+int same(const FlowGeometry &a, const FlowGeometry &b) {
+	if (a.GetNumVertices() != b.GetNumVertices() ||
+		a.GetNumIndices() != b.GetNumIndices()) return(0);
+	size_t nv = a.GetNumVertices();
+	for (size_t i=0; i<nv*3; i++) {
+		if (a.GetVertices()[i] != b.GetVertices()[i]) return(0);
+		if (a.GetNormals()[i] != b.GetNormals()[i]) return(0);
+	}
+	for (size_t i=0; i<nv*4; i++) {
+		if (a.GetColors()[i] != b.GetColors()[i]) return(0);
+	}
+	for (size_t i=0; i<a.GetNumIndices(); i++) {
+		if (a.GetIndices()[i] != b.GetIndices()[i]) return(0);
+	}
+	return(1);
+}
+
+int test_lines() {
+	int rc = 0;
+	int nlines = 150;
+	int npoints = 40;
+	FlowLineData *fld = make_lines(nlines, npoints);
+
+	float b[6];
+	line_bounds(fld, 0, 0, npoints-1, b);
+	for (int l=1; l<nlines; l++) {
+		float lb[6];
+		line_bounds(fld, l, 0, npoints-1, lb);
+		for (int i=0; i<3; i++) {
+			b[i] = lb[i] < b[i] ? lb[i] : b[i];
+			b[i+3] = lb[i+3] > b[i+3] ? lb[i+3] : b[i+3];
+		}
+	}
+
+	FlowGeometry fg(opt.nthreads);
+	fg.SetRadius(Radius);
+	fg.SetArrowHead(HeadRadius, 0.0, false);
+
+	//
+	// A ring of six vertices per point, and two caps. Twelve triangles
+	// per segment, and four per cap.
+	//
+	if (fg.BuildTubes(fld, 0, npoints-1, false, false) < 0) return(-1);
+	size_t nv = nlines * (6 * npoints + 12);
+	size_t ni = nlines * (36 * (npoints-1) + 24);
+	if (check(fg, "tubes", nv, ni, b, Radius) < 0) rc = -1;
+
+	FlowGeometry serial(1);
+	serial.SetRadius(Radius);
+	serial.SetArrowHead(HeadRadius, 0.0, false);
+	serial.BuildTubes(fld, 0, npoints-1, false, false);
+	if (! same(fg, serial)) {
+		cerr << ProgName << " : threads change the tubes" << endl;
+		rc = -1;
+	}
+
+	//
+	// Per segment: two rings, a cap, the tip and the head ring, with
+	// twelve, four and six triangles
+	//
+	if (fg.BuildArrows(fld, 0, npoints-1, false) < 0) return(-1);
+	nv = nlines * (npoints-1) * 25;
+	ni = nlines * (npoints-1) * 66;
+	if (check(fg, "arrows", nv, ni, b, HeadRadius + Radius) < 0) rc = -1;
+
+	serial.BuildArrows(fld, 0, npoints-1, false);
+	if (! same(fg, serial)) {
+		cerr << ProgName << " : threads change the arrows" << endl;
+		rc = -1;
+	}
+
+	//
+	// An age interval only draws that part of the lines
+	//
+	fg.BuildTubes(fld, 10, 19, true, false);
+	nv = nlines * (6 * 10 + 12);
+	ni = nlines * (36 * 9 + 24);
+	line_bounds(fld, 0, 10, 19, b);
+	for (int l=1; l<nlines; l++) {
+		float lb[6];
+		line_bounds(fld, l, 10, 19, lb);
+		for (int i=0; i<3; i++) {
+			b[i] = lb[i] < b[i] ? lb[i] : b[i];
+			b[i+3] = lb[i+3] > b[i+3] ? lb[i+3] : b[i+3];
+		}
+	}
+	if (check(fg, "age interval", nv, ni, b, Radius) < 0) rc = -1;
+
+	delete fld;
+	return(rc);
+}
+
+int test_flags() {
+	int rc = 0;
+	int npoints = 20;
+	FlowLineData *fld = make_lines(3, npoints);
+
+	//
+	// Line 0 ends at point 8, line 1 becomes stationary after point 4,
+	// and line 2 is stationary from its second point
+	//
+	fld->getFlowPoint(0, 8)[0] = END_FLOW_FLAG;
+	fld->getFlowPoint(1, 5)[0] = STATIONARY_STREAM_FLAG;
+	fld->getFlowPoint(2, 1)[0] = STATIONARY_STREAM_FLAG;
+
+	FlowGeometry fg(opt.nthreads);
+	fg.SetRadius(Radius);
+	fg.SetArrowHead(HeadRadius, 0.0, false);
+	fg.SetStationaryRadius(2.0 * Radius);
+
+	float b[6], b1[6], b2[6];
+	line_bounds(fld, 0, 0, 7, b);
+	line_bounds(fld, 1, 0, 4, b1);
+	line_bounds(fld, 2, 0, 0, b2);
+	for (int i=0; i<3; i++) {
+		b[i] = b1[i] < b[i] ? b1[i] : b[i];
+		b[i+3] = b1[i+3] > b[i+3] ? b1[i+3] : b[i+3];
+		b[i] = b2[i] < b[i] ? b2[i] : b[i];
+		b[i+3] = b2[i+3] > b[i+3] ? b2[i+3] : b[i+3];
+	}
+
+	//
+	// Tubes through 8 and 5 points, and two octahedra of 24 vertices
+	//
+	fg.BuildTubes(fld, 0, npoints-1, false, false);
+	size_t nv = (6 * 8 + 12) + (6 * 5 + 12) + 2 * 24;
+	size_t ni = (36 * 7 + 24) + (36 * 4 + 24) + 2 * 24;
+	if (check(fg, "flagged tubes", nv, ni, b, 2.0 * Radius) < 0) rc = -1;
+
+	//
+	// Arrows along 7 and 4 segments, without stationary symbols
+	//
+	fg.SetStationaryRadius(0.0);
+	fg.BuildArrows(fld, 0, npoints-1, false);
+	nv = (7 + 4) * 25;
+	ni = (7 + 4) * 66;
+	line_bounds(fld, 0, 0, 7, b);
+	for (int i=0; i<3; i++) {
+		b[i] = b1[i] < b[i] ? b1[i] : b[i];
+		b[i+3] = b1[i+3] > b[i+3] ? b1[i+3] : b[i+3];
+	}
+	if (check(fg, "flagged arrows", nv, ni, b, HeadRadius + Radius) < 0) {
+		rc = -1;
+	}
+
+	delete fld;
+	return(rc);
+}
+
+int test_periodic() {
+	int rc = 0;
+
+	//
+	// A straight line along x from 0.5 to 2.3, wrapped twice by a period
+	// of one. Each wrap restarts the tube with a ring, the segment
+	// crossing the boundary reaching 0.1 beyond it.
+	//
+	int npoints = 10;
+	FlowLineData *fld = new FlowLineData(1, npoints, false, 1, false);
+	for (int p=0; p<npoints; p++) {
+		fld->setFlowPoint(0, p, 0.5 + 0.2 * p, 0.5, 0.5);
+	}
+
+	FlowGeometry fg(opt.nthreads);
+	fg.SetRadius(Radius);
+	bool periodic[3] = {true, false, false};
+	float extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+	fg.SetPeriodic(periodic, extents);
+
+	fg.BuildTubes(fld, 0, npoints-1, false, false);
+	size_t nv = 6 * (npoints + 2) + 12;
+	size_t ni = 36 * (npoints-1) + 24;
+	float b[6] = {0.1, 0.5, 0.5, 1.1, 0.5, 0.5};
+	if (check(fg, "periodic tubes", nv, ni, b, Radius) < 0) rc = -1;
+
+	delete fld;
+	return(rc);
+}
+
+int test_lattice() {
+	int rc = 0;
+
+	//
+	// A uniform field (1, 0, 0) on the unit box, with one missing value
+	//
+	size_t dims[3] = {5, 5, 5};
+	size_t min[3] = {0, 0, 0};
+	size_t max[3] = {4, 4, 4};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+	bool periodic[3] = {false, false, false};
+	float *data = new float[125];
+	for (int i=0; i<125; i++) data[i] = 1.0;
+	float *blks[1] = {data};
+	RegularGrid *rg = new RegularGrid(
+		dims, min, max, extents, periodic, blks, MissingValue
+	);
+
+	FlowGeometry fg(opt.nthreads);
+	fg.SetRadius(Radius);
+	fg.SetArrowHead(3.0 * Radius, 2.0 * Radius, true);
+
+	const RegularGrid *field[3] = {rg, NULL, NULL};
+	int grid[3] = {4, 3, 2};
+	float scales[3] = {1.0, 1.0, 1.0};
+	float vscale = 0.1;
+
+	if (fg.BuildLattice(field, NULL, extents, grid, false, 0.0, scales, vscale) < 0) {
+		return(-1);
+	}
+
+	//
+	// Arrows start at cell centers and end 0.1 further along x
+	//
+	float b[6] = {0.125, 1.0/6.0, 0.25, 0.975, 5.0/6.0, 0.75};
+	if (check(fg, "lattice", 24 * 25, 24 * 66, b, 3.0 * Radius) < 0) rc = -1;
+
+	//
+	// Missing values drop the arrows: the upper layer of the lattice is
+	// on a plane of missing values
+	//
+	for (int j=0; j<5; j++) {
+	for (int i=0; i<5; i++) {
+		rg->AccessIJK(i, j, 3) = MissingValue;
+	}
+	}
+	fg.BuildLattice(field, NULL, extents, grid, false, 0.0, scales, vscale);
+	size_t narrows = fg.GetNumVertices() / 25;
+	if (narrows != 12 || fg.GetNumIndices() != narrows * 66) {
+		cerr << ProgName << " : " << narrows << " arrows around a missing value" << endl;
+		rc = -1;
+	}
+
+	delete rg;
+	delete [] data;
+	return(rc);
+}
+
+void benchmark() {
+	FlowLineData *fld = make_lines(opt.lines, opt.points);
+
+	FlowGeometry fg(opt.nthreads);
+	fg.SetRadius(Radius);
+	double t0 = GetTime();
+	fg.BuildTubes(fld, 0, opt.points-1, false, false);
+	double ttubes = GetTime() - t0;
+
+	FlowGeometry serial(1);
+	serial.SetRadius(Radius);
+	t0 = GetTime();
+	serial.BuildTubes(fld, 0, opt.points-1, false, false);
+	double tserial = GetTime() - t0;
+
+	cout << opt.lines << " lines of " << opt.points << " points : " <<
+		fg.GetNumIndices() / 3 << " triangles built in " << ttubes * 1000.0 <<
+		" ms (" << fg.GetNumThreads() << " threads), " << tserial * 1000.0 <<
+		" ms serially" << endl;
+
+	delete fld;
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int rc = 0;
+	if (test_lines() < 0) rc = 1;
+	if (test_flags() < 0) rc = 1;
+	if (test_periodic() < 0) rc = 1;
+	if (test_lattice() < 0) rc = 1;
+
+	benchmark();
+
+	exit(rc);
+}
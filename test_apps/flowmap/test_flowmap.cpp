@@ -0,0 +1,268 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/FlowMap.h>
+#include <vapor/flowlinedata.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Test of FlowMap and FTLEPipeLine on the linear saddle field
+// (u,v,w) = (x, -y, 0), whose flow map, (x e^T, y e^-T, z), and FTLE,
+// 1 everywhere for T = +/-1, are known. The field is sampled exactly by
+// trilinear interpolation, so only the Runge-Kutta error remains.
+//
+
+struct {
+	int	dim;
+	int	nsteps;
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"33",	"Dimension of the field grid"},
+	{"nsteps",	1, 	"64",	"Number of Runge-Kutta steps"},
+	{"nthreads",1, 	"0",	"Number of execution threads (0 => # processors)"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"nsteps", VetsUtil::CvtToInt, &opt.nsteps, sizeof(opt.nsteps)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// A single block grid of dim^3 points on extents. If comp is between
+// 0 and 2 the grid samples component comp of the saddle field,
+// otherwise it's filled with zeros.
+//
+RegularGrid *make_grid(
+	const size_t dim[3], const double extents[6], int comp,
+	bool has_missing, vector <float *> &storage
+) {
+	size_t min[3] = {0,0,0};
+	size_t max[3] = {dim[0]-1, dim[1]-1, dim[2]-1};
+	bool periodic[3] = {false, false, false};
+
+	float *data = new float[dim[0]*dim[1]*dim[2]];
+	storage.push_back(data);
+	float **blks = new float*[1];
+	blks[0] = data;
+
+	RegularGrid *rg;
+	if (has_missing) {
+		rg = new RegularGrid(dim, min, max, extents, periodic, blks, MissingValue);
+	}
+	else {
+		rg = new RegularGrid(dim, min, max, extents, periodic, blks);
+	}
+	delete [] blks;
+
+	for (size_t k=0; k<dim[2]; k++) {
+	for (size_t j=0; j<dim[1]; j++) {
+	for (size_t i=0; i<dim[0]; i++) {
+		double x, y, z;
+		rg->GetUserCoordinates(i, j, k, &x, &y, &z);
+		float v = 0.0;
+		if (comp == 0) v = x;
+		if (comp == 1) v = -y;
+		rg->AccessIJK(i,j,k) = v;
+	}
+	}
+	}
+	return(rg);
+}
+
+//
+// Advect a lattice inside the domain, and one that sticks out of it, and
+// compare the end positions with the exact flow map
+//
+int test_advect(const RegularGrid *u, const RegularGrid *v) {
+	int nerrors = 0;
+	size_t dim[3] = {9, 9, 5};
+	double extents[6] = {-0.1, -0.1, -0.1, 0.1, 0.1, 0.1};
+	vector <float *> storage;
+	RegularGrid *lattice = make_grid(dim, extents, -1, false, storage);
+
+	double T = 1.0;
+	FlowMap flowmap(opt.nthreads);
+	flowmap.SetIntegrationTime(T);
+	flowmap.SetNumSteps(opt.nsteps);
+
+	vector <float> endpos(3*dim[0]*dim[1]*dim[2]);
+	if (flowmap.Advect(u, v, NULL, lattice, &endpos[0]) < 0) exit(1);
+
+	double maxerr = 0.0;
+	for (size_t k=0; k<dim[2]; k++) {
+	for (size_t j=0; j<dim[1]; j++) {
+	for (size_t i=0; i<dim[0]; i++) {
+		double x, y, z;
+		lattice->GetUserCoordinates(i, j, k, &x, &y, &z);
+		const float *p = &endpos[3*(k*dim[0]*dim[1] + j*dim[0] + i)];
+		double exact[] = {x*exp(T), y*exp(-T), z};
+		for (int c=0; c<3; c++) {
+			double err = fabs(p[c] - exact[c]);
+			if (err > maxerr) maxerr = err;
+		}
+	}
+	}
+	}
+	cout << "Flow map error : " << maxerr << endl;
+	if (maxerr > 1.e-4) {
+		cerr << "Flow map error too large : " << maxerr << endl;
+		nerrors++;
+	}
+
+	//
+	// Seeds that start outside the field are flagged
+	//
+	double outside[6] = {0.5, -0.1, -0.1, 1.5, 0.1, 0.1};
+	RegularGrid *olattice = make_grid(dim, outside, -1, false, storage);
+	if (flowmap.Advect(u, v, NULL, olattice, &endpos[0]) < 0) exit(1);
+	size_t last = 3*(dim[0]*dim[1]*dim[2] - 1);
+	if (endpos[last] != END_FLOW_FLAG) {
+		cerr << "Seed outside the field not flagged" << endl;
+		nerrors++;
+	}
+
+	delete lattice;
+	delete olattice;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+	return(nerrors);
+}
+
+//
+// The FTLE of the saddle field through the pipeline stage, forward and
+// backward in time. Grid points that start outside the field, or whose
+// neighbors do, are missing. Seeds that leave the field stop there, so
+// the FTLE is checked only where they all stay inside.
+//
+int test_ftle(RegularGrid *u, RegularGrid *v) {
+	int nerrors = 0;
+	size_t dim[3] = {25, 25, 5};
+	vector <float *> storage;
+
+	double Ts[] = {1.0, -1.0};
+	for (int t=0; t<2; t++) {
+
+		double extents[6] = {-1.2, -1.2, -0.1, 1.2, 1.2, 0.1};
+		RegularGrid *ftle = make_grid(dim, extents, -1, true, storage);
+
+		FTLEPipeLine pipeline(
+			"ftle", "u", "v", "0", "FTLE", Ts[t], opt.nsteps*2, 1
+		);
+		vector <const RegularGrid *> inputs;
+		inputs.push_back(u);
+		inputs.push_back(v);
+		vector <RegularGrid *> outputs;
+		outputs.push_back(ftle);
+
+		// One level below the finest: half the steps
+		//
+		if (pipeline.GetNumSteps(0) != opt.nsteps) {
+			cerr << "Wrong number of steps : " << pipeline.GetNumSteps(0) << endl;
+			nerrors++;
+		}
+		if (pipeline.Calculate(inputs, outputs, 0, 0, 0) < 0) exit(1);
+
+		double maxerr = 0.0;
+		int nvalid = 0, nmissing = 0;
+		for (size_t k=0; k<dim[2]; k++) {
+		for (size_t j=0; j<dim[1]; j++) {
+		for (size_t i=0; i<dim[0]; i++) {
+			double x, y, z;
+			ftle->GetUserCoordinates(i, j, k, &x, &y, &z);
+			float f = ftle->AccessIJK(i,j,k);
+			if (f == MissingValue) {
+				nmissing++;
+				if (fabs(x) < 0.95 && fabs(y) < 0.95) {
+					cerr << "Unexpected missing value" << endl;
+					nerrors++;
+				}
+				continue;
+			}
+			nvalid++;
+			if (fabs(x) > 0.25 || fabs(y) > 0.25) continue;
+
+			double err = fabs(f - 1.0);
+			if (err > maxerr) maxerr = err;
+		}
+		}
+		}
+		cout << "FTLE (T = " << Ts[t] << ") error : " << maxerr <<
+			", " << nvalid << " valid, " << nmissing << " missing" << endl;
+
+		if (maxerr > 1.e-3 || ! nvalid || ! nmissing) {
+			cerr << "FTLE (T = " << Ts[t] << ") failed" << endl;
+			nerrors++;
+		}
+		delete ftle;
+	}
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+	return(nerrors);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	size_t dim[3] = {(size_t) opt.dim, (size_t) opt.dim, 5};
+	double extents[6] = {-1.0, -1.0, -0.2, 1.0, 1.0, 0.2};
+	vector <float *> storage;
+	RegularGrid *u = make_grid(dim, extents, 0, false, storage);
+	RegularGrid *v = make_grid(dim, extents, 1, false, storage);
+
+	int nerrors = 0;
+	nerrors += test_advect(u, v);
+	nerrors += test_ftle(u, v);
+
+	delete u;
+	delete v;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
@@ -0,0 +1,241 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/DCReaderGRIB.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for DCReaderGRIB: checks that decoded fields are
+// reordered into slices correctly for every scan mode, and that the
+// index of a GRIB file's records survives a round trip, follows a moved
+// file, and is rejected once the file changes.
+//
+
+struct {
+	int	ni;
+	int	nj;
+	char *dir;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"ni",		1, 	"7",	"Points per row of the test fields"},
+	{"nj",		1, 	"5",	"Rows of the test fields"},
+	{"dir",		1, 	".",	"Directory the test files are written to"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"ni", VetsUtil::CvtToInt, &opt.ni, sizeof(opt.ni)},
+	{"nj", VetsUtil::CvtToInt, &opt.nj, sizeof(opt.nj)},
+	{"dir", VetsUtil::CvtToString, &opt.dir, sizeof(opt.dir)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+typedef std::vector<std::map<std::string, std::string> > records_t;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Reorder a field of distinct values for each scan mode, and check every
+// point of the slice against the point the scan mode puts there
+//
+int test_reorder() {
+	int ni = opt.ni;
+	int nj = opt.nj;
+	int nerrors = 0;
+
+	vector <double> src(ni*nj);
+	for (int k=0; k<ni*nj; k++) src[k] = k + 0.5;
+
+	vector <float> dst(ni*nj);
+	for (int mode=0; mode<4; mode++) {
+		bool iScanNeg = mode & 1;
+		bool jScanPos = mode & 2;
+		double divisor = mode == 3 ? 9.8 : 1.0;
+
+		DCReaderGRIB::ReorderField(
+			&src[0], ni, nj, iScanNeg, jScanPos, divisor, &dst[0]
+		);
+
+		//
+		// Point (x,y) of the slice, y northward, is point i of row j of
+		// the field in scan order
+		//
+		int n = 0;
+		for (int y=0; y<nj; y++) {
+		for (int x=0; x<ni; x++) {
+			int i = iScanNeg ? ni-1-x : x;
+			int j = jScanPos ? y : nj-1-y;
+			float expect = (float) src[j*ni + i] / divisor;
+			if (dst[y*ni + x] != expect) n++;
+		}
+		}
+		if (n) {
+			cerr << ProgName << " : " << n << " misplaced points with " <<
+				"iScansNegatively=" << iScanNeg <<
+				" jScansPositively=" << jScanPos << endl;
+			nerrors++;
+		}
+	}
+	return(nerrors ? -1 : 0);
+}
+
+int write_file(const string &path, const string &contents) {
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (! fp) {
+		cerr << ProgName << " : fopen(" << path << ") failed" << endl;
+		return(-1);
+	}
+	fwrite(contents.c_str(), 1, contents.size(), fp);
+	return(fclose(fp) == 0 ? 0 : -1);
+}
+
+//
+// Return true if the records read from an index are those written, with
+// their "file" key set to file
+//
+bool same_records(
+	const records_t &written, const records_t &read, const string &file
+) {
+	if (read.size() != written.size()) return(false);
+	for (size_t r=0; r<written.size(); r++) {
+		std::map<std::string, std::string> keys = written[r];
+		keys["file"] = file;
+		if (read[r] != keys) return(false);
+	}
+	return(true);
+}
+
+//
+// Index round trip. The GRIB file itself is never parsed, only its
+// modification time and size are recorded, so it need not hold GRIB
+// messages.
+//
+int test_index() {
+	string file = string(opt.dir) + "/test_gribreader.grb";
+	string moved = string(opt.dir) + "/test_gribreader_moved.grb";
+	int nerrors = 0;
+
+	if (write_file(file, string(1000, 'x')) < 0) return(-1);
+
+	records_t records(3);
+	for (int r=0; r<records.size(); r++) {
+		char buf[32];
+		sprintf(buf, "%d", r*400);
+		records[r]["offset"] = buf;
+		records[r]["shortName"] = r == 2 ? "2t" : "t";
+		records[r]["level"] = r == 1 ? "850" : "500";
+		records[r]["dataDate"] = "20120530";
+		records[r]["name"] = "Temperature, with = and spaces";
+		records[r]["file"] = "/some/where/else.grb";
+	}
+
+	records_t read;
+	DCReaderGRIB::WriteIndex(file, records);
+	if (DCReaderGRIB::ReadIndex(file, read) < 0 ||
+		! same_records(records, read, file)) {
+
+		cerr << ProgName << " : index round trip failed" << endl;
+		nerrors++;
+	}
+
+	//
+	// The index follows the file
+	//
+	remove(moved.c_str());
+	remove((moved + ".gidx").c_str());
+	if (rename(file.c_str(), moved.c_str()) != 0 ||
+		rename((file + ".gidx").c_str(), (moved + ".gidx").c_str()) != 0) {
+
+		cerr << ProgName << " : rename failed" << endl;
+		return(-1);
+	}
+	if (DCReaderGRIB::ReadIndex(moved, read) < 0 ||
+		! same_records(records, read, moved)) {
+
+		cerr << ProgName << " : index of moved file rejected" << endl;
+		nerrors++;
+	}
+
+	//
+	// A changed file invalidates its index
+	//
+	if (write_file(moved, string(1001, 'x')) < 0) return(-1);
+	if (DCReaderGRIB::ReadIndex(moved, read) >= 0 || ! read.empty()) {
+		cerr << ProgName << " : stale index accepted" << endl;
+		nerrors++;
+	}
+
+	//
+	// Records without an offset, or with keys that can't be written,
+	// give no index
+	//
+	records_t bad = records;
+	bad[1].erase("offset");
+	DCReaderGRIB::WriteIndex(moved, bad);
+	if (DCReaderGRIB::ReadIndex(moved, read) >= 0) {
+		cerr << ProgName << " : index without offsets accepted" << endl;
+		nerrors++;
+	}
+
+	remove((moved + ".gidx").c_str());
+	bad = records;
+	bad[0]["name"] = "two\nlines";
+	DCReaderGRIB::WriteIndex(moved, bad);
+	if (DCReaderGRIB::ReadIndex(moved, read) >= 0) {
+		cerr << ProgName << " : index of multi-line value accepted" << endl;
+		nerrors++;
+	}
+
+	remove(moved.c_str());
+	remove((moved + ".gidx").c_str());
+	return(nerrors ? -1 : 0);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int rc = 0;
+	if (test_reorder() < 0) rc = 1;
+	if (test_index() < 0) rc = 1;
+
+	if (rc) exit(rc);
+	cout << "Passed" << endl;
+	exit(0);
+}
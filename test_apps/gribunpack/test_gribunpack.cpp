@@ -0,0 +1,426 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+
+#ifdef	GRIB_SAMPLES
+#include <string>
+#include <cmath>
+#include <dirent.h>
+#include "../../lib/gribapi/grib_api.h"
+#endif
+
+//
+// The fast path is included rather than linked, as grib_api doesn't
+// export it. The file needs no other grib_api headers.
+//
+#include "../../lib/gribapi/grib_bits_decode_fast.c"
+
+using namespace VetsUtil;
+
+//
+// Regression test for the simple packing fast path of grib_api: decodes
+// random packed values of several widths and counts with the fast path,
+// and checks that its values are bit for bit the values of the generic,
+// bit at a time, decode loop, and that it leaves the widths it doesn't
+// handle to that loop.
+//
+// When built with the bundled grib_api (GRIB_SAMPLES is defined by the
+// Makefile if its headers and sample files are present), also repacks
+// every simple packed sample with each width, and checks that the values
+// grib_get_double_array() decodes are bit for bit those of the generic
+// loop.
+//
+
+struct {
+	int	nvalues;
+	int	seed;
+	char *samples;
+	char *definitions;
+	int	maxvalues;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nvalues",	1, 	"1000000",	"Number of values of the timed field"},
+	{"seed",	1, 	"1",	"Random number seed"},
+	{"samples",	1, 	"../../share/grib_api/samples",	"Directory of grib_api sample files, or \"\" to skip them (grib_api builds only)"},
+	{"definitions",	1, 	"../../share/grib_api/definitions",	"grib_api definitions directory, unless GRIB_DEFINITION_PATH is set"},
+	{"maxvalues",	1, 	"1000000",	"Skip samples with more values than this"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nvalues", VetsUtil::CvtToInt, &opt.nvalues, sizeof(opt.nvalues)},
+	{"seed", VetsUtil::CvtToInt, &opt.seed, sizeof(opt.seed)},
+	{"samples", VetsUtil::CvtToString, &opt.samples, sizeof(opt.samples)},
+	{"definitions", VetsUtil::CvtToString, &opt.definitions, sizeof(opt.definitions)},
+	{"maxvalues", VetsUtil::CvtToInt, &opt.maxvalues, sizeof(opt.maxvalues)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+// The fast path widths, and widths left to the generic loop
+//
+const long Widths[] = {8, 12, 16, 24, 7, 13};
+const int NWidths = sizeof(Widths) / sizeof(Widths[0]);
+
+// Counts around the vector strides and the block size of the fast path
+//
+const size_t Counts[] = {
+	0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33,
+	511, 512, 513, 1023, 1024, 1025, 4097
+};
+const int NCounts = sizeof(Counts) / sizeof(Counts[0]);
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// The generic decode loops of grib_bits_any_endian_simple.c. Returns the
+// updated bit offset
+//
+long reference_decode(
+	const unsigned char *p, long bitp, long bitsPerValue,
+	double reference_value, double s, double d, size_t n_vals, double *val
+) {
+	if (bitsPerValue % 8) {
+		for (size_t i=0; i<n_vals; i++) {
+			unsigned long lvalue = 0;
+			for (long j=0; j<bitsPerValue; j++) {
+				lvalue <<= 1;
+				if (p[bitp >> 3] & (1 << (7 - (bitp % 8)))) lvalue += 1;
+				bitp++;
+			}
+			double x = ((lvalue*s)+reference_value)*d;
+			val[i] = x;
+		}
+	}
+	else {
+		size_t o = 0;
+		for (size_t i=0; i<n_vals; i++) {
+			unsigned long lvalue = 0;
+			for (long bc=0; bc<bitsPerValue/8; bc++) {
+				lvalue <<= 8;
+				lvalue |= p[o++];
+			}
+			double x = ((lvalue*s)+reference_value)*d;
+			val[i] = x;
+		}
+	}
+	return(bitp);
+}
+
+//
+// Decode n random values of the given width packed at the end of a
+// buffer, so that reads past the packed data fall outside it, with both
+// loops. Returns the number of mismatches, or -1 if the fast path didn't
+// behave as expected for the width
+//
+int check(long width, size_t n, double *ftime, double *rtime) {
+	size_t nbytes = (n*width+7)/8;
+	vector <unsigned char> buf(nbytes + 1);
+	unsigned char *p = &buf[0] + buf.size() - nbytes;
+	for (size_t i=0; i<nbytes; i++) p[i] = rand() & 0xff;
+
+	double ref = 200.0 + (double) rand() / RAND_MAX;
+	double s = 1.0 / (1 << (rand() % 16));
+	double d = 0.01;
+
+	vector <double> fast(n+1, -1.0);
+	vector <double> expected(n+1, -1.0);
+
+	long fbitp = 0;
+	double t0 = GetTime();
+	int rc = grib_decode_double_array_fast(
+		p, &fbitp, width, ref, s, d, n, &fast[0]
+	);
+	*ftime += GetTime() - t0;
+
+	t0 = GetTime();
+	long rbitp = reference_decode(p, 0, width, ref, s, d, n, &expected[0]);
+	*rtime += GetTime() - t0;
+
+	bool handled = width == 8 || width == 12 || width == 16 || width == 24;
+	if ((rc == 0) != handled) {
+		cerr << ProgName << " : " << width << " bits : fast path " <<
+			(handled ? "declined" : "accepted") << " " << n << " values" << endl;
+		return(-1);
+	}
+	if (! handled) return(0);
+
+	if (fbitp != rbitp) {
+		cerr << ProgName << " : " << width << " bits : bit offset " <<
+			fbitp << " after " << n << " values, expected " << rbitp << endl;
+		return(-1);
+	}
+
+	// The value past the last must be untouched
+	//
+	int mismatches = 0;
+	for (size_t i=0; i<=n; i++) {
+		if (memcmp(&fast[i], &expected[i], sizeof(double)) != 0) mismatches++;
+	}
+	return(mismatches);
+}
+
+//
+// Data that doesn't start on a byte is left to the generic loop
+//
+int check_offset() {
+	unsigned char p[8] = {0};
+	double val[4];
+	for (int w=0; w<4; w++) {
+		long bitp = 4;
+		if (grib_decode_double_array_fast(
+			p, &bitp, Widths[w], 0.0, 1.0, 1.0, 4, val) == 0 || bitp != 4) {
+
+			cerr << ProgName << " : " << Widths[w] <<
+				" bits : fast path accepted a bit offset" << endl;
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+#ifdef	GRIB_SAMPLES
+
+double power(long s, long n) {
+	double divisor = 1.0;
+	while (s < 0) { divisor /= n; s++; }
+	while (s > 0) { divisor *= n; s--; }
+	return(divisor);
+}
+
+//
+// Pack a random field of a sample with the given width and compare the
+// values grib_api decodes with the generic loop. Returns the number of
+// mismatches, or -1 if the message couldn't be packed
+//
+int check_width(grib_handle *sample, long width, double *timer) {
+	grib_handle *h = grib_handle_clone(sample);
+	if (! h) return(-1);
+
+	size_t n;
+	if (grib_get_size(h, "values", &n) != 0 ||
+		grib_set_long(h, "bitsPerValue", width) != 0) {
+
+		grib_handle_delete(h);
+		return(-1);
+	}
+
+	vector <double> values(n);
+	for (size_t i=0; i<n; i++) {
+		values[i] = 250.0 + 40.0 * sin(i * 0.001) + (double) rand() / RAND_MAX;
+	}
+	int rc = grib_set_double_array(h, "values", &values[0], n);
+
+	const void *msg;
+	size_t msglen;
+	if (rc == 0) rc = grib_get_message(h, &msg, &msglen);
+	grib_handle *copy = NULL;
+	if (rc == 0) copy = grib_handle_new_from_message_copy(0, msg, msglen);
+	grib_handle_delete(h);
+	if (! copy) return(-1);
+
+	long bpv, bsf, dsf;
+	double ref;
+	size_t offset;
+	rc = grib_get_long(copy, "bitsPerValue", &bpv);
+	if (rc == 0) rc = grib_get_long(copy, "binaryScaleFactor", &bsf);
+	if (rc == 0) rc = grib_get_long(copy, "decimalScaleFactor", &dsf);
+	if (rc == 0) rc = grib_get_double(copy, "referenceValue", &ref);
+	if (rc == 0) {
+
+		// GRIB 2 "values" apply the bitmap to the "codedValues"
+		//
+		rc = grib_get_offset(copy, "codedValues", &offset);
+		if (rc != 0) rc = grib_get_offset(copy, "values", &offset);
+	}
+	if (rc != 0 || bpv != width) {
+		grib_handle_delete(copy);
+		return(-1);
+	}
+
+	vector <double> decoded(n);
+	size_t len = n;
+	double t0 = GetTime();
+	rc = grib_get_double_array(copy, "values", &decoded[0], &len);
+	*timer += GetTime() - t0;
+
+	vector <double> expected(n);
+	grib_get_message(copy, &msg, &msglen);
+	reference_decode(
+		(const unsigned char *) msg + offset, 0, bpv, ref, power(bsf, 2),
+		power(-dsf, 10), n, &expected[0]
+	);
+	grib_handle_delete(copy);
+
+	if (rc != 0 || len != n) return((int) n);
+
+	int mismatches = 0;
+	for (size_t i=0; i<n; i++) {
+		if (memcmp(&decoded[i], &expected[i], sizeof(double)) != 0) mismatches++;
+	}
+	return(mismatches);
+}
+
+//
+// Check every width on every simple packed sample. Returns the number of
+// errors
+//
+int check_samples() {
+	if (! getenv("GRIB_DEFINITION_PATH")) {
+		setenv("GRIB_DEFINITION_PATH", opt.definitions, 1);
+	}
+
+	DIR *dir = opendir(opt.samples);
+	if (! dir) {
+		cerr << ProgName << " : Can't open " << opt.samples << endl;
+		return(1);
+	}
+	vector <string> files;
+	while (struct dirent *entry = readdir(dir)) {
+		string name = entry->d_name;
+		if (name.size() > 5 && name.substr(name.size()-5) == ".tmpl") {
+			files.push_back(string(opt.samples) + "/" + name);
+		}
+	}
+	closedir(dir);
+
+	int nerrors = 0;
+	int nchecked = 0;
+	double timer[NWidths] = {0.0};
+	for (int f=0; f<files.size(); f++) {
+		FILE *fp = fopen(files[f].c_str(), "rb");
+		if (! fp) {
+			cerr << ProgName << " : Can't open " << files[f] << endl;
+			nerrors++;
+			continue;
+		}
+
+		int err;
+		grib_handle *h;
+		while ((h = grib_handle_new_from_file(0, fp, &err))) {
+			char packing[64];
+			size_t len = sizeof(packing);
+			size_t n = 0;
+			if (grib_get_string(h, "packingType", packing, &len) != 0 ||
+				strcmp(packing, "grid_simple") != 0 ||
+				grib_get_size(h, "values", &n) != 0 ||
+				n > (size_t) opt.maxvalues) {
+
+				grib_handle_delete(h);
+				continue;
+			}
+
+			for (int w=0; w<NWidths; w++) {
+				int mismatches = check_width(h, Widths[w], &timer[w]);
+				if (mismatches < 0) {
+					cerr << files[f] << " : Can't pack " << Widths[w] <<
+						" bit values" << endl;
+					nerrors++;
+				}
+				else if (mismatches > 0) {
+					cerr << files[f] << " : " << Widths[w] << " bits : " <<
+						mismatches << " mismatches" << endl;
+					nerrors++;
+				}
+			}
+			nchecked++;
+			grib_handle_delete(h);
+		}
+		fclose(fp);
+	}
+
+	if (! nchecked) {
+		cerr << ProgName << " : No simple packed samples in " <<
+			opt.samples << endl;
+		return(nerrors + 1);
+	}
+	for (int w=0; w<NWidths; w++) {
+		cout << Widths[w] << " bits : samples decoded in " << timer[w] <<
+			" seconds" << endl;
+	}
+	cout << "Checked " << nchecked << " samples" << endl;
+	return(nerrors);
+}
+#endif
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	srand(opt.seed);
+
+	int nerrors = 0;
+	if (check_offset() < 0) nerrors++;
+
+	for (int w=0; w<NWidths; w++) {
+		double ftime = 0.0;
+		double rtime = 0.0;
+		for (int c=0; c<NCounts; c++) {
+			int mismatches = check(Widths[w], Counts[c], &ftime, &rtime);
+			if (mismatches < 0) nerrors++;
+			else if (mismatches > 0) {
+				cerr << ProgName << " : " << Widths[w] << " bits : " <<
+					mismatches << " mismatches in " << Counts[c] <<
+					" values" << endl;
+				nerrors++;
+			}
+		}
+
+		// Timed field
+		//
+		ftime = rtime = 0.0;
+		int mismatches = check(Widths[w], opt.nvalues, &ftime, &rtime);
+		if (mismatches < 0) nerrors++;
+		else if (mismatches > 0) {
+			cerr << ProgName << " : " << Widths[w] << " bits : " <<
+				mismatches << " mismatches in " << opt.nvalues <<
+				" values" << endl;
+			nerrors++;
+		}
+		cout << Widths[w] << " bits : fast path " << ftime <<
+			" seconds, generic loop " << rtime << " seconds" << endl;
+	}
+
+#ifdef	GRIB_SAMPLES
+	if (strlen(opt.samples)) nerrors += check_samples();
+#endif
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
@@ -0,0 +1,293 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/LayeredGrid.h>
+#include "HistoBuilder.h"
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for HistoBuilder: histograms boxes of a
+// synthetic volume with missing values and compares the bins with
+// ones computed a grid point at a time, the way Histo used to.
+//
+
+struct {
+	int	dim;
+	int	nthreads;
+	int	loop;
+	OptionParser::Boolean_T	layered;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"128",	"Grid dimension along each axis"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"loop",	1, 	"5",	"Number of histograms to build"},
+	{"layered",	0,	"",	"Histogram a layered grid instead of a regular one"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"loop", VetsUtil::CvtToInt, &opt.loop, sizeof(opt.loop)},
+	{"layered", VetsUtil::CvtToBoolean, &opt.layered, sizeof(opt.layered)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float value(double x, double y, double z) {
+	float v = sin(6.0*x) * cos(4.0*y) + z;
+	if (rand() % 13 == 0) v = MissingValue;
+	return(v);
+}
+
+// terrain following coordinate
+//
+double terrain(double x, double y, double z) {
+	double t = 0.1 * sin(3.0*x) * sin(5.0*y);
+	return(t + z * (1.0 - t));
+}
+
+//
+// Grid whose origin, (3,5,7), is not block aligned
+//
+RegularGrid *make_grid(int dim, bool layered, vector <float *> &storage) {
+	size_t min[3] = {3,5,7};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	return(MakeTestGrid(
+		dim, min, extents, value, layered ? terrain : NULL, &MissingValue,
+		storage
+	));
+}
+
+//
+// Grid point at a time reference, quantizing as documented by
+// HistoBuilder
+//
+void build_reference(
+	const RegularGrid *rg, const double exts[6], const float range[2],
+	int numBins, vector <int> &bins
+) {
+	bins.assign(numBins, 0);
+	float scale = (float) (numBins-1) / (range[1] - range[0]);
+
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	for (size_t k=0; k<dims[2]; k++) {
+	for (size_t j=0; j<dims[1]; j++) {
+	for (size_t i=0; i<dims[0]; i++) {
+		float v = rg->AccessIJK(i,j,k);
+		if (v == rg->GetMissingValue()) continue;
+
+		double x, y, z;
+		rg->GetUserCoordinates(i, j, k, &x, &y, &z);
+		if (x < exts[0] || x > exts[3] || y < exts[1] || y > exts[4] ||
+			z < exts[2] || z > exts[5]) continue;
+
+		float q = (v - range[0]) * scale;
+		if (q < 0.f) q = 0.f;
+		if (q > (float) (numBins-1)) q = (float) (numBins-1);
+		bins[(int) rint((double) q)]++;	// ties to even
+	}
+	}
+	}
+}
+
+//
+// Histogram a line of values and check the bin of each against the
+// expected one
+//
+int check_bins(
+	const char *what, const float *values, const int *expected, int n,
+	const float range[2], int numBins
+) {
+	size_t bs[3] = {(size_t) n, 1, 1};
+	size_t min[3] = {0, 0, 0};
+	size_t max[3] = {(size_t) n-1, 0, 0};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+	bool periodic[3] = {false, false, false};
+
+	vector <float> data(values, values+n);
+	float *blks[1] = {&data[0]};
+	RegularGrid rg(bs,min,max,extents,periodic,blks,MissingValue);
+
+	vector <int> reference(numBins, 0), bins;
+	for (int i=0; i<n; i++) {
+		if (expected[i] >= 0) reference[expected[i]]++;
+	}
+
+	HistoBuilder hb(1);
+	if (hb.Build(&rg, extents, range, numBins, bins) < 0 || bins != reference) {
+		cerr << ProgName << " : " << what << " values binned wrongly" << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+//
+// Values on and near bin boundaries, and outside of the range
+//
+int check_edges() {
+	int rc = 0;
+
+	//
+	// Positions are (v-min) * 2. Just below one half, 0.25 - 2^-26 maps
+	// to bin 0, although adding 0.5 in float rounds it up to 1.0. Ties
+	// round to the even bin, as rint() does.
+	//
+	float half = 0.25f - (float) ldexp(1.0, -26);
+	float range0[2] = {0.0, 1.0};
+	float values0[] = {0.0f, half, 0.25f, 0.3f, 0.5f, 0.75f, 1.0f};
+	int expected0[] = {0, 0, 0, 1, 1, 2, 2};
+	if (check_bins(
+		"boundary", values0, expected0, 7, range0, 3) < 0) rc = -1;
+
+	//
+	// A range spanning zero. Values below and above the range count in
+	// the end bins, and missing values and NaNs aren't counted
+	//
+	float inf = (float) HUGE_VAL;
+	float nan = inf - inf;
+	float range1[2] = {-2.0, 2.0};
+	float values1[] = {
+		-2.0f, -1.75f, -1.7499999f, -1.25f, -0.25f, -0.2500001f, 0.0f,
+		1.75f, 2.0f, -5.0f, 3.0f, -inf, inf, nan, MissingValue
+	};
+	int expected1[] = {
+		0, 0, 1, 2, 4, 3, 4,
+		8, 8, 0, 8, 0, 8, -1, -1
+	};
+	if (check_bins(
+		"negative", values1, expected1, 15, range1, 9) < 0) rc = -1;
+
+	return(rc);
+}
+
+int check_cache() {
+	HistoBuilder hb(1, 2);
+	size_t min[3] = {0,0,0};
+	size_t max[3] = {9,9,9};
+	double exts[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+	float range[2] = {0.0, 1.0};
+	vector <int> bins(256, 1), found;
+
+	hb.Insert(0, "u", 0, 0, min, max, exts, range, bins);
+	hb.Insert(1, "u", 0, 0, min, max, exts, range, bins);
+	bins[0] = 2;
+	hb.Insert(0, "u", 0, 0, min, max, exts, range, bins);
+
+	int rc = 0;
+	if (hb.GetNumEntries() != 2) rc = -1;
+	if (! hb.Find(0, "u", 0, 0, min, max, exts, range, 256, found) ||
+		found[0] != 2) rc = -1;
+	range[1] = 2.0;
+	if (hb.Find(0, "u", 0, 0, min, max, exts, range, 256, found)) rc = -1;
+	range[1] = 1.0;
+	hb.Insert(2, "v", 0, 0, min, max, exts, range, bins);
+	if (hb.Find(1, "u", 0, 0, min, max, exts, range, 256, found)) rc = -1;
+	hb.Purge("u");
+	if (hb.GetNumEntries() != 1) rc = -1;
+
+	if (rc < 0) cerr << ProgName << " : histogram cache failed" << endl;
+	return(rc);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	vector <float *> storage;
+	RegularGrid *rg = make_grid(opt.dim, opt.layered, storage);
+
+	double boxes[][6] = {
+		{0.0, 0.0, 0.0, 1.0, 1.0, 1.0},
+		{0.13, 0.27, 0.05, 0.71, 0.66, 0.93},
+		{0.5, -1.0, 0.3, 2.0, 0.5, 0.31},
+		{2.0, 2.0, 2.0, 3.0, 3.0, 3.0}
+	};
+	float range[2] = {-0.5, 1.5};
+	int nboxes = sizeof(boxes) / sizeof(boxes[0]);
+
+	HistoBuilder serial(1);
+	HistoBuilder parallel(opt.nthreads);
+	HistoBuilder *builders[] = {&serial, &parallel};
+
+	int rc = 0;
+	for (int n=0; n<nboxes; n++) {
+		vector <int> reference, bins;
+
+		double t0 = GetTime();
+		build_reference(rg, boxes[n], range, 256, reference);
+		double rtime = GetTime() - t0;
+		size_t dims[3];
+		rg->GetDimensions(dims);
+		cout << "Box " << n << " reference : " <<
+			(double) dims[0]*dims[1]*dims[2] / rtime * 1.0e-6 <<
+			" Mvoxel/s" << endl;
+
+		for (int b=0; b<2; b++) {
+			HistoBuilder *hb = builders[b];
+
+			double best = 0.0;
+			for (int l=0; l<opt.loop; l++) {
+				if (hb->Build(rg, boxes[n], range, 256, bins) < 0) exit(1);
+				if (hb->GetMVoxelsPerSec() > best) best = hb->GetMVoxelsPerSec();
+
+				if (bins != reference) {
+					cerr << ProgName << " : box " << n << 
+						" histogram differs from reference" << endl;
+					rc = 1;
+				}
+			}
+			cout << "HistoBuilder (" << hb->GetNumThreads() << " threads) : " <<
+				best << " Mvoxel/s" << endl;
+		}
+	}
+
+	if (check_cache() < 0) rc = 1;
+	if (check_edges() < 0) rc = 1;
+
+	delete rg;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+
+	exit(rc);
+}
@@ -0,0 +1,425 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include "IBFVFieldCache.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for IBFVFieldCache: half float conversions, look up
+// and least recently used eviction of fields, misses when any part of
+// the probe configuration changes, and the advected mesh, which must
+// match the one computed a vertex at a time with
+// ProbeParams::getIBFVValue(), as the probe used to.
+//
+
+struct {
+	int	width;
+	int	height;
+	int	nmesh;
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"width",	1, 	"97",	"Field width"},
+	{"height",	1, 	"64",	"Field height"},
+	{"nmesh",	1, 	"100",	"Number of mesh vertices along each axis"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"width", VetsUtil::CvtToInt, &opt.width, sizeof(opt.width)},
+	{"height", VetsUtil::CvtToInt, &opt.height, sizeof(opt.height)},
+	{"nmesh", VetsUtil::CvtToInt, &opt.nmesh, sizeof(opt.nmesh)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float bits_to_float(unsigned int bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return(f);
+}
+
+//
+// A field of width x height vectors of magnitude up to about scale
+//
+void make_field(
+	int width, int height, float scale, int seed,
+	vector <float> &u, vector <float> &v, vector <unsigned char> &valid
+) {
+	size_t n = (size_t) width * (size_t) height;
+	u.resize(n);
+	v.resize(n);
+	valid.resize(n);
+	for (int j=0; j<height; j++) {
+	for (int i=0; i<width; i++) {
+		size_t k = (size_t) j * width + i;
+		u[k] = scale * sin(0.1 * i + 0.03 * j + seed);
+		v[k] = scale * cos(0.05 * i - 0.07 * j + seed);
+		valid[k] = (i + j + seed) % 7 != 0;
+	}
+	}
+}
+
+//
+// ProbeParams::getIBFVValue(), before the mesh was advected with
+// IBFVFieldCache::AdvectMesh()
+//
+void get_ibfv_value(
+	const float *ibfvUField, const float *ibfvVField,
+	const int textureSize[2], float fieldScale,
+	float xa, float ya, float* px, float* py
+) {
+	//convert xa and ya to grid coords
+	float x = xa * (float)(textureSize[0]-1);
+	float y = ya * (float)(textureSize[1]-1);
+
+	float xfrac = x - floor(x);
+	float yfrac = y - floor(y);
+	float u00 = ibfvUField[(int)x + textureSize[0]*(int)y];
+	float u10 = ibfvUField[1+(int)x + textureSize[0]*(int)y];
+	float u11 = ibfvUField[1+(int)x + textureSize[0]*(1+(int)y)];
+	float u01 = ibfvUField[(int)x + textureSize[0]*(1+(int)y)];
+
+	float uval = (1.-xfrac)*((1.-yfrac)*u00+yfrac*u01)+
+		xfrac*((1.-yfrac)*u10+yfrac*u11);
+
+	float v00 = ibfvVField[(int)x + textureSize[0]*(int)y];
+	float v10 = ibfvVField[1+(int)x + textureSize[0]*(int)y];
+	float v11 = ibfvVField[1+(int)x + textureSize[0]*(1+(int)y)];
+	float v01 = ibfvVField[(int)x + textureSize[0]*(1+(int)y)];
+	float vval = (1.-xfrac)*((1.-yfrac)*v00+yfrac*v01)+
+		xfrac*((1.-yfrac)*v10+yfrac*v11);
+
+	float r = uval*uval+vval*vval;
+	if (r > 16.f*fieldScale*fieldScale/(textureSize[0]*textureSize[1])) {
+      r  = sqrt(r);
+      uval *= 4.f*fieldScale/(textureSize[0]*r);
+      vval *= 4.f*fieldScale/(textureSize[1]*r);
+   }
+	*px = xa + uval;
+	*py = ya + vval;
+}
+
+//
+// Every half converts to a float and back to itself, and floats round to
+// the nearest half, ties to even
+//
+int test_half() {
+	int nerrors = 0;
+
+	for (unsigned int h=0; h<0x10000; h++) {
+		float f = IBFVFieldCache::HalfToFloat((unsigned short) h);
+		unsigned short h1 = IBFVFieldCache::FloatToHalf(f);
+		bool nan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff);
+		if (nan ? ! (f != f) || (h1 & 0x7fff) <= 0x7c00 : h1 != h) {
+			if (nerrors++ < 10) {
+				fprintf(
+					stderr, "Half 0x%04x : %g converts back to 0x%04x\n",
+					h, f, h1
+				);
+			}
+		}
+	}
+
+	struct {
+		float f;
+		unsigned short h;
+	} cases[] = {
+		{0.0f, 0x0000},
+		{-0.0f, 0x8000},
+		{1.0f, 0x3c00},
+		{-2.0f, 0xc000},
+		{bits_to_float(0x3f801000), 0x3c00},	// 1 + 2^-11, tie to even
+		{bits_to_float(0x3f801001), 0x3c01},
+		{bits_to_float(0x3f803000), 0x3c02},	// 1 + 3*2^-11, tie to even
+		{65504.0f, 0x7bff},
+		{65519.0f, 0x7bff},
+		{65520.0f, 0x7c00},						// rounds to Inf
+		{1.e10f, 0x7c00},
+		{bits_to_float(0x33800000), 0x0001},	// 2^-24
+		{bits_to_float(0x33000000), 0x0000},	// 2^-25, tie to even
+		{bits_to_float(0x33c00000), 0x0002},	// 3*2^-25, tie to even
+		{bits_to_float(0x38800000), 0x0400},	// 2^-14
+		{bits_to_float(0x387fc000), 0x03ff},	// largest subnormal
+		{bits_to_float(0x387fe000), 0x0400},	// ... + 1/2 ulp, tie to even
+		{bits_to_float(0x7f800000), 0x7c00},
+		{bits_to_float(0xff800000), 0xfc00}
+	};
+	for (int i=0; i<sizeof(cases)/sizeof(cases[0]); i++) {
+		unsigned short h = IBFVFieldCache::FloatToHalf(cases[i].f);
+		if (h != cases[i].h) {
+			fprintf(
+				stderr, "FloatToHalf(%g) = 0x%04x, expected 0x%04x\n",
+				cases[i].f, h, cases[i].h
+			);
+			nerrors++;
+		}
+	}
+	return(nerrors);
+}
+
+//
+// Fields are found, only with their own time step, key and size, and the
+// least recently used ones are evicted beyond 16 entries
+//
+int test_lru() {
+	int nerrors = 0;
+	int w = opt.width;
+	int h = opt.height;
+	size_t n = (size_t) w * (size_t) h;
+
+	IBFVFieldCache cache;
+	if (cache.GetMaxEntries() != 16) {
+		cerr << "Default bound " << cache.GetMaxEntries() << " != 16" << endl;
+		nerrors++;
+	}
+
+	vector <double> key(1, 1.0);
+	vector <float> u, v;
+	vector <unsigned char> valid;
+	for (int ts=0; ts<16; ts++) {
+		make_field(w, h, 2.0, ts, u, v, valid);
+		cache.Insert(ts, key, w, h, &u[0], &v[0], &valid[0], (float) ts);
+	}
+
+	vector <float> u1(n), v1(n);
+	vector <unsigned char> valid1(n);
+	float mag;
+
+	//
+	// Every field is found, with its magnitude and validity, and components
+	// within the half precision bound
+	//
+	for (int ts=15; ts>=0; ts--) {
+		if (! cache.Find(ts, key, w, h, &u1[0], &v1[0], &valid1[0], &mag)) {
+			cerr << "Time step " << ts << " not found" << endl;
+			nerrors++;
+			continue;
+		}
+		make_field(w, h, 2.0, ts, u, v, valid);
+		float maxerr = 0.0;
+		for (size_t i=0; i<n; i++) {
+			maxerr = Max(maxerr, (float) fabs(u1[i] - u[i]));
+			maxerr = Max(maxerr, (float) fabs(v1[i] - v[i]));
+		}
+		if (maxerr > 2.0 * 5.e-4 || mag != (float) ts || valid1 != valid) {
+			cerr << "Time step " << ts << " : error " << maxerr <<
+				", magnitude " << mag << endl;
+			nerrors++;
+		}
+	}
+
+	//
+	// Time step 0 is now the most recently used, and 15 the least
+	//
+	make_field(w, h, 2.0, 16, u, v, valid);
+	cache.Insert(16, key, w, h, &u[0], &v[0], &valid[0], 16.0);
+	if (cache.GetNumEntries() != 16) {
+		cerr << cache.GetNumEntries() << " entries" << endl;
+		nerrors++;
+	}
+	if (cache.Find(15, key, w, h, &u1[0], &v1[0], &valid1[0], &mag)) {
+		cerr << "Least recently used time step 15 not evicted" << endl;
+		nerrors++;
+	}
+	for (int ts=0; ts<=16; ts++) {
+		if (ts == 15) continue;
+		if (! cache.Find(ts, key, w, h, &u1[0], &v1[0], &valid1[0], &mag)) {
+			cerr << "Time step " << ts << " evicted" << endl;
+			nerrors++;
+		}
+	}
+
+	//
+	// Other time steps, keys and sizes miss
+	//
+	vector <double> key2(1, 2.0);
+	if (cache.Find(17, key, w, h, &u1[0], &v1[0], &valid1[0], &mag) ||
+		cache.Find(0, key2, w, h, &u1[0], &v1[0], &valid1[0], &mag) ||
+		cache.Find(0, key, h, w, &u1[0], &v1[0], &valid1[0], &mag)) {
+
+		cerr << "Found a field that wasn't inserted" << endl;
+		nerrors++;
+	}
+
+	//
+	// Time steps 16, 14, 13 and 12 are the most recently used
+	//
+	cache.SetMaxEntries(4);
+	if (cache.GetNumEntries() != 4 ||
+		! cache.Find(12, key, w, h, &u1[0], &v1[0], &valid1[0], &mag) ||
+		cache.Find(11, key, w, h, &u1[0], &v1[0], &valid1[0], &mag)) {
+
+		cerr << "SetMaxEntries(4) kept the wrong entries" << endl;
+		nerrors++;
+	}
+	return(nerrors);
+}
+
+//
+// A change to any part of the probe configuration misses
+//
+int test_key() {
+	int nerrors = 0;
+	int w = opt.width;
+	int h = opt.height;
+	size_t n = (size_t) w * (size_t) h;
+
+	float transform[12];
+	for (int i=0; i<12; i++) transform[i] = 0.5f * i - 1.0f;
+	double angles[3] = {10.0, 20.0, 30.0};
+	int varNums[3] = {1, 2, 0};
+	int refLevel = 2;
+	int lod = 1;
+
+	vector <double> key;
+	IBFVFieldCache::MakeKey(transform, angles, varNums, refLevel, lod, key);
+
+	IBFVFieldCache cache;
+	vector <float> u, v;
+	vector <unsigned char> valid;
+	make_field(w, h, 1.0, 0, u, v, valid);
+	cache.Insert(0, key, w, h, &u[0], &v[0], &valid[0], 1.0);
+
+	vector <float> u1(n), v1(n);
+	vector <unsigned char> valid1(n);
+	float mag;
+
+	vector <double> same;
+	IBFVFieldCache::MakeKey(transform, angles, varNums, refLevel, lod, same);
+	if (! cache.Find(0, same, w, h, &u1[0], &v1[0], &valid1[0], &mag)) {
+		cerr << "Same configuration missed" << endl;
+		nerrors++;
+	}
+
+	const char *what[] = {
+		"transform", "angles", "variables", "refinement level", "LOD"
+	};
+	for (int c=0; c<5; c++) {
+		float t[12];
+		for (int i=0; i<12; i++) t[i] = transform[i];
+		double a[3] = {angles[0], angles[1], angles[2]};
+		int vn[3] = {varNums[0], varNums[1], varNums[2]};
+		int r = refLevel;
+		int l = lod;
+		switch (c) {
+		case 0: t[7] += 1.e-3f; break;
+		case 1: a[2] += 1.0; break;
+		case 2: vn[2] = 3; break;
+		case 3: r--; break;
+		case 4: l++; break;
+		}
+
+		vector <double> other;
+		IBFVFieldCache::MakeKey(t, a, vn, r, l, other);
+		if (cache.Find(0, other, w, h, &u1[0], &v1[0], &valid1[0], &mag)) {
+			cerr << "Changing the " << what[c] << " didn't miss" << endl;
+			nerrors++;
+		}
+	}
+	return(nerrors);
+}
+
+//
+// The advected mesh is the one getIBFVValue() gives at x = i*DM, y = j*DM
+//
+int test_advect() {
+	int nerrors = 0;
+	int w = opt.width;
+	int h = opt.height;
+	int nmesh = opt.nmesh;
+	int textureSize[2] = {w, h};
+
+	vector <float> u, v;
+	vector <unsigned char> valid;
+
+	//
+	// Field scales with displacements both clamped and not
+	//
+	float scales[] = {0.02f, 0.25f, 2.0f};
+	for (int s=0; s<sizeof(scales)/sizeof(scales[0]); s++) {
+		make_field(w, h, 0.05f, s, u, v, valid);
+
+		vector <float> mesh(2 * nmesh * nmesh);
+		IBFVFieldCache cache(16, opt.nthreads);
+		cache.AdvectMesh(w, h, &u[0], &v[0], scales[s], nmesh, &mesh[0]);
+
+		float DM = ((float) (0.999999/(nmesh-1.0)));
+		int nbad = 0;
+		for (int i=0; i<nmesh; i++) {
+		for (int j=0; j<nmesh; j++) {
+			float px, py;
+			get_ibfv_value(
+				&u[0], &v[0], textureSize, scales[s], i*DM, j*DM, &px, &py
+			);
+			const float *p = &mesh[2*(j + nmesh*i)];
+			if (p[0] != px || p[1] != py) {
+				if (nbad++ < 10) {
+					cerr << "Scale " << scales[s] << ", vertex (" << i <<
+						"," << j << ") : (" << p[0] << "," << p[1] <<
+						") != (" << px << "," << py << ")" << endl;
+				}
+			}
+		}
+		}
+		if (nbad) nerrors++;
+	}
+	return(nerrors);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int nerrors = 0;
+	nerrors += test_half();
+	nerrors += test_lru();
+	nerrors += test_key();
+	nerrors += test_advect();
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
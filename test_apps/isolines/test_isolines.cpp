@@ -0,0 +1,381 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include "IsolineExtractor.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for IsolineExtractor: extracts circles
+// from a plane holding the distance to its center, and checks that the
+// curves are closed, connected and on the circles, and that threads
+// don't change them. Also checks plane sampling from a grid. No OpenGL
+// context is needed.
+//
+
+struct {
+	int	size;
+	int	nisovals;
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"size",	1, 	"512",	"Plane dimension along each axis"},
+	{"nisovals",1, 	"16",	"Number of isovalues benchmarked"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"size", VetsUtil::CvtToInt, &opt.size, sizeof(opt.size)},
+	{"nisovals", VetsUtil::CvtToInt, &opt.nisovals, sizeof(opt.nisovals)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Distance of each plane point to the center, with a column of missing
+// values if requested
+//
+vector <float> make_plane(int g, bool missing) {
+	vector <float> plane(g*g);
+	for (int j=0; j<g; j++) {
+	for (int i=0; i<g; i++) {
+		double x = -1.0 + 2.0 * i / (g-1);
+		double y = -1.0 + 2.0 * j / (g-1);
+		plane[j*g+i] = sqrt(x*x + y*y);
+		if (missing && i == g/2) plane[j*g+i] = MissingValue;
+	}
+	}
+	return(plane);
+}
+
+bool same_point(const float *p, const float *q) {
+	return(p[0] == q[0] && p[1] == q[1]);
+}
+
+//
+// Index of the end point of segment s shared with segment t, or -1
+//
+int shared_end(const vector <float> &segs, int s, int t) {
+	for (int a=0; a<2; a++) {
+		for (int b=0; b<2; b++) {
+			if (same_point(&segs[4*s+2*a], &segs[4*t+2*b])) return(a);
+		}
+	}
+	return(-1);
+}
+
+//
+// Check that the curves of isovalue iso cover its segments, that
+// consecutive segments are connected, and count the closed curves
+//
+int check_curves(
+	const IsolineExtractor &ex, int iso, const char *name, int *nclosed
+) {
+	const vector <float> &segs = ex.GetSegments(iso);
+	int nsegs = segs.size() / 4;
+
+	vector <int> count(nsegs, 0);
+	*nclosed = 0;
+	for (int c=0; c<ex.GetNumCurves(iso); c++) {
+		int n;
+		const int *curve = ex.GetCurve(iso, c, &n);
+		for (int k=0; k<n; k++) count[curve[k]]++;
+		for (int k=1; k<n; k++) {
+			if (shared_end(segs, curve[k-1], curve[k]) < 0) {
+				cerr << ProgName << " : " << name << " : curve " << c <<
+					" is not connected" << endl;
+				return(-1);
+			}
+		}
+		if (n > 2 && shared_end(segs, curve[n-1], curve[0]) >= 0) {
+			(*nclosed)++;
+		}
+	}
+	for (int s=0; s<nsegs; s++) {
+		if (count[s] != 1) {
+			cerr << ProgName << " : " << name << " : segment " << s <<
+				" is in " << count[s] << " curves" << endl;
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+bool same_results(
+	const IsolineExtractor &a, const IsolineExtractor &b, int nisovals
+) {
+	for (int iso=0; iso<nisovals; iso++) {
+		if (a.GetSegments(iso) != b.GetSegments(iso)) return(false);
+		if (a.GetNumCurves(iso) != b.GetNumCurves(iso)) return(false);
+		for (int c=0; c<a.GetNumCurves(iso); c++) {
+			int na, nb;
+			const int *ca = a.GetCurve(iso, c, &na);
+			const int *cb = b.GetCurve(iso, c, &nb);
+			if (na != nb || memcmp(ca, cb, na * sizeof(int)) != 0) return(false);
+		}
+	}
+	return(true);
+}
+
+//
+// Isolines of the distance are circles: one closed curve per isovalue,
+// whose points are at the isovalue's distance from the center
+//
+int test_circles() {
+	int g = opt.size;
+	vector <float> plane = make_plane(g, false);
+	double h = 2.0 / (g-1);
+
+	vector <double> isovals;
+	isovals.push_back(0.25);
+	isovals.push_back(0.5);
+	isovals.push_back(0.75);
+	isovals.push_back(2.0);		// above the plane's values
+
+	IsolineExtractor serial(1);
+	IsolineExtractor ex(opt.nthreads);
+	if (serial.SetPlane(&plane[0], g, MissingValue) < 0) return(-1);
+	if (ex.SetPlane(&plane[0], g, MissingValue) < 0) return(-1);
+	if (serial.Extract(isovals, true) < 0) return(-1);
+	if (ex.Extract(isovals, true) < 0) return(-1);
+
+	int rc = 0;
+	if (! same_results(serial, ex, isovals.size())) {
+		cerr << ProgName << " : threads change the isolines" << endl;
+		rc = -1;
+	}
+
+	for (int iso=0; iso<isovals.size(); iso++) {
+		const vector <float> &segs = ex.GetSegments(iso);
+		int nclosed;
+		if (check_curves(ex, iso, "circles", &nclosed) < 0) return(-1);
+
+		int ncurves = isovals[iso] < 1.0 ? 1 : 0;
+		if (ex.GetNumCurves(iso) != ncurves || nclosed != ncurves) {
+			cerr << ProgName << " : isovalue " << isovals[iso] << " : " <<
+				ex.GetNumCurves(iso) << " curves, " << nclosed << " closed" <<
+				endl;
+			rc = -1;
+		}
+
+		double maxerr = 0.0;
+		double length = 0.0;
+		for (size_t s=0; s<segs.size(); s+=4) {
+			for (int e=0; e<2; e++) {
+				double r = sqrt(segs[s+2*e]*segs[s+2*e] + segs[s+2*e+1]*segs[s+2*e+1]);
+				maxerr = max(maxerr, fabs(r - isovals[iso]));
+			}
+			length += sqrt(
+				(segs[s+2]-segs[s])*(segs[s+2]-segs[s]) +
+				(segs[s+3]-segs[s+1])*(segs[s+3]-segs[s+1])
+			);
+		}
+		if (ncurves && (maxerr > h/4 ||
+			fabs(length / (2.0 * M_PI * isovals[iso]) - 1.0) > 0.01)) {
+
+			cerr << ProgName << " : isovalue " << isovals[iso] <<
+				" : not a circle (radius error " << maxerr << ", length " <<
+				length << ")" << endl;
+			rc = -1;
+		}
+	}
+	return(rc);
+}
+
+//
+// A column of missing values cuts the circles into two open curves
+//
+int test_missing() {
+	int g = 65;
+	vector <float> plane = make_plane(g, true);
+	vector <double> isovals(1, 0.5);
+
+	IsolineExtractor ex(opt.nthreads);
+	if (ex.SetPlane(&plane[0], g, MissingValue) < 0) return(-1);
+	if (ex.Extract(isovals, true) < 0) return(-1);
+
+	int nclosed;
+	if (check_curves(ex, 0, "missing", &nclosed) < 0) return(-1);
+	if (ex.GetNumCurves(0) != 2 || nclosed != 0) {
+		cerr << ProgName << " : missing values : " << ex.GetNumCurves(0) <<
+			" curves, " << nclosed << " closed" << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+//
+// A saddle cell whose average is on the other side of the isovalue than
+// its first corner separates that corner from its diagonal neighbor
+//
+int test_saddle() {
+	float plane[4] = {1.0, 0.0, 0.0, 1.0};
+	vector <double> isovals(1, 0.5);
+
+	IsolineExtractor ex(1);
+	if (ex.SetPlane(plane, 2, MissingValue) < 0) return(-1);
+	if (ex.Extract(isovals, true) < 0) return(-1);
+
+	const vector <float> &segs = ex.GetSegments(0);
+	float expected[8] = {-1.0, 0.0, 0.0, -1.0, 1.0, 0.0, 0.0, 1.0};
+	if (segs.size() != 8 || ex.GetNumCurves(0) != 2 ||
+		memcmp(&segs[0], expected, sizeof(expected)) != 0) {
+
+		cerr << ProgName << " : wrong saddle segments" << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+//
+// Sample a plane through a grid holding a linear function, which
+// trilinear interpolation reproduces
+//
+int test_sample() {
+	size_t bs[3] = {32,32,32};
+	size_t min[3] = {0,0,0};
+	size_t max[3] = {40,40,40};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+	bool periodic[3] = {false, false, false};
+
+	size_t nblocks = 8;
+	size_t bsize = bs[0]*bs[1]*bs[2];
+	vector <float> data(nblocks*bsize);
+	float *blks[8];
+	for (size_t b=0; b<nblocks; b++) blks[b] = &data[b*bsize];
+
+	RegularGrid rg(bs,min,max,extents,periodic,blks,MissingValue);
+	rg.SetInterpolationOrder(1);
+	for (int k=0; k<=max[2]; k++) {
+	for (int j=0; j<=max[1]; j++) {
+	for (int i=0; i<=max[0]; i++) {
+		rg.AccessIJK(i,j,k) = (i + 2.0*j + 3.0*k) / max[0];
+	}
+	}
+	}
+
+	//
+	// Tilted plane, partly outside of the bounds
+	//
+	int g = 101;
+	double origin[3] = {0.1, 0.2, 0.3};
+	double du[3] = {0.8/(g-1), 0.0, 0.2/(g-1)};
+	double dv[3] = {0.0, 0.7/(g-1), 0.0};
+	double bounds[6] = {0.0, 0.0, 0.0, 1.0, 0.8, 1.0};
+
+	IsolineExtractor serial(1);
+	IsolineExtractor ex(opt.nthreads);
+	if (serial.SamplePlane(&rg, g, origin, du, dv, bounds) < 0) return(-1);
+	if (ex.SamplePlane(&rg, g, origin, du, dv, bounds) < 0) return(-1);
+
+	if (memcmp(serial.GetPlane(), ex.GetPlane(), g*g*sizeof(float)) != 0) {
+		cerr << ProgName << " : threads change the samples" << endl;
+		return(-1);
+	}
+
+	const float *plane = ex.GetPlane();
+	double maxerr = 0.0;
+	int nmissing = 0;
+	for (int j=0; j<g; j++) {
+	for (int i=0; i<g; i++) {
+		double p[3];
+		for (int k=0; k<3; k++) p[k] = origin[k] + i*du[k] + j*dv[k];
+		float v = plane[j*g+i];
+		if (p[1] > bounds[4]) {
+			if (v != MissingValue) maxerr = 1.0;
+			nmissing++;
+			continue;
+		}
+		maxerr = std::max(maxerr, fabs(v - (p[0] + 2.0*p[1] + 3.0*p[2])));
+	}
+	}
+	if (maxerr > 1e-5 || nmissing == 0) {
+		cerr << ProgName << " : wrong samples (error " << maxerr << ")" << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+void benchmark() {
+	int g = opt.size;
+	vector <float> plane = make_plane(g, false);
+	vector <double> isovals;
+	for (int iso=0; iso<opt.nisovals; iso++) {
+		isovals.push_back(1.4 * (iso + 0.5) / opt.nisovals);
+	}
+
+	IsolineExtractor serial(1);
+	IsolineExtractor ex(opt.nthreads);
+	IsolineExtractor *exs[] = {&serial, &ex};
+	double times[2];
+	size_t nsegs = 0;
+	for (int e=0; e<2; e++) {
+		exs[e]->SetPlane(&plane[0], g, MissingValue);
+		double t0 = GetTime();
+		exs[e]->Extract(isovals, true);
+		times[e] = GetTime() - t0;
+	}
+	for (int iso=0; iso<isovals.size(); iso++) {
+		nsegs += ex.GetSegments(iso).size() / 4;
+	}
+	double ncells = (double) (g-1) * (g-1) * isovals.size();
+	cout << g << "x" << g << " plane, " << isovals.size() << " isovalues : " <<
+		nsegs << " segments, " << ncells / times[0] * 1e-6 <<
+		" Mcell/s (1 thread), " << ncells / times[1] * 1e-6 << " Mcell/s (" <<
+		ex.GetNumThreads() << " threads)" << endl;
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int rc = 0;
+	if (test_circles() < 0) rc = 1;
+	if (test_missing() < 0) rc = 1;
+	if (test_saddle() < 0) rc = 1;
+	if (test_sample() < 0) rc = 1;
+
+	benchmark();
+
+	exit(rc);
+}
@@ -0,0 +1,370 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/LayeredGrid.h>
+#include "IsoExtractor.h"
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for IsoExtractor: extracts spheres from
+// a distance field, on regular and layered grids, and checks that the
+// meshes are closed, consistently oriented, and on the sphere, and that
+// the octree and threads don't change them. No OpenGL context is needed.
+//
+
+struct {
+	int	dim;
+	int	nthreads;
+	char *file;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"70",	"Grid dimension along each axis"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"file",	1, 	"/tmp/test_isosurf",	"Base name of the mesh files written"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"file", VetsUtil::CvtToString, &opt.file, sizeof(opt.file)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+const double Radius = 0.6;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float sphere(double x, double y, double z) {
+	return(Radius - sqrt(x*x + y*y + z*z));
+}
+
+float xvalue(double x, double, double) {
+	return(x);
+}
+
+double zvalue(double, double, double z) {
+	return(z);
+}
+
+//
+// Grid over [-1,1]^3, whose origin, (3,5,7), is not block aligned, holding
+// Radius minus the distance from the origin, or the x coordinate
+//
+RegularGrid *make_grid(
+	int dim, bool layered, bool xcoord, vector <float *> &storage
+) {
+	size_t min[3] = {3,5,7};
+	double extents[6] = {-1.0, -1.0, -1.0, 1.0, 1.0, 1.0};
+
+	return(MakeTestGrid(
+		dim, min, extents, xcoord ? xvalue : sphere,
+		layered ? zvalue : NULL, NULL, storage
+	));
+}
+
+//
+// Triangles as coordinates, rotated so that the smallest vertex comes
+// first, and sorted
+//
+vector <vector <float> > canonical(const IsoMesh &mesh) {
+	vector <vector <float> > tris;
+	for (size_t t=0; t<mesh.GetNumTriangles(); t++) {
+		vector <float> v[3];
+		for (int i=0; i<3; i++) {
+			const float *p = &mesh.verts[mesh.tris[t*3+i]*3];
+			v[i].assign(p, p+3);
+		}
+		int first = 0;
+		for (int i=1; i<3; i++) if (v[i] < v[first]) first = i;
+
+		vector <float> tri;
+		for (int i=0; i<3; i++) {
+			tri.insert(tri.end(), v[(first+i)%3].begin(), v[(first+i)%3].end());
+		}
+		tris.push_back(tri);
+	}
+	sort(tris.begin(), tris.end());
+	return(tris);
+}
+
+//
+// Every directed edge must appear once, and its reverse once
+//
+bool closed(const IsoMesh &mesh) {
+	map <pair <unsigned int, unsigned int>, int> edges;
+	for (size_t t=0; t<mesh.GetNumTriangles(); t++) {
+		for (int i=0; i<3; i++) {
+			unsigned int a = mesh.tris[t*3+i];
+			unsigned int b = mesh.tris[t*3+(i+1)%3];
+			edges[make_pair(a,b)]++;
+		}
+	}
+	map <pair <unsigned int, unsigned int>, int>::iterator itr;
+	for (itr = edges.begin(); itr != edges.end(); ++itr) {
+		if (itr->second != 1) return(false);
+		pair <unsigned int, unsigned int> rev(itr->first.second, itr->first.first);
+		if (edges.find(rev) == edges.end()) return(false);
+	}
+	return(true);
+}
+
+int test_sphere(const RegularGrid *rg, const char *name) {
+	IsoExtractor ref(1);
+	IsoExtractor ex(opt.nthreads);
+
+	ref.SetSkipping(false);
+	ref.SetNormals(true);
+	ex.SetNormals(true);
+
+	double t0 = GetTime();
+	if (ex.SetGrid(rg) < 0) return(-1);
+	double otime = GetTime() - t0;
+	if (ref.SetGrid(rg) < 0) return(-1);
+
+	IsoMesh rmesh, mesh;
+	t0 = GetTime();
+	if (ref.Extract(0.0, &rmesh) < 0) return(-1);
+	double rtime = GetTime() - t0;
+
+	t0 = GetTime();
+	if (ex.Extract(0.0, &mesh) < 0) return(-1);
+	double etime = GetTime() - t0;
+
+	int rc = 0;
+	if (canonical(mesh) != canonical(rmesh)) {
+		cerr << ProgName << " : " << name <<
+			" mesh differs without block skipping" << endl;
+		rc = -1;
+	}
+
+	// The same extraction with one thread
+	//
+	IsoExtractor single(1);
+	single.SetNormals(true);
+	IsoMesh smesh;
+	if (single.SetGrid(rg) < 0 || single.Extract(0.0, &smesh) < 0) return(-1);
+	if (smesh.verts != mesh.verts || smesh.tris != mesh.tris ||
+		smesh.normals != mesh.normals) {
+
+		cerr << ProgName << " : " << name <<
+			" mesh depends on number of threads" << endl;
+		rc = -1;
+	}
+
+	if (mesh.GetNumTriangles() == 0 || ! closed(mesh)) {
+		cerr << ProgName << " : " << name << " mesh not closed" << endl;
+		rc = -1;
+	}
+
+	// Vertices are shared
+	//
+	vector <vector <float> > verts;
+	for (size_t v=0; v<mesh.GetNumVertices(); v++) {
+		verts.push_back(vector <float> (&mesh.verts[v*3], &mesh.verts[v*3+3]));
+	}
+	sort(verts.begin(), verts.end());
+	if (adjacent_find(verts.begin(), verts.end()) != verts.end()) {
+		cerr << ProgName << " : " << name << " duplicate vertices" << endl;
+		rc = -1;
+	}
+
+	// Vertices are on the sphere, with outward normals, and the
+	// triangles enclose its volume
+	//
+	double h = 2.0 / (opt.dim - 1);
+	double maxerr = 0.0;
+	double mindot = 1.0;
+	for (size_t v=0; v<mesh.GetNumVertices(); v++) {
+		const float *p = &mesh.verts[v*3];
+		const float *n = &mesh.normals[v*3];
+		double r = sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+		maxerr = max(maxerr, fabs(r - Radius));
+		mindot = min(mindot, (p[0]*n[0] + p[1]*n[1] + p[2]*n[2]) / r);
+	}
+	double volume = 0.0;
+	for (size_t t=0; t<mesh.GetNumTriangles(); t++) {
+		const float *a = &mesh.verts[mesh.tris[t*3]*3];
+		const float *b = &mesh.verts[mesh.tris[t*3+1]*3];
+		const float *c = &mesh.verts[mesh.tris[t*3+2]*3];
+		volume += (
+			a[0] * (b[1]*c[2] - b[2]*c[1]) -
+			a[1] * (b[0]*c[2] - b[2]*c[0]) +
+			a[2] * (b[0]*c[1] - b[1]*c[0])
+		) / 6.0;
+	}
+	double exact = 4.0 / 3.0 * M_PI * Radius * Radius * Radius;
+	if (maxerr > 0.5 * h || mindot < 0.9 || fabs(volume - exact) > 0.02 * exact) {
+		cerr << ProgName << " : " << name << " mesh not on sphere (error " <<
+			maxerr << ", normal " << mindot << ", volume " << volume <<
+			", expected " << exact << ")" << endl;
+		rc = -1;
+	}
+
+	double ntris = mesh.GetNumTriangles();
+	cout << name << " : " << mesh.GetNumTriangles() << " triangles, " <<
+		mesh.GetNumVertices() << " vertices, " << ex.GetNumActiveBlocks() <<
+		" of " << ex.GetNumBlocks() << " blocks" << endl;
+	cout << "  octree " << otime << " s, " << ex.GetMemoryUsage() <<
+		" bytes; mesh " << mesh.GetMemoryUsage() << " bytes" << endl;
+	cout << "  all blocks (1 thread) " << ntris / rtime * 1.0e-6 <<
+		" Mtri/s, octree (" << ex.GetNumThreads() << " threads) " <<
+		ntris / etime * 1.0e-6 << " Mtri/s" << endl;
+
+	return(rc);
+}
+
+//
+// Map the x coordinate onto the sphere, and export it
+//
+int test_map(const RegularGrid *rg, const RegularGrid *xg) {
+	IsoExtractor ex(opt.nthreads);
+
+	float ctab[256][4];
+	for (int i=0; i<256; i++) {
+		ctab[i][0] = i / 255.0;
+		ctab[i][1] = 0.0;
+		ctab[i][2] = 1.0 - i / 255.0;
+		ctab[i][3] = 1.0;
+	}
+	float range[2] = {-1.0, 1.0};
+
+	if (ex.SetGrid(rg) < 0) return(-1);
+	if (ex.SetMapGrid(xg) < 0) return(-1);
+	ex.SetColorMap(ctab, range);
+	ex.SetNormals(true);
+
+	IsoMesh mesh;
+	if (ex.Extract(0.0, &mesh) < 0) return(-1);
+
+	int rc = 0;
+	size_t nverts = mesh.GetNumVertices();
+	if (mesh.values.size() != nverts || mesh.colors.size() != nverts*4) {
+		cerr << ProgName << " : mapped values missing" << endl;
+		return(-1);
+	}
+	for (size_t v=0; v<nverts; v++) {
+		float x = mesh.verts[v*3];
+		int red = (int) ((x + 1.0) / 2.0 * 255.0 + 0.5);
+		if (fabs(mesh.values[v] - x) > 1.0e-5 ||
+			abs((int) mesh.colors[v*4] - red) > 1) {
+
+			cerr << ProgName << " : wrong mapped value " << mesh.values[v] <<
+				" at x = " << x << endl;
+			rc = -1;
+			break;
+		}
+	}
+
+	// A binary PLY file holds 12 bytes of coordinates, 12 of normals and
+	// 4 of color per vertex, and 13 bytes per triangle
+	//
+	string ply = string(opt.file) + ".ply";
+	string obj = string(opt.file) + ".obj";
+	double t0 = GetTime();
+	if (mesh.WritePLY(ply) < 0) return(-1);
+	double ptime = GetTime() - t0;
+	t0 = GetTime();
+	if (mesh.WriteOBJ(obj) < 0) return(-1);
+	double otime = GetTime() - t0;
+
+	FILE *fp = fopen(ply.c_str(), "rb");
+	if (! fp) return(-1);
+	vector <char> header(4096);
+	size_t n = fread(&header[0], 1, header.size()-1, fp);
+	header[n] = '\0';
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fclose(fp);
+
+	const char *end = strstr(&header[0], "end_header\n");
+	long expected = (end ? end - &header[0] + 11 : 0) +
+		nverts * 28 + mesh.GetNumTriangles() * 13;
+	if (! end || size != expected) {
+		cerr << ProgName << " : PLY file size " << size << ", expected " <<
+			expected << endl;
+		rc = -1;
+	}
+
+	// The OBJ file has a line per vertex, normal and triangle
+	//
+	fp = fopen(obj.c_str(), "r");
+	if (! fp) return(-1);
+	size_t lines = 0;
+	int c;
+	while ((c = fgetc(fp)) != EOF) if (c == '\n') lines++;
+	fclose(fp);
+	if (lines != 1 + 2*nverts + mesh.GetNumTriangles()) {
+		cerr << ProgName << " : OBJ file has " << lines << " lines" << endl;
+		rc = -1;
+	}
+
+	cout << "PLY " << size / ptime * 1.0e-6 << " MB/s, OBJ " <<
+		mesh.GetNumTriangles() / otime * 1.0e-6 << " Mtri/s" << endl;
+
+	remove(ply.c_str());
+	remove(obj.c_str());
+	return(rc);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int rc = 0;
+	vector <float *> storage;
+	RegularGrid *rg = make_grid(opt.dim, false, false, storage);
+	RegularGrid *lg = make_grid(opt.dim, true, false, storage);
+	RegularGrid *xg = make_grid(opt.dim, false, true, storage);
+
+	if (test_sphere(rg, "Regular grid") < 0) rc = 1;
+	if (test_sphere(lg, "Layered grid") < 0) rc = 1;
+	if (test_map(rg, xg) < 0) rc = 1;
+
+	delete rg;
+	delete lg;
+	delete xg;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+
+	exit(rc);
+}
@@ -0,0 +1,502 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/LayeredGrid.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Test of LayeredGrid point location. The results of GetIJKIndexFloor(),
+// GetIJKIndex(), InsideGrid() and GetValue() are compared with a
+// straightforward implementation of the bisection search the class used
+// before it kept per-column coordinate tables. That search read the
+// coordinate blocks directly; the tables have missing coordinates filled
+// in as by GetUserCoordinates(). So with no missing coordinates the
+// reference reads the raw coordinates, and with missing coordinates it
+// reads GetUserCoordinates().
+//
+
+struct {
+	int	npoints;
+	int	seed;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"npoints",	1, 	"20000","Number of random points per test"},
+	{"seed",	1, 	"1",	"Random number seed"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"npoints", VetsUtil::CvtToInt, &opt.npoints, sizeof(opt.npoints)},
+	{"seed", VetsUtil::CvtToInt, &opt.seed, sizeof(opt.seed)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// The grid under test along with a copy of its raw coordinates
+//
+struct TestGrid {
+	LayeredGrid *lg;
+	size_t dims[3];
+	int vd;
+	vector <float> coords;	// raw varying coordinates, i fastest
+	vector <float *> storage;
+	bool use_raw;	// reference reads coords rather than the grid
+
+	double Raw(const size_t ijk[3]) const {
+		return(coords[(ijk[2]*dims[1] + ijk[1])*dims[0] + ijk[0]]);
+	}
+	double C(size_t i, size_t j, size_t k) const {
+		size_t ijk[] = {i,j,k};
+		if (use_raw) return(Raw(ijk));
+		double xyz[3];
+		lg->GetUserCoordinates(i,j,k, &xyz[0], &xyz[1], &xyz[2]);
+		return(xyz[vd]);
+	}
+};
+
+double frand() {
+	return((double) rand() / (double) RAND_MAX);
+}
+
+//
+// Build a 13x11x9 layered grid of 8^3 blocks, varying along dimension
+// vd. The varying coordinate increases (or, if flip, decreases) with
+// the varying index, and is perturbed from column to column. If
+// missing is true the two lowest points of some columns, and all of
+// one column, have missing coordinates.
+//
+void make_grid(TestGrid *tg, int vd, bool flip, bool missing) {
+	size_t bs[3] = {8,8,8};
+	size_t dims[3] = {13,11,9};
+	size_t min[3] = {0,0,0};
+	size_t max[3] = {dims[0]-1, dims[1]-1, dims[2]-1};
+	bool periodic[3] = {false, false, false};
+	double extents[6] = {-1.0, 0.0, 2.0, 1.0, 3.0, 5.0};
+
+	size_t nblocks = 1;
+	for (int i=0; i<3; i++) nblocks *= (dims[i]+bs[i]-1) / bs[i];
+
+	float **blks = new float*[nblocks];
+	float **cblks = new float*[nblocks];
+	for (size_t b=0; b<nblocks; b++) {
+		blks[b] = new float[bs[0]*bs[1]*bs[2]];
+		cblks[b] = new float[bs[0]*bs[1]*bs[2]];
+		tg->storage.push_back(blks[b]);
+		tg->storage.push_back(cblks[b]);
+	}
+
+	tg->vd = vd;
+	for (int i=0; i<3; i++) tg->dims[i] = dims[i];
+	tg->coords.resize(dims[0]*dims[1]*dims[2]);
+
+	RegularGrid cg(bs, min, max, extents, periodic, cblks);
+	int a = vd == 0 ? 1 : 0;
+	int b = vd == 2 ? 1 : 2;
+	size_t nl = dims[vd];
+	double l0 = extents[vd];
+	double dl = (extents[vd+3] - extents[vd]) / (double) (nl-1);
+
+	for (size_t k=0; k<dims[2]; k++) {
+	for (size_t j=0; j<dims[1]; j++) {
+	for (size_t i=0; i<dims[0]; i++) {
+		size_t ijk[] = {i,j,k};
+		size_t l = flip ? nl-1-ijk[vd] : ijk[vd];
+		double wiggle = 0.4*sin(0.5*ijk[a] + 0.3*ijk[b]);
+		float c = l0 + dl * (l + wiggle * l / (double) (nl-1));
+
+		if (missing) {
+			if (ijk[a] % 3 == 1 && ijk[b] % 2 == 0 && ijk[vd] < 2) {
+				c = MissingValue;
+			}
+			if (ijk[a] == 5 && ijk[b] == 4) c = MissingValue;
+		}
+		cg.AccessIJK(i,j,k) = c;
+		tg->coords[(k*dims[1] + j)*dims[0] + i] = c;
+	}
+	}
+	}
+
+	if (missing) {
+		tg->lg = new LayeredGrid(
+			bs, min, max, extents, periodic, blks, cblks, vd, MissingValue
+		);
+	}
+	else {
+		tg->lg = new LayeredGrid(
+			bs, min, max, extents, periodic, blks, cblks, vd
+		);
+	}
+	tg->use_raw = ! missing;
+
+	for (size_t k=0; k<dims[2]; k++) {
+	for (size_t j=0; j<dims[1]; j++) {
+	for (size_t i=0; i<dims[0]; i++) {
+		tg->lg->AccessIJK(i,j,k) = (float) (i + 2*j + 3*k);
+	}
+	}
+	}
+	delete [] blks;
+	delete [] cblks;
+}
+
+void free_grid(TestGrid *tg) {
+	delete tg->lg;
+	for (int i=0; i<tg->storage.size(); i++) delete [] tg->storage[i];
+	tg->storage.clear();
+}
+
+//
+// Varying coordinate of the point xyz interpolated from the four
+// corners of the face of cell ijk0 spanned by the non-varying dimensions
+//
+double ref_interp(const TestGrid &tg, const size_t ijk0[3], const double xyz[3]) {
+	size_t ijk1[3];
+	for (int i=0; i<3; i++) {
+		ijk1[i] = ijk0[i] == tg.dims[i]-1 ? ijk0[i] : ijk0[i]+1;
+	}
+	double xyz0[3], xyz1[3];
+	tg.lg->RegularGrid::GetUserCoordinates(
+		ijk0[0],ijk0[1],ijk0[2], &xyz0[0], &xyz0[1], &xyz0[2]
+	);
+	tg.lg->RegularGrid::GetUserCoordinates(
+		ijk1[0],ijk1[1],ijk1[2], &xyz1[0], &xyz1[1], &xyz1[2]
+	);
+
+	int a = tg.vd == 0 ? 1 : 0;
+	int b = tg.vd == 2 ? 1 : 2;
+	size_t c[4][3];
+	for (int n=0; n<4; n++) {
+		c[n][tg.vd] = ijk0[tg.vd];
+		c[n][a] = n & 1 ? ijk1[a] : ijk0[a];
+		c[n][b] = n & 2 ? ijk1[b] : ijk0[b];
+	}
+	double c00 = tg.C(c[0][0], c[0][1], c[0][2]);
+	double c01 = tg.C(c[1][0], c[1][1], c[1][2]);
+	double c10 = tg.C(c[2][0], c[2][1], c[2][2]);
+	double c11 = tg.C(c[3][0], c[3][1], c[3][2]);
+
+	double iwgt = 0.0, jwgt = 0.0;
+	if (xyz1[a]!=xyz0[a]) iwgt = fabs((xyz[a]-xyz0[a]) / (xyz1[a]-xyz0[a]));
+	if (xyz1[b]!=xyz0[b]) jwgt = fabs((xyz[b]-xyz0[b]) / (xyz1[b]-xyz0[b]));
+
+	return(c00+iwgt*(c01-c00) + jwgt*((c10+iwgt*(c11-c10))-(c00+iwgt*(c01-c00))));
+}
+
+void ref_floor(const TestGrid &tg, const double xyz[3], size_t ijk[3]) {
+	tg.lg->RegularGrid::GetIJKIndexFloor(
+		xyz[0], xyz[1], xyz[2], &ijk[0], &ijk[1], &ijk[2]
+	);
+	int vd = tg.vd;
+	double vc = xyz[vd];
+
+	size_t l0 = 0;
+	size_t l1 = tg.dims[vd]-1;
+	ijk[vd] = l0;
+	double v0 = ref_interp(tg, ijk, xyz);
+	ijk[vd] = l1;
+	double v1 = ref_interp(tg, ijk, xyz);
+
+	if ((vc-v0) * (vc-v1) >= 0.0) {
+		if (v0<=v1) ijk[vd] = vc<=v0 ? 0 : l1;
+		else ijk[vd] = vc>=v0 ? 0 : l1;
+		return;
+	}
+
+	while (l1-l0 > 1) {
+		ijk[vd] = (l0+l1)>>1;
+		v1 = ref_interp(tg, ijk, xyz);
+		if (v1 == vc) {
+			l0 = (l0+l1)>>1;
+			break;
+		}
+		if ((vc-v0) * (vc-v1) <= 0.0) {
+			l1 = (l0+l1)>>1;
+		}
+		else {
+			l0 = (l0+l1)>>1;
+			v0 = v1;
+		}
+	}
+	ijk[vd] = l0;
+}
+
+void ref_index(const TestGrid &tg, const double xyz[3], size_t ijk[3]) {
+	tg.lg->RegularGrid::GetIJKIndex(
+		xyz[0], xyz[1], xyz[2], &ijk[0], &ijk[1], &ijk[2]
+	);
+	size_t ijk0[3];
+	ref_floor(tg, xyz, ijk0);
+
+	int vd = tg.vd;
+	if (ijk0[vd] == tg.dims[vd]-1) {
+		ijk[vd] = ijk0[vd];
+		return;
+	}
+	double c0 = ref_interp(tg, ijk0, xyz);
+	ijk0[vd]++;
+	double c1 = ref_interp(tg, ijk0, xyz);
+	ijk0[vd]--;
+	ijk[vd] = fabs(xyz[vd]-c0) < fabs(xyz[vd]-c1) ? ijk0[vd] : ijk0[vd]+1;
+}
+
+bool ref_inside(const TestGrid &tg, const double xyz[3]) {
+	double extents[6];
+	tg.lg->GetUserExtents(extents);
+	for (int i=0; i<3; i++) {
+		double lo = extents[i] < extents[i+3] ? extents[i] : extents[i+3];
+		double hi = extents[i] < extents[i+3] ? extents[i+3] : extents[i];
+		if (xyz[i] < lo || xyz[i] > hi) return(false);
+	}
+
+	size_t ijk[3];
+	tg.lg->RegularGrid::GetIJKIndexFloor(
+		xyz[0], xyz[1], xyz[2], &ijk[0], &ijk[1], &ijk[2]
+	);
+	ijk[tg.vd] = 0;
+	double bot = ref_interp(tg, ijk, xyz);
+	ijk[tg.vd] = tg.dims[tg.vd]-1;
+	double top = ref_interp(tg, ijk, xyz);
+
+	double vc = xyz[tg.vd];
+	if (bot < top) return(vc >= bot && vc <= top);
+	return(vc <= bot && vc >= top);
+}
+
+//
+// Trilinear interpolation, last along the varying dimension, of the
+// field i + 2j + 3k, which is represented exactly
+//
+double ref_value(const TestGrid &tg, const double xyz[3]) {
+	if (! ref_inside(tg, xyz)) return(tg.lg->GetMissingValue());
+
+	size_t ijk0[3], ijk1[3];
+	ref_floor(tg, xyz, ijk0);
+	for (int i=0; i<3; i++) {
+		ijk1[i] = ijk0[i] == tg.dims[i]-1 ? ijk0[i] : ijk0[i]+1;
+	}
+
+	double xyz0[3], xyz1[3];
+	tg.lg->RegularGrid::GetUserCoordinates(
+		ijk0[0],ijk0[1],ijk0[2], &xyz0[0], &xyz0[1], &xyz0[2]
+	);
+	tg.lg->RegularGrid::GetUserCoordinates(
+		ijk1[0],ijk1[1],ijk1[2], &xyz1[0], &xyz1[1], &xyz1[2]
+	);
+	xyz0[tg.vd] = ref_interp(tg, ijk0, xyz);
+	size_t ijkv[] = {ijk0[0], ijk0[1], ijk0[2]};
+	ijkv[tg.vd] = ijk1[tg.vd];
+	xyz1[tg.vd] = ref_interp(tg, ijkv, xyz);
+
+	double v = 0.0;
+	double wgt[3];
+	for (int i=0; i<3; i++) {
+		wgt[i] = xyz1[i]!=xyz0[i] ? fabs((xyz[i]-xyz0[i])/(xyz1[i]-xyz0[i])) : 0.0;
+		double scale = i == 0 ? 1.0 : (i == 1 ? 2.0 : 3.0);
+		v += scale * (ijk0[i] + wgt[i] * (ijk1[i] - ijk0[i]));
+	}
+	return(v);
+}
+
+//
+// Compare the grid with the reference at the point xyz
+//
+int compare(const TestGrid &tg, const double xyz[3]) {
+	const LayeredGrid *lg = tg.lg;
+	double x = xyz[0], y = xyz[1], z = xyz[2];
+	int nerrors = 0;
+
+	size_t ijk[3], rijk[3];
+	lg->GetIJKIndexFloor(x,y,z, &ijk[0], &ijk[1], &ijk[2]);
+	ref_floor(tg, xyz, rijk);
+	if (ijk[0]!=rijk[0] || ijk[1]!=rijk[1] || ijk[2]!=rijk[2]) {
+		fprintf(stderr, "GetIJKIndexFloor(%f,%f,%f) : (%d,%d,%d) != (%d,%d,%d)\n",
+			x,y,z, (int) ijk[0], (int) ijk[1], (int) ijk[2],
+			(int) rijk[0], (int) rijk[1], (int) rijk[2]
+		);
+		nerrors++;
+	}
+
+	lg->GetIJKIndex(x,y,z, &ijk[0], &ijk[1], &ijk[2]);
+	ref_index(tg, xyz, rijk);
+	if (ijk[0]!=rijk[0] || ijk[1]!=rijk[1] || ijk[2]!=rijk[2]) {
+		fprintf(stderr, "GetIJKIndex(%f,%f,%f) : (%d,%d,%d) != (%d,%d,%d)\n",
+			x,y,z, (int) ijk[0], (int) ijk[1], (int) ijk[2],
+			(int) rijk[0], (int) rijk[1], (int) rijk[2]
+		);
+		nerrors++;
+	}
+
+	bool inside = lg->InsideGrid(x,y,z);
+	if (inside != ref_inside(tg, xyz)) {
+		fprintf(stderr, "InsideGrid(%f,%f,%f) : %d\n", x,y,z, (int) inside);
+		nerrors++;
+	}
+
+	//
+	// GetValue() applies the weights of the non-varying dimensions to
+	// the i and j indecies, which only matches the reference when k is
+	// the varying dimension
+	//
+	if (tg.vd != 2) return(nerrors);
+
+	double v = lg->GetValue(x,y,z);
+	double rv = ref_value(tg, xyz);
+	if (fabs(v - rv) > 1.e-4 * (fabs(rv) + 1.0)) {
+		fprintf(stderr, "GetValue(%f,%f,%f) : %f != %f\n", x,y,z, v, rv);
+		nerrors++;
+	}
+	return(nerrors);
+}
+
+//
+// Random points in and around the grid, trajectories through it (which
+// mostly hit the cell found by the previous search), and the grid
+// points themselves (where the bisection finds exact matches)
+//
+int test_grid(int vd, bool flip, bool missing) {
+	TestGrid tg;
+	make_grid(&tg, vd, flip, missing);
+
+	int nerrors = 0;
+	double extents[6];
+	tg.lg->GetUserExtents(extents);
+	double lo[3], hi[3];
+	for (int i=0; i<3; i++) {
+		double pad = 0.05 * fabs(extents[i+3]-extents[i]);
+		lo[i] = (extents[i] < extents[i+3] ? extents[i] : extents[i+3]) - pad;
+		hi[i] = (extents[i] < extents[i+3] ? extents[i+3] : extents[i]) + pad;
+	}
+
+	for (int n=0; n<opt.npoints; n++) {
+		double xyz[3];
+		for (int i=0; i<3; i++) xyz[i] = lo[i] + frand() * (hi[i]-lo[i]);
+		nerrors += compare(tg, xyz);
+	}
+
+	for (int t=0; t<20; t++) {
+		double xyz[3], dxyz[3];
+		for (int i=0; i<3; i++) {
+			xyz[i] = lo[i] + frand() * (hi[i]-lo[i]);
+			dxyz[i] = (frand() - 0.5) * (hi[i]-lo[i]) / 200.0;
+		}
+		for (int n=0; n<opt.npoints/100; n++) {
+			nerrors += compare(tg, xyz);
+			for (int i=0; i<3; i++) xyz[i] += dxyz[i];
+		}
+	}
+
+	for (size_t k=0; k<tg.dims[2]; k++) {
+	for (size_t j=0; j<tg.dims[1]; j++) {
+	for (size_t i=0; i<tg.dims[0]; i++) {
+		double xyz[3];
+		tg.lg->GetUserCoordinates(i,j,k, &xyz[0], &xyz[1], &xyz[2]);
+		nerrors += compare(tg, xyz);
+	}
+	}
+	}
+
+	//
+	// Missing coordinates are replaced by the nearest valid one below,
+	// or failing that above, in the same column, or by the minimum
+	// extent if the column has none
+	//
+	if (missing) {
+		for (size_t k=0; k<tg.dims[2]; k++) {
+		for (size_t j=0; j<tg.dims[1]; j++) {
+		for (size_t i=0; i<tg.dims[0]; i++) {
+			size_t ijk[] = {i,j,k};
+			size_t l0 = ijk[vd];
+			double expected = MissingValue;
+			for (size_t l=l0+1; l>0 && expected==MissingValue; l--) {
+				ijk[vd] = l-1;
+				expected = tg.Raw(ijk);
+			}
+			for (size_t l=l0+1; l<tg.dims[vd] && expected==MissingValue; l++) {
+				ijk[vd] = l;
+				expected = tg.Raw(ijk);
+			}
+			if (expected == MissingValue) expected = extents[vd];
+
+			if (tg.C(i,j,k) != (float) expected) {
+				fprintf(stderr, "Coordinate (%d,%d,%d) : %f != %f\n",
+					(int) i, (int) j, (int) k, tg.C(i,j,k), expected
+				);
+				nerrors++;
+			}
+		}
+		}
+		}
+	}
+
+	if (tg.lg->GetLocatorMemSize() == 0) {
+		cerr << "Point location tables not built" << endl;
+		nerrors++;
+	}
+
+	cout << "Varying dimension " << vd << (flip ? ", decreasing" : "") <<
+		(missing ? ", missing coordinates" : "") << " : " <<
+		nerrors << " errors" << endl;
+
+	free_grid(&tg);
+	return(nerrors);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	srand(opt.seed);
+
+	int nerrors = 0;
+	for (int vd=0; vd<3; vd++) {
+		nerrors += test_grid(vd, false, false);
+		nerrors += test_grid(vd, true, false);
+	}
+	nerrors += test_grid(2, false, true);
+	nerrors += test_grid(2, true, true);
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
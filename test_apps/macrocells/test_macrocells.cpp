@@ -0,0 +1,328 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/BlockSummary.h>
+#include "MacroCellGrid.h"
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for MacroCellGrid: builds the macrocells
+// of a volume that is mostly empty, with a few storm cells, checks them
+// against a brute force computation, and checks that the transparent
+// space found is never visible. Reports the cost of building the
+// macrocells and the fraction of the volume left to sample. No OpenGL
+// context is needed.
+//
+
+struct {
+	int	dim;
+	int	cell;
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"200",	"Volume dimension along each axis"},
+	{"cell",	1, 	"8",	"Macrocell dimension"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"cell", VetsUtil::CvtToInt, &opt.cell, sizeof(opt.cell)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float storms(double x, double y, double z) {
+	const double cells[3][4] = {
+		{0.3, 0.3, 0.2, 0.05}, {0.7, 0.4, 0.3, 0.08}, {0.5, 0.8, 0.6, 0.04}
+	};
+
+	double v = 0.0;
+	for (int s=0; s<3; s++) {
+		double dx = x - cells[s][0];
+		double dy = y - cells[s][1];
+		double dz = z - cells[s][2];
+		double r2 = (dx*dx + dy*dy + dz*dz) / (cells[s][3]*cells[s][3]);
+		if (r2 < 16.0) v += exp(-r2);
+	}
+	if (rand() % 211 == 0) v = MissingValue;
+	return(v);
+}
+
+//
+// A volume of zeros with a few gaussian storm cells, and a scattering of
+// missing values. The grid origin isn't block aligned.
+//
+RegularGrid *make_grid(int dim, vector <float *> &storage) {
+	size_t min[3] = {5,7,3};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	return(MakeTestGrid(
+		dim, min, extents, storms, NULL, &MissingValue, storage
+	));
+}
+
+//
+// Opacity map transparent below 0.1
+//
+void make_table(float atab[256][4]) {
+	for (int i=0; i<256; i++) {
+		atab[i][0] = atab[i][1] = atab[i][2] = 1.0;
+		atab[i][3] = i < 26 ? 0.0 : (float) i / 255.0;
+	}
+}
+
+//
+// Normalized minimum and maximum of a macrocell, computed directly
+//
+bool cell_range(
+	const RegularGrid *rg, int cell, size_t ci, size_t cj, size_t ck,
+	float *vmin, float *vmax
+) {
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	size_t c[3] = {ci, cj, ck};
+	size_t lo[3], hi[3];
+	for (int i=0; i<3; i++) {
+		lo[i] = c[i] * cell;
+		hi[i] = (c[i]+1) * cell;
+		if (hi[i] > dims[i]-1) hi[i] = dims[i]-1;
+	}
+	bool found = false;
+	for (size_t k=lo[2]; k<=hi[2]; k++) {
+	for (size_t j=lo[1]; j<=hi[1]; j++) {
+	for (size_t i=lo[0]; i<=hi[0]; i++) {
+		float v = rg->AccessIJK(i,j,k);
+		if (v == MissingValue) continue;
+		if (! found || v < *vmin) *vmin = v;
+		if (! found || v > *vmax) *vmax = v;
+		found = true;
+	}
+	}
+	}
+	return(found);
+}
+
+int test_cells(const RegularGrid *rg, const float range[2]) {
+	MacroCellGrid mg(opt.cell, opt.nthreads);
+	if (mg.Build(rg, range) < 0) return(-1);
+
+	float atab[256][4];
+	make_table(atab);
+	mg.Classify(atab);
+
+	size_t cdims[3];
+	mg.GetDimensions(cdims);
+
+	//
+	// A macrocell holding a value mapped to an opaque entry must not be
+	// empty. One holding only transparent values, well away from the
+	// opaque ones, must be. The summary holds the exact range of each
+	// macrocell.
+	//
+	const BlockSummary &summary = mg.GetSummary();
+	int rc = 0;
+	size_t nwrong = 0;
+	size_t nrange = 0;
+	for (size_t ck=0; ck<cdims[2]; ck++) {
+	for (size_t cj=0; cj<cdims[1]; cj++) {
+	for (size_t ci=0; ci<cdims[0]; ci++) {
+		float vmin, vmax;
+		bool found = cell_range(rg, opt.cell, ci, cj, ck, &vmin, &vmax);
+		bool empty = mg.IsEmpty(ci, cj, ck);
+
+		size_t bcoord[3] = {ci, cj, ck};
+		float srange[2], mean;
+		size_t count;
+		bool sfound = summary.GetBlock(bcoord, srange, &mean, &count);
+		if (sfound != found) nrange++;
+		else if (found && (srange[0] != vmin || srange[1] != vmax)) nrange++;
+
+		if (! found && ! empty) nwrong++;
+		if (found) {
+			float tmax = (vmax - range[0]) / (range[1] - range[0]);
+			if (tmax >= 26.0 / 256.0 && empty) nwrong++;
+			if (tmax < 20.0 / 256.0 && ! empty) nwrong++;
+		}
+	}
+	}
+	}
+	if (nwrong) {
+		cerr << ProgName << " : " << nwrong << " misclassified macrocells" << endl;
+		rc = -1;
+	}
+	if (nrange) {
+		cerr << ProgName << " : " << nrange << " macrocell ranges wrong" << endl;
+		rc = -1;
+	}
+
+	//
+	// The occupied box of the whole volume must hold every opaque value
+	//
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	size_t min[3] = {0,0,0};
+	size_t max[3] = {dims[0]-1, dims[1]-1, dims[2]-1};
+	size_t omin[3], omax[3];
+	if (! mg.GetOccupiedBox(min, max, omin, omax)) {
+		cerr << ProgName << " : volume found empty" << endl;
+		return(-1);
+	}
+	float threshold = range[0] + 26.0 / 256.0 * (range[1] - range[0]);
+	size_t nout = 0;
+	for (size_t k=0; k<dims[2]; k++) {
+	for (size_t j=0; j<dims[1]; j++) {
+	for (size_t i=0; i<dims[0]; i++) {
+		if (rg->AccessIJK(i,j,k) < threshold) continue;
+		if (i < omin[0] || i > omax[0] || j < omin[1] || j > omax[1] ||
+			k < omin[2] || k > omax[2]) nout++;
+	}
+	}
+	}
+	if (nout) {
+		cerr << ProgName << " : " << nout << " opaque voxels outside of the occupied box" << endl;
+		rc = -1;
+	}
+
+	//
+	// A box of transparent space is empty
+	//
+	size_t bmin[3] = {0, 0, dims[2]-1 - 2*opt.cell};
+	size_t bmax[3] = {dims[0]/8, dims[1]/8, dims[2]-1};
+	if (mg.GetOccupiedBox(bmin, bmax, omin, omax)) {
+		cerr << ProgName << " : transparent corner not empty" << endl;
+		rc = -1;
+	}
+
+	//
+	// Isovalues
+	//
+	float iso = 0.5;
+	mg.ClassifyIso(&iso, 1);
+	nwrong = 0;
+	for (size_t ck=0; ck<cdims[2]; ck++) {
+	for (size_t cj=0; cj<cdims[1]; cj++) {
+	for (size_t ci=0; ci<cdims[0]; ci++) {
+		float vmin, vmax;
+		if (! cell_range(rg, opt.cell, ci, cj, ck, &vmin, &vmax)) continue;
+		float tmin = (vmin - range[0]) / (range[1] - range[0]);
+		float tmax = (vmax - range[0]) / (range[1] - range[0]);
+		bool contains = tmin <= iso && iso <= tmax;
+		if (contains && mg.IsEmpty(ci, cj, ck)) nwrong++;
+		if ((tmax < iso - 0.01 || tmin > iso + 0.01) && ! mg.IsEmpty(ci, cj, ck)) {
+			nwrong++;
+		}
+	}
+	}
+	}
+	if (nwrong) {
+		cerr << ProgName << " : " << nwrong << " macrocells misclassified by isovalue" << endl;
+		rc = -1;
+	}
+
+	//
+	// Threads don't change the macrocells
+	//
+	MacroCellGrid serial(opt.cell, 1);
+	serial.Build(rg, range);
+	serial.ClassifyIso(&iso, 1);
+	for (size_t ck=0; ck<cdims[2]; ck++) {
+	for (size_t cj=0; cj<cdims[1]; cj++) {
+	for (size_t ci=0; ci<cdims[0]; ci++) {
+		if (serial.IsEmpty(ci, cj, ck) != mg.IsEmpty(ci, cj, ck)) {
+			cerr << ProgName << " : threads change the macrocells" << endl;
+			return(-1);
+		}
+	}
+	}
+	}
+
+	return(rc);
+}
+
+void benchmark(const RegularGrid *rg, const float range[2]) {
+	size_t dims[3];
+	rg->GetDimensions(dims);
+	double nvoxels = (double) dims[0] * dims[1] * dims[2];
+
+	MacroCellGrid mg(opt.cell, opt.nthreads);
+	double t0 = GetTime();
+	mg.Build(rg, range);
+	double tbuild = GetTime() - t0;
+
+	float atab[256][4];
+	make_table(atab);
+	t0 = GetTime();
+	mg.Classify(atab);
+	double tclassify = GetTime() - t0;
+
+	size_t cdims[3];
+	mg.GetDimensions(cdims);
+	double ncells = (double) cdims[0] * cdims[1] * cdims[2];
+
+	cout << dims[0] << "^3 volume, " << opt.cell << "^3 macrocells : built in " <<
+		tbuild * 1000.0 << " ms (" << nvoxels / tbuild * 1e-6 << " Mvoxel/s, " <<
+		mg.GetNumThreads() << " threads), classified in " <<
+		tclassify * 1000.0 << " ms, " <<
+		100.0 * mg.GetNumOccupied() / ncells << "% of the volume left to sample" <<
+		endl;
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	vector <float *> storage;
+	RegularGrid *rg = make_grid(opt.dim, storage);
+	float range[2] = {0.0, 1.0};
+
+	int rc = 0;
+	if (test_cells(rg, range) < 0) rc = 1;
+
+	benchmark(rg, range);
+
+	delete rg;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+	exit(rc);
+}
@@ -0,0 +1,293 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/MultiResPyramid.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for MultiResPyramid: streams volumes with odd
+// dimensions and missing values, and a two dimensional slice, into
+// pyramids, checks every level against a direct box filter, and checks a
+// pyramid file round trip.
+//
+
+struct {
+	int	nx;
+	int	ny;
+	int	nz;
+	int	nlevels;
+	char *file;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nx",		1, 	"67",	"Volume dimension along X"},
+	{"ny",		1, 	"45",	"Volume dimension along Y"},
+	{"nz",		1, 	"29",	"Volume dimension along Z"},
+	{"nlevels",	1, 	"3",	"Number of coarser refinement levels"},
+	{"file",	1, 	"test_multirespyramid.pyr",	"Pyramid file to write"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nx", VetsUtil::CvtToInt, &opt.nx, sizeof(opt.nx)},
+	{"ny", VetsUtil::CvtToInt, &opt.ny, sizeof(opt.ny)},
+	{"nz", VetsUtil::CvtToInt, &opt.nz, sizeof(opt.nz)},
+	{"nlevels", VetsUtil::CvtToInt, &opt.nlevels, sizeof(opt.nlevels)},
+	{"file", VetsUtil::CvtToString, &opt.file, sizeof(opt.file)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Halve a volume with a 2x2x2 box filter, leaving out missing values
+//
+vector <float> reduce(const vector <float> &src, const size_t sdim[3]) {
+	size_t ddim[3];
+	for (int i=0; i<3; i++) ddim[i] = (sdim[i] + 1) / 2;
+
+	vector <float> dst(ddim[0]*ddim[1]*ddim[2]);
+	for (size_t k=0; k<ddim[2]; k++) {
+	for (size_t j=0; j<ddim[1]; j++) {
+	for (size_t i=0; i<ddim[0]; i++) {
+		double sum = 0.0;
+		int n = 0;
+		for (size_t z=2*k; z<2*k+2 && z<sdim[2]; z++) {
+		for (size_t y=2*j; y<2*j+2 && y<sdim[1]; y++) {
+		for (size_t x=2*i; x<2*i+2 && x<sdim[0]; x++) {
+			float v = src[(z*sdim[1] + y)*sdim[0] + x];
+			if (v == MissingValue) continue;
+			sum += v;
+			n++;
+		}
+		}
+		}
+		dst[(k*ddim[1] + j)*ddim[0] + i] = n ? (float) (sum/n) : MissingValue;
+	}
+	}
+	}
+	return(dst);
+}
+
+int check_levels(
+	const MultiResPyramid &pyramid, const vector <float> &volume,
+	const size_t dim[3]
+) {
+	int nlevels = pyramid.GetNumTransforms();
+
+	int nerrors = 0;
+	vector <float> level = volume;
+	size_t ldim[] = {dim[0], dim[1], dim[2]};
+	for (int l=nlevels-1; l>=0; l--) {
+		level = reduce(level, ldim);
+		for (int i=0; i<3; i++) ldim[i] = (ldim[i] + 1) / 2;
+
+		size_t pdim[3];
+		MultiResPyramid::GetDim(dim, nlevels, l, pdim);
+		if (pdim[0] != ldim[0] || pdim[1] != ldim[1] || pdim[2] != ldim[2]) {
+			cerr << "Level " << l << " dimension mismatch" << endl;
+			nerrors++;
+			continue;
+		}
+
+		//
+		// The whole level, and a region away from its origin
+		//
+		size_t min[] = {0, 0, 0};
+		size_t max[] = {ldim[0]-1, ldim[1]-1, ldim[2]-1};
+		for (int r=0; r<2; r++) {
+			if (r == 1) {
+				for (int i=0; i<3; i++) min[i] = ldim[i] / 3;
+			}
+			size_t n = 1;
+			for (int i=0; i<3; i++) n *= max[i]-min[i]+1;
+			vector <float> region(n);
+			if (pyramid.GetRegion(l, min, max, &region[0]) < 0) exit(1);
+
+			int mismatches = 0;
+			float *ptr = &region[0];
+			for (size_t z=min[2]; z<=max[2]; z++) {
+			for (size_t y=min[1]; y<=max[1]; y++) {
+			for (size_t x=min[0]; x<=max[0]; x++) {
+				float v = level[(z*ldim[1] + y)*ldim[0] + x];
+				if (fabs(*ptr++ - v) > 1e-5 * (1.0 + fabs(v))) mismatches++;
+			}
+			}
+			}
+			if (mismatches) {
+				cerr << "Level " << l << " region " << r << " : " <<
+					mismatches << " mismatches" << endl;
+				nerrors++;
+			}
+		}
+	}
+	return(nerrors);
+}
+
+//
+// Random values, with runs of missing values that leave some coarse
+// voxels covering nothing else
+//
+vector <float> make_volume(const size_t dim[3]) {
+	vector <float> volume(dim[0]*dim[1]*dim[2]);
+	for (size_t i=0; i<volume.size(); i++) {
+		volume[i] = (float) rand() / RAND_MAX;
+		if (rand() % 20 == 0) volume[i] = MissingValue;
+	}
+	for (size_t y=0; y<dim[1] && y<4; y++) {
+	for (size_t x=0; x<dim[0]; x++) {
+		volume[y*dim[0] + x] = MissingValue;
+		if (dim[2] > 1) volume[(dim[1] + y)*dim[0] + x] = MissingValue;
+	}
+	}
+	return(volume);
+}
+
+int stream(
+	MultiResPyramid &pyramid, const vector <float> &volume,
+	const size_t dim[3]
+) {
+	size_t depth = pyramid.GetSlabDepth();
+	size_t nxy = dim[0]*dim[1];
+	for (size_t z0=0; z0<dim[2]; z0+=depth) {
+		size_t nz = z0 + depth <= dim[2] ? depth : dim[2] - z0;
+		if (pyramid.AddSlab(&volume[z0*nxy], nz) < 0) return(-1);
+	}
+	return(pyramid.IsComplete() ? 0 : -1);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int nerrors = 0;
+
+	size_t dim[] = {(size_t) opt.nx, (size_t) opt.ny, (size_t) opt.nz};
+	vector <float> volume = make_volume(dim);
+
+	MultiResPyramid pyramid;
+	if (pyramid.Init(dim, opt.nlevels, true, MissingValue) < 0) exit(1);
+
+	double t0 = GetTime();
+	if (stream(pyramid, volume, dim) < 0) exit(1);
+	double t1 = GetTime();
+	cout << "Built " << opt.nlevels << " levels of a " << dim[0] << "x" <<
+		dim[1] << "x" << dim[2] << " volume in " << t1-t0 << " seconds" << endl;
+
+	nerrors += check_levels(pyramid, volume, dim);
+
+	//
+	// A slab of the wrong depth is rejected
+	//
+	MultiResPyramid partial;
+	bool enable = MyBase::EnableErrMsg(false);
+	if (partial.Init(dim, opt.nlevels) < 0) exit(1);
+	if (dim[2] > pyramid.GetSlabDepth() && partial.AddSlab(&volume[0], 1) >= 0) {
+		cerr << "Short slab accepted" << endl;
+		nerrors++;
+	}
+	MyBase::EnableErrMsg(enable);
+	MyBase::SetErrCode(0);
+
+	//
+	// Two dimensional variables are volumes one voxel deep
+	//
+	size_t dim2d[] = {dim[0], dim[1], 1};
+	vector <float> slice = make_volume(dim2d);
+	MultiResPyramid pyramid2d;
+	if (pyramid2d.Init(dim2d, opt.nlevels, true, MissingValue) < 0) exit(1);
+	if (stream(pyramid2d, slice, dim2d) < 0) exit(1);
+	nerrors += check_levels(pyramid2d, slice, dim2d);
+
+	//
+	// File round trip, into storage supplied by the caller, and files
+	// that don't match the volume or the data it was built from
+	//
+	const unsigned long long fingerprint = 0x0123456789abcdefULL;
+	pyramid.SetFingerprint(fingerprint);
+	if (pyramid.Write(opt.file) < 0) exit(1);
+
+	size_t nbytes = MultiResPyramid::GetNumBytes(dim, opt.nlevels);
+	if (nbytes != pyramid.GetNumBytes()) {
+		cerr << "Pyramid size mismatch" << endl;
+		nerrors++;
+	}
+	vector <float> storage(nbytes / sizeof(float));
+	MultiResPyramid copy;
+	if (copy.Init(dim, opt.nlevels, true, MissingValue, &storage[0]) < 0) {
+		exit(1);
+	}
+	copy.SetFingerprint(fingerprint);
+	if (copy.Read(opt.file) < 0) exit(1);
+	nerrors += check_levels(copy, volume, dim);
+
+	MultiResPyramid other;
+	enable = MyBase::EnableErrMsg(false);
+	if (other.Init(dim, opt.nlevels+1) < 0) exit(1);
+	other.SetFingerprint(fingerprint);
+	if (other.Read(opt.file) >= 0) {
+		cerr << "Mismatched pyramid file accepted" << endl;
+		nerrors++;
+	}
+
+	MultiResPyramid stale;
+	if (stale.Init(dim, opt.nlevels, true, MissingValue) < 0) exit(1);
+	stale.SetFingerprint(fingerprint + 1);
+	if (stale.Read(opt.file) >= 0) {
+		cerr << "Stale pyramid file accepted" << endl;
+		nerrors++;
+	}
+
+	FILE *fp = fopen(opt.file, "ab");
+	if (! fp || fputc(0, fp) == EOF || fclose(fp) != 0) exit(1);
+	stale.SetFingerprint(fingerprint);
+	if (stale.Read(opt.file) >= 0) {
+		cerr << "Oversized pyramid file accepted" << endl;
+		nerrors++;
+	}
+	MyBase::EnableErrMsg(enable);
+	MyBase::SetErrCode(0);
+	remove(opt.file);
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
@@ -0,0 +1,356 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netcdf.h>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/NCBuf.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for NCBuf: writes a variable through NCBuf as runs
+// that follow each other on disk, rows of sub-regions, rows and blocks
+// in random order, whole slices, and rows whose ends are written last,
+// with buffers smaller than a row, of a few rows and of many slices, and
+// checks that the file holds the values of the same writes made directly
+// with nc_put_vara().
+//
+
+struct {
+	int	nx;
+	int	ny;
+	int	nz;
+	char *dir;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nx",		1, 	"19",	"Dimension along X"},
+	{"ny",		1, 	"17",	"Dimension along Y"},
+	{"nz",		1, 	"13",	"Dimension along Z"},
+	{"dir",		1, 	".",	"Directory the test file is written to"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nx", VetsUtil::CvtToInt, &opt.nx, sizeof(opt.nx)},
+	{"ny", VetsUtil::CvtToInt, &opt.ny, sizeof(opt.ny)},
+	{"nz", VetsUtil::CvtToInt, &opt.nz, sizeof(opt.nz)},
+	{"dir", VetsUtil::CvtToString, &opt.dir, sizeof(opt.dir)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// A write of the region start..start+count, slowest dimension first
+//
+struct write_t {
+	size_t start[3];
+	size_t count[3];
+};
+
+void add_write(
+	vector <write_t> &writes, size_t z, size_t y, size_t x,
+	size_t nz, size_t ny, size_t nx
+) {
+	write_t w;
+	w.start[0] = z; w.start[1] = y; w.start[2] = x;
+	w.count[0] = nz; w.count[1] = ny; w.count[2] = nx;
+	writes.push_back(w);
+}
+
+// The sub-regions the domain is split into, and the rows of each, which
+// are written in order within a sub-region
+//
+const size_t BS[3] = {4, 5, 6};
+
+void add_rows(
+	vector <write_t> &writes, size_t bz, size_t by, size_t bx
+) {
+	size_t dim[3] = {(size_t) opt.nz, (size_t) opt.ny, (size_t) opt.nx};
+	size_t lo[3] = {bz*BS[0], by*BS[1], bx*BS[2]};
+	size_t hi[3];
+	for (int i=0; i<3; i++) hi[i] = min(lo[i]+BS[i], dim[i]);
+
+	for (size_t z=lo[0]; z<hi[0]; z++) {
+	for (size_t y=lo[1]; y<hi[1]; y++) {
+		add_write(writes, z, y, lo[2], 1, 1, hi[2]-lo[2]);
+	}
+	}
+}
+
+//
+// Each pattern writes every element of the variable once
+//
+const char *Patterns[] = {
+	"runs", "subregions", "shuffled subregions", "shuffled rows",
+	"shuffled blocks", "slices", "runs with deferred row ends", NULL
+};
+
+void make_writes(int pattern, vector <write_t> &writes) {
+	size_t nb[3];
+	size_t dim[3] = {(size_t) opt.nz, (size_t) opt.ny, (size_t) opt.nx};
+	for (int i=0; i<3; i++) nb[i] = (dim[i] + BS[i] - 1) / BS[i];
+
+	vector <size_t> blocks;
+	for (size_t b=0; b<nb[0]*nb[1]*nb[2]; b++) blocks.push_back(b);
+
+	writes.clear();
+	switch (pattern) {
+	case 0:
+
+		//
+		// Rows split into runs of random length, in order
+		//
+		for (size_t z=0; z<opt.nz; z++) {
+		for (size_t y=0; y<opt.ny; y++) {
+			for (size_t x=0; x<opt.nx; ) {
+				size_t n = min((size_t) (rand() % 8 + 1), opt.nx-x);
+				add_write(writes, z, y, x, 1, 1, n);
+				x += n;
+			}
+		}
+		}
+	break;
+	case 1:
+	case 2:
+		if (pattern == 2) random_shuffle(blocks.begin(), blocks.end());
+		for (size_t i=0; i<blocks.size(); i++) {
+			size_t b = blocks[i];
+			add_rows(writes, b / (nb[1]*nb[2]), (b / nb[2]) % nb[1], b % nb[2]);
+		}
+	break;
+	case 3:
+		for (size_t z=0; z<opt.nz; z++) {
+		for (size_t y=0; y<opt.ny; y++) {
+			add_write(writes, z, y, 0, 1, 1, opt.nx);
+		}
+		}
+		random_shuffle(writes.begin(), writes.end());
+	break;
+	case 4:
+
+		//
+		// Blocks written whole, which aren't contiguous on disk, or as
+		// rows
+		//
+		random_shuffle(blocks.begin(), blocks.end());
+		for (size_t i=0; i<blocks.size(); i++) {
+			size_t b = blocks[i];
+			size_t bz = b / (nb[1]*nb[2]);
+			size_t by = (b / nb[2]) % nb[1];
+			size_t bx = b % nb[2];
+			if (rand() % 2) {
+				add_rows(writes, bz, by, bx);
+				continue;
+			}
+			size_t lo[3] = {bz*BS[0], by*BS[1], bx*BS[2]};
+			size_t n[3];
+			for (int j=0; j<3; j++) n[j] = min(BS[j], dim[j]-lo[j]);
+			add_write(writes, lo[0], lo[1], lo[2], n[0], n[1], n[2]);
+		}
+	break;
+	case 5:
+		for (size_t z=0; z<opt.nz; z++) {
+			add_write(writes, z, 0, 0, 1, opt.ny, opt.nx);
+		}
+	break;
+	case 6: {
+
+		//
+		// Whole rows, and rows whose last runs are written after all
+		// others, so that the buffered data often end part way through
+		// a row
+		//
+		vector <write_t> deferred;
+		for (size_t z=0; z<opt.nz; z++) {
+		for (size_t y=0; y<opt.ny; y++) {
+			if (rand() % 2) {
+				add_write(writes, z, y, 0, 1, 1, opt.nx);
+				continue;
+			}
+			size_t split = rand() % opt.nx;
+			for (size_t x=0; x<opt.nx; ) {
+				size_t n = min((size_t) (rand() % 8 + 1), opt.nx-x);
+				add_write(x < split ? writes : deferred, z, y, x, 1, 1, n);
+				x += n;
+			}
+		}
+		}
+		writes.insert(writes.end(), deferred.begin(), deferred.end());
+	}
+	break;
+	}
+}
+
+//
+// Copy the region of a write out of the volume
+//
+void extract(const write_t &w, const vector <float> &volume, float *data) {
+	for (size_t z=w.start[0]; z<w.start[0]+w.count[0]; z++) {
+	for (size_t y=w.start[1]; y<w.start[1]+w.count[1]; y++) {
+	for (size_t x=w.start[2]; x<w.start[2]+w.count[2]; x++) {
+		*data++ = volume[(z*opt.ny + y)*opt.nx + x];
+	}
+	}
+	}
+}
+
+int nc_check(int rc, const string &what) {
+	if (rc != NC_NOERR) {
+		cerr << ProgName << " : " << what << " : " << nc_strerror(rc) << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+//
+// Write a pattern to variable "buffered" through NCBuf, and to variable
+// "direct" with nc_put_vara(), and compare the variables read back.
+// Returns the number of differing elements, or -1 on error
+//
+int check_pattern(
+	const string &path, int pattern, size_t bufsize, bool collective
+) {
+	vector <float> volume(opt.nx*opt.ny*opt.nz);
+	for (size_t i=0; i<volume.size(); i++) volume[i] = (float) rand();
+
+	vector <write_t> writes;
+	make_writes(pattern, writes);
+
+	int ncid;
+	if (nc_check(nc_create(path.c_str(), NC_CLOBBER, &ncid), path) < 0) {
+		return(-1);
+	}
+	const char *dimnames[] = {"z", "y", "x"};
+	size_t dimlens[] = {(size_t) opt.nz, (size_t) opt.ny, (size_t) opt.nx};
+	int dimids[3];
+	for (int i=0; i<3; i++) {
+		int rc = nc_def_dim(ncid, dimnames[i], dimlens[i], &dimids[i]);
+		if (nc_check(rc, path) < 0) return(-1);
+	}
+	int bufvarid, dirvarid;
+	int rc = nc_def_var(ncid, "buffered", NC_FLOAT, 3, dimids, &bufvarid);
+	if (rc == NC_NOERR) {
+		rc = nc_def_var(ncid, "direct", NC_FLOAT, 3, dimids, &dirvarid);
+	}
+	if (rc == NC_NOERR) rc = nc_enddef(ncid);
+	if (nc_check(rc, path) < 0) return(-1);
+
+	vector <size_t> dims(dimlens, dimlens+3);
+	NCBuf *ncbuf = new NCBuf(
+		ncid, bufvarid, NC_FLOAT, dims, collective, 0, bufsize
+	);
+
+	vector <float> data(volume.size());
+	for (size_t i=0; i<writes.size(); i++) {
+		extract(writes[i], volume, &data[0]);
+		rc = ncbuf->PutVara(writes[i].start, writes[i].count, &data[0]);
+		if (nc_check(rc, "NCBuf::PutVara()") < 0) return(-1);
+	}
+	rc = ncbuf->Flush();
+	delete ncbuf;
+	if (nc_check(rc, "NCBuf::Flush()") < 0) return(-1);
+
+	for (size_t i=0; i<writes.size(); i++) {
+		extract(writes[i], volume, &data[0]);
+		rc = nc_put_vara_float(
+			ncid, dirvarid, writes[i].start, writes[i].count, &data[0]
+		);
+		if (nc_check(rc, "nc_put_vara_float()") < 0) return(-1);
+	}
+	if (nc_check(nc_close(ncid), path) < 0) return(-1);
+
+	if (nc_check(nc_open(path.c_str(), NC_NOWRITE, &ncid), path) < 0) {
+		return(-1);
+	}
+	size_t start[] = {0, 0, 0};
+	vector <float> buffered(volume.size());
+	vector <float> direct(volume.size());
+	rc = nc_get_vara_float(ncid, bufvarid, start, dimlens, &buffered[0]);
+	if (rc == NC_NOERR) {
+		rc = nc_get_vara_float(ncid, dirvarid, start, dimlens, &direct[0]);
+	}
+	nc_close(ncid);
+	if (nc_check(rc, path) < 0) return(-1);
+
+	int n = 0;
+	for (size_t i=0; i<volume.size(); i++) {
+		if (memcmp(&buffered[i], &direct[i], sizeof(float)) != 0) n++;
+	}
+	return(n);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	string path = string(opt.dir) + "/test_ncbuf.nc";
+
+	//
+	// Buffers smaller than a row, of a few rows, and of several slices
+	//
+	size_t bufsizes[] = {
+		3*sizeof(float), 3*opt.nx*sizeof(float),
+		3*opt.nx*opt.ny*sizeof(float)
+	};
+
+	srand(1);
+	int nerrors = 0;
+	for (int p=0; Patterns[p]; p++) {
+	for (int b=0; b<3; b++) {
+	for (int c=0; c<2; c++) {
+		int n = check_pattern(path, p, bufsizes[b], c == 1);
+		if (n < 0) {
+			remove(path.c_str());
+			exit(1);
+		}
+		if (n > 0) {
+			cerr << ProgName << " : " << Patterns[p] <<
+				(c ? " (collective)" : "") << " : buffer of " <<
+				bufsizes[b] << " bytes : " << n << " differences" << endl;
+			nerrors++;
+		}
+	}
+	}
+	}
+	remove(path.c_str());
+
+	if (nerrors) exit(1);
+	cout << "Passed" << endl;
+	exit(0);
+}
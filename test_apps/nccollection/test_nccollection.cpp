@@ -0,0 +1,677 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <netcdf.h>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/NetCDFCollection.h>
+#include <vapor/DataMgr.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for NetCDFCollection: writes a small collection of
+// netCDF files shaped like WRF output, with variables staggered along
+// each dimension, and checks that hyperslabs read with Read(start, count),
+// and copied into blocks with DataMgr::_CopyToBlocks(), match the
+// volume read slice by slice with ReadSlice(), whether hyperslabs are
+// unstaggered whole or a few slices at a time. Also checks that slices
+// read with and without read-ahead match, that bounding the number
+// of open files doesn't change what is read, and that a collection
+// initialized lazily, with and without a manifest, has the metadata and
+// data of one initialized from every file. The manifest is left in the
+// test directory.
+//
+
+struct {
+	int	nx;
+	int	ny;
+	int	nz;
+	int	nfiles;
+	char *dir;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nx",		1, 	"37",	"Unstaggered dimension along X"},
+	{"ny",		1, 	"29",	"Unstaggered dimension along Y"},
+	{"nz",		1, 	"11",	"Unstaggered dimension along Z"},
+	{"nfiles",	1, 	"4",	"Number of files, one time step each"},
+	{"dir",		1, 	".",	"Directory the test files are written to"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nx", VetsUtil::CvtToInt, &opt.nx, sizeof(opt.nx)},
+	{"ny", VetsUtil::CvtToInt, &opt.ny, sizeof(opt.ny)},
+	{"nz", VetsUtil::CvtToInt, &opt.nz, sizeof(opt.nz)},
+	{"nfiles", VetsUtil::CvtToInt, &opt.nfiles, sizeof(opt.nfiles)},
+	{"dir", VetsUtil::CvtToString, &opt.dir, sizeof(opt.dir)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = 1.e37f;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Gives access to DataMgr's static block copy
+//
+class BlockCopier : public DataMgr {
+public:
+	using DataMgr::_CopyToBlocks;
+};
+
+//
+// Variables written to each file: name, and whether they are 3D and
+// staggered along X, Y and Z. Q has missing values.
+//
+struct var_t {
+	const char *name;
+	bool is3D;
+	bool stag[3];
+};
+
+const var_t Vars[] = {
+	{"T", true, {false, false, false}},
+	{"U", true, {true, false, false}},
+	{"V", true, {false, true, false}},
+	{"W", true, {false, false, true}},
+	{"Q", true, {true, true, false}},
+	{"MU_V", false, {false, true, false}},
+	{NULL}
+};
+
+int nc_check(int rc, const string &path) {
+	if (rc != NC_NOERR) {
+		cerr << ProgName << " : " << path << " : " << nc_strerror(rc) << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+//
+// Write file number f of the collection
+//
+int write_file(const string &path, int f) {
+	int ncid;
+	if (nc_check(nc_create(path.c_str(), NC_CLOBBER, &ncid), path) < 0) {
+		return(-1);
+	}
+
+	const char *dimnames[] = {
+		"Time", "bottom_top", "bottom_top_stag", "south_north",
+		"south_north_stag", "west_east", "west_east_stag"
+	};
+	size_t dimlens[] = {
+		NC_UNLIMITED, (size_t) opt.nz, (size_t) opt.nz+1, (size_t) opt.ny,
+		(size_t) opt.ny+1, (size_t) opt.nx, (size_t) opt.nx+1
+	};
+	int dimids[7];
+	for (int i=0; i<7; i++) {
+		int rc = nc_def_dim(ncid, dimnames[i], dimlens[i], &dimids[i]);
+		if (nc_check(rc, path) < 0) return(-1);
+	}
+
+	vector <int> varids;
+	for (int v=0; Vars[v].name; v++) {
+		const var_t &var = Vars[v];
+		int vdims[4] = {
+			dimids[0], dimids[var.stag[2] ? 2 : 1],
+			dimids[var.stag[1] ? 4 : 3], dimids[var.stag[0] ? 6 : 5]
+		};
+		if (! var.is3D) vdims[1] = vdims[2], vdims[2] = vdims[3];
+
+		int varid;
+		int rc = nc_def_var(
+			ncid, var.name, NC_FLOAT, var.is3D ? 4 : 3, vdims, &varid
+		);
+		if (nc_check(rc, path) < 0) return(-1);
+		rc = nc_put_att_float(
+			ncid, varid, "_FillValue", NC_FLOAT, 1, &MissingValue
+		);
+		if (nc_check(rc, path) < 0) return(-1);
+		varids.push_back(varid);
+	}
+
+	//
+	// The first file has a global attribute the others don't, and the
+	// fourth a different definition of variable P, which is only read by
+	// test_lazy(), so that lazy initialization must read them in full
+	//
+	string title = "nccollection test";
+	int rc = nc_put_att_text(
+		ncid, NC_GLOBAL, "TITLE", title.size(), title.c_str()
+	);
+	if (rc == NC_NOERR && f == 0) {
+		rc = nc_put_att_text(ncid, NC_GLOBAL, "RESTART", 1, "T");
+	}
+	int pdims[3] = {dimids[0], dimids[3], dimids[5]};
+	int pvarid;
+	if (rc == NC_NOERR) {
+		rc = nc_def_var(ncid, "P", NC_FLOAT, 3, pdims, &pvarid);
+	}
+	if (rc == NC_NOERR) {
+		string desc = f == 3 ? "fourth" : "pressure";
+		rc = nc_put_att_text(
+			ncid, pvarid, "description", desc.size(), desc.c_str()
+		);
+	}
+	if (nc_check(rc, path) < 0) return(-1);
+
+	if (nc_check(nc_enddef(ncid), path) < 0) return(-1);
+
+	srand(f+1);
+	for (int v=0; Vars[v].name; v++) {
+		const var_t &var = Vars[v];
+		size_t nx = opt.nx + var.stag[0];
+		size_t ny = opt.ny + var.stag[1];
+		size_t nz = var.is3D ? opt.nz + var.stag[2] : 1;
+
+		vector <float> data(nx*ny*nz);
+		for (size_t i=0; i<data.size(); i++) {
+			data[i] = (float) rand() / RAND_MAX * 100.0;
+			if (var.name[0] == 'Q' && rand() % 17 == 0) data[i] = MissingValue;
+		}
+
+		size_t start[] = {0, 0, 0, 0};
+		size_t count[] = {1, nz, ny, nx};
+		if (! var.is3D) count[1] = ny, count[2] = nx;
+
+		int rc = nc_put_vara_float(ncid, varids[v], start, count, &data[0]);
+		if (nc_check(rc, path) < 0) return(-1);
+	}
+	return(nc_check(nc_close(ncid), path));
+}
+
+int write_files(vector <string> &files) {
+	for (int f=0; f<opt.nfiles; f++) {
+		char buf[32];
+		sprintf(buf, "/nccollection_%d.nc", f);
+		files.push_back(string(opt.dir) + buf);
+		if (write_file(files.back(), f) < 0) return(-1);
+	}
+	return(0);
+}
+
+int init_collection(NetCDFCollection &ncdfc, const vector <string> &files) {
+	vector <string> time_dimnames(1, "Time");
+	vector <string> time_coordvars;
+	if (ncdfc.Initialize(files, time_dimnames, time_coordvars) < 0) {
+		return(-1);
+	}
+
+	vector <string> staggered;
+	staggered.push_back("bottom_top_stag");
+	staggered.push_back("south_north_stag");
+	staggered.push_back("west_east_stag");
+	ncdfc.SetStaggeredDims(staggered);
+	ncdfc.SetMissingValueAttName("_FillValue");
+	return(0);
+}
+
+//
+// Read a variable on the unstaggered grid, a slice at a time
+//
+int read_slices(
+	NetCDFCollection &ncdfc, size_t ts, const var_t &var,
+	vector <float> &volume
+) {
+	size_t nz = var.is3D ? opt.nz : 1;
+	size_t nslice = opt.nx * opt.ny;
+	volume.resize(nslice * nz);
+
+	int fd = ncdfc.OpenRead(ts, var.name);
+	if (fd < 0) return(-1);
+
+	int rc;
+	size_t z = 0;
+	while ((rc = ncdfc.ReadSlice(&volume[z*nslice], fd)) > 0) {
+		if (++z == nz) break;
+	}
+	ncdfc.Close(fd);
+	if (rc < 0) return(-1);
+	if (z != nz) {
+		cerr << ProgName << " : " << var.name << " : " << z << " slices read" << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+//
+// Compare the region min..max (x fastest) of a volume with data,
+// bit for bit
+//
+size_t count_mismatches(
+	const vector <float> &volume, const size_t min[3], const size_t max[3],
+	const float *data
+) {
+	size_t n = 0;
+	for (size_t z=min[2]; z<=max[2]; z++) {
+	for (size_t y=min[1]; y<=max[1]; y++) {
+	for (size_t x=min[0]; x<=max[0]; x++) {
+		float v = volume[(z*opt.ny + y)*opt.nx + x];
+		if (v != *data++) n++;
+	}
+	}
+	}
+	return(n);
+}
+
+//
+// Read hyperslabs of every variable, and check them, and their blocks,
+// against the volume read slice by slice
+//
+int test_hyperslabs(NetCDFCollection &ncdfc) {
+	size_t dim[3] = {(size_t) opt.nx, (size_t) opt.ny, (size_t) opt.nz};
+	int nerrors = 0;
+
+	srand(7);
+	for (size_t ts=0; ts<opt.nfiles; ts++) {
+	for (int v=0; Vars[v].name; v++) {
+		const var_t &var = Vars[v];
+		int ndim = var.is3D ? 3 : 2;
+
+		vector <float> volume;
+		if (read_slices(ncdfc, ts, var, volume) < 0) return(-1);
+
+		int fd = ncdfc.OpenRead(ts, var.name);
+		if (fd < 0) return(-1);
+
+		//
+		// The whole volume, single voxels at the corners, and random
+		// regions
+		//
+		for (int r=0; r<12; r++) {
+			size_t min[3], max[3];
+			for (int i=0; i<3; i++) {
+				size_t n = i < ndim ? dim[i] : 1;
+				if (r == 0) min[i] = 0, max[i] = n-1;
+				else if (r == 1) min[i] = max[i] = 0;
+				else if (r == 2) min[i] = max[i] = n-1;
+				else {
+					min[i] = rand() % n;
+					max[i] = min[i] + rand() % (n - min[i]);
+				}
+			}
+
+			size_t start[3], count[3];
+			for (int i=0; i<ndim; i++) {
+				start[ndim-1-i] = min[i];
+				count[ndim-1-i] = max[i]-min[i]+1;
+			}
+			vector <float> region(
+				(max[0]-min[0]+1)*(max[1]-min[1]+1)*(max[2]-min[2]+1)
+			);
+			if (ncdfc.Read(start, count, &region[0], fd) < 0) return(-1);
+
+			size_t n = count_mismatches(volume, min, max, &region[0]);
+			if (n) {
+				cerr << ProgName << " : " << var.name << " : " << n <<
+					" mismatches in region " << r << endl;
+				nerrors++;
+			}
+		}
+
+		//
+		// Blocks copied from a region starting at a block corner. Voxels
+		// of partial blocks repeat the nearest region voxel.
+		//
+		size_t bs[3] = {8, 5, (size_t) (var.is3D ? 4 : 1)};
+		size_t bmin[3], bmax[3], min[3], max[3], rdim[3];
+		for (int i=0; i<3; i++) {
+			size_t n = i < ndim ? dim[i] : 1;
+			size_t nb = (n + bs[i] - 1) / bs[i];
+			bmin[i] = rand() % nb;
+			bmax[i] = bmin[i] + rand() % (nb - bmin[i]);
+			min[i] = bmin[i] * bs[i];
+			max[i] = (bmax[i]+1) * bs[i] - 1;
+			if (max[i] > n-1) max[i] = n-1;
+			rdim[i] = max[i]-min[i]+1;
+		}
+		size_t start[3], count[3];
+		for (int i=0; i<ndim; i++) {
+			start[ndim-1-i] = min[i];
+			count[ndim-1-i] = rdim[i];
+		}
+		vector <float> region(rdim[0]*rdim[1]*rdim[2]);
+		if (ncdfc.Read(start, count, &region[0], fd) < 0) return(-1);
+		ncdfc.Close(fd);
+
+		size_t nblocks = 1;
+		for (int i=0; i<3; i++) nblocks *= bmax[i]-bmin[i]+1;
+		size_t bsize = bs[0]*bs[1]*bs[2];
+		vector <float> blks(nblocks*bsize);
+		BlockCopier::_CopyToBlocks(&region[0], rdim, bs, &blks[0]);
+
+		size_t n = 0;
+		const float *bp = &blks[0];
+		for (size_t bz=bmin[2]; bz<=bmax[2]; bz++) {
+		for (size_t by=bmin[1]; by<=bmax[1]; by++) {
+		for (size_t bx=bmin[0]; bx<=bmax[0]; bx++) {
+			for (size_t z=bz*bs[2]; z<(bz+1)*bs[2]; z++) {
+			for (size_t y=by*bs[1]; y<(by+1)*bs[1]; y++) {
+			for (size_t x=bx*bs[0]; x<(bx+1)*bs[0]; x++) {
+				size_t xx = x < max[0] ? x : max[0];
+				size_t yy = y < max[1] ? y : max[1];
+				size_t zz = z < max[2] ? z : max[2];
+				if (*bp++ != volume[(zz*opt.ny + yy)*opt.nx + xx]) n++;
+			}
+			}
+			}
+		}
+		}
+		}
+		if (n) {
+			cerr << ProgName << " : " << var.name << " : " << n <<
+				" mismatches in blocks" << endl;
+			nerrors++;
+		}
+	}
+	}
+	return(nerrors ? -1 : 0);
+}
+
+//
+// Check hyperslabs again with hyperslab buffers smaller than a slice,
+// and of a few slices, so that they are unstaggered a chunk of slices
+// at a time
+//
+int test_region_buffer(NetCDFCollection &ncdfc) {
+	size_t nslice = (opt.nx+1) * (opt.ny+1) * sizeof(float);
+	size_t sizes[] = {1, 3*nslice};
+	int nerrors = 0;
+
+	for (int i=0; i<2; i++) {
+		ncdfc.SetRegionBuffer(sizes[i]);
+		if (test_hyperslabs(ncdfc) < 0) {
+			cerr << ProgName << " : hyperslab buffer of " << sizes[i] <<
+				" bytes" << endl;
+			nerrors++;
+		}
+	}
+	ncdfc.SetRegionBuffer(8*1024*1024);
+	return(nerrors ? -1 : 0);
+}
+
+//
+// Return the number of differences between the metadata of two
+// collections: variables, dimensions, times, attributes and missing
+// values
+//
+int compare_metadata(
+	const NetCDFCollection &ncdfc0, const NetCDFCollection &ncdfc1
+) {
+	int n = 0;
+	if (ncdfc0.GetDimNames() != ncdfc1.GetDimNames()) n++;
+	if (ncdfc0.GetDims() != ncdfc1.GetDims()) n++;
+	if (ncdfc0.GetTimes() != ncdfc1.GetTimes()) n++;
+	if (ncdfc0.GetFailedVars() != ncdfc1.GetFailedVars()) n++;
+
+	vector <string> varnames;
+	for (int ndim=0; ndim<4; ndim++) {
+		vector <string> v0 = ncdfc0.GetVariableNames(ndim, false);
+		vector <string> v1 = ncdfc1.GetVariableNames(ndim, false);
+		if (v0 != v1) n++;
+		varnames.insert(varnames.end(), v0.begin(), v0.end());
+	}
+
+	//
+	// The empty name gives the global attributes
+	//
+	varnames.push_back("");
+	for (int v=0; v<varnames.size(); v++) {
+		string name = varnames[v];
+		if (! name.empty()) {
+			NetCDFSimple::Variable info0, info1;
+			if (ncdfc0.GetVariableInfo(name, info0) < 0 ||
+				ncdfc1.GetVariableInfo(name, info1) < 0 ||
+				! (info0 == info1)) n++;
+
+			double mv0, mv1;
+			bool has0 = ncdfc0.GetMissingValue(name, mv0);
+			bool has1 = ncdfc1.GetMissingValue(name, mv1);
+			if (has0 != has1 || (has0 && mv0 != mv1)) n++;
+
+			vector <double> t0, t1;
+			ncdfc0.GetTimes(name, t0);
+			ncdfc1.GetTimes(name, t1);
+			if (t0 != t1) n++;
+		}
+
+		vector <string> attnames = ncdfc0.GetAttNames(name);
+		if (attnames != ncdfc1.GetAttNames(name)) n++;
+		for (int a=0; a<attnames.size(); a++) {
+			string s0, s1;
+			vector <double> d0, d1;
+			ncdfc0.GetAtt(name, attnames[a], s0);
+			ncdfc1.GetAtt(name, attnames[a], s1);
+			ncdfc0.GetAtt(name, attnames[a], d0);
+			ncdfc1.GetAtt(name, attnames[a], d1);
+			if (s0 != s1 || d0 != d1) n++;
+		}
+	}
+	return(n);
+}
+
+//
+// Initialize the collection lazily without a manifest, writing one and
+// reading it back, and check each against the collection initialized
+// from every file. The files are listed second file first, so that the
+// file whose header is read in full isn't the first one.
+//
+int test_lazy(const vector <string> &files) {
+	vector <string> order = files;
+	if (order.size() > 1) swap(order[0], order[1]);
+
+	NetCDFCollection eager;
+	eager.SetManifestDir("");
+	if (init_collection(eager, order) < 0) return(-1);
+
+	const char *manifests[] = {"", opt.dir, opt.dir};
+	int nerrors = 0;
+	for (int i=0; i<3; i++) {
+		NetCDFCollection lazy;
+		lazy.SetLazyInitialize(true);
+		lazy.SetManifestDir(manifests[i]);
+		if (init_collection(lazy, order) < 0) return(-1);
+
+		int n = compare_metadata(eager, lazy);
+		if (n) {
+			cerr << ProgName << " : " << n << 
+				" metadata differences with lazy initialization " << i << endl;
+			nerrors++;
+		}
+
+		for (size_t ts=0; ts<opt.nfiles; ts++) {
+		for (int v=0; Vars[v].name; v++) {
+			vector <float> volume0, volume1;
+			if (read_slices(eager, ts, Vars[v], volume0) < 0) return(-1);
+			if (read_slices(lazy, ts, Vars[v], volume1) < 0) return(-1);
+			if (volume0 != volume1) {
+				cerr << ProgName << " : " << Vars[v].name << 
+					" : data differs with lazy initialization " << i << endl;
+				nerrors++;
+			}
+		}
+		}
+	}
+	return(nerrors ? -1 : 0);
+}
+
+//
+// Read every variable a slice at a time with read-ahead buffers smaller
+// than a slice, of one slice, of a few slices, and of the default size,
+// and with two handles on a variable read in turn, and check the
+// slices against those read without read-ahead
+//
+int test_read_ahead(NetCDFCollection &ncdfc) {
+	size_t nslice = opt.nx * opt.ny;
+	size_t sizes[] = {
+		sizeof(float), nslice*sizeof(float), 3*nslice*sizeof(float),
+		16*1024*1024
+	};
+	int nerrors = 0;
+
+	for (size_t ts=0; ts<opt.nfiles; ts++) {
+	for (int v=0; Vars[v].name; v++) {
+		const var_t &var = Vars[v];
+
+		vector <float> volume;
+		ncdfc.SetReadAhead(0);
+		if (read_slices(ncdfc, ts, var, volume) < 0) return(-1);
+
+		for (int s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+			vector <float> ravolume;
+			ncdfc.SetReadAhead(sizes[s]);
+			if (read_slices(ncdfc, ts, var, ravolume) < 0) return(-1);
+			if (ravolume != volume) {
+				cerr << ProgName << " : " << var.name << 
+					" : mismatch with read-ahead of " << sizes[s] << 
+					" bytes" << endl;
+				nerrors++;
+			}
+		}
+
+		if (! var.is3D) continue;
+
+		int fd0 = ncdfc.OpenRead(ts, var.name);
+		int fd1 = ncdfc.OpenRead(ts, var.name);
+		if (fd0 < 0 || fd1 < 0) return(-1);
+
+		vector <float> slice0(nslice), slice1(nslice);
+		for (size_t z=0; z<opt.nz; z++) {
+			if (ncdfc.ReadSlice(&slice0[0], fd0) <= 0) return(-1);
+			if (ncdfc.ReadSlice(&slice1[0], fd1) <= 0) return(-1);
+
+			size_t min[] = {0, 0, z};
+			size_t max[] = {(size_t) opt.nx-1, (size_t) opt.ny-1, z};
+			if (count_mismatches(volume, min, max, &slice0[0]) ||
+				count_mismatches(volume, min, max, &slice1[0])) {
+
+				cerr << ProgName << " : " << var.name << 
+					" : mismatch reading two handles in turn" << endl;
+				nerrors++;
+				break;
+			}
+		}
+		ncdfc.Close(fd0);
+		ncdfc.Close(fd1);
+	}
+	}
+	ncdfc.SetReadAhead(16*1024*1024);
+	return(nerrors ? -1 : 0);
+}
+
+//
+// Read a variable of every file with at most one file to be kept open.
+// Files are closed once their variables are, files with open variables
+// stay open, and slices read from every file in turn match those read
+// one file at a time.
+//
+int test_open_files(NetCDFCollection &ncdfc) {
+	const var_t &var = Vars[0];
+	size_t nslice = opt.nx * opt.ny;
+	int nerrors = 0;
+
+	ncdfc.SetMaxOpenFiles(1);
+
+	vector <vector <float> > volumes(opt.nfiles);
+	for (size_t ts=0; ts<opt.nfiles; ts++) {
+		if (read_slices(ncdfc, ts, var, volumes[ts]) < 0) return(-1);
+		if (ncdfc.GetNumOpenFiles() > 1) {
+			cerr << ProgName << " : " << ncdfc.GetNumOpenFiles() << 
+				" files left open" << endl;
+			nerrors++;
+		}
+	}
+
+	vector <int> fds;
+	for (size_t ts=0; ts<opt.nfiles; ts++) {
+		int fd = ncdfc.OpenRead(ts, var.name);
+		if (fd < 0) return(-1);
+		fds.push_back(fd);
+	}
+	if (ncdfc.GetNumOpenFiles() != opt.nfiles) {
+		cerr << ProgName << " : " << ncdfc.GetNumOpenFiles() << 
+			" files open, expected " << opt.nfiles << endl;
+		nerrors++;
+	}
+
+	vector <float> slice(nslice);
+	for (size_t z=0; z<opt.nz; z++) {
+	for (size_t ts=0; ts<opt.nfiles; ts++) {
+		if (ncdfc.ReadSlice(&slice[0], fds[ts]) <= 0) return(-1);
+
+		size_t min[] = {0, 0, z};
+		size_t max[] = {(size_t) opt.nx-1, (size_t) opt.ny-1, z};
+		if (count_mismatches(volumes[ts], min, max, &slice[0])) {
+			cerr << ProgName << " : " << var.name << 
+				" : mismatch reading files in turn" << endl;
+			nerrors++;
+		}
+	}
+	}
+
+	for (size_t ts=0; ts<opt.nfiles; ts++) ncdfc.Close(fds[ts]);
+	if (ncdfc.GetNumOpenFiles() > 1) {
+		cerr << ProgName << " : " << ncdfc.GetNumOpenFiles() << 
+			" files left open" << endl;
+		nerrors++;
+	}
+
+	ncdfc.SetMaxOpenFiles(32);
+	return(nerrors ? -1 : 0);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	vector <string> files;
+	if (write_files(files) < 0) exit(1);
+
+	int rc = 0;
+	NetCDFCollection ncdfc;
+	if (init_collection(ncdfc, files) < 0) rc = 1;
+	else if (test_hyperslabs(ncdfc) < 0) rc = 1;
+	else if (test_region_buffer(ncdfc) < 0) rc = 1;
+	else if (test_read_ahead(ncdfc) < 0) rc = 1;
+	else if (test_open_files(ncdfc) < 0) rc = 1;
+	else if (test_lazy(files) < 0) rc = 1;
+
+	for (int f=0; f<files.size(); f++) remove(files[f].c_str());
+
+	if (rc) exit(rc);
+	cout << "Passed" << endl;
+	exit(0);
+}
@@ -0,0 +1,130 @@
+#!/bin/sh
+#
+#	Regression test for the memory mapped input path of raw2vdf: converts
+#	the same raw data with and without -mmap, for floats and doubles, with
+#	and without -swapbytes, unstaggered and staggered along each axis, as
+#	a volume and as a region, and checks that the volumes read back with
+#	vdf2raw are bit for bit the same.
+#
+#	Usage: test_raw2vdf.sh [-dimension NXxNYxNZ] [-dir directory]
+#
+#	vdfcreate, raw2vdf and vdf2raw are taken from the search path. Data
+#	larger than the 64MB mapping window of raw2vdf (e.g. -dimension
+#	256x256x300) also exercise sliding the window across slices.
+#
+
+prog=`basename $0`
+dimension=37x29x23
+dir=.
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-dimension) dimension="$2"; shift 2;;
+	-dir) dir="$2"; shift 2;;
+	*) echo "Usage: $prog [-dimension NXxNYxNZ] [-dir directory]" 1>&2; exit 1;;
+	esac
+done
+
+nx=`echo $dimension | cut -dx -f1`
+ny=`echo $dimension | cut -dx -f2`
+nz=`echo $dimension | cut -dx -f3`
+
+tmp="$dir/test_raw2vdf.$$"
+mkdir -p "$tmp" || exit 1
+trap 'rm -rf "$tmp"' 0
+
+#
+# Write n random values of the given perl pack format (f or d) to a file
+#
+mkdata() {
+	perl -e '
+		my ($fmt, $n) = @ARGV;
+		srand(1);
+		binmode STDOUT;
+		for (my $i=0; $i<$n; $i++) {
+			print pack($fmt, rand(2000.0) - 1000.0);
+		}
+	' "$1" "$2" > "$3"
+}
+
+#
+# Convert a raw file with the given raw2vdf options, with and without
+# -mmap, and compare the volumes read back. Extra arguments are the
+# region options, passed to vdf2raw too
+#
+check() {
+	name="$1"; data="$2"; opts="$3"; shift 3
+	for mode in fread mmap; do
+		mmap=""
+		[ $mode = mmap ] && mmap="-mmap"
+		vdf="$tmp/$mode.vdf"
+		rm -rf "$tmp/$mode.vdf" "$tmp/${mode}_data" "$tmp/$mode.raw"
+		vdfcreate -dimension $dimension -vars3d var1 "$vdf" > /dev/null ||
+			return 1
+		raw2vdf -quiet $opts $mmap "$@" "$vdf" "$data" || return 1
+		vdf2raw -quiet "$@" "$vdf" "$tmp/$mode.raw" || return 1
+	done
+	if cmp -s "$tmp/fread.raw" "$tmp/mmap.raw"; then
+		:
+	else
+		echo "$prog : $name : -mmap output differs" 1>&2
+		return 1
+	fi
+	return 0
+}
+
+nerrors=0
+for stagdim in 0 1 2 3; do
+for region in volume region; do
+
+	sx=$nx; sy=$ny; sz=$nz
+	set --
+	if [ $region = region ]; then
+		sx=`expr $nx - 4`; sy=`expr $ny - 5`; sz=`expr $nz - 6`
+		set -- -xregion 2:`expr $sx + 1` -yregion 3:`expr $sy + 2` \
+			-zregion 1:$sz
+	fi
+	case $stagdim in
+	1) sx=`expr $sx + 1`;;
+	2) sy=`expr $sy + 1`;;
+	3) sz=`expr $sz + 1`;;
+	esac
+	n=`expr $sx \* $sy \* $sz`
+
+	for type in float double; do
+	for swap in native swapped; do
+
+		fmt=f; opts="-stagdim $stagdim"
+		[ $type = double ] && fmt=d && opts="$opts -dbl"
+		if [ $swap = swapped ]; then
+
+			# Host byte order is the one vdf2raw writes
+			#
+			if [ "`perl -e 'print unpack("h*", pack("s", 1))'`" = "1000" ]; then
+				fmt="$fmt>"
+			else
+				fmt="$fmt<"
+			fi
+			opts="$opts -swapbytes"
+		fi
+
+		data="$tmp/data.raw"
+		mkdata "$fmt" $n "$data" || exit 1
+
+		name="$type $swap stagdim $stagdim $region"
+		if check "$name" "$data" "$opts" "$@"; then
+			:
+		else
+			nerrors=`expr $nerrors + 1`
+		fi
+	done
+	done
+done
+done
+
+if [ $nerrors -ne 0 ]; then
+	echo "$prog : $nerrors errors" 1>&2
+	exit 1
+fi
+echo "Passed"
+exit 0
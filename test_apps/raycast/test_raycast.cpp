@@ -0,0 +1,321 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include "DVRRayCasterCPU.h"
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for DVRRayCasterCPU: renders a synthetic
+// volume with and without the accelerations (threads, empty space
+// skipping, early ray termination) and compares the images, and checks
+// images whose opacity is known analytically. No OpenGL context is
+// needed.
+//
+
+struct {
+	int	dim;
+	int	size;
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"dim",		1, 	"64",	"Grid dimension along each axis"},
+	{"size",	1, 	"256",	"Image dimension along each axis"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"size", VetsUtil::CvtToInt, &opt.size, sizeof(opt.size)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+float blob(double x, double y, double z) {
+	x -= 0.5;
+	y -= 0.5;
+	z -= 0.5;
+	float v = exp(-12.0 * (x*x + 2.0*y*y + z*z));
+	if (rand() % 97 == 0) v = MissingValue;
+	return(v);
+}
+
+float constant_value(double, double, double) {
+	return(0.5);
+}
+
+//
+// Unit cube grid holding a blob, or a constant, with missing values
+// sprinkled in
+//
+RegularGrid *make_grid(int dim, bool constant, vector <float *> &storage) {
+	size_t min[3] = {0,0,0};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	return(MakeTestGrid(
+		dim, min, extents, constant ? constant_value : blob, NULL,
+		&MissingValue, storage
+	));
+}
+
+void multiply(const double a[16], const double b[16], double r[16]) {
+	for (int c=0; c<4; c++) {
+		for (int i=0; i<4; i++) {
+			r[c*4+i] = 0.0;
+			for (int k=0; k<4; k++) r[c*4+i] += a[k*4+i] * b[c*4+k];
+		}
+	}
+}
+
+//
+// Orthographic view of the unit cube, looking down the z axis after
+// rotating the cube about its center by angle degrees around the x and
+// y axes
+//
+void view(double angle, double modelview[16], double projection[16]) {
+	double a = angle * M_PI / 180.0;
+	double ca = cos(a), sa = sin(a);
+
+	double ry[16] = {ca,0,-sa,0, 0,1,0,0, sa,0,ca,0, 0,0,0,1};
+	double rx[16] = {1,0,0,0, 0,ca,sa,0, 0,-sa,ca,0, 0,0,0,1};
+	double t0[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, -0.5,-0.5,-0.5,1};
+	double t1[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0.5,0.5,0.5,1};
+	double m0[16], m1[16];
+	multiply(ry, t0, m0);
+	multiply(rx, m0, m1);
+	multiply(t1, m1, modelview);
+
+	// glOrtho(-0.2, 1.2, -0.2, 1.2, -2, 2)
+	//
+	double s = 2.0 / 1.4;
+	double p[16] = {
+		s,0,0,0, 0,s,0,0, 0,0,-0.5,0, -0.5*s,-0.5*s,0,1
+	};
+	for (int i=0; i<16; i++) projection[i] = p[i];
+}
+
+int render(
+	DVRRayCasterCPU &rc, double angle, bool skipping, float termination,
+	vector <unsigned char> &image, double *time
+) {
+	double modelview[16], projection[16];
+	view(angle, modelview, projection);
+
+	rc.Resize(opt.size, opt.size);
+	if (rc.SetMatrices(modelview, projection) < 0) return(-1);
+	rc.SetSkipping(skipping);
+	rc.SetTerminationOpacity(termination);
+
+	double t0 = GetTime();
+	if (rc.Render() < 0) return(-1);
+	if (time) *time = GetTime() - t0;
+
+	const unsigned char *ptr = rc.GetImage();
+	image.assign(ptr, ptr + opt.size*opt.size*4);
+	return(0);
+}
+
+int maxdiff(const vector <unsigned char> &a, const vector <unsigned char> &b) {
+	int diff = 0;
+	for (size_t i=0; i<a.size(); i++) {
+		int d = abs((int) a[i] - (int) b[i]);
+		if (d > diff) diff = d;
+	}
+	return(diff);
+}
+
+//
+// Render the blob with and without the accelerations
+//
+int test_accel(
+	const RegularGrid *rg, bool preint, bool lighting, bool fast
+) {
+	DVRRayCasterCPU reference(1);
+	DVRRayCasterCPU accel(opt.nthreads);
+	DVRRayCasterCPU *rcs[] = {&reference, &accel};
+
+	//
+	// Transparent below 0.3, so much of the volume is empty
+	//
+	float tf[256][4];
+	for (int i=0; i<256; i++) {
+		double s = i / 255.0;
+		tf[i][0] = s;
+		tf[i][1] = 1.0 - s;
+		tf[i][2] = 0.5;
+		tf[i][3] = s < 0.3 ? 0.0 : 0.2 * (s - 0.3);
+	}
+	float lpos[3] = {0.3, 0.5, 1.0};
+	float range[2] = {0.0, 1.0};
+
+	for (int r=0; r<2; r++) {
+		if (rcs[r]->SetRegion(rg, range) < 0) return(-1);
+		rcs[r]->SetPreintegrationOnOff(preint);
+		rcs[r]->SetOLUT(tf, 0);
+		rcs[r]->SetLightingOnOff(lighting);
+		rcs[r]->SetLightingCoeff(0.6, 0.3, 0.4, 10.0);
+		rcs[r]->SetLightingLocation(lpos);
+		rcs[r]->SetRenderFast(fast);
+	}
+
+	int rc = 0;
+	double angles[] = {0.0, 30.0, 57.0};
+	for (int a=0; a<3; a++) {
+		vector <unsigned char> ref, skip, full;
+		double rtime, atime;
+		if (render(reference, angles[a], false, 2.0, ref, &rtime) < 0) {
+			return(-1);
+		}
+		if (render(accel, angles[a], true, 2.0, skip, NULL) < 0) return(-1);
+		if (render(accel, angles[a], true, 0.99, full, &atime) < 0) return(-1);
+
+		// Skipping empty space must not change the image, and early
+		// termination may change it by the opacity left
+		//
+		int dskip = maxdiff(ref, skip);
+		int dfull = maxdiff(ref, full);
+		if (dskip != 0 || dfull > 3) {
+			cerr << ProgName << " : accelerated image differs from reference"
+				<< " (angle " << angles[a] << ", max difference " << dskip
+				<< ", " << dfull << ")" << endl;
+			rc = -1;
+		}
+
+		cout << "preintegration " << preint << ", lighting " << lighting <<
+			", fast " << fast << ", angle " << angles[a] <<
+			" : reference " << rtime << " s, accelerated (" <<
+			accel.GetNumThreads() << " threads) " << atime << " s" << endl;
+	}
+	return(rc);
+}
+
+//
+// A transparent transfer function renders nothing
+//
+int test_empty(const RegularGrid *rg) {
+	DVRRayCasterCPU rc(opt.nthreads);
+	float tf[256][4];
+	memset(tf, 0, sizeof(tf));
+	float range[2] = {0.0, 1.0};
+
+	if (rc.SetRegion(rg, range) < 0) return(-1);
+	rc.SetOLUT(tf, 0);
+
+	vector <unsigned char> image;
+	if (render(rc, 30.0, true, 0.99, image, NULL) < 0) return(-1);
+	for (size_t i=0; i<image.size(); i++) {
+		if (image[i] != 0) {
+			cerr << ProgName << " : transparent volume rendered" << endl;
+			return(-1);
+		}
+	}
+	return(0);
+}
+
+//
+// Rays through a constant volume, along the z axis, take 2*(dim-1)+1
+// samples of opacity a: the opacity of the pixel is 1-(1-a)^n. Pixels
+// outside of the volume are transparent.
+//
+int test_constant(const RegularGrid *rg) {
+	DVRRayCasterCPU rc(opt.nthreads);
+	float alpha = 0.02;
+	float tf[256][4];
+	for (int i=0; i<256; i++) {
+		tf[i][0] = tf[i][1] = tf[i][2] = 1.0;
+		tf[i][3] = alpha;
+	}
+	float range[2] = {0.0, 1.0};
+
+	if (rc.SetRegion(rg, range) < 0) return(-1);
+	rc.SetCLUT(tf);
+
+	vector <unsigned char> image;
+	if (render(rc, 0.0, true, 2.0, image, NULL) < 0) return(-1);
+
+	int n = 2*(opt.dim-1) + 1;
+	int expected = (int) ((1.0 - pow(1.0 - alpha, n)) * 255.0 + 0.5);
+	int center = ((opt.size/2) * opt.size + opt.size/2) * 4;
+
+	int rcode = 0;
+	for (int c=0; c<4; c++) {
+		if (abs(image[center + c] - expected) > 1) {
+			cerr << ProgName << " : constant volume opacity " <<
+				(int) image[center + c] << ", expected " << expected << endl;
+			rcode = -1;
+		}
+	}
+	for (int c=0; c<4; c++) {
+		if (image[c] != 0 || image[image.size() - 4 + c] != 0) {
+			cerr << ProgName << " : pixel outside of volume rendered" << endl;
+			rcode = -1;
+		}
+	}
+	return(rcode);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int rc = 0;
+	vector <float *> storage;
+	RegularGrid *blob = make_grid(opt.dim, false, storage);
+	RegularGrid *constant = make_grid(opt.dim, true, storage);
+
+	for (int preint = 0; preint < 2; preint++) {
+		for (int lighting = 0; lighting < 2; lighting++) {
+			if (test_accel(blob, preint, lighting, false) < 0) rc = 1;
+		}
+	}
+	if (test_accel(blob, false, false, true) < 0) rc = 1;
+	if (test_empty(blob) < 0) rc = 1;
+	if (test_constant(constant) < 0) rc = 1;
+
+	delete blob;
+	delete constant;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+
+	exit(rc);
+}
@@ -0,0 +1,201 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include "RenderJobQueue.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for RenderJobQueue: checks that a client's jobs run
+// one at a time, that a submitted job replaces the waiting one and
+// cancels the running one, that cancelled jobs are never handed over,
+// and that the completion callback is made. No OpenGL context is needed.
+//
+
+struct {
+	int	nthreads;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nthreads",1, 	"2",	"Number of worker threads"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Job that spins for a number of milliseconds, returning early if it is
+// cancelled, and counts how many jobs of its client run at once
+//
+class TestJob : public RenderJob {
+public:
+	TestJob(int id, int msec, volatile int *nrunning) :
+		_id(id), _msec(msec), _nrunning(nrunning), _overlap(false) {}
+
+	virtual int Run() {
+		if (++(*_nrunning) > 1) _overlap = true;
+		for (int t=0; t<_msec && ! IsCancelled(); t++) usleep(1000);
+		--(*_nrunning);
+		return(IsCancelled() ? -1 : _id);
+	}
+
+	int GetId() const { return(_id); }
+	bool Overlapped() const { return(_overlap); }
+
+private:
+	int _id;
+	int _msec;
+	volatile int *_nrunning;
+	bool _overlap;
+};
+
+int NCallbacks = 0;
+
+void callback(void *clientData) {
+	(*(int *) clientData)++;
+}
+
+int test_replace(RenderJobQueue &queue) {
+	volatile int nrunning = 0;
+	int client;
+
+	//
+	// The first job is cancelled while it runs, the second is replaced
+	// before it runs: only the last one completes
+	//
+	queue.Submit(&client, new TestJob(1, 2000, &nrunning), callback, &NCallbacks);
+	usleep(50000);
+	queue.Submit(&client, new TestJob(2, 2000, &nrunning), callback, &NCallbacks);
+	queue.Submit(&client, new TestJob(3, 10, &nrunning), callback, &NCallbacks);
+	queue.Wait(&client);
+
+	if (queue.IsBusy(&client)) {
+		cerr << ProgName << " : queue busy after Wait()" << endl;
+		return(-1);
+	}
+	TestJob *job = (TestJob *) queue.TakeCompleted(&client);
+	if (! job || job->GetId() != 3 || job->GetStatus() != 3) {
+		cerr << ProgName << " : wrong completed job" << endl;
+		return(-1);
+	}
+	if (job->Overlapped()) {
+		cerr << ProgName << " : jobs of a client ran concurrently" << endl;
+		return(-1);
+	}
+	delete job;
+
+	if (queue.TakeCompleted(&client)) {
+		cerr << ProgName << " : job completed twice" << endl;
+		return(-1);
+	}
+	if (queue.GetNumThreads() && NCallbacks != 1) {
+		cerr << ProgName << " : " << NCallbacks << " callbacks, expected 1" << endl;
+		return(-1);
+	}
+	queue.Remove(&client);
+	return(0);
+}
+
+int test_cancel(RenderJobQueue &queue) {
+	volatile int nrunning = 0;
+	int client;
+
+	queue.Submit(&client, new TestJob(1, 2000, &nrunning));
+	usleep(50000);
+	queue.Cancel(&client);
+	queue.Wait(&client);
+	if (queue.TakeCompleted(&client)) {
+		cerr << ProgName << " : cancelled job completed" << endl;
+		return(-1);
+	}
+
+	//
+	// Removing a client waits for its running job
+	//
+	queue.Submit(&client, new TestJob(2, 2000, &nrunning));
+	usleep(50000);
+	queue.Remove(&client);
+	if (nrunning) {
+		cerr << ProgName << " : job running after Remove()" << endl;
+		return(-1);
+	}
+	return(0);
+}
+
+int test_clients(RenderJobQueue &queue) {
+	volatile int nrunning[4] = {0, 0, 0, 0};
+	int clients[4];
+
+	//
+	// Every client gets its own completed job
+	//
+	for (int c=0; c<4; c++) {
+		queue.Submit(&clients[c], new TestJob(c, 20, &nrunning[c]));
+	}
+	int rc = 0;
+	for (int c=0; c<4; c++) {
+		queue.Wait(&clients[c]);
+		TestJob *job = (TestJob *) queue.TakeCompleted(&clients[c]);
+		if (! job || job->GetId() != c) {
+			cerr << ProgName << " : client " << c << " : wrong job" << endl;
+			rc = -1;
+		}
+		if (job) delete job;
+		queue.Remove(&clients[c]);
+	}
+	return(rc);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	RenderJobQueue queue(opt.nthreads);
+
+	int rc = 0;
+	if (test_replace(queue) < 0) rc = 1;
+	if (test_cancel(queue) < 0) rc = 1;
+	if (test_clients(queue) < 0) rc = 1;
+
+	cout << ProgName << " : " << queue.GetNumThreads() << " worker threads, " <<
+		(rc ? "failed" : "passed") << endl;
+	exit(rc);
+}
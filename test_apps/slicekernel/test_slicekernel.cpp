@@ -0,0 +1,282 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/SliceKernel.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression and throughput test for SliceKernel: unstaggers volumes
+// shaped like a WRF domain, with and without missing values, and the WRF
+// elevation (PH + PHB) / g, and compares the results bit for bit with
+// interpolating along X, Y and Z in separate passes.
+//
+
+struct {
+	int	nx;
+	int	ny;
+	int	nz;
+	int	nreps;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nx",		1, 	"425",	"Unstaggered dimension along X"},
+	{"ny",		1, 	"300",	"Unstaggered dimension along Y"},
+	{"nz",		1, 	"50",	"Unstaggered dimension along Z"},
+	{"nreps",	1, 	"3",	"Number of timed repetitions"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nx", VetsUtil::CvtToInt, &opt.nx, sizeof(opt.nx)},
+	{"ny", VetsUtil::CvtToInt, &opt.ny, sizeof(opt.ny)},
+	{"nz", VetsUtil::CvtToInt, &opt.nz, sizeof(opt.nz)},
+	{"nreps", VetsUtil::CvtToInt, &opt.nreps, sizeof(opt.nreps)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	MissingValue = 1.e37f;
+const float	Grav = 9.81f;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Interpolate along one dimension in place, as NetCDFCollection did
+// before the kernel
+//
+void interpolate_line(
+	float *data, size_t n, size_t stride, bool has_missing
+) {
+	for (size_t i=0; i<n-1; i++) {
+		float a = data[i*stride];
+		float b = data[(i+1)*stride];
+		if (has_missing && (a == MissingValue || b == MissingValue)) {
+			data[i*stride] = MissingValue;
+		}
+		else {
+			data[i*stride] = 0.5 * (a + b);
+		}
+	}
+}
+
+vector <float> reference(
+	const vector <float> &native, const size_t dim[3], const bool stag[3],
+	bool has_missing
+) {
+	size_t nx = dim[0], ny = dim[1], nz = dim[2];
+	size_t nxus = stag[0] ? nx-1 : nx;
+	size_t nyus = stag[1] ? ny-1 : ny;
+	size_t nzus = stag[2] ? nz-1 : nz;
+
+	vector <float> buf = native;
+	vector <float> out;
+	for (size_t z=0; z<nz; z++) {
+		float *slice = &buf[z*nx*ny];
+		if (stag[0]) {
+			for (size_t y=0; y<ny; y++) {
+				interpolate_line(slice + y*nx, nx, 1, has_missing);
+			}
+		}
+		if (stag[1]) {
+			for (size_t x=0; x<nx; x++) {
+				interpolate_line(slice + x, ny, nx, has_missing);
+			}
+		}
+		for (size_t y=0; y<nyus; y++) {
+			out.insert(out.end(), slice + y*nx, slice + y*nx + nxus);
+		}
+	}
+	if (stag[2]) {
+		for (size_t i=0; i<nxus*nyus; i++) {
+			interpolate_line(&out[i], nz, nxus*nyus, has_missing);
+		}
+	}
+	out.resize(nxus*nyus*nzus);
+	return(out);
+}
+
+vector <float> make_volume(const size_t dim[3], bool has_missing) {
+	vector <float> volume(dim[0]*dim[1]*dim[2]);
+	for (size_t i=0; i<volume.size(); i++) {
+		volume[i] = 1000.0 * rand() / RAND_MAX;
+		if (has_missing && rand() % 50 == 0) volume[i] = MissingValue;
+	}
+	return(volume);
+}
+
+int count_mismatches(const vector <float> &a, const vector <float> &b) {
+	if (a.size() != b.size()) return(-1);
+	int mismatches = 0;
+	for (size_t i=0; i<a.size(); i++) {
+		if (memcmp(&a[i], &b[i], sizeof(float)) != 0) mismatches++;
+	}
+	return(mismatches);
+}
+
+//
+// Unstagger a volume, slice by slice and whole, and check both against
+// the separate passes
+//
+int test_unstagger(const size_t dim[3], const bool stag[3], bool has_missing) {
+	vector <float> native = make_volume(dim, has_missing);
+	size_t nxy = dim[0]*dim[1];
+
+	double t0 = GetTime();
+	vector <float> ref;
+	for (int r=0; r<opt.nreps; r++) {
+		ref = reference(native, dim, stag, has_missing);
+	}
+	double t1 = GetTime();
+
+	SliceKernel kernel;
+	if (kernel.Init(
+		dim[0], dim[1], stag[0], stag[1], stag[2], 1, 1.0, has_missing,
+		MissingValue
+	) < 0) exit(1);
+
+	size_t nxus, nyus;
+	kernel.GetDim(nxus, nyus);
+	vector <float> sliced(ref.size());
+	vector <float> whole(ref.size());
+	double t2 = GetTime();
+	for (int r=0; r<opt.nreps; r++) {
+		kernel.Reset();
+		float *dst = &sliced[0];
+		for (size_t z=0; z<dim[2]; z++) {
+			const float *slices[] = {&native[z*nxy]};
+			int rc = kernel.Apply(slices, dst);
+			if (rc < 0) exit(1);
+			if (rc) dst += nxus*nyus;
+		}
+	}
+	double t3 = GetTime();
+
+	const float *volumes[] = {&native[0]};
+	size_t nslices = kernel.ApplyVolume(volumes, dim[2], &whole[0]);
+
+	double mbytes = opt.nreps * native.size() * sizeof(float) / 1.e6;
+	cout << "Stagger " << stag[0] << stag[1] << stag[2] <<
+		(has_missing ? " with missing values : " : " : ") <<
+		mbytes/(t1-t0) << " MB/s in separate passes, " <<
+		mbytes/(t3-t2) << " MB/s fused" << endl;
+
+	int nerrors = 0;
+	if (nslices*nxus*nyus != ref.size()) {
+		cerr << "Wrong number of slices : " << nslices << endl;
+		nerrors++;
+	}
+	int m0 = count_mismatches(sliced, ref);
+	int m1 = count_mismatches(whole, ref);
+	if (m0 || m1) {
+		cerr << "Stagger " << stag[0] << stag[1] << stag[2] << " : " <<
+			m0 << ", " << m1 << " mismatches" << endl;
+		nerrors++;
+	}
+	return(nerrors);
+}
+
+//
+// The WRF elevation, (PH + PHB) / g, with PH and PHB staggered along Z
+//
+int test_elevation(const size_t dim[3]) {
+	bool stag[] = {false, false, true};
+	vector <float> PH = make_volume(dim, false);
+	vector <float> PHB = make_volume(dim, false);
+
+	double t0 = GetTime();
+	vector <float> ref;
+	for (int r=0; r<opt.nreps; r++) {
+		ref = reference(PH, dim, stag, false);
+		vector <float> refB = reference(PHB, dim, stag, false);
+		for (size_t i=0; i<ref.size(); i++) {
+			ref[i] = (ref[i] + refB[i]) / Grav;
+		}
+	}
+	double t1 = GetTime();
+
+	SliceKernel kernel;
+	if (kernel.Init(
+		dim[0], dim[1], stag[0], stag[1], stag[2], 2, Grav
+	) < 0) exit(1);
+
+	vector <float> elev(ref.size());
+	const float *volumes[] = {&PH[0], &PHB[0]};
+	double t2 = GetTime();
+	for (int r=0; r<opt.nreps; r++) {
+		(void) kernel.ApplyVolume(volumes, dim[2], &elev[0]);
+	}
+	double t3 = GetTime();
+
+	double mbytes = opt.nreps * 2 * PH.size() * sizeof(float) / 1.e6;
+	cout << "Elevation : " << mbytes/(t1-t0) << " MB/s in separate passes, " <<
+		mbytes/(t3-t2) << " MB/s fused" << endl;
+
+	int mismatches = count_mismatches(elev, ref);
+	if (mismatches) {
+		cerr << "Elevation : " << mismatches << " mismatches" << endl;
+		return(1);
+	}
+	return(0);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int nerrors = 0;
+
+	//
+	// Every combination of staggered dimensions
+	//
+	for (int s=0; s<8; s++) {
+		bool stag[] = {(s & 1) != 0, (s & 2) != 0, (s & 4) != 0};
+		size_t dim[3] = {(size_t) opt.nx, (size_t) opt.ny, (size_t) opt.nz};
+		for (int i=0; i<3; i++) {
+			if (stag[i]) dim[i]++;
+		}
+		nerrors += test_unstagger(dim, stag, false);
+		nerrors += test_unstagger(dim, stag, true);
+	}
+
+	size_t dim[] = {(size_t) opt.nx, (size_t) opt.ny, (size_t) opt.nz+1};
+	nerrors += test_elevation(dim);
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}
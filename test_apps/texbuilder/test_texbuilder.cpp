@@ -0,0 +1,275 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/RegularGrid.h>
+#include <vapor/LayeredGrid.h>
+#include <vapor/MapperFunctionBase.h>
+#include "TextureBuilder.h"
+#include "TestGrid.h"
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Benchmark and regression test for TextureBuilder: samples an oblique
+// plane through a synthetic volume and compares the texture with one
+// computed a texel at a time, the way the probe and 2D renderers used to.
+//
+
+struct {
+	int	width;
+	int	height;
+	int	dim;
+	int	nthreads;
+	int	loop;
+	OptionParser::Boolean_T	layered;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"width",	1, 	"1024",	"Texture width"},
+	{"height",	1, 	"1024",	"Texture height"},
+	{"dim",		1, 	"128",	"Grid dimension along each axis"},
+	{"nthreads",1, 	"0",	"Number of threads (0 => number of processors)"},
+	{"loop",	1, 	"5",	"Number of textures to build"},
+	{"layered",	0,	"",	"Sample a layered grid instead of a regular one"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"width", VetsUtil::CvtToInt, &opt.width, sizeof(opt.width)},
+	{"height", VetsUtil::CvtToInt, &opt.height, sizeof(opt.height)},
+	{"dim", VetsUtil::CvtToInt, &opt.dim, sizeof(opt.dim)},
+	{"nthreads", VetsUtil::CvtToInt, &opt.nthreads, sizeof(opt.nthreads)},
+	{"loop", VetsUtil::CvtToInt, &opt.loop, sizeof(opt.loop)},
+	{"layered", VetsUtil::CvtToBoolean, &opt.layered, sizeof(opt.layered)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+//
+// Plane through the volume tilted about the x and y axes
+//
+class PlaneMapper : public TexelMapper {
+public:
+	PlaneMapper(const double extents[6]) {
+		for (int i=0; i<6; i++) _extents[i] = extents[i];
+	}
+	void MapRow(
+		int iy, int width, int height, double *coords, bool *valid
+	) const {
+		double v = (double) iy / (double) (height-1);
+		for (int ix=0; ix<width; ix++) {
+			double u = (double) ix / (double) (width-1);
+			double *c = coords + 3*ix;
+			c[0] = _extents[0] + (_extents[3]-_extents[0]) * (1.1*u - 0.05);
+			c[1] = _extents[1] + (_extents[4]-_extents[1]) * v;
+			c[2] = _extents[2] + (_extents[5]-_extents[2]) * (0.2 + 0.3*u + 0.4*v);
+			valid[ix] = c[0] >= _extents[0] && c[0] <= _extents[3];
+		}
+	}
+private:
+	double _extents[6];
+};
+
+float value(double x, double y, double z) {
+	return(sin(6.0*x) * cos(4.0*y) + z);
+}
+
+// terrain following coordinate
+//
+double terrain(double x, double y, double z) {
+	double t = 0.1 * sin(3.0*x) * sin(5.0*y);
+	return(t + z * (1.0 - t));
+}
+
+RegularGrid *make_grid(int dim, bool layered, vector <float *> &storage) {
+	size_t min[3] = {0,0,0};
+	double extents[6] = {0.0, 0.0, 0.0, 1.0, 1.0, 1.0};
+
+	RegularGrid *rg = MakeTestGrid(
+		dim, min, extents, value, layered ? terrain : NULL, NULL, storage
+	);
+	rg->SetInterpolationOrder(1);
+	return(rg);
+}
+
+//
+// Texel at a time reference
+//
+void build_reference(
+	const RegularGrid *rg, const TexelMapper &mapper, const float *clut,
+	float minValue, float maxValue, int width, int height,
+	unsigned char *texture
+) {
+	vector <double> coords(3*width);
+	bool *valid = new bool[width];
+	for (int iy = 0; iy < height; iy++) {
+		mapper.MapRow(iy, width, height, &coords[0], valid);
+		for (int ix = 0; ix < width; ix++) {
+			unsigned char *texel = texture + 4*(ix+width*iy);
+			float varVal = rg->GetMissingValue();
+			if (valid[ix]) {
+				varVal = rg->GetValue(coords[3*ix],coords[3*ix+1],coords[3*ix+2]);
+			}
+			if (varVal == rg->GetMissingValue()) {
+				for (int c=0; c<4; c++) texel[c] = 0;
+				continue;
+			}
+			int lutIndex = MapperFunctionBase::mapPosition(
+				varVal, minValue, maxValue, 255
+			);
+			if (lutIndex < 0) lutIndex = 0;
+			if (lutIndex > 255) lutIndex = 255;
+			for (int c=0; c<4; c++) {
+				texel[c] = (unsigned char)(0.5+ clut[4*lutIndex+c]*255.f);
+			}
+		}
+	}
+	delete [] valid;
+}
+
+//
+// Check TextureBuilder::Sample() against texel at a time sampling
+//
+int check_samples(
+	TextureBuilder *tb, const RegularGrid *rg, const TexelMapper &mapper,
+	int width, int height
+) {
+	const RegularGrid *grids[3] = {rg, NULL, rg};
+	vector <float> values(3*width*height);
+	vector <unsigned char> valid(width*height);
+	if (tb->Sample(grids, &mapper, width, height, &values[0], &valid[0]) < 0) {
+		return(-1);
+	}
+
+	vector <double> coords(3*width);
+	bool *rowValid = new bool[width];
+	int rc = 0;
+	for (int iy = 0; iy < height && rc == 0; iy++) {
+		mapper.MapRow(iy, width, height, &coords[0], rowValid);
+		for (int ix = 0; ix < width; ix++) {
+			int texPos = ix + width*iy;
+			float v = 0.0;
+			bool ok = rowValid[ix];
+			if (ok) {
+				v = rg->GetValue(coords[3*ix],coords[3*ix+1],coords[3*ix+2]);
+				if (v == rg->GetMissingValue()) {
+					v = 0.0;
+					ok = false;
+				}
+			}
+			if ((valid[texPos] != 0) != ok || values[3*texPos] != v ||
+				values[3*texPos+1] != 0.0 || values[3*texPos+2] != v) {
+
+				cerr << ProgName << " : samples differ from reference" << endl;
+				rc = -1;
+				break;
+			}
+		}
+	}
+	delete [] rowValid;
+	return(rc);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	ProgName = Basename(argv[0]);
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	vector <float *> storage;
+	RegularGrid *rg = make_grid(opt.dim, opt.layered, storage);
+
+	double extents[6];
+	rg->GetUserExtents(extents);
+	PlaneMapper mapper(extents);
+
+	float clut[256*4];
+	for (int i=0; i<256; i++) {
+		clut[4*i] = (float) i / 255.0;
+		clut[4*i+1] = 1.0 - (float) i / 255.0;
+		clut[4*i+2] = fabs(sin(0.05*i));
+		clut[4*i+3] = 0.5;
+	}
+	float minValue = -0.5;
+	float maxValue = 1.5;
+
+	size_t texsize = (size_t) opt.width * opt.height * 4;
+	unsigned char *reference = new unsigned char[texsize];
+	unsigned char *texture = new unsigned char[texsize];
+
+	double t0 = GetTime();
+	build_reference(
+		rg, mapper, clut, minValue, maxValue, opt.width, opt.height, reference
+	);
+	double rtime = GetTime() - t0;
+	cout << "Reference : " <<
+		(double) opt.width * opt.height / rtime * 1.0e-6 << " Mtexel/s" << endl;
+
+	TextureBuilder serial(1);
+	TextureBuilder parallel(opt.nthreads);
+	TextureBuilder *builders[] = {&serial, &parallel};
+
+	int rc = 0;
+	for (int b=0; b<2; b++) {
+		TextureBuilder *tb = builders[b];
+		tb->SetLut(clut, 256, minValue, maxValue);
+
+		double best = 0.0;
+		for (int l=0; l<opt.loop; l++) {
+			memset(texture, 0xff, texsize);
+			if (tb->Build(rg, &mapper, opt.width, opt.height, texture) < 0) {
+				exit(1);
+			}
+			if (tb->GetMTexelsPerSec() > best) best = tb->GetMTexelsPerSec();
+
+			if (memcmp(texture, reference, texsize) != 0) {
+				cerr << ProgName << " : texture differs from reference" << endl;
+				rc = 1;
+			}
+		}
+		cout << "TextureBuilder (" << tb->GetNumThreads() << " threads) : " <<
+			best << " Mtexel/s" << endl;
+
+		if (check_samples(tb, rg, mapper, opt.width, opt.height) < 0) rc = 1;
+	}
+
+	delete rg;
+	for (int i=0; i<storage.size(); i++) delete [] storage[i];
+	delete [] reference;
+	delete [] texture;
+
+	exit(rc);
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <vapor/CFuncs.h>
+#include <vapor/OptionParser.h>
+#include <vapor/WeightTable.h>
+
+using namespace VetsUtil;
+using namespace VAPoR;
+
+//
+// Regression test for WeightTable: interpolates a distorted global grid
+// with missing values to a lon/lat grid, checks that regions of the
+// lon/lat grid match the whole grid, and that a table read from the
+// cache directory matches a computed one.
+//
+
+struct {
+	int	nx;
+	int	ny;
+	char *cachedir;
+	OptionParser::Boolean_T	help;
+} opt;
+
+OptionParser::OptDescRec_T	set_opts[] = {
+	{"nx",		1, 	"180",	"User grid dimension along longitude"},
+	{"ny",		1, 	"90",	"User grid dimension along latitude"},
+	{"cachedir",1, 	"test_weighttable.cache",	"Weight table cache directory"},
+	{"help",	0,	"",	"Print this message and exit"},
+	{NULL}
+};
+
+OptionParser::Option_T	get_options[] = {
+	{"nx", VetsUtil::CvtToInt, &opt.nx, sizeof(opt.nx)},
+	{"ny", VetsUtil::CvtToInt, &opt.ny, sizeof(opt.ny)},
+	{"cachedir", VetsUtil::CvtToString, &opt.cachedir, sizeof(opt.cachedir)},
+	{"help", VetsUtil::CvtToBoolean, &opt.help, sizeof(opt.help)},
+	{NULL}
+};
+
+const char	*ProgName;
+const float	SrcMV = 1.e37f;
+const float	DstMV = -999.0;
+
+void ErrMsgCBHandler(const char *msg, int) {
+    cerr << ProgName << " : " << msg << endl;
+}
+
+int count_mismatches(const float *a, const float *b, size_t n) {
+	int mismatches = 0;
+	for (size_t i=0; i<n; i++) {
+		if (memcmp(&a[i], &b[i], sizeof(float)) != 0) mismatches++;
+	}
+	return(mismatches);
+}
+
+//
+// Interpolate a region of the lon/lat grid from the part of the user
+// grid returned by sourceRegion(), and compare with the whole grid
+//
+int check_region(
+	WeightTable &wt, const vector <float> &data, const vector <float> &result,
+	int nx, const size_t min[2], const size_t max[2]
+) {
+	size_t smin[2], smax[2];
+	wt.sourceRegion(min, max, smin, smax);
+
+	size_t snx = smax[0]-smin[0]+1;
+	vector <float> source(snx*(smax[1]-smin[1]+1));
+	for (size_t y=smin[1]; y<=smax[1]; y++) {
+	for (size_t x=smin[0]; x<=smax[0]; x++) {
+		source[(y-smin[1])*snx + x-smin[0]] = data[y*nx + x];
+	}
+	}
+
+	size_t rnx = max[0]-min[0]+1;
+	vector <float> region(rnx*(max[1]-min[1]+1));
+	wt.interp2D(&source[0], smin, smax, &region[0], min, max, SrcMV, DstMV);
+
+	int mismatches = 0;
+	for (size_t y=min[1]; y<=max[1]; y++) {
+		mismatches += count_mismatches(
+			&region[(y-min[1])*rnx], &result[y*nx + min[0]], rnx
+		);
+	}
+	if (mismatches) {
+		cerr << "Region : " << mismatches << " mismatches" << endl;
+		return(1);
+	}
+	return(0);
+}
+
+int main(int argc, char **argv) {
+
+	OptionParser op;
+
+	MyBase::SetErrMsgCB(ErrMsgCBHandler);
+
+	ProgName = Basename(argv[0]);
+
+	if (op.AppendOptions(set_opts) < 0) {
+		cerr << ProgName << " : " << op.GetErrMsg();
+		exit(1);
+	}
+
+	if (op.ParseOptions(&argc, argv, get_options) < 0) {
+		cerr << ProgName << " : " << OptionParser::GetErrMsg();
+		exit(1);
+	}
+
+	if (opt.help) {
+		cerr << "Usage: " << ProgName << " [options]" << endl;
+		op.PrintOptionHelp(stderr);
+		exit(0);
+	}
+
+	int nerrors = 0;
+	int nx = opt.nx;
+	int ny = opt.ny;
+
+	//
+	// A global grid with wavy rows and columns, wrapping in longitude
+	//
+	vector <float> lat(nx*ny), lon(nx*ny), data(nx*ny);
+	for (int y=0; y<ny; y++) {
+	for (int x=0; x<nx; x++) {
+		lon[y*nx + x] = (x + 0.5*sin(y*0.1))*360.0/nx;
+		lat[y*nx + x] = -80.0 + y*165.0/ny + 2.0*cos(x*0.07);
+		data[y*nx + x] = rand() % 37 ?
+			sin(lon[y*nx + x]*0.05) * cos(lat[y*nx + x]*0.03) : SrcMV;
+	}
+	}
+	float latexts[] = {-75.0, 85.0};
+	float lonexts[] = {0.0, (float) (360.0*(nx-1)/nx)};
+	size_t dims[] = {(size_t) nx, (size_t) ny, 1};
+
+	WeightTable::SetCacheDir("");
+	double t0 = GetTime();
+	WeightTable wt(&lat[0], &lon[0], ny, nx, latexts, lonexts);
+	double t1 = GetTime();
+	cout << "Computed a " << nx << "x" << ny << " weight table in " <<
+		t1-t0 << " seconds" << endl;
+
+	vector <float> result(nx*ny);
+	wt.interp2D(&data[0], &result[0], SrcMV, DstMV, dims);
+
+	size_t min[] = {(size_t) nx/8, (size_t) ny/6};
+	size_t max[] = {(size_t) nx*5/6, (size_t) ny*3/4};
+	nerrors += check_region(wt, data, result, nx, min, max);
+
+	//
+	// The first table is written to the cache, the second is read from it
+	//
+	WeightTable::SetCacheDir(opt.cachedir);
+	for (int pass=0; pass<2; pass++) {
+		t0 = GetTime();
+		WeightTable cached(&lat[0], &lon[0], ny, nx, latexts, lonexts);
+		t1 = GetTime();
+		if (pass == 1) {
+			cout << "Read the weight table in " << t1-t0 << " seconds" << endl;
+		}
+
+		vector <float> cresult(nx*ny);
+		cached.interp2D(&data[0], &cresult[0], SrcMV, DstMV, dims);
+		int mismatches = count_mismatches(&cresult[0], &result[0], nx*ny);
+		if (mismatches) {
+			cerr << "Cache pass " << pass << " : " << mismatches <<
+				" mismatches" << endl;
+			nerrors++;
+		}
+		nerrors += check_region(cached, data, cresult, nx, min, max);
+	}
+	WeightTable::SetCacheDir("");
+
+	if (nerrors) {
+		cerr << ProgName << " : " << nerrors << " errors" << endl;
+		exit(1);
+	}
+	cout << "Passed" << endl;
+	exit(0);
+}